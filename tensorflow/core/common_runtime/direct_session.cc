@@ -17,6 +17,7 @@ limitations under the License.
 
 #include <algorithm>
 #include <atomic>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -37,6 +38,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/local_session_selection.h"
 #include "tensorflow/core/common_runtime/memory_types.h"
 #include "tensorflow/core/common_runtime/optimization_registry.h"
+#include "tensorflow/core/common_runtime/partitioned_graph_cache.h"
 #include "tensorflow/core/common_runtime/process_util.h"
 #include "tensorflow/core/common_runtime/rendezvous_mgr.h"
 #include "tensorflow/core/common_runtime/scoped_allocator_mgr.h"
@@ -90,6 +92,12 @@ auto* direct_session_runs = monitoring::Counter<0>::New(
     "/tensorflow/core/direct_session_runs",
     "The number of times DirectSession::Run() has been called.");
 
+auto* direct_session_partitioned_graph_cache = monitoring::Counter<1>::New(
+    "/tensorflow/core/direct_session_partitioned_graph_cache",
+    "The number of lookups in the partitioned graph cache of DirectSession, "
+    "by result.",
+    "result");
+
 Status NewThreadPoolFromThreadPoolOptions(
     const SessionOptions& options,
     const ThreadPoolOptionProto& thread_pool_options, int pool_number,
@@ -160,6 +168,24 @@ string GetRendezvousKey(const string& tensor_name,
                          frame_iter.frame_id, ":", frame_iter.iter_id);
 }
 
+// Gives the device of each partition an opportunity to rewrite its subgraph.
+Status RewriteGraphsForDevices(
+    const DeviceMgr* device_mgr,
+    std::unordered_map<string, std::unique_ptr<Graph>>* graphs) {
+  for (auto& partition : *graphs) {
+    const string& partition_name = partition.first;
+    std::unique_ptr<Graph>* graph = &partition.second;
+
+    VLOG(2) << "Created " << DebugString(graph->get()) << " for "
+            << partition_name;
+
+    Device* d;
+    TF_RETURN_IF_ERROR(device_mgr->LookupDevice(partition_name, &d));
+    TF_RETURN_IF_ERROR(d->MaybeRewriteGraph(graph));
+  }
+  return OkStatus();
+}
+
 }  // namespace
 
 class DirectSessionFactory : public SessionFactory {
@@ -380,6 +406,12 @@ DirectSession::DirectSession(const SessionOptions& options,
       LOG(INFO) << msg;
     }
   }
+  const string& cache_directory =
+      options_.config.experimental().partitioned_graph_cache_directory();
+  if (!cache_directory.empty()) {
+    partitioned_graph_cache_ = std::make_unique<PartitionedGraphCache>(
+        options_.env, cache_directory);
+  }
   for (auto d : device_mgr_->ListDevices()) {
     devices_.push_back(d);
     device_set_.AddDevice(d);
@@ -447,6 +479,10 @@ Status DirectSession::ExtendLocked(GraphDef&& graph) {
   if (finalized_) {
     return errors::FailedPrecondition("Session has been finalized.");
   }
+  if (partitioned_graph_cache_ != nullptr) {
+    graph_fingerprint_ =
+        PartitionedGraphCache::FingerprintGraph(graph_fingerprint_, graph);
+  }
   if (!(flib_def_ && execution_state_)) {
     // If this is the first call, we can initialize the execution state
     // with `graph` and do not need to call `Extend()`.
@@ -1424,6 +1460,17 @@ Status DirectSession::CreateExecutors(
       if (kernel && !OpSegment::ShouldOwnKernel(lib, kernel->type_string()))
         delete kernel;
     };
+    params.use_step_arena_allocator =
+        options_.config.experimental().use_step_arena_allocator();
+    params.static_memory_plan_warmup_runs =
+        options_.config.experimental().static_memory_plan_warmup_runs();
+    // The kernels of large graphs are created on the inter-op thread pool,
+    // which is otherwise idle while the executors are created.
+    thread::ThreadPool* initialization_pool = thread_pools_[0].first;
+    params.initialization_runner =
+        [initialization_pool](std::function<void()> fn) {
+          initialization_pool->Schedule(std::move(fn));
+        };
 
     optimizer.Optimize(lib, options_.env, device, &partition_graph,
                        GraphOptimizer::Options());
@@ -1614,6 +1661,29 @@ Status DirectSession::CreateGraphs(
     return errors::FailedPrecondition("Session has been finalized.");
   }
 
+  // Partial runs need the full graph, which is not cached.
+  std::optional<PartitionedGraphCacheKey> cache_key;
+  if (partitioned_graph_cache_ != nullptr && !run_state_args->is_partial_run) {
+    cache_key = partitioned_graph_cache_->BuildKey(
+        graph_fingerprint_, subgraph_options, options_.config, devices_);
+    std::optional<PartitionedGraphCacheEntry> entry =
+        partitioned_graph_cache_->TryToLoad(*cache_key);
+    if (entry.has_value()) {
+      Status s = CreateGraphsFromCacheEntry(
+          subgraph_options, &*entry, outputs, flib_def, input_types,
+          output_types, collective_graph_key);
+      if (s.ok()) {
+        direct_session_partitioned_graph_cache->GetCell("hit")->IncrementBy(1);
+        return RewriteGraphsForDevices(device_mgr_.get(), outputs);
+      }
+      LOG(WARNING) << "Failed to create graphs from the partitioned graph "
+                   << "cache entry "
+                   << partitioned_graph_cache_->GetFilePath(*cache_key) << ": "
+                   << s;
+    }
+    direct_session_partitioned_graph_cache->GetCell("miss")->IncrementBy(1);
+  }
+
   std::unique_ptr<ClientGraph> client_graph;
 
   std::unique_ptr<GraphExecutionState> temp_exec_state_holder;
@@ -1740,29 +1810,96 @@ Status DirectSession::CreateGraphs(
   TF_RETURN_IF_ERROR(OptimizationPassRegistry::Global()->RunGrouping(
       OptimizationPassRegistry::POST_PARTITIONING, optimization_options));
 
-  Status s;
-  for (auto& partition : *outputs) {
-    const string& partition_name = partition.first;
-    std::unique_ptr<Graph>* graph = &partition.second;
-
-    VLOG(2) << "Created " << DebugString(graph->get()) << " for "
-            << partition_name;
-
-    // Give the device an opportunity to rewrite its subgraph.
-    Device* d;
-    s = device_mgr_->LookupDevice(partition_name, &d);
-    if (!s.ok()) break;
-    s = d->MaybeRewriteGraph(graph);
+  if (cache_key.has_value()) {
+    PartitionedGraphCacheEntry entry;
+    *entry.mutable_key() = *cache_key;
+    for (const auto& partition : *outputs) {
+      partition.second->ToGraphDef(
+          &(*entry.mutable_partitions())[partition.first]);
+    }
+    *entry.mutable_library() = client_graph->flib_def->ToProto();
+    for (DataType dtype : client_graph->feed_types) {
+      entry.add_feed_types(dtype);
+    }
+    for (DataType dtype : client_graph->fetch_types) {
+      entry.add_fetch_types(dtype);
+    }
+    entry.set_collective_graph_key(*collective_graph_key);
+    entry.mutable_stateful_placements()->insert(stateful_placements_.begin(),
+                                                stateful_placements_.end());
+    Status s = partitioned_graph_cache_->Save(entry);
     if (!s.ok()) {
-      break;
+      LOG(WARNING) << "Failed to save the partitioned graph cache entry "
+                   << partitioned_graph_cache_->GetFilePath(*cache_key)
+                   << ": " << s;
     }
   }
+
+  Status s = RewriteGraphsForDevices(device_mgr_.get(), outputs);
   *flib_def = std::move(client_graph->flib_def);
   std::swap(*input_types, client_graph->feed_types);
   std::swap(*output_types, client_graph->fetch_types);
   return s;
 }
 
+Status DirectSession::CreateGraphsFromCacheEntry(
+    const BuildGraphOptions& options, PartitionedGraphCacheEntry* entry,
+    std::unordered_map<string, std::unique_ptr<Graph>>* outputs,
+    std::unique_ptr<FunctionLibraryDefinition>* flib_def,
+    DataTypeVector* input_types, DataTypeVector* output_types,
+    int64_t* collective_graph_key) {
+  if (entry->feed_types_size() != options.callable_options.feed_size() ||
+      entry->fetch_types_size() != options.callable_options.fetch_size()) {
+    return errors::InvalidArgument(
+        "Number of feeds and fetches does not match the callable options.");
+  }
+  for (const auto& placement : entry->stateful_placements()) {
+    auto iter = stateful_placements_.find(placement.first);
+    if (iter != stateful_placements_.end() &&
+        iter->second != placement.second) {
+      return errors::InvalidArgument(
+          "Stateful placement mismatch. Current assignment of ",
+          placement.first, " to ", iter->second, " does not match ",
+          placement.second);
+    }
+  }
+
+  auto cached_flib_def = std::make_unique<FunctionLibraryDefinition>(
+      OpRegistry::Global(), entry->library());
+  std::unordered_map<string, std::unique_ptr<Graph>> graphs;
+  for (auto& partition : *entry->mutable_partitions()) {
+    Device* d;
+    TF_RETURN_IF_ERROR(device_mgr_->LookupDevice(partition.first, &d));
+    auto device_graph = std::make_unique<Graph>(cached_flib_def.get());
+    device_graph->SetConstructionContext(ConstructionContext::kDirectSession);
+    GraphConstructorOptions device_opts;
+    device_opts.allow_internal_ops = true;
+    device_opts.expect_device_spec = true;
+    TF_RETURN_IF_ERROR(ConvertGraphDefToGraph(
+        device_opts, std::move(partition.second), device_graph.get()));
+    graphs.emplace(partition.first, std::move(device_graph));
+  }
+
+  VLOG(1) << "Loaded " << graphs.size()
+          << " partitioned graphs from the partitioned graph cache entry "
+          << partitioned_graph_cache_->GetFilePath(entry->key());
+  for (const auto& placement : entry->stateful_placements()) {
+    stateful_placements_.emplace(placement.first, placement.second);
+  }
+  *outputs = std::move(graphs);
+  *flib_def = std::move(cached_flib_def);
+  input_types->clear();
+  for (int dtype : entry->feed_types()) {
+    input_types->push_back(static_cast<DataType>(dtype));
+  }
+  output_types->clear();
+  for (int dtype : entry->fetch_types()) {
+    output_types->push_back(static_cast<DataType>(dtype));
+  }
+  *collective_graph_key = entry->collective_graph_key();
+  return OkStatus();
+}
+
 ::tensorflow::Status DirectSession::ListDevices(
     std::vector<DeviceAttributes>* response) {
   response->clear();
@@ -29,6 +29,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/device_set.h"
 #include "tensorflow/core/common_runtime/executor.h"
 #include "tensorflow/core/common_runtime/graph_execution_state.h"
+#include "tensorflow/core/common_runtime/partitioned_graph_cache.h"
 #include "tensorflow/core/common_runtime/process_function_library_runtime.h"
 #include "tensorflow/core/common_runtime/rendezvous_mgr.h"
 #include "tensorflow/core/common_runtime/session_factory.h"
@@ -263,6 +264,16 @@ class DirectSession : public Session {
       RunStateArgs* run_state_args, DataTypeVector* input_types,
       DataTypeVector* output_types, int64_t* collective_graph_key);
 
+  // Creates the graphs of `options` from `entry` of the partitioned graph
+  // cache. Leaves the outputs unchanged on error.
+  ::tensorflow::Status CreateGraphsFromCacheEntry(
+      const BuildGraphOptions& options, PartitionedGraphCacheEntry* entry,
+      std::unordered_map<string, std::unique_ptr<Graph>>* outputs,
+      std::unique_ptr<FunctionLibraryDefinition>* flib_def,
+      DataTypeVector* input_types, DataTypeVector* output_types,
+      int64_t* collective_graph_key)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(graph_state_lock_);
+
   ::tensorflow::Status RunInternal(
       int64_t step_id, const RunOptions& run_options,
       CallFrameInterface* call_frame, ExecutorsAndKeys* executors_and_keys,
@@ -405,6 +416,14 @@ class DirectSession : public Session {
   // library; it copies and modifies the function library.
   std::unique_ptr<FunctionLibraryDefinition> flib_def_;
 
+  // Saves and loads the graphs created by CreateGraphs(), if the session
+  // config sets a partitioned graph cache directory.
+  std::unique_ptr<PartitionedGraphCache> partitioned_graph_cache_;
+
+  // Fingerprint of the graphs that the session was created and extended with.
+  // Only computed if `partitioned_graph_cache_` is set.
+  uint64 graph_fingerprint_ TF_GUARDED_BY(graph_state_lock_) = 0;
+
   // true if the Session has been Closed.
   mutex closed_lock_;
   bool closed_ TF_GUARDED_BY(closed_lock_) = false;
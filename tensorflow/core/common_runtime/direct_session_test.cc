@@ -44,6 +44,7 @@ limitations under the License.
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/platform/path.h"
 #include "tensorflow/core/platform/protobuf.h"
 #include "tensorflow/core/platform/stacktrace.h"
 #include "tensorflow/core/platform/test.h"
@@ -226,6 +227,69 @@ TEST_F(DirectSessionMinusAXTest, RunSimpleNetwork_OptimizeForStaticGraph) {
   EXPECT_TRUE(absl::StrContains(s.message(), "optimize_for_static_graph"));
 }
 
+TEST_F(DirectSessionMinusAXTest, RunSimpleNetwork_StaticMemoryPlan) {
+  Initialize({3, 2, -1, 0});
+  SessionOptions options(DefaultSessionOptions());
+  options.config.mutable_experimental()->set_static_memory_plan_warmup_runs(2);
+  auto session = absl::WrapUnique(NewSession(options));
+  ASSERT_TRUE(session != nullptr);
+  TF_ASSERT_OK(session->Create(def_));
+
+  Session::CallableHandle handle;
+  TF_ASSERT_OK(session->MakeCallable(
+      MakeCallableOptions({x_ + ":0"}, {z_ + ":0"}, {}), &handle));
+  // Record the allocations of the first runs, replay them, and fall back when
+  // the shape of the feed changes.
+  for (int num_columns : {1, 1, 1, 1, 3, 3, 3, 3}) {
+    Tensor x(DT_FLOAT, TensorShape({2, num_columns}));
+    test::FillFn<float>(&x, [](int i) { return i % 2 + 1; });
+    std::vector<Tensor> outputs;
+    TF_ASSERT_OK(session->RunCallable(handle, {x}, &outputs, nullptr));
+    ASSERT_EQ(1, outputs.size());
+    ASSERT_EQ(TensorShape({2, num_columns}), outputs[0].shape());
+    auto mat = outputs[0].matrix<float>();
+    for (int j = 0; j < num_columns; ++j) {
+      const float x0 = x.matrix<float>()(0, j);
+      const float x1 = x.matrix<float>()(1, j);
+      EXPECT_FLOAT_EQ(-(3 * x0 + 2 * x1), mat(0, j));
+      EXPECT_FLOAT_EQ(x0, mat(1, j));
+    }
+  }
+  TF_ASSERT_OK(session->ReleaseCallable(handle));
+}
+
+TEST_F(DirectSessionMinusAXTest, RunSimpleNetwork_PartitionedGraphCache) {
+  Initialize({3, 2, -1, 0});
+  const string cache_directory =
+      io::JoinPath(testing::TmpDir(), "partitioned_graph_cache");
+  SessionOptions options(DefaultSessionOptions());
+  options.config.mutable_experimental()->set_partitioned_graph_cache_directory(
+      cache_directory);
+
+  // The first session saves the graphs of its callables, and the second
+  // session loads them.
+  for (int i = 0; i < 2; ++i) {
+    auto session = absl::WrapUnique(NewSession(options));
+    ASSERT_TRUE(session != nullptr);
+    TF_ASSERT_OK(session->Create(def_));
+
+    Tensor x(DT_FLOAT, TensorShape({2, 1}));
+    test::FillValues<float>(&x, {1, 1});
+    std::vector<Tensor> outputs;
+    TF_ASSERT_OK(session->Run({{x_, x}}, {y_ + ":0", z_ + ":0"}, {}, &outputs));
+    ASSERT_EQ(2, outputs.size());
+    EXPECT_FLOAT_EQ(5.0, outputs[0].matrix<float>()(0, 0));
+    EXPECT_FLOAT_EQ(-5.0, outputs[1].matrix<float>()(0, 0));
+    TF_ASSERT_OK(session->Run({}, {y_ + ":0"}, {}, &outputs));
+    ASSERT_EQ(1, outputs.size());
+    EXPECT_FLOAT_EQ(5.0, outputs[0].matrix<float>()(0, 0));
+
+    std::vector<string> entries;
+    TF_ASSERT_OK(Env::Default()->GetChildren(cache_directory, &entries));
+    EXPECT_EQ(2, entries.size());
+  }
+}
+
 TEST_F(DirectSessionMinusAXTest,
        RunSimpleNetwork_DisableOutputPartitionGraphs) {
   Initialize({3, 2, -1, 0});
@@ -30,11 +30,15 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/executor_factory.h"
 #include "tensorflow/core/common_runtime/graph_view.h"
 #include "tensorflow/core/common_runtime/immutable_executor_state.h"
+#include "tensorflow/core/common_runtime/kernel_dispatch_policy.h"
 #include "tensorflow/core/common_runtime/pending_counts.h"
 #include "tensorflow/core/common_runtime/propagator_state.h"
 #include "tensorflow/core/common_runtime/renamed_device.h"
 #include "tensorflow/core/common_runtime/simple_propagator_state.h"
+#include "tensorflow/core/common_runtime/static_memory_plan.h"
+#include "tensorflow/core/common_runtime/step_arena_allocator.h"
 #include "tensorflow/core/common_runtime/step_stats_collector.h"
+#include "tensorflow/core/common_runtime/work_stealing_scheduler.h"
 #include "tensorflow/core/framework/allocator.h"
 #include "tensorflow/core/framework/cancellation.h"
 #include "tensorflow/core/framework/collective.h"
@@ -47,6 +51,7 @@ limitations under the License.
 #include "tensorflow/core/framework/op_segment.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_reference.h"
+#include "tensorflow/core/framework/tensor_util.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/framework/types.pb.h"
 #include "tensorflow/core/graph/edgeset.h"
@@ -61,13 +66,16 @@ limitations under the License.
 #include "tensorflow/core/lib/gtl/manual_constructor.h"
 #include "tensorflow/core/lib/hash/hash.h"
 #include "tensorflow/core/platform/context.h"
+#include "tensorflow/core/platform/cpu_info.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/errors.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/macros.h"
 #include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/numa.h"
 #include "tensorflow/core/platform/profile_utils/cpu_utils.h"
 #include "tensorflow/core/platform/status.h"
+#include "tensorflow/core/platform/strcat.h"
 #include "tensorflow/core/platform/thread_annotations.h"
 #include "tensorflow/core/platform/tracing.h"
 #include "tensorflow/core/platform/types.h"
@@ -78,6 +86,7 @@ limitations under the License.
 #include "tensorflow/core/profiler/lib/traceme_encode.h"
 #include "tensorflow/core/protobuf/error_codes.pb.h"
 #include "tensorflow/core/util/determinism.h"
+#include "tensorflow/core/util/env_var.h"
 #include "tensorflow/core/util/managed_stack_trace.h"
 #include "tensorflow/core/util/tensor_slice_reader_cache.h"
 
@@ -139,17 +148,111 @@ struct KernelTimer {
   }
 };
 
+// Returns true if executors that were not given a `create_dispatch_policy`
+// function should use a `CostModelDispatchPolicy`.
+bool UseCostModelDispatch() {
+  static const bool use_cost_model_dispatch = [] {
+    bool value = false;
+    TF_CHECK_OK(ReadBoolFromEnvVar("TF_EXECUTOR_USE_COST_MODEL_DISPATCH",
+                                   /*default_val=*/false, &value));
+    return value;
+  }();
+  return use_cost_model_dispatch;
+}
+
+// Returns the options for the schedulers used by the "WORK_STEALING" executor.
+const WorkStealingScheduler::Options& WorkStealingOptions() {
+  static const WorkStealingScheduler::Options* options = [] {
+    auto* options = new WorkStealingScheduler::Options;
+    int64_t num_workers = 0;
+    TF_CHECK_OK(ReadInt64FromEnvVar("TF_WORK_STEALING_EXECUTOR_NUM_WORKERS",
+                                    /*default_val=*/0, &num_workers));
+    options->num_workers = static_cast<int>(num_workers);
+    if (port::NUMAEnabled()) {
+      // One process-wide pool per NUMA node, whose threads are bound to that
+      // node. The workers of the slots assigned to a node run on its pool, so
+      // that stealing from node-local slots first keeps work on the node.
+      for (int node = 0; node < port::NUMANumNodes(); ++node) {
+        ThreadOptions thread_options;
+        thread_options.numa_node = node;
+        auto* pool = new thread::ThreadPool(
+            Env::Default(), thread_options,
+            strings::StrCat("work_stealing_numa_", node),
+            std::max(1, port::MaxParallelism(node)));
+        options->numa_node_runners.push_back([pool](std::function<void()> fn) {
+          pool->Schedule(std::move(fn));
+        });
+      }
+    }
+    return options;
+  }();
+  return *options;
+}
+
+// Returns true if a node that may keep its inputs beyond the step, or hand
+// them out of the executor, is `n`: stateful kernels (e.g. enqueue or variable
+// assignment ops) and sends and retvals (e.g. fetches).
+bool MayKeepInputs(const Node* n) {
+  return n->op_def().is_stateful() || n->IsSend() || n->IsRetval();
+}
+
+// Returns true if the outputs of `n` are expected to die within the step,
+// i.e. neither `n` nor any of their direct consumers may keep them. Outputs
+// that reach such a consumer through an aliasing op (e.g. Identity) are copied
+// out of step memory by the executor before that consumer runs.
+bool OutputsDieInStep(const Node* n) {
+  if (MayKeepInputs(n)) return false;
+  for (const Edge* e : n->out_edges()) {
+    if (!e->IsControlEdge() && MayKeepInputs(e->dst())) return false;
+  }
+  return true;
+}
+
 // TODO(b/152925936): Re-evaluate these constants with current usage patterns.
 typedef gtl::InlinedVector<TensorValue, 4> TensorValueVec;
 typedef gtl::InlinedVector<AllocatorAttributes, 4> AllocatorAttributeVec;
 
 class ExecutorImpl : public Executor {
  public:
-  explicit ExecutorImpl(const LocalExecutorParams& p) : immutable_state_(p) {}
+  explicit ExecutorImpl(const LocalExecutorParams& p,
+                        bool use_work_stealing = false)
+      : immutable_state_(p) {
+    if (use_work_stealing) {
+      work_stealing_schedulers_ =
+          std::make_unique<WorkStealingSchedulerPool>(WorkStealingOptions());
+    }
+  }
 
   Status Initialize(const Graph& graph) {
     TF_RETURN_IF_ERROR(immutable_state_.Initialize(graph));
     kernel_stats_.Initialize(immutable_state_.graph_view());
+    if (immutable_state_.params().create_dispatch_policy) {
+      dispatch_policy_ = immutable_state_.params().create_dispatch_policy();
+    } else if (UseCostModelDispatch()) {
+      dispatch_policy_ = std::make_unique<CostModelDispatchPolicy>();
+    }
+    if (dispatch_policy_) {
+      dispatch_policy_->Initialize(immutable_state_.graph_view());
+    }
+    const LocalExecutorParams& params = immutable_state_.params();
+    if ((params.static_memory_plan_warmup_runs > 0 ||
+         params.use_step_arena_allocator) &&
+        params.device->device_type() == DEVICE_CPU) {
+      Allocator* base = params.device->GetAllocator(AllocatorAttributes());
+      step_memory_ = std::make_unique<StepMemory>();
+      if (params.static_memory_plan_warmup_runs > 0) {
+        StaticMemoryPlan::Options options;
+        options.warmup_runs = params.static_memory_plan_warmup_runs;
+        step_memory_->plan = std::make_unique<StaticMemoryPlan>(
+            base, graph.num_node_ids(), options);
+      } else {
+        step_memory_->arena_pool = std::make_unique<StepArenaPool>(base);
+      }
+      step_memory_->uses_step_allocator.resize(graph.num_node_ids(), false);
+      for (const Node* n : graph.nodes()) {
+        step_memory_->uses_step_allocator[n->id()] = OutputsDieInStep(n);
+      }
+    }
     return OkStatus();
   }
 
@@ -221,8 +324,28 @@ class ExecutorImpl : public Executor {
     std::unique_ptr<std::atomic_uint_fast64_t[]> cost_estimates_;
   };
 
+  // Serves the allocations of the nodes in `uses_step_allocator` from memory
+  // that is reused across steps. Exactly one of `plan` and `arena_pool` is set.
+  struct StepMemory {
+    std::unique_ptr<StaticMemoryPlan> plan;
+    std::unique_ptr<StepArenaPool> arena_pool;
+    // Indexed by node id.
+    std::vector<bool> uses_step_allocator;
+  };
+
   ImmutableExecutorState immutable_state_;
   KernelStats kernel_stats_;
+  // If not null, decides whether ready nodes are run inline, batched, or
+  // dispatched, instead of `kernel_stats_`.
+  std::unique_ptr<KernelDispatchPolicy> dispatch_policy_;
+  // If not null, each step dispatches its ready nodes through a
+  // `WorkStealingScheduler` from this pool instead of calling the step's runner
+  // directly.
+  std::unique_ptr<WorkStealingSchedulerPool> work_stealing_schedulers_;
+  // Not null iff the executor runs on a CPU device, and
+  // `LocalExecutorParams::static_memory_plan_warmup_runs` is positive or
+  // `LocalExecutorParams::use_step_arena_allocator` is true.
+  std::unique_ptr<StepMemory> step_memory_;
 
   TF_DISALLOW_COPY_AND_ASSIGN(ExecutorImpl);
 };
@@ -281,7 +404,10 @@ class ExecutorState {
  public:
   ExecutorState(const Executor::Args& args,
                 const ImmutableExecutorState& immutable_state_,
-                ExecutorImpl::KernelStats* kernel_stats_);
+                ExecutorImpl::KernelStats* kernel_stats_,
+                KernelDispatchPolicy* dispatch_policy,
+                WorkStealingSchedulerPool* work_stealing_schedulers,
+                ExecutorImpl::StepMemory* step_memory);
   ~ExecutorState();
 
   void RunAsync(Executor::DoneCallback done);
@@ -312,6 +438,10 @@ class ExecutorState {
                           NodeExecStatsInterface* stats);
 
   // Before invoking item->kernel, fills in its "inputs".
+  // If `entry` holds a tensor in the slab of `step_arena_allocator_`,
+  // replaces it with a copy in the device's memory.
+  void CopyOutOfStepArena(Entry* entry);
+
   Status PrepareInputs(const NodeItem& item, Entry* first_input,
                        TensorValueVec* inputs,
                        AllocatorAttributeVec* input_alloc_attrs,
@@ -337,6 +467,19 @@ class ExecutorState {
   // REQUIRES: `!ready->empty()`.
   void ScheduleReady(TaggedNodeSeq* ready, TaggedNodeReadyQueue* inline_ready);
 
+  // Implementation of `ScheduleReady()` when `dispatch_policy_` is set. Runs
+  // the nodes that the policy marks as inline on the current thread (if
+  // `inline_ready` is not null), groups the nodes it marks as batch into
+  // shared closures, and dispatches the rest.
+  void ScheduleReadyWithPolicy(TaggedNodeSeq* ready,
+                               TaggedNodeReadyQueue* inline_ready,
+                               int64_t scheduled_nsec);
+
+  // Runs each of `nodes` in its own closure, fanning out from child closures
+  // if there are many of them.
+  void DispatchExpensiveNodes(const TaggedNodeSeq& nodes,
+                              int64_t scheduled_nsec);
+
   // A wrapper for runner_ to keep track of the pending queue length. Op
   // execution should dispatch work using this function instead of using runner_
   // directly.
@@ -386,12 +529,24 @@ class ExecutorState {
   CallFrameInterface* call_frame_;
   const ImmutableExecutorState& immutable_state_;
   ExecutorImpl::KernelStats* const kernel_stats_;
+  KernelDispatchPolicy* const dispatch_policy_;  // Not owned. May be null.
+  // Not owned. May be null.
+  const ExecutorImpl::StepMemory* const step_memory_;
+  // Acquired from `step_memory_` for this step, and released on destruction.
+  // At most one of them is set.
+  StaticMemoryPlan::Step* memory_plan_step_ = nullptr;
+  StepArenaAllocator* step_arena_allocator_ = nullptr;
   CancellationManager* cancellation_manager_;
   tsl::CoordinationServiceAgent* coordination_service_agent_;
   absl::optional<ManagedStackTrace> stack_trace_ = absl::nullopt;
   // If not null, use this device to schedule intra-op operation
   std::unique_ptr<DeviceBase> user_device_;
   Executor::Args::Runner runner_;
+  // If not null, closures passed to `RunTask()` are dispatched through this
+  // scheduler, which in turn runs its workers on `runner_`. It is acquired
+  // from, and returned to, `work_stealing_schedulers_`.
+  WorkStealingSchedulerPool* const work_stealing_schedulers_;
+  std::shared_ptr<WorkStealingScheduler> work_stealing_scheduler_;
   bool sync_on_finish_;
   const bool run_all_kernels_inline_;
 
@@ -402,6 +557,13 @@ class ExecutorState {
 
   std::atomic_int_fast32_t num_outstanding_ops_;
 
+  // Number of nodes that `dispatch_policy_` ran inline, in a batched closure
+  // or in their own closure, and the number of batched closures.
+  std::atomic<int64_t> num_inlined_nodes_{0};
+  std::atomic<int64_t> num_batched_nodes_{0};
+  std::atomic<int64_t> num_batch_closures_{0};
+  std::atomic<int64_t> num_dispatched_nodes_{0};
+
   // Available via OpKernelContext to every OpKernel invocation.
   mutex num_deferred_ops_mu_;
   int64_t num_deferred_ops_ TF_GUARDED_BY(num_deferred_ops_mu_) = 0;
@@ -415,7 +577,10 @@ class ExecutorState {
 template <class PropagatorStateType>
 ExecutorState<PropagatorStateType>::ExecutorState(
     const Executor::Args& args, const ImmutableExecutorState& immutable_state,
-    ExecutorImpl::KernelStats* kernel_stats)
+    ExecutorImpl::KernelStats* kernel_stats,
+    KernelDispatchPolicy* dispatch_policy,
+    WorkStealingSchedulerPool* work_stealing_schedulers,
+    ExecutorImpl::StepMemory* step_memory)
     : vlog_(VLOG_IS_ON(1)),
       log_memory_(LogMemory::IsEnabled()),
       step_id_(args.step_id),
@@ -437,10 +602,13 @@ ExecutorState<PropagatorStateType>::ExecutorState(
       call_frame_(args.call_frame),
       immutable_state_(immutable_state),
       kernel_stats_(kernel_stats),
+      dispatch_policy_(dispatch_policy),
+      step_memory_(step_memory),
       cancellation_manager_(args.cancellation_manager),
       coordination_service_agent_(args.coordination_service_agent),
       stack_trace_(args.stack_trace),
       runner_(args.runner),
+      work_stealing_schedulers_(work_stealing_schedulers),
       sync_on_finish_(args.sync_on_finish),
       run_all_kernels_inline_(args.run_all_kernels_inline),
       propagator_(immutable_state, step_id_, vlog_),
@@ -450,6 +618,16 @@ ExecutorState<PropagatorStateType>::ExecutorState(
     user_device_ = RenamedDevice::NewRenamedDevice(
         device->name(), device, false, false, args.user_intra_op_threadpool);
   }
+  if (work_stealing_schedulers_ != nullptr && !run_all_kernels_inline_) {
+    work_stealing_scheduler_ = work_stealing_schedulers_->Acquire(runner_);
+  }
+  if (step_memory != nullptr) {
+    if (step_memory->plan != nullptr) {
+      memory_plan_step_ = step_memory->plan->StartStep();
+    } else {
+      step_arena_allocator_ = step_memory->arena_pool->Acquire();
+    }
+  }
 }
 
 template <class PropagatorStateType>
@@ -458,6 +636,15 @@ ExecutorState<PropagatorStateType>::~ExecutorState() {
     device_context_->Unref();
   }
   delete slice_reader_cache_;
+  if (work_stealing_scheduler_ != nullptr) {
+    work_stealing_schedulers_->Release(std::move(work_stealing_scheduler_));
+  }
+  if (memory_plan_step_ != nullptr) {
+    memory_plan_step_->Release();
+  }
+  if (step_arena_allocator_ != nullptr) {
+    step_arena_allocator_->Release();
+  }
 }
 
 template <class PropagatorStateType>
@@ -476,6 +663,15 @@ void ExecutorState<PropagatorStateType>::RunTask(Closure&& c, int sample_rate) {
     metrics::UpdateGraphPendingQueueLength(n_enqueues - n_dequeues);
   }
 
+  if (work_stealing_scheduler_) {
+    work_stealing_scheduler_->Schedule(
+        [c = std::forward<Closure>(c)]() mutable {
+          num_dequeue_ops.fetch_add(1, std::memory_order_relaxed);
+          std::forward<Closure>(c)();
+        });
+    return;
+  }
+
   // mutable is needed because std::forward<Closure> in the lambda body may move
   // the Closure `c`.
   runner_([c = std::forward<Closure>(c)]() mutable {
@@ -598,16 +794,24 @@ Status ExecutorState<PropagatorStateType>::ProcessSync(
         },
         profiler::GetTFTraceMeLevel(is_expensive));
     device->Compute(op_kernel, &ctx);
-  } else if (kernel_stats_->HasExpensiveMarker(item)) {
+  } else if (dispatch_policy_ != nullptr ||
+             kernel_stats_->HasExpensiveMarker(item)) {
     KernelTimer timer;
     device->Compute(op_kernel, &ctx);
+    const uint64 elapsed_cycles = timer.ElapsedCycles();
     // For expensive kernels, always update the cost estimate. For inexpensive
     // kernels, update the cost estimate with ~1/16 probability. This assumes
     // that the last 4 bits of the CPU cycle count is uniformly distributed.
     constexpr int kKernelExecutionTrackingInvocationSkipCount = 16;
-    if (is_expensive ||
-        timer.start_cycles % kKernelExecutionTrackingInvocationSkipCount == 0) {
-      kernel_stats_->UpdateCostEstimate(item, timer.ElapsedCycles());
+    if (kernel_stats_->HasExpensiveMarker(item) &&
+        (is_expensive ||
+         timer.start_cycles % kKernelExecutionTrackingInvocationSkipCount ==
+             0)) {
+      kernel_stats_->UpdateCostEstimate(item, elapsed_cycles);
+    }
+    if (dispatch_policy_ != nullptr) {
+      dispatch_policy_->RecordExecution(item, timer.start_cycles,
+                                        elapsed_cycles);
     }
   } else {
     device->Compute(op_kernel, &ctx);
@@ -883,6 +1087,15 @@ void ExecutorState<PropagatorStateType>::ProcessInline(
       params.outputs_required_array = item.outputs_required.get();
       params.inputs = inputs;
       params.input_alloc_attrs = input_alloc_attrs;
+      if (step_memory_ != nullptr) {
+        if (!step_memory_->uses_step_allocator[id]) {
+          params.step_allocator = nullptr;
+        } else if (memory_plan_step_ != nullptr) {
+          params.step_allocator = memory_plan_step_->allocator(id);
+        } else {
+          params.step_allocator = step_arena_allocator_;
+        }
+      }
 
       if (item.kernel_is_async) {
         ProcessAsync(item, params, tagged_node, first_input, stats,
@@ -931,6 +1144,15 @@ void ExecutorState<PropagatorStateType>::ProcessInline(
   if (completed) ScheduleFinish();
 }
 
+template <class PropagatorStateType>
+void ExecutorState<PropagatorStateType>::CopyOutOfStepArena(Entry* entry) {
+  Tensor* tensor = entry->val.get();
+  if (tensor->IsInitialized() && tensor->NumElements() > 0 &&
+      step_arena_allocator_->Owns(tensor->data())) {
+    *tensor = tensor::DeepCopy(*tensor);
+  }
+}
+
 template <class PropagatorStateType>
 Status ExecutorState<PropagatorStateType>::PrepareInputs(
     const NodeItem& item, Entry* first_input, TensorValueVec* inputs,
@@ -976,6 +1198,12 @@ Status ExecutorState<PropagatorStateType>::PrepareInputs(
               errors::InvalidArgument(i, "-th input expects a ref type"),
               item.kernel->def());
         }
+        // A node that does not use the arena may keep its inputs beyond the
+        // step, which would pin the whole slab.
+        if (step_arena_allocator_ != nullptr &&
+            !step_memory_->uses_step_allocator[item.node_id]) {
+          CopyOutOfStepArena(entry);
+        }
         inp->mutex_if_ref = nullptr;
         inp->tensor = entry->val.get();
         break;
@@ -1253,7 +1481,9 @@ void ExecutorState<PropagatorStateType>::ScheduleReady(
     scheduled_nsec = nodestats::NowInNsec();
   }
 
-  if (run_all_kernels_inline_) {
+  if (dispatch_policy_ != nullptr && !run_all_kernels_inline_) {
+    ScheduleReadyWithPolicy(ready, inline_ready, scheduled_nsec);
+  } else if (run_all_kernels_inline_) {
     if (inline_ready == nullptr) {
       // Schedule all ready kernels from a single closure. This ensure that,
       // regardless of the `runner_` implementation, all kernels will run
@@ -1302,48 +1532,142 @@ void ExecutorState<PropagatorStateType>::ScheduleReady(
       }
     }
     if (!expensive_nodes.empty()) {
-      if (expensive_nodes.size() < kInlineScheduleReadyThreshold) {
-        for (auto& tagged_node : expensive_nodes) {
+      DispatchExpensiveNodes(expensive_nodes, scheduled_nsec);
+    }
+  }
+  ready->clear();
+}
+
+template <class PropagatorStateType>
+void ExecutorState<PropagatorStateType>::DispatchExpensiveNodes(
+    const TaggedNodeSeq& expensive_nodes, int64_t scheduled_nsec) {
+  if (expensive_nodes.size() < kInlineScheduleReadyThreshold) {
+    for (auto& tagged_node : expensive_nodes) {
+      RunTask(std::bind(&ExecutorState::Process, this, tagged_node,
+                        scheduled_nsec),
+              /*sample_rate=*/expensive_nodes.size());
+    }
+  } else {
+    // There are too many ready expensive nodes. Schedule them in child
+    // threads.
+    // TODO(fishx): Apply the same optimization to cheap ops as well since
+    // executing lots of cheap ops in one thread can potentially be the
+    // bottleneck as well.
+    auto it = expensive_nodes.begin();
+    while (it < expensive_nodes.end()) {
+      auto end = it;
+      std::advance(end, kInlineScheduleReadyThreshold);
+      if (end > expensive_nodes.end()) {
+        end = expensive_nodes.end();
+      }
+      TaggedNodeSeq ready_chunk{it, end};
+      RunTask([this, ready_chunk = std::move(ready_chunk), scheduled_nsec]() {
+        profiler::TraceMe activity(
+            [&]() {
+              return strings::StrCat(
+                  "ExecutorState::ScheduleReady::"
+                  "ChildThreadExpensiveNodes#",
+                  "ready_chunk_size=", ready_chunk.size(), "#");
+            },
+            profiler::GetTFTraceMeLevel(/*is_expensive=*/false));
+        for (auto& tagged_node : ready_chunk) {
           RunTask(std::bind(&ExecutorState::Process, this, tagged_node,
                             scheduled_nsec),
-                  /*sample_rate=*/expensive_nodes.size());
+                  /*sample_rate=*/ready_chunk.size());
         }
-      } else {
-        // There are too many ready expensive nodes. Schedule them in child
-        // threads.
-        // TODO(fishx): Apply the same optimization to cheap ops as well since
-        // executing lots of cheap ops in one thread can potentially be the
-        // bottleneck as well.
-        auto it = expensive_nodes.begin();
-        while (it < expensive_nodes.end()) {
-          auto end = it;
-          std::advance(end, kInlineScheduleReadyThreshold);
-          if (end > expensive_nodes.end()) {
-            end = expensive_nodes.end();
-          }
-          TaggedNodeSeq ready_chunk{it, end};
-          RunTask(
-              [this, ready_chunk = std::move(ready_chunk), scheduled_nsec]() {
-                profiler::TraceMe activity(
-                    [&]() {
-                      return strings::StrCat(
-                          "ExecutorState::ScheduleReady::"
-                          "ChildThreadExpensiveNodes#",
-                          "ready_chunk_size=", ready_chunk.size(), "#");
-                    },
-                    profiler::GetTFTraceMeLevel(/*is_expensive=*/false));
-                for (auto& tagged_node : ready_chunk) {
-                  RunTask(std::bind(&ExecutorState::Process, this, tagged_node,
-                                    scheduled_nsec),
-                          /*sample_rate=*/ready_chunk.size());
-                }
-              });
-          it = end;
+      });
+      it = end;
+    }
+  }
+}
+
+template <class PropagatorStateType>
+void ExecutorState<PropagatorStateType>::ScheduleReadyWithPolicy(
+    TaggedNodeSeq* ready, TaggedNodeReadyQueue* inline_ready,
+    int64_t scheduled_nsec) {
+  const uint64 batch_budget_cycles = dispatch_policy_->BatchBudgetCycles();
+  int64_t num_inlined = 0;
+  int64_t num_batched = 0;
+  int64_t num_batch_closures = 0;
+
+  TaggedNodeSeq batch;
+  uint64 batch_cycles = 0;
+  auto run_batch = [this, &batch, &batch_cycles, &num_batch_closures,
+                    scheduled_nsec]() {
+    if (batch.size() == 1) {
+      RunTask(std::bind(&ExecutorState::Process, this, batch.front(),
+                        scheduled_nsec));
+    } else {
+      RunTask([this, batch = std::move(batch), scheduled_nsec]() {
+        TaggedNodeReadyQueue batch_ready;
+        for (auto& tagged_node : batch) {
+          batch_ready.push_back(tagged_node);
         }
+        ProcessInline(&batch_ready, scheduled_nsec);
+      });
+    }
+    ++num_batch_closures;
+    batch.clear();
+    batch_cycles = 0;
+  };
+
+  TaggedNodeSeq dispatched_nodes;
+  for (auto& tagged_node : *ready) {
+    const NodeItem& item = *tagged_node.node_item;
+    KernelDispatchPolicy::Decision decision =
+        tagged_node.get_is_dead() ? KernelDispatchPolicy::Decision::kInline
+                                  : dispatch_policy_->Decide(item);
+    // Without a thread to inline onto, run inexpensive nodes in batches.
+    if (inline_ready == nullptr &&
+        decision == KernelDispatchPolicy::Decision::kInline) {
+      decision = KernelDispatchPolicy::Decision::kBatch;
+    }
+    switch (decision) {
+      case KernelDispatchPolicy::Decision::kInline:
+        inline_ready->push_back(tagged_node);
+        ++num_inlined;
+        break;
+      case KernelDispatchPolicy::Decision::kBatch:
+        batch.push_back(tagged_node);
+        ++num_batched;
+        // Count every node as at least one cycle, so that a batch of nodes
+        // that have not been measured yet still has a bounded size.
+        batch_cycles +=
+            std::max<uint64>(1, dispatch_policy_->EstimatedCycles(item));
+        if (batch_cycles >= batch_budget_cycles) run_batch();
+        break;
+      case KernelDispatchPolicy::Decision::kDispatch:
+        dispatched_nodes.push_back(tagged_node);
+        break;
+    }
+  }
+
+  // Keep the current thread busy: prefer running the last (partial) batch
+  // inline, otherwise keep one of the dispatched nodes.
+  if (inline_ready != nullptr && inline_ready->empty()) {
+    if (!batch.empty()) {
+      for (auto& tagged_node : batch) {
+        inline_ready->push_back(tagged_node);
       }
+      num_inlined += batch.size();
+      num_batched -= batch.size();
+      batch.clear();
+    } else if (!dispatched_nodes.empty()) {
+      inline_ready->push_back(dispatched_nodes.back());
+      dispatched_nodes.pop_back();
+      ++num_inlined;
     }
   }
-  ready->clear();
+  if (!batch.empty()) run_batch();
+  if (!dispatched_nodes.empty()) {
+    DispatchExpensiveNodes(dispatched_nodes, scheduled_nsec);
+  }
+
+  num_inlined_nodes_.fetch_add(num_inlined, std::memory_order_relaxed);
+  num_batched_nodes_.fetch_add(num_batched, std::memory_order_relaxed);
+  num_batch_closures_.fetch_add(num_batch_closures, std::memory_order_relaxed);
+  num_dispatched_nodes_.fetch_add(dispatched_nodes.size(),
+                                  std::memory_order_relaxed);
 }
 
 template <class PropagatorStateType>
@@ -1378,6 +1702,14 @@ void ExecutorState<PropagatorStateType>::Finish() {
   CHECK(done_cb != nullptr);
   Device* device = immutable_state_.params().device;
 
+  if (dispatch_policy_ != nullptr) {
+    metrics::RecordExecutorDispatchDecisions(
+        num_inlined_nodes_.load(std::memory_order_relaxed),
+        num_batched_nodes_.load(std::memory_order_relaxed),
+        num_batch_closures_.load(std::memory_order_relaxed),
+        num_dispatched_nodes_.load(std::memory_order_relaxed));
+  }
+
   if (vlog_ && !status.ok() && VLOG_IS_ON(1)) {
     // Logs verbose information about the current state of active and pending
     // nodes in the propagator.
@@ -1484,15 +1816,19 @@ void ExecutorState<PropagatorStateType>::Finish() {
 
 void ExecutorImpl::RunAsync(const Args& args, DoneCallback done) {
   if (OpOrderDeterminismRequired()) {
-    (new ExecutorState<OrderedPropagatorState>(args, immutable_state_,
-                                               &kernel_stats_))
+    (new ExecutorState<OrderedPropagatorState>(
+         args, immutable_state_, &kernel_stats_, dispatch_policy_.get(),
+         work_stealing_schedulers_.get(), step_memory_.get()))
         ->RunAsync(std::move(done));
   } else if (immutable_state_.requires_control_flow_support()) {
-    (new ExecutorState<PropagatorState>(args, immutable_state_, &kernel_stats_))
+    (new ExecutorState<PropagatorState>(
+         args, immutable_state_, &kernel_stats_, dispatch_policy_.get(),
+         work_stealing_schedulers_.get(), step_memory_.get()))
         ->RunAsync(std::move(done));
   } else {
-    (new ExecutorState<SimplePropagatorState>(args, immutable_state_,
-                                              &kernel_stats_))
+    (new ExecutorState<SimplePropagatorState>(
+         args, immutable_state_, &kernel_stats_, dispatch_policy_.get(),
+         work_stealing_schedulers_.get(), step_memory_.get()))
         ->RunAsync(std::move(done));
   }
 }
@@ -1546,6 +1882,32 @@ class DefaultExecutorRegistrar {
 };
 static DefaultExecutorRegistrar registrar;
 
+// Registers a variant of the default executor that dispatches ready nodes
+// through a `WorkStealingScheduler`, reused across steps. The number of
+// workers defaults to `port::MaxParallelism()` and can be overridden with the
+// TF_WORK_STEALING_EXECUTOR_NUM_WORKERS environment variable. On hosts with
+// more than one NUMA node, the workers run on per-node thread pools instead
+// of the step's runner.
+class WorkStealingExecutorRegistrar {
+ public:
+  WorkStealingExecutorRegistrar() {
+    ExecutorFactory::Register("WORK_STEALING", new Factory);
+  }
+
+ private:
+  class Factory : public ExecutorFactory {
+    Status NewExecutor(const LocalExecutorParams& params, const Graph& graph,
+                       std::unique_ptr<Executor>* out_executor) override {
+      auto impl =
+          std::make_unique<ExecutorImpl>(params, /*use_work_stealing=*/true);
+      TF_RETURN_IF_ERROR(impl->Initialize(graph));
+      *out_executor = std::move(impl);
+      return OkStatus();
+    }
+  };
+};
+static WorkStealingExecutorRegistrar work_stealing_registrar;
+
 }  // namespace
 
 }  // namespace tensorflow
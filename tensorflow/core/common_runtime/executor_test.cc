@@ -25,7 +25,9 @@ limitations under the License.
 #include "tensorflow/cc/ops/standard_ops.h"
 #include "tensorflow/core/common_runtime/device.h"
 #include "tensorflow/core/common_runtime/device_factory.h"
+#include "tensorflow/core/common_runtime/executor_factory.h"
 #include "tensorflow/core/common_runtime/graph_constructor.h"
+#include "tensorflow/core/common_runtime/kernel_dispatch_policy.h"
 #include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
 #include "tensorflow/core/common_runtime/lower_functional_ops.h"
 #include "tensorflow/core/common_runtime/process_util.h"
@@ -41,6 +43,7 @@ limitations under the License.
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/random/simple_philox.h"
 #include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/cpu_info.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/strcat.h"
 #include "tensorflow/core/platform/test.h"
@@ -72,8 +75,11 @@ class ExecutorTest : public ::testing::Test {
     delete exec_;
   }
 
-  // Resets executor_ with a new executor based on a graph 'gdef'.
-  void Create(std::unique_ptr<const Graph> graph) {
+  // Resets executor_ with a new executor based on a graph 'gdef'. If
+  // `executor_type` is non-empty, the executor is created through the
+  // `ExecutorFactory` registered for that type.
+  void Create(std::unique_ptr<const Graph> graph,
+              const string& executor_type = "") {
     const int version = graph->versions().producer();
     LocalExecutorParams params;
     params.device = device_.get();
@@ -86,9 +92,22 @@ class ExecutorTest : public ::testing::Test {
     params.delete_kernel = [](OpKernel* kernel) {
       DeleteNonCachedKernel(kernel);
     };
+    params.create_dispatch_policy = create_dispatch_policy_;
+    params.use_step_arena_allocator = use_step_arena_allocator_;
+    if (parallel_initialization_) {
+      params.initialization_runner = [this](std::function<void()> fn) {
+        thread_pool_->Schedule(std::move(fn));
+      };
+    }
     rendez_ = NewLocalRendezvous();
     delete exec_;
-    TF_CHECK_OK(NewLocalExecutor(params, *graph, &exec_));
+    if (executor_type.empty()) {
+      TF_CHECK_OK(NewLocalExecutor(params, *graph, &exec_));
+    } else {
+      std::unique_ptr<Executor> executor;
+      TF_CHECK_OK(NewExecutor(executor_type, params, *graph, &executor));
+      exec_ = executor.release();
+    }
     runner_ = [this](std::function<void()> fn) { thread_pool_->Schedule(fn); };
   }
 
@@ -107,6 +126,10 @@ class ExecutorTest : public ::testing::Test {
   StepStats step_stats_;
   Executor::Args::Runner runner_;
   Rendezvous* rendez_ = nullptr;
+  std::function<std::unique_ptr<KernelDispatchPolicy>()>
+      create_dispatch_policy_;
+  bool use_step_arena_allocator_ = false;
+  bool parallel_initialization_ = false;
 };
 
 // A float val -> Tensor<float>
@@ -211,6 +234,31 @@ TEST_F(ExecutorTest, SelfAdd) {
   EXPECT_EQ(1024.0, V(out));  // b=v10=2*v9=4*v8=...=1024*a=1024.0
 }
 
+TEST_F(ExecutorTest, ParallelInitialization) {
+  // b = a + 1 + 1 + ... + 1
+  // The graph is large enough for the stateless Const and Add kernels to be
+  // created on the thread pool, while the stateful Recv and Send kernels are
+  // created by this thread.
+  auto g = std::make_unique<Graph>(OpRegistry::Global());
+  auto v = test::graph::Recv(g.get(), "a", "float", ALICE, 1, BOB);
+  const int N = 2048;
+  for (int i = 0; i < N; ++i) {
+    v = test::graph::Add(g.get(), v, test::graph::Constant(g.get(), V(1.0)));
+  }
+  test::graph::Send(g.get(), v, "b", BOB, 1, ALICE);
+  parallel_initialization_ = true;
+  Create(std::move(g));
+  Rendezvous::Args args;
+  TF_ASSERT_OK(
+      rendez_->Send(Key(ALICE, kIncarnation, BOB, "a"), args, V(1.0), false));
+  TF_ASSERT_OK(Run(rendez_));
+  Tensor out = V(-1);
+  bool is_dead = false;
+  TF_ASSERT_OK(
+      rendez_->Recv(Key(BOB, kIncarnation, ALICE, "b"), args, &out, &is_dead));
+  EXPECT_EQ(1.0 + N, V(out));
+}
+
 // Builds a graph which adds N copies of one variable "in". I.e.,
 //     a + a + a + ... + a
 // The returned graph is parenthesized ramdonly. I.e.,
@@ -261,6 +309,94 @@ TEST_F(ExecutorTest, RandomTree) {
   EXPECT_EQ(4096.0, V(out));
 }
 
+TEST_F(ExecutorTest, RandomTreeCostModelDispatch) {
+  // Use small thresholds, so that some of the nodes are batched and some are
+  // dispatched after the first run.
+  CostModelDispatchPolicy::Options options;
+  options.inline_threshold_cycles = 10;
+  options.dispatch_threshold_cycles = 1000;
+  options.batch_budget_cycles = 2000;
+  options.sample_interval = 1;
+  create_dispatch_policy_ = [options]() {
+    return std::make_unique<CostModelDispatchPolicy>(options);
+  };
+  auto g = std::make_unique<Graph>(OpRegistry::Global());
+  BuildTree(4096, g.get());
+  Create(std::move(g));
+  for (int i = 0; i < 3; ++i) {
+    Rendezvous::Args args;
+    TF_ASSERT_OK(rendez_->Send(Key(ALICE, kIncarnation, BOB, "a"), args,
+                               V(1.0), false));
+    TF_ASSERT_OK(Run(rendez_));
+    Tensor out = V(-1);
+    bool is_dead = false;
+    TF_ASSERT_OK(rendez_->Recv(Key(BOB, kIncarnation, ALICE, "b"), args, &out,
+                               &is_dead));
+    EXPECT_EQ(4096.0, V(out));
+  }
+}
+
+TEST_F(ExecutorTest, RandomTreeStepArena) {
+  use_step_arena_allocator_ = true;
+  auto g = std::make_unique<Graph>(OpRegistry::Global());
+  BuildTree(4096, g.get());
+  Create(std::move(g));
+  // The first run sizes the arena, and the later runs allocate from it.
+  for (int i = 0; i < 3; ++i) {
+    Rendezvous::Args args;
+    TF_ASSERT_OK(rendez_->Send(Key(ALICE, kIncarnation, BOB, "a"), args,
+                               V(1.0), false));
+    TF_ASSERT_OK(Run(rendez_));
+    Tensor out = V(-1);
+    bool is_dead = false;
+    TF_ASSERT_OK(rendez_->Recv(Key(BOB, kIncarnation, ALICE, "b"), args, &out,
+                               &is_dead));
+    EXPECT_EQ(4096.0, V(out));
+  }
+}
+
+TEST_F(ExecutorTest, StepArenaCopiesAliasedOutputsBeforeSend) {
+  use_step_arena_allocator_ = true;
+  // The output of `sum` may be served from the arena, and reaches the send
+  // through an Identity, which aliases its input.
+  auto g = std::make_unique<Graph>(OpRegistry::Global());
+  auto in = test::graph::Recv(g.get(), "a", "float", ALICE, 1, BOB);
+  auto sum = test::graph::Add(g.get(), in, in);
+  auto id = test::graph::Identity(g.get(), sum);
+  test::graph::Send(g.get(), id, "b", BOB, 1, ALICE);
+  Create(std::move(g));
+  std::vector<Tensor> outs;
+  for (int i = 0; i < 3; ++i) {
+    Rendezvous::Args args;
+    TF_ASSERT_OK(rendez_->Send(Key(ALICE, kIncarnation, BOB, "a"), args,
+                               V(1.0 + i), false));
+    TF_ASSERT_OK(Run(rendez_));
+    Tensor out = V(-1);
+    bool is_dead = false;
+    TF_ASSERT_OK(rendez_->Recv(Key(BOB, kIncarnation, ALICE, "b"), args, &out,
+                               &is_dead));
+    outs.push_back(out);
+  }
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(2.0 * (1.0 + i), V(outs[i]));
+  }
+}
+
+TEST_F(ExecutorTest, RandomTreeWorkStealing) {
+  auto g = std::make_unique<Graph>(OpRegistry::Global());
+  BuildTree(4096, g.get());
+  Create(std::move(g), "WORK_STEALING");
+  Rendezvous::Args args;
+  TF_ASSERT_OK(
+      rendez_->Send(Key(ALICE, kIncarnation, BOB, "a"), args, V(1.0), false));
+  TF_ASSERT_OK(Run(rendez_));
+  Tensor out = V(-1);
+  bool is_dead = false;
+  TF_ASSERT_OK(
+      rendez_->Recv(Key(BOB, kIncarnation, ALICE, "b"), args, &out, &is_dead));
+  EXPECT_EQ(4096.0, V(out));
+}
+
 void BuildConcurrentAddAssign(Graph* g) {
   auto one = test::graph::Constant(g, V(1.0));
   // A variable holds one float.
@@ -438,7 +574,8 @@ TEST_F(ExecutorTest, NoInputTensors) {
 // Create a graph that is 'depth' deep. At each level, fan-in and fan-out a
 // maximum of 'width' nodes. All nodes are no-ops and all dependencies are
 // control dependencies.
-static void BM_executor(::testing::benchmark::State& state) {
+static void BM_executor_helper(::testing::benchmark::State& state,
+                               const char* executor_type) {
   const int width = state.range(0);
   const int depth = state.range(1);
 
@@ -472,22 +609,94 @@ static void BM_executor(::testing::benchmark::State& state) {
   }
 
   FixupSourceAndSinkEdges(g);
-  test::Benchmark("cpu", g, /*old_benchmark_api=*/false).Run(state);
+  test::Benchmark("cpu", g, /*options=*/nullptr, /*init=*/nullptr,
+                  /*rendez=*/nullptr, executor_type,
+                  /*old_benchmark_api=*/false)
+      .Run(state);
 
   state.SetLabel(strings::StrCat("Nodes = ", cur));
   state.SetItemsProcessed(cur * static_cast<int64_t>(state.iterations()));
 }
 
+static void BM_executor(::testing::benchmark::State& state) {
+  BM_executor_helper(state, "");
+}
+
+static void BM_executor_work_stealing(::testing::benchmark::State& state) {
+  BM_executor_helper(state, "WORK_STEALING");
+}
+
 // Tall skinny graphs
 BENCHMARK(BM_executor)->UseRealTime()->ArgPair(16, 1024);
 BENCHMARK(BM_executor)->UseRealTime()->ArgPair(32, 8192);
+BENCHMARK(BM_executor_work_stealing)->UseRealTime()->ArgPair(16, 1024);
+BENCHMARK(BM_executor_work_stealing)->UseRealTime()->ArgPair(32, 8192);
 
 // Short fat graphs
 BENCHMARK(BM_executor)->UseRealTime()->ArgPair(1024, 16);
 BENCHMARK(BM_executor)->UseRealTime()->ArgPair(8192, 32);
+BENCHMARK(BM_executor_work_stealing)->UseRealTime()->ArgPair(1024, 16);
+BENCHMARK(BM_executor_work_stealing)->UseRealTime()->ArgPair(8192, 32);
 
 // Tall fat graph
 BENCHMARK(BM_executor)->UseRealTime()->ArgPair(1024, 1024);
+BENCHMARK(BM_executor_work_stealing)->UseRealTime()->ArgPair(1024, 1024);
+
+// Measures the time to create an executor for a graph of `num_nodes` Const
+// and Identity nodes, with kernels created serially or in parallel. The items
+// processed are the nodes of the graph.
+static void BM_ExecutorInitialization(::testing::benchmark::State& state) {
+  const int num_nodes = state.range(0);
+  const bool parallel = state.range(1);
+
+  Graph g(OpRegistry::Global());
+  for (int i = 0; i < num_nodes / 2; ++i) {
+    Tensor t(DT_FLOAT, TensorShape({16}));
+    t.flat<float>().setConstant(i);
+    test::graph::Identity(&g, test::graph::Constant(&g, t));
+  }
+  FixupSourceAndSinkEdges(&g);
+
+  std::unique_ptr<Device> device = DeviceFactory::NewDevice(
+      "CPU", {}, "/job:localhost/replica:0/task:0");
+  thread::ThreadPool pool(Env::Default(), "initialization",
+                          port::MaxParallelism());
+  LocalExecutorParams params;
+  params.device = device.get();
+  const int version = g.versions().producer();
+  params.create_kernel =
+      [&device, version](const std::shared_ptr<const NodeProperties>& props,
+                         OpKernel** kernel) {
+        return CreateNonCachedKernel(device.get(), nullptr, props, version,
+                                     kernel);
+      };
+  params.delete_kernel = [](OpKernel* kernel) {
+    DeleteNonCachedKernel(kernel);
+  };
+  if (parallel) {
+    params.initialization_runner = [&pool](std::function<void()> fn) {
+      pool.Schedule(std::move(fn));
+    };
+  }
+
+  for (auto s : state) {
+    Executor* exec = nullptr;
+    TF_CHECK_OK(NewLocalExecutor(params, g, &exec));
+    delete exec;
+  }
+  state.SetLabel(strings::StrCat("Nodes = ", g.num_op_nodes()));
+  state.SetItemsProcessed(g.num_op_nodes() *
+                          static_cast<int64_t>(state.iterations()));
+}
+
+BENCHMARK(BM_ExecutorInitialization)
+    ->UseRealTime()
+    ->ArgPair(1 << 10, false)
+    ->ArgPair(1 << 10, true)
+    ->ArgPair(1 << 14, false)
+    ->ArgPair(1 << 14, true)
+    ->ArgPair(1 << 16, false)
+    ->ArgPair(1 << 16, true);
 
 static void BM_const_identity(::testing::benchmark::State& state) {
   const int width = state.range(0);
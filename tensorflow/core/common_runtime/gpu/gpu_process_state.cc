@@ -368,6 +368,18 @@ Allocator* GPUProcessState::GetGpuHostAllocator(const GPUOptions& options,
     tsl::BFCAllocator::Options allocator_opts;
     allocator_opts.allow_growth =
         !options.experimental().gpu_host_mem_disallow_growth();
+    Status status = tsl::ReadBoolFromEnvVar(
+        "TF_BFC_ALLOCATOR_USE_THREAD_CACHES", /*default_val=*/false,
+        &allocator_opts.use_thread_caches);
+    if (!status.ok()) {
+      LOG(ERROR) << "GetGpuHostAllocator: " << status.message();
+    }
+    status = tsl::ReadInt64FromEnvVar("TF_BFC_ALLOCATOR_COMPACTION_INTERVAL_MS",
+                                      /*default_val=*/0,
+                                      &allocator_opts.compaction_interval_ms);
+    if (!status.ok()) {
+      LOG(ERROR) << "GetGpuHostAllocator: " << status.message();
+    }
     tsl::Allocator* allocator =
         new tsl::BFCAllocator(absl::WrapUnique(sub_allocator), mem_limit_bytes,
                               /*name=*/"gpu_host_bfc", allocator_opts);
@@ -15,6 +15,10 @@ limitations under the License.
 
 #include "tensorflow/core/common_runtime/immutable_executor_state.h"
 
+#include <algorithm>
+#include <functional>
+#include <memory>
+
 #include "absl/memory/memory.h"
 #include "tensorflow/core/framework/function.h"
 #include "tensorflow/core/framework/metrics.h"
@@ -22,8 +26,11 @@ limitations under the License.
 #include "tensorflow/core/graph/edgeset.h"
 #include "tensorflow/core/graph/graph.h"
 #include "tensorflow/core/graph/graph_node_util.h"
+#include "tensorflow/core/platform/blocking_counter.h"
+#include "tensorflow/core/platform/cpu_info.h"
 #include "tensorflow/core/platform/errors.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/env_var.h"
 
 namespace tensorflow {
 
@@ -31,6 +38,44 @@ namespace {
 bool IsInitializationOp(const Node* node) {
   return node->op_def().allows_uninitialized_input();
 }
+
+// Nodes with at least this many inputs get pending counts on a cache line of
+// their own in the frontier layout, since the threads that run their inputs
+// are likely to update them concurrently.
+constexpr size_t kContendedFanIn = 8;
+
+// Returns true if the pending counts of each frame should be laid out by
+// topological frontier, instead of by node id.
+bool UseFrontierPendingCountsLayout() {
+  static const bool use_frontier_layout = [] {
+    bool value = false;
+    TF_CHECK_OK(
+        ReadBoolFromEnvVar("TF_EXECUTOR_FRONTIER_PENDING_COUNTS_LAYOUT",
+                           /*default_val=*/false, &value));
+    return value;
+  }();
+  return use_frontier_layout;
+}
+
+// Graphs with fewer nodes are initialized serially, since the kernels of most
+// nodes are cheap to create.
+constexpr size_t kMinNodesForParallelInitialization = 1024;
+
+// Number of stateless nodes that a closure initializes at a time when the
+// node items are initialized in parallel.
+constexpr int64_t kNodesPerInitializationBlock = 64;
+
+// Returns true if the node items of large graphs should be initialized in
+// parallel when the executor params provide an initialization runner.
+bool UseParallelInitialization() {
+  static const bool use_parallel_initialization = [] {
+    bool value = true;
+    TF_CHECK_OK(ReadBoolFromEnvVar("TF_EXECUTOR_PARALLEL_INITIALIZATION",
+                                   /*default_val=*/true, &value));
+    return value;
+  }();
+  return use_parallel_initialization;
+}
 }  // namespace
 
 ImmutableExecutorState::~ImmutableExecutorState() {
@@ -95,12 +140,20 @@ Status ImmutableExecutorState::Initialize(const Graph& graph) {
   root_frame_info_ = frame_info_[""].get();
 
   pending_ids_.resize(gview_.num_nodes());
+  const bool use_frontier_layout = UseFrontierPendingCountsLayout();
 
   // Preprocess every node in the graph to create an instance of op
   // kernel for each node.
-  requires_control_flow_ = false;
+  std::vector<const Node*> nodes;
+  nodes.reserve(graph.num_nodes());
   for (const Node* n : graph.nodes()) {
     if (IsSink(n)) continue;
+    nodes.push_back(n);
+  }
+  TF_RETURN_IF_ERROR(InitializeNodeItems(nodes));
+
+  requires_control_flow_ = false;
+  for (const Node* n : nodes) {
     if (IsSwitch(n) || IsMerge(n) || IsEnter(n) || IsExit(n)) {
       requires_control_flow_ = true;
     } else if (IsRecv(n)) {
@@ -124,38 +177,15 @@ Status ImmutableExecutorState::Initialize(const Graph& graph) {
     FrameInfo* frame_info = EnsureFrameInfo(frame_name);
 
     NodeItem* item = gview_.node(id);
-    item->node_id = id;
-
     item->input_start = frame_info->total_inputs;
     frame_info->total_inputs += n->num_inputs();
 
-    Status s = params_.create_kernel(n->properties(), &item->kernel);
-    if (!s.ok()) {
-      params_.delete_kernel(item->kernel);
-      item->kernel = nullptr;
-      s = AttachDef(s, *n);
-      return s;
-    }
-    CHECK(item->kernel);
-    item->kernel_is_async = (item->kernel->AsAsync() != nullptr);
-    item->is_merge = IsMerge(n);
-    item->is_any_consumer_merge_or_control_trigger = false;
-    for (const Node* consumer : n->out_nodes()) {
-      if (IsMerge(consumer) || IsControlTrigger(consumer)) {
-        item->is_any_consumer_merge_or_control_trigger = true;
-        break;
-      }
-    }
-    const Tensor* const_tensor = item->kernel->const_tensor();
-    if (const_tensor) {
+    if (item->const_tensor) {
       // Hold onto a shallow copy of the constant tensor in `*this` so that the
       // reference count does not drop to 1. This prevents the constant tensor
       // from being forwarded, and its buffer reused.
-      const_tensors_.emplace_back(*const_tensor);
+      const_tensors_.emplace_back(*item->const_tensor);
     }
-    item->const_tensor = const_tensor;
-    item->is_noop = (item->kernel->type_string_view() == "NoOp");
-    item->is_enter = IsEnter(n);
     if (item->is_enter) {
       bool is_constant_enter;
       TF_RETURN_IF_ERROR(
@@ -186,25 +216,17 @@ Status ImmutableExecutorState::Initialize(const Graph& graph) {
     } else {
       item->is_constant_enter = false;
     }
-    item->is_exit = IsExit(n);
-    item->is_control_trigger = IsControlTrigger(n);
-    item->is_source = IsSource(n);
-    item->is_enter_exit_or_next_iter =
-        (IsEnter(n) || IsExit(n) || IsNextIteration(n));
-    item->is_transfer_node = IsTransferNode(n);
-    item->is_initialization_op = IsInitializationOp(n);
-    item->is_recv_or_switch = IsRecv(n) || IsSwitch(n);
-    item->is_next_iteration = IsNextIteration(n);
-    item->is_distributed_communication = IsDistributedCommunication(n);
 
     // Compute the maximum values we'll store for this node in the
     // pending counts data structure, and allocate a handle in
     // that frame's pending counts data structure that has enough
     // space to store these maximal count values.
-    size_t max_pending, max_dead;
-    GetMaxPendingCounts(n, &max_pending, &max_dead);
-    pending_ids_[id] =
-        frame_info->pending_counts_layout.CreateHandle(max_pending, max_dead);
+    if (!use_frontier_layout) {
+      size_t max_pending, max_dead;
+      GetMaxPendingCounts(n, &max_pending, &max_dead);
+      pending_ids_[id] =
+          frame_info->pending_counts_layout.CreateHandle(max_pending, max_dead);
+    }
 
     // See if this node is a root node, and if so, add item to root_nodes_.
     if (n->in_edges().empty()) {
@@ -218,28 +240,10 @@ Status ImmutableExecutorState::Initialize(const Graph& graph) {
       TF_RETURN_IF_ERROR(GetNodeAttr(n->attrs(), "frame_name", &enter_name));
       EnsureFrameInfo(enter_name)->input_count++;
     }
+  }
 
-    // Record information about whether each output of the op is used.
-    std::unique_ptr<bool[]> outputs_required(new bool[n->num_outputs()]);
-    std::fill(&outputs_required[0], &outputs_required[n->num_outputs()], false);
-    int32_t unused_outputs = n->num_outputs();
-    for (const Edge* e : n->out_edges()) {
-      if (IsSink(e->dst())) continue;
-      if (e->src_output() >= 0) {
-        if (!outputs_required[e->src_output()]) {
-          --unused_outputs;
-          outputs_required[e->src_output()] = true;
-        }
-      }
-    }
-    if (unused_outputs > 0) {
-      for (int i = 0; i < n->num_outputs(); ++i) {
-        if (!outputs_required[i]) {
-          metrics::RecordUnusedOutput(n->type_string());
-        }
-      }
-      item->outputs_required = std::move(outputs_required);
-    }
+  if (use_frontier_layout) {
+    CreateFrontierPendingIds(graph, cf_info);
   }
 
   // Rewrite each `EdgeInfo::input_slot` member to refer directly to the input
@@ -262,6 +266,190 @@ Status ImmutableExecutorState::Initialize(const Graph& graph) {
   return gview_.SetAllocAttrs(&graph, params_.device);
 }
 
+Status ImmutableExecutorState::InitializeNodeItem(const Node* n,
+                                                  NodeItem* item) {
+  item->node_id = n->id();
+
+  Status s = params_.create_kernel(n->properties(), &item->kernel);
+  if (!s.ok()) {
+    params_.delete_kernel(item->kernel);
+    item->kernel = nullptr;
+    s = AttachDef(s, *n);
+    return s;
+  }
+  CHECK(item->kernel);
+  item->kernel_is_async = (item->kernel->AsAsync() != nullptr);
+  item->is_merge = IsMerge(n);
+  item->is_any_consumer_merge_or_control_trigger = false;
+  for (const Node* consumer : n->out_nodes()) {
+    if (IsMerge(consumer) || IsControlTrigger(consumer)) {
+      item->is_any_consumer_merge_or_control_trigger = true;
+      break;
+    }
+  }
+  item->const_tensor = item->kernel->const_tensor();
+  item->is_noop = (item->kernel->type_string_view() == "NoOp");
+  item->is_enter = IsEnter(n);
+  item->is_exit = IsExit(n);
+  item->is_control_trigger = IsControlTrigger(n);
+  item->is_source = IsSource(n);
+  item->is_enter_exit_or_next_iter =
+      (IsEnter(n) || IsExit(n) || IsNextIteration(n));
+  item->is_transfer_node = IsTransferNode(n);
+  item->is_initialization_op = IsInitializationOp(n);
+  item->is_recv_or_switch = IsRecv(n) || IsSwitch(n);
+  item->is_next_iteration = IsNextIteration(n);
+  item->is_distributed_communication = IsDistributedCommunication(n);
+
+  // Record information about whether each output of the op is used.
+  std::unique_ptr<bool[]> outputs_required(new bool[n->num_outputs()]);
+  std::fill(&outputs_required[0], &outputs_required[n->num_outputs()], false);
+  int32_t unused_outputs = n->num_outputs();
+  for (const Edge* e : n->out_edges()) {
+    if (IsSink(e->dst())) continue;
+    if (e->src_output() >= 0) {
+      if (!outputs_required[e->src_output()]) {
+        --unused_outputs;
+        outputs_required[e->src_output()] = true;
+      }
+    }
+  }
+  if (unused_outputs > 0) {
+    for (int i = 0; i < n->num_outputs(); ++i) {
+      if (!outputs_required[i]) {
+        metrics::RecordUnusedOutput(n->type_string());
+      }
+    }
+    item->outputs_required = std::move(outputs_required);
+  }
+  return OkStatus();
+}
+
+Status ImmutableExecutorState::InitializeNodeItems(
+    const std::vector<const Node*>& nodes) {
+  if (!params_.initialization_runner ||
+      nodes.size() < kMinNodesForParallelInitialization ||
+      !UseParallelInitialization()) {
+    for (const Node* n : nodes) {
+      TF_RETURN_IF_ERROR(InitializeNodeItem(n, gview_.node(n->id())));
+    }
+    return OkStatus();
+  }
+
+  std::vector<Status> statuses(nodes.size());
+  std::vector<int> stateful_indices;
+  std::vector<int> stateless_indices;
+  for (int i = 0; i < nodes.size(); ++i) {
+    if (nodes[i]->op_def().is_stateful()) {
+      stateful_indices.push_back(i);
+    } else {
+      stateless_indices.push_back(i);
+    }
+  }
+
+  // The closures claim blocks of stateless nodes until none are left. The
+  // state is shared with the closures, since the runner may start some of
+  // them only after the other closures and this thread have initialized all
+  // the blocks.
+  struct SharedState {
+    explicit SharedState(int64_t num_blocks)
+        : num_blocks(num_blocks), counter(num_blocks) {}
+    const int64_t num_blocks;
+    std::atomic<int64_t> next_block{0};
+    BlockingCounter counter;
+    std::function<void(int64_t)> initialize_block;
+  };
+  const int64_t num_blocks =
+      (stateless_indices.size() + kNodesPerInitializationBlock - 1) /
+      kNodesPerInitializationBlock;
+  auto state = std::make_shared<SharedState>(num_blocks);
+  state->initialize_block = [this, &nodes, &statuses,
+                             &stateless_indices](int64_t block) {
+    const int64_t begin = block * kNodesPerInitializationBlock;
+    const int64_t end =
+        std::min<int64_t>(begin + kNodesPerInitializationBlock,
+                          stateless_indices.size());
+    for (int64_t i = begin; i < end; ++i) {
+      const int index = stateless_indices[i];
+      const Node* n = nodes[index];
+      statuses[index] = InitializeNodeItem(n, gview_.node(n->id()));
+    }
+  };
+  auto initialize_blocks = [](SharedState* state) {
+    for (int64_t block = state->next_block.fetch_add(1);
+         block < state->num_blocks; block = state->next_block.fetch_add(1)) {
+      state->initialize_block(block);
+      state->counter.DecrementCount();
+    }
+  };
+
+  const int64_t num_closures =
+      std::min<int64_t>(num_blocks - 1, port::MaxParallelism());
+  for (int64_t i = 0; i < num_closures; ++i) {
+    params_.initialization_runner([state, initialize_blocks]() {
+      initialize_blocks(state.get());
+    });
+  }
+  for (int index : stateful_indices) {
+    const Node* n = nodes[index];
+    statuses[index] = InitializeNodeItem(n, gview_.node(n->id()));
+  }
+  initialize_blocks(state.get());
+  state->counter.Wait();
+
+  for (const Status& s : statuses) {
+    TF_RETURN_IF_ERROR(s);
+  }
+  return OkStatus();
+}
+
+void ImmutableExecutorState::CreateFrontierPendingIds(
+    const Graph& graph, const ControlFlowInfo& cf_info) {
+  // Visit the nodes in breadth-first topological order, ignoring the back
+  // edges of loops, so that the counts of nodes that become ready at about the
+  // same time are adjacent.
+  std::vector<int> num_pending_inputs(graph.num_node_ids(), 0);
+  std::vector<const Node*> frontier;
+  for (const Node* n : graph.nodes()) {
+    for (const Edge* e : n->in_edges()) {
+      if (!IsNextIteration(e->src())) ++num_pending_inputs[n->id()];
+    }
+    if (num_pending_inputs[n->id()] == 0) frontier.push_back(n);
+  }
+  std::vector<bool> has_handle(graph.num_node_ids(), false);
+  auto create_handle = [&](const Node* n) {
+    if (IsSink(n) || has_handle[n->id()]) return;
+    has_handle[n->id()] = true;
+    size_t max_pending, max_dead;
+    GetMaxPendingCounts(n, &max_pending, &max_dead);
+    PendingCounts::Layout& layout =
+        EnsureFrameInfo(cf_info.frame_names[n->id()])->pending_counts_layout;
+    pending_ids_[n->id()] =
+        n->in_edges().size() >= kContendedFanIn
+            ? layout.CreateIsolatedHandle(max_pending, max_dead)
+            : layout.CreateHandle(max_pending, max_dead);
+  };
+  std::vector<const Node*> next_frontier;
+  while (!frontier.empty()) {
+    for (const Node* n : frontier) {
+      create_handle(n);
+      if (IsNextIteration(n)) continue;
+      for (const Node* out : n->out_nodes()) {
+        if (--num_pending_inputs[out->id()] == 0) {
+          next_frontier.push_back(out);
+        }
+      }
+    }
+    frontier.swap(next_frontier);
+    next_frontier.clear();
+  }
+  // Nodes in cycles that do not go through a NextIteration node are never
+  // ready, but still need a handle.
+  for (const Node* n : graph.nodes()) {
+    create_handle(n);
+  }
+}
+
 namespace {
 // If a Node has been marked to use a ScopedAllocator x for output i, then
 // sc_attr will contain the subsequence (i, x) at an even offset.  This function
@@ -124,7 +124,19 @@ class ImmutableExecutorState {
 
   static Status BuildControlFlowInfo(const Graph* graph,
                                      ControlFlowInfo* cf_info);
+  // Creates the kernel of `n` and initializes the members of `item` that only
+  // depend on `n`. Thread-safe for stateless nodes.
+  Status InitializeNodeItem(const Node* n, NodeItem* item);
+  // Calls `InitializeNodeItem()` for each node of `nodes`, in parallel if
+  // `params_.initialization_runner` is set. Returns the first error in the
+  // order of `nodes`.
+  Status InitializeNodeItems(const std::vector<const Node*>& nodes);
   void InitializePending(const Graph* graph, const ControlFlowInfo& cf_info);
+  // Creates `pending_ids_` in the order of the topological frontiers of
+  // `graph`, with the counts of nodes with a wide fan-in on cache lines of
+  // their own.
+  void CreateFrontierPendingIds(const Graph& graph,
+                                const ControlFlowInfo& cf_info);
 
   FrameInfo* EnsureFrameInfo(const string& fname);
 
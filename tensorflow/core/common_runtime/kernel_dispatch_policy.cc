@@ -0,0 +1,82 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/kernel_dispatch_policy.h"
+
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace tensorflow {
+
+CostModelDispatchPolicy::CostModelDispatchPolicy(const Options& options)
+    : options_(options) {
+  DCHECK_GT(options_.decay, 0);
+  DCHECK_GT(options_.sample_interval, 0);
+  DCHECK_EQ(options_.sample_interval & (options_.sample_interval - 1), 0)
+      << "sample_interval must be a power of two";
+  DCHECK_LE(options_.inline_threshold_cycles,
+            options_.dispatch_threshold_cycles);
+}
+
+void CostModelDispatchPolicy::Initialize(const GraphView& gview) {
+  num_nodes_ = gview.num_nodes();
+  cost_estimates_ = std::make_unique<std::atomic<uint64>[]>(num_nodes_);
+  for (int32_t i = 0; i < num_nodes_; ++i) {
+    const NodeItem* item = gview.node(i);
+    const bool is_expensive =
+        item != nullptr && item->kernel != nullptr &&
+        !item->kernel_is_async && item->kernel->IsExpensive();
+    cost_estimates_[i].store(
+        is_expensive ? options_.initial_expensive_estimate_cycles : 0,
+        std::memory_order_relaxed);
+  }
+}
+
+KernelDispatchPolicy::Decision CostModelDispatchPolicy::Decide(
+    const NodeItem& item) const {
+  // Asynchronous kernels return as soon as they have enqueued their work, so
+  // there is nothing to gain by running them on another thread.
+  if (item.kernel_is_async) return Decision::kInline;
+  const uint64 estimate = EstimatedCycles(item);
+  if (estimate < options_.inline_threshold_cycles) return Decision::kInline;
+  if (estimate < options_.dispatch_threshold_cycles) return Decision::kBatch;
+  return Decision::kDispatch;
+}
+
+uint64 CostModelDispatchPolicy::EstimatedCycles(const NodeItem& item) const {
+  DCHECK_LT(item.node_id, num_nodes_);
+  return cost_estimates_[item.node_id].load(std::memory_order_relaxed);
+}
+
+void CostModelDispatchPolicy::RecordExecution(const NodeItem& item,
+                                              uint64 start_cycles,
+                                              uint64 elapsed_cycles) {
+  std::atomic<uint64>& cost_estimate = cost_estimates_[item.node_id];
+  const uint64 prev_estimate = cost_estimate.load(std::memory_order_relaxed);
+  // Always update the estimate of dispatched nodes, whose cost dwarfs that of
+  // the update. Otherwise sample, assuming that the low bits of the CPU cycle
+  // count are uniformly distributed.
+  if (prev_estimate < options_.dispatch_threshold_cycles &&
+      (start_cycles & (options_.sample_interval - 1)) != 0) {
+    return;
+  }
+  // N.B. Updates are atomic but unlocked, so concurrent updates may be lost.
+  // This only slows down convergence of the estimate.
+  const uint64 new_estimate =
+      ((options_.decay - 1) * prev_estimate + elapsed_cycles) / options_.decay;
+  cost_estimate.store(new_estimate, std::memory_order_relaxed);
+}
+
+}  // namespace tensorflow
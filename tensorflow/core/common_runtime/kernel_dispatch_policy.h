@@ -0,0 +1,122 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_KERNEL_DISPATCH_POLICY_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_KERNEL_DISPATCH_POLICY_H_
+
+#include <atomic>
+#include <memory>
+
+#include "tensorflow/core/common_runtime/graph_view.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// Decides how the executor runs each node that becomes ready.
+//
+// An instance is owned by a single executor, and its methods may be called
+// concurrently from all threads that execute steps of that executor.
+class KernelDispatchPolicy {
+ public:
+  enum class Decision {
+    // Run the node on the thread that made it ready.
+    kInline,
+    // Run the node in a closure shared with other `kBatch` nodes that became
+    // ready at the same time, up to a total of `BatchBudgetCycles()`.
+    kBatch,
+    // Run the node in its own closure.
+    kDispatch,
+  };
+
+  virtual ~KernelDispatchPolicy() = default;
+
+  // Called once, after the executor has created the kernels for `gview`.
+  virtual void Initialize(const GraphView& gview) = 0;
+
+  // Returns how the executor should run `item`.
+  virtual Decision Decide(const NodeItem& item) const = 0;
+
+  // Returns the estimated cost of running `item` in CPU cycles. Used to size
+  // the groups of `kBatch` nodes.
+  virtual uint64 EstimatedCycles(const NodeItem& item) const = 0;
+
+  // Returns the maximum sum of `EstimatedCycles()` for the nodes in a single
+  // batched closure.
+  virtual uint64 BatchBudgetCycles() const = 0;
+
+  // Records that a synchronous invocation of `item`'s kernel started at
+  // `start_cycles` and took `elapsed_cycles`.
+  virtual void RecordExecution(const NodeItem& item, uint64 start_cycles,
+                               uint64 elapsed_cycles) = 0;
+};
+
+// A `KernelDispatchPolicy` that keeps an exponential moving average of the
+// compute time of every synchronous node, and picks a decision by comparing
+// that average against two thresholds.
+//
+// Unlike the executor's built-in cost estimates, which only track kernels that
+// report `OpKernel::IsExpensive()`, this policy learns the cost of all nodes,
+// so that kernels that are marked expensive but are cheap for the shapes of a
+// particular model end up inlined or batched.
+class CostModelDispatchPolicy : public KernelDispatchPolicy {
+ public:
+  struct Options {
+    // Nodes whose average cost is below this are run inline.
+    uint64 inline_threshold_cycles = 8000;
+
+    // Nodes whose average cost is below this (and not below
+    // `inline_threshold_cycles`) are batched, others are dispatched.
+    uint64 dispatch_threshold_cycles = 200 * 1000;
+
+    // Maximum estimated cost of a batched closure.
+    uint64 batch_budget_cycles = 400 * 1000;
+
+    // Initial estimate for kernels that report `IsExpensive()`; other
+    // kernels start at zero and are inlined until they are measured.
+    uint64 initial_expensive_estimate_cycles = 100 * 1000 * 1000;
+
+    // Weight of a new measurement in the moving average is 1 / `decay`.
+    uint64 decay = 8;
+
+    // Executions of nodes that are not dispatched are only measured with
+    // probability 1 / `sample_interval`, to amortize the cost of the update.
+    // Must be a power of two.
+    uint64 sample_interval = 16;
+  };
+
+  CostModelDispatchPolicy() : CostModelDispatchPolicy(Options()) {}
+  explicit CostModelDispatchPolicy(const Options& options);
+
+  void Initialize(const GraphView& gview) override;
+  Decision Decide(const NodeItem& item) const override;
+  uint64 EstimatedCycles(const NodeItem& item) const override;
+  uint64 BatchBudgetCycles() const override {
+    return options_.batch_budget_cycles;
+  }
+  void RecordExecution(const NodeItem& item, uint64 start_cycles,
+                       uint64 elapsed_cycles) override;
+
+ private:
+  const Options options_;
+  int32 num_nodes_ = 0;
+  std::unique_ptr<std::atomic<uint64>[]> cost_estimates_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(CostModelDispatchPolicy);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_KERNEL_DISPATCH_POLICY_H_
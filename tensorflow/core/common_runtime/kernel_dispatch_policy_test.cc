@@ -0,0 +1,92 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/kernel_dispatch_policy.h"
+
+#include <memory>
+
+#include "tensorflow/core/common_runtime/graph_view.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+using Decision = KernelDispatchPolicy::Decision;
+
+class CostModelDispatchPolicyTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    graph_ = std::make_unique<Graph>(OpRegistry::Global());
+    node_ = test::graph::NoOp(graph_.get(), {});
+    TF_ASSERT_OK(gview_.Initialize(graph_.get()));
+  }
+
+  const NodeItem& item() const { return *gview_.node(node_->id()); }
+
+  std::unique_ptr<Graph> graph_;
+  Node* node_ = nullptr;
+  GraphView gview_;
+};
+
+TEST_F(CostModelDispatchPolicyTest, UnmeasuredNodesAreInlined) {
+  CostModelDispatchPolicy policy;
+  policy.Initialize(gview_);
+  EXPECT_EQ(0, policy.EstimatedCycles(item()));
+  EXPECT_EQ(Decision::kInline, policy.Decide(item()));
+}
+
+TEST_F(CostModelDispatchPolicyTest, DecisionFollowsMovingAverage) {
+  CostModelDispatchPolicy::Options options;
+  options.inline_threshold_cycles = 100;
+  options.dispatch_threshold_cycles = 1000;
+  options.decay = 2;
+  options.sample_interval = 1;
+  CostModelDispatchPolicy policy(options);
+  policy.Initialize(gview_);
+
+  policy.RecordExecution(item(), /*start_cycles=*/0, /*elapsed_cycles=*/400);
+  EXPECT_EQ(200, policy.EstimatedCycles(item()));
+  EXPECT_EQ(Decision::kBatch, policy.Decide(item()));
+
+  policy.RecordExecution(item(), /*start_cycles=*/0, /*elapsed_cycles=*/4000);
+  EXPECT_EQ(2100, policy.EstimatedCycles(item()));
+  EXPECT_EQ(Decision::kDispatch, policy.Decide(item()));
+
+  for (int i = 0; i < 10; ++i) {
+    policy.RecordExecution(item(), /*start_cycles=*/0, /*elapsed_cycles=*/10);
+  }
+  EXPECT_EQ(Decision::kInline, policy.Decide(item()));
+}
+
+TEST_F(CostModelDispatchPolicyTest, SamplesCheapNodes) {
+  CostModelDispatchPolicy::Options options;
+  options.decay = 1;
+  options.sample_interval = 16;
+  CostModelDispatchPolicy policy(options);
+  policy.Initialize(gview_);
+
+  // Not sampled: the low bits of `start_cycles` are not zero.
+  policy.RecordExecution(item(), /*start_cycles=*/7, /*elapsed_cycles=*/500);
+  EXPECT_EQ(0, policy.EstimatedCycles(item()));
+
+  policy.RecordExecution(item(), /*start_cycles=*/32, /*elapsed_cycles=*/500);
+  EXPECT_EQ(500, policy.EstimatedCycles(item()));
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -26,6 +26,7 @@ class Device;
 class StepStatsCollector;
 class SessionMetadata;
 class FunctionLibraryRuntime;
+class KernelDispatchPolicy;
 class NodeProperties;
 class OpKernel;
 
@@ -50,6 +51,37 @@ struct LocalExecutorParams {
 
   // Whether control flow nodes are allowed to be executed synchronously.
   bool allow_control_flow_sync_execution = false;
+
+  // If set, creates the policy that decides whether ready nodes are run
+  // inline, in a batched closure, or in their own closure. If not set, the
+  // executor inlines nodes based on `OpKernel::IsExpensive()` and its own
+  // cost estimates, unless the TF_EXECUTOR_USE_COST_MODEL_DISPATCH
+  // environment variable is true, in which case it uses a
+  // `CostModelDispatchPolicy`.
+  std::function<std::unique_ptr<KernelDispatchPolicy>()> create_dispatch_policy;
+
+  // If true and `device` is a CPU device, the outputs and temporaries of
+  // stateless kernels are allocated from a per-step arena (see
+  // `StepArenaAllocator`), which is sized from the allocations of previous
+  // steps. Outputs that may outlive the step (e.g. fetched or sent tensors,
+  // or inputs of stateful kernels) are kept out of the arena.
+  bool use_step_arena_allocator = false;
+
+  // If positive and `device` is a CPU device, the executor records the
+  // allocations of stateless kernels during its first
+  // `static_memory_plan_warmup_runs` steps, and serves the allocations of
+  // later steps from a static assignment of buffers derived from them (see
+  // `StaticMemoryPlan`). Takes precedence over `use_step_arena_allocator`.
+  int static_memory_plan_warmup_runs = 0;
+
+  // If set, the executor creates the kernels of stateless nodes and
+  // initializes their node items in parallel, in closures passed to
+  // `initialization_runner`, when the graph has many nodes. The kernels of
+  // stateful nodes are always created serially, in graph order, by the thread
+  // that initializes the executor, since their constructors may create or
+  // look up shared resources. `create_kernel` must be thread-safe for
+  // stateless nodes if this is set.
+  std::function<void(std::function<void()>)> initialization_runner;
 };
 
 }  // end namespace tensorflow
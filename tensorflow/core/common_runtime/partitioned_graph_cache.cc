@@ -0,0 +1,150 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/partitioned_graph_cache.h"
+
+#include "absl/strings/str_cat.h"
+#include "tensorflow/core/framework/device.h"
+#include "tensorflow/core/lib/strings/proto_serialization.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/fingerprint.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/path.h"
+#include "tensorflow/core/public/version.h"
+
+namespace tensorflow {
+namespace {
+
+constexpr char kKeySeparator[] = "__";
+
+std::string VersionString() {
+  return absl::StrCat(TF_VERSION_STRING, "/", TF_GRAPH_DEF_VERSION);
+}
+
+}  // namespace
+
+PartitionedGraphCache::PartitionedGraphCache(Env* env,
+                                             absl::string_view directory,
+                                             absl::string_view prefix)
+    : env_(env), directory_(directory), prefix_(prefix) {
+  DCHECK(!directory_.empty());
+}
+
+/* static */ uint64 PartitionedGraphCache::FingerprintGraph(
+    uint64 base_fingerprint, const GraphDef& graph) {
+  return FingerprintCat64(base_fingerprint, DeterministicProtoHash64(graph));
+}
+
+PartitionedGraphCacheKey PartitionedGraphCache::BuildKey(
+    uint64 graph_fingerprint, const BuildGraphOptions& options,
+    const ConfigProto& config, const std::vector<Device*>& devices) const {
+  PartitionedGraphCacheKey key;
+  key.set_prefix(prefix_);
+  key.set_graph_fingerprint(graph_fingerprint);
+
+  uint64 callable_fingerprint =
+      DeterministicProtoHash64(options.callable_options);
+  callable_fingerprint = FingerprintCat64(
+      callable_fingerprint, options.use_function_convention ? 1 : 0);
+  callable_fingerprint =
+      FingerprintCat64(callable_fingerprint, options.collective_graph_key);
+  callable_fingerprint = FingerprintCat64(
+      callable_fingerprint, static_cast<uint64>(options.collective_order));
+  key.set_callable_fingerprint(callable_fingerprint);
+
+  // The cache directory does not change the graphs, so the same entries can
+  // be used with different directories.
+  ConfigProto config_without_cache = config;
+  config_without_cache.mutable_experimental()
+      ->clear_partitioned_graph_cache_directory();
+  key.set_config_fingerprint(DeterministicProtoHash64(config_without_cache));
+
+  // Device incarnations change between processes, and the physical device
+  // descriptions do not affect the graphs.
+  uint64 device_fingerprint = 0;
+  for (const Device* device : devices) {
+    const DeviceAttributes& attributes = device->attributes();
+    device_fingerprint =
+        FingerprintCat64(device_fingerprint, Fingerprint64(attributes.name()));
+    device_fingerprint = FingerprintCat64(
+        device_fingerprint, Fingerprint64(attributes.device_type()));
+    device_fingerprint =
+        FingerprintCat64(device_fingerprint, attributes.memory_limit());
+  }
+  key.set_device_fingerprint(device_fingerprint);
+
+  key.set_version(VersionString());
+  return key;
+}
+
+std::string PartitionedGraphCache::GetFilePath(
+    const PartitionedGraphCacheKey& key) const {
+  const std::string file_name = absl::StrCat(
+      key.prefix(), key.prefix().empty() ? "" : kKeySeparator,
+      key.graph_fingerprint(), kKeySeparator, key.callable_fingerprint(),
+      kKeySeparator, key.config_fingerprint(), kKeySeparator,
+      key.device_fingerprint(), ".pb");
+  return io::JoinPath(directory_, file_name);
+}
+
+std::optional<PartitionedGraphCacheEntry> PartitionedGraphCache::TryToLoad(
+    const PartitionedGraphCacheKey& key) const {
+  const std::string file_path = GetFilePath(key);
+  if (!env_->FileExists(file_path).ok()) {
+    return std::nullopt;
+  }
+
+  PartitionedGraphCacheEntry entry;
+  Status s = ReadBinaryProto(env_, file_path, &entry);
+  if (!s.ok()) {
+    LOG(WARNING) << "Ignoring partitioned graph cache entry " << file_path
+                 << ": " << s;
+    return std::nullopt;
+  }
+  if (!AreSerializedProtosEqual(key, entry.key())) {
+    VLOG(1) << "Partitioned graph cache key does not match:\n"
+            << "got:\n"
+            << entry.key().DebugString() << "\nexpected:\n"
+            << key.DebugString();
+    return std::nullopt;
+  }
+  if (entry.partitions().empty()) {
+    LOG(WARNING) << "Ignoring partitioned graph cache entry " << file_path
+                 << " without partitions.";
+    return std::nullopt;
+  }
+  return entry;
+}
+
+Status PartitionedGraphCache::Save(
+    const PartitionedGraphCacheEntry& entry) const {
+  TF_RETURN_IF_ERROR(env_->RecursivelyCreateDir(directory_));
+  const std::string file_path = GetFilePath(entry.key());
+  std::string temp_path = file_path;
+  if (!env_->CreateUniqueFileName(&temp_path, ".tmp")) {
+    return errors::Internal("Failed to create a temporary file name for ",
+                            file_path);
+  }
+  Status s = WriteBinaryProto(env_, temp_path, entry);
+  if (s.ok()) {
+    s = env_->RenameFile(temp_path, file_path);
+  }
+  if (!s.ok()) {
+    env_->DeleteFile(temp_path).IgnoreError();
+  }
+  return s;
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,86 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_PARTITIONED_GRAPH_CACHE_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_PARTITIONED_GRAPH_CACHE_H_
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "tensorflow/core/common_runtime/build_graph_options.h"
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/status.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/protobuf/config.pb.h"
+#include "tensorflow/core/protobuf/partitioned_graph_cache.pb.h"
+
+namespace tensorflow {
+
+class Device;
+
+// Saves and loads the optimized and partitioned graphs of a DirectSession
+// to and from files in a directory, so that new processes that run the same
+// graph with the same configuration can skip pruning, placement, grappler,
+// partitioning and the POST_PARTITIONING optimization passes.
+//
+// Each entry is stored in its own file, whose name is derived from its key.
+// Entries are written to a temporary file that is renamed once complete, so
+// processes that share a directory never read partially written entries.
+class PartitionedGraphCache {
+ public:
+  // `directory` must not be empty. `env` must outlive the cache.
+  PartitionedGraphCache(Env* env, absl::string_view directory,
+                        absl::string_view prefix = "");
+
+  // Returns the fingerprint of `graph` combined with `base_fingerprint`, which
+  // is the fingerprint of the graphs that the session was created and
+  // extended with before `graph`, or 0 for the first graph.
+  static uint64 FingerprintGraph(uint64 base_fingerprint,
+                                 const GraphDef& graph);
+
+  // Returns the key of the entry for the graphs that a session built with
+  // `options`, for the graph with fingerprint `graph_fingerprint`.
+  PartitionedGraphCacheKey BuildKey(uint64 graph_fingerprint,
+                                    const BuildGraphOptions& options,
+                                    const ConfigProto& config,
+                                    const std::vector<Device*>& devices) const;
+
+  // Returns std::nullopt if there is no valid entry for `key`.
+  std::optional<PartitionedGraphCacheEntry> TryToLoad(
+      const PartitionedGraphCacheKey& key) const;
+
+  // Saves `entry`, replacing any existing entry with the same key.
+  Status Save(const PartitionedGraphCacheEntry& entry) const;
+
+  // Returns the path of the file of the entry for `key`.
+  std::string GetFilePath(const PartitionedGraphCacheKey& key) const;
+
+  const std::string& directory() const { return directory_; }
+
+ private:
+  Env* const env_;
+  const std::string directory_;
+  const std::string prefix_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(PartitionedGraphCache);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_PARTITIONED_GRAPH_CACHE_H_
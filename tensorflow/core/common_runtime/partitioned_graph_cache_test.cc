@@ -0,0 +1,164 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/partitioned_graph_cache.h"
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/path.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+GraphDef MakeGraph(const string& node_name) {
+  GraphDef graph;
+  NodeDef* node = graph.add_node();
+  node->set_name(node_name);
+  node->set_op("NoOp");
+  return graph;
+}
+
+BuildGraphOptions MakeOptions(const string& target) {
+  BuildGraphOptions options;
+  options.callable_options.add_target(target);
+  options.use_function_convention = true;
+  return options;
+}
+
+class PartitionedGraphCacheTest : public ::testing::Test {
+ protected:
+  PartitionedGraphCacheTest()
+      : directory_(io::JoinPath(
+            testing::TmpDir(),
+            ::testing::UnitTest::GetInstance()->current_test_info()->name())),
+        cache_(Env::Default(), directory_) {}
+
+  PartitionedGraphCacheKey MakeKey(const GraphDef& graph,
+                                   const BuildGraphOptions& options,
+                                   const ConfigProto& config) {
+    return cache_.BuildKey(PartitionedGraphCache::FingerprintGraph(0, graph),
+                           options, config, /*devices=*/{});
+  }
+
+  PartitionedGraphCacheEntry MakeEntry(const PartitionedGraphCacheKey& key) {
+    PartitionedGraphCacheEntry entry;
+    *entry.mutable_key() = key;
+    (*entry.mutable_partitions())["/device:CPU:0"] = MakeGraph("b");
+    entry.add_fetch_types(DT_FLOAT);
+    (*entry.mutable_stateful_placements())["v"] = "/device:CPU:0";
+    return entry;
+  }
+
+  const string directory_;
+  PartitionedGraphCache cache_;
+};
+
+TEST_F(PartitionedGraphCacheTest, SavesAndLoadsEntries) {
+  PartitionedGraphCacheKey key =
+      MakeKey(MakeGraph("a"), MakeOptions("a"), ConfigProto());
+  EXPECT_FALSE(cache_.TryToLoad(key).has_value());
+
+  PartitionedGraphCacheEntry entry = MakeEntry(key);
+  TF_ASSERT_OK(cache_.Save(entry));
+  TF_EXPECT_OK(Env::Default()->FileExists(cache_.GetFilePath(key)));
+
+  std::optional<PartitionedGraphCacheEntry> loaded = cache_.TryToLoad(key);
+  ASSERT_TRUE(loaded.has_value());
+  EXPECT_EQ(entry.SerializeAsString(), loaded->SerializeAsString());
+
+  // Entries can be saved again, e.g. by concurrent processes.
+  TF_ASSERT_OK(cache_.Save(entry));
+  EXPECT_TRUE(cache_.TryToLoad(key).has_value());
+  std::vector<string> children;
+  TF_ASSERT_OK(Env::Default()->GetChildren(directory_, &children));
+  EXPECT_EQ(1, children.size());
+}
+
+TEST_F(PartitionedGraphCacheTest, KeysDependOnGraphOptionsAndConfig) {
+  const PartitionedGraphCacheKey key =
+      MakeKey(MakeGraph("a"), MakeOptions("a"), ConfigProto());
+
+  // A different graph, callable or config does not use the entry of `key`.
+  TF_ASSERT_OK(cache_.Save(MakeEntry(key)));
+  EXPECT_FALSE(cache_
+                   .TryToLoad(MakeKey(MakeGraph("other"), MakeOptions("a"),
+                                      ConfigProto()))
+                   .has_value());
+  EXPECT_FALSE(cache_
+                   .TryToLoad(MakeKey(MakeGraph("a"), MakeOptions("other"),
+                                      ConfigProto()))
+                   .has_value());
+  ConfigProto config;
+  config.set_inter_op_parallelism_threads(3);
+  EXPECT_FALSE(cache_.TryToLoad(MakeKey(MakeGraph("a"), MakeOptions("a"),
+                                        config))
+                   .has_value());
+
+  // The cache directory is not part of the key.
+  ConfigProto config_with_cache;
+  config_with_cache.mutable_experimental()
+      ->set_partitioned_graph_cache_directory(directory_);
+  EXPECT_TRUE(cache_.TryToLoad(MakeKey(MakeGraph("a"), MakeOptions("a"),
+                                       config_with_cache))
+                  .has_value());
+
+  // The fingerprint of extended graphs depends on all the graphs.
+  EXPECT_NE(PartitionedGraphCache::FingerprintGraph(0, MakeGraph("a")),
+            PartitionedGraphCache::FingerprintGraph(
+                PartitionedGraphCache::FingerprintGraph(0, MakeGraph("a")),
+                MakeGraph("b")));
+}
+
+TEST_F(PartitionedGraphCacheTest, IgnoresMismatchedEntries) {
+  PartitionedGraphCacheKey key =
+      MakeKey(MakeGraph("a"), MakeOptions("a"), ConfigProto());
+
+  // An entry written by another version is stored in the same file, but does
+  // not match the key.
+  PartitionedGraphCacheEntry entry = MakeEntry(key);
+  entry.mutable_key()->set_version("other");
+  TF_ASSERT_OK(cache_.Save(entry));
+  TF_EXPECT_OK(Env::Default()->FileExists(cache_.GetFilePath(key)));
+  EXPECT_FALSE(cache_.TryToLoad(key).has_value());
+
+  // Corrupted entries are ignored.
+  TF_ASSERT_OK(WriteStringToFile(Env::Default(), cache_.GetFilePath(key),
+                                 "not a proto"));
+  EXPECT_FALSE(cache_.TryToLoad(key).has_value());
+}
+
+TEST_F(PartitionedGraphCacheTest, PrefixNamespacesEntries) {
+  PartitionedGraphCache other_cache(Env::Default(), directory_, "other");
+  const GraphDef graph = MakeGraph("a");
+  PartitionedGraphCacheKey key = cache_.BuildKey(
+      PartitionedGraphCache::FingerprintGraph(0, graph), MakeOptions("a"),
+      ConfigProto(), /*devices=*/{});
+  PartitionedGraphCacheKey other_key = other_cache.BuildKey(
+      PartitionedGraphCache::FingerprintGraph(0, graph), MakeOptions("a"),
+      ConfigProto(), /*devices=*/{});
+  EXPECT_NE(cache_.GetFilePath(key), other_cache.GetFilePath(other_key));
+
+  TF_ASSERT_OK(cache_.Save(MakeEntry(key)));
+  EXPECT_FALSE(other_cache.TryToLoad(other_key).has_value());
+}
+
+}  // namespace
+}  // namespace tensorflow
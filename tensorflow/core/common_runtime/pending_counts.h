@@ -16,12 +16,15 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <algorithm>
 #include <atomic>
+#include <cstring>
 
 #include "tensorflow/core/lib/gtl/flatmap.h"
 #include "tensorflow/core/lib/hash/hash.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mem.h"
 #include "tensorflow/core/util/port.h"
 
 namespace tensorflow {
@@ -47,6 +50,13 @@ namespace tensorflow {
 //    PendingCounts counts(layout);
 //    ...
 //    counts.decrement_pending(h[id], 1);
+//
+// Handles are laid out in the order in which they are created, so callers
+// should create the handles of nodes that tend to be updated at the same time
+// (e.g. nodes in the same topological frontier) consecutively. Nodes that many
+// threads update concurrently, such as nodes with a wide fan-in, can be given
+// a handle on a cache line of their own with `CreateIsolatedHandle()`, so that
+// their updates do not invalidate the counts of other nodes.
 class PendingCounts {
  public:
   // The state machine for a node's execution.
@@ -73,6 +83,11 @@ class PendingCounts {
    public:
     Handle CreateHandle(size_t max_pending_count, size_t max_dead_count);
 
+    // Like `CreateHandle()`, but the counts of the returned handle do not
+    // share a cache line with the counts of any other handle.
+    Handle CreateIsolatedHandle(size_t max_pending_count,
+                                size_t max_dead_count);
+
    private:
     friend class PendingCounts;
     int next_offset_ = 0;  // Next byte offset to allocate
@@ -81,23 +96,18 @@ class PendingCounts {
   // Create a new PendingCounts object that can hold the state of
   // all the Handles allocated from "final_allocator".
   explicit PendingCounts(Layout layout)
-      : num_bytes_(layout.next_offset_), bytes_(new char[num_bytes_]()) {
-    if (num_bytes_ >= sizeof(LargeCounts)) {
-      CHECK_EQ(uintptr_t(bytes_) % alignof(LargeCounts), 0);
-    }
+      : num_bytes_(layout.next_offset_), bytes_(AllocateBytes(num_bytes_)) {
+    memset(bytes_, 0, num_bytes_);
   }
 
   // Create a new PendingCounts object with the same layout and counts
   // as "other".
   explicit PendingCounts(const PendingCounts& other)
-      : num_bytes_(other.num_bytes_), bytes_(new char[num_bytes_]) {
-    if (num_bytes_ >= sizeof(LargeCounts)) {
-      CHECK_EQ(uintptr_t(bytes_) % alignof(LargeCounts), 0);
-    }
+      : num_bytes_(other.num_bytes_), bytes_(AllocateBytes(num_bytes_)) {
     memcpy(bytes_, other.bytes_, other.num_bytes_);
   }
 
-  ~PendingCounts() { delete[] bytes_; }
+  ~PendingCounts() { port::AlignedFree(bytes_); }
 
   void set_initial_count(Handle h, size_t pending_count) {
     if (h.is_large_) {
@@ -389,6 +399,42 @@ class PendingCounts {
     }
   }
 
+  // A batched version of `adjust_for_activation()`, for a node whose
+  // `num_activations` inputs are activated at once (e.g. by several outputs
+  // of the same node), `num_dead` of which are dead. Equivalent to:
+  //    if (node_state(h) == PENDING_NOTREADY) {
+  //      for (int i = 0; i < num_dead; ++i) increment_dead_count(h);
+  //    }
+  //    decrement_pending(h, num_activations);
+  //    return {dead_count(h), pending(h)};
+  AdjustResult adjust_for_activations(Handle h, int num_activations,
+                                      int num_dead) {
+    DCHECK_GE(pending(h), num_activations);
+    DCHECK_LE(num_dead, num_activations);
+    if (h.is_large_) {
+      return adjust_for_activations_shared(Large(h), num_activations,
+                                           num_dead);
+    } else {
+      return adjust_for_activations_shared(Packed(h), num_activations,
+                                           num_dead);
+    }
+  }
+
+  // The same as the above, but performs the operation atomically. This
+  // is thread-safe to run concurrently with other threads.
+  AdjustResult adjust_for_activations_atomic(Handle h, int num_activations,
+                                             int num_dead) {
+    DCHECK_GE(pending(h), num_activations);
+    DCHECK_LE(num_dead, num_activations);
+    if (h.is_large_) {
+      return adjust_for_activations_shared_atomic(Large(h), num_activations,
+                                                  num_dead);
+    } else {
+      return adjust_for_activations_shared_atomic(Packed(h), num_activations,
+                                                  num_dead);
+    }
+  }
+
   class Handle {
    public:
     Handle() : byte_offset_(0), is_large_(0) {}
@@ -485,6 +531,37 @@ class PendingCounts {
     }
   }
 
+  template <typename T>
+  inline AdjustResult adjust_for_activations_shared(std::atomic<T>* c,
+                                                    int num_activations,
+                                                    int num_dead) {
+    T val = c->load(std::memory_order_relaxed);
+    if (PENDING_NOTREADY == NodeStateForStruct(val)) {
+      val.dead_count += num_dead;
+    }
+    DCHECK_GE(val.pending, num_activations);
+    val.pending -= num_activations;
+    c->store(val, std::memory_order_relaxed);
+    return AdjustResult(val.dead_count, val.pending);
+  }
+
+  template <typename T>
+  inline AdjustResult adjust_for_activations_shared_atomic(
+      std::atomic<T>* c, int num_activations, int num_dead) {
+    T old_val = c->load(std::memory_order_relaxed);
+    while (true) {
+      T new_val = old_val;
+      if (PENDING_NOTREADY == NodeStateForStruct(new_val)) {
+        new_val.dead_count += num_dead;
+      }
+      DCHECK_GE(new_val.pending, num_activations);
+      new_val.pending -= num_activations;
+      AdjustResult ret(new_val.dead_count, new_val.pending);
+      if (TF_PREDICT_TRUE(c->compare_exchange_weak(old_val, new_val)))
+        return ret;
+    }
+  }
+
   // We keep track of the pending count and dead input count for each
   // graph node.  The representation used here is designed to be cache
   // efficient for graphs with large numbers of nodes, where most
@@ -498,6 +575,15 @@ class PendingCounts {
   // We use 3 bits each for dead_count and pending.
   static constexpr int kMaxCountForPackedCounts = 7;
 
+  // Alignment of the counts array, and granularity of isolated handles.
+  static constexpr int kCacheLineSize = 64;
+
+  static char* AllocateBytes(int num_bytes) {
+    // `AlignedMalloc()` may return null for zero bytes.
+    return static_cast<char*>(
+        port::AlignedMalloc(std::max(num_bytes, 1), kCacheLineSize));
+  }
+
   // Most counts are small, so we pack a pending count and a dead
   // count into 3 bits each, use 1 bit to indicate that the node has
   // started computing.
@@ -568,6 +654,20 @@ inline PendingCounts::Handle PendingCounts::Layout::CreateHandle(
   return result;
 }
 
+inline PendingCounts::Handle PendingCounts::Layout::CreateIsolatedHandle(
+    size_t max_pending_count, size_t max_dead_count) {
+  // Start a new cache line, and always use `LargeCounts` since the rest of
+  // the line is padding anyway.
+  constexpr int L = kCacheLineSize;
+  static_assert(sizeof(std::atomic<LargeCounts>) <= L,
+                "std::atomic<LargeCounts> must fit in a cache line");
+  Handle result;
+  result.byte_offset_ = ((static_cast<int64_t>(next_offset_) + L - 1) / L) * L;
+  result.is_large_ = true;
+  next_offset_ = result.byte_offset_ + L;
+  return result;
+}
+
 }  // end namespace tensorflow
 
 #endif  // TENSORFLOW_CORE_COMMON_RUNTIME_PENDING_COUNTS_H_
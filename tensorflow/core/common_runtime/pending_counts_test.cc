@@ -19,8 +19,11 @@ limitations under the License.
 #include <unordered_map>
 #include <vector>
 
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/blocking_counter.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 
 using std::unique_ptr;
 
@@ -202,4 +205,150 @@ TEST(PendingCounts, AdjustForActivationAtomic) {
   EXPECT_EQ(c.pending(handles[1]), 0);
 }
 
+TEST(PendingCounts, IsolatedHandles) {
+  const int C = 20;
+  PendingCounts::Layout layout;
+  std::vector<PendingCounts::Handle> h(C);
+  for (int id = 0; id < C; id++) {
+    // Interleave isolated handles with packed and large ones.
+    h[id] = (id % 3 == 0) ? layout.CreateIsolatedHandle(id, id)
+                          : layout.CreateHandle(id, id);
+  }
+  PendingCounts c(layout);
+  for (int id = 0; id < C; id++) {
+    c.set_initial_count(h[id], id);
+  }
+  for (int id = 1; id < C; id++) {
+    c.decrement_pending(h[id], 1);
+    c.increment_dead_count(h[id]);
+  }
+  for (int id = 0; id < C; id++) {
+    EXPECT_EQ(c.pending(h[id]), std::max(id - 1, 0));
+    EXPECT_EQ(c.dead_count(h[id]), (id <= 1) ? 0 : 1);
+  }
+  PendingCounts c2(c);
+  for (int id = 0; id < C; id++) {
+    EXPECT_EQ(c.pending(h[id]), c2.pending(h[id]));
+    EXPECT_EQ(c.dead_count(h[id]), c2.dead_count(h[id]));
+  }
+}
+
+TEST(PendingCounts, AdjustForActivations) {
+  PendingCounts::Layout layout;
+  PendingCounts::Handle handles[3];
+  handles[0] = layout.CreateHandle(5, 5);
+  handles[1] = layout.CreateHandle(15, 15);
+  handles[2] = layout.CreateIsolatedHandle(5, 5);
+  for (int id = 0; id < 3; id++) {
+    PendingCounts::Handle h = handles[id];
+    // Test for packed, large and isolated.
+    int count = (id == 1) ? 15 : 5;
+
+    for (bool atomic : {false, true}) {
+      PendingCounts c(layout);
+      c.set_initial_count(h, count);
+      PendingCounts::AdjustResult result =
+          atomic ? c.adjust_for_activations_atomic(h, 2, 1)
+                 : c.adjust_for_activations(h, 2, 1);
+      EXPECT_EQ(c.pending(h), count - 2);
+      EXPECT_EQ(result.pending_count, count - 2);
+      EXPECT_EQ(c.dead_count(h), 1);
+      EXPECT_EQ(result.dead_count, 1);
+
+      result = atomic ? c.adjust_for_activations_atomic(h, count - 2, 2)
+                      : c.adjust_for_activations(h, count - 2, 2);
+      EXPECT_EQ(c.pending(h), 0);
+      EXPECT_EQ(result.pending_count, 0);
+      EXPECT_EQ(result.dead_count, 3);
+      EXPECT_EQ(c.node_state(h), PendingCounts::PENDING_READY);
+    }
+  }
+}
+
+TEST(PendingCounts, AdjustForActivationsAtomic) {
+  PendingCounts::Layout layout;
+  PendingCounts::Handle handles[2];
+  const int kInitialCounts[2] = {6, 16};
+  handles[0] = layout.CreateHandle(kInitialCounts[0], 0);
+  handles[1] = layout.CreateIsolatedHandle(kInitialCounts[1], 0);
+  PendingCounts c(layout);
+  c.set_initial_count(handles[0], kInitialCounts[0]);
+  c.set_initial_count(handles[1], kInitialCounts[1]);
+
+  Env* env = Env::Default();
+  std::atomic<bool> start{false};
+  std::vector<unique_ptr<Thread>> threads;
+  for (int t = 0; t < 2; t++) {
+    threads.emplace_back(env->StartThread({}, "tester", [&]() {
+      while (!start) {
+      }
+      for (int i = 0; i < kInitialCounts[0] / 2; i += 3) {
+        c.adjust_for_activations_atomic(handles[0], 3, 0);
+      }
+      for (int i = 0; i < kInitialCounts[1] / 2; i += 2) {
+        c.adjust_for_activations_atomic(handles[1], 2, 0);
+      }
+    }));
+  }
+  start = true;
+  threads.clear();  // Joins the threads.
+
+  EXPECT_EQ(c.pending(handles[0]), 0);
+  EXPECT_EQ(c.pending(handles[1]), 0);
+}
+
+// Measures the throughput of concurrent activations of the nodes of a wide
+// fan-in graph, where each of `num_threads` threads runs the inputs of a
+// different node. Args are the number of threads, whether the nodes have
+// isolated handles, and the number of activations applied per update (as for
+// a node with several outputs to the same consumer).
+void BM_ConcurrentActivations(::testing::benchmark::State& state) {
+  const int num_threads = state.range(0);
+  const bool isolated = state.range(1) != 0;
+  const int batch_size = state.range(2);
+  constexpr int kActivationsPerThread = 1 << 16;
+
+  PendingCounts::Layout layout;
+  std::vector<PendingCounts::Handle> handles(num_threads);
+  for (int i = 0; i < num_threads; ++i) {
+    handles[i] =
+        isolated
+            ? layout.CreateIsolatedHandle(kActivationsPerThread, 0)
+            : layout.CreateHandle(kActivationsPerThread, 0);
+  }
+  PendingCounts c(layout);
+  thread::ThreadPool pool(Env::Default(), "bench", num_threads);
+
+  for (auto s : state) {
+    for (const PendingCounts::Handle& h : handles) {
+      c.set_initial_count(h, kActivationsPerThread);
+    }
+    BlockingCounter counter(num_threads);
+    for (int t = 0; t < num_threads; ++t) {
+      pool.Schedule([&c, &counter, h = handles[t], batch_size]() {
+        for (int i = 0; i < kActivationsPerThread; i += batch_size) {
+          if (batch_size == 1) {
+            c.adjust_for_activation_atomic(h, false);
+          } else {
+            c.adjust_for_activations_atomic(h, batch_size, 0);
+          }
+        }
+        counter.DecrementCount();
+      });
+    }
+    counter.Wait();
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                          num_threads * kActivationsPerThread);
+}
+BENCHMARK(BM_ConcurrentActivations)
+    ->UseRealTime()
+    ->Apply([](benchmark::internal::Benchmark* b) {
+      for (int num_threads : {1, 2, 4, 8, 16, 32, 64}) {
+        b->Args({num_threads, /*isolated=*/0, /*batch_size=*/1});
+        b->Args({num_threads, /*isolated=*/1, /*batch_size=*/1});
+        b->Args({num_threads, /*isolated=*/1, /*batch_size=*/4});
+      }
+    });
+
 }  // namespace tensorflow
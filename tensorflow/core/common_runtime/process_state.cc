@@ -103,6 +103,18 @@ Allocator* ProcessState::GetCPUAllocator(int numa_node) {
 
       BFCAllocator::Options allocator_opts;
       allocator_opts.allow_growth = true;
+      status = ReadBoolFromEnvVar("TF_BFC_ALLOCATOR_USE_THREAD_CACHES",
+                                  /*default_val=*/false,
+                                  &allocator_opts.use_thread_caches);
+      if (!status.ok()) {
+        LOG(ERROR) << "GetCPUAllocator: " << status.message();
+      }
+      status = ReadInt64FromEnvVar("TF_BFC_ALLOCATOR_COMPACTION_INTERVAL_MS",
+                                   /*default_val=*/0,
+                                   &allocator_opts.compaction_interval_ms);
+      if (!status.ok()) {
+        LOG(ERROR) << "GetCPUAllocator: " << status.message();
+      }
       allocator = new BFCAllocator(
           absl::WrapUnique(sub_allocator), cpu_mem_limit,
           /*name=*/"bfc_cpu_allocator_for_gpu", allocator_opts);
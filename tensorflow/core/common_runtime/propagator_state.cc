@@ -437,25 +437,47 @@ int PropagatorState::FrameState::ActivateNodesFastPathInternal(
   } while (0);
 
   Entry* input_tensors = iter_state->input_tensors;
-  for (const EdgeInfo& e : item->output_edges()) {
-    const int dst_id = e.dst_id;
+  const gtl::ArraySlice<EdgeInfo> output_edges = item->output_edges();
+  for (size_t i = 0; i < output_edges.size();) {
+    const int dst_id = output_edges[i].dst_id;
     const PendingCounts::Handle dst_pending_id =
         immutable_state.pending_ids()[dst_id];
-    const int src_slot = e.output_slot;
 
-    const bool increment_dead =
-        (is_dead || ((*outputs)[src_slot].state == Entry::State::NO_VALUE));
-    const int dst_loc = e.input_slot;
-    if (e.is_last) {
-      input_tensors[dst_loc] = std::move((*outputs)[src_slot]);
+    // Consecutive edges to the same destination (e.g. from several outputs
+    // of `item` to one consumer) are applied with a single update of the
+    // destination's pending count.
+    int num_activations = 0;
+    int num_dead = 0;
+    do {
+      const EdgeInfo& e = output_edges[i];
+      const int src_slot = e.output_slot;
+      if (is_dead || ((*outputs)[src_slot].state == Entry::State::NO_VALUE)) {
+        ++num_dead;
+      }
+      const int dst_loc = e.input_slot;
+      if (e.is_last) {
+        input_tensors[dst_loc] = std::move((*outputs)[src_slot]);
+      } else {
+        input_tensors[dst_loc] = (*outputs)[src_slot];
+      }
+      ++num_activations;
+      ++i;
+    } while (i < output_edges.size() && output_edges[i].dst_id == dst_id);
+
+    PendingCounts::AdjustResult adjust_result(0, 0);
+    if (TF_PREDICT_TRUE(num_activations == 1)) {
+      adjust_result =
+          atomic ? iter_state->adjust_for_activation_atomic(dst_pending_id,
+                                                            num_dead > 0)
+                 : iter_state->adjust_for_activation(dst_pending_id,
+                                                     num_dead > 0);
     } else {
-      input_tensors[dst_loc] = (*outputs)[src_slot];
+      adjust_result =
+          atomic ? iter_state->adjust_for_activations_atomic(
+                       dst_pending_id, num_activations, num_dead)
+                 : iter_state->adjust_for_activations(
+                       dst_pending_id, num_activations, num_dead);
     }
-    const PendingCounts::AdjustResult adjust_result =
-        atomic
-            ? iter_state->adjust_for_activation_atomic(dst_pending_id,
-                                                       increment_dead)
-            : iter_state->adjust_for_activation(dst_pending_id, increment_dead);
     MAYBE_ADD_TO_READY(dst_id, adjust_result);
   }
 
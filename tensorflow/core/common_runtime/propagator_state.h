@@ -205,6 +205,16 @@ class PropagatorState {
         PendingCounts::Handle h, bool increment_dead) {
       return counts.adjust_for_activation_atomic(h, increment_dead);
     }
+    PendingCounts::AdjustResult adjust_for_activations(PendingCounts::Handle h,
+                                                       int num_activations,
+                                                       int num_dead) {
+      return counts.adjust_for_activations(h, num_activations, num_dead);
+    }
+    PendingCounts::AdjustResult adjust_for_activations_atomic(
+        PendingCounts::Handle h, int num_activations, int num_dead) {
+      return counts.adjust_for_activations_atomic(h, num_activations,
+                                                  num_dead);
+    }
 
     ~IterationState() { delete[] input_tensors; }
 
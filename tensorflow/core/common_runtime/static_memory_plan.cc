@@ -0,0 +1,452 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/static_memory_plan.h"
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <numeric>
+#include <utility>
+
+#include "tensorflow/core/framework/metrics.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace tensorflow {
+namespace {
+
+// `free_time` of recorded allocations that outlived their step.
+constexpr int64_t kEscaped = std::numeric_limits<int64_t>::max();
+
+size_t RoundUp(size_t n, size_t multiple) {
+  return (n + multiple - 1) / multiple * multiple;
+}
+
+// Pairwise disjoint lifetimes `[alloc_time, free_time]`, keyed by
+// `alloc_time`.
+using Lifetimes = std::map<int64_t, int64_t>;
+
+// Returns true if `[alloc_time, free_time]` intersects one of `lifetimes`.
+// Since those are disjoint, only the ones that start right before and at or
+// after `alloc_time` need to be checked.
+bool Overlaps(const Lifetimes& lifetimes, int64_t alloc_time,
+              int64_t free_time) {
+  auto next = lifetimes.lower_bound(alloc_time);
+  if (next != lifetimes.end() && next->first <= free_time) return true;
+  return next != lifetimes.begin() && std::prev(next)->second >= alloc_time;
+}
+
+}  // namespace
+
+// The assignment of the allocations of a step to buffers in a slab.
+struct StaticMemoryPlan::Plan {
+  struct Entry {
+    size_t num_bytes;
+    // Index into `buffer_offsets`, or -1 if the allocation is not planned.
+    int32 buffer;
+  };
+
+  // The entries of node `n` are `entries[node_begin[n]:node_begin[n + 1]]`,
+  // indexed by ordinal.
+  std::vector<int32> node_begin;
+  std::vector<Entry> entries;
+  // Offset of each buffer in the slab, in increasing order.
+  std::vector<size_t> buffer_offsets;
+  size_t slab_bytes = 0;
+};
+
+// The memory used by one step that replays a plan.
+struct StaticMemoryPlan::Slab {
+  Slab(Allocator* base, const Plan& plan)
+      : base(base),
+        data(plan.slab_bytes == 0
+                 ? nullptr
+                 : static_cast<char*>(base->AllocateRaw(
+                       Allocator::kAllocatorAlignment, plan.slab_bytes))),
+        size(data == nullptr ? 0 : plan.slab_bytes),
+        in_use(new std::atomic<bool>[plan.buffer_offsets.size()]) {
+    for (size_t i = 0; i < plan.buffer_offsets.size(); ++i) {
+      in_use[i].store(false, std::memory_order_relaxed);
+    }
+  }
+  ~Slab() {
+    if (data != nullptr) base->DeallocateRaw(data);
+  }
+
+  bool Owns(const void* ptr) const {
+    const char* p = static_cast<const char*>(ptr);
+    return p >= data && p < data + size;
+  }
+
+  Allocator* const base;
+  char* const data;
+  const size_t size;
+  // Indexed by buffer.
+  const std::unique_ptr<std::atomic<bool>[]> in_use;
+};
+
+struct StaticMemoryPlan::State {
+  explicit State(const Options& options) : options(options) {}
+
+  // Adds the allocations of a recording step that ended at `end_time`, and
+  // derives a plan once enough steps have been recorded.
+  void AddTrace(int num_nodes, std::vector<Step::Record> records,
+                int64_t end_time) {
+    for (Step::Record& record : records) {
+      DCHECK_GE(record.free_time, 0);
+      if (record.free_time > end_time) record.free_time = kEscaped;
+    }
+    std::sort(records.begin(), records.end(),
+              [](const Step::Record& a, const Step::Record& b) {
+                return a.node_id != b.node_id ? a.node_id < b.node_id
+                                              : a.ordinal < b.ordinal;
+              });
+    std::shared_ptr<const Plan> new_plan;
+    {
+      mutex_lock l(mu);
+      if (plan != nullptr || num_plans >= options.max_plans) return;
+      traces.push_back(std::move(records));
+      if (static_cast<int>(traces.size()) < options.warmup_runs) return;
+      ++num_plans;
+      new_plan = DerivePlan(num_nodes);
+      traces.clear();
+      plan = new_plan;
+    }
+    if (new_plan != nullptr) {
+      VLOG(1) << "Derived a static memory plan with "
+              << new_plan->entries.size() << " allocations in "
+              << new_plan->buffer_offsets.size() << " buffers of "
+              << new_plan->slab_bytes << " bytes in total";
+    } else {
+      VLOG(1) << "Could not derive a static memory plan, because the recorded "
+                 "steps made different allocations";
+    }
+  }
+
+  // Returns a plan for `traces`, or nullptr if they differ.
+  std::shared_ptr<const Plan> DerivePlan(int num_nodes)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(mu) {
+    const std::vector<Step::Record>& first = traces[0];
+    for (const std::vector<Step::Record>& trace : traces) {
+      if (trace.size() != first.size()) return nullptr;
+      for (size_t i = 0; i < trace.size(); ++i) {
+        if (trace[i].node_id != first[i].node_id ||
+            trace[i].ordinal != first[i].ordinal ||
+            trace[i].num_bytes != first[i].num_bytes) {
+          return nullptr;
+        }
+      }
+    }
+
+    auto plan = std::make_shared<Plan>();
+    plan->node_begin.assign(num_nodes + 1, 0);
+    plan->entries.reserve(first.size());
+    for (const Step::Record& record : first) {
+      ++plan->node_begin[record.node_id + 1];
+      plan->entries.push_back({record.num_bytes, -1});
+    }
+    std::partial_sum(plan->node_begin.begin(), plan->node_begin.end(),
+                     plan->node_begin.begin());
+
+    // Whether allocation `e` overlaps one of the allocations assigned to a
+    // buffer, whose lifetimes in each trace are `lifetimes[trace]`.
+    auto overlaps = [this](int e, const std::vector<Lifetimes>& lifetimes) {
+      for (size_t t = 0; t < traces.size(); ++t) {
+        if (Overlaps(lifetimes[t], traces[t][e].alloc_time,
+                     traces[t][e].free_time)) {
+          return true;
+        }
+      }
+      return false;
+    };
+
+    // Greedy assignment by decreasing size: each allocation goes to the first
+    // buffer whose allocations never overlapped with it, so the size of each
+    // buffer is the size of its first allocation.
+    std::vector<int> order(first.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&first](int a, int b) {
+      return first[a].num_bytes > first[b].num_bytes;
+    });
+    // Indexed by buffer, then by trace.
+    std::vector<std::vector<Lifetimes>> buffer_lifetimes;
+    for (int e : order) {
+      bool escaped = false;
+      for (const std::vector<Step::Record>& trace : traces) {
+        escaped |= trace[e].free_time == kEscaped;
+      }
+      if (escaped) continue;
+      size_t buffer = 0;
+      while (buffer < buffer_lifetimes.size() &&
+             overlaps(e, buffer_lifetimes[buffer])) {
+        ++buffer;
+      }
+      if (buffer == buffer_lifetimes.size()) {
+        const size_t buffer_bytes = RoundUp(
+            std::max<size_t>(first[e].num_bytes, 1),
+            Allocator::kAllocatorAlignment);
+        if (plan->slab_bytes + buffer_bytes > options.max_plan_bytes) continue;
+        plan->buffer_offsets.push_back(plan->slab_bytes);
+        plan->slab_bytes += buffer_bytes;
+        buffer_lifetimes.emplace_back(traces.size());
+      }
+      for (size_t t = 0; t < traces.size(); ++t) {
+        buffer_lifetimes[buffer][t].emplace(traces[t][e].alloc_time,
+                                            traces[t][e].free_time);
+      }
+      plan->entries[e].buffer = buffer;
+    }
+    return plan;
+  }
+
+  // Called when a step that replayed `step_plan` has ended and all of its
+  // allocations have been deallocated.
+  void EndReplay(const Plan* step_plan, Slab* slab, bool mismatched) {
+    std::vector<Slab*> free_slabs;
+    {
+      mutex_lock l(mu);
+      if (step_plan == plan.get()) {
+        mismatched_steps = mismatched ? mismatched_steps + 1 : 0;
+        if (mismatched_steps >= options.warmup_runs) {
+          // The shapes have changed. Record new steps, if allowed.
+          VLOG(1) << "Discarding a static memory plan after "
+                  << mismatched_steps << " steps that it did not cover";
+          plan.reset();
+          mismatched_steps = 0;
+          std::swap(free_slabs, idle_slabs);
+          free_slabs.push_back(slab);
+        } else if (open && static_cast<int>(idle_slabs.size()) <
+                                   options.max_idle_slabs) {
+          idle_slabs.push_back(slab);
+        } else {
+          free_slabs.push_back(slab);
+        }
+      } else {
+        free_slabs.push_back(slab);
+      }
+    }
+    for (Slab* s : free_slabs) delete s;
+  }
+
+  const Options options;
+
+  mutex mu;
+  // False once the `StaticMemoryPlan` has been destroyed.
+  bool open TF_GUARDED_BY(mu) = true;
+  // The plan replayed by new steps. If null, new steps record their
+  // allocations, unless `num_plans` has reached `options.max_plans`.
+  std::shared_ptr<const Plan> plan TF_GUARDED_BY(mu);
+  int num_plans TF_GUARDED_BY(mu) = 0;
+  // Number of consecutive steps that made allocations not covered by `plan`.
+  int mismatched_steps TF_GUARDED_BY(mu) = 0;
+  // Sorted by node id and ordinal.
+  std::vector<std::vector<Step::Record>> traces TF_GUARDED_BY(mu);
+  // Slabs for `plan` that are not used by any step.
+  std::vector<Slab*> idle_slabs TF_GUARDED_BY(mu);
+};
+
+class StaticMemoryPlan::NodeAllocator : public Allocator {
+ public:
+  std::string Name() override { return "static_memory_plan"; }
+
+  void* AllocateRaw(size_t alignment, size_t num_bytes) override {
+    return step_->AllocateRaw(
+        node_id_, next_ordinal_.fetch_add(1, std::memory_order_relaxed),
+        alignment, num_bytes);
+  }
+
+  void DeallocateRaw(void* ptr) override { step_->DeallocateRaw(ptr); }
+
+  AllocatorMemoryType GetMemoryType() const override {
+    return step_->base_->GetMemoryType();
+  }
+
+ private:
+  friend class StaticMemoryPlan::Step;
+
+  Step* step_ = nullptr;
+  int32 node_id_ = 0;
+  std::atomic<int32> next_ordinal_{0};
+};
+
+StaticMemoryPlan::StaticMemoryPlan(Allocator* base, int num_nodes,
+                                   const Options& options)
+    : base_(base),
+      num_nodes_(num_nodes),
+      state_(std::make_shared<State>(options)) {
+  DCHECK_GT(options.warmup_runs, 0);
+}
+
+StaticMemoryPlan::~StaticMemoryPlan() {
+  std::vector<Slab*> idle_slabs;
+  {
+    mutex_lock l(state_->mu);
+    state_->open = false;
+    std::swap(idle_slabs, state_->idle_slabs);
+  }
+  for (Slab* slab : idle_slabs) delete slab;
+}
+
+StaticMemoryPlan::Step* StaticMemoryPlan::StartStep() {
+  std::shared_ptr<const Plan> plan;
+  Slab* slab = nullptr;
+  {
+    mutex_lock l(state_->mu);
+    if (state_->plan != nullptr) {
+      plan = state_->plan;
+      if (!state_->idle_slabs.empty()) {
+        slab = state_->idle_slabs.back();
+        state_->idle_slabs.pop_back();
+      }
+    } else if (state_->num_plans >= state_->options.max_plans) {
+      return nullptr;
+    }
+  }
+  if (plan != nullptr && slab == nullptr) {
+    slab = new Slab(base_, *plan);
+    if (slab->data == nullptr && plan->slab_bytes > 0) {
+      delete slab;
+      return nullptr;
+    }
+  }
+  return new Step(base_, num_nodes_, state_, std::move(plan), slab);
+}
+
+bool StaticMemoryPlan::has_plan() const {
+  mutex_lock l(state_->mu);
+  return state_->plan != nullptr;
+}
+
+size_t StaticMemoryPlan::plan_bytes() const {
+  mutex_lock l(state_->mu);
+  return state_->plan == nullptr ? 0 : state_->plan->slab_bytes;
+}
+
+StaticMemoryPlan::Step::Step(Allocator* base, int num_nodes,
+                             std::shared_ptr<State> state,
+                             std::shared_ptr<const Plan> plan, Slab* slab)
+    : base_(base),
+      num_nodes_(num_nodes),
+      state_(std::move(state)),
+      plan_(std::move(plan)),
+      slab_(slab),
+      node_allocators_(new NodeAllocator[num_nodes]) {
+  for (int i = 0; i < num_nodes; ++i) {
+    node_allocators_[i].step_ = this;
+    node_allocators_[i].node_id_ = i;
+  }
+}
+
+StaticMemoryPlan::Step::~Step() = default;
+
+Allocator* StaticMemoryPlan::Step::allocator(int node_id) {
+  return &node_allocators_[node_id];
+}
+
+void StaticMemoryPlan::Step::Release() {
+  if (plan_ == nullptr) {
+    mutex_lock l(mu_);
+    end_time_ = clock_.fetch_add(1, std::memory_order_relaxed);
+  }
+  Unref();
+}
+
+void* StaticMemoryPlan::Step::AllocateRaw(int32 node_id, int32 ordinal,
+                                          size_t alignment, size_t num_bytes) {
+  refs_.fetch_add(1, std::memory_order_relaxed);
+  if (plan_ == nullptr) {
+    void* ptr = base_->AllocateRaw(alignment, num_bytes);
+    if (ptr == nullptr) {
+      Unref();
+      return nullptr;
+    }
+    const int64_t now = clock_.fetch_add(1, std::memory_order_relaxed);
+    mutex_lock l(mu_);
+    live_records_[ptr] = records_.size();
+    records_.push_back({node_id, ordinal, num_bytes, now, -1});
+    return ptr;
+  }
+
+  const int32 begin = plan_->node_begin[node_id];
+  const int32 end = plan_->node_begin[node_id + 1];
+  if (ordinal < end - begin &&
+      plan_->entries[begin + ordinal].num_bytes == num_bytes) {
+    const int32 buffer = plan_->entries[begin + ordinal].buffer;
+    bool expected = false;
+    // The buffer may still be used by another allocation if the nodes run in
+    // a different order than in the recorded steps.
+    if (buffer >= 0 && alignment <= Allocator::kAllocatorAlignment &&
+        slab_->in_use[buffer].compare_exchange_strong(
+            expected, true, std::memory_order_acquire)) {
+      num_planned_.fetch_add(1, std::memory_order_relaxed);
+      return slab_->data + plan_->buffer_offsets[buffer];
+    }
+  } else {
+    mismatched_.store(true, std::memory_order_relaxed);
+  }
+  num_unplanned_.fetch_add(1, std::memory_order_relaxed);
+  void* ptr = base_->AllocateRaw(alignment, num_bytes);
+  if (ptr == nullptr) Unref();
+  return ptr;
+}
+
+void StaticMemoryPlan::Step::DeallocateRaw(void* ptr) {
+  if (plan_ == nullptr) {
+    const int64_t now = clock_.fetch_add(1, std::memory_order_relaxed);
+    {
+      mutex_lock l(mu_);
+      auto it = live_records_.find(ptr);
+      DCHECK(it != live_records_.end());
+      records_[it->second].free_time = now;
+      live_records_.erase(it);
+    }
+    base_->DeallocateRaw(ptr);
+  } else if (slab_->Owns(ptr)) {
+    const size_t offset = static_cast<char*>(ptr) - slab_->data;
+    const auto it = std::upper_bound(plan_->buffer_offsets.begin(),
+                                     plan_->buffer_offsets.end(), offset);
+    slab_->in_use[it - plan_->buffer_offsets.begin() - 1].store(
+        false, std::memory_order_release);
+  } else {
+    base_->DeallocateRaw(ptr);
+  }
+  Unref();
+}
+
+void StaticMemoryPlan::Step::Unref() {
+  if (refs_.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+
+  // The step has ended and all of its allocations have been deallocated.
+  if (plan_ == nullptr) {
+    int64_t end_time;
+    std::vector<Record> records;
+    {
+      mutex_lock l(mu_);
+      end_time = end_time_;
+      std::swap(records, records_);
+    }
+    state_->AddTrace(num_nodes_, std::move(records), end_time);
+  } else {
+    metrics::RecordStaticMemoryPlanAllocations(
+        num_planned_.load(std::memory_order_relaxed),
+        num_unplanned_.load(std::memory_order_relaxed));
+    state_->EndReplay(plan_.get(), slab_,
+                      mismatched_.load(std::memory_order_relaxed));
+  }
+  delete this;
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,165 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_STATIC_MEMORY_PLAN_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_STATIC_MEMORY_PLAN_H_
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// Records the allocations made by the nodes of an executor during its first
+// steps, derives a static assignment of those allocations to buffers, and
+// serves the allocations of later steps from the assigned buffers.
+//
+// An allocation is identified by the node that made it and its ordinal among
+// the allocations of that node in the step. Once `Options::warmup_runs` steps
+// have made the same allocations (with the same sizes), allocations whose
+// lifetimes never overlapped in any of these steps are assigned to the same
+// buffer, and the buffers are laid out in a single slab per step. Allocations
+// that outlived their step in any recorded step (e.g. fetched outputs) are not
+// planned.
+//
+// Replaying the plan is safe even if a step runs its nodes in a different
+// order than the recorded steps, or if the shapes change: an allocation only
+// uses its buffer if it has the recorded size and the buffer is not in use,
+// and otherwise falls back to the base allocator. If `Options::warmup_runs`
+// consecutive steps make allocations that the plan does not cover, the plan is
+// discarded and new steps are recorded.
+class StaticMemoryPlan {
+ public:
+  struct Options {
+    // Number of steps that are recorded before deriving a plan.
+    int warmup_runs = 2;
+
+    // Maximum size of the slab of a step. Allocations that do not fit are not
+    // planned.
+    size_t max_plan_bytes = 256 << 20;
+
+    // Maximum number of times that recorded steps are used to derive a plan,
+    // including attempts that fail because the steps made different
+    // allocations. After that, and once the last plan has been discarded, the
+    // steps of the executor neither record nor replay allocations.
+    int max_plans = 3;
+
+    // Maximum number of idle slabs kept for reuse by concurrent steps.
+    int max_idle_slabs = 4;
+  };
+
+  class Step;
+
+  // `base` must outlive the `StaticMemoryPlan` and all of its steps.
+  StaticMemoryPlan(Allocator* base, int num_nodes, const Options& options);
+  ~StaticMemoryPlan();
+
+  // Returns the state of a new step, or nullptr if the steps of this executor
+  // should use the base allocator directly. The caller must call
+  // `Step::Release()` when the step ends.
+  Step* StartStep();
+
+  // Returns true if steps currently replay a plan.
+  bool has_plan() const;
+
+  // Size of the slab of the current plan, or 0 if there is no plan.
+  size_t plan_bytes() const;
+
+ private:
+  struct Plan;
+  struct Slab;
+  struct State;
+  class NodeAllocator;
+
+  Allocator* const base_;
+  const int num_nodes_;
+  const std::shared_ptr<State> state_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(StaticMemoryPlan);
+};
+
+// The allocation state of one executor step. Deletes itself once the step has
+// been released and all allocations made through it have been deallocated.
+class StaticMemoryPlan::Step {
+ public:
+  // Returns the allocator for the allocations of node `node_id` in this step.
+  Allocator* allocator(int node_id);
+
+  // Signals that the step has ended. The step must not be used for new
+  // allocations after this call.
+  void Release();
+
+ private:
+  friend class StaticMemoryPlan;
+  friend class StaticMemoryPlan::NodeAllocator;
+
+  // An allocation made by a recording step.
+  struct Record {
+    int32 node_id;
+    int32 ordinal;
+    size_t num_bytes;
+    int64_t alloc_time;
+    int64_t free_time;  // -1 while the allocation is live.
+  };
+
+  Step(Allocator* base, int num_nodes, std::shared_ptr<State> state,
+       std::shared_ptr<const Plan> plan, Slab* slab);
+  ~Step();
+
+  void* AllocateRaw(int32 node_id, int32 ordinal, size_t alignment,
+                    size_t num_bytes);
+  void DeallocateRaw(void* ptr);
+  void Unref();
+
+  Allocator* const base_;
+  const int num_nodes_;
+  const std::shared_ptr<State> state_;
+  // If null, the step records its allocations. Otherwise, the step replays
+  // `plan_` using the buffers in `slab_`.
+  const std::shared_ptr<const Plan> plan_;
+  Slab* const slab_;
+
+  std::unique_ptr<NodeAllocator[]> node_allocators_;
+
+  // One reference for the step, plus one for every allocation that has not
+  // been deallocated yet.
+  std::atomic<int64_t> refs_{1};
+
+  // Replaying steps only.
+  std::atomic<int64_t> num_planned_{0};
+  std::atomic<int64_t> num_unplanned_{0};
+  std::atomic<bool> mismatched_{false};
+
+  // Recording steps only.
+  std::atomic<int64_t> clock_{0};
+  mutex mu_;
+  int64_t end_time_ TF_GUARDED_BY(mu_) = -1;
+  std::vector<Record> records_ TF_GUARDED_BY(mu_);
+  absl::flat_hash_map<void*, int> live_records_ TF_GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(Step);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_STATIC_MEMORY_PLAN_H_
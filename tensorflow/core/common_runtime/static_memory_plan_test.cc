@@ -0,0 +1,182 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/static_memory_plan.h"
+
+#include <vector>
+
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+constexpr size_t kAlignment = Allocator::kAllocatorAlignment;
+
+struct StepPointers {
+  void* a = nullptr;
+  void* b = nullptr;
+  void* c = nullptr;
+};
+
+// Node 0 allocates `a_bytes`, node 1 allocates 200 bytes, node 0 frees its
+// allocation, and node 2 allocates 100 bytes. If `escape` is true, the
+// allocation of node 2 is freed after the end of the step.
+StepPointers RunStep(StaticMemoryPlan* plan, size_t a_bytes = 100,
+                     bool escape = false) {
+  StepPointers ptrs;
+  StaticMemoryPlan::Step* step = plan->StartStep();
+  EXPECT_NE(nullptr, step);
+  ptrs.a = step->allocator(0)->AllocateRaw(kAlignment, a_bytes);
+  ptrs.b = step->allocator(1)->AllocateRaw(kAlignment, 200);
+  step->allocator(0)->DeallocateRaw(ptrs.a);
+  ptrs.c = step->allocator(2)->AllocateRaw(kAlignment, 100);
+  step->allocator(1)->DeallocateRaw(ptrs.b);
+  if (!escape) step->allocator(2)->DeallocateRaw(ptrs.c);
+  step->Release();
+  if (escape) step->allocator(2)->DeallocateRaw(ptrs.c);
+  return ptrs;
+}
+
+TEST(StaticMemoryPlanTest, ReusesBuffersOfDisjointAllocations) {
+  StaticMemoryPlan::Options options;
+  options.warmup_runs = 2;
+  StaticMemoryPlan plan(cpu_allocator(), /*num_nodes=*/3, options);
+  RunStep(&plan);
+  EXPECT_FALSE(plan.has_plan());
+  RunStep(&plan);
+  ASSERT_TRUE(plan.has_plan());
+  // The allocations of nodes 0 and 2 share a buffer.
+  EXPECT_EQ(256 + 128, plan.plan_bytes());
+
+  StepPointers first = RunStep(&plan);
+  EXPECT_EQ(first.a, first.c);
+  EXPECT_NE(first.a, first.b);
+  // The next step reuses the same slab.
+  StepPointers second = RunStep(&plan);
+  EXPECT_EQ(first.a, second.a);
+  EXPECT_EQ(first.b, second.b);
+}
+
+TEST(StaticMemoryPlanTest, PacksSequentialAllocationsIntoOneBuffer) {
+  constexpr int kNumNodes = 9;
+  StaticMemoryPlan::Options options;
+  options.warmup_runs = 2;
+  StaticMemoryPlan plan(cpu_allocator(), kNumNodes, options);
+  // Node 0 holds 200 bytes for the whole step, while nodes 1 to 8 each
+  // allocate and free 100 bytes in turn.
+  auto run_step = [&plan]() {
+    std::vector<void*> ptrs(kNumNodes);
+    StaticMemoryPlan::Step* step = plan.StartStep();
+    EXPECT_NE(nullptr, step);
+    ptrs[0] = step->allocator(0)->AllocateRaw(kAlignment, 200);
+    for (int n = 1; n < kNumNodes; ++n) {
+      ptrs[n] = step->allocator(n)->AllocateRaw(kAlignment, 100);
+      step->allocator(n)->DeallocateRaw(ptrs[n]);
+    }
+    step->allocator(0)->DeallocateRaw(ptrs[0]);
+    step->Release();
+    return ptrs;
+  };
+  run_step();
+  run_step();
+  ASSERT_TRUE(plan.has_plan());
+  EXPECT_EQ(256 + 128, plan.plan_bytes());
+
+  std::vector<void*> ptrs = run_step();
+  for (int n = 2; n < kNumNodes; ++n) {
+    EXPECT_EQ(ptrs[1], ptrs[n]);
+  }
+  EXPECT_NE(ptrs[0], ptrs[1]);
+}
+
+TEST(StaticMemoryPlanTest, DoesNotPlanEscapingAllocations) {
+  StaticMemoryPlan::Options options;
+  options.warmup_runs = 1;
+  StaticMemoryPlan plan(cpu_allocator(), /*num_nodes=*/3, options);
+  RunStep(&plan, /*a_bytes=*/100, /*escape=*/true);
+  ASSERT_TRUE(plan.has_plan());
+  EXPECT_EQ(256 + 128, plan.plan_bytes());
+  StepPointers ptrs = RunStep(&plan, /*a_bytes=*/100, /*escape=*/true);
+  EXPECT_NE(ptrs.a, ptrs.c);
+}
+
+TEST(StaticMemoryPlanTest, FallsBackWhenBufferIsInUse) {
+  StaticMemoryPlan::Options options;
+  options.warmup_runs = 1;
+  StaticMemoryPlan plan(cpu_allocator(), /*num_nodes=*/3, options);
+  RunStep(&plan);
+  ASSERT_TRUE(plan.has_plan());
+
+  // Node 2 allocates before node 0 frees its allocation, unlike in the
+  // recorded step.
+  StaticMemoryPlan::Step* step = plan.StartStep();
+  void* a = step->allocator(0)->AllocateRaw(kAlignment, 100);
+  void* c = step->allocator(2)->AllocateRaw(kAlignment, 100);
+  EXPECT_NE(a, c);
+  step->allocator(0)->DeallocateRaw(a);
+  step->allocator(2)->DeallocateRaw(c);
+  step->Release();
+  EXPECT_TRUE(plan.has_plan());
+}
+
+TEST(StaticMemoryPlanTest, RecordsAgainWhenShapesChange) {
+  StaticMemoryPlan::Options options;
+  options.warmup_runs = 2;
+  StaticMemoryPlan plan(cpu_allocator(), /*num_nodes=*/3, options);
+  RunStep(&plan);
+  RunStep(&plan);
+  ASSERT_TRUE(plan.has_plan());
+
+  RunStep(&plan, /*a_bytes=*/1000);
+  EXPECT_TRUE(plan.has_plan());
+  RunStep(&plan, /*a_bytes=*/1000);
+  EXPECT_FALSE(plan.has_plan());
+
+  RunStep(&plan, /*a_bytes=*/1000);
+  RunStep(&plan, /*a_bytes=*/1000);
+  ASSERT_TRUE(plan.has_plan());
+  EXPECT_EQ(1024 + 256, plan.plan_bytes());
+}
+
+TEST(StaticMemoryPlanTest, StopsAfterMaxPlans) {
+  StaticMemoryPlan::Options options;
+  options.warmup_runs = 2;
+  options.max_plans = 1;
+  StaticMemoryPlan plan(cpu_allocator(), /*num_nodes=*/3, options);
+  RunStep(&plan, /*a_bytes=*/100);
+  RunStep(&plan, /*a_bytes=*/1000);
+  EXPECT_FALSE(plan.has_plan());
+  EXPECT_EQ(nullptr, plan.StartStep());
+}
+
+TEST(StaticMemoryPlanTest, StepOutlivesPlan) {
+  StaticMemoryPlan::Options options;
+  options.warmup_runs = 1;
+  StaticMemoryPlan::Step* step;
+  void* ptr;
+  {
+    StaticMemoryPlan plan(cpu_allocator(), /*num_nodes=*/3, options);
+    RunStep(&plan);
+    step = plan.StartStep();
+    ptr = step->allocator(1)->AllocateRaw(kAlignment, 200);
+    step->Release();
+  }
+  // Deletes the step and its slab.
+  step->allocator(1)->DeallocateRaw(ptr);
+}
+
+}  // namespace
+}  // namespace tensorflow
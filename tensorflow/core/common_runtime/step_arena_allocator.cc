@@ -0,0 +1,194 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/step_arena_allocator.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+namespace {
+
+size_t RoundUp(size_t n, size_t multiple) {
+  return (n + multiple - 1) / multiple * multiple;
+}
+
+// Total size of the slabs of the idle arenas of all pools in the process.
+std::atomic<size_t> idle_bytes_in_process{0};
+
+size_t MaxProcessIdleBytes() {
+  static const size_t max_idle_bytes = [] {
+    int64_t value = 0;
+    TF_CHECK_OK(ReadInt64FromEnvVar("TF_STEP_ARENA_MAX_IDLE_BYTES",
+                                    /*default_val=*/256 << 20, &value));
+    return static_cast<size_t>(std::max<int64_t>(value, 0));
+  }();
+  return max_idle_bytes;
+}
+
+// Adds `bytes` to `idle_bytes_in_process` and returns true, unless that would
+// exceed `MaxProcessIdleBytes()`.
+bool TryAddProcessIdleBytes(size_t bytes) {
+  size_t current = idle_bytes_in_process.load(std::memory_order_relaxed);
+  do {
+    if (current + bytes > MaxProcessIdleBytes()) return false;
+  } while (!idle_bytes_in_process.compare_exchange_weak(
+      current, current + bytes, std::memory_order_relaxed));
+  return true;
+}
+
+void RemoveProcessIdleBytes(size_t bytes) {
+  idle_bytes_in_process.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+}  // namespace
+
+// State shared between a `StepArenaPool` and the arenas it created, which may
+// outlive the pool.
+struct StepArenaAllocator::PoolState {
+  explicit PoolState(const StepArenaPool::Options& options)
+      : options(options) {}
+
+  const StepArenaPool::Options options;
+
+  mutex mu;
+  // False once the pool has been destroyed.
+  bool open TF_GUARDED_BY(mu) = true;
+  size_t target_capacity TF_GUARDED_BY(mu) = 0;
+  std::vector<StepArenaAllocator*> idle_arenas TF_GUARDED_BY(mu);
+};
+
+StepArenaAllocator::StepArenaAllocator(Allocator* base,
+                                       std::shared_ptr<PoolState> pool_state)
+    : base_(base), pool_state_(std::move(pool_state)) {}
+
+StepArenaAllocator::~StepArenaAllocator() {
+  if (slab_ != nullptr) {
+    base_->DeallocateRaw(slab_);
+  }
+}
+
+void StepArenaAllocator::Reset(size_t capacity) {
+  if (capacity > capacity_) {
+    if (slab_ != nullptr) {
+      base_->DeallocateRaw(slab_);
+    }
+    slab_ = static_cast<char*>(
+        base_->AllocateRaw(Allocator::kAllocatorAlignment, capacity));
+    capacity_ = slab_ == nullptr ? 0 : capacity;
+  }
+  offset_.store(0, std::memory_order_relaxed);
+  bytes_requested_.store(0, std::memory_order_relaxed);
+  refs_.store(1, std::memory_order_release);
+}
+
+void* StepArenaAllocator::AllocateRaw(size_t alignment, size_t num_bytes) {
+  refs_.fetch_add(1, std::memory_order_relaxed);
+  const size_t size =
+      RoundUp(std::max<size_t>(num_bytes, 1), Allocator::kAllocatorAlignment);
+  bytes_requested_.fetch_add(size, std::memory_order_relaxed);
+  // The slab is aligned to `kAllocatorAlignment`, so larger alignments cannot
+  // be served from it.
+  if (size <= capacity_ && alignment <= Allocator::kAllocatorAlignment) {
+    const size_t offset = offset_.fetch_add(size, std::memory_order_relaxed);
+    if (offset + size <= capacity_) {
+      return slab_ + offset;
+    }
+  }
+  void* ptr = base_->AllocateRaw(alignment, num_bytes);
+  if (ptr == nullptr) Unref();
+  return ptr;
+}
+
+void StepArenaAllocator::DeallocateRaw(void* ptr) {
+  if (!Owns(ptr)) {
+    base_->DeallocateRaw(ptr);
+  }
+  Unref();
+}
+
+void StepArenaAllocator::Unref() {
+  if (refs_.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+
+  // The step has ended and all of its allocations have been deallocated, so
+  // the slab can be reused.
+  const size_t bytes_requested =
+      bytes_requested_.load(std::memory_order_relaxed);
+  {
+    mutex_lock l(pool_state_->mu);
+    pool_state_->target_capacity = std::min(
+        pool_state_->options.max_arena_bytes,
+        std::max(pool_state_->target_capacity,
+                 bytes_requested));
+    if (pool_state_->open &&
+        pool_state_->idle_arenas.size() <
+            pool_state_->options.max_idle_arenas &&
+        TryAddProcessIdleBytes(capacity_)) {
+      pool_state_->idle_arenas.push_back(this);
+      return;
+    }
+  }
+  delete this;
+}
+
+StepArenaPool::StepArenaPool(Allocator* base, const Options& options)
+    : base_(base),
+      state_(std::make_shared<StepArenaAllocator::PoolState>(options)) {}
+
+StepArenaPool::~StepArenaPool() {
+  std::vector<StepArenaAllocator*> idle_arenas;
+  {
+    mutex_lock l(state_->mu);
+    state_->open = false;
+    std::swap(idle_arenas, state_->idle_arenas);
+  }
+  for (StepArenaAllocator* arena : idle_arenas) {
+    RemoveProcessIdleBytes(arena->capacity());
+    delete arena;
+  }
+}
+
+StepArenaAllocator* StepArenaPool::Acquire() {
+  StepArenaAllocator* arena = nullptr;
+  size_t target_capacity;
+  {
+    mutex_lock l(state_->mu);
+    target_capacity = state_->target_capacity;
+    if (!state_->idle_arenas.empty()) {
+      arena = state_->idle_arenas.back();
+      state_->idle_arenas.pop_back();
+      RemoveProcessIdleBytes(arena->capacity());
+    }
+  }
+  if (arena == nullptr) {
+    arena = new StepArenaAllocator(base_, state_);
+  }
+  arena->Reset(target_capacity);
+  return arena;
+}
+
+size_t StepArenaPool::target_capacity() const {
+  mutex_lock l(state_->mu);
+  return state_->target_capacity;
+}
+
+size_t StepArenaPool::process_idle_bytes() {
+  return idle_bytes_in_process.load(std::memory_order_relaxed);
+}
+
+}  // namespace tensorflow
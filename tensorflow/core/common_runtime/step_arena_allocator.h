@@ -0,0 +1,148 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_STEP_ARENA_ALLOCATOR_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_STEP_ARENA_ALLOCATOR_H_
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+class StepArenaPool;
+
+// An allocator that serves the allocations of a single executor step from a
+// contiguous slab by bumping an offset, without locking. Allocations that do
+// not fit in the slab are forwarded to a base allocator.
+//
+// Memory in the slab is never reused during a step. Instead, the whole slab
+// becomes reusable once the step has ended *and* every allocation made through
+// the arena (including those that outlived the step, such as fetched outputs)
+// has been deallocated. At that point the arena returns to the `StepArenaPool`
+// that created it, or deletes itself if the pool no longer exists.
+class StepArenaAllocator : public Allocator {
+ public:
+  ~StepArenaAllocator() override;
+
+  std::string Name() override { return "step_arena"; }
+  void* AllocateRaw(size_t alignment, size_t num_bytes) override;
+  void DeallocateRaw(void* ptr) override;
+  AllocatorMemoryType GetMemoryType() const override {
+    return base_->GetMemoryType();
+  }
+
+  // Signals that the step that acquired this arena has ended. The arena must
+  // not be used for new allocations after this call.
+  void Release() { Unref(); }
+
+  // Size of the slab, in bytes.
+  size_t capacity() const { return capacity_; }
+
+  // Returns true if `ptr` points into the slab.
+  bool Owns(const void* ptr) const {
+    const char* p = static_cast<const char*>(ptr);
+    return p >= slab_ && p < slab_ + capacity_;
+  }
+
+ private:
+  friend class StepArenaPool;
+  struct PoolState;
+
+  StepArenaAllocator(Allocator* base, std::shared_ptr<PoolState> pool_state);
+
+  // (Re)allocates the slab with at least `capacity` bytes and resets the arena
+  // for use by a new step.
+  void Reset(size_t capacity);
+
+  void Unref();
+
+  Allocator* const base_;
+  const std::shared_ptr<PoolState> pool_state_;
+
+  char* slab_ = nullptr;
+  size_t capacity_ = 0;
+
+  // Offset of the next free byte in `slab_`. May exceed `capacity_`.
+  std::atomic<size_t> offset_{0};
+  // One reference for the step that acquired the arena, plus one for every
+  // allocation that has not been deallocated yet.
+  std::atomic<int64_t> refs_{0};
+  // Total bytes requested from this arena during the current use, rounded up
+  // to `kAllocatorAlignment`, including requests forwarded to `base_`.
+  std::atomic<size_t> bytes_requested_{0};
+
+  TF_DISALLOW_COPY_AND_ASSIGN(StepArenaAllocator);
+};
+
+// A pool of `StepArenaAllocator`s for the steps of one executor.
+//
+// The size of the slabs is learned from previous steps: the first step runs
+// with an empty slab (so that all of its allocations go to the base
+// allocator), and later arenas are sized to hold all the bytes requested by
+// the largest step seen so far, up to `Options::max_arena_bytes`. Since memory
+// is not reused within a step, this is the sum of the step's allocations
+// rather than its peak. For graphs with fixed shapes, every step after the
+// first serves its intermediate tensors without calling into the base
+// allocator.
+//
+// Idle arenas are kept for reuse only while the slabs of the idle arenas of
+// all pools in the process total at most TF_STEP_ARENA_MAX_IDLE_BYTES bytes
+// (256MB by default); other arenas are freed when they are released.
+class StepArenaPool {
+ public:
+  struct Options {
+    // Maximum size of a single arena's slab. Steps that request more than this
+    // forward the excess to the base allocator.
+    size_t max_arena_bytes = 64 << 20;
+
+    // Maximum number of idle arenas kept for reuse. Concurrent steps beyond
+    // this number allocate new arenas, which are freed when they are released.
+    int max_idle_arenas = 4;
+  };
+
+  // `base` must outlive the pool and all arenas acquired from it.
+  explicit StepArenaPool(Allocator* base)
+      : StepArenaPool(base, Options()) {}
+  StepArenaPool(Allocator* base, const Options& options);
+  ~StepArenaPool();
+
+  // Returns an arena for a new step. The caller must call `Release()` on the
+  // returned arena when the step ends.
+  StepArenaAllocator* Acquire();
+
+  // The slab size that newly acquired arenas will have.
+  size_t target_capacity() const;
+
+  // Returns the total size of the slabs of the idle arenas of all pools.
+  static size_t process_idle_bytes();
+
+ private:
+  Allocator* const base_;
+  const std::shared_ptr<StepArenaAllocator::PoolState> state_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(StepArenaPool);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_STEP_ARENA_ALLOCATOR_H_
@@ -0,0 +1,145 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/step_arena_allocator.h"
+
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+TEST(StepArenaAllocatorTest, FirstStepUsesBaseAllocator) {
+  StepArenaPool pool(cpu_allocator());
+  StepArenaAllocator* arena = pool.Acquire();
+  EXPECT_EQ(0, arena->capacity());
+  void* ptr = arena->AllocateRaw(Allocator::kAllocatorAlignment, 100);
+  ASSERT_NE(nullptr, ptr);
+  EXPECT_FALSE(arena->Owns(ptr));
+  arena->DeallocateRaw(ptr);
+  arena->Release();
+  EXPECT_EQ(128, pool.target_capacity());
+}
+
+TEST(StepArenaAllocatorTest, LaterStepsUseSlab) {
+  StepArenaPool pool(cpu_allocator());
+  StepArenaAllocator* arena = pool.Acquire();
+  arena->DeallocateRaw(arena->AllocateRaw(Allocator::kAllocatorAlignment, 64));
+  arena->DeallocateRaw(arena->AllocateRaw(Allocator::kAllocatorAlignment, 100));
+  arena->Release();
+
+  arena = pool.Acquire();
+  EXPECT_EQ(192, arena->capacity());
+  std::vector<void*> ptrs;
+  ptrs.push_back(arena->AllocateRaw(Allocator::kAllocatorAlignment, 64));
+  ptrs.push_back(arena->AllocateRaw(Allocator::kAllocatorAlignment, 100));
+  // Does not fit in the slab.
+  ptrs.push_back(arena->AllocateRaw(Allocator::kAllocatorAlignment, 1));
+  EXPECT_TRUE(arena->Owns(ptrs[0]));
+  EXPECT_TRUE(arena->Owns(ptrs[1]));
+  EXPECT_NE(ptrs[0], ptrs[1]);
+  EXPECT_FALSE(arena->Owns(ptrs[2]));
+  for (void* ptr : ptrs) arena->DeallocateRaw(ptr);
+  arena->Release();
+  EXPECT_EQ(256, pool.target_capacity());
+}
+
+TEST(StepArenaAllocatorTest, CapacityIsBounded) {
+  StepArenaPool::Options options;
+  options.max_arena_bytes = 128;
+  StepArenaPool pool(cpu_allocator(), options);
+  StepArenaAllocator* arena = pool.Acquire();
+  arena->DeallocateRaw(
+      arena->AllocateRaw(Allocator::kAllocatorAlignment, 1000));
+  arena->Release();
+  EXPECT_EQ(128, pool.target_capacity());
+}
+
+TEST(StepArenaAllocatorTest, OutstandingAllocationsOutliveStep) {
+  StepArenaPool pool(cpu_allocator());
+  StepArenaAllocator* arena = pool.Acquire();
+  arena->DeallocateRaw(arena->AllocateRaw(Allocator::kAllocatorAlignment, 64));
+  arena->Release();
+
+  arena = pool.Acquire();
+  void* escaped = arena->AllocateRaw(Allocator::kAllocatorAlignment, 64);
+  EXPECT_TRUE(arena->Owns(escaped));
+  arena->Release();
+
+  // The slab of the first arena is still in use, so the next step gets
+  // another one.
+  StepArenaAllocator* next_arena = pool.Acquire();
+  EXPECT_NE(arena, next_arena);
+  void* ptr = next_arena->AllocateRaw(Allocator::kAllocatorAlignment, 64);
+  EXPECT_TRUE(next_arena->Owns(ptr));
+  EXPECT_NE(escaped, ptr);
+  next_arena->DeallocateRaw(ptr);
+  next_arena->Release();
+
+  arena->DeallocateRaw(escaped);
+}
+
+TEST(StepArenaAllocatorTest, IdleArenasAreCountedPerProcess) {
+  const size_t initial_idle_bytes = StepArenaPool::process_idle_bytes();
+  StepArenaPool pool(cpu_allocator());
+  StepArenaAllocator* arena = pool.Acquire();
+  arena->DeallocateRaw(arena->AllocateRaw(Allocator::kAllocatorAlignment, 64));
+  arena->Release();
+
+  arena = pool.Acquire();
+  arena->Release();
+  EXPECT_EQ(initial_idle_bytes + 64, StepArenaPool::process_idle_bytes());
+  arena = pool.Acquire();
+  EXPECT_EQ(initial_idle_bytes, StepArenaPool::process_idle_bytes());
+  arena->Release();
+}
+
+TEST(StepArenaAllocatorTest, IdleArenasAreBoundedPerProcess) {
+  // Larger than the default bound on the idle bytes in the process.
+  constexpr size_t kStepBytes = 300 << 20;
+  StepArenaPool::Options options;
+  options.max_arena_bytes = kStepBytes;
+  StepArenaPool pool(cpu_allocator(), options);
+  StepArenaAllocator* arena = pool.Acquire();
+  arena->DeallocateRaw(
+      arena->AllocateRaw(Allocator::kAllocatorAlignment, kStepBytes));
+  arena->Release();
+
+  const size_t initial_idle_bytes = StepArenaPool::process_idle_bytes();
+  arena = pool.Acquire();
+  EXPECT_EQ(kStepBytes, arena->capacity());
+  // The slab does not fit in the bound, so it is freed.
+  arena->Release();
+  EXPECT_EQ(initial_idle_bytes, StepArenaPool::process_idle_bytes());
+}
+
+TEST(StepArenaAllocatorTest, ArenaOutlivesPool) {
+  StepArenaAllocator* arena;
+  void* ptr;
+  {
+    StepArenaPool pool(cpu_allocator());
+    arena = pool.Acquire();
+    ptr = arena->AllocateRaw(Allocator::kAllocatorAlignment, 64);
+    arena->Release();
+  }
+  // Deletes the arena.
+  arena->DeallocateRaw(ptr);
+}
+
+}  // namespace
+}  // namespace tensorflow
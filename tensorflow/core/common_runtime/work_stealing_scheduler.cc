@@ -0,0 +1,218 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/work_stealing_scheduler.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "tensorflow/core/platform/cpu_info.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/numa.h"
+
+namespace tensorflow {
+namespace {
+
+// Identifies the worker (if any) that is running on the current thread.
+struct WorkerContext {
+  const WorkStealingScheduler* scheduler = nullptr;
+  int slot = -1;
+};
+
+thread_local WorkerContext current_worker;
+
+}  // namespace
+
+std::shared_ptr<WorkStealingScheduler> WorkStealingScheduler::Create(
+    Runner runner, const Options& options) {
+  return std::shared_ptr<WorkStealingScheduler>(
+      new WorkStealingScheduler(std::move(runner), options));
+}
+
+WorkStealingScheduler::WorkStealingScheduler(Runner runner,
+                                             const Options& options)
+    : runner_(std::move(runner)),
+      numa_node_runners_(options.numa_node_runners) {
+  const int num_workers = options.num_workers > 0
+                              ? options.num_workers
+                              : std::max(1, port::MaxParallelism());
+  const int num_numa_nodes = std::max<int>(1, numa_node_runners_.size());
+
+  slots_by_numa_node_.resize(num_numa_nodes);
+  slots_.reserve(num_workers);
+  for (int i = 0; i < num_workers; ++i) {
+    // Assign contiguous ranges of slots to each node, so that slot `i` and
+    // slot `i + 1` are usually neighbours on the same node.
+    const int node = static_cast<int64_t>(i) * num_numa_nodes / num_workers;
+    slots_.push_back(std::make_unique<Slot>());
+    slots_.back()->numa_node = node;
+    slots_by_numa_node_[node].push_back(i);
+  }
+
+  for (int i = 0; i < num_workers; ++i) {
+    Slot* slot = slots_[i].get();
+    slot->victims.reserve(num_workers - 1);
+    // Local victims, starting after `i` so that thieves on the same node do
+    // not all hit the same deque.
+    const std::vector<int>& local = slots_by_numa_node_[slot->numa_node];
+    const int local_pos =
+        std::find(local.begin(), local.end(), i) - local.begin();
+    for (int j = 1; j < local.size(); ++j) {
+      slot->victims.push_back(local[(local_pos + j) % local.size()]);
+    }
+    // Remote victims, visiting the next node (by index) first.
+    for (int n = 1; n < num_numa_nodes; ++n) {
+      for (int victim :
+           slots_by_numa_node_[(slot->numa_node + n) % num_numa_nodes]) {
+        slot->victims.push_back(victim);
+      }
+    }
+  }
+}
+
+WorkStealingScheduler::~WorkStealingScheduler() {
+  DCHECK_EQ(num_queued_.load(), 0);
+}
+
+int WorkStealingScheduler::SlotForCurrentThread() {
+  if (current_worker.scheduler == this) {
+    return current_worker.slot;
+  }
+  const uint64 n = next_external_slot_.fetch_add(1, std::memory_order_relaxed);
+  if (slots_by_numa_node_.size() > 1) {
+    const int node = port::NUMAGetThreadNodeAffinity();
+    if (node >= 0 && node < slots_by_numa_node_.size() &&
+        !slots_by_numa_node_[node].empty()) {
+      const std::vector<int>& local = slots_by_numa_node_[node];
+      return local[n % local.size()];
+    }
+  }
+  return n % slots_.size();
+}
+
+void WorkStealingScheduler::Schedule(std::function<void()> fn) {
+  const int slot = SlotForCurrentThread();
+  // N.B. This increment must be sequentially consistent with the loads of
+  // `Slot::active` in `MaybeStartWorker()`; see `WorkerLoop()`. It precedes
+  // the push so that `num_queued_` never undercounts the queued closures.
+  num_queued_.fetch_add(1);
+  {
+    mutex_lock l(slots_[slot]->mu);
+    slots_[slot]->queue.push_back(std::move(fn));
+  }
+  MaybeStartWorker(slot);
+}
+
+void WorkStealingScheduler::MaybeStartWorker(int preferred_slot) {
+  auto try_start = [this](int slot) {
+    Slot* s = slots_[slot].get();
+    if (s->active.load()) return false;
+    bool expected = false;
+    if (!s->active.compare_exchange_strong(expected, true)) return false;
+    num_running_workers_.fetch_add(1);
+    const Runner& runner = numa_node_runners_.empty()
+                               ? runner_
+                               : numa_node_runners_[s->numa_node];
+    runner([self = shared_from_this(), slot]() { self->WorkerLoop(slot); });
+    return true;
+  };
+  if (try_start(preferred_slot)) return;
+  for (int victim : slots_[preferred_slot]->victims) {
+    if (try_start(victim)) return;
+  }
+}
+
+std::function<void()> WorkStealingScheduler::PopOrSteal(int slot) {
+  std::function<void()> fn;
+  Slot* own = slots_[slot].get();
+  {
+    mutex_lock l(own->mu);
+    if (!own->queue.empty()) {
+      fn = std::move(own->queue.back());
+      own->queue.pop_back();
+      return fn;
+    }
+  }
+  for (int victim : own->victims) {
+    Slot* other = slots_[victim].get();
+    mutex_lock l(other->mu);
+    if (!other->queue.empty()) {
+      fn = std::move(other->queue.front());
+      other->queue.pop_front();
+      num_steals_.fetch_add(1, std::memory_order_relaxed);
+      return fn;
+    }
+  }
+  return fn;
+}
+
+void WorkStealingScheduler::WorkerLoop(int slot) {
+  // Workers can nest when `runner_` runs closures inline.
+  const WorkerContext saved_worker = current_worker;
+  current_worker.scheduler = this;
+  current_worker.slot = slot;
+
+  Slot* s = slots_[slot].get();
+  while (true) {
+    std::function<void()> fn = PopOrSteal(slot);
+    if (fn) {
+      num_queued_.fetch_sub(1, std::memory_order_relaxed);
+      fn();
+      continue;
+    }
+    // Going idle. A concurrent `Schedule()` either observes `active == false`
+    // for this slot (and starts a new worker), or it incremented `num_queued_`
+    // before the store below, in which case we observe it here and try to
+    // resume draining.
+    s->active.store(false);
+    if (num_queued_.load() == 0) break;
+    bool expected = false;
+    if (!s->active.compare_exchange_strong(expected, true)) break;
+  }
+
+  current_worker = saved_worker;
+  num_running_workers_.fetch_sub(1);
+}
+
+std::shared_ptr<WorkStealingScheduler> WorkStealingSchedulerPool::Acquire(
+    WorkStealingScheduler::Runner runner) {
+  {
+    mutex_lock l(mu_);
+    // Schedulers whose workers are still returning from the previous step are
+    // skipped, so that a straggling worker never runs closures of this step.
+    for (auto it = schedulers_.begin(); it != schedulers_.end(); ++it) {
+      if ((*it)->IsIdle()) {
+        std::shared_ptr<WorkStealingScheduler> scheduler = std::move(*it);
+        schedulers_.erase(it);
+        scheduler->set_runner(std::move(runner));
+        return scheduler;
+      }
+    }
+  }
+  return WorkStealingScheduler::Create(std::move(runner), options_);
+}
+
+void WorkStealingSchedulerPool::Release(
+    std::shared_ptr<WorkStealingScheduler> scheduler) {
+  // Drop the runner so that it does not keep per-step state alive. Workers
+  // that are still returning no longer dispatch through it.
+  scheduler->set_runner(nullptr);
+  mutex_lock l(mu_);
+  if (schedulers_.size() < kMaxIdleSchedulers) {
+    schedulers_.push_back(std::move(scheduler));
+  }
+}
+
+}  // namespace tensorflow
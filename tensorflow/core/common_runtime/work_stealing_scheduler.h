@@ -0,0 +1,199 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_WORK_STEALING_SCHEDULER_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_WORK_STEALING_SCHEDULER_H_
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// A scheduler that multiplexes closures onto a fixed number of "worker
+// slots", each of which owns a deque of pending closures. Workers are
+// themselves closures that are dispatched through a runner (typically the
+// inter-op thread pool of a session), so the scheduler does not own any
+// threads.
+//
+// * A closure scheduled from inside a worker is pushed onto that worker's own
+//   deque, and the worker pops from the back (LIFO) of its deque. This keeps
+//   a chain of dependent nodes on the thread that produced their inputs.
+// * An idle worker steals from the front (FIFO) of other deques. It visits
+//   the slots on its own NUMA node first, then the slots on other nodes.
+// * A closure scheduled from outside a worker is pushed onto the slots in
+//   round-robin order, restricted to the slots on the NUMA node of the
+//   calling thread if that thread is bound to one.
+//
+// Slots are only grouped by NUMA node if `Options::numa_node_runners` is set.
+// The worker of a slot on node `n` is then dispatched through the runner of
+// node `n`, whose threads are bound to that node, so the grouping matches
+// where closures actually run. Otherwise all slots form a single group and
+// workers are dispatched through the runner passed to `Create()`.
+//
+// Compared to invoking the runner once per closure, this reduces the traffic
+// on the shared thread pool queue (at most `num_workers` closures are in
+// flight on it at any time) and keeps chains of dependent closures on one
+// thread.
+//
+// Instances must be created with `Create()` and are kept alive by their
+// running workers, so it is safe to drop the last external reference while
+// scheduled closures are still running.
+class WorkStealingScheduler
+    : public std::enable_shared_from_this<WorkStealingScheduler> {
+ public:
+  typedef std::function<void(std::function<void()>)> Runner;
+
+  struct Options {
+    // Maximum number of workers that may drain deques concurrently. If <= 0,
+    // `port::MaxParallelism()` is used.
+    int num_workers = 0;
+    // If not empty, one runner per NUMA node, whose threads are bound to that
+    // node (e.g. a `thread::ThreadPool` created with a `ThreadOptions` whose
+    // `numa_node` is set). The slots are spread evenly across these nodes,
+    // and the worker of a slot is dispatched through the runner of its node
+    // instead of the runner passed to `Create()`.
+    std::vector<Runner> numa_node_runners;
+  };
+
+  static std::shared_ptr<WorkStealingScheduler> Create(Runner runner,
+                                                       const Options& options);
+
+  ~WorkStealingScheduler();
+
+  // Schedules `fn` to run on one of the workers.
+  void Schedule(std::function<void()> fn);
+
+  int num_workers() const { return static_cast<int>(slots_.size()); }
+
+  // Returns the NUMA node that worker slot `slot` is assigned to, or 0 if no
+  // `Options::numa_node_runners` were given.
+  int numa_node(int slot) const { return slots_[slot]->numa_node; }
+
+  // Returns the order in which the worker of slot `slot` visits other slots
+  // when stealing.
+  const std::vector<int>& victims(int slot) const {
+    return slots_[slot]->victims;
+  }
+
+  // Returns true if no closure is queued and no worker is running, in which
+  // case `set_runner()` may be called.
+  bool IsIdle() const {
+    return num_queued_.load() == 0 && num_running_workers_.load() == 0;
+  }
+
+  // Replaces the runner that subsequent workers are dispatched through, unless
+  // `Options::numa_node_runners` were given. Must not be called concurrently
+  // with `Schedule()`.
+  void set_runner(Runner runner) { runner_ = std::move(runner); }
+
+  // Returns the total number of closures that were run by a worker other than
+  // the one on whose deque they were enqueued.
+  int64_t num_steals() const {
+    return num_steals_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  // The per-worker state. Aligned to avoid false sharing between the slots of
+  // different workers.
+  struct alignas(64) Slot {
+    mutex mu;
+    std::deque<std::function<void()>> queue TF_GUARDED_BY(mu);
+    // True while a worker is draining this slot.
+    std::atomic<bool> active{false};
+    // The NUMA node that this slot is assigned to.
+    int numa_node = 0;
+    // Order in which the worker of this slot visits other slots when
+    // stealing: the other slots on the same NUMA node first, starting with
+    // the one after this slot, then the slots on the other nodes.
+    std::vector<int> victims;
+  };
+
+  WorkStealingScheduler(Runner runner, const Options& options);
+
+  // Returns the slot that a closure scheduled from the current thread should
+  // be pushed onto.
+  int SlotForCurrentThread();
+
+  // Starts a worker for `preferred_slot`, or for another idle slot if a worker
+  // is already active there. Does nothing if all slots are active.
+  void MaybeStartWorker(int preferred_slot);
+
+  // Drains `slot` and steals from other slots until no work is left.
+  void WorkerLoop(int slot);
+
+  // Pops a closure from the back of `slot`, or steals one from the front of
+  // another slot. Returns an empty function if all deques are empty.
+  std::function<void()> PopOrSteal(int slot);
+
+  Runner runner_;
+  // If not empty, the runner through which the workers of the slots on each
+  // NUMA node are dispatched.
+  const std::vector<Runner> numa_node_runners_;
+  std::vector<std::unique_ptr<Slot>> slots_;
+  // For each NUMA node, the indices of the slots assigned to it.
+  std::vector<std::vector<int>> slots_by_numa_node_;
+
+  // Upper bound on the number of closures that have been pushed but not yet
+  // popped. Used together with `Slot::active` to ensure that no closure is
+  // left behind when a worker goes idle concurrently with a `Schedule()` call.
+  std::atomic<int64_t> num_queued_{0};
+  // Number of workers that have been dispatched and not yet returned.
+  std::atomic<int> num_running_workers_{0};
+  std::atomic<uint64> next_external_slot_{0};
+  std::atomic<int64_t> num_steals_{0};
+
+  TF_DISALLOW_COPY_AND_ASSIGN(WorkStealingScheduler);
+};
+
+// Keeps idle `WorkStealingScheduler`s, so that an executor builds its worker
+// slots once and reuses them across steps instead of building them per step.
+class WorkStealingSchedulerPool {
+ public:
+  explicit WorkStealingSchedulerPool(
+      const WorkStealingScheduler::Options& options)
+      : options_(options) {}
+
+  // Returns a scheduler that dispatches its workers through `runner` and is
+  // not used by any other caller until it is passed to `Release()`.
+  std::shared_ptr<WorkStealingScheduler> Acquire(
+      WorkStealingScheduler::Runner runner);
+
+  // Returns `scheduler` to the pool. Must be called once no more closures
+  // will be scheduled on it; its workers may still be returning.
+  void Release(std::shared_ptr<WorkStealingScheduler> scheduler);
+
+ private:
+  // Upper bound on the number of schedulers kept for reuse.
+  static constexpr int kMaxIdleSchedulers = 16;
+
+  const WorkStealingScheduler::Options options_;
+  mutex mu_;
+  std::vector<std::shared_ptr<WorkStealingScheduler>> schedulers_
+      TF_GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(WorkStealingSchedulerPool);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_WORK_STEALING_SCHEDULER_H_
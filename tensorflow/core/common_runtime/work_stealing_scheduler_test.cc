@@ -0,0 +1,259 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/work_stealing_scheduler.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/blocking_counter.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+WorkStealingScheduler::Options MakeOptions(int num_workers) {
+  WorkStealingScheduler::Options options;
+  options.num_workers = num_workers;
+  return options;
+}
+
+TEST(WorkStealingSchedulerTest, RunsAllClosures) {
+  thread::ThreadPool pool(Env::Default(), "test", 4);
+  auto scheduler = WorkStealingScheduler::Create(
+      [&pool](std::function<void()> fn) { pool.Schedule(std::move(fn)); },
+      MakeOptions(4));
+  constexpr int kNumClosures = 10000;
+  std::atomic<int> count{0};
+  BlockingCounter counter(kNumClosures);
+  for (int i = 0; i < kNumClosures; ++i) {
+    scheduler->Schedule([&count, &counter]() {
+      count.fetch_add(1);
+      counter.DecrementCount();
+    });
+  }
+  counter.Wait();
+  EXPECT_EQ(kNumClosures, count.load());
+}
+
+TEST(WorkStealingSchedulerTest, RunsNestedClosures) {
+  thread::ThreadPool pool(Env::Default(), "test", 4);
+  auto scheduler = WorkStealingScheduler::Create(
+      [&pool](std::function<void()> fn) { pool.Schedule(std::move(fn)); },
+      MakeOptions(4));
+  // Builds a binary tree of closures of the given depth, where each closure
+  // schedules its children.
+  constexpr int kDepth = 12;
+  BlockingCounter counter((1 << (kDepth + 1)) - 1);
+  std::function<void(int)> fn = [&](int depth) {
+    if (depth < kDepth) {
+      scheduler->Schedule([&fn, depth]() { fn(depth + 1); });
+      scheduler->Schedule([&fn, depth]() { fn(depth + 1); });
+    }
+    counter.DecrementCount();
+  };
+  scheduler->Schedule([&fn]() { fn(0); });
+  counter.Wait();
+}
+
+TEST(WorkStealingSchedulerTest, InlineRunner) {
+  auto scheduler = WorkStealingScheduler::Create(
+      [](std::function<void()> fn) { fn(); }, MakeOptions(3));
+  int count = 0;
+  std::function<void(int)> fn = [&](int depth) {
+    ++count;
+    if (depth < 10) {
+      scheduler->Schedule([&fn, depth]() { fn(depth + 1); });
+      scheduler->Schedule([&fn, depth]() { fn(depth + 1); });
+    }
+  };
+  scheduler->Schedule([&fn]() { fn(0); });
+  EXPECT_EQ((1 << 11) - 1, count);
+}
+
+TEST(WorkStealingSchedulerTest, OutlivesLastReference) {
+  thread::ThreadPool pool(Env::Default(), "test", 2);
+  BlockingCounter counter(100);
+  {
+    auto scheduler = WorkStealingScheduler::Create(
+        [&pool](std::function<void()> fn) { pool.Schedule(std::move(fn)); },
+        MakeOptions(2));
+    for (int i = 0; i < 100; ++i) {
+      scheduler->Schedule([&counter]() { counter.DecrementCount(); });
+    }
+  }
+  counter.Wait();
+}
+
+// The fake NUMA node of the current thread, set by the runners that
+// `MakeNumaOptions()` returns.
+thread_local int current_test_node = -1;
+
+// Returns options with one runner per pool in `node_pools`, which marks the
+// threads it runs closures on with the index of the pool.
+WorkStealingScheduler::Options MakeNumaOptions(
+    int num_workers, const std::vector<thread::ThreadPool*>& node_pools) {
+  WorkStealingScheduler::Options options = MakeOptions(num_workers);
+  for (int node = 0; node < node_pools.size(); ++node) {
+    thread::ThreadPool* pool = node_pools[node];
+    options.numa_node_runners.push_back(
+        [pool, node](std::function<void()> fn) {
+          pool->Schedule([node, fn = std::move(fn)]() {
+            current_test_node = node;
+            fn();
+          });
+        });
+  }
+  return options;
+}
+
+TEST(WorkStealingSchedulerTest, VisitsNodeLocalVictimsFirst) {
+  thread::ThreadPool pool0(Env::Default(), "node0", 1);
+  thread::ThreadPool pool1(Env::Default(), "node1", 1);
+  auto scheduler = WorkStealingScheduler::Create(
+      [](std::function<void()> fn) { fn(); },
+      MakeNumaOptions(4, {&pool0, &pool1}));
+  EXPECT_EQ(0, scheduler->numa_node(0));
+  EXPECT_EQ(0, scheduler->numa_node(1));
+  EXPECT_EQ(1, scheduler->numa_node(2));
+  EXPECT_EQ(1, scheduler->numa_node(3));
+  EXPECT_EQ(std::vector<int>({1, 2, 3}), scheduler->victims(0));
+  EXPECT_EQ(std::vector<int>({0, 2, 3}), scheduler->victims(1));
+  EXPECT_EQ(std::vector<int>({3, 0, 1}), scheduler->victims(2));
+  EXPECT_EQ(std::vector<int>({2, 0, 1}), scheduler->victims(3));
+}
+
+TEST(WorkStealingSchedulerTest, WithoutNodeRunnersUsesOneGroup) {
+  auto scheduler = WorkStealingScheduler::Create(
+      [](std::function<void()> fn) { fn(); }, MakeOptions(3));
+  for (int slot = 0; slot < 3; ++slot) {
+    EXPECT_EQ(0, scheduler->numa_node(slot));
+  }
+  EXPECT_EQ(std::vector<int>({2, 0}), scheduler->victims(1));
+}
+
+TEST(WorkStealingSchedulerTest, DispatchesWorkersThroughNodeRunners) {
+  thread::ThreadPool pool0(Env::Default(), "node0", 2);
+  thread::ThreadPool pool1(Env::Default(), "node1", 2);
+  std::atomic<int> num_default_runs{0};
+  auto scheduler = WorkStealingScheduler::Create(
+      [&num_default_runs](std::function<void()> fn) {
+        num_default_runs.fetch_add(1);
+        fn();
+      },
+      MakeNumaOptions(4, {&pool0, &pool1}));
+  constexpr int kNumClosures = 1000;
+  std::atomic<int> num_runs_by_node[2] = {{0}, {0}};
+  BlockingCounter counter(kNumClosures);
+  for (int i = 0; i < kNumClosures; ++i) {
+    scheduler->Schedule([&num_runs_by_node, &counter]() {
+      ASSERT_GE(current_test_node, 0);
+      ASSERT_LT(current_test_node, 2);
+      num_runs_by_node[current_test_node].fetch_add(1);
+      counter.DecrementCount();
+    });
+  }
+  counter.Wait();
+  EXPECT_EQ(0, num_default_runs.load());
+  EXPECT_EQ(kNumClosures, num_runs_by_node[0].load() +
+                              num_runs_by_node[1].load());
+}
+
+TEST(WorkStealingSchedulerPoolTest, ReusesIdleSchedulers) {
+  WorkStealingSchedulerPool pool(MakeOptions(2));
+  auto inline_runner = [](std::function<void()> fn) { fn(); };
+  std::shared_ptr<WorkStealingScheduler> scheduler =
+      pool.Acquire(inline_runner);
+  int count = 0;
+  scheduler->Schedule([&count]() { ++count; });
+  EXPECT_EQ(1, count);
+  EXPECT_TRUE(scheduler->IsIdle());
+  WorkStealingScheduler* raw = scheduler.get();
+  pool.Release(std::move(scheduler));
+
+  scheduler = pool.Acquire(inline_runner);
+  EXPECT_EQ(raw, scheduler.get());
+  // The scheduler is in use, so a concurrent step gets a new one.
+  std::shared_ptr<WorkStealingScheduler> other = pool.Acquire(inline_runner);
+  EXPECT_NE(raw, other.get());
+  scheduler->Schedule([&count]() { ++count; });
+  EXPECT_EQ(2, count);
+  pool.Release(std::move(scheduler));
+  pool.Release(std::move(other));
+}
+
+TEST(WorkStealingSchedulerPoolTest, SkipsSchedulersWithRunningWorkers) {
+  WorkStealingSchedulerPool pool(MakeOptions(2));
+  std::function<void()> pending_worker;
+  std::shared_ptr<WorkStealingScheduler> scheduler =
+      pool.Acquire([&pending_worker](std::function<void()> fn) {
+        pending_worker = std::move(fn);
+      });
+  int count = 0;
+  scheduler->Schedule([&count]() { ++count; });
+  EXPECT_FALSE(scheduler->IsIdle());
+  WorkStealingScheduler* raw = scheduler.get();
+  pool.Release(std::move(scheduler));
+
+  // The worker has not run yet, so the released scheduler is not reused.
+  scheduler = pool.Acquire([](std::function<void()> fn) { fn(); });
+  EXPECT_NE(raw, scheduler.get());
+  pending_worker();
+  EXPECT_EQ(1, count);
+  pool.Release(std::move(scheduler));
+}
+
+void BM_WorkStealingScheduler(::testing::benchmark::State& state) {
+  const int num_threads = state.range(0);
+  thread::ThreadPool pool(Env::Default(), "bench", num_threads);
+  auto scheduler = WorkStealingScheduler::Create(
+      [&pool](std::function<void()> fn) { pool.Schedule(std::move(fn)); },
+      MakeOptions(num_threads));
+  constexpr int kNumClosures = 1000;
+  for (auto s : state) {
+    BlockingCounter counter(kNumClosures);
+    for (int i = 0; i < kNumClosures; ++i) {
+      scheduler->Schedule([&counter]() { counter.DecrementCount(); });
+    }
+    counter.Wait();
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                          kNumClosures);
+}
+BENCHMARK(BM_WorkStealingScheduler)->UseRealTime()->Arg(1)->Arg(4)->Arg(16);
+
+void BM_ThreadPoolSchedule(::testing::benchmark::State& state) {
+  const int num_threads = state.range(0);
+  thread::ThreadPool pool(Env::Default(), "bench", num_threads);
+  constexpr int kNumClosures = 1000;
+  for (auto s : state) {
+    BlockingCounter counter(kNumClosures);
+    for (int i = 0; i < kNumClosures; ++i) {
+      pool.Schedule([&counter]() { counter.DecrementCount(); });
+    }
+    counter.Wait();
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                          kNumClosures);
+}
+BENCHMARK(BM_ThreadPoolSchedule)->UseRealTime()->Arg(1)->Arg(4)->Arg(16);
+
+}  // namespace
+}  // namespace tensorflow
@@ -14,15 +14,22 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow/core/data/compression_utils.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <limits>
+#include <optional>
 #include <string>
 #include <vector>
 
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
 #include "tensorflow/core/common_runtime/dma_helper.h"
 #include "tensorflow/core/framework/tensor.pb.h"
 #include "tensorflow/core/framework/tensor_shape.pb.h"
 #include "tensorflow/core/framework/types.pb.h"
 #include "tensorflow/core/framework/variant_op_registry.h"
+#include "tensorflow/core/platform/coding.h"
 #include "tensorflow/core/platform/errors.h"
 #include "tensorflow/core/platform/snappy.h"
 #include "tensorflow/core/platform/status.h"
@@ -36,9 +43,377 @@ namespace {
 // Increment this when making changes to the `CompressedElement` proto. The
 // `UncompressElement` function will determine what to read according to the
 // version.
-constexpr int kCompressedElementVersion = 0;
+constexpr int kCompressedElementVersion = 1;
+// Version of the elements whose components are all encoded with `CODEC_RAW`,
+// which binaries predating component codecs can read.
+constexpr int kRawCompressedElementVersion = 0;
 
-}  // namespace
+// Components with fewer values are not worth encoding.
+constexpr int64_t kMinCodecValues = 16;
+// Number of leading values of an integer component from which the size of its
+// delta-varint encoding is estimated before encoding it.
+constexpr int64_t kDeltaVarintSampleValues = 256;
+
+using Codec = CompressedComponentMetadata::Codec;
+
+bool IsIntegerType(DataType dtype) {
+  switch (dtype) {
+    case DT_INT8:
+    case DT_INT16:
+    case DT_INT32:
+    case DT_INT64:
+    case DT_UINT8:
+    case DT_UINT16:
+    case DT_UINT32:
+    case DT_UINT64:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool IsFloatingPointType(DataType dtype) {
+  switch (dtype) {
+    case DT_HALF:
+    case DT_BFLOAT16:
+    case DT_FLOAT:
+    case DT_DOUBLE:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Returns whether components of type `dtype` can be encoded with `codec`.
+bool SupportsCodec(DataType dtype, Codec codec) {
+  switch (codec) {
+    case CompressedComponentMetadata::CODEC_RAW:
+      return true;
+    case CompressedComponentMetadata::CODEC_DELTA_VARINT:
+      return IsIntegerType(dtype);
+    case CompressedComponentMetadata::CODEC_BYTE_SHUFFLE:
+      return DataTypeCanUseMemcpy(dtype) && DataTypeSize(dtype) > 1;
+    case CompressedComponentMetadata::CODEC_DICTIONARY:
+      return dtype == DT_STRING;
+    default:
+      return false;
+  }
+}
+
+// Calls `fn` with a value of the C++ type of the integer type `dtype`.
+template <typename Fn>
+auto DispatchIntegerType(DataType dtype, Fn fn) {
+  switch (dtype) {
+    case DT_INT8:
+      return fn(int8_t());
+    case DT_INT16:
+      return fn(int16_t());
+    case DT_INT32:
+      return fn(int32_t());
+    case DT_INT64:
+      return fn(int64_t());
+    case DT_UINT8:
+      return fn(uint8_t());
+    case DT_UINT16:
+      return fn(uint16_t());
+    case DT_UINT32:
+      return fn(uint32_t());
+    default:
+      return fn(uint64_t());
+  }
+}
+
+// Returns the zigzag encoding of the difference between `value` and
+// `previous`, and sets `previous` to `value`. Differences are computed modulo
+// 2^64 on the sign-extended values, which round-trips every type of at most 64
+// bits.
+template <typename T>
+uint64_t ZigZagDelta(T value, uint64_t& previous) {
+  const uint64_t current = static_cast<uint64_t>(value);
+  const int64_t delta = static_cast<int64_t>(current - previous);
+  previous = current;
+  return (static_cast<uint64_t>(delta) << 1) ^
+         static_cast<uint64_t>(delta >> 63);
+}
+
+// Writes the zigzag varint-encoded differences between consecutive `values`
+// to `dst`, which must have room for `n * kMaxVarint64Bytes` bytes. Returns the
+// number of bytes written.
+template <typename T>
+size_t EncodeDeltaVarint(const T* values, int64_t n, char* dst) {
+  char* pos = dst;
+  uint64_t previous = 0;
+  for (int64_t i = 0; i < n; ++i) {
+    pos = core::EncodeVarint64(pos, ZigZagDelta(values[i], previous));
+  }
+  return pos - dst;
+}
+
+// Returns the number of bytes `EncodeDeltaVarint` writes for `values`.
+template <typename T>
+size_t DeltaVarintSize(const T* values, int64_t n) {
+  size_t size = 0;
+  uint64_t previous = 0;
+  for (int64_t i = 0; i < n; ++i) {
+    size += core::VarintLength(ZigZagDelta(values[i], previous));
+  }
+  return size;
+}
+
+template <typename T>
+Status DecodeDeltaVarint(absl::string_view src, int64_t n, T* values) {
+  const char* pos = src.data();
+  const char* limit = src.data() + src.size();
+  uint64_t previous = 0;
+  for (int64_t i = 0; i < n; ++i) {
+    uint64_t zigzag;
+    pos = core::GetVarint64Ptr(pos, limit, &zigzag);
+    if (pos == nullptr) {
+      return errors::Internal("Could not decode delta-varint component.");
+    }
+    previous += (zigzag >> 1) ^ (~(zigzag & 1) + 1);
+    values[i] = static_cast<T>(previous);
+  }
+  if (pos != limit) {
+    return errors::Internal("Could not decode delta-varint component.");
+  }
+  return OkStatus();
+}
+
+// Stores byte `k` of value `i` of the `n` values of `Width` bytes in `src` at
+// `dst[k * n + i]`.
+template <int Width>
+void ByteShuffle(const char* src, int64_t n, char* dst) {
+  for (int k = 0; k < Width; ++k) {
+    char* out = dst + k * n;
+    const char* in = src + k;
+    for (int64_t i = 0; i < n; ++i) {
+      out[i] = in[i * Width];
+    }
+  }
+}
+
+template <int Width>
+void ByteUnshuffle(const char* src, int64_t n, char* dst) {
+  for (int k = 0; k < Width; ++k) {
+    const char* in = src + k * n;
+    char* out = dst + k;
+    for (int64_t i = 0; i < n; ++i) {
+      out[i * Width] = in[i];
+    }
+  }
+}
+
+// Byte-shuffles or unshuffles the `n` values of `width` bytes in `src` into
+// `dst`. Common widths are unrolled.
+void ByteShuffle(const char* src, int64_t n, int width, bool unshuffle,
+                 char* dst) {
+  switch (width) {
+    case 2:
+      return unshuffle ? ByteUnshuffle<2>(src, n, dst)
+                       : ByteShuffle<2>(src, n, dst);
+    case 4:
+      return unshuffle ? ByteUnshuffle<4>(src, n, dst)
+                       : ByteShuffle<4>(src, n, dst);
+    case 8:
+      return unshuffle ? ByteUnshuffle<8>(src, n, dst)
+                       : ByteShuffle<8>(src, n, dst);
+    default:
+      for (int64_t i = 0; i < n; ++i) {
+        for (int k = 0; k < width; ++k) {
+          if (unshuffle) {
+            dst[i * width + k] = src[k * n + i];
+          } else {
+            dst[k * n + i] = src[i * width + k];
+          }
+        }
+      }
+  }
+}
+
+// Dictionary-encodes the strings of `component` into `encoded`. Unless `force`
+// is true, returns false without encoding if less than half of the strings are
+// repeated.
+bool EncodeDictionary(const Tensor& component, bool force, tstring& encoded) {
+  const auto& strings = component.unaligned_flat<tstring>();
+  const int64_t n = strings.size();
+  absl::flat_hash_map<absl::string_view, uint64_t> entry_indices;
+  std::vector<absl::string_view> entries;
+  std::vector<uint64_t> indices(n);
+  for (int64_t i = 0; i < n; ++i) {
+    absl::string_view str(strings.data()[i].data(), strings.data()[i].size());
+    auto it = entry_indices.try_emplace(str, entries.size()).first;
+    if (it->second == entries.size()) {
+      entries.push_back(str);
+      if (!force && 2 * static_cast<int64_t>(entries.size()) > n) {
+        return false;
+      }
+    }
+    indices[i] = it->second;
+  }
+
+  size_t size = core::VarintLength(entries.size());
+  for (absl::string_view entry : entries) {
+    size += core::VarintLength(entry.size()) + entry.size();
+  }
+  for (uint64_t index : indices) {
+    size += core::VarintLength(index);
+  }
+  encoded.resize_uninitialized(size);
+  char* pos = core::EncodeVarint64(encoded.mdata(), entries.size());
+  for (absl::string_view entry : entries) {
+    pos = core::EncodeVarint64(pos, entry.size());
+    std::memcpy(pos, entry.data(), entry.size());
+    pos += entry.size();
+  }
+  for (uint64_t index : indices) {
+    pos = core::EncodeVarint64(pos, index);
+  }
+  return true;
+}
+
+Status DecodeDictionary(absl::string_view src, Tensor& component) {
+  const char* pos = src.data();
+  const char* limit = src.data() + src.size();
+  auto corrupted = [] {
+    return errors::Internal("Could not decode dictionary component.");
+  };
+  uint64_t num_entries;
+  pos = core::GetVarint64Ptr(pos, limit, &num_entries);
+  if (pos == nullptr || num_entries > src.size()) {
+    return corrupted();
+  }
+  std::vector<absl::string_view> entries(num_entries);
+  for (uint64_t i = 0; i < num_entries; ++i) {
+    uint64_t length;
+    pos = core::GetVarint64Ptr(pos, limit, &length);
+    if (pos == nullptr || length > static_cast<uint64_t>(limit - pos)) {
+      return corrupted();
+    }
+    entries[i] = absl::string_view(pos, length);
+    pos += length;
+  }
+  auto strings = component.unaligned_flat<tstring>();
+  for (int64_t i = 0; i < strings.size(); ++i) {
+    uint64_t index;
+    pos = core::GetVarint64Ptr(pos, limit, &index);
+    if (pos == nullptr || index >= num_entries) {
+      return corrupted();
+    }
+    strings.data()[i].assign(entries[index].data(), entries[index].size());
+  }
+  if (pos != limit) {
+    return corrupted();
+  }
+  return OkStatus();
+}
+
+// Encodes `component` into `encoded` with `codec` if set, or with a codec
+// chosen from the dtype and values of `component` otherwise. Returns the codec
+// used. Components encoded with `CODEC_RAW` are left to the caller.
+Codec EncodeComponent(const Tensor& component, std::optional<Codec> codec,
+                      tstring& encoded) {
+  const DataType dtype = component.dtype();
+  const int64_t n = component.NumElements();
+  const bool force = codec.has_value();
+  if (!force) {
+    if (n < kMinCodecValues) {
+      codec = CompressedComponentMetadata::CODEC_RAW;
+    } else if (IsIntegerType(dtype)) {
+      codec = CompressedComponentMetadata::CODEC_DELTA_VARINT;
+    } else if (IsFloatingPointType(dtype)) {
+      codec = CompressedComponentMetadata::CODEC_BYTE_SHUFFLE;
+    } else if (dtype == DT_STRING) {
+      codec = CompressedComponentMetadata::CODEC_DICTIONARY;
+    } else {
+      codec = CompressedComponentMetadata::CODEC_RAW;
+    }
+  } else if (!SupportsCodec(dtype, *codec)) {
+    codec = CompressedComponentMetadata::CODEC_RAW;
+  }
+
+  switch (*codec) {
+    case CompressedComponentMetadata::CODEC_DELTA_VARINT: {
+      const StringPiece data = component.tensor_data();
+      // Deltas that do not fit in fewer bytes than the values are left to the
+      // compressor. This is first estimated on a prefix of the values, so that
+      // unsorted components are rejected without being encoded.
+      if (!force) {
+        const int64_t sample = std::min(n, kDeltaVarintSampleValues);
+        const size_t sample_size = DispatchIntegerType(dtype, [&](auto type) {
+          using T = decltype(type);
+          return DeltaVarintSize(reinterpret_cast<const T*>(data.data()),
+                                 sample);
+        });
+        if (4 * sample_size > 3 * sample * DataTypeSize(dtype)) {
+          return CompressedComponentMetadata::CODEC_RAW;
+        }
+      }
+      encoded.resize_uninitialized(n * core::kMaxVarint64Bytes);
+      const size_t size = DispatchIntegerType(dtype, [&](auto type) {
+        using T = decltype(type);
+        return EncodeDeltaVarint(reinterpret_cast<const T*>(data.data()), n,
+                                 encoded.mdata());
+      });
+      if (!force && 4 * size > 3 * data.size()) {
+        return CompressedComponentMetadata::CODEC_RAW;
+      }
+      encoded.resize(size);
+      return *codec;
+    }
+    case CompressedComponentMetadata::CODEC_BYTE_SHUFFLE: {
+      const StringPiece data = component.tensor_data();
+      encoded.resize_uninitialized(data.size());
+      ByteShuffle(data.data(), n, DataTypeSize(dtype), /*unshuffle=*/false,
+                  encoded.mdata());
+      return *codec;
+    }
+    case CompressedComponentMetadata::CODEC_DICTIONARY:
+      if (EncodeDictionary(component, force, encoded)) {
+        return *codec;
+      }
+      return CompressedComponentMetadata::CODEC_RAW;
+    default:
+      return CompressedComponentMetadata::CODEC_RAW;
+  }
+}
+
+// Decodes the `encoded` bytes of a component encoded with `codec` into
+// `component`, which must have been allocated with the component's dtype and
+// shape.
+Status DecodeComponent(Codec codec, absl::string_view encoded,
+                       Tensor& component) {
+  const DataType dtype = component.dtype();
+  if (!SupportsCodec(dtype, codec)) {
+    return errors::Internal("Unsupported codec ", codec, " for component of ",
+                            DataTypeString(dtype));
+  }
+  const int64_t n = component.NumElements();
+  switch (codec) {
+    case CompressedComponentMetadata::CODEC_DELTA_VARINT: {
+      char* data = const_cast<char*>(component.tensor_data().data());
+      return DispatchIntegerType(dtype, [&](auto type) {
+        using T = decltype(type);
+        return DecodeDeltaVarint(encoded, n, reinterpret_cast<T*>(data));
+      });
+    }
+    case CompressedComponentMetadata::CODEC_BYTE_SHUFFLE: {
+      const StringPiece data = component.tensor_data();
+      if (encoded.size() != data.size()) {
+        return errors::Internal("Byte-shuffled component has ",
+                                encoded.size(), " bytes, expected ",
+                                data.size());
+      }
+      ByteShuffle(encoded.data(), n, DataTypeSize(dtype), /*unshuffle=*/true,
+                  const_cast<char*>(data.data()));
+      return OkStatus();
+    }
+    case CompressedComponentMetadata::CODEC_DICTIONARY:
+      return DecodeDictionary(encoded, component);
+    default:
+      return errors::Internal("Unsupported codec ", codec);
+  }
+}
 
 class Iov {
  public:
@@ -63,15 +438,23 @@ class Iov {
   size_t num_bytes_;
 };
 
-Status CompressElement(const std::vector<Tensor>& element,
-                       CompressedElement* out) {
-  // First pass: preprocess the non`memcpy`able tensors.
+Status CompressElementImpl(const std::vector<Tensor>& element,
+                           std::optional<Codec> codec, CompressedElement* out) {
+  // First pass: preprocess the non`memcpy`able tensors, and encode the
+  // components for which a codec applies.
   size_t num_string_tensors = 0;
   size_t num_string_tensor_strings = 0;
   std::vector<TensorProto> nonmemcpyable_components;
   size_t total_nonmemcpyable_size = 0;
-  for (const auto& component : element) {
-    if (component.dtype() == DT_STRING) {
+  std::vector<Codec> codecs(element.size());
+  std::vector<tstring> encoded(element.size());
+  bool any_encoded = false;
+  for (int i = 0; i < element.size(); ++i) {
+    const auto& component = element[i];
+    codecs[i] = EncodeComponent(component, codec, encoded[i]);
+    if (codecs[i] != CompressedComponentMetadata::CODEC_RAW) {
+      any_encoded = true;
+    } else if (component.dtype() == DT_STRING) {
       ++num_string_tensors;
       num_string_tensor_strings += component.NumElements();
     } else if (!DataTypeCanUseMemcpy(component.dtype())) {
@@ -83,6 +466,7 @@ Status CompressElement(const std::vector<Tensor>& element,
   }
 
   // Second pass: build an iov array of the tensor data.
+  // - Encoded tensors are pointed to from a single iovec on their encoding.
   // - `memcpy`able tensors are pointed to directly from a single iovec.
   // - String tensors are pointed to directly from multiple iovecs (one for each
   // string).
@@ -99,7 +483,11 @@ Status CompressElement(const std::vector<Tensor>& element,
         out->mutable_component_metadata()->Add();
     metadata->set_dtype(component.dtype());
     component.shape().AsProto(metadata->mutable_tensor_shape());
-    if (DataTypeCanUseMemcpy(component.dtype())) {
+    if (codecs[i] != CompressedComponentMetadata::CODEC_RAW) {
+      metadata->set_codec(codecs[i]);
+      iov.Add(encoded[i].mdata(), encoded[i].size());
+      metadata->add_uncompressed_bytes(encoded[i].size());
+    } else if (DataTypeCanUseMemcpy(component.dtype())) {
       const TensorBuffer* buffer = DMAHelper::buffer(&component);
       if (buffer) {
         iov.Add(buffer->data(), buffer->size());
@@ -131,15 +519,39 @@ Status CompressElement(const std::vector<Tensor>& element,
                                       out->mutable_data())) {
     return errors::Internal("Failed to compress using snappy.");
   }
-  out->set_version(kCompressedElementVersion);
+  out->set_version(any_encoded ? kCompressedElementVersion
+                               : kRawCompressedElementVersion);
   VLOG(3) << "Compressed element from " << iov.NumBytes() << " bytes to "
           << out->data().size() << " bytes";
   return OkStatus();
 }
 
+}  // namespace
+
+Status CompressElement(const std::vector<Tensor>& element,
+                       CompressedElement* out) {
+  return CompressElement(element, CodecPolicy::kRaw, out);
+}
+
+Status CompressElement(const std::vector<Tensor>& element, CodecPolicy policy,
+                       CompressedElement* out) {
+  if (policy == CodecPolicy::kAuto) {
+    return CompressElementImpl(element, /*codec=*/std::nullopt, out);
+  }
+  return CompressElementImpl(element, CompressedComponentMetadata::CODEC_RAW,
+                             out);
+}
+
+Status CompressElement(const std::vector<Tensor>& element,
+                       CompressedComponentMetadata::Codec codec,
+                       CompressedElement* out) {
+  return CompressElementImpl(element, codec, out);
+}
+
 Status UncompressElement(const CompressedElement& compressed,
                          std::vector<Tensor>* out) {
-  if (compressed.version() != kCompressedElementVersion) {
+  if (compressed.version() != kRawCompressedElementVersion &&
+      compressed.version() != kCompressedElementVersion) {
     return errors::Internal("Unsupported compressed element version: ",
                             compressed.version());
   }
@@ -147,12 +559,26 @@ Status UncompressElement(const CompressedElement& compressed,
   out->clear();
   out->reserve(num_components);
 
-  // First pass: preprocess the non`memcpy`able tensors.
+  // First pass: preprocess the non`memcpy`able tensors, and validate the
+  // metadata of encoded tensors.
   size_t num_string_tensors = 0;
   size_t num_string_tensor_strings = 0;
   size_t total_nonmemcpyable_size = 0;
+  size_t total_encoded_size = 0;
   for (const auto& metadata : compressed.component_metadata()) {
-    if (metadata.dtype() == DT_STRING) {
+    if (metadata.codec() != CompressedComponentMetadata::CODEC_RAW) {
+      if (!SupportsCodec(metadata.dtype(), metadata.codec())) {
+        return errors::Internal("Unsupported codec ", metadata.codec(),
+                                " for component of ",
+                                DataTypeString(metadata.dtype()));
+      }
+      if (metadata.uncompressed_bytes_size() != 1) {
+        return errors::Internal("Encoded component has ",
+                                metadata.uncompressed_bytes_size(),
+                                " sizes, expected 1");
+      }
+      total_encoded_size += metadata.uncompressed_bytes(0);
+    } else if (metadata.dtype() == DT_STRING) {
       ++num_string_tensors;
       num_string_tensor_strings += metadata.uncompressed_bytes_size();
     } else if (!DataTypeCanUseMemcpy(metadata.dtype())) {
@@ -161,6 +587,7 @@ Status UncompressElement(const CompressedElement& compressed,
   }
 
   // Second pass: prepare the memory to be uncompressed into.
+  // - Encoded tensors are uncompressed into a string, and decoded afterwards.
   // - `memcpy`able tensors are directly uncompressed into via a single iovec.
   // - String tensors are directly uncompressed into via multiple iovecs (one
   // for each string).
@@ -170,8 +597,15 @@ Status UncompressElement(const CompressedElement& compressed,
   tstring nonmemcpyable;
   nonmemcpyable.resize_uninitialized(total_nonmemcpyable_size);
   char* nonmemcpyable_pos = nonmemcpyable.mdata();
+  tstring encoded;
+  encoded.resize_uninitialized(total_encoded_size);
+  char* encoded_pos = encoded.mdata();
   for (const auto& metadata : compressed.component_metadata()) {
-    if (DataTypeCanUseMemcpy(metadata.dtype())) {
+    if (metadata.codec() != CompressedComponentMetadata::CODEC_RAW) {
+      out->emplace_back(metadata.dtype(), metadata.tensor_shape());
+      iov.Add(encoded_pos, metadata.uncompressed_bytes(0));
+      encoded_pos += metadata.uncompressed_bytes(0);
+    } else if (DataTypeCanUseMemcpy(metadata.dtype())) {
       out->emplace_back(metadata.dtype(), metadata.tensor_shape());
       TensorBuffer* buffer = DMAHelper::buffer(&out->back());
       if (buffer) {
@@ -211,13 +645,21 @@ Status UncompressElement(const CompressedElement& compressed,
     return errors::Internal("Failed to perform snappy decompression.");
   }
 
-  // Third pass: deserialize nonstring, non`memcpy`able tensors.
+  // Third pass: decode the encoded tensors, and deserialize nonstring,
+  // non`memcpy`able tensors.
   nonmemcpyable_pos = nonmemcpyable.mdata();
+  encoded_pos = encoded.mdata();
   for (int i = 0; i < num_components; ++i) {
     const CompressedComponentMetadata& metadata =
         compressed.component_metadata(i);
-    if (!DataTypeCanUseMemcpy(metadata.dtype()) &&
-        metadata.dtype() != DT_STRING) {
+    if (metadata.codec() != CompressedComponentMetadata::CODEC_RAW) {
+      TF_RETURN_IF_ERROR(DecodeComponent(
+          metadata.codec(),
+          absl::string_view(encoded_pos, metadata.uncompressed_bytes(0)),
+          out->at(i)));
+      encoded_pos += metadata.uncompressed_bytes(0);
+    } else if (!DataTypeCanUseMemcpy(metadata.dtype()) &&
+               metadata.dtype() != DT_STRING) {
       TensorProto tp;
       if (!tp.ParseFromString(
               {nonmemcpyable_pos,
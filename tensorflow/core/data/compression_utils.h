@@ -26,6 +26,20 @@ limitations under the License.
 namespace tensorflow {
 namespace data {
 
+// Selects how `CompressElement` encodes the components of an element before
+// compressing them.
+enum class CodecPolicy {
+  // Every component is stored with `CODEC_RAW`. The compressed element has
+  // version 0, which binaries predating component codecs can uncompress.
+  kRaw,
+  // Each component is encoded with a codec chosen from its dtype and contents
+  // (see `CompressedComponentMetadata::Codec`): sorted integers are
+  // delta-encoded, floating point values are byte-shuffled, and strings with
+  // many repeated values are dictionary-encoded. Elements with an encoded
+  // component have version 1, which older binaries reject.
+  kAuto,
+};
+
 // Compresses the components of `element` into the `CompressedElement` proto.
 //
 // In addition to writing the actual compressed bytes, `Compress` fills
@@ -35,6 +49,17 @@ namespace data {
 Status CompressElement(const std::vector<Tensor>& element,
                        CompressedElement* out);
 
+// Like `CompressElement`, but encodes the components according to `policy`.
+// `CompressElement(element, out)` is `CodecPolicy::kRaw`.
+Status CompressElement(const std::vector<Tensor>& element, CodecPolicy policy,
+                       CompressedElement* out);
+
+// Like `CompressElement`, but encodes every component whose dtype supports
+// `codec` with `codec`, and the other components with `CODEC_RAW`.
+Status CompressElement(const std::vector<Tensor>& element,
+                       CompressedComponentMetadata::Codec codec,
+                       CompressedElement* out);
+
 // Uncompresses a `CompressedElement` into a vector of tensor components.
 Status UncompressElement(const CompressedElement& compressed,
                          std::vector<Tensor>* out);
@@ -14,12 +14,16 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow/core/data/compression_utils.h"
 
+#include <cstdint>
+#include <limits>
 #include <string>
 #include <vector>
 
+#include "absl/strings/str_cat.h"
 #include "tensorflow/core/data/dataset_test_base.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 #include "tensorflow/core/protobuf/error_codes.pb.h"
 #include "tensorflow/tsl/platform/status_matchers.h"
 
@@ -98,7 +102,7 @@ TEST_P(ParameterizedCompressionUtilsTest, VersionMismatch) {
   CompressedElement compressed;
   TF_ASSERT_OK(CompressElement(element, &compressed));
 
-  compressed.set_version(1);
+  compressed.set_version(2);
   std::vector<Tensor> round_trip_element;
   EXPECT_THAT(UncompressElement(compressed, &round_trip_element),
               StatusIs(error::INTERNAL));
@@ -107,6 +111,272 @@ TEST_P(ParameterizedCompressionUtilsTest, VersionMismatch) {
 INSTANTIATE_TEST_SUITE_P(Instantiation, ParameterizedCompressionUtilsTest,
                          ::testing::ValuesIn(TestCases()));
 
+// Compresses `element` with `codec`, checks that its components are encoded
+// with `expected_codec`, and that it uncompresses to `element`.
+void ExpectCodecRoundTrip(const std::vector<Tensor>& element,
+                          CompressedComponentMetadata::Codec codec,
+                          CompressedComponentMetadata::Codec expected_codec) {
+  CompressedElement compressed;
+  TF_ASSERT_OK(CompressElement(element, codec, &compressed));
+  ASSERT_EQ(compressed.component_metadata_size(), element.size());
+  for (const auto& metadata : compressed.component_metadata()) {
+    EXPECT_EQ(metadata.codec(), expected_codec);
+  }
+  EXPECT_EQ(compressed.version(),
+            expected_codec == CompressedComponentMetadata::CODEC_RAW ? 0 : 1);
+  std::vector<Tensor> round_trip_element;
+  TF_ASSERT_OK(UncompressElement(compressed, &round_trip_element));
+  TF_EXPECT_OK(DatasetOpsTestBase::ExpectEqual(element, round_trip_element,
+                                               /*compare_order=*/true));
+}
+
+template <typename T>
+Tensor SequenceTensor(int64_t n, int64_t start, int64_t step) {
+  Tensor tensor(DataTypeToEnum<T>::value, TensorShape{n});
+  auto flat = tensor.flat<T>();
+  for (int64_t i = 0; i < n; ++i) {
+    flat(i) = static_cast<T>(start + i * step);
+  }
+  return tensor;
+}
+
+TEST(CompressionUtilsCodecTest, SortedIdsUseDeltaVarint) {
+  std::vector<Tensor> element = {
+      SequenceTensor<int64_t>(/*n=*/1000, /*start=*/1 << 30, /*step=*/3)};
+  CompressedElement compressed;
+  TF_ASSERT_OK(CompressElement(element, CodecPolicy::kAuto, &compressed));
+  EXPECT_EQ(compressed.version(), 1);
+  EXPECT_EQ(compressed.component_metadata(0).codec(),
+            CompressedComponentMetadata::CODEC_DELTA_VARINT);
+  EXPECT_LT(compressed.component_metadata(0).uncompressed_bytes(0),
+            1000 * sizeof(int64_t) / 4);
+  std::vector<Tensor> round_trip_element;
+  TF_ASSERT_OK(UncompressElement(compressed, &round_trip_element));
+  test::ExpectEqual(element[0], round_trip_element[0]);
+}
+
+TEST(CompressionUtilsCodecTest, DefaultPolicyIsRaw) {
+  std::vector<Tensor> element = {SequenceTensor<int64_t>(1000, 0, 1),
+                                 SequenceTensor<float>(64, 0, 1)};
+  CompressedElement compressed;
+  TF_ASSERT_OK(CompressElement(element, &compressed));
+  EXPECT_EQ(compressed.version(), 0);
+  for (const auto& metadata : compressed.component_metadata()) {
+    EXPECT_EQ(metadata.codec(), CompressedComponentMetadata::CODEC_RAW);
+  }
+}
+
+TEST(CompressionUtilsCodecTest, UnsortedIntegersStayRaw) {
+  Tensor tensor(DT_INT64, TensorShape{1000});
+  auto flat = tensor.flat<int64_t>();
+  for (int i = 0; i < 1000; ++i) {
+    flat(i) = (i % 2 == 0 ? 1 : -1) * (int64_t{1} << 40) * (i + 1);
+  }
+  CompressedElement compressed;
+  TF_ASSERT_OK(CompressElement({tensor}, CodecPolicy::kAuto, &compressed));
+  EXPECT_EQ(compressed.version(), 0);
+  EXPECT_EQ(compressed.component_metadata(0).codec(),
+            CompressedComponentMetadata::CODEC_RAW);
+}
+
+TEST(CompressionUtilsCodecTest, DeltaVarintExtremeValues) {
+  Tensor tensor(DT_INT64, TensorShape{32});
+  auto flat = tensor.flat<int64_t>();
+  for (int i = 0; i < 32; ++i) {
+    flat(i) = i % 2 == 0 ? std::numeric_limits<int64_t>::min() + i
+                         : std::numeric_limits<int64_t>::max() - i;
+  }
+  ExpectCodecRoundTrip({tensor}, CompressedComponentMetadata::CODEC_DELTA_VARINT,
+                       CompressedComponentMetadata::CODEC_DELTA_VARINT);
+}
+
+TEST(CompressionUtilsCodecTest, DeltaVarintAllIntegerTypes) {
+  ExpectCodecRoundTrip(
+      {SequenceTensor<int8_t>(100, -50, 1), SequenceTensor<uint8_t>(100, 0, 2),
+       SequenceTensor<int16_t>(100, 1000, -37),
+       SequenceTensor<uint16_t>(100, 0, 600),
+       SequenceTensor<int32_t>(100, -7, 100003),
+       SequenceTensor<uint32_t>(100, 1, 40000000),
+       SequenceTensor<int64_t>(100, 5, -123456789012),
+       SequenceTensor<uint64_t>(100, 0, 1000000000000)},
+      CompressedComponentMetadata::CODEC_DELTA_VARINT,
+      CompressedComponentMetadata::CODEC_DELTA_VARINT);
+}
+
+TEST(CompressionUtilsCodecTest, ByteShuffleFloatingPoint) {
+  Tensor floats(DT_FLOAT, TensorShape{10, 7});
+  Tensor doubles(DT_DOUBLE, TensorShape{33});
+  for (int i = 0; i < floats.NumElements(); ++i) {
+    floats.flat<float>()(i) = 0.5f * i - 3.0f;
+  }
+  for (int i = 0; i < doubles.NumElements(); ++i) {
+    doubles.flat<double>()(i) = 1.0 / (i + 1);
+  }
+  ExpectCodecRoundTrip({floats, doubles},
+                       CompressedComponentMetadata::CODEC_BYTE_SHUFFLE,
+                       CompressedComponentMetadata::CODEC_BYTE_SHUFFLE);
+
+  CompressedElement compressed;
+  TF_ASSERT_OK(CompressElement({floats}, CodecPolicy::kAuto, &compressed));
+  EXPECT_EQ(compressed.component_metadata(0).codec(),
+            CompressedComponentMetadata::CODEC_BYTE_SHUFFLE);
+}
+
+TEST(CompressionUtilsCodecTest, DictionaryStrings) {
+  std::vector<tstring> values;
+  for (int i = 0; i < 200; ++i) {
+    values.push_back(i % 3 == 0 ? "" : absl::StrCat("category_", i % 7));
+  }
+  std::vector<Tensor> element = {
+      CreateTensor<tstring>(TensorShape{20, 10}, values)};
+  ExpectCodecRoundTrip(element, CompressedComponentMetadata::CODEC_DICTIONARY,
+                       CompressedComponentMetadata::CODEC_DICTIONARY);
+
+  CompressedElement compressed;
+  TF_ASSERT_OK(CompressElement(element, CodecPolicy::kAuto, &compressed));
+  EXPECT_EQ(compressed.component_metadata(0).codec(),
+            CompressedComponentMetadata::CODEC_DICTIONARY);
+}
+
+TEST(CompressionUtilsCodecTest, DistinctStringsStayRaw) {
+  std::vector<tstring> values;
+  for (int i = 0; i < 100; ++i) {
+    values.push_back(absl::StrCat("unique_", i));
+  }
+  CompressedElement compressed;
+  TF_ASSERT_OK(
+      CompressElement({CreateTensor<tstring>(TensorShape{100}, values)},
+                      CodecPolicy::kAuto, &compressed));
+  EXPECT_EQ(compressed.version(), 0);
+  EXPECT_EQ(compressed.component_metadata(0).codec(),
+            CompressedComponentMetadata::CODEC_RAW);
+  EXPECT_EQ(compressed.component_metadata(0).uncompressed_bytes_size(), 100);
+}
+
+TEST(CompressionUtilsCodecTest, UnsupportedCodecFallsBackToRaw) {
+  std::vector<Tensor> element = {
+      CreateTensor<bool>(TensorShape{2}, {true, false}),
+      CreateTensor<tstring>(TensorShape{2}, {"a", "b"}),
+      DatasetOpsTestBase::CreateTestVariantTensor(
+          {CreateTensor<int64_t>(TensorShape{1}, {1})})};
+  ExpectCodecRoundTrip(element, CompressedComponentMetadata::CODEC_DELTA_VARINT,
+                       CompressedComponentMetadata::CODEC_RAW);
+  ExpectCodecRoundTrip(element, CompressedComponentMetadata::CODEC_BYTE_SHUFFLE,
+                       CompressedComponentMetadata::CODEC_RAW);
+}
+
+TEST(CompressionUtilsCodecTest, ForcedRawKeepsVersion) {
+  ExpectCodecRoundTrip({SequenceTensor<int64_t>(1000, 0, 1),
+                        CreateTensor<float>(TensorShape{64})},
+                       CompressedComponentMetadata::CODEC_RAW,
+                       CompressedComponentMetadata::CODEC_RAW);
+}
+
+TEST(CompressionUtilsCodecTest, EmptyTensors) {
+  ExpectCodecRoundTrip({CreateTensor<int64_t>(TensorShape{0, 4})},
+                       CompressedComponentMetadata::CODEC_DELTA_VARINT,
+                       CompressedComponentMetadata::CODEC_DELTA_VARINT);
+  ExpectCodecRoundTrip({Tensor(DT_STRING, TensorShape{0})},
+                       CompressedComponentMetadata::CODEC_DICTIONARY,
+                       CompressedComponentMetadata::CODEC_DICTIONARY);
+}
+
+TEST(CompressionUtilsCodecTest, CorruptedEncodingIsRejected) {
+  CompressedElement compressed;
+  TF_ASSERT_OK(CompressElement({SequenceTensor<int64_t>(100, 0, 1)},
+                               CompressedComponentMetadata::CODEC_DELTA_VARINT,
+                               &compressed));
+  compressed.mutable_component_metadata(0)->set_dtype(DT_FLOAT);
+  std::vector<Tensor> round_trip_element;
+  EXPECT_THAT(UncompressElement(compressed, &round_trip_element),
+              StatusIs(error::INTERNAL, HasSubstr("Unsupported codec")));
+}
+
+enum class BenchmarkData { kSortedIds = 0, kEmbeddings = 1, kCategories = 2 };
+
+std::vector<Tensor> BenchmarkElement(BenchmarkData data, int64_t n) {
+  switch (data) {
+    case BenchmarkData::kSortedIds: {
+      Tensor ids(DT_INT64, TensorShape{n});
+      int64_t id = 1000000;
+      for (int64_t i = 0; i < n; ++i) {
+        id += 1 + (i * 7919) % 13;
+        ids.flat<int64_t>()(i) = id;
+      }
+      return {ids};
+    }
+    case BenchmarkData::kEmbeddings: {
+      Tensor embeddings(DT_FLOAT, TensorShape{n / 64, 64});
+      for (int64_t i = 0; i < embeddings.NumElements(); ++i) {
+        embeddings.flat<float>()(i) =
+            static_cast<float>((i * 2654435761u) % 1000) / 1000.0f - 0.5f;
+      }
+      return {embeddings};
+    }
+    case BenchmarkData::kCategories: {
+      Tensor categories(DT_STRING, TensorShape{n});
+      for (int64_t i = 0; i < n; ++i) {
+        categories.flat<tstring>()(i) =
+            absl::StrCat("country_code_", (i * 31) % 50);
+      }
+      return {categories};
+    }
+  }
+  return {};
+}
+
+size_t ElementBytes(const std::vector<Tensor>& element) {
+  size_t bytes = 0;
+  for (const auto& component : element) {
+    if (component.dtype() == DT_STRING) {
+      const auto& flat = component.flat<tstring>();
+      for (int64_t i = 0; i < flat.size(); ++i) {
+        bytes += flat(i).size();
+      }
+    } else {
+      bytes += component.TotalBytes();
+    }
+  }
+  return bytes;
+}
+
+// Reports the compression ratio, and the compression and decompression
+// throughput of the element as `bytes_per_second`.
+void BM_CompressElementCodec(::testing::benchmark::State& state) {
+  const auto data = static_cast<BenchmarkData>(state.range(0));
+  const auto codec =
+      static_cast<CompressedComponentMetadata::Codec>(state.range(1));
+  const bool uncompress = state.range(2);
+  const std::vector<Tensor> element = BenchmarkElement(data, 1 << 16);
+
+  CompressedElement compressed;
+  TF_CHECK_OK(CompressElement(element, codec, &compressed));
+  std::vector<Tensor> round_trip_element;
+  for (auto s : state) {
+    if (uncompress) {
+      TF_CHECK_OK(UncompressElement(compressed, &round_trip_element));
+    } else {
+      CompressedElement out;
+      TF_CHECK_OK(CompressElement(element, codec, &out));
+    }
+  }
+  const size_t bytes = ElementBytes(element);
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * bytes);
+  state.counters["ratio"] =
+      static_cast<double>(bytes) / compressed.data().size();
+}
+
+BENCHMARK(BM_CompressElementCodec)
+    ->ArgNames({"data", "codec", "uncompress"})
+    ->ArgsProduct({{static_cast<int>(BenchmarkData::kSortedIds),
+                    static_cast<int>(BenchmarkData::kEmbeddings),
+                    static_cast<int>(BenchmarkData::kCategories)},
+                   {CompressedComponentMetadata::CODEC_RAW,
+                    CompressedComponentMetadata::CODEC_DELTA_VARINT,
+                    CompressedComponentMetadata::CODEC_BYTE_SHUFFLE,
+                    CompressedComponentMetadata::CODEC_DICTIONARY},
+                   {0, 1}});
+
 }  // namespace
 }  // namespace data
 }  // namespace tensorflow
@@ -19,6 +19,7 @@ limitations under the License.
 #include <array>
 #include <cstdint>
 #include <cstdlib>
+#include <cstring>
 #include <functional>
 #include <memory>
 #include <queue>
@@ -31,6 +32,7 @@ limitations under the License.
 #include "absl/container/flat_hash_set.h"
 #include "absl/strings/str_join.h"
 #include "tensorflow/core/common_runtime/function.h"
+#include "tensorflow/core/framework/allocation_description.pb.h"
 #include "tensorflow/core/framework/attr_value.pb.h"
 #include "tensorflow/core/framework/dataset.h"
 #include "tensorflow/core/framework/function.h"
@@ -43,7 +45,9 @@ limitations under the License.
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/graph/graph_def_builder.h"
 #include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/refcount.h"
 #include "tensorflow/core/lib/hash/hash.h"
+#include "tensorflow/core/lib/math/math_util.h"
 #include "tensorflow/core/lib/strings/proto_serialization.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/blocking_counter.h"
@@ -101,6 +105,7 @@ constexpr char kSlackPeriodOpt[] = "slack_period";
 constexpr char kMakeDeterministicOpt[] = "make_deterministic";
 constexpr char kFilterParallelizationOpt[] = "filter_parallelization";
 constexpr char kWarmStartOpt[] = "warm_start";
+constexpr char kParseExampleProjectionOpt[] = "parse_example_projection";
 
 void DefaultOptimizationGraphRewrites(
     const Options& options, absl::flat_hash_set<tstring>* optimization_enabled,
@@ -226,6 +231,14 @@ void DefaultOptimizationGraphRewrites(
       optimization_disabled->insert(kWarmStartOpt);
     }
   }
+  if (optimization_options.optional_parse_example_projection_case() ==
+      OptimizationOptions::kParseExampleProjection) {
+    if (optimization_options.parse_example_projection()) {
+      optimization_enabled->insert(kParseExampleProjectionOpt);
+    } else {
+      optimization_disabled->insert(kParseExampleProjectionOpt);
+    }
+  }
 }
 
 // Returns whether an op has been allowlisted as stateless. Uses a heuristic to
@@ -764,11 +777,219 @@ Status ProcessBatch(int64_t batch_size, int64_t num_elements,
   return OkStatus();
 }
 
+namespace {
+
+// Use parallelism for creating the batch as long as the final batch is at
+// least 1MB.
+constexpr int64_t kMinParallelCopyBytes = 1 << 20;
+
+// Owns the memory of all components of a columnar batch.
+class BatchArena : public TensorBuffer {
+ public:
+  BatchArena(Allocator* allocator, size_t size)
+      : TensorBuffer(
+            allocator->AllocateRaw(Allocator::kAllocatorAlignment, size)),
+        allocator_(allocator),
+        size_(size) {}
+
+  size_t size() const override { return size_; }
+  TensorBuffer* root_buffer() override { return this; }
+  bool GetAllocatedBytes(size_t* out_bytes) const override {
+    *out_bytes = size_;
+    return true;
+  }
+  void FillAllocationDescription(AllocationDescription* proto) const override {
+    proto->set_requested_bytes(size_);
+    proto->set_allocator_name(allocator_->Name());
+    proto->set_ptr(reinterpret_cast<uintptr_t>(data()));
+  }
+
+ private:
+  ~BatchArena() override {
+    if (data() != nullptr) {
+      allocator_->DeallocateRaw(data());
+    }
+  }
+
+  Allocator* const allocator_;
+  const size_t size_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(BatchArena);
+};
+
+// One component of a columnar batch, stored in `arena[offset, offset + size)`.
+// Each column is the root of its own buffer, so that a column whose batch has
+// been dropped can be forwarded (see `Tensor::RefCountIsOne()`).
+class BatchColumn : public TensorBuffer {
+ public:
+  BatchColumn(BatchArena* arena, size_t offset, size_t size)
+      : TensorBuffer(static_cast<char*>(arena->data()) + offset),
+        arena_(arena),
+        size_(size) {
+    arena_->Ref();
+  }
+
+  size_t size() const override { return size_; }
+  TensorBuffer* root_buffer() override { return this; }
+  // Accounts for the column only, so that the bytes of a batch add up to the
+  // size of its arena.
+  bool GetAllocatedBytes(size_t* out_bytes) const override {
+    *out_bytes = size_;
+    return true;
+  }
+  void FillAllocationDescription(AllocationDescription* proto) const override {
+    arena_->FillAllocationDescription(proto);
+    proto->set_requested_bytes(size_);
+    proto->set_ptr(reinterpret_cast<uintptr_t>(data()));
+  }
+
+ private:
+  ~BatchColumn() override { arena_->Unref(); }
+
+  BatchArena* const arena_;
+  const size_t size_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(BatchColumn);
+};
+
+bool UseColumnarBatch(const CopyBatchParams& params,
+                      const std::vector<std::vector<Tensor>>& batch_elements) {
+  const std::vector<Tensor>& first_element = batch_elements.at(0);
+  if (first_element.size() < params.min_columnar_batch_components) {
+    return false;
+  }
+  int64_t element_bytes = 0;
+  for (const Tensor& component : first_element) {
+    if (!DataTypeCanUseMemcpy(component.dtype())) {
+      return false;
+    }
+    element_bytes += component.TotalBytes();
+  }
+  return element_bytes * static_cast<int64_t>(batch_elements.size()) <=
+         params.max_columnar_batch_bytes;
+}
+
+// Copies a batch whose components all have memcpy-able types into columns
+// that share a single allocation. The copy is split into shards of about the
+// same number of bytes over the (component, element) pairs of the batch, so
+// that batches with many small components are copied in parallel too.
+Status CopyColumnarBatch(const CopyBatchParams& params,
+                         const std::vector<std::vector<Tensor>>& batch_elements,
+                         bool parallel_copy,
+                         const std::function<Status()>& allocation_callback,
+                         std::vector<Tensor>* out_tensors) {
+  const std::vector<Tensor>& first_element = batch_elements.at(0);
+  const int64_t num_components = first_element.size();
+  const int64_t num_batch_elements = batch_elements.size();
+
+  // `column_offsets` are the (aligned) offsets of the columns in the arena, and
+  // `copy_offsets` the offsets of the columns in the stream of bytes to copy.
+  std::vector<size_t> element_bytes(num_components);
+  std::vector<size_t> column_offsets(num_components + 1, 0);
+  std::vector<size_t> copy_offsets(num_components + 1, 0);
+  for (int64_t i = 0; i < num_components; ++i) {
+    element_bytes[i] = first_element[i].TotalBytes();
+    const size_t column_bytes = element_bytes[i] * num_batch_elements;
+    column_offsets[i + 1] =
+        column_offsets[i] +
+        MathUtil::CeilOfRatio<size_t>(column_bytes,
+                                      Allocator::kAllocatorAlignment) *
+            Allocator::kAllocatorAlignment;
+    copy_offsets[i + 1] = copy_offsets[i] + column_bytes;
+  }
+  const size_t total_bytes = copy_offsets[num_components];
+
+  BatchArena* arena =
+      new BatchArena(params.allocator, std::max<size_t>(
+                                           column_offsets[num_components], 1));
+  core::ScopedUnref unref_arena(arena);
+  if (arena->data() == nullptr) {
+    return errors::ResourceExhausted(
+        "Failed to allocate memory for a batch of ", num_components,
+        " components");
+  }
+  out_tensors->reserve(num_components);
+  for (int64_t i = 0; i < num_components; ++i) {
+    TensorShape batch_component_shape({num_batch_elements});
+    batch_component_shape.AppendShape(first_element[i].shape());
+    BatchColumn* column = new BatchColumn(
+        arena, column_offsets[i], element_bytes[i] * num_batch_elements);
+    out_tensors->emplace_back(first_element[i].dtype(), batch_component_shape,
+                              column);
+    column->Unref();
+  }
+  if (allocation_callback) {
+    TF_RETURN_IF_ERROR(allocation_callback());
+  }
+  for (int64_t index = 1; index < num_batch_elements; ++index) {
+    const std::vector<Tensor>& element = batch_elements[index];
+    for (int64_t i = 0; i < num_components; ++i) {
+      if (element[i].shape() != first_element[i].shape()) {
+        return errors::InvalidArgument(
+            "Cannot batch tensors with different shapes in component ", i,
+            ". First element had shape ",
+            first_element[i].shape().DebugString(), " and element ", index,
+            " had shape ", element[i].shape().DebugString(), ".");
+      }
+    }
+  }
+
+  // Copies the elements of the columns in the byte range [begin, end) of the
+  // copy stream, rounded to element boundaries.
+  char* const arena_base = static_cast<char*>(arena->data());
+  auto copy_range = [&](size_t begin, size_t end) {
+    for (int64_t i = std::upper_bound(copy_offsets.begin(), copy_offsets.end(),
+                                      begin) -
+                     copy_offsets.begin() - 1;
+         i < num_components && copy_offsets[i] < end; ++i) {
+      if (element_bytes[i] == 0) continue;
+      const int64_t first = MathUtil::CeilOfRatio<size_t>(
+          std::max(begin, copy_offsets[i]) - copy_offsets[i],
+          element_bytes[i]);
+      const int64_t last = std::min<int64_t>(
+          num_batch_elements,
+          MathUtil::CeilOfRatio<size_t>(
+              std::min(end, copy_offsets[i + 1]) - copy_offsets[i],
+              element_bytes[i]));
+      char* dest = arena_base + column_offsets[i];
+      for (int64_t index = first; index < last; ++index) {
+        memcpy(dest + index * element_bytes[i],
+               batch_elements[index][i].tensor_data().data(),
+               element_bytes[i]);
+      }
+    }
+  };
+
+  const int64_t num_shards = params.runner_threadpool_size;
+  if (parallel_copy && total_bytes >= kMinParallelCopyBytes &&
+      num_shards > 1) {
+    BlockingCounter counter(num_shards);
+    for (int64_t shard = 0; shard < num_shards; ++shard) {
+      const size_t begin = total_bytes * shard / num_shards;
+      const size_t end = total_bytes * (shard + 1) / num_shards;
+      (*params.runner)([begin, end, &copy_range, &counter]() {
+        copy_range(begin, end);
+        counter.DecrementCount();
+      });
+    }
+    counter.Wait();
+  } else {
+    copy_range(0, total_bytes);
+  }
+  return OkStatus();
+}
+
+}  // namespace
+
 Status CopyBatch(CopyBatchParams params,
                  const std::vector<std::vector<Tensor>>& batch_elements,
                  bool parallel_copy,
                  std::function<Status()> allocation_callback,
                  std::vector<Tensor>* out_tensors) {
+  if (UseColumnarBatch(params, batch_elements)) {
+    return CopyColumnarBatch(params, batch_elements, parallel_copy,
+                             allocation_callback, out_tensors);
+  }
   const size_t num_tuple_components = batch_elements.at(0).size();
   out_tensors->reserve(num_tuple_components);
   const int64_t num_batch_elements = batch_elements.size();
@@ -814,9 +1035,7 @@ Status CopyBatch(CopyBatchParams params,
     };
     const auto total_bytes =
         first_element.AllocatedBytes() * num_batch_elements;
-    // Use parallelism for creating the batch as long as the final batch is at
-    // least 1MB.
-    if (parallel_copy && total_bytes >= (1 << 20)) {
+    if (parallel_copy && total_bytes >= kMinParallelCopyBytes) {
       Status status;
       mutex status_mu;
       const auto num_threads = params.runner_threadpool_size;
@@ -283,6 +283,21 @@ struct CopyBatchParams {
   Allocator* allocator;
   std::function<void(std::function<void()>)>* runner;
   int64 runner_threadpool_size;
+  // Batches with at least this many components, all of which have a type that
+  // can be copied with memcpy, and at most `max_columnar_batch_bytes` bytes
+  // are copied into columns that share a single allocation. As a column that
+  // outlives the rest of its batch keeps the whole allocation alive, larger
+  // batches, for which the allocations are cheap compared to the copy, are
+  // allocated one component at a time.
+  int64 min_columnar_batch_components = 16;
+  int64 max_columnar_batch_bytes = 4 << 20;
+
+  CopyBatchParams(Allocator* allocator,
+                  std::function<void(std::function<void()>)>* runner,
+                  int64 runner_threadpool_size)
+      : allocator(allocator),
+        runner(runner),
+        runner_threadpool_size(runner_threadpool_size) {}
 
   explicit CopyBatchParams(IteratorContext* ctx) {
     allocator = ctx->allocator({});
@@ -305,6 +320,11 @@ struct CopyBatchParams {
 // invoke upon successful allocation of the memory for the batch. The
 // `out_tensors` argument will be used to store the resulting batch (one for
 // each component of the input).
+//
+// Wide batches of small components (see
+// `CopyBatchParams::min_columnar_batch_components`) are allocated at once, with
+// one contiguous column per component, and their copy is parallelized across
+// components as well as across elements.
 Status CopyBatch(CopyBatchParams params,
                  const std::vector<std::vector<Tensor>>& batch_elements,
                  bool parallel_copy,
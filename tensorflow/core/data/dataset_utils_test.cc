@@ -15,7 +15,9 @@ limitations under the License.
 
 #include "tensorflow/core/data/dataset_utils.h"
 
+#include <atomic>
 #include <functional>
+#include <limits>
 #include <string>
 #include <vector>
 
@@ -31,8 +33,10 @@ limitations under the License.
 #include "tensorflow/core/framework/types.pb.h"
 #include "tensorflow/core/framework/variant.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/platform/str_util.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 #include "tensorflow/core/protobuf/error_codes.pb.h"
 #include "tensorflow/core/util/work_sharder.h"
 #include "tensorflow/tsl/platform/status_matchers.h"
@@ -640,6 +644,7 @@ GetOptimizationsTestCase GetOptimizationTestCase4() {
   options.mutable_optimization_options()->set_shuffle_and_repeat_fusion(true);
   options.mutable_optimization_options()->set_inject_prefetch(true);
   options.mutable_optimization_options()->set_warm_start(true);
+  options.mutable_optimization_options()->set_parse_example_projection(true);
   options.set_slack(true);
   return {
       options,
@@ -647,7 +652,8 @@ GetOptimizationsTestCase GetOptimizationTestCase4() {
       {"filter_fusion", "filter_parallelization", "make_sloppy",
        "map_and_batch_fusion", "map_and_filter_fusion", "map_fusion",
        "map_parallelization", "noop_elimination", "parallel_batch",
-       "shuffle_and_repeat_fusion", "slack", "inject_prefetch", "warm_start"},
+       "shuffle_and_repeat_fusion", "slack", "inject_prefetch", "warm_start",
+       "parse_example_projection"},
       /*expected_disabled=*/{},
       /*expected_default=*/{}};
 }
@@ -716,6 +722,196 @@ TEST(DatasetUtilsTest, CountBytes) {
   EXPECT_EQ(GetTotalBytes(compressed), compressed_element.ByteSizeLong());
 }
 
+// Returns `num_elements` elements with `num_components` float components of
+// shape [component_size] each.
+std::vector<std::vector<Tensor>> MakeBatchElements(int64_t num_elements,
+                                                   int64_t num_components,
+                                                   int64_t component_size) {
+  std::vector<std::vector<Tensor>> elements(num_elements);
+  for (int64_t i = 0; i < num_elements; ++i) {
+    for (int64_t j = 0; j < num_components; ++j) {
+      Tensor component(DT_FLOAT, TensorShape({component_size}));
+      component.flat<float>().setConstant(i * num_components + j);
+      elements[i].push_back(std::move(component));
+    }
+  }
+  return elements;
+}
+
+class CopyBatchTest : public ::testing::TestWithParam<bool> {
+ protected:
+  CopyBatchTest()
+      : thread_pool_(Env::Default(), "copy_batch_test", /*num_threads=*/4),
+        runner_([this](std::function<void()> fn) {
+          thread_pool_.Schedule(std::move(fn));
+        }) {}
+
+  CopyBatchParams Params(int64_t min_columnar_batch_components,
+                         Allocator* allocator = cpu_allocator()) {
+    CopyBatchParams params(allocator, &runner_, thread_pool_.NumThreads());
+    params.min_columnar_batch_components = min_columnar_batch_components;
+    return params;
+  }
+
+  bool parallel_copy() const { return GetParam(); }
+
+  thread::ThreadPool thread_pool_;
+  std::function<void(std::function<void()>)> runner_;
+};
+
+TEST_P(CopyBatchTest, ColumnarBatchMatchesBatch) {
+  // Large enough to be copied in parallel.
+  auto elements = MakeBatchElements(/*num_elements=*/16, /*num_components=*/20,
+                                    /*component_size=*/1000);
+  std::vector<Tensor> expected;
+  TF_ASSERT_OK(
+      CopyBatch(Params(std::numeric_limits<int64_t>::max()), elements,
+                parallel_copy(), /*allocation_callback=*/nullptr, &expected));
+  std::vector<Tensor> columnar;
+  TF_ASSERT_OK(CopyBatch(Params(/*min_columnar_batch_components=*/20),
+                         elements, parallel_copy(),
+                         /*allocation_callback=*/nullptr, &columnar));
+  ASSERT_EQ(columnar.size(), 20);
+  for (int i = 0; i < columnar.size(); ++i) {
+    EXPECT_EQ(columnar[i].shape(), TensorShape({16, 1000}));
+    test::ExpectEqual(columnar[i], expected[i]);
+    // The columns share a single allocation, but each only accounts for its
+    // own bytes and can be forwarded on its own.
+    EXPECT_EQ(columnar[i].AllocatedBytes(), 16 * 1000 * sizeof(float));
+    EXPECT_TRUE(columnar[i].RefCountIsOne());
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(columnar[i].data()) %
+                  Allocator::kAllocatorAlignment,
+              0);
+  }
+  // The columns outlive each other.
+  Tensor last = columnar.back();
+  columnar.clear();
+  test::ExpectEqual(last, expected.back());
+}
+
+TEST_P(CopyBatchTest, ColumnarBatchWithEmptyComponents) {
+  auto elements = MakeBatchElements(/*num_elements=*/3, /*num_components=*/4,
+                                    /*component_size=*/0);
+  for (auto& element : elements) {
+    element.push_back(CreateTensor<int64_t>(TensorShape({2}), {1, 2}));
+  }
+  std::vector<Tensor> batch;
+  TF_ASSERT_OK(CopyBatch(Params(/*min_columnar_batch_components=*/1), elements,
+                         parallel_copy(), /*allocation_callback=*/nullptr,
+                         &batch));
+  ASSERT_EQ(batch.size(), 5);
+  EXPECT_EQ(batch[0].shape(), TensorShape({3, 0}));
+  test::ExpectEqual(batch[4], CreateTensor<int64_t>(TensorShape({3, 2}),
+                                                    {1, 2, 1, 2, 1, 2}));
+}
+
+TEST_P(CopyBatchTest, ColumnarBatchWithDifferentShapes) {
+  auto elements = MakeBatchElements(/*num_elements=*/3, /*num_components=*/4,
+                                    /*component_size=*/2);
+  elements[2][1] = Tensor(DT_FLOAT, TensorShape({3}));
+  std::vector<Tensor> batch;
+  EXPECT_THAT(
+      CopyBatch(Params(/*min_columnar_batch_components=*/1), elements,
+                parallel_copy(), /*allocation_callback=*/nullptr, &batch),
+      StatusIs(tsl::error::INVALID_ARGUMENT,
+               HasSubstr("different shapes in component 1")));
+}
+
+TEST_P(CopyBatchTest, StringComponentsAreNotColumnar) {
+  std::vector<std::vector<Tensor>> elements = {
+      {CreateTensor<int64_t>(TensorShape({}), {1}),
+       CreateTensor<tstring>(TensorShape({}), {"a"})},
+      {CreateTensor<int64_t>(TensorShape({}), {2}),
+       CreateTensor<tstring>(TensorShape({}), {"b"})}};
+  std::vector<Tensor> batch;
+  TF_ASSERT_OK(CopyBatch(Params(/*min_columnar_batch_components=*/1), elements,
+                         parallel_copy(), /*allocation_callback=*/nullptr,
+                         &batch));
+  EXPECT_FALSE(batch[0].SharesBufferWith(batch[1]));
+  test::ExpectEqual(batch[1],
+                    CreateTensor<tstring>(TensorShape({2}), {"a", "b"}));
+}
+
+// Counts the allocations made through it.
+class CountingAllocator : public Allocator {
+ public:
+  std::string Name() override { return "counting"; }
+  void* AllocateRaw(size_t alignment, size_t num_bytes) override {
+    ++num_allocations_;
+    return cpu_allocator()->AllocateRaw(alignment, num_bytes);
+  }
+  void DeallocateRaw(void* ptr) override {
+    cpu_allocator()->DeallocateRaw(ptr);
+  }
+  int num_allocations() const { return num_allocations_; }
+
+ private:
+  std::atomic<int> num_allocations_{0};
+};
+
+TEST_P(CopyBatchTest, LargeBatchesAreNotColumnar) {
+  auto elements = MakeBatchElements(/*num_elements=*/4, /*num_components=*/8,
+                                    /*component_size=*/256);
+  const int64_t batch_bytes = 4 * 8 * 256 * sizeof(float);
+  CountingAllocator allocator;
+  CopyBatchParams params =
+      Params(/*min_columnar_batch_components=*/1, &allocator);
+  params.max_columnar_batch_bytes = batch_bytes;
+  std::vector<Tensor> batch;
+  TF_ASSERT_OK(CopyBatch(params, elements, parallel_copy(),
+                         /*allocation_callback=*/nullptr, &batch));
+  EXPECT_EQ(allocator.num_allocations(), 1);
+  batch.clear();
+
+  params.max_columnar_batch_bytes = batch_bytes - 1;
+  TF_ASSERT_OK(CopyBatch(params, elements, parallel_copy(),
+                         /*allocation_callback=*/nullptr, &batch));
+  EXPECT_EQ(allocator.num_allocations(), 1 + 8);
+  ASSERT_EQ(batch.size(), 8);
+  EXPECT_EQ(batch[7].shape(), TensorShape({4, 256}));
+}
+
+INSTANTIATE_TEST_SUITE_P(ParallelCopy, CopyBatchTest, ::testing::Bool());
+
+// Copies batches of 32 elements with `num_components` float components of
+// 16 values each, in parallel as `ParallelBatchDataset` does. If `columnar` is
+// false, the batches are copied one component at a time. The examples per
+// second compare with `BM_ParallelBatchWideElements` in
+// `parallel_batch_dataset_op_test`, which batches the same elements.
+void BM_CopyBatch(::testing::benchmark::State& state) {
+  const int64_t num_components = state.range(0);
+  const bool columnar = state.range(1);
+  constexpr int64_t kBatchSize = 32;
+  const auto elements =
+      MakeBatchElements(kBatchSize, num_components, /*component_size=*/16);
+  thread::ThreadPool thread_pool(Env::Default(), "bm_copy_batch",
+                                 port::MaxParallelism());
+  std::function<void(std::function<void()>)> runner =
+      [&thread_pool](std::function<void()> fn) {
+        thread_pool.Schedule(std::move(fn));
+      };
+  CopyBatchParams params(cpu_allocator(), &runner, thread_pool.NumThreads());
+  params.min_columnar_batch_components =
+      columnar ? 1 : std::numeric_limits<int64_t>::max();
+  for (auto s : state) {
+    std::vector<Tensor> batch;
+    TF_CHECK_OK(CopyBatch(params, elements, /*parallel_copy=*/true,
+                          /*allocation_callback=*/nullptr, &batch));
+  }
+  state.SetItemsProcessed(state.iterations() * kBatchSize);
+  state.SetBytesProcessed(state.iterations() * kBatchSize * num_components *
+                          16 * sizeof(float));
+}
+
+BENCHMARK(BM_CopyBatch)
+    ->ArgPair(16, false)
+    ->ArgPair(16, true)
+    ->ArgPair(256, false)
+    ->ArgPair(256, true)
+    ->ArgPair(1024, false)
+    ->ArgPair(1024, true)
+    ->UseRealTime();
+
 TEST_F(DatasetOpsTestBase, TestVariantEqualityChecking) {
   Tensor scalar_0{DT_VARIANT, TensorShape({})};
   scalar_0.scalar<Variant>()() = TestVariant({CreateTensor<int64_t>({}, {0})});
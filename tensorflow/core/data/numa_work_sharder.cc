@@ -0,0 +1,101 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/data/numa_work_sharder.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "absl/strings/str_cat.h"
+#include "tensorflow/core/platform/cpu_info.h"
+#include "tensorflow/core/platform/numa.h"
+
+namespace tensorflow {
+namespace data {
+
+/* static */ std::unique_ptr<NumaWorkSharder> NumaWorkSharder::Create(
+    Env* env, const std::string& name, int num_threads) {
+  if (!port::NUMAEnabled() || port::NUMANumNodes() < 2) {
+    return nullptr;
+  }
+  const int num_nodes = port::NUMANumNodes();
+  return std::make_unique<NumaWorkSharder>(
+      env, name, num_nodes, std::max(num_threads / num_nodes, 1));
+}
+
+/* static */ NumaWorkSharder* NumaWorkSharder::Shared() {
+  static NumaWorkSharder* sharder =
+      Create(Env::Default(), "tf_data_numa", port::MaxParallelism()).release();
+  return sharder;
+}
+
+/* static */ int NumaWorkSharder::GetThreadNode() {
+  const int node = port::NUMAGetThreadNodeAffinity();
+  if (node != port::kNUMANoAffinity) {
+    return node;
+  }
+  // The stack is first touched by the thread itself, and does not move.
+  static thread_local const int stack_node = []() {
+    int stack_variable = 0;
+    return port::NUMAGetMemAffinity(&stack_variable);
+  }();
+  return stack_node;
+}
+
+NumaWorkSharder::NumaWorkSharder(Env* env, const std::string& name,
+                                 int num_nodes, int threads_per_node)
+    : threads_per_node_(threads_per_node) {
+  nodes_.reserve(num_nodes);
+  for (int i = 0; i < num_nodes; ++i) {
+    ThreadOptions thread_options;
+    thread_options.numa_node = i;
+    auto node = std::make_unique<Node>();
+    node->pool = std::make_unique<thread::ThreadPool>(
+        env, thread_options, absl::StrCat(name, "_numa_", i), threads_per_node,
+        /*low_latency_hint=*/false);
+    nodes_.push_back(std::move(node));
+  }
+}
+
+int NumaWorkSharder::PickNode(int consumer_node) const {
+  if (consumer_node >= 0 && consumer_node < num_nodes() &&
+      nodes_[consumer_node]->num_pending < threads_per_node_) {
+    return consumer_node;
+  }
+  int best_node = 0;
+  for (int i = 1; i < num_nodes(); ++i) {
+    if (nodes_[i]->num_pending < nodes_[best_node]->num_pending) {
+      best_node = i;
+    }
+  }
+  return best_node;
+}
+
+void NumaWorkSharder::Schedule(int node, std::function<void()> fn) {
+  Node* n = nodes_[node].get();
+  ++n->num_pending;
+  n->pool->Schedule([n, fn = std::move(fn)]() {
+    fn();
+    --n->num_pending;
+  });
+}
+
+std::function<void(std::function<void()>)> NumaWorkSharder::Runner(int node) {
+  return [this, node](std::function<void()> fn) {
+    Schedule(node, std::move(fn));
+  };
+}
+
+}  // namespace data
+}  // namespace tensorflow
@@ -0,0 +1,90 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_DATA_NUMA_WORK_SHARDER_H_
+#define TENSORFLOW_CORE_DATA_NUMA_WORK_SHARDER_H_
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/threadpool.h"
+
+namespace tensorflow {
+namespace data {
+
+// Shards work across one thread pool per NUMA node, whose threads are bound to
+// the node. The work still allocates memory with the usual allocators, so that
+// memory is local to the node when its pages are first touched by the work.
+//
+// `PickNode()` adapts the sharding to the load: work goes to the node of its
+// consumer while that node has idle threads, and otherwise to the least loaded
+// node.
+class NumaWorkSharder {
+ public:
+  // Returns a sharder with `num_threads` threads split across the NUMA nodes,
+  // or nullptr if NUMA is not supported or there is a single node.
+  static std::unique_ptr<NumaWorkSharder> Create(Env* env,
+                                                 const std::string& name,
+                                                 int num_threads);
+
+  // Returns the sharder shared by the process, which has
+  // `port::MaxParallelism()` threads, or nullptr if NUMA is not supported or
+  // there is a single node.
+  static NumaWorkSharder* Shared();
+
+  // Returns the NUMA node of the calling thread: the node it is bound to, or
+  // for an unbound thread the node its stack was allocated on, which is where
+  // the thread ran when it started. Returns `port::kNUMANoAffinity` if the node
+  // is unknown.
+  static int GetThreadNode();
+
+  // Creates a sharder with `threads_per_node` threads on each of `num_nodes`
+  // nodes.
+  NumaWorkSharder(Env* env, const std::string& name, int num_nodes,
+                  int threads_per_node);
+
+  int num_nodes() const { return nodes_.size(); }
+
+  // Returns the node that the next work consumed on `consumer_node` should be
+  // scheduled on. `consumer_node` may be `port::kNUMANoAffinity`.
+  int PickNode(int consumer_node) const;
+
+  // Schedules `fn` on the threads of `node`.
+  void Schedule(int node, std::function<void()> fn);
+
+  // Returns a runner that schedules closures on the threads of `node`. The
+  // runner must not outlive the sharder.
+  std::function<void(std::function<void()>)> Runner(int node);
+
+ private:
+  struct Node {
+    // The number of closures scheduled on the node that have not finished.
+    std::atomic<int64_t> num_pending{0};
+    // Must be ordered after `num_pending`, which its threads update until it
+    // is destroyed.
+    std::unique_ptr<thread::ThreadPool> pool;
+  };
+
+  const int threads_per_node_;
+  std::vector<std::unique_ptr<Node>> nodes_;
+};
+
+}  // namespace data
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_DATA_NUMA_WORK_SHARDER_H_
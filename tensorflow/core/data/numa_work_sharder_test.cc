@@ -0,0 +1,117 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/data/numa_work_sharder.h"
+
+#include <atomic>
+#include <functional>
+
+#include "tensorflow/core/platform/blocking_counter.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/notification.h"
+#include "tensorflow/core/platform/numa.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace data {
+namespace {
+
+TEST(NumaWorkSharderTest, PickNodePrefersConsumerNode) {
+  NumaWorkSharder sharder(Env::Default(), "test", /*num_nodes=*/2,
+                          /*threads_per_node=*/2);
+  EXPECT_EQ(sharder.num_nodes(), 2);
+  EXPECT_EQ(sharder.PickNode(/*consumer_node=*/0), 0);
+  EXPECT_EQ(sharder.PickNode(/*consumer_node=*/1), 1);
+  EXPECT_EQ(sharder.PickNode(port::kNUMANoAffinity), 0);
+}
+
+TEST(NumaWorkSharderTest, PickNodeSpillsWhenConsumerNodeIsBusy) {
+  NumaWorkSharder sharder(Env::Default(), "test", /*num_nodes=*/2,
+                          /*threads_per_node=*/2);
+  Notification unblock;
+  BlockingCounter started(2);
+  for (int i = 0; i < 2; ++i) {
+    sharder.Schedule(/*node=*/1, [&]() {
+      started.DecrementCount();
+      unblock.WaitForNotification();
+    });
+  }
+  started.Wait();
+  EXPECT_EQ(sharder.PickNode(/*consumer_node=*/1), 0);
+  EXPECT_EQ(sharder.PickNode(/*consumer_node=*/0), 0);
+  unblock.Notify();
+}
+
+TEST(NumaWorkSharderTest, ScheduleRunsAllClosures) {
+  const int kNumClosures = 100;
+  std::atomic<int> num_runs(0);
+  {
+    NumaWorkSharder sharder(Env::Default(), "test", /*num_nodes=*/2,
+                            /*threads_per_node=*/2);
+    BlockingCounter counter(kNumClosures);
+    for (int i = 0; i < kNumClosures; ++i) {
+      sharder.Schedule(i % sharder.num_nodes(), [&]() {
+        ++num_runs;
+        counter.DecrementCount();
+      });
+    }
+    counter.Wait();
+  }
+  EXPECT_EQ(num_runs, kNumClosures);
+}
+
+TEST(NumaWorkSharderTest, Runner) {
+  NumaWorkSharder sharder(Env::Default(), "test", /*num_nodes=*/2,
+                          /*threads_per_node=*/1);
+  std::function<void(std::function<void()>)> runner = sharder.Runner(1);
+  Notification done;
+  runner([&]() { done.Notify(); });
+  done.WaitForNotification();
+}
+
+TEST(NumaWorkSharderTest, CreateRequiresMultipleNodes) {
+  auto sharder = NumaWorkSharder::Create(Env::Default(), "test",
+                                         /*num_threads=*/4);
+  if (port::NUMAEnabled() && port::NUMANumNodes() > 1) {
+    ASSERT_NE(sharder, nullptr);
+    EXPECT_EQ(sharder->num_nodes(), port::NUMANumNodes());
+  } else {
+    EXPECT_EQ(sharder, nullptr);
+  }
+}
+
+TEST(NumaWorkSharderTest, SharedIsCreatedOnce) {
+  NumaWorkSharder* sharder = NumaWorkSharder::Shared();
+  EXPECT_EQ(NumaWorkSharder::Shared(), sharder);
+  if (port::NUMAEnabled() && port::NUMANumNodes() > 1) {
+    ASSERT_NE(sharder, nullptr);
+    EXPECT_EQ(sharder->num_nodes(), port::NUMANumNodes());
+  } else {
+    EXPECT_EQ(sharder, nullptr);
+  }
+}
+
+TEST(NumaWorkSharderTest, GetThreadNode) {
+  const int node = NumaWorkSharder::GetThreadNode();
+  if (port::NUMAEnabled()) {
+    EXPECT_GE(node, port::kNUMANoAffinity);
+    EXPECT_LT(node, port::NUMANumNodes());
+  } else {
+    EXPECT_EQ(node, port::kNUMANoAffinity);
+  }
+}
+
+}  // namespace
+}  // namespace data
+}  // namespace tensorflow
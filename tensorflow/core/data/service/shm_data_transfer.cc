@@ -0,0 +1,1076 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/data/service/shm_data_transfer.h"
+
+#if defined(__linux__)
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/mman.h>
+#include <sys/random.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif  // __linux__
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "tensorflow/core/data/service/data_transfer.h"
+#include "tensorflow/core/data/service/worker.pb.h"
+#include "tensorflow/core/framework/dataset.pb.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor.pb.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/framework/variant.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/random.h"
+#include "tensorflow/core/platform/status.h"
+#include "tensorflow/core/platform/statusor.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+
+namespace tensorflow {
+namespace data {
+namespace {
+
+#if defined(__linux__)
+
+// Minimum size of the shared memory segment of a connection. Segments are
+// sized to the smallest power of two that fits the element, and are replaced
+// when an element does not fit.
+constexpr size_t kInitialSegmentBytes = 4 << 20;
+// A segment is also replaced by a smaller one when it is at least this many
+// times the size an element needs, so that one large element does not pin a
+// large segment for the rest of the connection.
+constexpr size_t kSegmentShrinkFactor = 4;
+// Alignment of the component headers and payloads in a segment.
+constexpr size_t kAlignment = 64;
+// Upper bound on the size of the variable-length fields of the control
+// messages, to detect peers which do not speak the protocol.
+constexpr uint64_t kMaxControlMessageBytes = 16 << 20;
+// Time for a client to present the secret of the server after connecting.
+constexpr int kHandshakeTimeoutSeconds = 10;
+
+// How a component is encoded in shared memory.
+enum class ComponentEncoding : uint32_t {
+  // The tensor buffer, for types which can be copied with memcpy.
+  kRaw = 0,
+  // The lengths of the strings of a DT_STRING tensor, followed by their bytes.
+  kString = 1,
+  // A serialized `CompressedElement`, for scalar compressed element variants.
+  kCompressedElement = 2,
+  // A serialized `TensorProto`, for all other tensors.
+  kTensorProto = 3,
+};
+
+// Precedes the dimension sizes and the payload of each component.
+struct ComponentHeader {
+  uint32_t dtype;
+  ComponentEncoding encoding;
+  uint32_t num_dims;
+  uint32_t reserved;
+  uint64_t payload_bytes;
+};
+
+// Contents of the segment named in the compatibility info. The token is also
+// published in the compatibility info, to check that a client reads the segment
+// of the server. The secret is only readable by the processes which can open
+// the segment, and is the first message a client sends on a connection.
+struct TokenSegmentContents {
+  uint64_t token;
+  uint64_t secret[2];
+};
+
+// Response to a `GetElementRequest`. Followed on the socket by `message_bytes`
+// bytes of status message, by `segment_name_bytes` bytes of segment name if the
+// connection switched to a new segment, and by `element_bytes` bytes of element
+// if `inline_element` is set.
+struct ResponseHeader {
+  uint32_t code;
+  uint32_t end_of_sequence;
+  uint32_t skip;
+  // Whether the element is sent on the socket, because no segment could be
+  // allocated for it.
+  uint32_t inline_element;
+  int64_t element_index;
+  uint64_t element_bytes;
+  uint64_t segment_bytes;
+  uint64_t message_bytes;
+  uint64_t segment_name_bytes;
+};
+
+size_t AlignUp(size_t n) {
+  return (n + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+// Returns the size of the segment to create for an element of `element_bytes`
+// bytes.
+size_t SegmentBytesFor(size_t element_bytes) {
+  size_t segment_bytes = kInitialSegmentBytes;
+  while (segment_bytes < element_bytes) {
+    segment_bytes *= 2;
+  }
+  return segment_bytes;
+}
+
+// Returns the offset of the payload of a component whose header is at
+// `offset`.
+size_t PayloadOffset(size_t offset, uint32_t num_dims) {
+  return AlignUp(offset + sizeof(ComponentHeader) + num_dims * sizeof(int64_t));
+}
+
+std::string NewSegmentName() {
+  return absl::StrCat("/tf_data_shm_", getpid(), "_", random::New64());
+}
+
+void SetNoDelay(int fd) {
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+// Sets the timeout of the reads from `fd`, or removes it if `seconds` is 0.
+void SetReceiveTimeout(int fd, int seconds) {
+  timeval timeout;
+  timeout.tv_sec = seconds;
+  timeout.tv_usec = 0;
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+}
+
+// Fills `data` with `n` bytes from the kernel random number generator.
+Status GetRandomBytes(void* data, size_t n) {
+  char* p = static_cast<char*>(data);
+  while (n > 0) {
+    ssize_t read = getrandom(p, n, 0);
+    if (read < 0) {
+      if (errno == EINTR) continue;
+      return errors::Internal("Failed to generate random bytes: ",
+                              strerror(errno));
+    }
+    p += read;
+    n -= read;
+  }
+  return OkStatus();
+}
+
+Status WriteFully(int fd, const void* data, size_t n) {
+  const char* p = static_cast<const char*>(data);
+  while (n > 0) {
+    ssize_t written = send(fd, p, n, MSG_NOSIGNAL);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      return errors::Unavailable("Failed to send shared memory transfer data: ",
+                                 strerror(errno));
+    }
+    p += written;
+    n -= written;
+  }
+  return OkStatus();
+}
+
+Status ReadFully(int fd, void* data, size_t n) {
+  char* p = static_cast<char*>(data);
+  while (n > 0) {
+    ssize_t read = recv(fd, p, n, 0);
+    if (read < 0) {
+      if (errno == EINTR) continue;
+      return errors::Unavailable(
+          "Failed to receive shared memory transfer data: ", strerror(errno));
+    }
+    if (read == 0) {
+      return errors::Unavailable("Shared memory transfer connection closed.");
+    }
+    p += read;
+    n -= read;
+  }
+  return OkStatus();
+}
+
+// Reads a string of `size` bytes from `fd`.
+Status ReadString(int fd, uint64_t size, std::string& str) {
+  if (size > kMaxControlMessageBytes) {
+    return errors::DataLoss("Invalid shared memory transfer message of ", size,
+                            " bytes.");
+  }
+  str.resize(size);
+  return ReadFully(fd, str.data(), size);
+}
+
+// A POSIX shared memory segment mapped into this process.
+class SharedMemorySegment {
+ public:
+  // Creates a segment of `size` bytes named `name`, mapped for writing. The
+  // segment is unlinked when destroyed. Returns ResourceExhausted if its pages
+  // cannot be allocated.
+  static StatusOr<std::unique_ptr<SharedMemorySegment>> Create(
+      const std::string& name, size_t size) {
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+      return errors::IOError(
+          absl::StrCat("Failed to create shared memory segment ", name), errno);
+    }
+    if (ftruncate(fd, size) != 0) {
+      Status s = errors::IOError(
+          absl::StrCat("Failed to resize shared memory segment ", name), errno);
+      close(fd);
+      shm_unlink(name.c_str());
+      return s;
+    }
+    // `ftruncate` reserves no pages, so writing to the mapping of a segment
+    // which does not fit in /dev/shm would raise SIGBUS.
+    int error;
+    do {
+      error = posix_fallocate(fd, 0, size);
+    } while (error == EINTR);
+    if (error != 0) {
+      close(fd);
+      shm_unlink(name.c_str());
+      return errors::ResourceExhausted("Failed to allocate ", size,
+                                       " bytes for shared memory segment ",
+                                       name, ": ", strerror(error));
+    }
+    void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+      Status s = errors::IOError(
+          absl::StrCat("Failed to map shared memory segment ", name), errno);
+      shm_unlink(name.c_str());
+      return s;
+    }
+    return absl::WrapUnique(new SharedMemorySegment(
+        name, static_cast<char*>(data), size, /*linked=*/true));
+  }
+
+  // Maps the first `size` bytes of the existing segment `name` for reading.
+  static StatusOr<std::unique_ptr<SharedMemorySegment>> Open(
+      const std::string& name, size_t size) {
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+      return errors::IOError(
+          absl::StrCat("Failed to open shared memory segment ", name), errno);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < size) {
+      close(fd);
+      return errors::DataLoss("Shared memory segment ", name,
+                              " is smaller than ", size, " bytes.");
+    }
+    void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+      return errors::IOError(
+          absl::StrCat("Failed to map shared memory segment ", name), errno);
+    }
+    return absl::WrapUnique(new SharedMemorySegment(
+        name, static_cast<char*>(data), size, /*linked=*/false));
+  }
+
+  ~SharedMemorySegment() {
+    munmap(data_, size_);
+    Unlink();
+  }
+
+  // Removes the name of a segment created by this process. The memory stays
+  // mapped in the processes which have opened it.
+  void Unlink() {
+    if (linked_) {
+      shm_unlink(name_.c_str());
+      linked_ = false;
+    }
+  }
+
+  const std::string& name() const { return name_; }
+  char* data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  SharedMemorySegment(const std::string& name, char* data, size_t size,
+                      bool linked)
+      : name_(name), data_(data), size_(size), linked_(linked) {}
+
+  const std::string name_;
+  char* const data_;
+  const size_t size_;
+  bool linked_;
+};
+
+// Encodes the components of an element for shared memory: the number of
+// components, followed by a `ComponentHeader`, the dimension sizes, and the
+// payload of each component.
+class ElementEncoder {
+ public:
+  explicit ElementEncoder(const std::vector<Tensor>& components)
+      : components_(components) {}
+
+  // Computes the encoded size, serializing the components which are not
+  // copied as is.
+  Status Prepare() {
+    size_ = AlignUp(sizeof(uint64_t));
+    serialized_.resize(components_.size());
+    for (int i = 0; i < components_.size(); ++i) {
+      const Tensor& tensor = components_[i];
+      uint64_t payload_bytes = 0;
+      ComponentEncoding encoding = EncodingOf(tensor);
+      switch (encoding) {
+        case ComponentEncoding::kRaw:
+          payload_bytes = tensor.tensor_data().size();
+          break;
+        case ComponentEncoding::kString: {
+          auto strings = tensor.flat<tstring>();
+          payload_bytes = strings.size() * sizeof(uint64_t);
+          for (int64_t j = 0; j < strings.size(); ++j) {
+            payload_bytes += strings(j).size();
+          }
+          break;
+        }
+        case ComponentEncoding::kCompressedElement:
+          if (!tensor.scalar<Variant>()()
+                   .get<CompressedElement>()
+                   ->SerializeToString(&serialized_[i])) {
+            return errors::Internal("Failed to serialize compressed element.");
+          }
+          payload_bytes = serialized_[i].size();
+          break;
+        case ComponentEncoding::kTensorProto: {
+          TensorProto proto;
+          tensor.AsProtoTensorContent(&proto);
+          if (!proto.SerializeToString(&serialized_[i])) {
+            return errors::Internal("Failed to serialize tensor.");
+          }
+          payload_bytes = serialized_[i].size();
+          break;
+        }
+      }
+      encodings_.push_back(encoding);
+      payload_bytes_.push_back(payload_bytes);
+      size_ = AlignUp(PayloadOffset(size_, tensor.dims()) + payload_bytes);
+    }
+    return OkStatus();
+  }
+
+  // The number of bytes written by `Encode`.
+  size_t size() const { return size_; }
+
+  // Writes the encoded element to `dst`, which must have `size()` bytes.
+  void Encode(char* dst) const {
+    uint64_t num_components = components_.size();
+    std::memcpy(dst, &num_components, sizeof(num_components));
+    size_t offset = AlignUp(sizeof(uint64_t));
+    for (int i = 0; i < components_.size(); ++i) {
+      const Tensor& tensor = components_[i];
+      ComponentHeader header{static_cast<uint32_t>(tensor.dtype()),
+                             encodings_[i],
+                             static_cast<uint32_t>(tensor.dims()),
+                             /*reserved=*/0, payload_bytes_[i]};
+      std::memcpy(dst + offset, &header, sizeof(header));
+      int64_t* dims =
+          reinterpret_cast<int64_t*>(dst + offset + sizeof(ComponentHeader));
+      for (int d = 0; d < tensor.dims(); ++d) {
+        dims[d] = tensor.dim_size(d);
+      }
+      char* payload = dst + PayloadOffset(offset, tensor.dims());
+      switch (encodings_[i]) {
+        case ComponentEncoding::kRaw:
+          std::memcpy(payload, tensor.tensor_data().data(),
+                      tensor.tensor_data().size());
+          break;
+        case ComponentEncoding::kString: {
+          auto strings = tensor.flat<tstring>();
+          uint64_t* lengths = reinterpret_cast<uint64_t*>(payload);
+          char* bytes = payload + strings.size() * sizeof(uint64_t);
+          for (int64_t j = 0; j < strings.size(); ++j) {
+            lengths[j] = strings(j).size();
+            std::memcpy(bytes, strings(j).data(), strings(j).size());
+            bytes += strings(j).size();
+          }
+          break;
+        }
+        case ComponentEncoding::kCompressedElement:
+        case ComponentEncoding::kTensorProto:
+          std::memcpy(payload, serialized_[i].data(), serialized_[i].size());
+          break;
+      }
+      offset =
+          AlignUp(PayloadOffset(offset, tensor.dims()) + payload_bytes_[i]);
+    }
+  }
+
+ private:
+  static ComponentEncoding EncodingOf(const Tensor& tensor) {
+    if (DataTypeCanUseMemcpy(tensor.dtype())) {
+      return ComponentEncoding::kRaw;
+    }
+    if (tensor.dtype() == DT_STRING) {
+      return ComponentEncoding::kString;
+    }
+    if (tensor.dtype() == DT_VARIANT && tensor.dims() == 0 &&
+        tensor.scalar<Variant>()().get<CompressedElement>() != nullptr) {
+      return ComponentEncoding::kCompressedElement;
+    }
+    return ComponentEncoding::kTensorProto;
+  }
+
+  const std::vector<Tensor>& components_;
+  std::vector<ComponentEncoding> encodings_;
+  std::vector<uint64_t> payload_bytes_;
+  std::vector<std::string> serialized_;
+  size_t size_ = 0;
+};
+
+// Decodes the element of `size` bytes encoded at `data` by `ElementEncoder`.
+Status DecodeElement(const char* data, size_t size,
+                     std::vector<Tensor>& components) {
+  auto corrupted = [] {
+    return errors::DataLoss("Corrupted element in shared memory.");
+  };
+  uint64_t num_components = 0;
+  if (size < sizeof(num_components)) {
+    return corrupted();
+  }
+  std::memcpy(&num_components, data, sizeof(num_components));
+  size_t offset = AlignUp(sizeof(uint64_t));
+  for (uint64_t i = 0; i < num_components; ++i) {
+    ComponentHeader header;
+    if (offset + sizeof(header) > size) {
+      return corrupted();
+    }
+    std::memcpy(&header, data + offset, sizeof(header));
+    const size_t payload_offset = PayloadOffset(offset, header.num_dims);
+    if (header.num_dims > TensorShape::MaxDimensions() ||
+        payload_offset > size || header.payload_bytes > size - payload_offset ||
+        !DataType_IsValid(header.dtype)) {
+      return corrupted();
+    }
+    std::vector<int64_t> dims(header.num_dims);
+    std::memcpy(dims.data(), data + offset + sizeof(header),
+                header.num_dims * sizeof(int64_t));
+    TensorShape shape;
+    TF_RETURN_IF_ERROR(TensorShape::BuildTensorShape(dims, &shape));
+    const DataType dtype = static_cast<DataType>(header.dtype);
+    const char* payload = data + payload_offset;
+    switch (header.encoding) {
+      case ComponentEncoding::kRaw: {
+        if (!DataTypeCanUseMemcpy(dtype)) {
+          return corrupted();
+        }
+        Tensor tensor(dtype, shape);
+        if (tensor.tensor_data().size() != header.payload_bytes) {
+          return corrupted();
+        }
+        std::memcpy(const_cast<char*>(tensor.tensor_data().data()), payload,
+                    header.payload_bytes);
+        components.push_back(std::move(tensor));
+        break;
+      }
+      case ComponentEncoding::kString: {
+        Tensor tensor(DT_STRING, shape);
+        auto strings = tensor.flat<tstring>();
+        uint64_t remaining = header.payload_bytes;
+        if (strings.size() > remaining / sizeof(uint64_t)) {
+          return corrupted();
+        }
+        remaining -= strings.size() * sizeof(uint64_t);
+        const char* bytes = payload + strings.size() * sizeof(uint64_t);
+        for (int64_t j = 0; j < strings.size(); ++j) {
+          uint64_t length;
+          std::memcpy(&length, payload + j * sizeof(uint64_t), sizeof(length));
+          if (length > remaining) {
+            return corrupted();
+          }
+          strings(j).assign(bytes, length);
+          bytes += length;
+          remaining -= length;
+        }
+        components.push_back(std::move(tensor));
+        break;
+      }
+      case ComponentEncoding::kCompressedElement: {
+        CompressedElement compressed;
+        if (!compressed.ParseFromArray(payload, header.payload_bytes)) {
+          return corrupted();
+        }
+        Tensor tensor(DT_VARIANT, TensorShape{});
+        tensor.scalar<Variant>()() = std::move(compressed);
+        components.push_back(std::move(tensor));
+        break;
+      }
+      case ComponentEncoding::kTensorProto: {
+        TensorProto proto;
+        Tensor tensor;
+        if (!proto.ParseFromArray(payload, header.payload_bytes) ||
+            !tensor.FromProto(proto)) {
+          return corrupted();
+        }
+        components.push_back(std::move(tensor));
+        break;
+      }
+      default:
+        return corrupted();
+    }
+    offset = AlignUp(payload_offset + header.payload_bytes);
+  }
+  return OkStatus();
+}
+
+// Serves `GetElement` requests from clients on the same host. Each client
+// connection is served by its own thread, which copies the elements into a
+// shared memory segment owned by the connection. Connections whose first
+// message is not the secret of the server are closed.
+class ShmDataTransferServer : public DataTransferServer {
+ public:
+  explicit ShmDataTransferServer(GetElementT get_element)
+      : get_element_(std::move(get_element)) {}
+
+  ~ShmDataTransferServer() override {
+    {
+      mutex_lock l(mu_);
+      cancelled_ = true;
+      for (int fd : connection_fds_) {
+        shutdown(fd, SHUT_RDWR);
+      }
+    }
+    if (listen_fd_ >= 0) {
+      shutdown(listen_fd_, SHUT_RDWR);
+    }
+    accept_thread_.reset();
+    // No connection is accepted anymore. The threads are joined without
+    // holding `mu_`, which they acquire when they finish.
+    absl::flat_hash_map<int, std::unique_ptr<Thread>> connection_threads;
+    {
+      mutex_lock l(mu_);
+      connection_threads = std::move(connection_threads_);
+    }
+    connection_threads.clear();
+    ReapFinishedConnections();
+    if (listen_fd_ >= 0) {
+      close(listen_fd_);
+    }
+  }
+
+  Status Start() override {
+    listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0) {
+      return errors::IOError("Failed to create socket", errno);
+    }
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    socklen_t addr_len = sizeof(addr);
+    if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) !=
+            0 ||
+        listen(listen_fd_, SOMAXCONN) != 0 ||
+        getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&addr),
+                    &addr_len) != 0) {
+      return errors::IOError("Failed to listen on a loopback port", errno);
+    }
+    port_ = ntohs(addr.sin_port);
+
+    TokenSegmentContents contents;
+    contents.token = random::New64();
+    TF_RETURN_IF_ERROR(GetRandomBytes(secret_, sizeof(secret_)));
+    std::memcpy(contents.secret, secret_, sizeof(secret_));
+    TF_ASSIGN_OR_RETURN(token_segment_,
+                        SharedMemorySegment::Create(NewSegmentName(),
+                                                    sizeof(contents)));
+    std::memcpy(token_segment_->data(), &contents, sizeof(contents));
+    token_ = contents.token;
+
+    accept_thread_ = absl::WrapUnique(Env::Default()->StartThread(
+        {}, "tf_data_shm_accept", [this] { AcceptConnections(); }));
+    return OkStatus();
+  }
+
+  int get_port() override { return port_; }
+
+  // Clients which can read `token_` from the segment named in the
+  // compatibility info share the memory of the server, and read the secret
+  // which they present on their connections.
+  StatusOr<std::string> GetCompatibilityInfo() const override {
+    if (token_segment_ == nullptr) {
+      return errors::FailedPrecondition(
+          "The shared memory data transfer server has not been started.");
+    }
+    return absl::StrCat(token_segment_->name(), ",", token_);
+  }
+
+ private:
+  void AcceptConnections() {
+    while (true) {
+      int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+      ReapFinishedConnections();
+      mutex_lock l(mu_);
+      if (cancelled_) {
+        if (fd >= 0) {
+          close(fd);
+        }
+        return;
+      }
+      if (fd < 0) {
+        if (errno == EINTR || errno == ECONNABORTED) {
+          continue;
+        }
+        LOG(ERROR) << "Shared memory data transfer server stopped accepting "
+                   << "connections: " << strerror(errno);
+        return;
+      }
+      SetNoDelay(fd);
+      connection_fds_.insert(fd);
+      // The thread removes itself from `connection_threads_` when it finishes,
+      // which waits for `mu_`, so it is inserted first.
+      connection_threads_[fd] = absl::WrapUnique(
+          Env::Default()->StartThread({}, "tf_data_shm_connection",
+                                      [this, fd] { ServeConnection(fd); }));
+    }
+  }
+
+  // Joins the threads of the connections which were closed.
+  void ReapFinishedConnections() TF_LOCKS_EXCLUDED(mu_) {
+    std::vector<std::unique_ptr<Thread>> finished_threads;
+    {
+      mutex_lock l(mu_);
+      finished_threads.swap(finished_connection_threads_);
+    }
+    finished_threads.clear();
+  }
+
+  // Returns whether the client connected to `fd` presents `secret_`.
+  bool Handshake(int fd) {
+    uint64_t secret[2];
+    SetReceiveTimeout(fd, kHandshakeTimeoutSeconds);
+    Status s = ReadFully(fd, secret, sizeof(secret));
+    SetReceiveTimeout(fd, 0);
+    if (!s.ok()) {
+      return false;
+    }
+    if (std::memcmp(secret, secret_, sizeof(secret)) != 0) {
+      LOG(WARNING) << "Closing a shared memory data transfer connection which "
+                   << "did not present the secret of the server.";
+      return false;
+    }
+    return true;
+  }
+
+  // Serves the client connected to `fd` if it presents the secret.
+  void ServeConnection(int fd) {
+    if (Handshake(fd)) {
+      ServeRequests(fd);
+    }
+    mutex_lock l(mu_);
+    connection_fds_.erase(fd);
+    close(fd);
+    // The thread cannot join itself, so it is joined by the accept thread or
+    // the destructor.
+    auto it = connection_threads_.find(fd);
+    if (it != connection_threads_.end()) {
+      finished_connection_threads_.push_back(std::move(it->second));
+      connection_threads_.erase(it);
+    }
+  }
+
+  // Serves the requests of the client connected to `fd` until it disconnects.
+  void ServeRequests(int fd) {
+    std::unique_ptr<SharedMemorySegment> segment;
+    while (true) {
+      uint64_t request_bytes = 0;
+      std::string serialized_request;
+      if (!ReadFully(fd, &request_bytes, sizeof(request_bytes)).ok() ||
+          !ReadString(fd, request_bytes, serialized_request).ok()) {
+        break;
+      }
+      if (segment != nullptr) {
+        // The client maps the segment before sending its next request.
+        segment->Unlink();
+      }
+      GetElementRequest request;
+      GetElementResult result;
+      ResponseHeader header;
+      std::memset(&header, 0, sizeof(header));
+      std::string segment_name;
+      std::string inline_element;
+      Status s = request.ParseFromString(serialized_request)
+                     ? get_element_(&request, &result)
+                     : errors::InvalidArgument("Failed to parse request.");
+      if (s.ok()) {
+        s = WriteElement(result, segment, header, segment_name,
+                         inline_element);
+      }
+      const std::string message(s.message());
+      header.code = static_cast<uint32_t>(s.code());
+      header.message_bytes = message.size();
+      header.segment_name_bytes = segment_name.size();
+      if (!WriteFully(fd, &header, sizeof(header)).ok() ||
+          !WriteFully(fd, message.data(), message.size()).ok() ||
+          !WriteFully(fd, segment_name.data(), segment_name.size()).ok() ||
+          !WriteFully(fd, inline_element.data(), inline_element.size()).ok()) {
+        break;
+      }
+    }
+  }
+
+  // Copies `result` into `segment`, replacing the segment if the element does
+  // not fit or only needs a small part of it, in which case the name of the new
+  // segment is set in `segment_name`. If no segment can be allocated for an
+  // element that does not fit, it is encoded into `inline_element` instead, to
+  // be sent on the socket: the element was already produced, so failing the
+  // request would lose it.
+  static Status WriteElement(const GetElementResult& result,
+                             std::unique_ptr<SharedMemorySegment>& segment,
+                             ResponseHeader& header, std::string& segment_name,
+                             std::string& inline_element) {
+    header.end_of_sequence = result.end_of_sequence;
+    header.skip = result.skip;
+    header.element_index = result.element_index;
+    if (result.components.empty()) {
+      return OkStatus();
+    }
+    ElementEncoder encoder(result.components);
+    TF_RETURN_IF_ERROR(encoder.Prepare());
+    const size_t segment_bytes = SegmentBytesFor(encoder.size());
+    const bool fits = segment != nullptr && segment->size() >= encoder.size();
+    if (!fits || segment->size() >= kSegmentShrinkFactor * segment_bytes) {
+      StatusOr<std::unique_ptr<SharedMemorySegment>> new_segment =
+          SharedMemorySegment::Create(NewSegmentName(), segment_bytes);
+      if (new_segment.ok()) {
+        segment = std::move(*new_segment);
+        segment_name = segment->name();
+      } else if (fits) {
+        // The element fits the current segment, which is kept rather than
+        // shrunk.
+        VLOG(1) << "Failed to shrink a shared memory segment of "
+                << segment->size() << " bytes: " << new_segment.status();
+      } else {
+        LOG_EVERY_N_SEC(WARNING, 60)
+            << "Sending a tf.data element of " << encoder.size()
+            << " bytes on the socket instead of shared memory: "
+            << new_segment.status();
+        inline_element.resize(encoder.size());
+        encoder.Encode(inline_element.data());
+        header.inline_element = 1;
+        header.element_bytes = encoder.size();
+        return OkStatus();
+      }
+    }
+    encoder.Encode(segment->data());
+    header.element_bytes = encoder.size();
+    header.segment_bytes = segment->size();
+    return OkStatus();
+  }
+
+  const GetElementT get_element_;
+  int listen_fd_ = -1;
+  int port_ = 0;
+  uint64_t token_ = 0;
+  uint64_t secret_[2] = {0, 0};
+  std::unique_ptr<SharedMemorySegment> token_segment_;
+  std::unique_ptr<Thread> accept_thread_;
+
+  mutex mu_;
+  bool cancelled_ TF_GUARDED_BY(mu_) = false;
+  absl::flat_hash_set<int> connection_fds_ TF_GUARDED_BY(mu_);
+  // The threads serving the open connections, keyed by socket.
+  absl::flat_hash_map<int, std::unique_ptr<Thread>> connection_threads_
+      TF_GUARDED_BY(mu_);
+  // The threads of the closed connections, which have not been joined yet.
+  std::vector<std::unique_ptr<Thread>> finished_connection_threads_
+      TF_GUARDED_BY(mu_);
+};
+
+// A connection to a `ShmDataTransferServer`, with the segment holding the last
+// element it received.
+struct ShmConnection {
+  explicit ShmConnection(int fd) : fd(fd) {}
+  ~ShmConnection() { close(fd); }
+
+  const int fd;
+  std::unique_ptr<SharedMemorySegment> segment;
+};
+
+class ShmDataTransferClient : public DataTransferClient {
+ public:
+  explicit ShmDataTransferClient(int port) : port_(port) {
+    VLOG(2) << "Create ShmDataTransferClient for port " << port_ << ".";
+  }
+
+  // Connects to the server, so that an unreachable server is detected when the
+  // client is built. The connections used by `GetElement` are only opened
+  // after `CheckCompatibility` has read the secret of the server.
+  Status Initialize() { return OpenSocket().status(); }
+
+  Status GetElement(const GetElementRequest& req,
+                    GetElementResult& result) override {
+    VLOG(3) << "GetElement for task " << req.task_id()
+            << " from shared memory transfer server.";
+    std::unique_ptr<ShmConnection> connection;
+    {
+      mutex_lock l(mu_);
+      if (cancelled_) {
+        return errors::Cancelled("Client was cancelled.");
+      }
+      if (!idle_connections_.empty()) {
+        connection = std::move(idle_connections_.back());
+        idle_connections_.pop_back();
+      }
+    }
+    if (connection == nullptr) {
+      TF_ASSIGN_OR_RETURN(connection, Connect());
+    }
+    {
+      mutex_lock l(mu_);
+      if (cancelled_) {
+        return errors::Cancelled("Client was cancelled.");
+      }
+      active_fds_.insert(connection->fd);
+    }
+    Status element_status;
+    Status s = Exchange(*connection, req, result, element_status);
+    mutex_lock l(mu_);
+    active_fds_.erase(connection->fd);
+    if (cancelled_) {
+      return errors::Cancelled("Client was cancelled.");
+    }
+    // Connections with transport errors are dropped.
+    TF_RETURN_IF_ERROR(s);
+    idle_connections_.push_back(std::move(connection));
+    return element_status;
+  }
+
+  void TryCancel() override {
+    VLOG(2) << "Cancel ShmDataTransferClient.";
+    mutex_lock l(mu_);
+    cancelled_ = true;
+    for (int fd : active_fds_) {
+      shutdown(fd, SHUT_RDWR);
+    }
+    idle_connections_.clear();
+  }
+
+  Status CheckCompatibility(
+      const std::string& compatibility_info) const override {
+    std::vector<std::string> parts = absl::StrSplit(compatibility_info, ',');
+    uint64_t token = 0;
+    if (parts.size() != 2 || !absl::SimpleAtoi(parts[1], &token)) {
+      return errors::InvalidArgument(
+          "Invalid shared memory transfer compatibility info: ",
+          compatibility_info);
+    }
+    StatusOr<std::unique_ptr<SharedMemorySegment>> segment =
+        SharedMemorySegment::Open(parts[0], sizeof(TokenSegmentContents));
+    TokenSegmentContents contents;
+    std::memset(&contents, 0, sizeof(contents));
+    if (segment.ok()) {
+      std::memcpy(&contents, (*segment)->data(), sizeof(contents));
+    }
+    if (!segment.ok() || contents.token != token) {
+      return errors::FailedPrecondition(
+          "The tf.data service worker does not share memory with this client: ",
+          segment.ok() ? "token mismatch" : segment.status().message());
+    }
+    mutex_lock l(mu_);
+    std::memcpy(secret_, contents.secret, sizeof(secret_));
+    has_secret_ = true;
+    return OkStatus();
+  }
+
+ private:
+  // Opens a connection to the server, and presents the secret of the server.
+  StatusOr<std::unique_ptr<ShmConnection>> Connect() const {
+    uint64_t secret[2];
+    {
+      mutex_lock l(mu_);
+      if (!has_secret_) {
+        return errors::FailedPrecondition(
+            "The compatibility of the shared memory transfer server has not "
+            "been checked.");
+      }
+      std::memcpy(secret, secret_, sizeof(secret));
+    }
+    TF_ASSIGN_OR_RETURN(std::unique_ptr<ShmConnection> connection,
+                        OpenSocket());
+    TF_RETURN_IF_ERROR(WriteFully(connection->fd, secret, sizeof(secret)));
+    return connection;
+  }
+
+  StatusOr<std::unique_ptr<ShmConnection>> OpenSocket() const {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+      return errors::IOError("Failed to create socket", errno);
+    }
+    auto connection = std::make_unique<ShmConnection>(fd);
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port_);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+      return errors::Unavailable(
+          "Failed to connect to shared memory transfer server at port ", port_,
+          ": ", strerror(errno));
+    }
+    SetNoDelay(fd);
+    return connection;
+  }
+
+  // Sends `req` on `connection` and decodes the response into `result`. The
+  // returned status reports transport errors, and `element_status` the status
+  // of the request on the server.
+  static Status Exchange(ShmConnection& connection,
+                         const GetElementRequest& req, GetElementResult& result,
+                         Status& element_status) {
+    std::string serialized_request;
+    if (!req.SerializeToString(&serialized_request)) {
+      return errors::Internal("Failed to serialize request.");
+    }
+    const uint64_t request_bytes = serialized_request.size();
+    TF_RETURN_IF_ERROR(
+        WriteFully(connection.fd, &request_bytes, sizeof(request_bytes)));
+    TF_RETURN_IF_ERROR(WriteFully(connection.fd, serialized_request.data(),
+                                  serialized_request.size()));
+
+    ResponseHeader header;
+    std::string message;
+    std::string segment_name;
+    TF_RETURN_IF_ERROR(ReadFully(connection.fd, &header, sizeof(header)));
+    TF_RETURN_IF_ERROR(
+        ReadString(connection.fd, header.message_bytes, message));
+    TF_RETURN_IF_ERROR(
+        ReadString(connection.fd, header.segment_name_bytes, segment_name));
+    std::string inline_element;
+    if (header.inline_element) {
+      inline_element.resize(header.element_bytes);
+      TF_RETURN_IF_ERROR(ReadFully(connection.fd, inline_element.data(),
+                                   inline_element.size()));
+    }
+    if (!segment_name.empty()) {
+      connection.segment = nullptr;
+      TF_ASSIGN_OR_RETURN(connection.segment,
+                          SharedMemorySegment::Open(segment_name,
+                                                    header.segment_bytes));
+    }
+    element_status =
+        Status(static_cast<absl::StatusCode>(header.code), message);
+    if (!element_status.ok()) {
+      return OkStatus();
+    }
+    result.end_of_sequence = header.end_of_sequence;
+    result.skip = header.skip;
+    result.element_index = header.element_index;
+    if (header.element_bytes == 0) {
+      return OkStatus();
+    }
+    if (header.inline_element) {
+      return DecodeElement(inline_element.data(), inline_element.size(),
+                           result.components);
+    }
+    if (connection.segment == nullptr ||
+        header.element_bytes > connection.segment->size()) {
+      return errors::DataLoss("Element of ", header.element_bytes,
+                              " bytes does not fit the shared memory segment.");
+    }
+    return DecodeElement(connection.segment->data(), header.element_bytes,
+                         result.components);
+  }
+
+  const int port_;
+
+  mutable mutex mu_;
+  bool cancelled_ TF_GUARDED_BY(mu_) = false;
+  // The secret of the server, read by `CheckCompatibility`.
+  mutable bool has_secret_ TF_GUARDED_BY(mu_) = false;
+  mutable uint64_t secret_[2] TF_GUARDED_BY(mu_) = {0, 0};
+  // Connections which are not used by a `GetElement` call.
+  std::vector<std::unique_ptr<ShmConnection>> idle_connections_
+      TF_GUARDED_BY(mu_);
+  // Sockets of the connections used by `GetElement` calls, shut down by
+  // `TryCancel`.
+  absl::flat_hash_set<int> active_fds_ TF_GUARDED_BY(mu_);
+};
+
+#endif  // __linux__
+
+class ShmTransferServerRegistrar {
+ public:
+  ShmTransferServerRegistrar() {
+    DataTransferServer::Register(
+        kShmTransferProtocol,
+        [](DataTransferServer::GetElementT get_element,
+           std::shared_ptr<DataTransferServer>* out) -> Status {
+#if defined(__linux__)
+          *out =
+              std::make_shared<ShmDataTransferServer>(std::move(get_element));
+          return OkStatus();
+#else
+          return errors::Unimplemented(
+              "Shared memory data transfer is only supported on Linux.");
+#endif  // __linux__
+        });
+  }
+};
+static ShmTransferServerRegistrar shm_server_registrar;
+
+class ShmTransferClientRegistrar {
+ public:
+  ShmTransferClientRegistrar() {
+    DataTransferClient::Register(
+        kShmTransferProtocol,
+        [](DataTransferClient::Config config,
+           std::unique_ptr<DataTransferClient>* out) -> Status {
+#if defined(__linux__)
+          // The server listens on the loopback interface, so only the port of
+          // the address is used.
+          absl::string_view address = config.address;
+          int port = 0;
+          size_t colon = address.rfind(':');
+          if (colon == absl::string_view::npos ||
+              !absl::SimpleAtoi(address.substr(colon + 1), &port)) {
+            return errors::InvalidArgument(
+                "Invalid shared memory transfer server address: ", address);
+          }
+          auto client = std::make_unique<ShmDataTransferClient>(port);
+          TF_RETURN_IF_ERROR(client->Initialize());
+          *out = std::move(client);
+          return OkStatus();
+#else
+          return errors::Unimplemented(
+              "Shared memory data transfer is only supported on Linux.");
+#endif  // __linux__
+        });
+  }
+};
+static ShmTransferClientRegistrar shm_client_registrar;
+
+}  // namespace
+}  // namespace data
+}  // namespace tensorflow
@@ -0,0 +1,38 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_DATA_SERVICE_SHM_DATA_TRANSFER_H_
+#define TENSORFLOW_CORE_DATA_SERVICE_SHM_DATA_TRANSFER_H_
+
+namespace tensorflow {
+namespace data {
+
+// Data transfer protocol for clients running on the same host as the tf.data
+// service worker. Requests and responses are exchanged over a loopback socket,
+// while the element tensors are copied into a POSIX shared memory segment owned
+// by each connection, without being serialized to protos.
+//
+// The server registers a shared memory token in its compatibility info. A
+// client which cannot read the token, e.g. because it runs on another host or
+// in another IPC namespace, fails the compatibility check and falls back to
+// gRPC. The segment also holds a secret, which clients present when they
+// connect: the server closes connections from processes which cannot read the
+// segment.
+constexpr const char kShmTransferProtocol[] = "shm";
+
+}  // namespace data
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_DATA_SERVICE_SHM_DATA_TRANSFER_H_
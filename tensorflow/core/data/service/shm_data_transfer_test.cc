@@ -0,0 +1,373 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/data/service/shm_data_transfer.h"
+
+#if defined(__linux__)
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif  // __linux__
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "tensorflow/core/data/service/data_transfer.h"
+#include "tensorflow/core/data/service/worker.pb.h"
+#include "tensorflow/core/framework/dataset.pb.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/framework/variant.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/status.h"
+#include "tensorflow/core/platform/status_matchers.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/threadpool.h"
+
+namespace tensorflow {
+namespace data {
+namespace {
+
+using ::tensorflow::testing::StatusIs;
+
+class ShmDataTransferTest : public ::testing::Test {
+ protected:
+  // Starts a server which answers requests with `get_element`.
+  void StartServer(DataTransferServer::GetElementT get_element) {
+    TF_ASSERT_OK(DataTransferServer::Build(kShmTransferProtocol,
+                                           std::move(get_element), &server_));
+    TF_ASSERT_OK(server_->Start());
+  }
+
+  StatusOr<std::unique_ptr<DataTransferClient>> CreateClient() {
+    std::unique_ptr<DataTransferClient> client;
+    TF_RETURN_IF_ERROR(DataTransferClient::Build(
+        kShmTransferProtocol,
+        {/*protocol=*/"grpc", absl::StrCat("localhost:", server_->get_port())},
+        &client));
+    TF_ASSIGN_OR_RETURN(std::string compatibility_info,
+                        server_->GetCompatibilityInfo());
+    TF_RETURN_IF_ERROR(client->CheckCompatibility(compatibility_info));
+    return client;
+  }
+
+  std::shared_ptr<DataTransferServer> server_;
+};
+
+// Returns a server callback which answers every request with `components`.
+DataTransferServer::GetElementT ReturnComponents(
+    std::vector<Tensor> components) {
+  return [components](const GetElementRequest* request,
+                      GetElementResult* result) {
+    result->components = components;
+    result->element_index = request->task_id();
+    return OkStatus();
+  };
+}
+
+TEST_F(ShmDataTransferTest, TransferTensors) {
+  Tensor strings(DT_STRING, TensorShape({3}));
+  strings.flat<tstring>()(0) = "";
+  strings.flat<tstring>()(1) = "hello";
+  strings.flat<tstring>()(2) = std::string(1000, 'x');
+  std::vector<Tensor> components = {
+      test::AsTensor<float>({1.0, 2.5, -3.0}, TensorShape({3, 1})),
+      test::AsScalar<int64_t>(42), Tensor(DT_INT32, TensorShape({0, 5})),
+      strings, test::AsTensor<bool>({true, false})};
+  StartServer(ReturnComponents(components));
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<DataTransferClient> client,
+                          CreateClient());
+
+  for (int64_t i = 0; i < 3; ++i) {
+    GetElementRequest request;
+    request.set_task_id(i);
+    GetElementResult result;
+    TF_ASSERT_OK(client->GetElement(request, result));
+    EXPECT_EQ(result.element_index, i);
+    EXPECT_FALSE(result.end_of_sequence);
+    EXPECT_FALSE(result.skip);
+    ASSERT_EQ(result.components.size(), components.size());
+    for (int j = 0; j < components.size(); ++j) {
+      test::ExpectEqual(result.components[j], components[j]);
+    }
+  }
+}
+
+TEST_F(ShmDataTransferTest, TransferCompressedElement) {
+  CompressedElement compressed;
+  compressed.set_data(std::string(100, 'a'));
+  compressed.set_version(2);
+  Tensor tensor(DT_VARIANT, TensorShape({}));
+  tensor.scalar<Variant>()() = compressed;
+  StartServer(ReturnComponents({tensor}));
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<DataTransferClient> client,
+                          CreateClient());
+
+  GetElementResult result;
+  TF_ASSERT_OK(client->GetElement(GetElementRequest(), result));
+  ASSERT_EQ(result.components.size(), 1);
+  const CompressedElement* received =
+      result.components[0].scalar<Variant>()().get<CompressedElement>();
+  ASSERT_NE(received, nullptr);
+  EXPECT_EQ(received->data(), compressed.data());
+  EXPECT_EQ(received->version(), compressed.version());
+}
+
+TEST_F(ShmDataTransferTest, ElementLargerThanSegment) {
+  const int64_t num_elements = (8 << 20) / sizeof(float) + 1;
+  Tensor large(DT_FLOAT, TensorShape({num_elements}));
+  large.flat<float>().setConstant(0.5);
+  Tensor small = test::AsScalar<int32_t>(7);
+  int64_t num_requests = 0;
+  StartServer([&](const GetElementRequest* request, GetElementResult* result) {
+    result->components = {++num_requests % 2 == 0 ? large : small};
+    return OkStatus();
+  });
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<DataTransferClient> client,
+                          CreateClient());
+
+  for (int i = 1; i <= 4; ++i) {
+    GetElementResult result;
+    TF_ASSERT_OK(client->GetElement(GetElementRequest(), result));
+    ASSERT_EQ(result.components.size(), 1);
+    test::ExpectEqual(result.components[0], i % 2 == 0 ? large : small);
+  }
+}
+
+#if defined(__linux__)
+// Returns the total size of the mappings of shared memory segments in this
+// process, including the segments that are already unlinked.
+StatusOr<uint64_t> MappedSegmentBytes() {
+  // /proc files report a size of 0, so they are read line by line.
+  std::ifstream maps("/proc/self/maps");
+  if (!maps) {
+    return errors::Unavailable("Failed to read /proc/self/maps.");
+  }
+  uint64_t total_bytes = 0;
+  std::string line;
+  while (std::getline(maps, line)) {
+    if (!absl::StrContains(line, "/tf_data_shm_")) {
+      continue;
+    }
+    uint64_t begin = 0, end = 0;
+    std::vector<absl::string_view> range =
+        absl::StrSplit(absl::string_view(line).substr(0, line.find(' ')), '-');
+    if (range.size() != 2 || !absl::SimpleHexAtoi(range[0], &begin) ||
+        !absl::SimpleHexAtoi(range[1], &end)) {
+      return errors::Internal("Unexpected mapping: ", line);
+    }
+    total_bytes += end - begin;
+  }
+  return total_bytes;
+}
+
+TEST_F(ShmDataTransferTest, ShrinksSegmentAfterLargeElement) {
+  const int64_t num_elements = (32 << 20) / sizeof(float) + 1;
+  Tensor large(DT_FLOAT, TensorShape({num_elements}));
+  large.flat<float>().setConstant(0.5);
+  Tensor small = test::AsScalar<int32_t>(7);
+  int64_t num_requests = 0;
+  StartServer([&](const GetElementRequest* request, GetElementResult* result) {
+    result->components = {++num_requests == 1 ? large : small};
+    return OkStatus();
+  });
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<DataTransferClient> client,
+                          CreateClient());
+
+  GetElementResult large_result;
+  TF_ASSERT_OK(client->GetElement(GetElementRequest(), large_result));
+  test::ExpectEqual(large_result.components[0], large);
+  TF_ASSERT_OK_AND_ASSIGN(uint64_t large_mapped_bytes, MappedSegmentBytes());
+  // The server and the client each map the 64MB segment of the element.
+  EXPECT_GE(large_mapped_bytes, 2 * (64 << 20));
+
+  for (int i = 0; i < 2; ++i) {
+    GetElementResult result;
+    TF_ASSERT_OK(client->GetElement(GetElementRequest(), result));
+    test::ExpectEqual(result.components[0], small);
+  }
+  TF_ASSERT_OK_AND_ASSIGN(uint64_t small_mapped_bytes, MappedSegmentBytes());
+  // Both sides replaced the large segment by a 4MB one.
+  EXPECT_LT(small_mapped_bytes, 2 * (8 << 20));
+}
+#endif  // __linux__
+
+TEST_F(ShmDataTransferTest, EndOfSequenceAndSkip) {
+  StartServer([](const GetElementRequest* request, GetElementResult* result) {
+    result->end_of_sequence = request->task_id() == 0;
+    result->skip = request->task_id() == 1;
+    return OkStatus();
+  });
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<DataTransferClient> client,
+                          CreateClient());
+
+  GetElementRequest request;
+  GetElementResult result;
+  request.set_task_id(0);
+  TF_ASSERT_OK(client->GetElement(request, result));
+  EXPECT_TRUE(result.end_of_sequence);
+  EXPECT_TRUE(result.components.empty());
+
+  GetElementResult skip_result;
+  request.set_task_id(1);
+  TF_ASSERT_OK(client->GetElement(request, skip_result));
+  EXPECT_TRUE(skip_result.skip);
+  EXPECT_TRUE(skip_result.components.empty());
+}
+
+TEST_F(ShmDataTransferTest, ServerError) {
+  StartServer([](const GetElementRequest* request, GetElementResult* result) {
+    return errors::NotFound("No task ", request->task_id());
+  });
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<DataTransferClient> client,
+                          CreateClient());
+
+  GetElementRequest request;
+  request.set_task_id(3);
+  GetElementResult result;
+  EXPECT_THAT(client->GetElement(request, result),
+              StatusIs(error::NOT_FOUND, "No task 3"));
+  // The connection remains usable after an error.
+  EXPECT_THAT(client->GetElement(request, result),
+              StatusIs(error::NOT_FOUND, "No task 3"));
+}
+
+TEST_F(ShmDataTransferTest, ConcurrentRequests) {
+  StartServer([](const GetElementRequest* request, GetElementResult* result) {
+    result->components = {test::AsScalar<int64_t>(request->task_id())};
+    return OkStatus();
+  });
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<DataTransferClient> client,
+                          CreateClient());
+
+  std::vector<Status> statuses(100);
+  std::vector<int64_t> values(100, -1);
+  {
+    thread::ThreadPool pool(Env::Default(), "shm_data_transfer_test", 8);
+    for (int i = 0; i < 100; ++i) {
+      pool.Schedule([&, i] {
+        GetElementRequest request;
+        request.set_task_id(i);
+        GetElementResult result;
+        statuses[i] = client->GetElement(request, result);
+        if (statuses[i].ok()) {
+          values[i] = result.components[0].scalar<int64_t>()();
+        }
+      });
+    }
+  }
+  for (int i = 0; i < 100; ++i) {
+    TF_EXPECT_OK(statuses[i]);
+    EXPECT_EQ(values[i], i);
+  }
+}
+
+TEST_F(ShmDataTransferTest, Cancel) {
+  StartServer(ReturnComponents({test::AsScalar<int64_t>(1)}));
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<DataTransferClient> client,
+                          CreateClient());
+
+  client->TryCancel();
+  GetElementResult result;
+  EXPECT_THAT(client->GetElement(GetElementRequest(), result),
+              StatusIs(error::CANCELLED));
+}
+
+TEST_F(ShmDataTransferTest, IncompatibleServer) {
+  StartServer(ReturnComponents({}));
+  std::unique_ptr<DataTransferClient> client;
+  TF_ASSERT_OK(DataTransferClient::Build(
+      kShmTransferProtocol,
+      {/*protocol=*/"grpc", absl::StrCat("localhost:", server_->get_port())},
+      &client));
+  EXPECT_THAT(client->CheckCompatibility("/tf_data_shm_nonexistent,1"),
+              StatusIs(error::FAILED_PRECONDITION));
+  TF_ASSERT_OK_AND_ASSIGN(std::string compatibility_info,
+                          server_->GetCompatibilityInfo());
+  const std::string segment_name =
+      compatibility_info.substr(0, compatibility_info.find(','));
+  EXPECT_THAT(client->CheckCompatibility(absl::StrCat(segment_name, ",0")),
+              StatusIs(error::FAILED_PRECONDITION));
+}
+
+TEST_F(ShmDataTransferTest, ManyClients) {
+  StartServer(ReturnComponents({test::AsScalar<int64_t>(1)}));
+  // The threads of the closed connections are joined as new ones are opened.
+  for (int i = 0; i < 50; ++i) {
+    TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<DataTransferClient> client,
+                            CreateClient());
+    GetElementResult result;
+    TF_ASSERT_OK(client->GetElement(GetElementRequest(), result));
+    ASSERT_EQ(result.components.size(), 1);
+  }
+}
+
+#if defined(__linux__)
+TEST_F(ShmDataTransferTest, RejectsConnectionWithoutSecret) {
+  int num_requests = 0;
+  StartServer([&](const GetElementRequest* request, GetElementResult* result) {
+    ++num_requests;
+    return OkStatus();
+  });
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_GE(fd, 0);
+  sockaddr_in addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(server_->get_port());
+  ASSERT_EQ(connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+  // A wrong secret, followed by an empty request.
+  const char message[sizeof(uint64_t) * 3] = {};
+  ASSERT_EQ(send(fd, message, sizeof(message), MSG_NOSIGNAL), sizeof(message));
+
+  // The server closes, or resets, the connection without answering.
+  char response;
+  EXPECT_LE(recv(fd, &response, 1, 0), 0);
+  close(fd);
+  EXPECT_EQ(num_requests, 0);
+}
+#endif  // __linux__
+
+TEST_F(ShmDataTransferTest, ServerUnavailable) {
+  StartServer(ReturnComponents({}));
+  const int port = server_->get_port();
+  server_.reset();
+  std::unique_ptr<DataTransferClient> client;
+  EXPECT_THAT(DataTransferClient::Build(kShmTransferProtocol,
+                                        {/*protocol=*/"grpc",
+                                         absl::StrCat("localhost:", port)},
+                                        &client),
+              StatusIs(error::UNAVAILABLE));
+}
+
+}  // namespace
+}  // namespace data
+}  // namespace tensorflow
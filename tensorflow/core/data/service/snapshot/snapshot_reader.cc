@@ -46,8 +46,6 @@ constexpr const char* const kStartIndex = "start_index";
 constexpr const char* const kOutputTypes = "output_types";
 constexpr const char* const kOutputShapes = "output_shapes";
 
-constexpr int64_t kTFRecordReaderOutputBufferSize = 512 << 20;  // 512MB
-
 // A reader dataset is responsible for reading one chunk file.
 // TODO(b/250921378): Merge this with `snapshot_util::Reader::Dataset`.
 class SnapshotChunkDatasetOp : public DatasetOpKernel {
@@ -123,7 +121,7 @@ class SnapshotChunkDatasetOp::Dataset : public DatasetBase {
     Status Initialize(IteratorContext* ctx) override {
       reader_ = std::make_unique<snapshot_util::TFRecordReader>(
           dataset()->chunk_file_, dataset()->compression_, dataset()->dtypes_,
-          kTFRecordReaderOutputBufferSize);
+          snapshot_util::kTFRecordReaderOutputBufferSize);
       return reader_->Initialize(ctx->env());
     }
 
@@ -45,7 +45,6 @@ namespace tensorflow {
 namespace data {
 namespace {
 
-constexpr int64_t kTFRecordReaderOutputBufferSize = 512 << 20;  // 512MB
 constexpr int64_t kUnknownNumElements = -1;
 
 // Extracts the index from `filename`. If `filename` is `prefix_<index>`, this
@@ -132,7 +131,8 @@ Status SnapshotStreamWriter::WriteChunk() {
   LOG(INFO) << "Writing distributed tf.data snapshot stream "
             << params_.stream_index << ", chunk " << chunk_index_ << ".";
   std::string chunk_file_path = GetChunkFilePath();
-  snapshot_util::TFRecordWriter writer(chunk_file_path, params_.compression);
+  snapshot_util::TFRecordWriter writer(chunk_file_path, params_.compression,
+                                       params_.writer_options);
   TF_RETURN_IF_ERROR(writer.Initialize(params_.env));
   while (ShouldWriteRecord()) {
     TF_RETURN_IF_ERROR(WriteRecord(writer));
@@ -314,9 +314,9 @@ Status SnapshotStreamWriter::Restore() {
                                     kUnknownNumElements);
   }
   TF_RETURN_IF_ERROR(checkpoint_name.status());
-  snapshot_util::TFRecordReaderImpl reader(CheckpointPath(*checkpoint_name),
-                                           params_.compression,
-                                           kTFRecordReaderOutputBufferSize);
+  snapshot_util::TFRecordReaderImpl reader(
+      CheckpointPath(*checkpoint_name), params_.compression,
+      snapshot_util::kTFRecordReaderOutputBufferSize);
   TF_RETURN_IF_ERROR(reader.Initialize(params_.env));
   TF_ASSIGN_OR_RETURN(std::vector<Tensor> serialized_tensors,
                       reader.GetTensors());
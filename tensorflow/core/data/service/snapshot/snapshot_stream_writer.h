@@ -62,6 +62,11 @@ struct SnapshotWriterParams {
   // snapshot. Used only for unit testing.
   bool test_only_keep_temp_files = false;
 
+  // How chunk files are compressed and written: the thread pool compressing in
+  // parallel with the stream writer, which is shared by the chunk files of all
+  // streams, the compression block size, and whether to use direct I/O.
+  snapshot_util::TFRecordWriterOptions writer_options;
+
   std::string StreamDirectory() const {
     return tensorflow::data::StreamDirectory(snapshot_path, stream_index);
   }
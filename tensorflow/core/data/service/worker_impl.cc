@@ -158,6 +158,11 @@ LocalWorkers::AddressToWorkerMap* LocalWorkers::local_workers_ =
 DataServiceWorkerImpl::DataServiceWorkerImpl(const WorkerConfig& config)
     : config_(ApplyWorkerDefaults(config)), worker_uid_(port::JobUid()) {
   metrics::RecordTFDataServiceWorkerCreated();
+  if (config_.snapshot_compression_threads() > 0) {
+    snapshot_compression_thread_pool_ = std::make_unique<thread::ThreadPool>(
+        Env::Default(), "tf_data_snapshot_compression",
+        static_cast<int>(config_.snapshot_compression_threads()));
+  }
 }
 
 DataServiceWorkerImpl::~DataServiceWorkerImpl() {
@@ -655,15 +660,20 @@ Status DataServiceWorkerImpl::UpdateSnapshotWriters(
         &dataset_def));
     TF_ASSIGN_OR_RETURN(std::unique_ptr<StandaloneTaskIterator> iterator,
                         MakeSnapshotTaskIterator(snapshot_task, dataset_def));
+    SnapshotWriterParams writer_params{
+        snapshot_task.base_path(), snapshot_task.stream_index(),
+        snapshot_task.metadata().compression(), Env::Default(),
+        config_.snapshot_max_chunk_size_bytes()};
+    writer_params.writer_options.compression_thread_pool =
+        snapshot_compression_thread_pool_.get();
+    writer_params.writer_options.compression_block_size_bytes =
+        config_.snapshot_compression_block_size_bytes();
+    writer_params.writer_options.direct_io = config_.snapshot_direct_io();
     mutex_lock l(mu_);
     snapshot_writers_.emplace(
         snapshot_task_key,
-        std::make_unique<SnapshotStreamWriter>(
-            SnapshotWriterParams{
-                snapshot_task.base_path(), snapshot_task.stream_index(),
-                snapshot_task.metadata().compression(), Env::Default(),
-                config_.snapshot_max_chunk_size_bytes()},
-            std::move(iterator)));
+        std::make_unique<SnapshotStreamWriter>(writer_params,
+                                               std::move(iterator)));
   }
 
   // Cancel writers for snapshots that are no longer assigned by the dispatcher.
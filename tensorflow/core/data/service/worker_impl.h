@@ -41,6 +41,7 @@ limitations under the License.
 #include "tensorflow/core/platform/status.h"
 #include "tensorflow/core/platform/statusor.h"
 #include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/threadpool.h"
 #include "tensorflow/core/protobuf/service_config.pb.h"
 #include "tensorflow/core/public/session.h"
 
@@ -196,6 +197,11 @@ class DataServiceWorkerImpl {
   condition_variable heartbeat_cv_ TF_GUARDED_BY(mu_);
   CancellationManager cancellation_manager_;
 
+  // If not null, compresses the chunks of all snapshot streams in parallel
+  // with their writers. Declared before `snapshot_writers_` so that it outlives
+  // them.
+  std::unique_ptr<thread::ThreadPool> snapshot_compression_thread_pool_;
+
   absl::flat_hash_map<SnapshotTask, std::unique_ptr<SnapshotStreamWriter>,
                       absl::Hash<SnapshotTask>>
       snapshot_writers_ TF_GUARDED_BY(mu_);
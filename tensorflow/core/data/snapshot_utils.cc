@@ -18,6 +18,7 @@ limitations under the License.
 #include <algorithm>
 #include <climits>
 #include <functional>
+#include <limits>
 #include <memory>
 #include <optional>
 #include <string>
@@ -136,15 +137,57 @@ Status Writer::Create(Env* env, const std::string& filename,
 }
 
 TFRecordWriter::TFRecordWriter(const std::string& filename,
-                               const std::string& compression_type)
-    : filename_(filename), compression_type_(compression_type) {}
+                               const std::string& compression_type,
+                               const TFRecordWriterOptions& options)
+    : filename_(filename),
+      compression_type_(compression_type),
+      options_(options) {}
 
 Status TFRecordWriter::Initialize(tensorflow::Env* env) {
-  TF_RETURN_IF_ERROR(env->NewAppendableFile(filename_, &dest_));
+  // The block size is stored in the int32 buffer sizes of the compression
+  // streams, and a block must fit into the output buffer of the reader.
+  if (options_.compression_block_size_bytes < 0 ||
+      options_.compression_block_size_bytes >
+          std::numeric_limits<int32_t>::max() ||
+      options_.compression_block_size_bytes >
+          kTFRecordReaderOutputBufferSize) {
+    return errors::InvalidArgument(
+        "Snapshot compression block size must be in [1, ",
+        std::min<int64_t>(std::numeric_limits<int32_t>::max(),
+                          kTFRecordReaderOutputBufferSize),
+        "] bytes, or 0 to use the default; got ",
+        options_.compression_block_size_bytes, ".");
+  }
+  if (options_.direct_io) {
+    Status s = env->NewDirectIOWritableFile(filename_, &dest_);
+    if (!s.ok()) {
+      VLOG(1) << "Writing " << filename_
+              << " without direct I/O: " << s.ToString();
+      dest_ = nullptr;
+    }
+  }
+  if (dest_ == nullptr) {
+    TF_RETURN_IF_ERROR(env->NewAppendableFile(filename_, &dest_));
+  }
 
-  record_writer_ = std::make_unique<io::RecordWriter>(
-      dest_.get(), io::RecordWriterOptions::CreateRecordWriterOptions(
-                       /*compression_type=*/compression_type_));
+  io::RecordWriterOptions options =
+      io::RecordWriterOptions::CreateRecordWriterOptions(
+          /*compression_type=*/compression_type_);
+#if !defined(IS_SLIM_BUILD)
+  if (options_.compression_block_size_bytes > 0) {
+    options.zlib_options.input_buffer_size =
+        options_.compression_block_size_bytes;
+    options.zlib_options.output_buffer_size =
+        options_.compression_block_size_bytes;
+    options.snappy_options.input_buffer_size =
+        options_.compression_block_size_bytes;
+    options.snappy_options.output_buffer_size =
+        options_.compression_block_size_bytes;
+  }
+  options.snappy_options.compression_thread_pool =
+      options_.compression_thread_pool;
+#endif  // IS_SLIM_BUILD
+  record_writer_ = std::make_unique<io::RecordWriter>(dest_.get(), options);
   return OkStatus();
 }
 
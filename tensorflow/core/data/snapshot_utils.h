@@ -34,6 +34,7 @@ limitations under the License.
 #include "tensorflow/core/platform/file_system.h"
 #include "tensorflow/core/platform/path.h"
 #include "tensorflow/core/platform/status.h"
+#include "tensorflow/core/platform/threadpool.h"
 #include "tensorflow/core/protobuf/snapshot.pb.h"
 
 namespace tensorflow {
@@ -59,6 +60,10 @@ constexpr char kModeRead[] = "read";
 constexpr char kModePassthrough[] = "passthrough";
 constexpr char kShardDirectorySuffix[] = ".shard";
 
+// The output buffer size of the readers of distributed snapshot files. The
+// compression blocks of `TFRecordWriter` must fit into it.
+constexpr int64_t kTFRecordReaderOutputBufferSize = 512 << 20;  // 512MB
+
 enum Mode { READER = 0, WRITER = 1, PASSTHROUGH = 2 };
 
 // Returns the name of the "hash" directory for the given base path and hash ID.
@@ -102,11 +107,30 @@ class Writer {
   virtual Status Initialize(tensorflow::Env* env) = 0;
 };
 
+// Options for writing snapshot files with `TFRecordWriter`.
+struct TFRecordWriterOptions {
+  // If not null, the pool on which blocks are compressed in parallel with the
+  // writer. Only applies to SNAPPY compression. If null, blocks are compressed
+  // by the writing thread. Not owned; may be shared by several writers, and
+  // must outlive them.
+  thread::ThreadPool* compression_thread_pool = nullptr;
+
+  // The number of uncompressed bytes compressed at a time. If 0, uses the
+  // default of the compression type. Otherwise must be positive and at most
+  // `kTFRecordReaderOutputBufferSize`.
+  int64_t compression_block_size_bytes = 0;
+
+  // If true, writes the file with direct I/O, bypassing the page cache. Falls
+  // back to buffered writes if the file system does not support direct I/O.
+  bool direct_io = false;
+};
+
 // Writes snapshots with the standard TFRecord file format.
 class TFRecordWriter : public Writer {
  public:
   TFRecordWriter(const std::string& filename,
-                 const std::string& compression_type);
+                 const std::string& compression_type,
+                 const TFRecordWriterOptions& options = {});
 
   Status Initialize(tensorflow::Env* env) override;
 
@@ -121,6 +145,7 @@ class TFRecordWriter : public Writer {
  private:
   const std::string filename_;
   const std::string compression_type_;
+  const TFRecordWriterOptions options_;
 
   std::unique_ptr<WritableFile> dest_;
   std::unique_ptr<io::RecordWriter> record_writer_;
@@ -265,6 +290,13 @@ class TFRecordReaderImpl {
   // Reads all Tensors in the input file.
   StatusOr<std::vector<Tensor>> GetTensors();
 
+  // Returns the offset of the next record in the input file.
+  uint64_t offset() const { return offset_; }
+
+  // Makes the next `GetNext()` read the record at `offset`, which must have
+  // been returned by `offset()`. Only supported for uncompressed files.
+  void Seek(uint64_t offset) { offset_ = offset; }
+
  private:
   // Parses `record` into a Tensor.
   StatusOr<Tensor> Parse(const tstring& record);
@@ -295,6 +327,13 @@ class TFRecordReader : public Reader {
   // end of file, or an error status if there is an error.
   Status ReadTensors(std::vector<Tensor>* read_tensors) override;
 
+  // Returns the offset of the next element in the input file.
+  uint64_t offset() const { return reader_impl_.offset(); }
+
+  // Makes the next `ReadTensors()` read the element at `offset`, which must
+  // have been returned by `offset()`. Only supported for uncompressed files.
+  void Seek(uint64_t offset) { reader_impl_.Seek(offset); }
+
  private:
   TFRecordReaderImpl reader_impl_;
   const DataTypeVector dtypes_;
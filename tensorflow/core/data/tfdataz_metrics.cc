@@ -22,7 +22,9 @@ limitations under the License.
 #include <utility>
 #include <vector>
 
+#include "absl/strings/str_cat.h"
 #include "absl/time/time.h"
+#include "tensorflow/core/framework/metrics.h"
 #include "tensorflow/core/platform/env.h"
 
 namespace tensorflow {
@@ -91,6 +93,76 @@ absl::Duration ApproximateLatencyEstimator::GetAverageLatency(Duration duration)
   return absl::Duration(absl::Microseconds(interval_latency)) / interval_count;
 }
 
+ApproximateThroughputEstimator::ApproximateThroughputEstimator(const Env& env)
+    : env_(env),
+      start_time_micros_(env.NowMicros()),
+      last_updated_time_mins_(
+          absl::ToInt64Minutes(absl::Microseconds(start_time_micros_))) {}
+
+void ApproximateThroughputEstimator::AddElement(int64_t bytes)
+    TF_LOCKS_EXCLUDED(mu_) {
+  UpdateRingBuffer();
+
+  mutex_lock l(mu_);
+  elements_counter_ += 1;
+  bytes_counter_ += bytes;
+}
+
+void ApproximateThroughputEstimator::UpdateRingBuffer()
+    TF_LOCKS_EXCLUDED(mu_) {
+  int64_t now_minutes =
+      absl::ToInt64Minutes(absl::Microseconds(env_.NowMicros()));
+
+  mutex_lock l(mu_);
+  int64_t elapsed_minutes = now_minutes - last_updated_time_mins_;
+  int64_t minutes_to_update = std::min(elapsed_minutes, kSlots);
+  for (int i = 0; i < minutes_to_update; ++i) {
+    elements_[next_slot_] = elements_counter_;
+    bytes_[next_slot_] = bytes_counter_;
+    next_slot_ = (next_slot_ + 1) % kSlots;
+  }
+  last_updated_time_mins_ = now_minutes;
+}
+
+double ApproximateThroughputEstimator::GetRate(Duration duration,
+                                               int64_t counter,
+                                               const int64_t* ring_buffer)
+    TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+  const int minutes = static_cast<int>(duration);
+  const double elapsed_seconds = absl::ToDoubleSeconds(
+      absl::Microseconds(env_.NowMicros() - start_time_micros_));
+  const double seconds =
+      std::max(std::min(minutes * 60.0, elapsed_seconds), 1.0);
+  const int slot = (next_slot_ - minutes + kSlots) % kSlots;
+  return static_cast<double>(counter - ring_buffer[slot]) / seconds;
+}
+
+double ApproximateThroughputEstimator::GetElementsPerSecond(Duration duration)
+    TF_LOCKS_EXCLUDED(mu_) {
+  UpdateRingBuffer();
+
+  mutex_lock l(mu_);
+  return GetRate(duration, elements_counter_, elements_);
+}
+
+double ApproximateThroughputEstimator::GetBytesPerSecond(Duration duration)
+    TF_LOCKS_EXCLUDED(mu_) {
+  UpdateRingBuffer();
+
+  mutex_lock l(mu_);
+  return GetRate(duration, bytes_counter_, bytes_);
+}
+
+std::string ApproximateThroughputEstimator::DebugString() {
+  return absl::StrCat(
+      "elements/s: ", GetElementsPerSecond(Duration::kMinute), " (1 min), ",
+      GetElementsPerSecond(Duration::kFiveMinutes), " (5 min), ",
+      GetElementsPerSecond(Duration::kSixtyMinutes), " (60 min); bytes/s: ",
+      GetBytesPerSecond(Duration::kMinute), " (1 min), ",
+      GetBytesPerSecond(Duration::kFiveMinutes), " (5 min), ",
+      GetBytesPerSecond(Duration::kSixtyMinutes), " (60 min)");
+}
+
 TfDatazMetricsCollector::TfDatazMetricsCollector(const Env& env,
                                                  IteratorBase* iterator)
     : iterator_(iterator), latency_estimator_(env) {}
@@ -133,6 +205,13 @@ TfDatazMetricsCollectors& tfdataz_metric_collectors() {
   static auto& collectors = *new TfDatazMetricsCollectors();
   return collectors;
 }
+
+using NumaNodeThroughputEstimators =
+    absl::flat_hash_map<int, std::shared_ptr<ApproximateThroughputEstimator>>;
+NumaNodeThroughputEstimators& numa_node_throughput_estimators() {
+  static auto& estimators = *new NumaNodeThroughputEstimators();
+  return estimators;
+}
 }  // namespace
 
 void TfDatazMetricsRegistry::Register(
@@ -153,5 +232,34 @@ TfDatazMetricsRegistry::GetIteratorMetricCollectors() {
   return tfdataz_metric_collectors();
 }
 
+void TfDatazMetricsRegistry::RecordNumaNodeElement(int numa_node,
+                                                   int64_t bytes) {
+  std::shared_ptr<ApproximateThroughputEstimator> estimator;
+  {
+    mutex_lock l(*get_tfdataz_metrics_registry_lock());
+    auto& estimators = numa_node_throughput_estimators();
+    auto it = estimators.find(numa_node);
+    if (it == estimators.end()) {
+      it = estimators
+               .emplace(numa_node,
+                        std::make_shared<ApproximateThroughputEstimator>(
+                            *Env::Default()))
+               .first;
+      metrics::GetTFDataNumaNodeThroughputGauge(absl::StrCat(numa_node))
+          ->Set([estimator = it->second]() {
+            return estimator->DebugString();
+          });
+    }
+    estimator = it->second;
+  }
+  estimator->AddElement(bytes);
+}
+
+absl::flat_hash_map<int, std::shared_ptr<ApproximateThroughputEstimator>>
+TfDatazMetricsRegistry::GetNumaNodeThroughputEstimators() {
+  mutex_lock l(*get_tfdataz_metrics_registry_lock());
+  return numa_node_throughput_estimators();
+}
+
 }  // namespace data
 }  // namespace tensorflow
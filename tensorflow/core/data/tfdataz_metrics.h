@@ -23,6 +23,7 @@ limitations under the License.
 #include <utility>
 #include <vector>
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/time/time.h"
 #include "tensorflow/core/framework/dataset.h"
@@ -89,6 +90,60 @@ class ApproximateLatencyEstimator {
   int64_t latency_count_[kSlots] TF_GUARDED_BY(mu_);
 };
 
+// Calculates the approximate throughput, in elements and bytes per second, for
+// the past 1, 5 and 60 minutes. Like `ApproximateLatencyEstimator`, the
+// implementation uses ring buffers to maintain the cumulative element and byte
+// counts for the past 60 minutes.
+class ApproximateThroughputEstimator {
+ public:
+  using Duration = ApproximateLatencyEstimator::Duration;
+
+  explicit ApproximateThroughputEstimator(const Env& env);
+
+  // Records an element of `bytes` bytes with the current timestamp.
+  void AddElement(int64_t bytes);
+
+  // Returns the average number of elements per second for the duration (1, 5
+  // and 60 minutes) specified, or since the estimator was created if that is
+  // more recent.
+  double GetElementsPerSecond(Duration duration);
+
+  // Returns the average number of bytes per second for the duration (1, 5 and
+  // 60 minutes) specified, or since the estimator was created if that is more
+  // recent.
+  double GetBytesPerSecond(Duration duration);
+
+  // Returns the element and byte rates for the past 1, 5 and 60 minutes, for
+  // /tfdataz.
+  std::string DebugString();
+
+ private:
+  static constexpr int64_t kSlots = 60;
+
+  // Updates the ring buffers with the latest cumulative counts, like
+  // `ApproximateLatencyEstimator::UpdateRingBuffer`.
+  void UpdateRingBuffer() TF_LOCKS_EXCLUDED(mu_);
+  // Returns the average rate of the cumulative `counter`, whose values are
+  // recorded in `ring_buffer`, for `duration`.
+  double GetRate(Duration duration, int64_t counter,
+                 const int64_t* ring_buffer) TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  const Env& env_;
+  const int64_t start_time_micros_;
+
+  mutex mu_;
+  // The time when the ring buffers were last updated.
+  int64_t last_updated_time_mins_ TF_GUARDED_BY(mu_);
+  // Counters storing the cumulative element and byte counts recorded so far.
+  int64_t elements_counter_ TF_GUARDED_BY(mu_) = 0;
+  int64_t bytes_counter_ TF_GUARDED_BY(mu_) = 0;
+  // Next slot in the ring buffers.
+  int next_slot_ TF_GUARDED_BY(mu_) = 0;
+  // Ring buffers storing the cumulative counts for the last 60 minutes.
+  int64_t elements_[kSlots] TF_GUARDED_BY(mu_) = {};
+  int64_t bytes_[kSlots] TF_GUARDED_BY(mu_) = {};
+};
+
 // Collects and exports the tf.data performance metrics to /tfdataz.
 class TfDatazMetricsCollector {
  public:
@@ -136,6 +191,18 @@ class TfDatazMetricsRegistry {
   // Returns all the registered `TfDatazMetricsCollector`s.
   static absl::flat_hash_set<std::shared_ptr<TfDatazMetricsCollector>>
   GetIteratorMetricCollectors();
+
+  // Records an element of `bytes` bytes that was produced on the NUMA node
+  // `numa_node`, e.g. by a NUMA-aware `ParallelMapDataset`. The throughput of
+  // each node is exported to /tfdataz by the
+  // `/tensorflow/data/numa_node_throughput` gauge.
+  static void RecordNumaNodeElement(int numa_node, int64_t bytes);
+
+  // Returns the throughput estimators of the NUMA nodes that elements were
+  // recorded on, keyed by node.
+  static absl::flat_hash_map<int,
+                             std::shared_ptr<ApproximateThroughputEstimator>>
+  GetNumaNodeThroughputEstimators();
 };
 
 }  // namespace data
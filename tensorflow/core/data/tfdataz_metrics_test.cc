@@ -15,10 +15,12 @@ limitations under the License.
 #include "tensorflow/core/data/tfdataz_metrics.h"
 
 #include <memory>
+#include <string>
 #include <utility>
 
 #include "absl/time/time.h"
 #include "tensorflow/core/framework/dataset.h"
+#include "tensorflow/core/framework/metrics.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/util/fake_clock_env.h"
@@ -197,6 +199,80 @@ class ScopedTfDataMetricsRegistration {
   std::shared_ptr<TfDatazMetricsCollector> collector_;
 };
 
+TEST(ApproximateThroughputEstimatorTest, GetRatesForLastOneMinute) {
+  FakeClockEnv env(Env::Default());
+  ApproximateThroughputEstimator estimator(env);
+  estimator.AddElement(10);
+  estimator.AddElement(10);
+  estimator.AddElement(10);
+  env.AdvanceByMicroseconds(k2MinutesInMicros);
+  estimator.AddElement(20);
+  estimator.AddElement(20);
+  estimator.AddElement(20);
+
+  EXPECT_DOUBLE_EQ(estimator.GetElementsPerSecond(
+                       ApproximateThroughputEstimator::Duration::kMinute),
+                   3.0 / 60);
+  EXPECT_DOUBLE_EQ(estimator.GetBytesPerSecond(
+                       ApproximateThroughputEstimator::Duration::kMinute),
+                   60.0 / 60);
+}
+
+TEST(ApproximateThroughputEstimatorTest, GetRatesSinceCreation) {
+  FakeClockEnv env(Env::Default());
+  ApproximateThroughputEstimator estimator(env);
+  estimator.AddElement(100);
+  env.AdvanceByMicroseconds(k2MinutesInMicros);
+  estimator.AddElement(100);
+
+  // Only two minutes have elapsed since the estimator was created.
+  EXPECT_DOUBLE_EQ(estimator.GetElementsPerSecond(
+                       ApproximateThroughputEstimator::Duration::kFiveMinutes),
+                   2.0 / 120);
+  EXPECT_DOUBLE_EQ(estimator.GetBytesPerSecond(
+                       ApproximateThroughputEstimator::Duration::kFiveMinutes),
+                   200.0 / 120);
+}
+
+TEST(ApproximateThroughputEstimatorTest, GetRatesForLastSixtyMinutes) {
+  FakeClockEnv env(Env::Default());
+  ApproximateThroughputEstimator estimator(env);
+  estimator.AddElement(1);
+  env.AdvanceByMicroseconds(k59MinutesInMicros);
+  estimator.AddElement(1);
+  env.AdvanceByMicroseconds(k2MinutesInMicros);
+  estimator.AddElement(1);
+
+  // The first element was recorded more than 60 minutes ago.
+  EXPECT_DOUBLE_EQ(estimator.GetElementsPerSecond(
+                       ApproximateThroughputEstimator::Duration::kSixtyMinutes),
+                   2.0 / 3600);
+}
+
+TEST(TfDatazMetricsRegistryTest, RecordNumaNodeElement) {
+  TfDatazMetricsRegistry::RecordNumaNodeElement(/*numa_node=*/1,
+                                                /*bytes=*/16);
+  TfDatazMetricsRegistry::RecordNumaNodeElement(/*numa_node=*/1,
+                                                /*bytes=*/16);
+
+  auto estimators = TfDatazMetricsRegistry::GetNumaNodeThroughputEstimators();
+  ASSERT_TRUE(estimators.contains(1));
+  EXPECT_FALSE(estimators.contains(0));
+  EXPECT_GT(estimators[1]->GetBytesPerSecond(
+                ApproximateThroughputEstimator::Duration::kMinute),
+            0);
+}
+
+TEST(TfDatazMetricsRegistryTest, ExportsNumaNodeThroughput) {
+  TfDatazMetricsRegistry::RecordNumaNodeElement(/*numa_node=*/2,
+                                                /*bytes=*/16);
+
+  const std::string throughput =
+      metrics::GetTFDataNumaNodeThroughputGauge("2")->value()();
+  EXPECT_THAT(throughput, ::testing::HasSubstr("elements/s"));
+  EXPECT_THAT(throughput, ::testing::HasSubstr("bytes/s"));
+}
+
 TEST(TfDatazMetricsRegistryTest, Register) {
   std::unique_ptr<IteratorBase> iterator;
   auto collector_one = std::make_shared<TfDatazMetricsCollector>(
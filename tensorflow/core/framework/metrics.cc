@@ -50,6 +50,42 @@ auto* graph_pending_queue_length_histogram = tsl::monitoring::Sampler<0>::New(
     // Power of 1.5 with bucket count 30 (> 191k)
     {tsl::monitoring::Buckets::Exponential(1, 1.5, 30)});
 
+auto* executor_dispatch_decisions = tsl::monitoring::Counter<1>::New(
+    "/tensorflow/core/executor_dispatch_decisions",
+    "The number of nodes run by the executor under a dispatch policy, by how "
+    "they were run.",
+    "decision");
+
+auto* executor_closures_saved_histogram = tsl::monitoring::Sampler<0>::New(
+    {"/tensorflow/core/executor_closures_saved_per_step",
+     "The number of closures that a dispatch policy saved in one executor "
+     "step, compared to dispatching every ready node in its own closure."},
+    // Power of 2 with bucket count 20 (> 1M)
+    {tsl::monitoring::Buckets::Exponential(1, 2, 20)});
+
+auto* static_memory_plan_allocations = tsl::monitoring::Counter<1>::New(
+    "/tensorflow/core/static_memory_plan_allocations",
+    "The number of allocations made by executor steps that use a static "
+    "memory plan, by whether the plan could serve them.",
+    "result");
+
+auto* run_handler_queueing_delay_usecs = tsl::monitoring::Sampler<1>::New(
+    {"/tensorflow/core/run_handler_queueing_delay_usecs",
+     "The time that a sample of the inter-op closures scheduled through a "
+     "RunHandlerPool spend queued before they run, in microseconds, by run "
+     "priority.",
+     "priority"},
+    // Power of 2 with bucket count 24 (> 8 seconds)
+    {tsl::monitoring::Buckets::Exponential(1, 2, 24)});
+
+auto* run_handler_wait_usecs = tsl::monitoring::Sampler<1>::New(
+    {"/tensorflow/core/run_handler_wait_usecs",
+     "The time that runs wait for a free handler of a RunHandlerPool, in "
+     "microseconds, by run priority.",
+     "priority"},
+    // Power of 2 with bucket count 24 (> 8 seconds)
+    {tsl::monitoring::Buckets::Exponential(1, 2, 24)});
+
 auto* graph_run_input_tensor_bytes = tsl::monitoring::Sampler<0>::New(
     {"/tensorflow/core/graph_run_input_tensor_bytes",
      "The size of input tensors in bytes."},
@@ -91,6 +127,29 @@ auto* tf_data_bytes_fetched_counter = tsl::monitoring::Counter<0>::New(
     "/tensorflow/data/bytes_fetched",
     "The number of bytes fetched from tf.data Dataset iterator.");
 
+auto* tf_data_shuffle_spill_bytes_counter = tsl::monitoring::Counter<1>::New(
+    "/tensorflow/data/shuffle_spill_bytes",
+    "The number of bytes that tf.data shuffle buffers spilled to disk or read "
+    "back from disk.",
+    "operation");
+
+auto* tf_data_shared_cache_queries_counter = tsl::monitoring::Counter<1>::New(
+    "/tensorflow/data/shared_cache_queries",
+    "tf.data process-wide shared cache queries counter. The result can be hit "
+    "or miss.",
+    "cache_hit");
+
+auto* tf_data_shared_cache_size_bytes =
+    tsl::monitoring::Gauge<int64_t, 0>::New(
+        "/tensorflow/data/shared_cache_size_bytes",
+        "tf.data process-wide shared cache memory usage in bytes.");
+
+auto* tf_data_shared_cache_evicted_bytes_counter =
+    tsl::monitoring::Counter<0>::New(
+        "/tensorflow/data/shared_cache_evicted_bytes",
+        "The number of bytes evicted from the tf.data process-wide shared "
+        "cache.");
+
 auto* tf_data_elements_counter = tsl::monitoring::Counter<1>::New(
     "/tensorflow/data/elements", "tf.data elements", "name");
 
@@ -208,6 +267,12 @@ auto* tf_data_model_gauge =
     tsl::monitoring::Gauge<std::function<std::string()>, 1>::New(
         "/tensorflow/data/model", "tf.data autotuning model proto.", "id");
 
+auto* tf_data_numa_node_throughput_gauge =
+    tsl::monitoring::Gauge<std::function<std::string()>, 1>::New(
+        "/tensorflow/data/numa_node_throughput",
+        "tf.data throughput of the elements produced on each NUMA node.",
+        "numa_node");
+
 auto* tf_data_auto_shard = tsl::monitoring::Gauge<int64, 2>::New(
     "/tensorflow/data/autoshard", "tf.data autoshard statistics.", "id",
     "name");
@@ -392,10 +457,40 @@ tsl::monitoring::GaugeCell<std::function<std::string()>>* GetTFDataModelGauge(
   return tf_data_model_gauge->GetCell(id);
 }
 
+tsl::monitoring::GaugeCell<std::function<std::string()>>*
+GetTFDataNumaNodeThroughputGauge(const string& numa_node) {
+  return tf_data_numa_node_throughput_gauge->GetCell(numa_node);
+}
+
 void RecordTFDataBytesFetched(int64_t num_bytes) {
   tf_data_bytes_fetched_counter->GetCell()->IncrementBy(num_bytes);
 }
 
+void RecordTFDataShuffleSpillBytesWritten(int64_t num_bytes) {
+  static auto* tf_data_shuffle_spill_bytes_written_cell =
+      tf_data_shuffle_spill_bytes_counter->GetCell("write");
+  tf_data_shuffle_spill_bytes_written_cell->IncrementBy(num_bytes);
+}
+
+void RecordTFDataShuffleSpillBytesRead(int64_t num_bytes) {
+  static auto* tf_data_shuffle_spill_bytes_read_cell =
+      tf_data_shuffle_spill_bytes_counter->GetCell("read");
+  tf_data_shuffle_spill_bytes_read_cell->IncrementBy(num_bytes);
+}
+
+void RecordTFDataSharedCacheQuery(bool cache_hit) {
+  std::string cache_hit_str = cache_hit ? "true" : "false";
+  tf_data_shared_cache_queries_counter->GetCell(cache_hit_str)->IncrementBy(1);
+}
+
+void RecordTFDataSharedCacheSizeBytes(size_t bytes) {
+  tf_data_shared_cache_size_bytes->GetCell()->Set(static_cast<int64_t>(bytes));
+}
+
+void RecordTFDataSharedCacheEvictedBytes(int64_t num_bytes) {
+  tf_data_shared_cache_evicted_bytes_counter->GetCell()->IncrementBy(num_bytes);
+}
+
 void RecordTFDataExperiment(const string& name) {
   tf_data_experiment_counter->GetCell(name)->IncrementBy(1);
 }
@@ -595,6 +690,40 @@ void UpdateGraphPendingQueueLength(uint64 len) {
   graph_pending_queue_length_cell->Add(len);
 }
 
+tsl::monitoring::SamplerCell* GetRunHandlerQueueingDelayCell(
+    int64_t priority) {
+  return run_handler_queueing_delay_usecs->GetCell(absl::StrCat(priority));
+}
+
+void RecordRunHandlerWaitTime(int64_t priority, uint64 wait_time_usecs) {
+  run_handler_wait_usecs->GetCell(absl::StrCat(priority))
+      ->Add(wait_time_usecs);
+}
+
+void RecordExecutorDispatchDecisions(int64_t num_inlined, int64_t num_batched,
+                                     int64_t num_batch_closures,
+                                     int64_t num_dispatched) {
+  static auto* inline_cell = executor_dispatch_decisions->GetCell("inline");
+  static auto* batch_cell = executor_dispatch_decisions->GetCell("batch");
+  static auto* dispatch_cell = executor_dispatch_decisions->GetCell("dispatch");
+  inline_cell->IncrementBy(num_inlined);
+  batch_cell->IncrementBy(num_batched);
+  dispatch_cell->IncrementBy(num_dispatched);
+  static auto* closures_saved_cell =
+      executor_closures_saved_histogram->GetCell();
+  closures_saved_cell->Add(num_inlined + num_batched - num_batch_closures);
+}
+
+void RecordStaticMemoryPlanAllocations(int64_t num_planned,
+                                       int64_t num_unplanned) {
+  static auto* planned_cell =
+      static_memory_plan_allocations->GetCell("planned");
+  static auto* unplanned_cell =
+      static_memory_plan_allocations->GetCell("unplanned");
+  planned_cell->IncrementBy(num_planned);
+  unplanned_cell->IncrementBy(num_unplanned);
+}
+
 void UpdateGraphBuildTime(const uint64 running_time_usecs) {
   if (running_time_usecs > 0) {
     static auto* build_graph_calls_cell = build_graph_calls->GetCell();
@@ -21,6 +21,7 @@ limitations under the License.
 #include "tensorflow/core/framework/dataset_options.pb.h"
 #include "tensorflow/core/lib/monitoring/counter.h"
 #include "tensorflow/core/lib/monitoring/gauge.h"
+#include "tensorflow/core/lib/monitoring/sampler.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/statusor.h"
 #include "tensorflow/core/platform/types.h"
@@ -77,9 +78,33 @@ monitoring::CounterCell* GetTFDataElementsCounter(const string& name);
 monitoring::GaugeCell<std::function<std::string()>>* GetTFDataModelGauge(
     const string& id);
 
+// Returns a gauge that renders the throughput of the elements produced on a
+// NUMA node by NUMA-aware tf.data iterators.
+//
+// The `numa_node` argument is the index of the node.
+monitoring::GaugeCell<std::function<std::string()>>*
+GetTFDataNumaNodeThroughputGauge(const string& numa_node);
+
 // Records the number of bytes fetched from tf.data.Dataset iterator.
 void RecordTFDataBytesFetched(int64_t num_bytes);
 
+// Records the number of bytes that tf.data shuffle buffers spilled to disk.
+void RecordTFDataShuffleSpillBytesWritten(int64_t num_bytes);
+
+// Records the number of bytes that tf.data shuffle buffers read back from
+// disk.
+void RecordTFDataShuffleSpillBytesRead(int64_t num_bytes);
+
+// Records tf.data process-wide shared cache queries.
+void RecordTFDataSharedCacheQuery(bool cache_hit);
+
+// Records tf.data process-wide shared cache memory usage in bytes.
+void RecordTFDataSharedCacheSizeBytes(size_t bytes);
+
+// Records the number of bytes evicted from the tf.data process-wide shared
+// cache.
+void RecordTFDataSharedCacheEvictedBytes(int64_t num_bytes);
+
 // Records the number of times tf.data experiment is applied to input pipelines.
 void RecordTFDataExperiment(const string& name);
 
@@ -206,6 +231,31 @@ void RecordTPUXlaSpmdCoresPerReplica(int64_t cores_per_replica);
 void UpdateGraphExecTime(const uint64 running_time_usecs);
 void UpdateGraphPendingQueueLength(uint64 len);
 
+// Records how an executor step that uses a `KernelDispatchPolicy` ran its
+// nodes: `num_inlined` nodes ran on the thread that made them ready,
+// `num_batched` nodes ran in `num_batch_closures` shared closures, and
+// `num_dispatched` nodes ran in their own closure.
+void RecordExecutorDispatchDecisions(int64_t num_inlined, int64_t num_batched,
+                                     int64_t num_batch_closures,
+                                     int64_t num_dispatched);
+
+// Records that an executor step that replayed a static memory plan served
+// `num_planned` allocations from the plan's buffers and forwarded
+// `num_unplanned` allocations to the device allocator.
+void RecordStaticMemoryPlanAllocations(int64_t num_planned,
+                                       int64_t num_unplanned);
+
+// Returns a sampler cell that records the time, in microseconds, that the
+// inter-op closures of runs with the given run handler pool `priority` spend
+// queued before a thread of the pool runs them. Only one in every
+// TF_RUN_HANDLER_QUEUEING_DELAY_SAMPLE_PERIOD closures (64 by default) is
+// recorded, and none if that period is 0.
+monitoring::SamplerCell* GetRunHandlerQueueingDelayCell(int64_t priority);
+
+// Records the time, in microseconds, that a run with the given run handler
+// pool `priority` waited for a free run handler.
+void RecordRunHandlerWaitTime(int64_t priority, uint64 wait_time_usecs);
+
 // Records that one output of an op of type `op_name` was unused.
 void RecordUnusedOutput(const string& op_name);
 
@@ -55,6 +55,16 @@ constexpr double kTargetTimeSigmas = 1.0;
 // downsizing a buffer.
 constexpr double kBufferUpsizeMultiplier = 2.0;
 constexpr double kBufferDownsizeMultipliter = 0.9;
+// The smoothing factors of the per-node cost models of the model-predictive
+// optimization: the weight of a new observation in the level, the weight of a
+// new observation in the trend, and the damping applied to the trend.
+constexpr double kCostModelLevelWeight = 0.5;
+constexpr double kCostModelTrendWeight = 0.2;
+constexpr double kCostModelTrendDamping = 0.8;
+// The model-predictive optimization keeps the current parameter values unless
+// the new ones are predicted to reduce the output time by at least this
+// fraction.
+constexpr double kModelPredictiveMinImprovement = 0.05;
 
 constexpr char kFlatMap[] = "FlatMap";
 constexpr char kInterleave[] = "Interleave";
@@ -2281,6 +2291,10 @@ void Model::Optimize(AutotuneAlgorithm algorithm, int64_t cpu_budget,
     case AutotuneAlgorithm::STAGE_BASED:
       OptimizeStageBased(snapshot, optimization_params, cancellation_manager);
       break;
+    case AutotuneAlgorithm::MODEL_PREDICTIVE:
+      OptimizeModelPredictive(snapshot, optimization_params,
+                              cancellation_manager);
+      break;
     default:
       VLOG(2) << "Autotuning algorithm was not recognized. Aborting "
                  "optimization.";
@@ -2570,6 +2584,185 @@ void Model::OptimizeHillClimbHelper(
   }
   UpdateStateValues(&parameters);
 }
+
+void Model::UpdateCostModels(std::shared_ptr<Node> snapshot) {
+  Node::NodeVector nodes =
+      snapshot->CollectNodes(TraversalOrder::BFS, IsAnyNode);
+  nodes.push_back(snapshot);
+  mutex_lock l(mu_);
+  absl::flat_hash_map<std::string, NodeCostModel> cost_models;
+  for (auto& node : nodes) {
+    const int64_t num_elements = node->num_elements();
+    const int64_t processing_time = node->processing_time();
+    if (num_elements == 0) {
+      continue;
+    }
+    NodeCostModel cost_model;
+    auto it = cost_models_.find(node->long_name());
+    if (it == cost_models_.end()) {
+      // The first observation covers the lifetime of the node.
+      cost_model.level = static_cast<double>(processing_time) /
+                         static_cast<double>(num_elements);
+    } else {
+      cost_model = it->second;
+      const int64_t delta_elements = num_elements - cost_model.num_elements;
+      if (delta_elements > 0) {
+        const double observed =
+            static_cast<double>(processing_time - cost_model.processing_time) /
+            static_cast<double>(delta_elements);
+        const double damped_trend = kCostModelTrendDamping * cost_model.trend;
+        const double level =
+            kCostModelLevelWeight * observed +
+            (1.0 - kCostModelLevelWeight) * (cost_model.level + damped_trend);
+        cost_model.trend =
+            kCostModelTrendWeight * (level - cost_model.level) +
+            (1.0 - kCostModelTrendWeight) * damped_trend;
+        cost_model.level = level;
+      }
+    }
+    cost_model.num_elements = num_elements;
+    cost_model.processing_time = processing_time;
+    const double predicted = std::max(
+        0.0, cost_model.level + kCostModelTrendDamping * cost_model.trend);
+    // The snapshot is private to this optimization, so its processing time can
+    // be overwritten to make the output time reflect the predicted cost.
+    node->add_processing_time(
+        static_cast<int64_t>(predicted * static_cast<double>(num_elements)) -
+        processing_time);
+    cost_models[node->long_name()] = cost_model;
+  }
+  // Only the nodes that are still part of the model are kept.
+  cost_models_ = std::move(cost_models);
+}
+
+void Model::OptimizeModelPredictive(
+    std::shared_ptr<Node> snapshot,
+    const OptimizationParams& optimization_params,
+    CancellationManager* cancellation_manager) {
+  VLOG(2) << "Starting optimization of tunable parameters with Model "
+             "Predictive.";
+  UpdateCostModels(snapshot);
+  auto parameters = CollectTunableParameters(snapshot);
+  if (parameters.empty()) {
+    VLOG(2) << "There are no tunable parameters.";
+    return;
+  }
+  VLOG(2) << "Number of tunable parameters: " << parameters.size();
+
+  // Output time improvements smaller than this are ignored.
+  constexpr double kMinDelta = 1.0L;
+  // The minimum resource cost of a step, so that steps that do not consume any
+  // budget are preferred but still ranked by their improvement.
+  constexpr double kMinResourceCost = 1.0e-3;
+
+  const double model_input_time = optimization_params.model_input_time();
+  const double ram_budget = optimization_params.ram_budget();
+  auto cpu_usage = [&parameters]() {
+    double usage = 0.0;
+    for (const auto& pair : parameters) {
+      if (pair.second->name == kParallelism) {
+        usage += pair.second->value;
+      }
+    }
+    return usage;
+  };
+
+  // Evaluates the parameter values currently in use under the updated cost
+  // model.
+  std::vector<double> current_values;
+  current_values.reserve(parameters.size());
+  for (auto& pair : parameters) {
+    pair.second->value =
+        std::clamp(pair.second->value, pair.second->min, pair.second->max);
+    current_values.push_back(pair.second->value);
+  }
+  const double current_output_time =
+      OutputTime(snapshot, model_input_time, /*gradients=*/nullptr);
+  const double current_cpu_usage = cpu_usage();
+  const double current_buffered_bytes = TotalMaximumBufferedBytes(snapshot);
+
+  for (auto& pair : parameters) {
+    pair.second->value = pair.second->min;
+  }
+  // The CPU budget cannot be lower than the parallelism of the minimum values.
+  const double cpu_budget =
+      std::max<double>(optimization_params.cpu_budget(), cpu_usage());
+  const bool current_within_budget =
+      current_cpu_usage <= cpu_budget && current_buffered_bytes <= ram_budget;
+  const double processing_time = TotalProcessingTime(snapshot);
+  double output_time =
+      OutputTime(snapshot, model_input_time, /*gradients=*/nullptr);
+  double buffered_bytes = TotalMaximumBufferedBytes(snapshot);
+  double parallelism = cpu_usage();
+  while (!cancellation_manager->IsCancelled()) {
+    if (output_time < processing_time / cpu_budget) {
+      metrics::RecordTFDataAutotuneStoppingCriteria("output_time");
+      break;
+    }
+    double best_score = 0.0;
+    Parameter* best_parameter = nullptr;
+    double best_output_time = output_time;
+    double best_buffered_bytes = buffered_bytes;
+    for (auto& pair : parameters) {
+      Parameter* parameter = pair.second.get();
+      if (parameter->value >= parameter->max) {
+        continue;
+      }
+      const double new_parallelism =
+          parallelism + (parameter->name == kParallelism ? 1.0 : 0.0);
+      if (new_parallelism > cpu_budget) {
+        continue;
+      }
+      parameter->value++;
+      const double new_buffered_bytes = TotalMaximumBufferedBytes(snapshot);
+      const double new_output_time =
+          OutputTime(snapshot, model_input_time, /*gradients=*/nullptr);
+      parameter->value--;
+      const double delta = output_time - new_output_time;
+      if (new_buffered_bytes > ram_budget || delta <= kMinDelta) {
+        continue;
+      }
+      double resource_cost = (new_parallelism - parallelism) / cpu_budget;
+      if (new_buffered_bytes > buffered_bytes) {
+        resource_cost += (new_buffered_bytes - buffered_bytes) / ram_budget;
+      }
+      const double score = delta / std::max(resource_cost, kMinResourceCost);
+      if (score > best_score) {
+        best_score = score;
+        best_parameter = parameter;
+        best_output_time = new_output_time;
+        best_buffered_bytes = new_buffered_bytes;
+      }
+    }
+    if (!best_parameter) {
+      metrics::RecordTFDataAutotuneStoppingCriteria("budget_exhausted");
+      break;
+    }
+    best_parameter->value++;
+    if (best_parameter->name == kParallelism) {
+      parallelism++;
+    }
+    output_time = best_output_time;
+    buffered_bytes = best_buffered_bytes;
+  }
+
+  const bool faster =
+      output_time <
+      (1.0 - kModelPredictiveMinImprovement) * current_output_time;
+  const bool cheaper = parallelism < current_cpu_usage &&
+                       output_time <= current_output_time;
+  if (current_within_budget && !faster && !cheaper) {
+    VLOG(2) << "Keeping the current parameter values, whose predicted output "
+               "time is "
+            << current_output_time << " compared to " << output_time << ".";
+    metrics::RecordTFDataAutotuneStoppingCriteria("model_predictive_damped");
+    int i = 0;
+    for (auto& pair : parameters) {
+      pair.second->value = current_values[i++];
+    }
+  }
+  UpdateStateValues(&parameters);
+}
 void Model::RecordIteratorGapTime(uint64_t duration_usec) {
   mutex_lock l(gap_mu_);
   // Drop duration if it is too large.
@@ -943,6 +943,25 @@ class Model {
                           const OptimizationParams& optimization_params,
                           CancellationManager* cancellation_manager);
 
+  // This optimization fits a model of the per-element processing time of each
+  // node from the time recorded since the previous optimization (see
+  // `UpdateCostModels`) and uses it to predict the output time. Starting from
+  // the minimum values, it then repeatedly increases the parameter with the
+  // largest predicted output time improvement per unit of CPU and RAM budget it
+  // consumes, until neither budget allows for further improvement. To avoid
+  // oscillating between similar configurations, the new parameter values are
+  // only applied if they are predicted to be noticeably faster than the current
+  // ones, if they use less CPU without being slower, or if the current values
+  // no longer fit the budgets.
+  void OptimizeModelPredictive(std::shared_ptr<Node> snapshot,
+                               const OptimizationParams& optimization_params,
+                               CancellationManager* cancellation_manager);
+
+  // Updates the cost model of each node in `snapshot` with the per-element
+  // processing time recorded since the previous update, and sets the processing
+  // time of the snapshot nodes to the one predicted by their cost models.
+  void UpdateCostModels(std::shared_ptr<Node> snapshot) TF_LOCKS_EXCLUDED(mu_);
+
   // This is the first part of the stage-based optimization that optimizes
   // tunable parallelism parameters for async interleave many nodes only. We
   // separately optimize async interleave many nodes more aggressively because
@@ -1025,6 +1044,22 @@ class Model {
   std::shared_ptr<Node> snapshot_ TF_GUARDED_BY(mu_);
   // Stores the optimization parameters used by autotune.
   OptimizationParams optimization_params_ TF_GUARDED_BY(mu_);
+  // Online model of the per-element processing time of a node, used by the
+  // `MODEL_PREDICTIVE` algorithm. It is fit by exponential smoothing with a
+  // damped trend of the per-element processing times observed between
+  // consecutive optimizations.
+  struct NodeCostModel {
+    // The number of elements and the processing time of the node at the last
+    // observation.
+    int64_t num_elements = 0;
+    int64_t processing_time = 0;
+    // The smoothed per-element processing time and its trend per observation.
+    double level = 0.0;
+    double trend = 0.0;
+  };
+  // Cost models of the nodes, keyed by the node long name.
+  absl::flat_hash_map<std::string, NodeCostModel> cost_models_
+      TF_GUARDED_BY(mu_);
 };
 
 // Class to compute timing information for a model.
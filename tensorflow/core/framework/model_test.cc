@@ -1343,7 +1343,7 @@ TEST_P(OptimizeZeroRamBudgetTest, Model) {
 }
 
 INSTANTIATE_TEST_SUITE_P(Test, OptimizeZeroRamBudgetTest,
-                         ::testing::Values(0, 1, 2, 3));
+                         ::testing::Values(0, 1, 2, 3, 5));
 
 TEST(RecordTimeTest, RecordTimeTest) {
   std::shared_ptr<Node> source = model::MakeSourceNode({});
@@ -3180,6 +3180,187 @@ TEST_F(ModelTimingTest, SelfTime) {
   EXPECT_DOUBLE_EQ(910, node_2->ComputeSelfTime());
 }
 
+// Replays recorded pipeline traces against a model. Each round of a trace
+// records the elements produced by the nodes since the previous round, after
+// which the model is optimized as if the optimization period had elapsed.
+class TraceReplayTest : public ModelTimingTest {
+ protected:
+  struct NodeTrace {
+    int64_t node_id;
+    int64_t num_elements;
+    int64_t processing_time_per_element;
+  };
+  using TraceRound = std::vector<NodeTrace>;
+
+  // Returns a pipeline of two parallel maps, with node 2 producing the input of
+  // node 1, in which both nodes have produced 100 elements.
+  static std::string TwoParallelMapsPipeline(int64_t processing_time_1,
+                                             int64_t processing_time_2,
+                                             int64_t bytes_produced) {
+    return strings::Printf(R"pb(
+      nodes: {
+        key: 1
+        value: {
+          id: 1
+          name: "ParallelMapV2"
+          autotune: true
+          num_elements: 100
+          processing_time: %lld
+          bytes_produced: %lld
+          node_class: ASYNC_KNOWN_RATIO
+          ratio: 1
+          inputs: 2
+          parameters: {
+            name: "parallelism"
+            value: 1
+            min: 1
+            max: 16
+            tunable: true
+          }
+        }
+      }
+      nodes: {
+        key: 2
+        value: {
+          id: 2
+          name: "ParallelMapV2"
+          autotune: true
+          num_elements: 100
+          processing_time: %lld
+          bytes_produced: %lld
+          node_class: ASYNC_KNOWN_RATIO
+          ratio: 1
+          parameters: {
+            name: "parallelism"
+            value: 1
+            min: 1
+            max: 16
+            tunable: true
+          }
+        }
+      }
+      output: 1
+    )pb",
+                           static_cast<long long>(processing_time_1),
+                           static_cast<long long>(bytes_produced),
+                           static_cast<long long>(processing_time_2),
+                           static_cast<long long>(bytes_produced));
+  }
+
+  // Replays `trace`, optimizing the model with `algorithm` after each round,
+  // and returns the parallelism of nodes 1 and 2 after each round.
+  std::vector<std::pair<double, double>> Replay(
+      const std::vector<TraceRound>& trace, AutotuneAlgorithm algorithm,
+      int64_t cpu_budget, int64_t ram_budget) {
+    std::vector<std::pair<double, double>> parallelism;
+    CancellationManager cancellation_manager;
+    for (const TraceRound& round : trace) {
+      for (const NodeTrace& node_trace : round) {
+        Node* node = MutableGetNode(node_trace.node_id);
+        node->add_processing_time(node_trace.num_elements *
+                                  node_trace.processing_time_per_element);
+        for (int64_t i = 0; i < node_trace.num_elements; ++i) {
+          node->record_element();
+        }
+      }
+      model_->Optimize(algorithm, cpu_budget, ram_budget,
+                       /*model_input_time=*/0, &cancellation_manager);
+      parallelism.emplace_back(
+          GetNode(/*node_id=*/1)->parameter_value(kParallelism),
+          GetNode(/*node_id=*/2)->parameter_value(kParallelism));
+    }
+    return parallelism;
+  }
+};
+
+TEST_F(TraceReplayTest, ModelPredictiveAdaptsToCostChange) {
+  BuildModelFromProto(TwoParallelMapsPipeline(
+      /*processing_time_1=*/100000000, /*processing_time_2=*/100000000,
+      /*bytes_produced=*/0));
+  // Both nodes take 1ms per element, until the elements processed by node 2
+  // become 9 times more expensive.
+  std::vector<TraceRound> trace;
+  for (int i = 0; i < 5; ++i) {
+    trace.push_back({{1, 100, 1000000}, {2, 100, 1000000}});
+  }
+  for (int i = 0; i < 6; ++i) {
+    trace.push_back({{1, 100, 1000000}, {2, 100, 9000000}});
+  }
+  auto parallelism = Replay(trace, AutotuneAlgorithm::MODEL_PREDICTIVE,
+                            /*cpu_budget=*/8, /*ram_budget=*/1000);
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_EQ(parallelism[i], std::make_pair(4.0, 4.0)) << "round " << i;
+  }
+  // The cost model follows the change within two rounds, while the lifetime
+  // average of node 2 is still below 4ms per element.
+  for (size_t i = 6; i < parallelism.size(); ++i) {
+    EXPECT_EQ(parallelism[i], std::make_pair(2.0, 6.0)) << "round " << i;
+  }
+}
+
+TEST_F(TraceReplayTest, ModelPredictiveDoesNotOscillate) {
+  BuildModelFromProto(TwoParallelMapsPipeline(
+      /*processing_time_1=*/100000000, /*processing_time_2=*/150000000,
+      /*bytes_produced=*/0));
+  // The cost of node 2 alternates around the cost for which (3, 5) and (4, 4)
+  // are predicted to be equally fast.
+  std::vector<TraceRound> trace;
+  for (int i = 0; i < 12; ++i) {
+    trace.push_back(
+        {{1, 100, 1000000}, {2, 100, i % 2 == 0 ? 2000000 : 1100000}});
+  }
+  auto parallelism = Replay(trace, AutotuneAlgorithm::MODEL_PREDICTIVE,
+                            /*cpu_budget=*/8, /*ram_budget=*/1000);
+  int num_changes = 0;
+  for (size_t i = 1; i < parallelism.size(); ++i) {
+    EXPECT_EQ(parallelism[i].first + parallelism[i].second, 8);
+    if (parallelism[i] != parallelism[i - 1]) {
+      ++num_changes;
+    }
+  }
+  EXPECT_LE(num_changes, 1);
+}
+
+TEST_F(TraceReplayTest, ModelPredictiveRespectsRamBudget) {
+  // Each element buffered by either node takes 1000 bytes.
+  BuildModelFromProto(TwoParallelMapsPipeline(
+      /*processing_time_1=*/100000000, /*processing_time_2=*/100000000,
+      /*bytes_produced=*/100000));
+  CellReader<int64_t> cell_reader(
+      "/tensorflow/data/autotune_stopping_criteria");
+  CancellationManager cancellation_manager;
+  model_->Optimize(AutotuneAlgorithm::MODEL_PREDICTIVE, /*cpu_budget=*/8,
+                   /*ram_budget=*/6000, /*model_input_time=*/0,
+                   &cancellation_manager);
+  EXPECT_EQ(GetNode(/*node_id=*/1)->parameter_value(kParallelism), 3);
+  EXPECT_EQ(GetNode(/*node_id=*/2)->parameter_value(kParallelism), 3);
+  EXPECT_EQ(cell_reader.Delta("budget_exhausted"), 1);
+}
+
+TEST_F(TraceReplayTest, ModelPredictiveKeepsRecordedProcessingTime) {
+  BuildModelFromProto(R"pb(
+    nodes: {
+      key: 1
+      value: {
+        id: 1
+        name: "Map"
+        autotune: true
+        num_elements: 100
+        processing_time: 1000
+        node_class: KNOWN_RATIO
+        ratio: 1
+      }
+    }
+    output: 1
+  )pb");
+  CancellationManager cancellation_manager;
+  model_->Optimize(AutotuneAlgorithm::MODEL_PREDICTIVE, /*cpu_budget=*/8,
+                   /*ram_budget=*/1000, /*model_input_time=*/0,
+                   &cancellation_manager);
+  // Only the processing time of the snapshot is replaced by the prediction.
+  EXPECT_EQ(GetNode(/*node_id=*/1)->processing_time(), 1000);
+}
+
 }  // namespace
 }  // namespace model
 }  // namespace data
@@ -627,6 +627,11 @@ class OpKernelContext {
     // stored in this container..
     ScopedStepContainer* step_container = nullptr;
 
+    // If not null, allocations with default attributes are served from this
+    // allocator instead of the device's. Owned by the executor, which uses it
+    // to pool the memory of short-lived tensors within a step.
+    Allocator* step_allocator = nullptr;
+
     // Mechanism used by this op kernel invocation to communicate with
     // computations running on other devices.
     RendezvousInterface* rendezvous = nullptr;
@@ -19,10 +19,12 @@ limitations under the License.
 
 #include <algorithm>
 #include <cmath>
+#include <limits>
 #include <list>
 #include <memory>
 
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "tensorflow/core/framework/metrics.h"
 #include "tensorflow/core/framework/run_handler_util.h"
 #include "tensorflow/core/lib/core/threadpool_interface.h"
 #include "tensorflow/core/lib/strings/strcat.h"
@@ -43,6 +45,23 @@ static constexpr int32_t kMaxConcurrentHandlers = 128;
 typedef typename internal::RunHandlerEnvironment::Task Task;
 typedef Eigen::RunQueue<Task, 1024> Queue;
 
+// Returns the number of inter-op closures per closure whose queueing delay is
+// recorded, or 0 if the delay is not recorded.
+int64_t QueueingDelaySamplePeriod() {
+  static const int64_t period = static_cast<int64_t>(ParamFromEnvWithDefault(
+      "TF_RUN_HANDLER_QUEUEING_DELAY_SAMPLE_PERIOD", 64.0));
+  return period;
+}
+
+// Returns true if the queueing delay of the next inter-op closure scheduled
+// by the current thread should be recorded.
+bool SampleQueueingDelay() {
+  const int64_t period = QueueingDelaySamplePeriod();
+  if (period <= 0) return false;
+  thread_local int64_t num_closures = 0;
+  return num_closures++ % period == 0;
+}
+
 }  // namespace
 
 namespace internal {
@@ -735,6 +754,9 @@ class RunHandler::Impl {
   // Stores now time (in microseconds) since unix epoch when the handler is
   // requested via RunHandlerPool::Get().
   uint64 start_time_us() const { return start_time_us_; }
+  // Time (in microseconds since unix epoch) by which the run should complete,
+  // or kNoDeadline if the run has no latency budget.
+  uint64 deadline_us() const { return deadline_us_; }
   int64_t step_id() const { return step_id_; }
   void ScheduleInterOpClosure(std::function<void()> fn);
   void ScheduleIntraOpClosure(std::function<void()> fn);
@@ -746,7 +768,18 @@ class RunHandler::Impl {
 
   internal::ThreadWorkSource* tws() { return &tws_; }
 
-  int64_t priority() { return options_.priority(); }
+  int64_t priority() const { return options_.priority(); }
+
+  // Returns true if the inter-op work of this handler should be stolen before
+  // the work of `other`: handlers with a higher priority run first, and among
+  // handlers with the same priority the one with the earliest deadline runs
+  // first. Ties keep the order in which the handlers were requested.
+  bool RunsBefore(const Impl& other) const {
+    if (priority() != other.priority()) return priority() > other.priority();
+    return deadline_us() < other.deadline_us();
+  }
+
+  static constexpr uint64 kNoDeadline = std::numeric_limits<uint64>::max();
 
  private:
   class ThreadPoolInterfaceWrapper : public thread::ThreadPoolInterface {
@@ -764,7 +797,11 @@ class RunHandler::Impl {
 
   RunHandlerPool::Impl* pool_impl_;  // NOT OWNED.
   uint64 start_time_us_;
+  uint64 deadline_us_;
   int64_t step_id_;
+  // Records the queueing delay of inter-op closures for the priority of the
+  // current run.
+  monitoring::SamplerCell* queueing_delay_cell_ = nullptr;
   std::unique_ptr<thread::ThreadPoolInterface> thread_pool_interface_;
   internal::ThreadWorkSource tws_;
   RunOptions::Experimental::RunHandlerPoolOptions options_;
@@ -844,6 +881,7 @@ class RunHandlerPool::Impl {
     uint64 version;
     int num_active_requests;
     RunHandler::Impl* handler_impl;
+    const uint64 wait_start_us = tensorflow::EnvTime::NowMicros();
     {
       mutex_lock l(mu_);
       if (!has_free_handler()) {
@@ -873,12 +911,11 @@ class RunHandlerPool::Impl {
 
       num_active_requests = sorted_active_handlers_.size() + 1;
       thread_work_sources->resize(num_active_requests);
-      int priority = options.priority();
       auto it = sorted_active_handlers_.cbegin();
       bool new_handler_inserted = false;
       for (int i = 0; i < num_active_requests; ++i) {
         if (!new_handler_inserted && (it == sorted_active_handlers_.cend() ||
-                                      priority > (*it)->priority())) {
+                                      handler_impl->RunsBefore(**it))) {
           sorted_active_handlers_.insert(it, handler_impl);
           new_handler_inserted = true;
           // Point to the newly added handler.
@@ -889,6 +926,8 @@ class RunHandlerPool::Impl {
       }
       version = ++version_;
     }
+    metrics::RecordRunHandlerWaitTime(
+        options.priority(), tensorflow::EnvTime::NowMicros() - wait_start_us);
     RecomputePoolStats(num_active_requests, version, *thread_work_sources);
     return std::unique_ptr<RunHandler>(new RunHandler(handler_impl));
   }
@@ -934,6 +973,16 @@ class RunHandlerPool::Impl {
     return ret;
   }
 
+  std::vector<int64_t> GetActiveHandlerStepIdsForTesting()
+      TF_LOCKS_EXCLUDED(mu_) {
+    mutex_lock l(mu_);
+    std::vector<int64_t> ret;
+    for (const auto& handler_impl : sorted_active_handlers_) {
+      ret.push_back(handler_impl->step_id());
+    }
+    return ret;
+  }
+
  private:
   void RecomputePoolStats(
       int num_active_requests, uint64 version,
@@ -953,8 +1002,8 @@ class RunHandlerPool::Impl {
 
   std::unique_ptr<internal::RunHandlerThreadPool> run_handler_thread_pool_;
   // Thread compatible part used only by lock under RunHandlerPool.
-  // Handlers are sorted by start time.
-  // TODO(azaks): sort by the remaining latency budget.
+  // Handlers are sorted by priority, then by deadline (see
+  // RunHandler::Impl::RunsBefore), then by start time.
   // TODO(chaox): Consider other data structure for maintaining the sorted
   // active handlers if the searching overhead(currently O(n)) becomes the
   // bottleneck.
@@ -1064,8 +1113,20 @@ RunHandler::Impl::Impl(RunHandlerPool::Impl* pool_impl)
 
 void RunHandler::Impl::ScheduleInterOpClosure(std::function<void()> fn) {
   VLOG(3) << "Scheduling inter work for  " << tws()->GetTracemeId();
-  pool_impl_->run_handler_thread_pool()->AddWorkToQueue(tws(), true,
-                                                        std::move(fn));
+  if (!SampleQueueingDelay()) {
+    pool_impl_->run_handler_thread_pool()->AddWorkToQueue(tws(), true,
+                                                          std::move(fn));
+    return;
+  }
+  const uint64 enqueue_time_us = tensorflow::EnvTime::NowMicros();
+  pool_impl_->run_handler_thread_pool()->AddWorkToQueue(
+      tws(), true,
+      [fn = std::move(fn), enqueue_time_us,
+       queueing_delay_cell = queueing_delay_cell_]() {
+        queueing_delay_cell->Add(tensorflow::EnvTime::NowMicros() -
+                                 enqueue_time_us);
+        fn();
+      });
 }
 
 void RunHandler::Impl::ScheduleIntraOpClosure(std::function<void()> fn) {
@@ -1078,8 +1139,14 @@ void RunHandler::Impl::Reset(
     int64_t step_id,
     const RunOptions::Experimental::RunHandlerPoolOptions& options) {
   start_time_us_ = tensorflow::Env::Default()->NowMicros();
+  deadline_us_ =
+      options.latency_budget_in_ms() > 0
+          ? start_time_us_ + options.latency_budget_in_ms() * 1000
+          : kNoDeadline;
   step_id_ = step_id;
   options_ = options;
+  queueing_delay_cell_ =
+      metrics::GetRunHandlerQueueingDelayCell(options.priority());
   tws_.SetTracemeId(step_id);
 }
 
@@ -1103,6 +1170,11 @@ std::vector<int64_t> RunHandlerPool::GetActiveHandlerPrioritiesForTesting()
   return impl_->GetActiveHandlerPrioritiesForTesting();
 }
 
+std::vector<int64_t> RunHandlerPool::GetActiveHandlerStepIdsForTesting()
+    const {
+  return impl_->GetActiveHandlerStepIdsForTesting();
+}
+
 RunHandler::RunHandler(Impl* impl) : impl_(impl) {}
 
 void RunHandler::ScheduleInterOpClosure(std::function<void()> fn) {
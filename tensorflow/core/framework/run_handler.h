@@ -72,6 +72,10 @@ class RunHandlerPool {
   // order of the active handler list.
   std::vector<int64_t> GetActiveHandlerPrioritiesForTesting() const;
 
+  // Get the step ids for active handlers, in the order of the active handler
+  // list.
+  std::vector<int64_t> GetActiveHandlerStepIdsForTesting() const;
+
  private:
   class Impl;
   friend class RunHandler;
@@ -82,7 +86,9 @@ class RunHandlerPool {
 // RunHandler can be used to schedule inter/intra-op closures to run on a global
 // pool shared across all Session::Run(s). The closures are enqueued to a
 // handler specific queue, from which the work is stolen in a priority order
-// (time of the Get() call).
+// (RunHandlerPoolOptions.priority, then the deadline given by
+// RunHandlerPoolOptions.latency_budget_in_ms, then the time of the Get()
+// call).
 //
 // It can only be created via RunHandlerPool::Get().
 //
@@ -28,6 +28,7 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/graph/graph.h"
 #include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/lib/monitoring/cell_reader.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/blocking_counter.h"
 #include "tensorflow/core/platform/env.h"
@@ -113,6 +114,71 @@ TEST(RunHandlerUtilTest, PrioritySchedulingTest) {
   EXPECT_EQ(sorted_active_list[3], 1);
 }
 
+TEST(RunHandlerUtilTest, DeadlineSchedulingTest) {
+  int num_threads = 2;
+  std::unique_ptr<RunHandlerPool> pool(
+      new RunHandlerPool(num_threads, num_threads));
+
+  RunOptions::Experimental::RunHandlerPoolOptions options;
+  options.set_priority(1);
+  options.set_latency_budget_in_ms(1000 * 1000);
+  auto handler1 = pool->Get(/*step_id=*/1, /*timeout_in_ms=*/0, options);
+  options.set_latency_budget_in_ms(0);
+  auto handler2 = pool->Get(/*step_id=*/2, /*timeout_in_ms=*/0, options);
+  options.set_latency_budget_in_ms(10);
+  auto handler3 = pool->Get(/*step_id=*/3, /*timeout_in_ms=*/0, options);
+
+  // Among requests with the same priority, the one with the earliest deadline
+  // comes first, and requests without a latency budget come last.
+  EXPECT_THAT(pool->GetActiveHandlerStepIdsForTesting(),
+              ::testing::ElementsAre(3, 1, 2));
+
+  // Priorities take precedence over deadlines.
+  options.set_priority(2);
+  options.set_latency_budget_in_ms(0);
+  auto handler4 = pool->Get(/*step_id=*/4, /*timeout_in_ms=*/0, options);
+  options.set_priority(1);
+  options.set_latency_budget_in_ms(10 * 1000);
+  auto handler5 = pool->Get(/*step_id=*/5, /*timeout_in_ms=*/0, options);
+  EXPECT_THAT(pool->GetActiveHandlerStepIdsForTesting(),
+              ::testing::ElementsAre(4, 3, 5, 1, 2));
+}
+
+TEST(RunHandlerUtilTest, RecordsQueueingDelayByPriority) {
+  monitoring::testing::CellReader<monitoring::testing::Histogram>
+      queueing_delay("/tensorflow/core/run_handler_queueing_delay_usecs");
+  monitoring::testing::CellReader<monitoring::testing::Histogram> wait_time(
+      "/tensorflow/core/run_handler_wait_usecs");
+  int num_threads = 2;
+  std::unique_ptr<RunHandlerPool> pool(
+      new RunHandlerPool(num_threads, num_threads));
+
+  RunOptions::Experimental::RunHandlerPoolOptions options;
+  options.set_priority(7);
+  auto handler = pool->Get(/*step_id=*/1, /*timeout_in_ms=*/0, options);
+  // By default, one in every 64 closures scheduled by a thread is sampled,
+  // starting with the first one.
+  constexpr int kSamplePeriod = 64;
+  constexpr int kNumClosures = 3 * kSamplePeriod;
+  BlockingCounter counter(kNumClosures);
+  {
+    // Schedules from a new thread, whose sampling starts from its first
+    // closure.
+    std::unique_ptr<Thread> thread(Env::Default()->StartThread(
+        ThreadOptions(), "schedule", [&handler, &counter]() {
+          for (int i = 0; i < kNumClosures; ++i) {
+            handler->ScheduleInterOpClosure(
+                [&counter]() { counter.DecrementCount(); });
+          }
+        }));
+  }
+  counter.Wait();
+  handler.reset();
+
+  EXPECT_EQ(queueing_delay.Delta("7").num(), 3);
+  EXPECT_EQ(wait_time.Delta("7").num(), 1);
+}
+
 TEST(RunHandlerThreadPool, EnqueueTask) {
   Eigen::MaxSizeVector<mutex> waiters_mu(2);
   waiters_mu.resize(2);
@@ -0,0 +1,346 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/data/parse_example_projection.h"
+
+#include <algorithm>
+#include <array>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/strip.h"
+#include "tensorflow/core/framework/attr_value.pb.h"
+#include "tensorflow/core/framework/function.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/grappler/clusters/cluster.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/mutable_graph_view.h"
+#include "tensorflow/core/grappler/op_types.h"
+#include "tensorflow/core/grappler/optimizers/custom_graph_optimizer_registry.h"
+#include "tensorflow/core/grappler/optimizers/data/graph_utils.h"
+#include "tensorflow/core/grappler/utils.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace {
+
+constexpr char kDenseKeys[] = "dense_keys";
+constexpr char kSparseKeys[] = "sparse_keys";
+constexpr char kRaggedKeys[] = "ragged_keys";
+constexpr char kOutputTypes[] = "output_types";
+constexpr char kOutputShapes[] = "output_shapes";
+constexpr char kTargumentsAttr[] = "Targuments";
+constexpr char kFuncAttr[] = "f";
+
+// Index of the first `dense_defaults` input of a parse node.
+constexpr int kDenseDefaultsInputIndex = 2;
+
+constexpr std::array<const char*, 3> kParseExampleOps = {
+    "ParseExampleDataset",
+    "ParseExampleDatasetV2",
+    "ExperimentalParseExampleDataset",
+};
+
+constexpr std::array<const char*, 4> kMapOps = {
+    "MapDataset",
+    "ParallelMapDataset",
+    "ParallelMapDatasetV2",
+    "MapAndBatchDataset",
+};
+
+bool IsParseExampleNode(const NodeDef& node) {
+  for (const char* op : kParseExampleOps) {
+    if (node.op() == op) return true;
+  }
+  return false;
+}
+
+bool IsMapNode(const NodeDef& node) {
+  for (const char* op : kMapOps) {
+    if (node.op() == op) return true;
+  }
+  return false;
+}
+
+enum class FeatureKind { kDense, kSparse, kRagged };
+
+// A feature of the parsing configuration: its kind and its index in the
+// attributes of that kind.
+struct Feature {
+  FeatureKind kind;
+  int index;
+};
+
+// Returns the features of `parse_node` in the order of its output components,
+// which are sorted by key across dense, sparse and ragged features.
+std::vector<Feature> GetFeaturesInOutputOrder(const NodeDef& parse_node) {
+  std::map<string, Feature> features_by_key;
+  auto add_features = [&](const char* attr_name, FeatureKind kind) {
+    const AttrValue* keys = gtl::FindOrNull(parse_node.attr(), attr_name);
+    if (keys == nullptr) return;
+    for (int i = 0; i < keys->list().s_size(); ++i) {
+      features_by_key.insert({keys->list().s(i), {kind, i}});
+    }
+  };
+  add_features(kDenseKeys, FeatureKind::kDense);
+  add_features(kSparseKeys, FeatureKind::kSparse);
+  add_features(kRaggedKeys, FeatureKind::kRagged);
+  std::vector<Feature> features;
+  features.reserve(features_by_key.size());
+  for (const auto& it : features_by_key) features.push_back(it.second);
+  return features;
+}
+
+// Returns whether the dense feature `index` of `parse_node` has a default
+// value, i.e. whether parsing succeeds for examples which do not contain it.
+bool DenseFeatureHasDefault(const NodeDef& parse_node, int index,
+                            const MutableGraphView& graph) {
+  const int input_index = kDenseDefaultsInputIndex + index;
+  if (input_index >= parse_node.input_size()) return false;
+  const NodeDef* default_node =
+      graph.GetNode(NodeName(parse_node.input(input_index)));
+  if (default_node == nullptr || !IsConstant(*default_node)) return false;
+  const AttrValue* value = gtl::FindOrNull(default_node->attr(), "value");
+  if (value == nullptr ||
+      !TensorShape::IsValid(value->tensor().tensor_shape())) {
+    return false;
+  }
+  return TensorShape(value->tensor().tensor_shape()).num_elements() > 0;
+}
+
+// Returns the names of the input arguments of `fdef` that are read by its
+// nodes or returned by it.
+absl::flat_hash_set<string> GetUsedInputs(const FunctionDef& fdef) {
+  absl::flat_hash_set<string> used;
+  auto add_reference = [&used](absl::string_view input) {
+    absl::ConsumePrefix(&input, "^");
+    used.insert(string(input.substr(0, input.find(':'))));
+  };
+  for (const NodeDef& node : fdef.node_def()) {
+    for (const string& input : node.input()) add_reference(input);
+  }
+  for (const auto& it : fdef.ret()) add_reference(it.second);
+  return used;
+}
+
+// Removes the elements of `list` whose index is not in `keep`.
+template <typename T>
+void KeepListElements(const std::vector<int>& keep, T* list) {
+  T kept;
+  for (int index : keep) *kept.Add() = list->Get(index);
+  list->Swap(&kept);
+}
+
+// Keeps the list attribute `attr_name` of `node` only at the indices `keep`.
+void KeepAttrListElements(const char* attr_name, const std::vector<int>& keep,
+                          NodeDef* node) {
+  auto it = node->mutable_attr()->find(attr_name);
+  if (it == node->mutable_attr()->end()) return;
+  AttrValue::ListValue* list = it->second.mutable_list();
+  if (list->s_size() > 0) KeepListElements(keep, list->mutable_s());
+  if (list->type_size() > 0) KeepListElements(keep, list->mutable_type());
+  if (list->shape_size() > 0) KeepListElements(keep, list->mutable_shape());
+}
+
+// Returns a copy of `parse_node` which only parses the features
+// `features[i]` for i in `kept_outputs`.
+NodeDef MakeProjectedParseNode(const NodeDef& parse_node,
+                               const std::vector<Feature>& features,
+                               const std::vector<int>& kept_outputs,
+                               MutableGraphView* graph) {
+  NodeDef projected = parse_node;
+  graph_utils::SetUniqueGraphNodeName(parse_node.op(), graph->graph(),
+                                      &projected);
+
+  std::vector<int> kept_dense, kept_sparse, kept_ragged;
+  for (int output : kept_outputs) {
+    const Feature& feature = features[output];
+    switch (feature.kind) {
+      case FeatureKind::kDense:
+        kept_dense.push_back(feature.index);
+        break;
+      case FeatureKind::kSparse:
+        kept_sparse.push_back(feature.index);
+        break;
+      case FeatureKind::kRagged:
+        kept_ragged.push_back(feature.index);
+        break;
+    }
+  }
+  // The outputs are sorted by key, so the kept features of each kind must be
+  // listed in their original relative order.
+  std::sort(kept_dense.begin(), kept_dense.end());
+  std::sort(kept_sparse.begin(), kept_sparse.end());
+  std::sort(kept_ragged.begin(), kept_ragged.end());
+
+  for (const char* attr_name : {kDenseKeys, "Tdense", "dense_shapes"}) {
+    KeepAttrListElements(attr_name, kept_dense, &projected);
+  }
+  for (const char* attr_name : {kSparseKeys, "sparse_types"}) {
+    KeepAttrListElements(attr_name, kept_sparse, &projected);
+  }
+  for (const char* attr_name :
+       {kRaggedKeys, "ragged_value_types", "ragged_split_types"}) {
+    KeepAttrListElements(attr_name, kept_ragged, &projected);
+  }
+  KeepAttrListElements(kOutputTypes, kept_outputs, &projected);
+  KeepAttrListElements(kOutputShapes, kept_outputs, &projected);
+
+  // Inputs are `input_dataset`, `num_parallel_calls`, the dense defaults and
+  // then the control inputs.
+  const int num_dense = parse_node.attr().at(kDenseKeys).list().s_size();
+  projected.clear_input();
+  for (int i = 0; i < kDenseDefaultsInputIndex; ++i) {
+    projected.add_input(parse_node.input(i));
+  }
+  for (int d : kept_dense) {
+    projected.add_input(parse_node.input(kDenseDefaultsInputIndex + d));
+  }
+  for (int i = kDenseDefaultsInputIndex + num_dense;
+       i < parse_node.input_size(); ++i) {
+    projected.add_input(parse_node.input(i));
+  }
+  return projected;
+}
+
+// Returns a copy of `fdef` without the input arguments whose index is in
+// `removed_inputs`.
+FunctionDef MakeProjectedFunction(const FunctionDef& fdef,
+                                  const std::vector<int>& removed_inputs,
+                                  const FunctionDefLibrary& library) {
+  FunctionDef projected = fdef;
+  graph_utils::SetUniqueGraphFunctionName(fdef.signature().name(), &library,
+                                          &projected);
+  const absl::flat_hash_set<int> removed(removed_inputs.begin(),
+                                         removed_inputs.end());
+  std::vector<int> kept;
+  for (int i = 0; i < fdef.signature().input_arg_size(); ++i) {
+    if (!removed.contains(i)) kept.push_back(i);
+  }
+  KeepListElements(kept, projected.mutable_signature()->mutable_input_arg());
+
+  // Argument attributes are keyed by argument index.
+  projected.clear_arg_attr();
+  projected.clear_resource_arg_unique_id();
+  for (int i = 0; i < static_cast<int>(kept.size()); ++i) {
+    if (const auto* attr = gtl::FindOrNull(fdef.arg_attr(), kept[i])) {
+      (*projected.mutable_arg_attr())[i] = *attr;
+    }
+    if (const auto* id = gtl::FindOrNull(fdef.resource_arg_unique_id(),
+                                         kept[i])) {
+      (*projected.mutable_resource_arg_unique_id())[i] = *id;
+    }
+  }
+  return projected;
+}
+
+}  // namespace
+
+Status ParseExampleProjection::OptimizeAndCollectStats(
+    Cluster* cluster, const GrapplerItem& item, GraphDef* output,
+    OptimizationStats* stats) {
+  *output = item.graph;
+  MutableGraphView graph(output);
+  FunctionLibraryDefinition function_library(OpRegistry::Global(),
+                                             item.graph.library());
+  const absl::flat_hash_set<string> fetch(item.fetch.begin(),
+                                          item.fetch.end());
+  absl::flat_hash_set<string> nodes_to_delete;
+
+  for (const NodeDef& node : item.graph.node()) {
+    if (!IsParseExampleNode(node) || fetch.contains(node.name())) continue;
+    NodeDef* parse_node = graph.GetNode(node.name());
+
+    // The parsed features must be consumed by exactly one map transformation.
+    const auto fanouts =
+        graph.GetFanouts(*parse_node, /*include_controlled_nodes=*/true);
+    if (fanouts.size() != 1) continue;
+    const MutableGraphView::InputPort& fanout = *fanouts.begin();
+    if (fanout.port_id != 0 || !IsMapNode(*fanout.node)) continue;
+    const NodeDef& map_node = *fanout.node;
+    if (fetch.contains(map_node.name())) continue;
+
+    const FunctionDef* fdef =
+        function_library.Find(map_node.attr().at(kFuncAttr).func().name());
+    if (fdef == nullptr) continue;
+    const std::vector<Feature> features = GetFeaturesInOutputOrder(*parse_node);
+    const int num_outputs =
+        parse_node->attr().at(kOutputTypes).list().type_size();
+    const int num_captured =
+        map_node.attr().at(kTargumentsAttr).list().type_size();
+    if (static_cast<int>(features.size()) != num_outputs ||
+        fdef->signature().input_arg_size() != num_outputs + num_captured) {
+      continue;
+    }
+
+    const absl::flat_hash_set<string> used_inputs = GetUsedInputs(*fdef);
+    std::vector<int> kept_outputs;
+    std::vector<int> removed_outputs;
+    for (int i = 0; i < num_outputs; ++i) {
+      const bool used =
+          used_inputs.contains(fdef->signature().input_arg(i).name());
+      const bool removable =
+          !used && (features[i].kind != FeatureKind::kDense ||
+                    DenseFeatureHasDefault(*parse_node, features[i].index,
+                                           graph));
+      if (removable) {
+        removed_outputs.push_back(i);
+      } else {
+        kept_outputs.push_back(i);
+      }
+    }
+    if (removed_outputs.empty()) continue;
+    // A dataset has at least one component, so keep the first feature if none
+    // of them is used.
+    if (kept_outputs.empty()) {
+      kept_outputs.push_back(removed_outputs.front());
+      removed_outputs.erase(removed_outputs.begin());
+      if (removed_outputs.empty()) continue;
+    }
+
+    FunctionDef projected_function = MakeProjectedFunction(
+        *fdef, removed_outputs, output->library());
+    NodeDef* projected_parse = graph.AddNode(
+        MakeProjectedParseNode(*parse_node, features, kept_outputs, &graph));
+
+    NodeDef projected_map = map_node;
+    graph_utils::SetUniqueGraphNodeName(map_node.op(), graph.graph(),
+                                        &projected_map);
+    projected_map.set_input(0, projected_parse->name());
+    (*projected_map.mutable_attr())[kFuncAttr].mutable_func()->set_name(
+        projected_function.signature().name());
+    NodeDef* projected_map_node = graph.AddNode(std::move(projected_map));
+
+    TF_RETURN_IF_ERROR(
+        graph.UpdateFanouts(map_node.name(), projected_map_node->name()));
+    TF_RETURN_IF_ERROR(function_library.AddFunctionDef(projected_function));
+    *output->mutable_library()->add_function() = std::move(projected_function);
+    nodes_to_delete.insert(map_node.name());
+    nodes_to_delete.insert(parse_node->name());
+    stats->num_changes++;
+  }
+
+  TF_RETURN_IF_ERROR(graph.DeleteNodes(nodes_to_delete));
+  return OkStatus();
+}
+
+REGISTER_GRAPH_OPTIMIZER_AS(ParseExampleProjection,
+                            "parse_example_projection");
+
+}  // namespace grappler
+}  // namespace tensorflow
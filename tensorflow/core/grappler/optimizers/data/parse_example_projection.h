@@ -0,0 +1,54 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_DATA_PARSE_EXAMPLE_PROJECTION_H_
+#define TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_DATA_PARSE_EXAMPLE_PROJECTION_H_
+
+#include "tensorflow/core/grappler/optimizers/data/optimizer_base.h"
+
+namespace tensorflow {
+namespace grappler {
+
+// This optimization pushes the projection of a `map` transformation down into
+// the `ParseExampleDataset` that feeds it: features whose components are not
+// read by the map function are removed from the parsing configuration, and the
+// corresponding arguments are removed from the map function. The parser then
+// skips the serialized payload of these features instead of decoding them.
+//
+// Dense features without a default value are kept, so that examples missing
+// them are still rejected.
+class ParseExampleProjection : public TFDataOptimizerBase {
+ public:
+  ParseExampleProjection() = default;
+  ~ParseExampleProjection() override = default;
+
+  string name() const override { return "parse_example_projection"; };
+
+  bool UsesFunctionLibrary() const override { return false; }
+
+  Status Init(
+      const tensorflow::RewriterConfig_CustomGraphOptimizer* config) override {
+    return OkStatus();
+  }
+
+  Status OptimizeAndCollectStats(Cluster* cluster, const GrapplerItem& item,
+                                 GraphDef* output,
+                                 OptimizationStats* stats) override;
+};
+
+}  // namespace grappler
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_DATA_PARSE_EXAMPLE_PROJECTION_H_
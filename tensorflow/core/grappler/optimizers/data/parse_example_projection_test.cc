@@ -0,0 +1,241 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/data/parse_example_projection.h"
+
+#include "tensorflow/core/framework/attr_value_util.h"
+#include "tensorflow/core/framework/function_testlib.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/optimizers/data/graph_utils.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace {
+
+using test::function::NDef;
+
+constexpr char kParseExampleDataset[] = "ParseExampleDatasetV2";
+constexpr char kMapDataset[] = "MapDataset";
+
+// Creates a ParseExampleDatasetV2 node parsing the dense features "a"
+// (float, with default) and "b" (int64, with the default `b_default`) and the
+// sparse feature "c" (string). Its output components are sorted by key.
+NodeDef MakeParseNode(StringPiece name, StringPiece input_node_name,
+                      StringPiece b_default) {
+  return NDef(name, kParseExampleDataset,
+              {string(input_node_name), "num_parallel_calls", "a_default",
+               string(b_default)},
+              {{"dense_keys", gtl::ArraySlice<tstring>{"a", "b"}},
+               {"Tdense", gtl::ArraySlice<DataType>{DT_FLOAT, DT_INT64}},
+               {"dense_shapes", gtl::ArraySlice<TensorShape>{{1}, {1}}},
+               {"sparse_keys", gtl::ArraySlice<tstring>{"c"}},
+               {"sparse_types", gtl::ArraySlice<DataType>{DT_STRING}},
+               {"ragged_keys", gtl::ArraySlice<tstring>{}},
+               {"ragged_value_types", gtl::ArraySlice<DataType>{}},
+               {"ragged_split_types", gtl::ArraySlice<DataType>{}},
+               {"output_types",
+                gtl::ArraySlice<DataType>{DT_FLOAT, DT_INT64, DT_VARIANT}},
+               {"output_shapes",
+                gtl::ArraySlice<PartialTensorShape>{{-1, 1}, {-1, 1}, {-1, 3}}},
+               {"deterministic", "default"}});
+}
+
+NodeDef MakeMapNode(StringPiece name, StringPiece input_node_name,
+                    StringPiece function_name,
+                    const std::vector<string>& captured_inputs = {},
+                    const DataTypeVector& captured_types = {}) {
+  std::vector<string> inputs = {string(input_node_name)};
+  inputs.insert(inputs.end(), captured_inputs.begin(), captured_inputs.end());
+  return NDef(name, kMapDataset, inputs,
+              {{"f", FunctionDefHelper::FunctionRef(string(function_name))},
+               {"Targuments", captured_types},
+               {"output_shapes", gtl::ArraySlice<PartialTensorShape>{{-1, 1}}},
+               {"output_types", gtl::ArraySlice<DataType>{DT_INT64}}});
+}
+
+// Returns a function of the parsed features which only reads feature "b".
+FunctionDef ReturnB() {
+  return FunctionDefHelper::Create(
+      "ReturnB", {"a: float", "b: int64", "c: variant"}, {"out: int64"}, {},
+      {{{"y"}, "Identity", {"b"}, {{"T", DT_INT64}}}}, {{"out", "y:output:0"}});
+}
+
+// Returns a function of the parsed features and a captured input which reads
+// features "b" and "c" and the captured input.
+FunctionDef AddCapturedToB() {
+  return FunctionDefHelper::Create(
+      "AddCapturedToB",
+      {"a: float", "b: int64", "c: variant", "captured: int64"},
+      {"out: int64"}, {},
+      {{{"y"}, "Add", {"b", "captured"}, {{"T", DT_INT64}}},
+       {{"c_identity"}, "Identity", {"c"}, {{"T", DT_VARIANT}}}},
+      {{"out", "y:z:0"}});
+}
+
+// Returns the nodes feeding the parse node, with `b_default` as the default
+// value of feature "b".
+std::vector<NodeDef> MakeInputNodes(const Tensor& b_default) {
+  return {
+      NDef("filenames", "Const", {},
+           {{"value", test::AsTensor<tstring>({"a"})}, {"dtype", DT_STRING}}),
+      NDef("records", "TFRecordDataset", {"filenames"}, {}),
+      NDef("num_parallel_calls", "Const", {},
+           {{"value", int64_t{1}}, {"dtype", DT_INT64}}),
+      NDef("a_default", "Const", {},
+           {{"value", test::AsTensor<float>({0.0f})}, {"dtype", DT_FLOAT}}),
+      NDef("b_default", "Const", {},
+           {{"value", b_default}, {"dtype", DT_INT64}}),
+  };
+}
+
+const NodeDef& GetNodeWithOp(StringPiece op, const GraphDef& graph) {
+  const int index = graph_utils::FindGraphNodeWithOp(op, graph);
+  CHECK_NE(index, -1) << "No " << op << " node";
+  return graph.node(index);
+}
+
+const FunctionDef& GetMapFunction(const GraphDef& graph) {
+  const NodeDef& map = GetNodeWithOp(kMapDataset, graph);
+  const int index = graph_utils::FindGraphFunctionWithName(
+      map.attr().at("f").func().name(), graph.library());
+  CHECK_NE(index, -1) << "No map function";
+  return graph.library().function(index);
+}
+
+TEST(ParseExampleProjectionTest, RemovesUnusedFeatures) {
+  GrapplerItem item;
+  std::vector<NodeDef> nodes = MakeInputNodes(test::AsTensor<int64_t>({0}));
+  nodes.push_back(MakeParseNode("parse", "records", "b_default"));
+  nodes.push_back(MakeMapNode("map", "parse", "ReturnB"));
+  nodes.push_back(NDef("Sink", "Identity", {"map"}, {}));
+  item.graph = test::function::GDef(nodes, {ReturnB()});
+  item.fetch.push_back("Sink");
+
+  ParseExampleProjection optimizer;
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  EXPECT_FALSE(graph_utils::ContainsGraphNodeWithName("parse", output));
+  EXPECT_FALSE(graph_utils::ContainsGraphNodeWithName("map", output));
+  const NodeDef& parse = GetNodeWithOp(kParseExampleDataset, output);
+  ASSERT_EQ(parse.attr().at("dense_keys").list().s_size(), 1);
+  EXPECT_EQ(parse.attr().at("dense_keys").list().s(0), "b");
+  ASSERT_EQ(parse.attr().at("Tdense").list().type_size(), 1);
+  EXPECT_EQ(parse.attr().at("Tdense").list().type(0), DT_INT64);
+  EXPECT_EQ(parse.attr().at("dense_shapes").list().shape_size(), 1);
+  EXPECT_EQ(parse.attr().at("sparse_keys").list().s_size(), 0);
+  EXPECT_EQ(parse.attr().at("sparse_types").list().type_size(), 0);
+  ASSERT_EQ(parse.attr().at("output_types").list().type_size(), 1);
+  EXPECT_EQ(parse.attr().at("output_types").list().type(0), DT_INT64);
+  EXPECT_EQ(parse.attr().at("output_shapes").list().shape_size(), 1);
+  ASSERT_EQ(parse.input_size(), 3);
+  EXPECT_EQ(parse.input(0), "records");
+  EXPECT_EQ(parse.input(1), "num_parallel_calls");
+  EXPECT_EQ(parse.input(2), "b_default");
+
+  const NodeDef& map = GetNodeWithOp(kMapDataset, output);
+  EXPECT_EQ(map.input(0), parse.name());
+  const FunctionDef& function = GetMapFunction(output);
+  EXPECT_NE(function.signature().name(), "ReturnB");
+  ASSERT_EQ(function.signature().input_arg_size(), 1);
+  EXPECT_EQ(function.signature().input_arg(0).name(), "b");
+  EXPECT_EQ(GetNodeWithOp("Identity", output).input(0), map.name());
+}
+
+TEST(ParseExampleProjectionTest, KeepsCapturedInputs) {
+  GrapplerItem item;
+  std::vector<NodeDef> nodes = MakeInputNodes(test::AsTensor<int64_t>({0}));
+  nodes.push_back(NDef("captured", "Const", {},
+                       {{"value", int64_t{1}}, {"dtype", DT_INT64}}));
+  nodes.push_back(MakeParseNode("parse", "records", "b_default"));
+  nodes.push_back(MakeMapNode("map", "parse", "AddCapturedToB", {"captured"},
+                              {DT_INT64}));
+  nodes.push_back(NDef("Sink", "Identity", {"map"}, {}));
+  item.graph = test::function::GDef(nodes, {AddCapturedToB()});
+  item.fetch.push_back("Sink");
+
+  ParseExampleProjection optimizer;
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  const NodeDef& parse = GetNodeWithOp(kParseExampleDataset, output);
+  ASSERT_EQ(parse.attr().at("dense_keys").list().s_size(), 1);
+  EXPECT_EQ(parse.attr().at("dense_keys").list().s(0), "b");
+  ASSERT_EQ(parse.attr().at("sparse_keys").list().s_size(), 1);
+  EXPECT_EQ(parse.attr().at("sparse_keys").list().s(0), "c");
+  EXPECT_EQ(parse.attr().at("output_types").list().type_size(), 2);
+
+  const NodeDef& map = GetNodeWithOp(kMapDataset, output);
+  ASSERT_EQ(map.input_size(), 2);
+  EXPECT_EQ(map.input(1), "captured");
+  const FunctionDef& function = GetMapFunction(output);
+  ASSERT_EQ(function.signature().input_arg_size(), 3);
+  EXPECT_EQ(function.signature().input_arg(0).name(), "b");
+  EXPECT_EQ(function.signature().input_arg(1).name(), "c");
+  EXPECT_EQ(function.signature().input_arg(2).name(), "captured");
+}
+
+TEST(ParseExampleProjectionTest, KeepsRequiredDenseFeatures) {
+  GrapplerItem item;
+  // Feature "a" is unused but has no default value, so parsing fails for
+  // examples without it and it must not be removed.
+  std::vector<NodeDef> nodes = MakeInputNodes(test::AsTensor<int64_t>({0}));
+  nodes[3] = NDef("a_default", "Const", {},
+                  {{"value", Tensor(DT_FLOAT, TensorShape({0}))},
+                   {"dtype", DT_FLOAT}});
+  nodes.push_back(MakeParseNode("parse", "records", "b_default"));
+  nodes.push_back(MakeMapNode("map", "parse", "ReturnB"));
+  nodes.push_back(NDef("Sink", "Identity", {"map"}, {}));
+  item.graph = test::function::GDef(nodes, {ReturnB()});
+  item.fetch.push_back("Sink");
+
+  ParseExampleProjection optimizer;
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  const NodeDef& parse = GetNodeWithOp(kParseExampleDataset, output);
+  ASSERT_EQ(parse.attr().at("dense_keys").list().s_size(), 2);
+  EXPECT_EQ(parse.attr().at("sparse_keys").list().s_size(), 0);
+  ASSERT_EQ(parse.input_size(), 4);
+  const FunctionDef& function = GetMapFunction(output);
+  ASSERT_EQ(function.signature().input_arg_size(), 2);
+  EXPECT_EQ(function.signature().input_arg(0).name(), "a");
+  EXPECT_EQ(function.signature().input_arg(1).name(), "b");
+}
+
+TEST(ParseExampleProjectionTest, NoChangeWhenParseHasOtherConsumers) {
+  GrapplerItem item;
+  std::vector<NodeDef> nodes = MakeInputNodes(test::AsTensor<int64_t>({0}));
+  nodes.push_back(MakeParseNode("parse", "records", "b_default"));
+  nodes.push_back(MakeMapNode("map", "parse", "ReturnB"));
+  nodes.push_back(NDef("Sink", "Identity", {"map"}, {}));
+  nodes.push_back(NDef("OtherSink", "Identity", {"parse"}, {}));
+  item.graph = test::function::GDef(nodes, {ReturnB()});
+  item.fetch = {"Sink", "OtherSink"};
+
+  ParseExampleProjection optimizer;
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+  EXPECT_TRUE(graph_utils::ContainsGraphNodeWithName("parse", output));
+  EXPECT_TRUE(graph_utils::ContainsGraphNodeWithName("map", output));
+  EXPECT_EQ(output.library().function_size(), 1);
+}
+
+}  // namespace
+}  // namespace grappler
+}  // namespace tensorflow
@@ -19,10 +19,15 @@ limitations under the License.
 #include <utility>
 #include <vector>
 
+#include "absl/container/flat_hash_map.h"
+#include "tensorflow/core/data/hash_utils.h"
 #include "tensorflow/core/data/name_utils.h"
 #include "tensorflow/core/data/serialization_utils.h"
 #include "tensorflow/core/framework/dataset.h"
 #include "tensorflow/core/framework/dataset_options.pb.h"
+#include "tensorflow/core/framework/function.pb.h"
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/framework/op.h"
 #include "tensorflow/core/framework/partial_tensor_shape.h"
 #include "tensorflow/core/framework/resource_mgr.h"
 #include "tensorflow/core/framework/tensor.h"
@@ -46,6 +51,7 @@ namespace data {
 /* static */ constexpr const char* const CacheDatasetOp::kFileName;
 /* static */ constexpr const char* const CacheDatasetOp::kOutputTypes;
 /* static */ constexpr const char* const CacheDatasetOp::kOutputShapes;
+/* static */ constexpr const char* const CacheDatasetOp::kSharedCache;
 
 namespace {
 
@@ -59,6 +65,8 @@ constexpr char kCurIndex[] = "cur_index";
 constexpr char kShardId[] = "shard_id";
 constexpr char kCreatedAt[] = "Created at";
 constexpr char kMemoryDatasetPrefix[] = "Memory";
+constexpr char kSharedMemoryDatasetPrefix[] = "SharedMemory";
+constexpr char kInputIndex[] = "input_index";
 constexpr char kMemoryCache[] = "MemoryCache";
 constexpr char kCacheCompleted[] = "cache_completed";
 constexpr char kIndex[] = "index";
@@ -70,6 +78,126 @@ constexpr char kIncompleteCacheErrorMessage[] =
     "contents of the dataset  will be discarded. This can happen if you have "
     "an input pipeline similar to `dataset.cache().take(k).repeat()`. You "
     "should use `dataset.take(k).cache().repeat()` instead.";
+
+// Returns the value of the scalar constant that the node input `input` refers
+// to, or an error if it is not a constant.
+Status GetConstantInput(
+    const absl::flat_hash_map<absl::string_view, const NodeDef*>& nodes,
+    const std::string& input, Tensor* value) {
+  auto it = nodes.find(input.substr(0, input.find(':')));
+  if (it == nodes.end() || it->second->op() != "Const" ||
+      !value->FromProto(it->second->attr().at("value").tensor()) ||
+      value->NumElements() != 1) {
+    return errors::FailedPrecondition("Input ", input, " is not a constant.");
+  }
+  return OkStatus();
+}
+
+// Returns an error if `node` may produce different outputs when it is run
+// again, or (if it is a dataset) may produce its elements in a different
+// order. `nodes` are the nodes of the graph of `node`, or null if `node` is in
+// a function.
+Status CheckNodeIsDeterministic(
+    const NodeDef& node,
+    const absl::flat_hash_map<absl::string_view, const NodeDef*>* nodes) {
+  const OpDef* op_def;
+  if (!OpRegistry::Global()->LookUpOpDef(node.op(), &op_def).ok()) {
+    // Calls of library functions, which are checked separately.
+    return OkStatus();
+  }
+  bool attr_value;
+  if ((TryGetNodeAttr(node, "reshuffle_each_iteration", &attr_value) &&
+       attr_value) ||
+      (TryGetNodeAttr(node, "rerandomize_each_iteration", &attr_value) &&
+       attr_value)) {
+    return errors::FailedPrecondition(node.op(),
+                                      " is randomized in each iteration.");
+  }
+  std::string deterministic;
+  if ((TryGetNodeAttr(node, "deterministic", &deterministic) &&
+       deterministic != "true") ||
+      (TryGetNodeAttr(node, "sloppy", &attr_value) && attr_value)) {
+    return errors::FailedPrecondition(
+        node.op(), " is not guaranteed to be deterministic.");
+  }
+  if (op_def->is_stateful() && !DatasetOpKernel::IsDatasetOp(*op_def)) {
+    return errors::FailedPrecondition(node.op(), " is stateful.");
+  }
+  // Check the scalar inputs that determine the randomness of datasets. If the
+  // inputs before them are single tensors, the index of their argument is the
+  // index of their input.
+  bool has_seeds = false;
+  bool has_seed_generator = false;
+  bool seeded = false;
+  bool single_tensor_inputs = true;
+  for (int i = 0; i < op_def->input_arg_size(); ++i) {
+    const OpDef::ArgDef& arg_def = op_def->input_arg(i);
+    const std::string& arg = arg_def.name();
+    if (arg == "seed_generator") {
+      has_seed_generator = true;
+    }
+    if (arg != "seed" && arg != "seed2" && arg != "sloppy") {
+      single_tensor_inputs &= arg_def.number_attr().empty() &&
+                              arg_def.type_list_attr().empty();
+      continue;
+    }
+    Tensor value;
+    if (nodes == nullptr || !single_tensor_inputs || i >= node.input_size() ||
+        !GetConstantInput(*nodes, node.input(i), &value).ok()) {
+      return errors::FailedPrecondition(node.op(), " has a non-constant ", arg,
+                                        " input.");
+    }
+    if (arg == "sloppy") {
+      if (value.dtype() == DT_BOOL && value.flat<bool>()(0)) {
+        return errors::FailedPrecondition(
+            node.op(), " is not guaranteed to be deterministic.");
+      }
+      continue;
+    }
+    has_seeds = true;
+    if (value.dtype() != DT_INT64 || value.flat<int64_t>()(0) != 0) {
+      seeded = true;
+    }
+  }
+  if ((has_seeds || has_seed_generator) && !seeded) {
+    return errors::FailedPrecondition(node.op(), " is not seeded.");
+  }
+  return OkStatus();
+}
+
+// Returns an error if the dataset of `graph_def` may produce different elements,
+// or its elements in a different order, when it is iterated again.
+Status CheckDatasetIsDeterministic(const GraphDef& graph_def) {
+  absl::flat_hash_map<absl::string_view, const NodeDef*> nodes;
+  for (const NodeDef& node : graph_def.node()) {
+    nodes[node.name()] = &node;
+  }
+  for (const NodeDef& node : graph_def.node()) {
+    TF_RETURN_IF_ERROR(CheckNodeIsDeterministic(node, &nodes));
+  }
+  for (const FunctionDef& function : graph_def.library().function()) {
+    for (const NodeDef& node : function.node_def()) {
+      TF_RETURN_IF_ERROR(CheckNodeIsDeterministic(node, /*nodes=*/nullptr));
+    }
+  }
+  return OkStatus();
+}
+
+// Computes the fingerprint of `dataset`, which identifies the elements it
+// produces. Fails if the dataset depends on external state, or if it may
+// produce different elements or a different order of elements when it is
+// iterated again, in which case the blocks of elements that different
+// iterators cache would not make up the same sequence.
+Status FingerprintDataset(OpKernelContext* ctx, const DatasetBase* dataset,
+                          uint64* fingerprint) {
+  GraphDef graph_def;
+  SerializationContext::Params params(ctx);
+  params.external_state_policy = ExternalStatePolicy::POLICY_FAIL;
+  TF_RETURN_IF_ERROR(
+      AsGraphDef(dataset, SerializationContext(params), &graph_def));
+  TF_RETURN_IF_ERROR(CheckDatasetIsDeterministic(graph_def));
+  return HashGraph(graph_def, fingerprint);
+}
 }  // namespace
 
 class PartialCache {
@@ -1108,15 +1236,236 @@ class CacheDatasetOp::MemoryDatasetV2
   ResourceMgr* const resource_mgr_;  // Not owned.
 };
 
+// This version of memory dataset caches elements in the process-wide
+// `SharedMemoryCache`, keyed by the fingerprint of the input dataset. It
+// supports sharing of the cache across different iterators of all datasets with
+// the same fingerprint, and only reads the input for the blocks of elements
+// that are not cached.
+class CacheDatasetOp::SharedMemoryDataset : public DatasetBase {
+ public:
+  SharedMemoryDataset(OpKernelContext* ctx, const DatasetBase* input,
+                      SharedMemoryCache* cache, uint64 fingerprint,
+                      int op_version)
+      : DatasetBase(DatasetContext(ctx)),
+        input_(input),
+        cache_(cache),
+        fingerprint_(fingerprint),
+        op_version_(op_version),
+        resource_handle_(op_version == 2 ? ctx->input(2) : Tensor()) {
+    input_->Ref();
+  }
+
+  ~SharedMemoryDataset() override { input_->Unref(); }
+
+  std::unique_ptr<IteratorBase> MakeIteratorInternal(
+      const string& prefix) const override {
+    name_utils::IteratorPrefixParams params;
+    params.dataset_prefix = kSharedMemoryDatasetPrefix;
+    return std::make_unique<Iterator>(Iterator::Params{
+        this, name_utils::IteratorPrefix(kDatasetType, prefix, params)});
+  }
+
+  const DataTypeVector& output_dtypes() const override {
+    return input_->output_dtypes();
+  }
+
+  const std::vector<PartialTensorShape>& output_shapes() const override {
+    return input_->output_shapes();
+  }
+
+  string DebugString() const override {
+    name_utils::DatasetDebugStringParams params;
+    params.dataset_prefix = kSharedMemoryDatasetPrefix;
+    return name_utils::DatasetDebugString(kDatasetType, params);
+  }
+
+  int64_t CardinalityInternal(CardinalityOptions options) const override {
+    return input_->Cardinality(options);
+  };
+
+  Status InputDatasets(std::vector<const DatasetBase*>* inputs) const override {
+    inputs->push_back(input_);
+    return OkStatus();
+  }
+
+  Status CheckExternalState() const override {
+    return input_->CheckExternalState();
+  }
+
+ protected:
+  Status AsGraphDefInternal(SerializationContext* ctx,
+                            DatasetGraphDefBuilder* b,
+                            Node** output) const override {
+    Node* input_node = nullptr;
+    TF_RETURN_IF_ERROR(b->AddInputDataset(ctx, input_, &input_node));
+    Node* filename_node = nullptr;
+    TF_RETURN_IF_ERROR(b->AddScalar(tstring(""), &filename_node));
+    std::vector<Node*> inputs = {input_node, filename_node};
+    if (op_version_ == 2) {
+      Node* resource_handle_node = nullptr;
+      TF_RETURN_IF_ERROR(b->AddTensor(resource_handle_, &resource_handle_node));
+      inputs.push_back(resource_handle_node);
+    }
+    AttrValue shared_cache;
+    b->BuildAttrValue(true, &shared_cache);
+    TF_RETURN_IF_ERROR(
+        b->AddDataset(this, inputs, {{kSharedCache, shared_cache}}, output));
+    return OkStatus();
+  }
+
+ private:
+  class Iterator : public DatasetIterator<SharedMemoryDataset> {
+   public:
+    explicit Iterator(const Params& params)
+        : DatasetIterator<SharedMemoryDataset>(params) {}
+
+    Status GetNextInternal(IteratorContext* ctx,
+                           std::vector<Tensor>* out_tensors,
+                           bool* end_of_sequence) override {
+      mutex_lock l(mu_);
+      SharedMemoryCache* cache = dataset()->cache_;
+      const int64_t block_index = index_ / cache->block_size();
+      if (!block_ || block_index_ != block_index) {
+        block_ = cache->Lookup(dataset()->fingerprint_, block_index);
+        if (!block_) {
+          TF_RETURN_IF_ERROR(ReadBlock(ctx, block_index));
+          cache->Insert(dataset()->fingerprint_, block_index, block_);
+        }
+        block_index_ = block_index;
+      }
+      const int64_t offset = index_ - block_index * cache->block_size();
+      if (offset >= static_cast<int64_t>(block_->elements.size())) {
+        DCHECK(block_->end_of_sequence);
+        *end_of_sequence = true;
+        return OkStatus();
+      }
+      const std::vector<Tensor>& element = block_->elements[offset];
+      out_tensors->insert(out_tensors->begin(), element.begin(), element.end());
+      ++index_;
+      *end_of_sequence = false;
+      return OkStatus();
+    }
+
+   protected:
+    std::shared_ptr<model::Node> CreateNode(
+        IteratorContext* ctx, model::Node::Args args) const override {
+      return model::MakeKnownRatioNode(std::move(args),
+                                       /*ratio=*/1);
+    }
+
+    Status SaveInternal(SerializationContext* ctx,
+                        IteratorStateWriter* writer) override {
+      mutex_lock l(mu_);
+      TF_RETURN_IF_ERROR(writer->WriteScalar(full_name(kIndex), index_));
+      if (input_impl_) {
+        TF_RETURN_IF_ERROR(
+            writer->WriteScalar(full_name(kInputIndex), input_index_));
+        TF_RETURN_IF_ERROR(SaveInput(ctx, writer, input_impl_));
+      }
+      return OkStatus();
+    }
+
+    Status RestoreInternal(IteratorContext* ctx,
+                           IteratorStateReader* reader) override {
+      mutex_lock l(mu_);
+      block_.reset();
+      input_impl_.reset();
+      TF_RETURN_IF_ERROR(reader->ReadScalar(full_name(kIndex), &index_));
+      if (reader->Contains(full_name(kInputIndex))) {
+        TF_RETURN_IF_ERROR(
+            reader->ReadScalar(full_name(kInputIndex), &input_index_));
+        TF_RETURN_IF_ERROR(dataset()->input_->MakeIterator(
+            ctx, this, prefix(), &input_impl_));
+        TF_RETURN_IF_ERROR(RestoreInput(ctx, reader, input_impl_));
+      }
+      return OkStatus();
+    }
+
+   private:
+    // Reads the elements of the given block from the input into `block_`. The
+    // input iterator is created on the first cache miss, and skips the
+    // elements of the blocks that were read from the cache.
+    Status ReadBlock(IteratorContext* ctx, int64_t block_index)
+        TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      const int64_t block_size = dataset()->cache_->block_size();
+      const int64_t start = block_index * block_size;
+      if (!input_impl_ || input_index_ > start) {
+        TF_RETURN_IF_ERROR(dataset()->input_->MakeIterator(
+            ctx, this, prefix(), &input_impl_));
+        input_index_ = 0;
+      }
+      auto block = std::make_shared<SharedMemoryCache::Block>();
+      while (input_index_ < start) {
+        int num_skipped;
+        TF_RETURN_IF_ERROR(input_impl_->Skip(
+            ctx, static_cast<int>(std::min<int64_t>(start - input_index_,
+                                                    kint32max)),
+            &block->end_of_sequence, &num_skipped));
+        input_index_ += num_skipped;
+        if (block->end_of_sequence) {
+          block_ = std::move(block);
+          return OkStatus();
+        }
+      }
+      while (static_cast<int64_t>(block->elements.size()) < block_size) {
+        std::vector<Tensor> element;
+        TF_RETURN_IF_ERROR(
+            input_impl_->GetNext(ctx, &element, &block->end_of_sequence));
+        if (block->end_of_sequence) {
+          break;
+        }
+        ++input_index_;
+        block->size_bytes += GetTotalBytes(element);
+        block->elements.push_back(std::move(element));
+      }
+      block_ = std::move(block);
+      return OkStatus();
+    }
+
+    mutex mu_;
+    // The index of the next element to produce.
+    int64_t index_ TF_GUARDED_BY(mu_) = 0;
+    // The block containing the next element, and its index.
+    std::shared_ptr<const SharedMemoryCache::Block> block_ TF_GUARDED_BY(mu_);
+    int64_t block_index_ TF_GUARDED_BY(mu_) = 0;
+    // The input iterator, and the index of its next element.
+    std::unique_ptr<IteratorBase> input_impl_ TF_GUARDED_BY(mu_);
+    int64_t input_index_ TF_GUARDED_BY(mu_) = 0;
+  };
+
+  const DatasetBase* const input_;
+  SharedMemoryCache* const cache_;  // Not owned.
+  const uint64 fingerprint_;
+  const int op_version_;
+  const Tensor resource_handle_;
+};
+
 CacheDatasetOp::CacheDatasetOp(OpKernelConstruction* ctx)
     : UnaryDatasetOpKernel(ctx),
-      op_version_(ctx->def().op() == kCacheDataset ? 1 : 2) {}
+      op_version_(ctx->def().op() == kCacheDataset ? 1 : 2) {
+  if (ctx->HasAttr(kSharedCache)) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr(kSharedCache, &shared_cache_));
+  }
+}
 
 void CacheDatasetOp::MakeDataset(OpKernelContext* ctx, DatasetBase* input,
                                  DatasetBase** output) {
   // Parse out the filenames tensor.
   tstring filename;
   OP_REQUIRES_OK(ctx, ParseScalarArgument<tstring>(ctx, kFileName, &filename));
+  if (filename.empty() && shared_cache_) {
+    uint64 fingerprint;
+    Status s = FingerprintDataset(ctx, input, &fingerprint);
+    if (s.ok()) {
+      *output = new SharedMemoryDataset(ctx, input, SharedMemoryCache::Global(),
+                                        fingerprint, op_version_);
+      return;
+    }
+    LOG(WARNING) << "The input of " << ctx->op_kernel().name()
+                 << " cannot be cached in the shared cache, and will be cached "
+                    "for each iterator instead: "
+                 << s;
+  }
   if (filename.empty()) {
     static std::atomic<int64_t> resource_id_counter(0);
     const string& container = ctx->resource_manager()->default_container();
@@ -30,6 +30,7 @@ class CacheDatasetOp : public UnaryDatasetOpKernel {
   static constexpr const char* const kFileName = "filename";
   static constexpr const char* const kOutputTypes = "output_types";
   static constexpr const char* const kOutputShapes = "output_shapes";
+  static constexpr const char* const kSharedCache = "shared_cache";
 
   explicit CacheDatasetOp(OpKernelConstruction* ctx);
 
@@ -42,8 +43,10 @@ class CacheDatasetOp : public UnaryDatasetOpKernel {
   class FileDatasetV2;
   class MemoryDataset;
   class MemoryDatasetV2;
+  class SharedMemoryDataset;
 
   const int op_version_;
+  bool shared_cache_ = false;
 };
 
 }  // namespace data
@@ -17,15 +17,23 @@ limitations under the License.
 #include "tensorflow/core/data/dataset_test_base.h"
 #include "tensorflow/core/data/dataset_utils.h"
 #include "tensorflow/core/data/serialization_utils.h"
+#include "tensorflow/core/kernels/data/shuffle_dataset_op.h"
+#include "tensorflow/core/kernels/data/tf_record_dataset_op.h"
+#include "tensorflow/core/lib/io/record_writer.h"
+#include "tensorflow/core/lib/monitoring/cell_reader.h"
 #include "tensorflow/core/platform/path.h"
+#include "tensorflow/tsl/lib/io/record_index.h"
 
 namespace tensorflow {
 namespace data {
 namespace {
 
+using ::tensorflow::monitoring::testing::CellReader;
+
 constexpr char kNodeName[] = "cache_dataset";
 constexpr char kFileDatasetPrefix[] = "File";
 constexpr char kMemoryDatasetPrefix[] = "Memory";
+constexpr char kSharedMemoryDatasetPrefix[] = "SharedMemory";
 
 class CacheDatasetParams : public DatasetParams {
  public:
@@ -33,10 +41,11 @@ class CacheDatasetParams : public DatasetParams {
   CacheDatasetParams(T input_dataset_params, string filename,
                      DataTypeVector output_dtypes,
                      std::vector<PartialTensorShape> output_shapes,
-                     string node_name)
+                     string node_name, bool shared_cache = false)
       : DatasetParams(std::move(output_dtypes), std::move(output_shapes),
                       std::move(node_name)),
-        filename_(filename) {
+        filename_(filename),
+        shared_cache_(shared_cache) {
     input_dataset_params_.push_back(std::make_unique<T>(input_dataset_params));
     iterator_prefix_ =
         name_utils::IteratorPrefix(input_dataset_params.dataset_type(),
@@ -57,7 +66,8 @@ class CacheDatasetParams : public DatasetParams {
   Status GetAttributes(AttributeVector* attr_vector) const override {
     *attr_vector = {{"output_types", output_dtypes_},
                     {"output_shapes", output_shapes_},
-                    {"metadata", ""}};
+                    {"metadata", ""},
+                    {"shared_cache", shared_cache_}};
     return OkStatus();
   }
 
@@ -65,8 +75,64 @@ class CacheDatasetParams : public DatasetParams {
 
   string filename() const { return filename_; }
 
+  bool shared_cache() const { return shared_cache_; }
+
  private:
   string filename_;
+  bool shared_cache_;
+};
+
+class ShuffleDatasetParams : public DatasetParams {
+ public:
+  template <typename T>
+  ShuffleDatasetParams(T input_dataset_params, int64_t buffer_size,
+                       int64_t seed, int64_t seed2,
+                       bool reshuffle_each_iteration,
+                       DataTypeVector output_dtypes,
+                       std::vector<PartialTensorShape> output_shapes,
+                       string node_name)
+      : DatasetParams(std::move(output_dtypes), std::move(output_shapes),
+                      std::move(node_name)),
+        buffer_size_(buffer_size),
+        seed_(seed),
+        seed2_(seed2),
+        reshuffle_each_iteration_(reshuffle_each_iteration) {
+    input_dataset_params_.push_back(std::make_unique<T>(input_dataset_params));
+    iterator_prefix_ =
+        name_utils::IteratorPrefix(input_dataset_params.dataset_type(),
+                                   input_dataset_params.iterator_prefix());
+  }
+
+  std::vector<Tensor> GetInputTensors() const override {
+    return {CreateTensor<int64_t>(TensorShape({}), {buffer_size_}),
+            CreateTensor<int64_t>(TensorShape({}), {seed_}),
+            CreateTensor<int64_t>(TensorShape({}), {seed2_})};
+  }
+
+  Status GetInputNames(std::vector<string>* input_names) const override {
+    *input_names = {ShuffleDatasetOpBase::kInputDataset,
+                    ShuffleDatasetOpBase::kBufferSize,
+                    ShuffleDatasetOpBase::kSeed, ShuffleDatasetOpBase::kSeed2};
+    return OkStatus();
+  }
+
+  Status GetAttributes(AttributeVector* attr_vector) const override {
+    *attr_vector = {{"output_types", output_dtypes_},
+                    {"output_shapes", output_shapes_},
+                    {"reshuffle_each_iteration", reshuffle_each_iteration_},
+                    {"metadata", ""}};
+    return OkStatus();
+  }
+
+  string dataset_type() const override {
+    return ShuffleDatasetOp::kDatasetType;
+  }
+
+ private:
+  int64_t buffer_size_;
+  int64_t seed_;
+  int64_t seed2_;
+  bool reshuffle_each_iteration_;
 };
 
 class CacheDatasetOpTest : public DatasetOpsTestBase {
@@ -75,6 +141,7 @@ class CacheDatasetOpTest : public DatasetOpsTestBase {
     TF_RETURN_IF_ERROR(DatasetOpsTestBase::Initialize(dataset_params));
     auto params = static_cast<const CacheDatasetParams&>(dataset_params);
     cache_filename_ = params.filename();
+    shared_cache_ = params.shared_cache();
     return OkStatus();
   }
 
@@ -98,6 +165,7 @@ class CacheDatasetOpTest : public DatasetOpsTestBase {
 
  protected:
   tstring cache_filename_;
+  bool shared_cache_ = false;
 };
 
 // Test case 1: cache data in file.
@@ -150,6 +218,31 @@ CacheDatasetParams CacheDatasetParams4() {
                             kNodeName);
 }
 
+// Test case 5: cache data in the shared memory cache.
+CacheDatasetParams CacheDatasetParams5() {
+  auto tensor_slice_dataset_params = TensorSliceDatasetParams(
+      /*components=*/{CreateTensor<int64_t>(TensorShape{3, 3, 1},
+                                            {0, 1, 2, 3, 4, 5, 6, 7, 8})},
+      /*node_name=*/"tensor_slice");
+  return CacheDatasetParams(std::move(tensor_slice_dataset_params),
+                            /*filename=*/"",
+                            /*output_dtypes=*/{DT_INT64},
+                            /*output_shapes=*/{PartialTensorShape({3, 1})},
+                            kNodeName, /*shared_cache=*/true);
+}
+
+// Test case 6: cache empty data in the shared memory cache.
+CacheDatasetParams CacheDatasetParams6() {
+  auto tensor_slice_dataset_params = TensorSliceDatasetParams(
+      /*components=*/{CreateTensor<int64_t>(TensorShape{0}, {})},
+      /*node_name=*/"tensor_slice");
+  return CacheDatasetParams(std::move(tensor_slice_dataset_params),
+                            /*filename=*/"",
+                            /*output_dtypes=*/{DT_INT64},
+                            /*output_shapes=*/{PartialTensorShape({})},
+                            kNodeName, /*shared_cache=*/true);
+}
+
 std::vector<GetNextTestCase<CacheDatasetParams>> GetNextTestCases() {
   return {{/*dataset_params=*/CacheDatasetParams1(),
            /*expected_outputs=*/
@@ -162,6 +255,12 @@ std::vector<GetNextTestCase<CacheDatasetParams>> GetNextTestCases() {
            CreateTensors<int64_t>(TensorShape({3, 1}),
                                   {{0, 1, 2}, {3, 4, 5}, {6, 7, 8}})},
           {/*dataset_params=*/CacheDatasetParams4(),
+           /*expected_outputs=*/{}},
+          {/*dataset_params=*/CacheDatasetParams5(),
+           /*expected_outputs=*/
+           CreateTensors<int64_t>(TensorShape({3, 1}),
+                                  {{0, 1, 2}, {3, 4, 5}, {6, 7, 8}})},
+          {/*dataset_params=*/CacheDatasetParams6(),
            /*expected_outputs=*/{}}};
 }
 
@@ -247,6 +346,10 @@ std::vector<CardinalityTestCase<CacheDatasetParams>> CardinalityTestCases() {
           {/*dataset_params=*/CacheDatasetParams3(),
            /*expected_cardinality=*/3},
           {/*dataset_params=*/CacheDatasetParams4(),
+           /*expected_cardinality=*/0},
+          {/*dataset_params=*/CacheDatasetParams5(),
+           /*expected_cardinality=*/3},
+          {/*dataset_params=*/CacheDatasetParams6(),
            /*expected_cardinality=*/0}};
 }
 
@@ -286,6 +389,248 @@ TEST_F(CacheDatasetOpTest, IteratorPrefix) {
       iterator_prefix_params)));
 }
 
+TEST_F(CacheDatasetOpTest, SharedMemoryIteratorPrefix) {
+  auto dataset_params = CacheDatasetParams5();
+  TF_ASSERT_OK(Initialize(dataset_params));
+  name_utils::IteratorPrefixParams iterator_prefix_params;
+  iterator_prefix_params.dataset_prefix = kSharedMemoryDatasetPrefix;
+  TF_ASSERT_OK(CheckIteratorPrefix(name_utils::IteratorPrefix(
+      CacheDatasetOp::kDatasetType, dataset_params.iterator_prefix(),
+      iterator_prefix_params)));
+}
+
+TEST_F(CacheDatasetOpTest, SharedMemoryCacheIsSharedAcrossDatasets) {
+  CellReader<int64_t> cell_reader("/tensorflow/data/shared_cache_queries");
+  auto make_dataset_params = []() {
+    auto tensor_slice_dataset_params = TensorSliceDatasetParams(
+        /*components=*/{CreateTensor<int64_t>(TensorShape{4}, {9, 8, 7, 6})},
+        /*node_name=*/"tensor_slice");
+    return CacheDatasetParams(std::move(tensor_slice_dataset_params),
+                              /*filename=*/"",
+                              /*output_dtypes=*/{DT_INT64},
+                              /*output_shapes=*/{PartialTensorShape({})},
+                              kNodeName, /*shared_cache=*/true);
+  };
+  std::vector<Tensor> expected_outputs =
+      CreateTensors<int64_t>(TensorShape({}), {{9}, {8}, {7}, {6}});
+
+  // The first dataset reads its input and populates the cache.
+  TF_ASSERT_OK(Initialize(make_dataset_params()));
+  TF_ASSERT_OK(CheckIteratorGetNext(expected_outputs, /*compare_order=*/true));
+  EXPECT_EQ(cell_reader.Delta("false"), 1);
+  EXPECT_EQ(cell_reader.Delta("true"), 0);
+
+  // A new dataset with the same input reads the elements from the cache.
+  TF_ASSERT_OK(Initialize(make_dataset_params()));
+  TF_ASSERT_OK(CheckIteratorGetNext(expected_outputs, /*compare_order=*/true));
+  EXPECT_EQ(cell_reader.Delta("false"), 0);
+  EXPECT_EQ(cell_reader.Delta("true"), 1);
+}
+
+// Returns the params of a dataset that caches a shuffle of [0, 10) in the
+// shared cache.
+CacheDatasetParams SharedCacheOfShuffleParams(int64_t seed, int64_t seed2,
+                                              bool reshuffle_each_iteration) {
+  auto shuffle_dataset_params = ShuffleDatasetParams(
+      RangeDatasetParams(0, 10, 1), /*buffer_size=*/10, seed, seed2,
+      reshuffle_each_iteration,
+      /*output_dtypes=*/{DT_INT64},
+      /*output_shapes=*/{PartialTensorShape({})},
+      /*node_name=*/"shuffle_dataset");
+  return CacheDatasetParams(std::move(shuffle_dataset_params),
+                            /*filename=*/"",
+                            /*output_dtypes=*/{DT_INT64},
+                            /*output_shapes=*/{PartialTensorShape({})},
+                            kNodeName, /*shared_cache=*/true);
+}
+
+TEST_F(CacheDatasetOpTest, SharedMemoryCacheOfUnseededShuffle) {
+  CellReader<int64_t> cell_reader("/tensorflow/data/shared_cache_queries");
+  auto dataset_params =
+      SharedCacheOfShuffleParams(/*seed=*/0, /*seed2=*/0,
+                                 /*reshuffle_each_iteration=*/false);
+  std::vector<Tensor> expected_outputs = CreateTensors<int64_t>(
+      TensorShape({}), {{0}, {1}, {2}, {3}, {4}, {5}, {6}, {7}, {8}, {9}});
+  // Each dataset shuffles its input differently, so the elements are cached
+  // for each iterator instead of in the shared cache.
+  for (int i = 0; i < 2; ++i) {
+    TF_ASSERT_OK(Initialize(dataset_params));
+    name_utils::IteratorPrefixParams iterator_prefix_params;
+    iterator_prefix_params.dataset_prefix = kMemoryDatasetPrefix;
+    TF_ASSERT_OK(CheckIteratorPrefix(name_utils::IteratorPrefix(
+        CacheDatasetOp::kDatasetType, dataset_params.iterator_prefix(),
+        iterator_prefix_params)));
+    TF_ASSERT_OK(
+        CheckIteratorGetNext(expected_outputs, /*compare_order=*/false));
+  }
+  EXPECT_EQ(cell_reader.Delta("false"), 0);
+  EXPECT_EQ(cell_reader.Delta("true"), 0);
+}
+
+TEST_F(CacheDatasetOpTest, SharedMemoryCacheOfReshuffledInput) {
+  auto dataset_params =
+      SharedCacheOfShuffleParams(/*seed=*/1, /*seed2=*/2,
+                                 /*reshuffle_each_iteration=*/true);
+  TF_ASSERT_OK(Initialize(dataset_params));
+  name_utils::IteratorPrefixParams iterator_prefix_params;
+  iterator_prefix_params.dataset_prefix = kMemoryDatasetPrefix;
+  TF_ASSERT_OK(CheckIteratorPrefix(name_utils::IteratorPrefix(
+      CacheDatasetOp::kDatasetType, dataset_params.iterator_prefix(),
+      iterator_prefix_params)));
+}
+
+TEST_F(CacheDatasetOpTest, SharedMemoryCacheOfSeededShuffle) {
+  CellReader<int64_t> cell_reader("/tensorflow/data/shared_cache_queries");
+  auto dataset_params =
+      SharedCacheOfShuffleParams(/*seed=*/1, /*seed2=*/2,
+                                 /*reshuffle_each_iteration=*/false);
+  TF_ASSERT_OK(Initialize(dataset_params));
+  name_utils::IteratorPrefixParams iterator_prefix_params;
+  iterator_prefix_params.dataset_prefix = kSharedMemoryDatasetPrefix;
+  TF_ASSERT_OK(CheckIteratorPrefix(name_utils::IteratorPrefix(
+      CacheDatasetOp::kDatasetType, dataset_params.iterator_prefix(),
+      iterator_prefix_params)));
+  std::vector<Tensor> first_outputs;
+  bool end_of_sequence = false;
+  while (!end_of_sequence) {
+    std::vector<Tensor> next;
+    TF_ASSERT_OK(
+        iterator_->GetNext(iterator_ctx_.get(), &next, &end_of_sequence));
+    first_outputs.insert(first_outputs.end(), next.begin(), next.end());
+  }
+  // A new dataset with the same seeds reads the same order from the cache.
+  TF_ASSERT_OK(Initialize(dataset_params));
+  TF_ASSERT_OK(CheckIteratorGetNext(first_outputs, /*compare_order=*/true));
+  EXPECT_EQ(cell_reader.Delta("true"), 1);
+}
+
+// Params of a TFRecordDataset that reads indexed files in a random
+// permutation.
+class IndexShuffledTFRecordDatasetParams : public DatasetParams {
+ public:
+  IndexShuffledTFRecordDatasetParams(std::vector<tstring> filenames,
+                                     int64_t index_shuffle_seed,
+                                     bool reshuffle_each_iteration)
+      : DatasetParams({DT_STRING}, {PartialTensorShape({})}, "tf_record"),
+        filenames_(std::move(filenames)),
+        index_shuffle_seed_(index_shuffle_seed),
+        reshuffle_each_iteration_(reshuffle_each_iteration) {}
+
+  std::vector<Tensor> GetInputTensors() const override {
+    return {CreateTensor<tstring>(
+                TensorShape({static_cast<int64_t>(filenames_.size())}),
+                filenames_),
+            CreateTensor<tstring>(TensorShape({}), {""}),
+            CreateTensor<int64_t>(TensorShape({}), {0})};
+  }
+
+  Status GetInputNames(std::vector<string>* input_names) const override {
+    *input_names = {TFRecordDatasetOp::kFileNames,
+                    TFRecordDatasetOp::kCompressionType,
+                    TFRecordDatasetOp::kBufferSize};
+    return OkStatus();
+  }
+
+  Status GetAttributes(AttributeVector* attr_vector) const override {
+    *attr_vector = {
+        {"metadata", ""},
+        {TFRecordDatasetOp::kIndexShuffleSeed, index_shuffle_seed_},
+        {TFRecordDatasetOp::kReshuffleEachIteration,
+         reshuffle_each_iteration_}};
+    return OkStatus();
+  }
+
+  string dataset_type() const override {
+    return TFRecordDatasetOp::kDatasetType;
+  }
+
+ private:
+  std::vector<tstring> filenames_;
+  int64_t index_shuffle_seed_;
+  bool reshuffle_each_iteration_;
+};
+
+// Returns the params of a dataset that caches an index shuffle of 4 indexed
+// TFRecord files of 5 records each in the shared cache.
+CacheDatasetParams SharedCacheOfIndexShuffleParams(
+    bool reshuffle_each_iteration) {
+  std::vector<tstring> filenames;
+  Env* env = Env::Default();
+  for (int i = 0; i < 4; ++i) {
+    filenames.push_back(
+        io::JoinPath(testing::TmpDir(), absl::StrCat("index_shuffle_", i)));
+    std::unique_ptr<WritableFile> file;
+    TF_CHECK_OK(env->NewWritableFile(filenames.back(), &file));
+    std::unique_ptr<WritableFile> index_file;
+    TF_CHECK_OK(env->NewWritableFile(
+        tsl::io::RecordIndexFileName(filenames.back()), &index_file));
+    io::RecordWriterOptions options;
+    options.index_file = index_file.get();
+    io::RecordWriter writer(file.get(), options);
+    for (int j = 0; j < 5; ++j) {
+      TF_CHECK_OK(writer.WriteRecord(absl::StrCat(i, "_", j)));
+    }
+    TF_CHECK_OK(writer.Close());
+    TF_CHECK_OK(file->Close());
+    TF_CHECK_OK(index_file->Close());
+  }
+  return CacheDatasetParams(
+      IndexShuffledTFRecordDatasetParams(std::move(filenames),
+                                         /*index_shuffle_seed=*/7,
+                                         reshuffle_each_iteration),
+      /*filename=*/"",
+      /*output_dtypes=*/{DT_STRING},
+      /*output_shapes=*/{PartialTensorShape({})}, kNodeName,
+      /*shared_cache=*/true);
+}
+
+TEST_F(CacheDatasetOpTest, SharedMemoryCacheOfIndexShuffledTFRecords) {
+  CellReader<int64_t> cell_reader("/tensorflow/data/shared_cache_queries");
+  auto dataset_params =
+      SharedCacheOfIndexShuffleParams(/*reshuffle_each_iteration=*/false);
+  TF_ASSERT_OK(Initialize(dataset_params));
+  name_utils::IteratorPrefixParams iterator_prefix_params;
+  iterator_prefix_params.dataset_prefix = kSharedMemoryDatasetPrefix;
+  TF_ASSERT_OK(CheckIteratorPrefix(name_utils::IteratorPrefix(
+      CacheDatasetOp::kDatasetType, dataset_params.iterator_prefix(),
+      iterator_prefix_params)));
+  std::vector<Tensor> first_outputs;
+  bool end_of_sequence = false;
+  while (!end_of_sequence) {
+    std::vector<Tensor> next;
+    TF_ASSERT_OK(
+        iterator_->GetNext(iterator_ctx_.get(), &next, &end_of_sequence));
+    first_outputs.insert(first_outputs.end(), next.begin(), next.end());
+  }
+  ASSERT_EQ(first_outputs.size(), 20);
+
+  // Every record is cached once, and a new dataset reads the same permutation
+  // from the cache.
+  TF_ASSERT_OK(Initialize(dataset_params));
+  TF_ASSERT_OK(CheckIteratorGetNext(first_outputs, /*compare_order=*/true));
+  std::vector<Tensor> expected_outputs;
+  for (int i = 0; i < 4; ++i) {
+    for (int j = 0; j < 5; ++j) {
+      expected_outputs.push_back(CreateTensor<tstring>(
+          TensorShape({}), {absl::StrCat(i, "_", j)}));
+    }
+  }
+  TF_ASSERT_OK(Initialize(dataset_params));
+  TF_ASSERT_OK(CheckIteratorGetNext(expected_outputs, /*compare_order=*/false));
+  EXPECT_EQ(cell_reader.Delta("true"), 2);
+}
+
+TEST_F(CacheDatasetOpTest, SharedMemoryCacheOfIndexReshuffledTFRecords) {
+  auto dataset_params =
+      SharedCacheOfIndexShuffleParams(/*reshuffle_each_iteration=*/true);
+  TF_ASSERT_OK(Initialize(dataset_params));
+  name_utils::IteratorPrefixParams iterator_prefix_params;
+  iterator_prefix_params.dataset_prefix = kMemoryDatasetPrefix;
+  TF_ASSERT_OK(CheckIteratorPrefix(name_utils::IteratorPrefix(
+      CacheDatasetOp::kDatasetType, dataset_params.iterator_prefix(),
+      iterator_prefix_params)));
+}
+
 std::vector<IteratorSaveAndRestoreTestCase<CacheDatasetParams>>
 IteratorSaveAndRestoreTestCases() {
   return {{/*dataset_params=*/CacheDatasetParams1(),
@@ -302,6 +647,14 @@ IteratorSaveAndRestoreTestCases() {
            CreateTensors<int64_t>(TensorShape({3, 1}),
                                   {{0, 1, 2}, {3, 4, 5}, {6, 7, 8}})},
           {/*dataset_params=*/CacheDatasetParams4(),
+           /*breakpoints=*/{0, 2, 4, 11},
+           /*expected_outputs=*/{}},
+          {/*dataset_params=*/CacheDatasetParams5(),
+           /*breakpoints=*/{0, 2, 4, 11},
+           /*expected_outputs=*/
+           CreateTensors<int64_t>(TensorShape({3, 1}),
+                                  {{0, 1, 2}, {3, 4, 5}, {6, 7, 8}})},
+          {/*dataset_params=*/CacheDatasetParams6(),
            /*breakpoints=*/{0, 2, 4, 11},
            /*expected_outputs=*/{}}};
 }
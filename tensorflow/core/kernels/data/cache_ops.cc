@@ -16,18 +16,22 @@ limitations under the License.
 
 #include "tensorflow/core/data/dataset_utils.h"
 #include "tensorflow/core/framework/dataset.h"
+#include "tensorflow/core/framework/metrics.h"
 #include "tensorflow/core/framework/partial_tensor_shape.h"
 #include "tensorflow/core/framework/resource_mgr.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/lib/random/philox_random.h"
 #include "tensorflow/core/lib/random/random.h"
 #include "tensorflow/core/lib/random/random_distributions.h"
+#include "tensorflow/core/util/env_var.h"
 
 namespace tensorflow {
 namespace data {
 namespace {
 
 constexpr char kMemoryCache[] = "MemoryCache";
+constexpr int64_t kDefaultSharedCacheCapacityBytes = 1LL << 30;  // 1 GB
+constexpr int64_t kDefaultSharedCacheBlockSize = 64;
 
 }  // namespace
 
@@ -68,6 +72,86 @@ const std::vector<std::vector<Tensor>>& MemoryCache::data() {
   return cache_;
 }
 
+SharedMemoryCache::SharedMemoryCache(int64_t capacity_bytes,
+                                     int64_t block_size)
+    : capacity_bytes_(capacity_bytes), block_size_(block_size) {
+  DCHECK_GT(block_size, 0);
+}
+
+SharedMemoryCache* SharedMemoryCache::Global() {
+  static SharedMemoryCache* cache = []() {
+    int64_t capacity_bytes;
+    Status s = ReadInt64FromEnvVar("TF_DATA_SHARED_CACHE_CAPACITY_BYTES",
+                                   kDefaultSharedCacheCapacityBytes,
+                                   &capacity_bytes);
+    if (!s.ok()) {
+      LOG(WARNING) << s;
+      capacity_bytes = kDefaultSharedCacheCapacityBytes;
+    }
+    int64_t block_size;
+    s = ReadInt64FromEnvVar("TF_DATA_SHARED_CACHE_BLOCK_SIZE",
+                            kDefaultSharedCacheBlockSize, &block_size);
+    if (!s.ok()) {
+      LOG(WARNING) << s;
+      block_size = kDefaultSharedCacheBlockSize;
+    }
+    if (block_size <= 0) {
+      LOG(WARNING) << "Invalid TF_DATA_SHARED_CACHE_BLOCK_SIZE: " << block_size
+                   << ". Using the default block size instead.";
+      block_size = kDefaultSharedCacheBlockSize;
+    }
+    return new SharedMemoryCache(capacity_bytes, block_size);
+  }();
+  return cache;
+}
+
+std::shared_ptr<const SharedMemoryCache::Block> SharedMemoryCache::Lookup(
+    uint64 fingerprint, int64_t block_index) {
+  mutex_lock l(mu_);
+  auto it = entries_.find(Key(fingerprint, block_index));
+  if (it == entries_.end()) {
+    metrics::RecordTFDataSharedCacheQuery(/*cache_hit=*/false);
+    return nullptr;
+  }
+  metrics::RecordTFDataSharedCacheQuery(/*cache_hit=*/true);
+  lru_.splice(lru_.begin(), lru_, it->second.position);
+  return it->second.block;
+}
+
+void SharedMemoryCache::Insert(uint64 fingerprint, int64_t block_index,
+                               std::shared_ptr<const Block> block) {
+  if (block->size_bytes > capacity_bytes_) {
+    return;
+  }
+  mutex_lock l(mu_);
+  const Key key(fingerprint, block_index);
+  if (entries_.contains(key)) {
+    // Another iterator has cached the same elements.
+    return;
+  }
+  int64_t evicted_bytes = 0;
+  while (size_bytes_ + block->size_bytes > capacity_bytes_) {
+    auto it = entries_.find(lru_.back());
+    DCHECK(it != entries_.end());
+    evicted_bytes += it->second.block->size_bytes;
+    size_bytes_ -= it->second.block->size_bytes;
+    entries_.erase(it);
+    lru_.pop_back();
+  }
+  size_bytes_ += block->size_bytes;
+  lru_.push_front(key);
+  entries_[key] = Entry{std::move(block), lru_.begin()};
+  if (evicted_bytes > 0) {
+    metrics::RecordTFDataSharedCacheEvictedBytes(evicted_bytes);
+  }
+  metrics::RecordTFDataSharedCacheSizeBytes(size_bytes_);
+}
+
+int64_t SharedMemoryCache::size_bytes() {
+  mutex_lock l(mu_);
+  return size_bytes_;
+}
+
 AnonymousMemoryCacheHandleOp::AnonymousMemoryCacheHandleOp(
     OpKernelConstruction* ctx)
     : AnonymousResourceOp<MemoryCacheManager>(ctx,
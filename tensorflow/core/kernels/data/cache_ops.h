@@ -16,6 +16,13 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_KERNELS_DATA_CACHE_OPS_H_
 #define TENSORFLOW_CORE_KERNELS_DATA_CACHE_OPS_H_
 
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
 #include "tensorflow/core/data/dataset_utils.h"
 #include "tensorflow/core/framework/resource_mgr.h"
 
@@ -57,6 +64,65 @@ class MemoryCache {
   std::vector<std::vector<Tensor>> cache_ TF_GUARDED_BY(mu_);
 };
 
+// A thread-safe, size-bounded cache of dataset elements shared by the
+// iterators of all datasets with the same fingerprint.
+//
+// Elements are cached in blocks of `block_size` consecutive elements, keyed by
+// the fingerprint of the dataset and the index of the block. When the total
+// size of the cached blocks exceeds `capacity_bytes`, the least recently used
+// blocks are evicted. Blocks are immutable, so an evicted block remains valid
+// for the iterators that are reading it.
+class SharedMemoryCache {
+ public:
+  struct Block {
+    std::vector<std::vector<Tensor>> elements;
+    // Whether the dataset ends after `elements`.
+    bool end_of_sequence = false;
+    // The total size of the tensors of `elements`.
+    int64_t size_bytes = 0;
+  };
+
+  SharedMemoryCache(int64_t capacity_bytes, int64_t block_size);
+
+  // Returns the process-wide cache. Its capacity and block size can be set with
+  // the `TF_DATA_SHARED_CACHE_CAPACITY_BYTES` and
+  // `TF_DATA_SHARED_CACHE_BLOCK_SIZE` environment variables.
+  static SharedMemoryCache* Global();
+
+  // Returns the given block and marks it as the most recently used one, or
+  // returns nullptr if the block is not cached.
+  std::shared_ptr<const Block> Lookup(uint64 fingerprint, int64_t block_index);
+
+  // Caches the given block, evicting the least recently used blocks if needed.
+  // Blocks larger than the capacity of the cache are not cached.
+  void Insert(uint64 fingerprint, int64_t block_index,
+              std::shared_ptr<const Block> block);
+
+  int64_t capacity_bytes() const { return capacity_bytes_; }
+  int64_t block_size() const { return block_size_; }
+
+  // Returns the total size of the cached blocks.
+  int64_t size_bytes();
+
+ private:
+  using Key = std::pair<uint64, int64_t>;
+
+  struct Entry {
+    std::shared_ptr<const Block> block;
+    // The position of the entry in `lru_`.
+    std::list<Key>::iterator position;
+  };
+
+  const int64_t capacity_bytes_;
+  const int64_t block_size_;
+
+  mutex mu_;
+  // The keys of the cached blocks, from the most to the least recently used.
+  std::list<Key> lru_ TF_GUARDED_BY(mu_);
+  absl::flat_hash_map<Key, Entry> entries_ TF_GUARDED_BY(mu_);
+  int64_t size_bytes_ TF_GUARDED_BY(mu_) = 0;
+};
+
 // A resource wrapping a shared instance of a memory cache.
 class MemoryCacheManager : public ResourceBase {
  public:
@@ -0,0 +1,96 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/kernels/data/cache_ops.h"
+
+#include <cstdint>
+#include <memory>
+
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/monitoring/cell_reader.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace data {
+namespace {
+
+using ::tensorflow::monitoring::testing::CellReader;
+
+constexpr int64_t kElementBytes = sizeof(int64_t);
+
+// Returns a block of `num_elements` scalar int64 elements.
+std::shared_ptr<const SharedMemoryCache::Block> MakeBlock(
+    int64_t num_elements) {
+  auto block = std::make_shared<SharedMemoryCache::Block>();
+  for (int64_t i = 0; i < num_elements; ++i) {
+    block->elements.push_back({test::AsScalar<int64_t>(i)});
+    block->size_bytes += kElementBytes;
+  }
+  return block;
+}
+
+TEST(SharedMemoryCacheTest, LookupAndInsert) {
+  CellReader<int64_t> queries("/tensorflow/data/shared_cache_queries");
+  SharedMemoryCache cache(/*capacity_bytes=*/1024, /*block_size=*/4);
+  EXPECT_EQ(cache.Lookup(/*fingerprint=*/1, /*block_index=*/0), nullptr);
+  auto block = MakeBlock(4);
+  cache.Insert(/*fingerprint=*/1, /*block_index=*/0, block);
+  EXPECT_EQ(cache.Lookup(/*fingerprint=*/1, /*block_index=*/0), block);
+  EXPECT_EQ(cache.Lookup(/*fingerprint=*/2, /*block_index=*/0), nullptr);
+  EXPECT_EQ(cache.Lookup(/*fingerprint=*/1, /*block_index=*/1), nullptr);
+  EXPECT_EQ(cache.size_bytes(), 4 * kElementBytes);
+  EXPECT_EQ(queries.Delta("true"), 1);
+  EXPECT_EQ(queries.Delta("false"), 3);
+}
+
+TEST(SharedMemoryCacheTest, EvictsLeastRecentlyUsedBlocks) {
+  CellReader<int64_t> evicted_bytes(
+      "/tensorflow/data/shared_cache_evicted_bytes");
+  // Fits two blocks of four elements.
+  SharedMemoryCache cache(/*capacity_bytes=*/8 * kElementBytes,
+                          /*block_size=*/4);
+  cache.Insert(/*fingerprint=*/1, /*block_index=*/0, MakeBlock(4));
+  cache.Insert(/*fingerprint=*/1, /*block_index=*/1, MakeBlock(4));
+  // Block 0 becomes the most recently used block.
+  EXPECT_NE(cache.Lookup(/*fingerprint=*/1, /*block_index=*/0), nullptr);
+  cache.Insert(/*fingerprint=*/1, /*block_index=*/2, MakeBlock(4));
+  EXPECT_NE(cache.Lookup(/*fingerprint=*/1, /*block_index=*/0), nullptr);
+  EXPECT_EQ(cache.Lookup(/*fingerprint=*/1, /*block_index=*/1), nullptr);
+  EXPECT_NE(cache.Lookup(/*fingerprint=*/1, /*block_index=*/2), nullptr);
+  EXPECT_EQ(cache.size_bytes(), 8 * kElementBytes);
+  EXPECT_EQ(evicted_bytes.Delta(), 4 * kElementBytes);
+}
+
+TEST(SharedMemoryCacheTest, DoesNotCacheOversizedBlocks) {
+  SharedMemoryCache cache(/*capacity_bytes=*/2 * kElementBytes,
+                          /*block_size=*/4);
+  cache.Insert(/*fingerprint=*/1, /*block_index=*/0, MakeBlock(1));
+  cache.Insert(/*fingerprint=*/1, /*block_index=*/1, MakeBlock(4));
+  EXPECT_NE(cache.Lookup(/*fingerprint=*/1, /*block_index=*/0), nullptr);
+  EXPECT_EQ(cache.Lookup(/*fingerprint=*/1, /*block_index=*/1), nullptr);
+  EXPECT_EQ(cache.size_bytes(), kElementBytes);
+}
+
+TEST(SharedMemoryCacheTest, KeepsFirstInsertedBlock) {
+  SharedMemoryCache cache(/*capacity_bytes=*/1024, /*block_size=*/4);
+  auto block = MakeBlock(4);
+  cache.Insert(/*fingerprint=*/1, /*block_index=*/0, block);
+  cache.Insert(/*fingerprint=*/1, /*block_index=*/0, MakeBlock(4));
+  EXPECT_EQ(cache.Lookup(/*fingerprint=*/1, /*block_index=*/0), block);
+  EXPECT_EQ(cache.size_bytes(), 4 * kElementBytes);
+}
+
+}  // namespace
+}  // namespace data
+}  // namespace tensorflow
@@ -197,6 +197,9 @@ class ParseExampleDatasetOp : public UnaryDatasetOpKernel {
          it++) {
       it->second = i++;
     }
+    // The feature names are fixed for the dataset, so their index is built
+    // once and shared by all the batches parsed.
+    OP_REQUIRES_OK(ctx, example::BuildFeatureNameIndex(&config));
 
     *output = new Dataset(
         ctx, input, dense_defaults, sparse_keys_, dense_keys_,
@@ -15,6 +15,7 @@ limitations under the License.
 #include "tensorflow/core/kernels/data/parallel_batch_dataset_op.h"
 
 #include "tensorflow/core/data/dataset_test_base.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 
 namespace tensorflow {
 namespace data {
@@ -480,6 +481,72 @@ TEST_F(ParallelBatchDatasetOpTest, InvalidParallelBatchSize) {
             absl::StatusCode::kInvalidArgument);
 }
 
+// Returns the params of a ParallelBatchDataset with batches of 32 elements
+// with `num_components` float components of 16 values each, copied in
+// parallel.
+ParallelBatchDatasetParams WideElementsParams(int64_t num_components,
+                                              int64_t num_batches) {
+  constexpr int64_t kBatchSize = 32;
+  constexpr int64_t kComponentSize = 16;
+  std::vector<Tensor> components;
+  DataTypeVector output_dtypes;
+  std::vector<PartialTensorShape> output_shapes;
+  for (int64_t i = 0; i < num_components; ++i) {
+    Tensor component(DT_FLOAT,
+                     TensorShape({kBatchSize * num_batches, kComponentSize}));
+    component.flat<float>().setConstant(i);
+    components.push_back(std::move(component));
+    output_dtypes.push_back(DT_FLOAT);
+    output_shapes.push_back(PartialTensorShape({kBatchSize, kComponentSize}));
+  }
+  return ParallelBatchDatasetParams(
+      TensorSliceDatasetParams(std::move(components), "tensor_slice"),
+      /*batch_size=*/kBatchSize,
+      /*num_parallel_calls=*/4,
+      /*drop_remainder=*/true, std::move(output_dtypes),
+      std::move(output_shapes),
+      /*parallel_copy=*/true,
+      /*deterministic=*/DeterminismPolicy::kDeterministic,
+      /*node_name=*/kNodeName);
+}
+
+class ParallelBatchDatasetOpBenchmark : public DatasetOpsTestBase {
+ public:
+  void TestBody() override {}
+
+  // Measures the examples per second that ParallelBatchDataset batches, to
+  // compare with the copy alone in `BM_CopyBatch` of `dataset_utils_test`.
+  void Run(::testing::benchmark::State& state, int64_t num_components) {
+    constexpr int64_t kNumBatches = 8;
+    auto dataset_params = WideElementsParams(num_components, kNumBatches);
+    TF_CHECK_OK(InitializeRuntime(dataset_params));
+    std::unique_ptr<TestDataset> dataset;
+    TF_CHECK_OK(MakeDataset(dataset_params, &dataset));
+    for (auto s : state) {
+      std::unique_ptr<TestIterator> iterator;
+      TF_CHECK_OK(MakeIterator(dataset_params, *dataset, &iterator));
+      std::vector<Tensor> out_tensors;
+      bool end_of_sequence = false;
+      while (!end_of_sequence) {
+        TF_CHECK_OK(iterator->GetNext(&out_tensors, &end_of_sequence));
+      }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                            kNumBatches * 32);
+  }
+};
+
+void BM_ParallelBatchWideElements(::testing::benchmark::State& state) {
+  ParallelBatchDatasetOpBenchmark benchmark;
+  benchmark.Run(state, /*num_components=*/state.range(0));
+}
+
+BENCHMARK(BM_ParallelBatchWideElements)
+    ->Arg(16)
+    ->Arg(256)
+    ->Arg(1024)
+    ->UseRealTime();
+
 }  // namespace
 }  // namespace data
 }  // namespace tensorflow
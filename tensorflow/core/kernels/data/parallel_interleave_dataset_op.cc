@@ -120,6 +120,14 @@ constexpr int kDefaultCyclePrefetchFactor = 2;
 // match the behavior of the original implementation.
 constexpr double kDefaultPerIteratorPrefetchFactor = 2.0L;
 
+// `kMaxFutureWorkersPerCore * port::MaxParallelism()` is the maximum number of
+// future workers. Future workers mostly wait on I/O while they create the
+// iterators of input elements (e.g. open files), so they may oversubscribe the
+// cores, but only by a bounded factor so that large cycle lengths (e.g. when
+// interleaving the thousands of files of a glob) do not create a thread per
+// cycle element.
+constexpr int kMaxFutureWorkersPerCore = 4;
+
 // Period between reporting dataset statistics.
 constexpr int kStatsReportingPeriodMillis = 1000;
 
@@ -171,6 +179,19 @@ int64_t ComputePrefetchInputElements(int64_t configured_prefetch_input_elements,
   return kDefaultCyclePrefetchFactor * cycle_length;
 }
 
+// Returns the number of future workers. When elements are moved from
+// `future_elements_` to `current_elements_`, the future worker which created
+// the element may continue to process the element for some time. That is why
+// an additional `cycle_length` future workers are used (up to the bound) so
+// that whenever `future_elements_.size() < prefetch_input_elements`, there is
+// likely a future worker available to create a new future element.
+int64_t ComputeNumFutureWorkers(int64_t prefetch_input_elements,
+                                int64_t cycle_length) {
+  const int64_t max_future_workers =
+      std::max<int64_t>(kMaxFutureWorkersPerCore * port::MaxParallelism(), 1);
+  return std::min(prefetch_input_elements + cycle_length, max_future_workers);
+}
+
 int64_t ComputeMaxBufferedElements(int64_t prefetch_input_elements,
                                    int64_t buffer_output_elements,
                                    int64_t cycle_length) {
@@ -380,10 +401,10 @@ class ParallelInterleaveDatasetOp::Dataset : public DatasetBase {
       //
       // Allocate one thread for the worker manager, one thread for stats
       // collection, `cycle_length_` threads for the current workers, and
-      // `future_elements_prefetch_` for the future workers.
+      // `ComputeNumFutureWorkers()` for the future workers.
       int max_current_workers = dataset()->cycle_length_;
-      int future_workers =
-          dataset()->prefetch_input_elements_ + dataset()->cycle_length_;
+      int future_workers = ComputeNumFutureWorkers(
+          dataset()->prefetch_input_elements_, dataset()->cycle_length_);
       int num_threads = 1 + max_current_workers + future_workers;
       if (ctx->stats_aggregator()) {
         num_threads++;
@@ -843,15 +864,22 @@ class ParallelInterleaveDatasetOp::Dataset : public DatasetBase {
       }
     }
 
-    // Creates a new element.
-    std::shared_ptr<Element> MakeElement(IteratorContext* ctx)
+    // Creates a new element. If `defer_iterator` is true, only the input of
+    // the element is fetched, and the caller must claim the element and call
+    // `InitializeIterator()` to create its iterator without holding `mu_`.
+    std::shared_ptr<Element> MakeElement(IteratorContext* ctx,
+                                         bool defer_iterator = false)
         TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
       if (end_of_input_) {
         return nullptr;
       }
       auto element = std::make_shared<Element>();
       element->id = element_id_counter_++;
-      InitializeInput(ctx, *element);
+      if (defer_iterator) {
+        FetchInput(ctx, *element);
+      } else {
+        InitializeInput(ctx, *element);
+      }
       return element;
     }
 
@@ -866,14 +894,8 @@ class ParallelInterleaveDatasetOp::Dataset : public DatasetBase {
         DecrementOutstandingThreads();
       });
       int initial_current_workers;
-      // When elements are moved from `future_elements_` to `current_elements_`,
-      // the future worker which created the element may continue to process
-      // the element for some time. That is why we need an additional
-      // `cycle_length_` future workers to guarantee that whenever
-      // `future_element_.size() < future_elements_prefetch_`, there will be a
-      // future worker available to create a new future element.
-      int future_workers =
-          dataset()->prefetch_input_elements_ + dataset()->cycle_length_;
+      int future_workers = ComputeNumFutureWorkers(
+          dataset()->prefetch_input_elements_, dataset()->cycle_length_);
       {
         mutex_lock l(*mu_);
         initial_current_workers = num_parallel_calls_->value;
@@ -1027,7 +1049,11 @@ class ParallelInterleaveDatasetOp::Dataset : public DatasetBase {
             done();
             return;
           }
-          element = MakeElement(ctx.get());
+          // The input is fetched while holding `mu_`, which keeps the order
+          // of the elements deterministic, but the iterator of the element
+          // (e.g. the opened file) is created concurrently with the other
+          // workers.
+          element = MakeElement(ctx.get(), /*defer_iterator=*/true);
           if (!element) {
             done();
             return;
@@ -1036,6 +1062,7 @@ class ParallelInterleaveDatasetOp::Dataset : public DatasetBase {
           element->active = true;
           future_elements_.push_back(element);
         }
+        InitializeIterator(ctx.get(), element);
         ProcessElement(ctx.get(), element);
       }
     }
@@ -1097,14 +1124,60 @@ class ParallelInterleaveDatasetOp::Dataset : public DatasetBase {
       }
     }
 
+    // Fetches the input of `element` and creates its iterator while holding
+    // `mu_`.
     void InitializeInput(IteratorContext* ctx, Element& element)
         TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
-      element.initialized = true;
+      if (!FetchInput(ctx, element)) {
+        return;
+      }
+      MemoryCheckpoint checkpoint(ctx->id_registry());
+      std::unique_ptr<IteratorBase> iterator;
+      Status status = MakeElementIterator(ctx, *element.inputs, element.id,
+                                          &iterator, &checkpoint);
+      checkpoint_->Merge(&checkpoint);
+      FinishInitialization(ctx, element, status, std::move(iterator));
+    }
+
+    // Creates the iterator of `element`, whose input was fetched by
+    // `MakeElement(ctx, /*defer_iterator=*/true)`, without holding `mu_`. The
+    // caller must have claimed the element by setting `element->active`.
+    void InitializeIterator(IteratorContext* ctx,
+                            const std::shared_ptr<Element>& element)
+        TF_LOCKS_EXCLUDED(mu_) {
+      const std::vector<Tensor>* inputs;
+      int64_t id;
+      {
+        mutex_lock l(*mu_);
+        DCHECK(element->active);
+        if (element->initialized) {
+          return;
+        }
+        // `inputs` remains valid after releasing the lock because the element
+        // is active, so no other thread modifies it.
+        inputs = element->inputs.get();
+        id = element->id;
+      }
+      MemoryCheckpoint checkpoint(ctx->id_registry());
+      std::unique_ptr<IteratorBase> iterator;
+      Status status =
+          MakeElementIterator(ctx, *inputs, id, &iterator, &checkpoint);
+      mutex_lock l(*mu_);
+      checkpoint_->Merge(&checkpoint);
+      FinishInitialization(ctx, *element, status, std::move(iterator));
+    }
+
+    // Fetches the input of `element`. Returns whether the iterator of the
+    // element needs to be created from the input, in which case the element is
+    // left uninitialized; otherwise the element is initialized.
+    bool FetchInput(IteratorContext* ctx, Element& element)
+        TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
       // Check if we've already reached end of input.
       if (end_of_input_) {
+        element.initialized = true;
         element.no_input = true;
         NotifyElementUpdate(element);
-        return;
+        return false;
       }
       profiler::TraceMe traceme([input_element_id = element.id] {
         return profiler::TraceMeEncode(
@@ -1117,29 +1190,56 @@ class ParallelInterleaveDatasetOp::Dataset : public DatasetBase {
       Status status = input_impl_->GetNext(ctx, &inputs, &end_of_input_);
       checkpoint_->Merge(ctx->checkpoint());
       if (!status.ok()) {
+        element.initialized = true;
         AddErrorResult(ctx, element, status);
-        return;
+        return false;
       }
       if (end_of_input_) {
+        element.initialized = true;
         element.no_input = true;
         NotifyElementUpdate(element);
-        return;
+        return false;
       }
       element.inputs = std::make_unique<std::vector<Tensor>>(std::move(inputs));
+      return true;
+    }
+
+    // Creates the iterator for the input element `inputs` with the given `id`,
+    // adding the state it checkpoints to `checkpoint`. Does not access any
+    // state guarded by `mu_`.
+    Status MakeElementIterator(IteratorContext* ctx,
+                               const std::vector<Tensor>& inputs, int64_t id,
+                               std::unique_ptr<IteratorBase>* iterator,
+                               MemoryCheckpoint* checkpoint) {
+      profiler::TraceMe traceme([id] {
+        return profiler::TraceMeEncode("ParallelInterleaveMakeIterator",
+                                       {{"input_element_id", id}});
+      });
       IteratorContext::Params params(ctx);
       params.interleave_depth += 1;
       IteratorContext nested_ctx(params);
-      status = MakeIteratorFromInputElement(
-          &nested_ctx, this, *element.inputs, element.id,
-          *instantiated_captured_func_, prefix(), &element.iterator,
-          model_node());
-      checkpoint_->Merge(nested_ctx.checkpoint());
+      Status status = MakeIteratorFromInputElement(
+          &nested_ctx, this, inputs, id, *instantiated_captured_func_,
+          prefix(), iterator, model_node());
+      checkpoint->Merge(nested_ctx.checkpoint());
+      return status;
+    }
+
+    // Marks `element` as initialized with the result of creating its
+    // iterator.
+    void FinishInitialization(IteratorContext* ctx, Element& element,
+                              Status status,
+                              std::unique_ptr<IteratorBase> iterator)
+        TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      element.initialized = true;
       if (!status.ok()) {
         element.inputs.reset();
-        element.iterator.reset();
         AddErrorResult(ctx, element, status);
         return;
       }
+      element.iterator = std::move(iterator);
+      // The element may have been moved to the current cycle while its
+      // iterator was being created, in which case autotuning stays enabled.
       if (element.cycle_index == -1) {
         DisableAutotune(ctx, element.iterator.get());
       }
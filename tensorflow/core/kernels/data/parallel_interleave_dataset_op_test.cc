@@ -13,9 +13,11 @@ limitations under the License.
 
 #include <algorithm>
 #include <memory>
+#include <numeric>
 
 #include "tensorflow/core/data/dataset_test_base.h"
 #include "tensorflow/core/graph/graph_def_builder.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 
 namespace tensorflow {
 namespace data {
@@ -899,6 +901,83 @@ TEST_F(ParallelInterleaveDatasetOpTest, InvalidArguments) {
   }
 }
 
+// Returns the params of a deterministic parallel interleave over
+// `num_inputs` inputs with a single element each, like the files of a large
+// glob.
+ParallelInterleaveDatasetParams ManyInputsParams(int64_t num_inputs,
+                                                 int64_t cycle_length) {
+  std::vector<int64_t> values(num_inputs);
+  std::iota(values.begin(), values.end(), 0);
+  auto tensor_slice_dataset_params = TensorSliceDatasetParams(
+      /*components=*/{CreateTensor<int64_t>(TensorShape{num_inputs, 1, 1},
+                                            values)},
+      /*node_name=*/"tensor_slice");
+  return ParallelInterleaveDatasetParams(
+      tensor_slice_dataset_params,
+      /*other_arguments=*/{},
+      /*cycle_length=*/cycle_length,
+      /*block_length=*/1,
+      /*buffer_output_elements=*/model::kAutotune,
+      /*prefetch_input_elements=*/model::kAutotune,
+      /*num_parallel_calls=*/cycle_length,
+      /*func=*/
+      MakeTensorSliceDatasetFunc(
+          DataTypeVector({DT_INT64}),
+          std::vector<PartialTensorShape>({PartialTensorShape({1})})),
+      /*func_lib=*/{test::function::MakeTensorSliceDataset()},
+      /*type_arguments=*/{},
+      /*output_dtypes=*/{DT_INT64},
+      /*output_shapes=*/{PartialTensorShape({1})},
+      /*deterministic=*/DeterminismPolicy::kDeterministic,
+      /*node_name=*/kNodeName);
+}
+
+TEST_F(ParallelInterleaveDatasetOpTest, ManyInputsDeterministicOrder) {
+  constexpr int64_t kNumInputs = 10000;
+  auto dataset_params = ManyInputsParams(kNumInputs, /*cycle_length=*/16);
+  TF_ASSERT_OK(Initialize(dataset_params));
+  std::vector<Tensor> expected_outputs;
+  for (int64_t i = 0; i < kNumInputs; ++i) {
+    expected_outputs.push_back(CreateTensor<int64_t>(TensorShape{1}, {i}));
+  }
+  TF_EXPECT_OK(CheckIteratorGetNext(expected_outputs, /*compare_order=*/true));
+}
+
+class ParallelInterleaveDatasetOpBenchmark : public DatasetOpsTestBase {
+ public:
+  void TestBody() override {}
+
+  // Measures the time to interleave `num_inputs` single-element inputs.
+  void Run(::testing::benchmark::State& state, int64_t num_inputs,
+           int64_t cycle_length) {
+    auto dataset_params = ManyInputsParams(num_inputs, cycle_length);
+    TF_CHECK_OK(InitializeRuntime(dataset_params));
+    std::unique_ptr<TestDataset> dataset;
+    TF_CHECK_OK(MakeDataset(dataset_params, &dataset));
+    for (auto s : state) {
+      std::unique_ptr<TestIterator> iterator;
+      TF_CHECK_OK(MakeIterator(dataset_params, *dataset, &iterator));
+      std::vector<Tensor> out_tensors;
+      bool end_of_sequence = false;
+      while (!end_of_sequence) {
+        TF_CHECK_OK(iterator->GetNext(&out_tensors, &end_of_sequence));
+      }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                            num_inputs);
+  }
+};
+
+void BM_ParallelInterleaveManyInputs(::testing::benchmark::State& state) {
+  ParallelInterleaveDatasetOpBenchmark benchmark;
+  benchmark.Run(state, /*num_inputs=*/state.range(0),
+                /*cycle_length=*/state.range(1));
+}
+
+BENCHMARK(BM_ParallelInterleaveManyInputs)
+    ->ArgsProduct({{1000, 10000}, {4, 64}})
+    ->UseRealTime();
+
 }  // namespace
 }  // namespace data
 }  // namespace tensorflow
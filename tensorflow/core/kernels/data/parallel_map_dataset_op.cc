@@ -14,6 +14,7 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow/core/kernels/data/parallel_map_dataset_op.h"
 
+#include <atomic>
 #include <deque>
 #include <functional>
 #include <memory>
@@ -25,7 +26,9 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/input_colocation_exemption_registry.h"
 #include "tensorflow/core/data/dataset_utils.h"
 #include "tensorflow/core/data/name_utils.h"
+#include "tensorflow/core/data/numa_work_sharder.h"
 #include "tensorflow/core/data/stats_utils.h"
+#include "tensorflow/core/data/tfdataz_metrics.h"
 #include "tensorflow/core/framework/metrics.h"
 #include "tensorflow/core/framework/model.h"
 #include "tensorflow/core/framework/partial_tensor_shape.h"
@@ -33,10 +36,12 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/random/random.h"
+#include "tensorflow/core/platform/numa.h"
 #include "tensorflow/core/platform/stringprintf.h"
 #include "tensorflow/core/profiler/lib/traceme.h"
 #include "tensorflow/core/profiler/lib/traceme_encode.h"
 #include "tensorflow/core/protobuf/error_codes.pb.h"
+#include "tensorflow/core/util/env_var.h"
 
 namespace tensorflow {
 namespace data {
@@ -74,6 +79,23 @@ constexpr char kErrorMessage[] = "error_message";
 // Period between reporting dataset statistics.
 constexpr int kStatsReportingPeriodMillis = 1000;
 
+// Returns whether parallel map calls should be sharded across the NUMA nodes of
+// the host, which is controlled by the `TF_DATA_NUMA_AWARE_PARALLEL_MAP`
+// environment variable.
+bool NumaAwareParallelMap() {
+  static const bool numa_aware = [] {
+    bool value;
+    Status s = ReadBoolFromEnvVar("TF_DATA_NUMA_AWARE_PARALLEL_MAP",
+                                  /*default_val=*/false, &value);
+    if (!s.ok()) {
+      LOG(WARNING) << s;
+      return false;
+    }
+    return value;
+  }();
+  return numa_aware;
+}
+
 }  // namespace
 
 class ParallelMapDatasetOp::Dataset : public DatasetBase {
@@ -258,6 +280,9 @@ class ParallelMapDatasetOp::Dataset : public DatasetBase {
       if (num_parallel_calls_->value == model::kAutotune) {
         num_parallel_calls_->value = GetAutotuneDefaultParallelism(ctx);
       }
+      if (NumaAwareParallelMap()) {
+        numa_sharder_ = NumaWorkSharder::Shared();
+      }
       cancellation_manager_ = std::make_unique<CancellationManager>();
       TF_RETURN_IF_ERROR(RegisterCancellationCallback(
           ctx->cancellation_manager(),
@@ -280,6 +305,9 @@ class ParallelMapDatasetOp::Dataset : public DatasetBase {
                            std::vector<Tensor>* out_tensors,
                            bool* end_of_sequence) override {
       std::shared_ptr<InvocationResult> result;
+      if (numa_sharder_) {
+        consumer_numa_node_ = NumaWorkSharder::GetThreadNode();
+      }
       {
         mutex_lock l(*mu_);
         EnsureThreadsStarted(ctx);
@@ -449,6 +477,19 @@ class ParallelMapDatasetOp::Dataset : public DatasetBase {
     void EnsureThreadsStarted(IteratorContext* ctx)
         TF_EXCLUSIVE_LOCKS_REQUIRED(*mu_) {
       if (!runner_thread_) {
+        if (numa_sharder_) {
+          for (int i = 0; i < numa_sharder_->num_nodes(); ++i) {
+            IteratorContext::Params params(ctx);
+            // As for the default runner, keep a symbol in the
+            // `tensorflow::data` namespace on the stack of the function.
+            params.runner = [runner = numa_sharder_->Runner(i)](
+                                std::function<void()> fn) {
+              runner([fn = std::move(fn)]() { Runner::get()->Run(fn); });
+            };
+            numa_ctxs_.push_back(
+                std::make_shared<IteratorContext>(std::move(params)));
+          }
+        }
         auto ctx_copy = std::make_shared<IteratorContext>(*ctx);
         runner_thread_ = ctx->StartThread(
             "tf_data_parallel_map",
@@ -487,9 +528,24 @@ class ParallelMapDatasetOp::Dataset : public DatasetBase {
         return;
       }
 
-      auto done = [this, ctx, result](Status status) {
+      // When the calls are sharded across NUMA nodes, the function runs on
+      // the threads of the node picked for the consumer. Its outputs are still
+      // allocated by the device's allocator, so their memory is only local to
+      // the node when its pages are first touched by the node's threads.
+      int numa_node = port::kNUMANoAffinity;
+      std::shared_ptr<IteratorContext> call_ctx = ctx;
+      if (numa_sharder_) {
+        numa_node = numa_sharder_->PickNode(consumer_numa_node_);
+        call_ctx = numa_ctxs_[numa_node];
+      }
+
+      auto done = [this, ctx, result, numa_node](Status status) {
         result->status.Update(status);
         RecordBufferEnqueue(ctx.get(), result->return_values);
+        if (numa_node != port::kNUMANoAffinity && result->status.ok()) {
+          TfDatazMetricsRegistry::RecordNumaNodeElement(
+              numa_node, GetTotalBytes(result->return_values));
+        }
         CallCompleted(ctx, result);
       };
 
@@ -497,30 +553,30 @@ class ParallelMapDatasetOp::Dataset : public DatasetBase {
       // `result->return_values`, and invoking `done` when finished.
       if (dataset()->captured_func_->use_inter_op_parallelism()) {
         instantiated_captured_func_->RunAsync(
-            ctx.get(), std::move(input_element), &result->return_values,
+            call_ctx.get(), std::move(input_element), &result->return_values,
             std::move(done), model_node());
       } else {
         // In this case, the function will be executed using single-threaded
         // executor. We schedule it using `ctx->runner()` to enable concurrent
         // application of the function over different input elements.
         auto fn = std::bind(
-            [this, ctx, result](std::vector<Tensor> input_element) {
+            [this, call_ctx, result](std::vector<Tensor> input_element) {
               return instantiated_captured_func_->Run(
-                  ctx.get(), std::move(input_element), &result->return_values,
-                  model_node());
+                  call_ctx.get(), std::move(input_element),
+                  &result->return_values, model_node());
             },
             std::move(input_element));
-        (*ctx->runner())(
-            [this, ctx, fn = std::move(fn), done = std::move(done)]() {
+        (*call_ctx->runner())(
+            [this, call_ctx, fn = std::move(fn), done = std::move(done)]() {
               Status s;
               // Check whether we are already recording to prevent invalid
               // nesting of `RecordStart` calls.
-              if (IsRecording(ctx.get())) {
+              if (IsRecording(call_ctx.get())) {
                 s = fn();
               } else {
-                RecordStart(ctx.get());
+                RecordStart(call_ctx.get());
                 s = fn();
-                RecordStop(ctx.get());
+                RecordStop(call_ctx.get());
               }
               done(s);
             });
@@ -728,6 +784,16 @@ class ParallelMapDatasetOp::Dataset : public DatasetBase {
     // tree. We record the interleave depth so that it can be included in the
     // trace metadata.
     int64 interleave_depth_ = -1;
+
+    // If the calls are sharded across NUMA nodes, the sharder shared by the
+    // process and a context per node whose runner schedules closures on the
+    // node.
+    NumaWorkSharder* numa_sharder_ = nullptr;  // Not owned.
+    // `numa_ctxs_` is populated before the runner thread is started and is
+    // read-only afterwards.
+    std::vector<std::shared_ptr<IteratorContext>> numa_ctxs_;
+    // The NUMA node of the thread that last called `GetNext()`.
+    std::atomic<int> consumer_numa_node_{port::kNUMANoAffinity};
   };
 
   const DatasetBase* const input_;
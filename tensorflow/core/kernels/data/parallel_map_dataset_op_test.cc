@@ -13,6 +13,8 @@ limitations under the License.
 
 #include "tensorflow/core/data/dataset_test_base.h"
 #include "tensorflow/core/data/name_utils.h"
+#include "tensorflow/core/framework/allocation_description.pb.h"
+#include "tensorflow/core/framework/tensor_description.pb.h"
 
 namespace tensorflow {
 namespace data {
@@ -411,6 +413,27 @@ TEST_F(ParallelMapDatasetOpTest, InvalidNumParallelCalls) {
             absl::StatusCode::kInvalidArgument);
 }
 
+TEST_F(ParallelMapDatasetOpTest, OutputsAreAllocatedByTheDeviceAllocator) {
+  // Sharding the calls across NUMA nodes only moves them to the node's
+  // threads: the function outputs still come from the device's allocator.
+  auto dataset_params = ParallelMapDatasetParams2();
+  TF_ASSERT_OK(Initialize(dataset_params));
+  const string allocator_name = device_->GetAllocator({})->Name();
+  bool end_of_sequence = false;
+  while (true) {
+    std::vector<Tensor> next;
+    TF_ASSERT_OK(
+        iterator_->GetNext(iterator_ctx_.get(), &next, &end_of_sequence));
+    if (end_of_sequence) break;
+    for (const Tensor& tensor : next) {
+      TensorDescription description;
+      tensor.FillDescription(&description);
+      EXPECT_EQ(description.allocation_description().allocator_name(),
+                allocator_name);
+    }
+  }
+}
+
 }  // namespace
 }  // namespace data
 }  // namespace tensorflow
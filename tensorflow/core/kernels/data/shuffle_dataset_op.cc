@@ -31,6 +31,7 @@ limitations under the License.
 #include "tensorflow/core/framework/resource_mgr.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/kernels/data/random_seed_ops.h"
+#include "tensorflow/core/kernels/data/spilling_shuffle_buffer.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/random/philox_random.h"
 #include "tensorflow/core/lib/random/random.h"
@@ -52,6 +53,8 @@ namespace data {
 /* static */ constexpr const char* const ShuffleDatasetOpBase::kOutputShapes;
 /* static */ constexpr const char* const
     ShuffleDatasetOpBase::kReshuffleEachIteration;
+/* static */ constexpr const char* const ShuffleDatasetOpBase::kSpillDirectory;
+/* static */ constexpr const char* const ShuffleDatasetOpBase::kSpillRunSize;
 
 /* static */ constexpr const char* const ShuffleDatasetOp::kDatasetType;
 
@@ -71,6 +74,7 @@ constexpr char kSlicesSize[] = "slices_size";
 constexpr char kSlicesStart[] = "slices_start";
 constexpr char kSlicesEnd[] = "slices_end";
 constexpr char kSlicesReachedEndOfSequence[] = "slices_reached_end_of_sequence";
+constexpr char kSpillBuffer[] = "spill_buffer";
 constexpr char kSeedGenerator[] = "SeedGenerator";
 constexpr char kEpochNumRandomSamples[] = "epoch_num_random_samples";
 constexpr char kShuffleDatasetV1[] = "ShuffleDataset";
@@ -88,12 +92,15 @@ class ShuffleDatasetOpBase::ShuffleDatasetBase : public DatasetBase {
   ShuffleDatasetBase(OpKernelContext* ctx, const DatasetBase* input,
                      int64_t buffer_size,
                      std::shared_ptr<SeedGenerator> seed_generator,
-                     int64_t count)
+                     int64_t count, const std::string& spill_directory = "",
+                     int64_t spill_run_size = 0)
       : DatasetBase(DatasetContext(ctx)),
         input_(input),
         buffer_size_(buffer_size),
         seed_generator_(std::move(seed_generator)),
         count_(count),
+        spill_directory_(spill_directory),
+        spill_run_size_(spill_run_size),
         traceme_metadata_(
             {{"buffer_size",
               strings::Printf("%lld", static_cast<long long>(buffer_size))}}) {
@@ -189,7 +196,13 @@ class ShuffleDatasetOpBase::ShuffleDatasetBase : public DatasetBase {
           seed_generator_(seed_generator),
           parent_generator_(seed_generator->seed(), seed_generator->seed2()),
           generator_(&parent_generator_) {
-      if (params.dataset->buffer_size_ == kUnknownCardinality) {
+      if (!params.dataset->spill_directory_.empty()) {
+        spill_buffer_ = std::make_unique<SpillingShuffleBuffer>(
+            Env::Default(), params.dataset->spill_directory_,
+            params.dataset->output_dtypes(), params.dataset->buffer_size_,
+            params.dataset->spill_run_size_);
+        buffer_ = std::make_unique<std::vector<std::vector<Tensor>>>();
+      } else if (params.dataset->buffer_size_ == kUnknownCardinality) {
         buffer_ = std::make_unique<std::vector<std::vector<Tensor>>>();
       } else {
         buffer_ = std::make_unique<std::vector<std::vector<Tensor>>>(
@@ -210,6 +223,9 @@ class ShuffleDatasetOpBase::ShuffleDatasetBase : public DatasetBase {
                            std::vector<Tensor>* out_tensors,
                            bool* end_of_sequence) override {
       mutex_lock l(mu_);
+      if (spill_buffer_) {
+        return GetNextFromSpillBuffer(ctx, out_tensors, end_of_sequence);
+      }
       TF_RETURN_IF_ERROR(FillBuffer(ctx));
       if (num_elements_ == 0) {
         DCHECK(input_impl_ == nullptr);
@@ -271,6 +287,15 @@ class ShuffleDatasetOpBase::ShuffleDatasetBase : public DatasetBase {
 
       // Save the epoch counter, buffer, and buffer slices.
       TF_RETURN_IF_ERROR(writer->WriteScalar(this->full_name(kEpoch), epoch_));
+      if (spill_buffer_) {
+        TF_RETURN_IF_ERROR(
+            spill_buffer_->Save(writer, this->full_name(kSpillBuffer)));
+        if (data_produced_) {
+          TF_RETURN_IF_ERROR(
+              writer->WriteScalar(this->full_name(kDataProduced), ""));
+        }
+        return OkStatus();
+      }
       TF_RETURN_IF_ERROR(
           writer->WriteScalar(this->full_name(kNumElements), num_elements_));
       TF_RETURN_IF_ERROR(WriteElementsToCheckpoint(writer, prefix(), *buffer_));
@@ -326,6 +351,16 @@ class ShuffleDatasetOpBase::ShuffleDatasetBase : public DatasetBase {
 
       // Restore the epoch counter, buffer, and buffer slices.
       TF_RETURN_IF_ERROR(reader->ReadScalar(this->full_name(kEpoch), &epoch_));
+      if (spill_buffer_) {
+        spill_buffer_ = std::make_unique<SpillingShuffleBuffer>(
+            Env::Default(), dataset()->spill_directory_,
+            dataset()->output_dtypes(), dataset()->buffer_size_,
+            dataset()->spill_run_size_);
+        TF_RETURN_IF_ERROR(spill_buffer_->Restore(
+            ctx, reader, this->full_name(kSpillBuffer)));
+        data_produced_ = reader->Contains(this->full_name(kDataProduced));
+        return OkStatus();
+      }
       TF_RETURN_IF_ERROR(
           reader->ReadScalar(this->full_name(kNumElements), &num_elements_));
       size_t slices_size;
@@ -476,10 +511,14 @@ class ShuffleDatasetOpBase::ShuffleDatasetBase : public DatasetBase {
     Status PrepareNextEpoch(IteratorContext* ctx)
         TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
       if (epoch_ == 0) {
-        slices_.push_back(std::make_unique<Slice>(0, 0, false));
+        if (!spill_buffer_) {
+          slices_.push_back(std::make_unique<Slice>(0, 0, false));
+        }
       } else {
-        int64_t n = slices_.back()->end;
-        slices_.push_back(std::make_unique<Slice>(n, n, false));
+        if (!spill_buffer_) {
+          int64_t n = slices_.back()->end;
+          slices_.push_back(std::make_unique<Slice>(n, n, false));
+        }
         for (const auto& provider : ctx->split_providers()) {
           TF_RETURN_IF_ERROR(provider->Reset());
         }
@@ -524,10 +563,83 @@ class ShuffleDatasetOpBase::ShuffleDatasetBase : public DatasetBase {
       return absl::StrCat(dataset()->buffer_size_);
     }
 
+    // Produces the next element when the dataset spills its shuffle buffer
+    // to disk. Until a window of the buffer has been sealed, the input is
+    // consumed to fill it; afterwards, one input element is added to the
+    // filling window for every element produced, so that the next window is
+    // full when the current one has been drained.
+    Status GetNextFromSpillBuffer(IteratorContext* ctx,
+                                  std::vector<Tensor>* out_tensors,
+                                  bool* end_of_sequence)
+        TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      bool end_of_input = false;
+      int64_t start_micros = EnvTime::NowMicros();
+      int64_t num_log_entries = 0;
+      while (spill_buffer_->num_sealed_elements() == 0 && !end_of_input) {
+        if (EnvTime::NowMicros() >
+            ((num_log_entries + 1) * kLogIntervalMicros) + start_micros) {
+          num_log_entries++;
+          LOG(INFO) << "Filling up shuffle buffer (this may take a while): "
+                    << spill_buffer_->num_filling_elements() << " of "
+                    << BufferSizeString();
+        }
+        TF_RETURN_IF_ERROR(AddToSpillBuffer(ctx, &end_of_input));
+      }
+      if (num_log_entries > 0) {
+        LOG(INFO) << "Shuffle buffer filled.";
+      }
+      if (spill_buffer_->num_sealed_elements() == 0) {
+        *end_of_sequence = true;
+        return OkStatus();
+      }
+      if (!end_of_input &&
+          spill_buffer_->num_sealed_windows() <= kMaxEpochsInBuffer) {
+        TF_RETURN_IF_ERROR(AddToSpillBuffer(ctx, &end_of_input));
+      }
+      *end_of_sequence = false;
+      auto random = [this]() TF_NO_THREAD_SAFETY_ANALYSIS { return Random(); };
+      return spill_buffer_->Remove(random, out_tensors);
+    }
+
+    // Adds the next input element to the spill buffer, sealing the filling
+    // window at the end of each input epoch. Sets `end_of_input` if there is
+    // no more input.
+    Status AddToSpillBuffer(IteratorContext* ctx, bool* end_of_input)
+        TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      auto random = [this]() TF_NO_THREAD_SAFETY_ANALYSIS { return Random(); };
+      if (!input_impl_) {
+        if (dataset()->count_ != -1 && epoch_ >= dataset()->count_) {
+          *end_of_input = true;
+          return OkStatus();
+        }
+        TF_RETURN_IF_ERROR(PrepareNextEpoch(ctx));
+      }
+      std::vector<Tensor> input_element;
+      bool end_of_input_sequence = false;
+      TF_RETURN_IF_ERROR(
+          input_impl_->GetNext(ctx, &input_element, &end_of_input_sequence));
+      if (!end_of_input_sequence) {
+        data_produced_ = true;
+        return spill_buffer_->Add(std::move(input_element), random);
+      }
+      input_impl_.reset();
+      TF_RETURN_IF_ERROR(spill_buffer_->Seal(random));
+      if (ctx->split_providers().empty() && !data_produced_ &&
+          this->dataset()->count_ == -1) {
+        // If we encounter the end of sequence without producing data, we
+        // terminate the iteration immediately. (Otherwise, this iterator
+        // would loop infinitely and never produce a value.)
+        *end_of_input = true;
+      }
+      return OkStatus();
+    }
+
     mutex mu_;
     SeedGenerator* const seed_generator_ TF_GUARDED_BY(mu_);  // Not owned.
     std::unique_ptr<std::vector<std::vector<Tensor>>> buffer_
         TF_GUARDED_BY(mu_);
+    // Used instead of `buffer_` if the dataset spills its buffer to disk.
+    std::unique_ptr<SpillingShuffleBuffer> spill_buffer_ TF_GUARDED_BY(mu_);
     std::unique_ptr<IteratorBase> input_impl_ TF_GUARDED_BY(mu_) = nullptr;
     int64_t epoch_ TF_GUARDED_BY(mu_) = 0;
     int64_t num_elements_ TF_GUARDED_BY(mu_) = 0;
@@ -552,6 +664,10 @@ class ShuffleDatasetOpBase::ShuffleDatasetBase : public DatasetBase {
   // fuse shuffle and repeat together, and make the shuffle dataset op
   // responsible for repeating as well.
   const int64_t count_;
+  // If not empty, the shuffle buffer keeps runs of `spill_run_size_` elements
+  // in memory and spills the rest to this directory.
+  const std::string spill_directory_;
+  const int64_t spill_run_size_;
   const TraceMeMetadata traceme_metadata_;
   mutable mutex mu_;
   mutable std::vector<std::int64_t> shuffled_indices_ TF_GUARDED_BY(mu_);
@@ -677,8 +793,10 @@ class ShuffleDatasetOp::DatasetV3 : public ShuffleDatasetBase {
  public:
   DatasetV3(OpKernelContext* ctx, const DatasetBase* input, int64_t buffer_size,
             int64_t count, RandomSeeds&& seeds, SeedGeneratorManager* manager,
-            ResourceHandle&& resource_handle, bool owns_resource)
-      : ShuffleDatasetBase(ctx, input, buffer_size, manager->get(), count),
+            ResourceHandle&& resource_handle, bool owns_resource,
+            const std::string& spill_directory, int64_t spill_run_size)
+      : ShuffleDatasetBase(ctx, input, buffer_size, manager->get(), count,
+                           spill_directory, spill_run_size),
         manager_(manager),
         owns_resource_(owns_resource),
         resource_handle_(std::move(resource_handle)),
@@ -717,13 +835,18 @@ class ShuffleDatasetOp::DatasetV3 : public ShuffleDatasetBase {
     AttrValue reshuffle_each_iteration;
     b->BuildAttrValue(seed_generator_->reshuffle_each_iteration(),
                       &reshuffle_each_iteration);
-    TF_RETURN_IF_ERROR(
-        b->AddDataset(this,
-                      {input_graph_node, buffer_size_node, seed_node,
-                       seed2_node, resource_handle_node},  // Inputs
-                      {std::make_pair(kReshuffleEachIteration,
-                                      reshuffle_each_iteration)},  // Attrs
-                      output));
+    AttrValue spill_directory;
+    b->BuildAttrValue(spill_directory_, &spill_directory);
+    AttrValue spill_run_size;
+    b->BuildAttrValue(spill_run_size_, &spill_run_size);
+    TF_RETURN_IF_ERROR(b->AddDataset(
+        this,
+        {input_graph_node, buffer_size_node, seed_node, seed2_node,
+         resource_handle_node},  // Inputs
+        {std::make_pair(kReshuffleEachIteration, reshuffle_each_iteration),
+         std::make_pair(kSpillDirectory, spill_directory),
+         std::make_pair(kSpillRunSize, spill_run_size)},  // Attrs
+        output));
     return OkStatus();
   }
 
@@ -749,6 +872,16 @@ ShuffleDatasetOp::ShuffleDatasetOp(OpKernelConstruction* ctx)
     OP_REQUIRES_OK(
         ctx, ctx->GetAttr(kReshuffleEachIteration, &reshuffle_each_iteration_));
   }
+  if (ctx->HasAttr(kSpillDirectory)) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr(kSpillDirectory, &spill_directory_));
+  }
+  if (ctx->HasAttr(kSpillRunSize)) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr(kSpillRunSize, &spill_run_size_));
+    OP_REQUIRES(ctx, spill_directory_.empty() || spill_run_size_ > 0,
+                errors::InvalidArgument(
+                    "spill_run_size must be greater than zero, got ",
+                    spill_run_size_));
+  }
 }
 
 void ShuffleDatasetOp::MakeDataset(OpKernelContext* ctx, DatasetBase* input,
@@ -800,9 +933,9 @@ void ShuffleDatasetOp::MakeDataset(OpKernelContext* ctx, DatasetBase* input,
     }
 
     // Ownership of manager is transferred onto `DatasetV3`.
-    *output = new ShuffleDatasetOp::DatasetV3(ctx, input, buffer_size, count,
-                                              std::move(seeds), manager,
-                                              std::move(handle), owns_resource);
+    *output = new ShuffleDatasetOp::DatasetV3(
+        ctx, input, buffer_size, count, std::move(seeds), manager,
+        std::move(handle), owns_resource, spill_directory_, spill_run_size_);
   } else if (op_version_ == 2) {
     auto handle = HandleFromInput(ctx, 2);
     SeedGeneratorManager* manager = nullptr;
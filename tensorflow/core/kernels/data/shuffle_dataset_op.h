@@ -30,6 +30,8 @@ class ShuffleDatasetOpBase : public UnaryDatasetOpKernel {
   static constexpr const char* const kOutputShapes = "output_shapes";
   static constexpr const char* const kReshuffleEachIteration =
       "reshuffle_each_iteration";
+  static constexpr const char* const kSpillDirectory = "spill_directory";
+  static constexpr const char* const kSpillRunSize = "spill_run_size";
 
   explicit ShuffleDatasetOpBase(OpKernelConstruction* ctx);
 
@@ -53,6 +55,8 @@ class ShuffleDatasetOp : public ShuffleDatasetOpBase {
   class DatasetV3;
   int op_version_ = 0;
   bool reshuffle_each_iteration_ = true;
+  std::string spill_directory_;
+  int64_t spill_run_size_ = 0;
 };
 
 class ShuffleAndRepeatDatasetOp : public ShuffleDatasetOpBase {
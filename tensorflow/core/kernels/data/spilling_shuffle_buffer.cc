@@ -0,0 +1,389 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/kernels/data/spilling_shuffle_buffer.h"
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "tensorflow/core/data/serialization_utils.h"
+#include "tensorflow/core/framework/metrics.h"
+#include "tensorflow/core/lib/io/compression.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/random/random.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/stringprintf.h"
+
+namespace tensorflow {
+namespace data {
+namespace {
+
+constexpr char kFilling[] = "filling";
+constexpr char kWindow[] = "window";
+constexpr char kRun[] = "run";
+constexpr char kNumWindows[] = "num_windows";
+constexpr char kNumRuns[] = "num_runs";
+constexpr char kNumElements[] = "num_elements";
+constexpr char kNumRead[] = "num_read";
+constexpr char kOffset[] = "offset";
+constexpr char kFilename[] = "filename";
+constexpr char kElements[] = "elements";
+
+// Returns a uniformly distributed random number in [0, n).
+uint64 RandomIndex(const SpillingShuffleBuffer::RandomFn& random, uint64 n) {
+  if (n <= std::numeric_limits<uint32>::max()) {
+    return random() % n;
+  }
+  const uint64 high = random();
+  const uint64 low = random();
+  return ((high << 32) | low) % n;
+}
+
+}  // namespace
+
+SpillingShuffleBuffer::SpillingShuffleBuffer(Env* env,
+                                             const std::string& directory,
+                                             const DataTypeVector& dtypes,
+                                             int64_t buffer_size,
+                                             int64_t run_size,
+                                             int64_t max_open_runs)
+    : env_(env),
+      directory_(directory),
+      dtypes_(dtypes),
+      buffer_size_(buffer_size),
+      run_size_(run_size),
+      max_open_runs_(max_open_runs),
+      file_prefix_(io::JoinPath(
+          directory, strings::Printf("shuffle_spill_%016llx",
+                                     static_cast<unsigned long long>(
+                                         random::New64())))) {
+  DCHECK_GT(run_size_, 0);
+  DCHECK_GT(max_open_runs_, 1);
+}
+
+SpillingShuffleBuffer::~SpillingShuffleBuffer() {
+  auto delete_runs = [this](const Window& window) {
+    for (const Run& run : window.runs) {
+      DeleteRunFile(run.filename);
+    }
+  };
+  delete_runs(filling_);
+  for (const Window& window : sealed_windows_) {
+    delete_runs(window);
+  }
+  if (!checkpointed_files_.empty()) {
+    VLOG(1) << "Keeping " << checkpointed_files_.size()
+            << " shuffle buffer run files in " << directory_
+            << " that are referenced by the latest checkpoint.";
+  }
+}
+
+Status SpillingShuffleBuffer::Add(std::vector<Tensor> element,
+                                  const RandomFn& random) {
+  filling_.elements.push_back(std::move(element));
+  filling_.num_elements++;
+  if (filling_.elements.size() >= run_size_) {
+    TF_RETURN_IF_ERROR(Spill(random));
+  }
+  if (buffer_size_ > 0 && filling_.num_elements >= buffer_size_) {
+    TF_RETURN_IF_ERROR(Seal(random));
+  }
+  return OkStatus();
+}
+
+Status SpillingShuffleBuffer::Seal(const RandomFn& random) {
+  if (filling_.num_elements == 0) {
+    return OkStatus();
+  }
+  Shuffle(random, &filling_.elements);
+  TF_RETURN_IF_ERROR(MergeRuns(random, &filling_));
+  num_sealed_elements_ += filling_.num_elements;
+  sealed_windows_.push_back(std::move(filling_));
+  filling_ = Window();
+  return OkStatus();
+}
+
+Status SpillingShuffleBuffer::Remove(const RandomFn& random,
+                                     std::vector<Tensor>* element) {
+  DCHECK_GT(num_sealed_elements_, 0);
+  Window& window = sealed_windows_.front();
+  uint64 index = RandomIndex(random, window.num_elements);
+  if (index < window.elements.size()) {
+    *element = std::move(window.elements.back());
+    window.elements.pop_back();
+  } else {
+    index -= window.elements.size();
+    auto it = window.runs.begin();
+    while (index >= it->num_elements - it->num_read) {
+      index -= it->num_elements - it->num_read;
+      ++it;
+      DCHECK(it != window.runs.end());
+    }
+    TF_RETURN_IF_ERROR(ReadFromRun(&*it, element));
+    if (it->num_read == it->num_elements) {
+      FinishRun(&*it);
+      window.runs.erase(it);
+    }
+  }
+  window.num_elements--;
+  num_sealed_elements_--;
+  if (window.num_elements == 0) {
+    DCHECK(window.runs.empty());
+    sealed_windows_.pop_front();
+  }
+  return OkStatus();
+}
+
+void SpillingShuffleBuffer::Shuffle(
+    const RandomFn& random, std::vector<std::vector<Tensor>>* elements) {
+  for (int64_t i = static_cast<int64_t>(elements->size()) - 1; i > 0; --i) {
+    std::swap((*elements)[i], (*elements)[RandomIndex(random, i + 1)]);
+  }
+}
+
+std::string SpillingShuffleBuffer::NewRunFilename() {
+  return absl::StrCat(file_prefix_, "_", next_run_id_++, ".tfrecord");
+}
+
+Status SpillingShuffleBuffer::Spill(const RandomFn& random) {
+  if (!directory_created_) {
+    TF_RETURN_IF_ERROR(env_->RecursivelyCreateDir(directory_));
+    directory_created_ = true;
+  }
+  Shuffle(random, &filling_.elements);
+  Run run;
+  run.filename = NewRunFilename();
+  run.num_elements = filling_.elements.size();
+  snapshot_util::TFRecordWriter writer(run.filename, io::compression::kNone);
+  TF_RETURN_IF_ERROR(writer.Initialize(env_));
+  for (const std::vector<Tensor>& element : filling_.elements) {
+    TF_RETURN_IF_ERROR(writer.WriteTensors(element));
+  }
+  TF_RETURN_IF_ERROR(writer.Close());
+  uint64 file_size = 0;
+  if (env_->GetFileSize(run.filename, &file_size).ok()) {
+    metrics::RecordTFDataShuffleSpillBytesWritten(file_size);
+  }
+  VLOG(2) << "Spilled " << run.num_elements << " shuffle buffer elements ("
+          << file_size << " bytes) to " << run.filename;
+  filling_.runs.push_back(std::move(run));
+  filling_.elements.clear();
+  return OkStatus();
+}
+
+Status SpillingShuffleBuffer::MergeRuns(const RandomFn& random,
+                                        Window* window) {
+  while (window->runs.size() > max_open_runs_) {
+    TF_RETURN_IF_ERROR(MergeFirstRuns(random, max_open_runs_, window));
+  }
+  return OkStatus();
+}
+
+Status SpillingShuffleBuffer::MergeFirstRuns(const RandomFn& random,
+                                             int64_t num_runs,
+                                             Window* window) {
+  Run merged;
+  merged.filename = NewRunFilename();
+  int64_t num_left = 0;
+  for (int64_t i = 0; i < num_runs; ++i) {
+    const Run& run = window->runs[i];
+    num_left += run.num_elements - run.num_read;
+  }
+  merged.num_elements = num_left;
+  snapshot_util::TFRecordWriter writer(merged.filename,
+                                       io::compression::kNone);
+  TF_RETURN_IF_ERROR(writer.Initialize(env_));
+  // As in `Remove()`, drawing from each run with probability proportional to
+  // its remaining elements merges random permutations into one.
+  std::vector<Tensor> element;
+  while (num_left > 0) {
+    uint64 index = RandomIndex(random, num_left);
+    int64_t i = 0;
+    while (index >= window->runs[i].num_elements - window->runs[i].num_read) {
+      index -= window->runs[i].num_elements - window->runs[i].num_read;
+      ++i;
+    }
+    TF_RETURN_IF_ERROR(ReadFromRun(&window->runs[i], &element));
+    TF_RETURN_IF_ERROR(writer.WriteTensors(element));
+    --num_left;
+  }
+  TF_RETURN_IF_ERROR(writer.Close());
+  uint64 file_size = 0;
+  if (env_->GetFileSize(merged.filename, &file_size).ok()) {
+    metrics::RecordTFDataShuffleSpillBytesWritten(file_size);
+  }
+  VLOG(2) << "Merged " << num_runs << " shuffle buffer runs ("
+          << merged.num_elements << " elements) into " << merged.filename;
+  for (int64_t i = 0; i < num_runs; ++i) {
+    FinishRun(&window->runs.front());
+    window->runs.pop_front();
+  }
+  window->runs.push_back(std::move(merged));
+  return OkStatus();
+}
+
+Status SpillingShuffleBuffer::ReadFromRun(Run* run,
+                                          std::vector<Tensor>* element) {
+  if (!run->reader) {
+    run->reader = std::make_unique<snapshot_util::TFRecordReader>(
+        run->filename, io::compression::kNone, dtypes_);
+    TF_RETURN_IF_ERROR(run->reader->Initialize(env_));
+    // Resume after the elements read before the buffer was restored.
+    run->reader->Seek(run->offset);
+  }
+  element->clear();
+  Status s = run->reader->ReadTensors(element);
+  if (errors::IsOutOfRange(s)) {
+    return errors::DataLoss("Shuffle buffer run file ", run->filename,
+                            " ended after ", run->num_read, " of ",
+                            run->num_elements, " elements.");
+  }
+  TF_RETURN_IF_ERROR(s);
+  run->num_read++;
+  run->offset = run->reader->offset();
+  return OkStatus();
+}
+
+void SpillingShuffleBuffer::FinishRun(Run* run) {
+  DCHECK_EQ(run->num_read, run->num_elements);
+  run->reader.reset();
+  uint64 file_size = 0;
+  if (env_->GetFileSize(run->filename, &file_size).ok()) {
+    metrics::RecordTFDataShuffleSpillBytesRead(file_size);
+  }
+  DeleteRunFile(run->filename);
+}
+
+void SpillingShuffleBuffer::DeleteRunFile(const std::string& filename) {
+  if (checkpointed_files_.contains(filename)) {
+    return;
+  }
+  Status s = env_->DeleteFile(filename);
+  if (!s.ok()) {
+    LOG(WARNING) << "Failed to delete shuffle buffer run file " << filename
+                 << ": " << s;
+  }
+}
+
+Status SpillingShuffleBuffer::Save(IteratorStateWriter* writer,
+                                   const std::string& prefix) {
+  TF_RETURN_IF_ERROR(
+      writer->WriteScalar(prefix, kNumWindows, sealed_windows_.size()));
+  for (int64_t i = 0; i < sealed_windows_.size(); ++i) {
+    TF_RETURN_IF_ERROR(SaveWindow(
+        writer, absl::StrCat(prefix, "::", kWindow, "_", i),
+        sealed_windows_[i]));
+  }
+  TF_RETURN_IF_ERROR(
+      SaveWindow(writer, absl::StrCat(prefix, "::", kFilling), filling_));
+
+  // The files referenced by the previous checkpoint that are not referenced by
+  // this one have been read back already.
+  absl::flat_hash_set<std::string> previous_files;
+  previous_files.swap(checkpointed_files_);
+  auto add_runs = [this](const Window& window) {
+    for (const Run& run : window.runs) {
+      checkpointed_files_.insert(run.filename);
+    }
+  };
+  add_runs(filling_);
+  for (const Window& window : sealed_windows_) {
+    add_runs(window);
+  }
+  for (const std::string& filename : previous_files) {
+    DeleteRunFile(filename);
+  }
+  return OkStatus();
+}
+
+Status SpillingShuffleBuffer::SaveWindow(IteratorStateWriter* writer,
+                                         const std::string& prefix,
+                                         const Window& window) {
+  TF_RETURN_IF_ERROR(
+      writer->WriteScalar(prefix, kNumElements, window.num_elements));
+  TF_RETURN_IF_ERROR(writer->WriteScalar(prefix, kNumRuns, window.runs.size()));
+  for (int64_t i = 0; i < window.runs.size(); ++i) {
+    const Run& run = window.runs[i];
+    const std::string run_prefix = absl::StrCat(prefix, "::", kRun, "_", i);
+    TF_RETURN_IF_ERROR(
+        writer->WriteScalar(run_prefix, kFilename, run.filename));
+    TF_RETURN_IF_ERROR(
+        writer->WriteScalar(run_prefix, kNumElements, run.num_elements));
+    TF_RETURN_IF_ERROR(writer->WriteScalar(run_prefix, kNumRead, run.num_read));
+    TF_RETURN_IF_ERROR(writer->WriteScalar(
+        run_prefix, kOffset, static_cast<int64_t>(run.offset)));
+  }
+  return WriteElementsToCheckpoint(
+      writer, absl::StrCat(prefix, "::", kElements), window.elements);
+}
+
+Status SpillingShuffleBuffer::Restore(IteratorContext* ctx,
+                                      IteratorStateReader* reader,
+                                      const std::string& prefix) {
+  DCHECK_EQ(num_sealed_elements_, 0);
+  DCHECK_EQ(filling_.num_elements, 0);
+  int64_t num_windows;
+  TF_RETURN_IF_ERROR(reader->ReadScalar(prefix, kNumWindows, &num_windows));
+  for (int64_t i = 0; i < num_windows; ++i) {
+    Window window;
+    TF_RETURN_IF_ERROR(RestoreWindow(
+        ctx, reader, absl::StrCat(prefix, "::", kWindow, "_", i), &window));
+    num_sealed_elements_ += window.num_elements;
+    sealed_windows_.push_back(std::move(window));
+  }
+  return RestoreWindow(ctx, reader, absl::StrCat(prefix, "::", kFilling),
+                       &filling_);
+}
+
+Status SpillingShuffleBuffer::RestoreWindow(IteratorContext* ctx,
+                                            IteratorStateReader* reader,
+                                            const std::string& prefix,
+                                            Window* window) {
+  TF_RETURN_IF_ERROR(
+      reader->ReadScalar(prefix, kNumElements, &window->num_elements));
+  int64_t num_runs;
+  TF_RETURN_IF_ERROR(reader->ReadScalar(prefix, kNumRuns, &num_runs));
+  for (int64_t i = 0; i < num_runs; ++i) {
+    const std::string run_prefix = absl::StrCat(prefix, "::", kRun, "_", i);
+    Run run;
+    tstring filename;
+    TF_RETURN_IF_ERROR(reader->ReadScalar(run_prefix, kFilename, &filename));
+    run.filename = filename;
+    TF_RETURN_IF_ERROR(
+        reader->ReadScalar(run_prefix, kNumElements, &run.num_elements));
+    TF_RETURN_IF_ERROR(reader->ReadScalar(run_prefix, kNumRead, &run.num_read));
+    int64_t offset;
+    TF_RETURN_IF_ERROR(reader->ReadScalar(run_prefix, kOffset, &offset));
+    run.offset = offset;
+    Status s = env_->FileExists(run.filename);
+    if (!s.ok()) {
+      return errors::FailedPrecondition(
+          "Failed to restore the shuffle buffer: run file ", run.filename,
+          " is not available: ", s.message());
+    }
+    checkpointed_files_.insert(run.filename);
+    window->runs.push_back(std::move(run));
+  }
+  return ReadElementsFromCheckpoint(
+      ctx, reader, absl::StrCat(prefix, "::", kElements), &window->elements);
+}
+
+}  // namespace data
+}  // namespace tensorflow
@@ -0,0 +1,183 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_KERNELS_DATA_SPILLING_SHUFFLE_BUFFER_H_
+#define TENSORFLOW_CORE_KERNELS_DATA_SPILLING_SHUFFLE_BUFFER_H_
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_set.h"
+#include "tensorflow/core/data/snapshot_utils.h"
+#include "tensorflow/core/framework/dataset.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/status.h"
+
+namespace tensorflow {
+namespace data {
+
+// A shuffle buffer that holds up to `buffer_size` elements while keeping at
+// most `run_size` of them in memory per window.
+//
+// Elements are added to a filling window. Whenever the filling window has
+// `run_size` elements in memory, they are shuffled and spilled to a run file
+// in `directory`, in the TFRecord format of `snapshot_util::TFRecordWriter`.
+// The filling window is sealed once it holds `buffer_size` elements (never, if
+// `buffer_size` is `kUnknownCardinality`) or when `Seal()` is called, e.g. at
+// the end of an input epoch.
+//
+// Sealed windows are served in the order in which they were sealed, each in a
+// uniformly random order: `Remove()` draws from a run (or the shuffled
+// in-memory remainder of the window) with probability proportional to the
+// number of elements the run has left, and reads the runs sequentially. As the
+// runs are random permutations, this yields a uniformly random permutation of
+// the window while only the in-memory remainder and one open reader per run
+// are kept in memory. Windows are disjoint: unlike the in-memory shuffle
+// buffer, which slides over the input, no element is ever output before all
+// elements of the previous window.
+//
+// To bound the number of open readers, a window that has more than
+// `max_open_runs` runs when it is sealed has its runs merged, `max_open_runs`
+// at a time, into larger random permutations until it has at most
+// `max_open_runs` runs. Runs are read from saved byte offsets, so restoring
+// the buffer does not re-read the elements that were already served.
+//
+// Run files are deleted once they have been read back or when the buffer is
+// destroyed, except for the files referenced by the most recent `Save()` (or
+// `Restore()`), which are kept until the next `Save()` so that the latest
+// checkpoint can be restored.
+//
+// This class is thread-compatible.
+class SpillingShuffleBuffer {
+ public:
+  // Returns a uniformly distributed random number.
+  using RandomFn = std::function<uint32()>;
+
+  // The default maximum number of runs read from concurrently.
+  static constexpr int64_t kDefaultMaxOpenRuns = 64;
+
+  SpillingShuffleBuffer(Env* env, const std::string& directory,
+                        const DataTypeVector& dtypes, int64_t buffer_size,
+                        int64_t run_size,
+                        int64_t max_open_runs = kDefaultMaxOpenRuns);
+  ~SpillingShuffleBuffer();
+
+  // Number of elements in the sealed windows.
+  int64_t num_sealed_elements() const { return num_sealed_elements_; }
+  // Number of sealed windows.
+  int64_t num_sealed_windows() const { return sealed_windows_.size(); }
+  // Number of elements in the filling window.
+  int64_t num_filling_elements() const { return filling_.num_elements; }
+
+  // Adds `element` to the filling window.
+  Status Add(std::vector<Tensor> element, const RandomFn& random);
+
+  // Seals the filling window, if it is not empty.
+  Status Seal(const RandomFn& random);
+
+  // Removes a random element of the first sealed window. Requires
+  // `num_sealed_elements() > 0`.
+  Status Remove(const RandomFn& random, std::vector<Tensor>* element);
+
+  // Saves the state of the buffer under `prefix`. Spilled elements are not
+  // saved, only the names of their run files and the read positions.
+  Status Save(IteratorStateWriter* writer, const std::string& prefix);
+
+  // Restores the state saved by `Save()` into an empty buffer.
+  Status Restore(IteratorContext* ctx, IteratorStateReader* reader,
+                 const std::string& prefix);
+
+ private:
+  struct Run {
+    std::string filename;
+    int64_t num_elements = 0;
+    int64_t num_read = 0;
+    // Byte offset of the next element to read in the run file.
+    uint64 offset = 0;
+    std::unique_ptr<snapshot_util::TFRecordReader> reader;
+  };
+
+  struct Window {
+    std::deque<Run> runs;
+    // Elements that have not been spilled. For sealed windows, they are
+    // shuffled and served from the back.
+    std::vector<std::vector<Tensor>> elements;
+    // The number of elements added to the window while filling, and the number
+    // of elements left once sealed.
+    int64_t num_elements = 0;
+  };
+
+  // Shuffles `elements` in place.
+  static void Shuffle(const RandomFn& random,
+                      std::vector<std::vector<Tensor>>* elements);
+
+  // Returns the name of a new run file.
+  std::string NewRunFilename();
+
+  // Spills the in-memory elements of the filling window to a new run.
+  Status Spill(const RandomFn& random);
+
+  // Merges runs of `window` until it has at most `max_open_runs_` runs.
+  Status MergeRuns(const RandomFn& random, Window* window);
+
+  // Replaces the first `num_runs` runs of `window` with a single run that
+  // holds a uniformly random permutation of their elements.
+  Status MergeFirstRuns(const RandomFn& random, int64_t num_runs,
+                        Window* window);
+
+  // Reads the next element of `run`, opening it if needed.
+  Status ReadFromRun(Run* run, std::vector<Tensor>* element);
+
+  // Closes the reader of `run`, records the bytes read back, and deletes its
+  // file. Requires that all elements of `run` have been read.
+  void FinishRun(Run* run);
+
+  // Deletes the file of a run that has been read back or dropped, unless it is
+  // referenced by the latest checkpoint.
+  void DeleteRunFile(const std::string& filename);
+
+  Status SaveWindow(IteratorStateWriter* writer, const std::string& prefix,
+                    const Window& window);
+  Status RestoreWindow(IteratorContext* ctx, IteratorStateReader* reader,
+                       const std::string& prefix, Window* window);
+
+  Env* const env_;
+  const std::string directory_;
+  const DataTypeVector dtypes_;
+  const int64_t buffer_size_;
+  const int64_t run_size_;
+  const int64_t max_open_runs_;
+  // Unique prefix of the run files written by this buffer.
+  const std::string file_prefix_;
+  int64_t next_run_id_ = 0;
+  bool directory_created_ = false;
+
+  Window filling_;
+  std::deque<Window> sealed_windows_;
+  int64_t num_sealed_elements_ = 0;
+
+  // Run files referenced by the latest checkpoint.
+  absl::flat_hash_set<std::string> checkpointed_files_;
+};
+
+}  // namespace data
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_KERNELS_DATA_SPILLING_SHUFFLE_BUFFER_H_
@@ -0,0 +1,242 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/kernels/data/spilling_shuffle_buffer.h"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/data/dataset_test_base.h"
+#include "tensorflow/core/data/serialization_utils.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/monitoring/cell_reader.h"
+#include "tensorflow/core/lib/random/philox_random.h"
+#include "tensorflow/core/lib/random/random_distributions.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace data {
+namespace {
+
+using ::tensorflow::monitoring::testing::CellReader;
+using ::testing::ElementsAreArray;
+using ::testing::UnorderedElementsAreArray;
+
+class SpillingShuffleBufferTest : public DatasetOpsTestBase {
+ protected:
+  SpillingShuffleBufferTest()
+      : parent_generator_(/*seed=*/1, /*seed2=*/2),
+        generator_(&parent_generator_),
+        random_([this]() {
+          num_random_samples_++;
+          return generator_();
+        }) {}
+
+  void SetUp() override {
+    directory_ = io::JoinPath(
+        testing::TmpDir(),
+        ::testing::UnitTest::GetInstance()->current_test_info()->name());
+    TF_ASSERT_OK(Env::Default()->RecursivelyCreateDir(directory_));
+  }
+
+  std::unique_ptr<SpillingShuffleBuffer> MakeBuffer(
+      int64_t buffer_size, int64_t run_size,
+      int64_t max_open_runs = SpillingShuffleBuffer::kDefaultMaxOpenRuns) {
+    return std::make_unique<SpillingShuffleBuffer>(
+        Env::Default(), directory_, DataTypeVector{DT_INT64}, buffer_size,
+        run_size, max_open_runs);
+  }
+
+  int64_t Remove(SpillingShuffleBuffer* buffer) {
+    std::vector<Tensor> element;
+    TF_CHECK_OK(buffer->Remove(random_, &element));
+    CHECK_EQ(element.size(), 1);
+    return element[0].scalar<int64_t>()();
+  }
+
+  // Resets the random number generator to the state after `num_samples`
+  // samples.
+  void ResetRandom(int64_t num_samples) {
+    parent_generator_ = random::PhiloxRandom(/*seed=*/1, /*seed2=*/2);
+    generator_ =
+        random::SingleSampleAdapter<random::PhiloxRandom>(&parent_generator_);
+    generator_.Skip(num_samples);
+    num_random_samples_ = num_samples;
+  }
+
+  int NumFiles() {
+    std::vector<std::string> children;
+    TF_CHECK_OK(Env::Default()->GetChildren(directory_, &children));
+    return children.size();
+  }
+
+  std::string directory_;
+  random::PhiloxRandom parent_generator_;
+  random::SingleSampleAdapter<random::PhiloxRandom> generator_;
+  int64_t num_random_samples_ = 0;
+  SpillingShuffleBuffer::RandomFn random_;
+};
+
+std::vector<Tensor> MakeElement(int64_t value) {
+  return {test::AsScalar<int64_t>(value)};
+}
+
+std::vector<int64_t> Range(int64_t start, int64_t end) {
+  std::vector<int64_t> range;
+  for (int64_t i = start; i < end; ++i) range.push_back(i);
+  return range;
+}
+
+TEST_F(SpillingShuffleBufferTest, ShufflesWindows) {
+  CellReader<int64_t> spill_bytes("/tensorflow/data/shuffle_spill_bytes");
+  auto buffer = MakeBuffer(/*buffer_size=*/100, /*run_size=*/16);
+  for (int64_t i = 0; i < 250; ++i) {
+    TF_ASSERT_OK(buffer->Add(MakeElement(i), random_));
+  }
+  TF_ASSERT_OK(buffer->Seal(random_));
+  EXPECT_EQ(buffer->num_sealed_windows(), 3);
+  EXPECT_EQ(buffer->num_sealed_elements(), 250);
+  EXPECT_EQ(buffer->num_filling_elements(), 0);
+  // 6 full runs per full window, and 3 full runs for the last window.
+  EXPECT_EQ(NumFiles(), 15);
+  const int64_t bytes_written = spill_bytes.Delta("write");
+  EXPECT_GT(bytes_written, 0);
+
+  // Each window is produced before the next one, in a random order.
+  std::vector<int64_t> window;
+  for (int64_t start : {0, 100, 200}) {
+    window.clear();
+    for (int64_t i = start; i < std::min<int64_t>(start + 100, 250); ++i) {
+      window.push_back(Remove(buffer.get()));
+    }
+    std::vector<int64_t> expected = Range(start, start + window.size());
+    EXPECT_THAT(window, UnorderedElementsAreArray(expected));
+    EXPECT_NE(window, expected);
+  }
+  EXPECT_EQ(buffer->num_sealed_elements(), 0);
+  EXPECT_EQ(NumFiles(), 0);
+  EXPECT_EQ(spill_bytes.Delta("read"), bytes_written);
+}
+
+TEST_F(SpillingShuffleBufferTest, MergesRunsWhenSealing) {
+  auto buffer = MakeBuffer(/*buffer_size=*/100, /*run_size=*/8,
+                           /*max_open_runs=*/3);
+  for (int64_t i = 0; i < 100; ++i) {
+    TF_ASSERT_OK(buffer->Add(MakeElement(i), random_));
+  }
+  // The 12 runs of the window are merged 3 at a time until 2 runs are left.
+  EXPECT_EQ(buffer->num_sealed_windows(), 1);
+  EXPECT_EQ(NumFiles(), 2);
+  std::vector<int64_t> elements;
+  while (buffer->num_sealed_elements() > 0) {
+    elements.push_back(Remove(buffer.get()));
+  }
+  EXPECT_THAT(elements, UnorderedElementsAreArray(Range(0, 100)));
+  EXPECT_NE(elements, Range(0, 100));
+  EXPECT_EQ(NumFiles(), 0);
+}
+
+TEST_F(SpillingShuffleBufferTest, ShuffleAll) {
+  auto buffer = MakeBuffer(/*buffer_size=*/kUnknownCardinality,
+                           /*run_size=*/10);
+  for (int64_t i = 0; i < 95; ++i) {
+    TF_ASSERT_OK(buffer->Add(MakeElement(i), random_));
+  }
+  EXPECT_EQ(buffer->num_sealed_elements(), 0);
+  TF_ASSERT_OK(buffer->Seal(random_));
+  std::vector<int64_t> elements;
+  while (buffer->num_sealed_elements() > 0) {
+    elements.push_back(Remove(buffer.get()));
+  }
+  EXPECT_THAT(elements, UnorderedElementsAreArray(Range(0, 95)));
+}
+
+TEST_F(SpillingShuffleBufferTest, SaveAndRestore) {
+  auto buffer = MakeBuffer(/*buffer_size=*/50, /*run_size=*/8);
+  for (int64_t i = 0; i < 70; ++i) {
+    TF_ASSERT_OK(buffer->Add(MakeElement(i), random_));
+  }
+  std::vector<int64_t> produced;
+  for (int i = 0; i < 20; ++i) {
+    produced.push_back(Remove(buffer.get()));
+  }
+
+  VariantTensorDataWriter writer;
+  TF_ASSERT_OK(buffer->Save(&writer, "prefix"));
+  std::vector<const VariantTensorData*> data;
+  writer.GetData(&data);
+
+  // The expected output after the checkpoint, from the original buffer.
+  const int64_t num_random_samples = num_random_samples_;
+  std::vector<int64_t> expected;
+  TF_ASSERT_OK(buffer->Seal(random_));
+  while (buffer->num_sealed_elements() > 0) {
+    expected.push_back(Remove(buffer.get()));
+  }
+  // The files referenced by the checkpoint outlive the buffer.
+  buffer.reset();
+  EXPECT_GT(NumFiles(), 0);
+
+  ResetRandom(num_random_samples);
+  auto restored = MakeBuffer(/*buffer_size=*/50, /*run_size=*/8);
+  // Initializes `iterator_ctx_`.
+  TF_ASSERT_OK(Initialize(RangeDatasetParams(0, 1, 1)));
+  VariantTensorDataReader reader(data);
+  TF_ASSERT_OK(restored->Restore(iterator_ctx_.get(), &reader, "prefix"));
+  EXPECT_EQ(restored->num_sealed_elements(), 30);
+  EXPECT_EQ(restored->num_filling_elements(), 20);
+  TF_ASSERT_OK(restored->Seal(random_));
+  std::vector<int64_t> actual;
+  while (restored->num_sealed_elements() > 0) {
+    actual.push_back(Remove(restored.get()));
+  }
+  EXPECT_THAT(actual, ElementsAreArray(expected));
+
+  produced.insert(produced.end(), actual.begin(), actual.end());
+  EXPECT_THAT(produced, UnorderedElementsAreArray(Range(0, 70)));
+
+  // The next checkpoint releases the files of the previous one.
+  VariantTensorDataWriter next_writer;
+  TF_ASSERT_OK(restored->Save(&next_writer, "prefix"));
+  EXPECT_EQ(NumFiles(), 0);
+}
+
+TEST_F(SpillingShuffleBufferTest, RestoreFailsWithoutRunFiles) {
+  auto buffer = MakeBuffer(/*buffer_size=*/50, /*run_size=*/8);
+  for (int64_t i = 0; i < 20; ++i) {
+    TF_ASSERT_OK(buffer->Add(MakeElement(i), random_));
+  }
+  VariantTensorDataWriter writer;
+  TF_ASSERT_OK(buffer->Save(&writer, "prefix"));
+  std::vector<const VariantTensorData*> data;
+  writer.GetData(&data);
+  int64_t undeleted_files, undeleted_dirs;
+  TF_ASSERT_OK(Env::Default()->DeleteRecursively(directory_, &undeleted_files,
+                                                 &undeleted_dirs));
+
+  auto restored = MakeBuffer(/*buffer_size=*/50, /*run_size=*/8);
+  TF_ASSERT_OK(Initialize(RangeDatasetParams(0, 1, 1)));
+  VariantTensorDataReader reader(data);
+  EXPECT_TRUE(errors::IsFailedPrecondition(
+      restored->Restore(iterator_ctx_.get(), &reader, "prefix")));
+}
+
+}  // namespace
+}  // namespace data
+}  // namespace tensorflow
@@ -14,17 +14,27 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow/core/kernels/data/tf_record_dataset_op.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <list>
+
 #include "tensorflow/core/data/name_utils.h"
 #include "tensorflow/core/data/utils.h"
 #include "tensorflow/core/framework/metrics.h"
 #include "tensorflow/core/framework/partial_tensor_shape.h"
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/kernels/random_index_shuffle.h"
+#include "tensorflow/core/lib/hash/hash.h"
 #include "tensorflow/core/lib/io/buffered_inputstream.h"
 #include "tensorflow/core/lib/io/inputbuffer.h"
 #include "tensorflow/core/lib/io/random_inputstream.h"
 #include "tensorflow/core/lib/io/record_reader.h"
 #include "tensorflow/core/lib/io/zlib_compression_options.h"
 #include "tensorflow/core/lib/io/zlib_inputstream.h"
+#include "tensorflow/core/util/env_var.h"
+#include "tensorflow/tsl/lib/io/record_batch_reader.h"
+#include "tensorflow/tsl/lib/io/record_index.h"
 
 namespace tensorflow {
 namespace data {
@@ -36,13 +46,39 @@ namespace data {
 /* static */ constexpr const char* const TFRecordDatasetOp::kFileNames;
 /* static */ constexpr const char* const TFRecordDatasetOp::kCompressionType;
 /* static */ constexpr const char* const TFRecordDatasetOp::kBufferSize;
+/* static */ constexpr const char* const TFRecordDatasetOp::kIndexShuffleSeed;
 
 constexpr char kCurrentFileIndex[] = "current_file_index";
+constexpr char kEpoch[] = "epoch";
 constexpr char kOffset[] = "offset";
+constexpr char kPosition[] = "position";
 constexpr char kGcsFsPrefix[] = "gs://";
 constexpr char kS3FsPrefix[] = "s3://";
 constexpr int64_t kCloudTpuBlockSize = 127LL << 20;  // 127MB.
 constexpr int64_t kS3BlockSize = kCloudTpuBlockSize;
+// The number of rounds of the permutation of the records read with an index.
+constexpr int32_t kIndexShuffleRounds = 8;
+// The maximum number of files that are kept open when reading with an index.
+constexpr int kMaxOpenIndexedFiles = 64;
+
+// Returns the number of buffer reads to keep outstanding per file, from the
+// TF_DATA_TFRECORD_NUM_OUTSTANDING_READS environment variable. The readers only
+// buffer more than one read for files that support batched reads (see
+// `RandomAccessFile::SupportsBatchedReads()`), so that e.g. GCS files do not
+// buffer several of their large blocks for no gain.
+int NumOutstandingReads() {
+  static const int num_outstanding_reads = []() {
+    int64_t value;
+    Status s = ReadInt64FromEnvVar("TF_DATA_TFRECORD_NUM_OUTSTANDING_READS",
+                                   /*default_val=*/1, &value);
+    if (!s.ok()) {
+      LOG(WARNING) << s;
+      return 1;
+    }
+    return static_cast<int>(std::max<int64_t>(value, 1));
+  }();
+  return num_outstanding_reads;
+}
 
 bool is_cloud_tpu_gcs_fs() {
 #if (defined(PLATFORM_CLOUD_TPU) && defined(TPU_GCS_FS)) || \
@@ -55,19 +91,27 @@ bool is_cloud_tpu_gcs_fs() {
 class TFRecordDatasetOp::Dataset : public DatasetBase {
  public:
   explicit Dataset(OpKernelContext* ctx, std::vector<string> filenames,
-                   const string& compression_type, int64_t buffer_size)
+                   const string& compression_type, int64_t buffer_size,
+                   int64_t index_shuffle_seed, bool reshuffle_each_iteration)
       : DatasetBase(DatasetContext(ctx)),
         filenames_(std::move(filenames)),
         compression_type_(compression_type),
+        index_shuffle_seed_(index_shuffle_seed),
+        reshuffle_each_iteration_(reshuffle_each_iteration),
         options_(io::RecordReaderOptions::CreateRecordReaderOptions(
             compression_type)) {
     if (buffer_size > 0) {
       options_.buffer_size = buffer_size;
+      options_.num_outstanding_reads = NumOutstandingReads();
     }
   }
 
   std::unique_ptr<IteratorBase> MakeIteratorInternal(
       const string& prefix) const override {
+    if (index_shuffle_seed_ >= 0) {
+      return std::make_unique<ShuffledIterator>(ShuffledIterator::Params{
+          this, name_utils::IteratorPrefix(kDatasetType, prefix)});
+    }
     return std::make_unique<Iterator>(Iterator::Params{
         this, name_utils::IteratorPrefix(kDatasetType, prefix)});
   }
@@ -103,8 +147,21 @@ class TFRecordDatasetOp::Dataset : public DatasetBase {
     TF_RETURN_IF_ERROR(b->AddScalar(compression_type_, &compression_type));
     Node* buffer_size = nullptr;
     TF_RETURN_IF_ERROR(b->AddScalar(options_.buffer_size, &buffer_size));
+    // The attrs are only set when they are used, so that the graphs of the
+    // other datasets can still be read by older binaries.
+    std::vector<std::pair<StringPiece, AttrValue>> attrs;
+    if (index_shuffle_seed_ >= 0) {
+      AttrValue index_shuffle_seed;
+      b->BuildAttrValue(index_shuffle_seed_, &index_shuffle_seed);
+      attrs.emplace_back(kIndexShuffleSeed, index_shuffle_seed);
+    }
+    if (reshuffle_each_iteration_) {
+      AttrValue reshuffle_each_iteration;
+      b->BuildAttrValue(reshuffle_each_iteration_, &reshuffle_each_iteration);
+      attrs.emplace_back(kReshuffleEachIteration, reshuffle_each_iteration);
+    }
     TF_RETURN_IF_ERROR(b->AddDataset(
-        this, {filenames, compression_type, buffer_size}, output));
+        this, {filenames, compression_type, buffer_size}, attrs, output));
     return OkStatus();
   }
 
@@ -123,11 +180,11 @@ class TFRecordDatasetOp::Dataset : public DatasetBase {
       mutex_lock l(mu_);
       do {
         // We are currently processing a file, so try to read the next record.
-        if (reader_) {
+        if (reader_ || batch_reader_) {
           out_tensors->emplace_back(ctx->allocator({}), DT_STRING,
                                     TensorShape({}));
           Status s =
-              reader_->ReadRecord(&out_tensors->back().scalar<tstring>()());
+              ReadRecordLocked(&out_tensors->back().scalar<tstring>()());
           if (s.ok()) {
             static monitoring::CounterCell* bytes_counter =
                 metrics::GetTFDataBytesReadCounter(kDatasetType);
@@ -169,10 +226,10 @@ class TFRecordDatasetOp::Dataset : public DatasetBase {
       do {
         // We are currently processing a file, so try to skip reading
         // the next (num_to_skip - *num_skipped) record.
-        if (reader_) {
+        if (reader_ || batch_reader_) {
           int last_num_skipped;
-          Status s = reader_->SkipRecords(num_to_skip - *num_skipped,
-                                          &last_num_skipped);
+          Status s = SkipRecordsLocked(num_to_skip - *num_skipped,
+                                       &last_num_skipped);
           *num_skipped += last_num_skipped;
           if (s.ok()) {
             *end_of_sequence = false;
@@ -218,6 +275,13 @@ class TFRecordDatasetOp::Dataset : public DatasetBase {
       if (reader_) {
         TF_RETURN_IF_ERROR(
             writer->WriteScalar(full_name(kOffset), reader_->TellOffset()));
+      } else if (batch_reader_) {
+        // The offset of the first record of the batch that was not returned.
+        const uint64 offset =
+            batch_index_ == 0
+                ? batch_reader_->TellOffset()
+                : batch_reader_->OffsetAfter(batch_[batch_index_ - 1]);
+        TF_RETURN_IF_ERROR(writer->WriteScalar(full_name(kOffset), offset));
       }
       return OkStatus();
     }
@@ -234,7 +298,11 @@ class TFRecordDatasetOp::Dataset : public DatasetBase {
         int64_t offset;
         TF_RETURN_IF_ERROR(reader->ReadScalar(full_name(kOffset), &offset));
         TF_RETURN_IF_ERROR(SetupStreamsLocked(ctx->env()));
-        TF_RETURN_IF_ERROR(reader_->SeekOffset(offset));
+        if (batch_reader_) {
+          TF_RETURN_IF_ERROR(batch_reader_->SeekOffset(offset));
+        } else {
+          TF_RETURN_IF_ERROR(reader_->SeekOffset(offset));
+        }
       }
       return OkStatus();
     }
@@ -252,17 +320,62 @@ class TFRecordDatasetOp::Dataset : public DatasetBase {
       TF_RETURN_IF_ERROR(env->NewRandomAccessFile(
           TranslateFileName(dataset()->filenames_[current_file_index_]),
           &file_));
-      reader_ = std::make_unique<io::SequentialRecordReader>(
-          file_.get(), dataset()->options_);
+      const io::RecordReaderOptions& options = dataset()->options_;
+      if (options.compression_type == io::RecordReaderOptions::NONE &&
+          options.buffer_size > 0) {
+        // Buffered uncompressed files are parsed a buffer at a time.
+        batch_reader_ = std::make_unique<tsl::io::RecordBatchReader>(
+            file_.get(), options.buffer_size, options.num_outstanding_reads);
+      } else {
+        reader_ = std::make_unique<io::SequentialRecordReader>(file_.get(),
+                                                               options);
+      }
       return OkStatus();
     }
 
     // Resets all reader streams.
     void ResetStreamsLocked() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
       reader_.reset();
+      batch_reader_.reset();
+      batch_.clear();
+      batch_index_ = 0;
       file_.reset();
     }
 
+    // Reads the next record of the current file into `*record`.
+    Status ReadRecordLocked(tstring* record) TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      if (reader_) {
+        return reader_->ReadRecord(record);
+      }
+      if (batch_index_ == batch_.size()) {
+        batch_index_ = 0;
+        TF_RETURN_IF_ERROR(batch_reader_->ReadBatch(&batch_));
+      }
+      const absl::string_view data = batch_[batch_index_++];
+      record->assign(data.data(), data.size());
+      return OkStatus();
+    }
+
+    // Skips the next `num_to_skip` records of the current file.
+    Status SkipRecordsLocked(int num_to_skip, int* num_skipped)
+        TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      if (reader_) {
+        return reader_->SkipRecords(num_to_skip, num_skipped);
+      }
+      *num_skipped = 0;
+      while (*num_skipped < num_to_skip) {
+        if (batch_index_ == batch_.size()) {
+          batch_index_ = 0;
+          TF_RETURN_IF_ERROR(batch_reader_->ReadBatch(&batch_));
+        }
+        const size_t n = std::min<size_t>(num_to_skip - *num_skipped,
+                                          batch_.size() - batch_index_);
+        batch_index_ += n;
+        *num_skipped += n;
+      }
+      return OkStatus();
+    }
+
     mutex mu_;
     size_t current_file_index_ TF_GUARDED_BY(mu_) = 0;
 
@@ -270,15 +383,271 @@ class TFRecordDatasetOp::Dataset : public DatasetBase {
     // we must destroy `reader_` before `file_`.
     std::unique_ptr<RandomAccessFile> file_ TF_GUARDED_BY(mu_);
     std::unique_ptr<io::SequentialRecordReader> reader_ TF_GUARDED_BY(mu_);
+    std::unique_ptr<tsl::io::RecordBatchReader> batch_reader_
+        TF_GUARDED_BY(mu_);
+    // The records of the last batch read by `batch_reader_`, of which the
+    // first `batch_index_` have been returned.
+    std::vector<absl::string_view> batch_ TF_GUARDED_BY(mu_);
+    size_t batch_index_ TF_GUARDED_BY(mu_) = 0;
+  };
+
+  // Reads the records of all the files in a random permutation, determined by
+  // `index_shuffle_seed_`, and locates each record with the index of its file
+  // (see record_index.h). The permutation is blocked so that at most
+  // `kMaxOpenIndexedFiles` files are read at a time: the order of the files is
+  // permuted, and then the records of each window of `kMaxOpenIndexedFiles`
+  // consecutive files in that order are permuted. The permutation is the same
+  // for every iterator unless `reshuffle_each_iteration_` is set, in which case
+  // each iterator of the dataset is a new epoch, permuted with a different key.
+  // The epoch and the position in the permutation are checkpointed, and
+  // skipping records reads none of them.
+  class ShuffledIterator : public DatasetIterator<Dataset> {
+   public:
+    explicit ShuffledIterator(const Params& params)
+        : DatasetIterator<Dataset>(params) {}
+
+    bool SymbolicCheckpointCompatible() const override { return true; }
+
+    Status Initialize(IteratorContext* ctx) override {
+      mutex_lock l(mu_);
+      // Only the sizes of the indices are read up front; the files are opened
+      // when their first record is read.
+      num_file_records_.reserve(dataset()->filenames_.size());
+      for (const string& filename : dataset()->filenames_) {
+        uint64 index_size;
+        TF_RETURN_IF_ERROR(ctx->env()->GetFileSize(
+            tsl::io::RecordIndexFileName(TranslateFileName(filename)),
+            &index_size));
+        uint64 num_records;
+        TF_RETURN_IF_ERROR(
+            tsl::io::RecordIndex::NumRecords(index_size, &num_records));
+        num_file_records_.push_back(num_records);
+        num_records_ += num_records;
+      }
+      files_.resize(dataset()->filenames_.size());
+      PermuteFilesLocked(dataset()->reshuffle_each_iteration_
+                             ? dataset()->num_epochs_.fetch_add(1)
+                             : 0);
+      return OkStatus();
+    }
+
+    Status GetNextInternal(IteratorContext* ctx,
+                           std::vector<Tensor>* out_tensors,
+                           bool* end_of_sequence) override {
+      mutex_lock l(mu_);
+      if (position_ == num_records_) {
+        *end_of_sequence = true;
+        return OkStatus();
+      }
+      // The position moves forward even if the record cannot be read, so that
+      // it works with ignore_errors.
+      const uint64 position = position_++;
+      const size_t window =
+          std::upper_bound(window_first_positions_.begin(),
+                           window_first_positions_.end(), position) -
+          window_first_positions_.begin() - 1;
+      const uint64 window_first_position = window_first_positions_[window];
+      const uint64 window_end_position =
+          window + 1 < window_first_positions_.size()
+              ? window_first_positions_[window + 1]
+              : num_records_;
+      const uint64 shuffled_position =
+          window_first_position +
+          Permute(position - window_first_position,
+                  window_end_position - window_first_position,
+                  /*stream=*/window + 1);
+      const size_t order =
+          std::upper_bound(first_positions_.begin(), first_positions_.end(),
+                           shuffled_position) -
+          first_positions_.begin() - 1;
+      IndexedFile* file;
+      TF_RETURN_IF_ERROR(GetFileLocked(ctx->env(), file_order_[order], &file));
+      uint64 offset;
+      TF_RETURN_IF_ERROR(file->index->Lookup(
+          shuffled_position - first_positions_[order], &offset));
+      Tensor record_tensor(ctx->allocator({}), DT_STRING, TensorShape({}));
+      TF_RETURN_IF_ERROR(
+          file->reader->ReadRecord(&offset, &record_tensor.scalar<tstring>()()));
+      static monitoring::CounterCell* bytes_counter =
+          metrics::GetTFDataBytesReadCounter(kDatasetType);
+      bytes_counter->IncrementBy(record_tensor.scalar<tstring>()().size());
+      out_tensors->push_back(std::move(record_tensor));
+      *end_of_sequence = false;
+      return OkStatus();
+    }
+
+    Status SkipInternal(IteratorContext* ctx, int num_to_skip,
+                        bool* end_of_sequence, int* num_skipped) override {
+      mutex_lock l(mu_);
+      *num_skipped = std::min<uint64>(num_to_skip, num_records_ - position_);
+      position_ += *num_skipped;
+      *end_of_sequence = *num_skipped < num_to_skip;
+      return OkStatus();
+    }
+
+   protected:
+    std::shared_ptr<model::Node> CreateNode(
+        IteratorContext* ctx, model::Node::Args args) const override {
+      return model::MakeSourceNode(std::move(args));
+    }
+
+    Status SaveInternal(SerializationContext* ctx,
+                        IteratorStateWriter* writer) override {
+      mutex_lock l(mu_);
+      TF_RETURN_IF_ERROR(writer->WriteScalar(full_name(kEpoch), epoch_));
+      return writer->WriteScalar(full_name(kPosition),
+                                 static_cast<int64_t>(position_));
+    }
+
+    Status RestoreInternal(IteratorContext* ctx,
+                           IteratorStateReader* reader) override {
+      mutex_lock l(mu_);
+      int64_t epoch;
+      TF_RETURN_IF_ERROR(reader->ReadScalar(full_name(kEpoch), &epoch));
+      int64_t position;
+      TF_RETURN_IF_ERROR(reader->ReadScalar(full_name(kPosition), &position));
+      if (position < 0 || static_cast<uint64>(position) > num_records_) {
+        return errors::FailedPrecondition(
+            "Restored position ", position, " is out of range: the files have ",
+            num_records_, " records");
+      }
+      if (epoch != epoch_) {
+        // The open files belong to the window of the old permutation.
+        for (std::unique_ptr<IndexedFile>& file : files_) file.reset();
+        lru_files_.clear();
+        PermuteFilesLocked(epoch);
+      }
+      // The next iterators continue from the restored epoch, as they would
+      // have without the checkpoint.
+      if (dataset()->reshuffle_each_iteration_) {
+        int64_t num_epochs = dataset()->num_epochs_.load();
+        while (num_epochs <= epoch &&
+               !dataset()->num_epochs_.compare_exchange_weak(num_epochs,
+                                                             epoch + 1)) {
+        }
+      }
+      position_ = position;
+      return OkStatus();
+    }
+
+   private:
+    // A file, its index and their readers.
+    struct IndexedFile {
+      // The readers borrow the files, so they are destroyed first.
+      std::unique_ptr<RandomAccessFile> index_file;
+      std::unique_ptr<RandomAccessFile> file;
+      std::unique_ptr<tsl::io::RecordIndex> index;
+      std::unique_ptr<io::RecordReader> reader;
+      // The position of the file in `lru_files_`.
+      std::list<size_t>::iterator lru_position;
+    };
+
+    // Returns the position of `index` in the permutation of [0, size) of the
+    // given `stream` of the current epoch: stream 0 permutes the files, and
+    // stream `w + 1` the records of window `w`.
+    uint64 Permute(uint64 index, uint64 size, uint64 stream) const
+        TF_SHARED_LOCKS_REQUIRED(mu_) {
+      if (size <= 1) return index;
+      const uint64 seed = Hash64Combine(dataset()->index_shuffle_seed_, epoch_);
+      return random::index_shuffle(
+          index,
+          {static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32),
+           static_cast<uint32_t>(stream)},
+          size - 1, kIndexShuffleRounds);
+    }
+
+    // Sets the epoch, and permutes the files and splits them into windows.
+    void PermuteFilesLocked(int64_t epoch) TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      epoch_ = epoch;
+      const size_t num_files = num_file_records_.size();
+      file_order_.resize(num_files);
+      first_positions_.resize(num_files);
+      window_first_positions_.clear();
+      uint64 first_position = 0;
+      for (size_t i = 0; i < num_files; ++i) {
+        file_order_[i] = Permute(i, num_files, /*stream=*/0);
+        if (i % kMaxOpenIndexedFiles == 0) {
+          window_first_positions_.push_back(first_position);
+        }
+        first_positions_[i] = first_position;
+        first_position += num_file_records_[file_order_[i]];
+      }
+    }
+
+    // Stores the file at `file_index` in `*file`, and opens it if needed.
+    Status GetFileLocked(Env* env, size_t file_index, IndexedFile** file)
+        TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      if (files_[file_index]) {
+        *file = files_[file_index].get();
+        lru_files_.splice(lru_files_.end(), lru_files_, (*file)->lru_position);
+        return OkStatus();
+      }
+      const string filename =
+          TranslateFileName(dataset()->filenames_[file_index]);
+      const string index_filename = tsl::io::RecordIndexFileName(filename);
+      auto new_file = std::make_unique<IndexedFile>();
+      TF_RETURN_IF_ERROR(
+          env->NewRandomAccessFile(index_filename, &new_file->index_file));
+      uint64 index_size;
+      TF_RETURN_IF_ERROR(env->GetFileSize(index_filename, &index_size));
+      TF_RETURN_IF_ERROR(tsl::io::RecordIndex::Open(
+          new_file->index_file.get(), index_size, &new_file->index));
+      TF_RETURN_IF_ERROR(env->NewRandomAccessFile(filename, &new_file->file));
+      new_file->reader =
+          std::make_unique<io::RecordReader>(new_file->file.get());
+
+      // Closes the least recently read file, to bound the open files. Since a
+      // window has at most `kMaxOpenIndexedFiles` files, this is a file of a
+      // previous window.
+      if (lru_files_.size() == kMaxOpenIndexedFiles) {
+        files_[lru_files_.front()].reset();
+        lru_files_.pop_front();
+      }
+      new_file->lru_position = lru_files_.insert(lru_files_.end(), file_index);
+      files_[file_index] = std::move(new_file);
+      *file = files_[file_index].get();
+      return OkStatus();
+    }
+
+    mutex mu_;
+    // The number of records of each file.
+    std::vector<uint64> num_file_records_ TF_GUARDED_BY(mu_);
+    uint64 num_records_ TF_GUARDED_BY(mu_) = 0;
+    // The epoch, which determines the permutation.
+    int64_t epoch_ TF_GUARDED_BY(mu_) = 0;
+    // The indices of the files, in the permuted order.
+    std::vector<size_t> file_order_ TF_GUARDED_BY(mu_);
+    // The position of the first record of each file in `file_order_`, and of
+    // each window of files.
+    std::vector<uint64> first_positions_ TF_GUARDED_BY(mu_);
+    std::vector<uint64> window_first_positions_ TF_GUARDED_BY(mu_);
+    // The position of the next record in the permutation.
+    uint64 position_ TF_GUARDED_BY(mu_) = 0;
+    std::vector<std::unique_ptr<IndexedFile>> files_ TF_GUARDED_BY(mu_);
+    // The indices of the open files, from the least to the most recently read.
+    std::list<size_t> lru_files_ TF_GUARDED_BY(mu_);
   };
 
   const std::vector<string> filenames_;
   const tstring compression_type_;
+  const int64_t index_shuffle_seed_;
+  const bool reshuffle_each_iteration_;
   io::RecordReaderOptions options_;
+  // The number of shuffled iterators created so far, which is the epoch of the
+  // next one if `reshuffle_each_iteration_` is set.
+  mutable std::atomic<int64_t> num_epochs_{0};
 };
 
 TFRecordDatasetOp::TFRecordDatasetOp(OpKernelConstruction* ctx)
-    : DatasetOpKernel(ctx) {}
+    : DatasetOpKernel(ctx) {
+  if (ctx->HasAttr(kIndexShuffleSeed)) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr(kIndexShuffleSeed, &index_shuffle_seed_));
+  }
+  if (ctx->HasAttr(kReshuffleEachIteration)) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr(kReshuffleEachIteration,
+                                     &reshuffle_each_iteration_));
+  }
+}
 
 void TFRecordDatasetOp::MakeDataset(OpKernelContext* ctx,
                                     DatasetBase** output) {
@@ -326,8 +695,18 @@ void TFRecordDatasetOp::MakeDataset(OpKernelContext* ctx,
     buffer_size = kS3BlockSize;
   }
 
-  *output =
-      new Dataset(ctx, std::move(filenames), compression_type, buffer_size);
+  OP_REQUIRES(ctx, index_shuffle_seed_ < 0 || compression_type.empty(),
+              errors::InvalidArgument(
+                  "`index_shuffle_seed` requires uncompressed files, but "
+                  "`compression_type` is ",
+                  compression_type));
+  OP_REQUIRES(ctx, !reshuffle_each_iteration_ || index_shuffle_seed_ >= 0,
+              errors::InvalidArgument("`reshuffle_each_iteration` requires a "
+                                      "non-negative `index_shuffle_seed`."));
+
+  *output = new Dataset(ctx, std::move(filenames), compression_type,
+                        buffer_size, index_shuffle_seed_,
+                        reshuffle_each_iteration_);
 }
 
 namespace {
@@ -26,6 +26,9 @@ class TFRecordDatasetOp : public DatasetOpKernel {
   static constexpr const char* const kFileNames = "filenames";
   static constexpr const char* const kCompressionType = "compression_type";
   static constexpr const char* const kBufferSize = "buffer_size";
+  static constexpr const char* const kIndexShuffleSeed = "index_shuffle_seed";
+  static constexpr const char* const kReshuffleEachIteration =
+      "reshuffle_each_iteration";
 
   explicit TFRecordDatasetOp(OpKernelConstruction* ctx);
 
@@ -34,6 +37,8 @@ class TFRecordDatasetOp : public DatasetOpKernel {
 
  private:
   class Dataset;
+  int64_t index_shuffle_seed_ = -1;
+  bool reshuffle_each_iteration_ = false;
 };
 
 }  // namespace data
@@ -11,7 +11,11 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow/core/kernels/data/tf_record_dataset_op.h"
 
+#include "absl/container/flat_hash_set.h"
 #include "tensorflow/core/data/dataset_test_base.h"
+#include "tensorflow/core/data/serialization_utils.h"
+#include "tensorflow/core/lib/io/record_writer.h"
+#include "tensorflow/tsl/lib/io/record_index.h"
 
 namespace tensorflow {
 namespace data {
@@ -23,12 +27,15 @@ class TFRecordDatasetParams : public DatasetParams {
  public:
   TFRecordDatasetParams(std::vector<tstring> filenames,
                         CompressionType compression_type, int64_t buffer_size,
-                        string node_name)
+                        string node_name, int64_t index_shuffle_seed = -1,
+                        bool reshuffle_each_iteration = false)
       : DatasetParams({DT_STRING}, {PartialTensorShape({})},
                       std::move(node_name)),
         filenames_(std::move(filenames)),
         compression_type_(compression_type),
-        buffer_size_(buffer_size) {}
+        buffer_size_(buffer_size),
+        index_shuffle_seed_(index_shuffle_seed),
+        reshuffle_each_iteration_(reshuffle_each_iteration) {}
 
   std::vector<Tensor> GetInputTensors() const override {
     int num_files = filenames_.size();
@@ -51,6 +58,10 @@ class TFRecordDatasetParams : public DatasetParams {
   Status GetAttributes(AttributeVector* attr_vector) const override {
     attr_vector->clear();
     attr_vector->emplace_back("metadata", "");
+    attr_vector->emplace_back(TFRecordDatasetOp::kIndexShuffleSeed,
+                              index_shuffle_seed_);
+    attr_vector->emplace_back(TFRecordDatasetOp::kReshuffleEachIteration,
+                              reshuffle_each_iteration_);
     return OkStatus();
   }
 
@@ -62,6 +73,8 @@ class TFRecordDatasetParams : public DatasetParams {
   std::vector<tstring> filenames_;
   CompressionType compression_type_;
   int64_t buffer_size_;
+  int64_t index_shuffle_seed_;
+  bool reshuffle_each_iteration_;
 };
 
 class TFRecordDatasetOpTest : public DatasetOpsTestBase {};
@@ -84,6 +97,29 @@ Status CreateTestFiles(const std::vector<tstring>& filenames,
   return OkStatus();
 }
 
+// Writes uncompressed TFRecord files and their indices.
+Status CreateIndexedTestFiles(const std::vector<tstring>& filenames,
+                              const std::vector<std::vector<string>>& contents) {
+  Env* env = Env::Default();
+  for (int i = 0; i < filenames.size(); ++i) {
+    std::unique_ptr<WritableFile> file;
+    TF_RETURN_IF_ERROR(env->NewWritableFile(filenames[i], &file));
+    std::unique_ptr<WritableFile> index_file;
+    TF_RETURN_IF_ERROR(env->NewWritableFile(
+        tsl::io::RecordIndexFileName(filenames[i]), &index_file));
+    io::RecordWriterOptions options;
+    options.index_file = index_file.get();
+    io::RecordWriter writer(file.get(), options);
+    for (const string& record : contents[i]) {
+      TF_RETURN_IF_ERROR(writer.WriteRecord(record));
+    }
+    TF_RETURN_IF_ERROR(writer.Close());
+    TF_RETURN_IF_ERROR(file->Close());
+    TF_RETURN_IF_ERROR(index_file->Close());
+  }
+  return OkStatus();
+}
+
 // Test case 1: multiple text files with ZLIB compression.
 TFRecordDatasetParams TFRecordDatasetParams1() {
   std::vector<tstring> filenames = {
@@ -138,6 +174,45 @@ TFRecordDatasetParams TFRecordDatasetParams3() {
                                /*node_name=*/kNodeName);
 }
 
+// Test case 4: multiple text files without compression, of which a buffer
+// holds several records.
+TFRecordDatasetParams TFRecordDatasetParams4() {
+  std::vector<tstring> filenames = {
+      absl::StrCat(testing::TmpDir(), "/tf_record_UNCOMPRESSED_BUFFERED_1"),
+      absl::StrCat(testing::TmpDir(), "/tf_record_UNCOMPRESSED_BUFFERED_2")};
+  std::vector<std::vector<string>> contents = {{"1", "22", "333"},
+                                               {"a", "bb", "ccc"}};
+  CompressionType compression_type = CompressionType::UNCOMPRESSED;
+  if (!CreateTestFiles(filenames, contents, compression_type).ok()) {
+    VLOG(WARNING) << "Failed to create the test files: "
+                  << absl::StrJoin(filenames, ", ");
+  }
+  return TFRecordDatasetParams(filenames,
+                               /*compression_type=*/compression_type,
+                               /*buffer_size=*/1024,
+                               /*node_name=*/kNodeName);
+}
+
+// Test case 5: multiple indexed files without compression, read in a random
+// permutation.
+TFRecordDatasetParams TFRecordDatasetParams5() {
+  std::vector<tstring> filenames = {
+      absl::StrCat(testing::TmpDir(), "/tf_record_INDEXED_1"),
+      absl::StrCat(testing::TmpDir(), "/tf_record_INDEXED_2")};
+  std::vector<std::vector<string>> contents = {{"1", "22", "333"},
+                                               {"a", "bb", "ccc"}};
+  if (!CreateIndexedTestFiles(filenames, contents).ok()) {
+    VLOG(WARNING) << "Failed to create the test files: "
+                  << absl::StrJoin(filenames, ", ");
+  }
+  return TFRecordDatasetParams(filenames,
+                               /*compression_type=*/
+                               CompressionType::UNCOMPRESSED,
+                               /*buffer_size=*/0,
+                               /*node_name=*/kNodeName,
+                               /*index_shuffle_seed=*/42);
+}
+
 std::vector<GetNextTestCase<TFRecordDatasetParams>> GetNextTestCases() {
   return {
       {/*dataset_params=*/TFRecordDatasetParams1(),
@@ -149,7 +224,14 @@ std::vector<GetNextTestCase<TFRecordDatasetParams>> GetNextTestCases() {
            TensorShape({}), {{"1"}, {"22"}, {"333"}, {"a"}, {"bb"}, {"ccc"}})},
       {/*dataset_params=*/TFRecordDatasetParams3(),
        CreateTensors<tstring>(
-           TensorShape({}), {{"1"}, {"22"}, {"333"}, {"a"}, {"bb"}, {"ccc"}})}};
+           TensorShape({}), {{"1"}, {"22"}, {"333"}, {"a"}, {"bb"}, {"ccc"}})},
+      {/*dataset_params=*/TFRecordDatasetParams4(),
+       CreateTensors<tstring>(
+           TensorShape({}), {{"1"}, {"22"}, {"333"}, {"a"}, {"bb"}, {"ccc"}})},
+      {/*dataset_params=*/TFRecordDatasetParams5(),
+       CreateTensors<tstring>(
+           TensorShape({}), {{"1"}, {"22"}, {"333"}, {"a"}, {"bb"}, {"ccc"}}),
+       /*compare_order=*/false}};
 }
 
 ITERATOR_GET_NEXT_TEST_P(TFRecordDatasetOpTest, TFRecordDatasetParams,
@@ -187,6 +269,17 @@ std::vector<SkipTestCase<TFRecordDatasetParams>> SkipTestCases() {
            /*expected_outputs=*/
            CreateTensors<tstring>(TensorShape({}), {{"bb"}})},
           {/*dataset_params=*/TFRecordDatasetParams3(),
+           /*num_to_skip*/ 7, /*expected_num_skipped*/ 6},
+
+          {/*dataset_params=*/TFRecordDatasetParams4(),
+           /*num_to_skip*/ 2, /*expected_num_skipped*/ 2, /*get_next*/ true,
+           /*expected_outputs=*/
+           CreateTensors<tstring>(TensorShape({}), {{"333"}})},
+          {/*dataset_params=*/TFRecordDatasetParams4(),
+           /*num_to_skip*/ 4, /*expected_num_skipped*/ 4, /*get_next*/ true,
+           /*expected_outputs=*/
+           CreateTensors<tstring>(TensorShape({}), {{"bb"}})},
+          {/*dataset_params=*/TFRecordDatasetParams4(),
            /*num_to_skip*/ 7, /*expected_num_skipped*/ 6}};
 }
 
@@ -258,12 +351,162 @@ IteratorSaveAndRestoreTestCases() {
       {/*dataset_params=*/TFRecordDatasetParams3(),
        /*breakpoints=*/{0, 2, 7},
        CreateTensors<tstring>(
-           TensorShape({}), {{"1"}, {"22"}, {"333"}, {"a"}, {"bb"}, {"ccc"}})}};
+           TensorShape({}), {{"1"}, {"22"}, {"333"}, {"a"}, {"bb"}, {"ccc"}})},
+      {/*dataset_params=*/TFRecordDatasetParams4(),
+       /*breakpoints=*/{0, 1, 2, 4, 7},
+       CreateTensors<tstring>(
+           TensorShape({}), {{"1"}, {"22"}, {"333"}, {"a"}, {"bb"}, {"ccc"}})},
+      {/*dataset_params=*/TFRecordDatasetParams5(),
+       /*breakpoints=*/{0, 2, 5, 7},
+       CreateTensors<tstring>(
+           TensorShape({}), {{"1"}, {"22"}, {"333"}, {"a"}, {"bb"}, {"ccc"}}),
+       /*compare_order=*/false}};
 }
 
 ITERATOR_SAVE_AND_RESTORE_TEST_P(TFRecordDatasetOpTest, TFRecordDatasetParams,
                                  IteratorSaveAndRestoreTestCases())
 
+// More indexed files than the shuffled iterator keeps open, with the records
+// "<file>_<record>".
+TFRecordDatasetParams ManyIndexedFilesParams(
+    bool reshuffle_each_iteration = false) {
+  std::vector<tstring> filenames;
+  std::vector<std::vector<string>> contents;
+  for (int i = 0; i < 130; ++i) {
+    filenames.push_back(
+        absl::StrCat(testing::TmpDir(), "/tf_record_INDEXED_MANY_", i));
+    contents.push_back({absl::StrCat(i, "_0"), absl::StrCat(i, "_1")});
+  }
+  if (!CreateIndexedTestFiles(filenames, contents).ok()) {
+    VLOG(WARNING) << "Failed to create the test files: "
+                  << absl::StrJoin(filenames, ", ");
+  }
+  return TFRecordDatasetParams(filenames,
+                               /*compression_type=*/
+                               CompressionType::UNCOMPRESSED,
+                               /*buffer_size=*/0,
+                               /*node_name=*/kNodeName,
+                               /*index_shuffle_seed=*/42,
+                               reshuffle_each_iteration);
+}
+
+// Reads the records of `iterator` until the end of the sequence.
+Status GetRecords(IteratorContext* ctx, IteratorBase* iterator,
+                  std::vector<string>* records) {
+  bool end_of_sequence = false;
+  while (true) {
+    std::vector<Tensor> next;
+    TF_RETURN_IF_ERROR(iterator->GetNext(ctx, &next, &end_of_sequence));
+    if (end_of_sequence) return OkStatus();
+    records->push_back(next[0].scalar<tstring>()());
+  }
+}
+
+TEST_F(TFRecordDatasetOpTest, IndexShuffleReadsFilesInWindows) {
+  auto dataset_params = ManyIndexedFilesParams();
+  TF_ASSERT_OK(Initialize(dataset_params));
+  std::vector<string> records;
+  TF_ASSERT_OK(GetRecords(iterator_ctx_.get(), iterator_.get(), &records));
+  std::vector<string> expected_records;
+  for (int i = 0; i < 130; ++i) {
+    expected_records.push_back(absl::StrCat(i, "_0"));
+    expected_records.push_back(absl::StrCat(i, "_1"));
+  }
+  EXPECT_THAT(records,
+              ::testing::UnorderedElementsAreArray(expected_records));
+  // The records of the first 64 files are read before any other record.
+  ASSERT_EQ(records.size(), 260);
+  absl::flat_hash_set<string> files;
+  for (int i = 0; i < 128; ++i) {
+    files.insert(records[i].substr(0, records[i].find('_')));
+  }
+  EXPECT_EQ(files.size(), 64);
+}
+
+TEST_F(TFRecordDatasetOpTest, IndexShuffleKeepsPermutationByDefault) {
+  auto dataset_params = ManyIndexedFilesParams();
+  TF_ASSERT_OK(Initialize(dataset_params));
+  std::vector<string> records;
+  TF_ASSERT_OK(GetRecords(iterator_ctx_.get(), iterator_.get(), &records));
+  std::unique_ptr<IteratorBase> iterator;
+  TF_ASSERT_OK(dataset_->MakeIterator(iterator_ctx_.get(), /*parent=*/nullptr,
+                                      dataset_params.iterator_prefix(),
+                                      &iterator));
+  std::vector<string> next_iteration_records;
+  TF_ASSERT_OK(
+      GetRecords(iterator_ctx_.get(), iterator.get(), &next_iteration_records));
+  EXPECT_EQ(next_iteration_records, records);
+}
+
+TEST_F(TFRecordDatasetOpTest, IndexShuffleReseedsEachEpoch) {
+  auto dataset_params =
+      ManyIndexedFilesParams(/*reshuffle_each_iteration=*/true);
+  TF_ASSERT_OK(Initialize(dataset_params));
+  std::vector<string> records;
+  TF_ASSERT_OK(GetRecords(iterator_ctx_.get(), iterator_.get(), &records));
+  std::unique_ptr<IteratorBase> iterator;
+  TF_ASSERT_OK(dataset_->MakeIterator(iterator_ctx_.get(), /*parent=*/nullptr,
+                                      dataset_params.iterator_prefix(),
+                                      &iterator));
+  std::vector<string> next_epoch_records;
+  TF_ASSERT_OK(
+      GetRecords(iterator_ctx_.get(), iterator.get(), &next_epoch_records));
+  EXPECT_THAT(next_epoch_records,
+              ::testing::UnorderedElementsAreArray(records));
+  EXPECT_NE(next_epoch_records, records);
+}
+
+TEST_F(TFRecordDatasetOpTest, IndexShuffleRestoresEpoch) {
+  auto dataset_params =
+      ManyIndexedFilesParams(/*reshuffle_each_iteration=*/true);
+  TF_ASSERT_OK(Initialize(dataset_params));
+  bool end_of_sequence = false;
+  std::vector<Tensor> next;
+  for (int i = 0; i < 100; ++i) {
+    TF_ASSERT_OK(
+        iterator_->GetNext(iterator_ctx_.get(), &next, &end_of_sequence));
+  }
+  std::unique_ptr<SerializationContext> serialization_ctx;
+  TF_ASSERT_OK(CreateSerializationContext(&serialization_ctx));
+  VariantTensorDataWriter writer;
+  TF_ASSERT_OK(iterator_->Save(serialization_ctx.get(), &writer));
+  std::vector<string> records;
+  TF_ASSERT_OK(GetRecords(iterator_ctx_.get(), iterator_.get(), &records));
+
+  // The restored iterator continues the permutation of the saved epoch.
+  std::vector<const VariantTensorData*> data;
+  writer.GetData(&data);
+  VariantTensorDataReader reader(data);
+  std::unique_ptr<IteratorBase> iterator;
+  TF_ASSERT_OK(RestoreIterator(iterator_ctx_.get(), &reader,
+                               dataset_params.iterator_prefix(), *dataset_,
+                               &iterator));
+  std::vector<string> restored_records;
+  TF_ASSERT_OK(
+      GetRecords(iterator_ctx_.get(), iterator.get(), &restored_records));
+  EXPECT_EQ(restored_records, records);
+}
+
+TEST_F(TFRecordDatasetOpTest, IndexShuffleRequiresUncompressedFiles) {
+  std::vector<tstring> filenames = {
+      absl::StrCat(testing::TmpDir(), "/tf_record_ZLIB_1")};
+  auto dataset_params = TFRecordDatasetParams(
+      filenames, /*compression_type=*/CompressionType::ZLIB,
+      /*buffer_size=*/10, /*node_name=*/kNodeName, /*index_shuffle_seed=*/42);
+  EXPECT_EQ(Initialize(dataset_params).code(),
+            absl::StatusCode::kInvalidArgument);
+}
+
+TEST_F(TFRecordDatasetOpTest, ReshuffleRequiresIndexShuffleSeed) {
+  auto dataset_params = TFRecordDatasetParams(
+      {absl::StrCat(testing::TmpDir(), "/tf_record_UNCOMPRESSED_1")},
+      /*compression_type=*/CompressionType::UNCOMPRESSED,
+      /*buffer_size=*/10, /*node_name=*/kNodeName, /*index_shuffle_seed=*/-1,
+      /*reshuffle_each_iteration=*/true);
+  EXPECT_EQ(Initialize(dataset_params).code(),
+            absl::StatusCode::kInvalidArgument);
+}
+
 }  // namespace
 }  // namespace data
 }  // namespace tensorflow
@@ -15,6 +15,7 @@ limitations under the License.
 
 // See docs in ../ops/parsing_ops.cc.
 
+#include <memory>
 #include <numeric>
 #include <unordered_set>
 #include <vector>
@@ -30,6 +31,7 @@ limitations under the License.
 #include "tensorflow/core/lib/gtl/array_slice.h"
 #include "tensorflow/core/platform/errors.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/protobuf.h"
 #include "tensorflow/core/util/example_proto_fast_parsing.h"
 #include "tensorflow/core/util/example_proto_helper.h"
@@ -92,6 +94,7 @@ class ParseExampleOp : public OpKernel {
 
     example::Result result;
     if (TensorShapeUtils::IsVector(serialized->shape())) {
+      OP_REQUIRES_OK(ctx, SetFeatureNameIndex(&config));
       OP_REQUIRES_OK(
           ctx, ParseExampleVector(config, serialized, names, ctx, &result));
     } else {
@@ -101,6 +104,20 @@ class ParseExampleOp : public OpKernel {
   }
 
  protected:
+  // Sets the index of `config` to the index of the previous call, which is
+  // rebuilt if the keys changed since. The keys are usually constant, so this
+  // saves building the index on every call.
+  Status SetFeatureNameIndex(example::FastParseExampleConfig* config)
+      TF_LOCKS_EXCLUDED(mu_) {
+    mutex_lock l(mu_);
+    config->index = index_;
+    if (!example::HasFeatureNameIndex(*config)) {
+      TF_RETURN_IF_ERROR(example::BuildFeatureNameIndex(config));
+      index_ = config->index;
+    }
+    return OkStatus();
+  }
+
   // Copies keys from tensor to std::vector<string>.
   Status GetTensorKeys(OpKernelContext* ctx, StringPiece input_name,
                        std::vector<StringPiece>* keys) const {
@@ -290,6 +307,8 @@ class ParseExampleOp : public OpKernel {
   ParseExampleAttrs attrs_;
   int op_version_;
   absl::once_flag flag_;
+  mutex mu_;
+  std::shared_ptr<const example::FeatureNameIndex> index_ TF_GUARDED_BY(mu_);
 };
 
 REGISTER_KERNEL_BUILDER(Name("ParseExample").Device(DEVICE_CPU),
@@ -15,16 +15,24 @@ limitations under the License.
 
 // Tests kernels of lookup ops.
 
+#include <algorithm>
+#include <vector>
+
 #include "tensorflow/core/framework/fake_input.h"
 #include "tensorflow/core/framework/lookup_interface.h"
 #include "tensorflow/core/framework/node_def_builder.h"
 #include "tensorflow/core/framework/op.h"
 #include "tensorflow/core/framework/shape_inference_testutil.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/kernels/lookup_table_op.h"
 #include "tensorflow/core/kernels/ops_testutil.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 
 namespace tensorflow {
 namespace {
@@ -100,5 +108,189 @@ TEST_F(LookupOpsTest, AnonymousHashTable_RefCounting) {
   EXPECT_FALSE(alive);
 }
 
+using ShardedInt64Map = lookup::ShardedHashMap<int64_t, int64_t>;
+
+// Returns the values of `keys` in `map`, with -1 for missing keys.
+template <class K, class Map>
+std::vector<int64_t> FindAll(const Map& map, const Tensor& keys) {
+  std::vector<int64_t> values(keys.NumElements(), -2);
+  map.FindBatch(keys.flat<K>(), [&values](int64_t i, const int64_t* value) {
+    values[i] = value == nullptr ? -1 : *value;
+  });
+  return values;
+}
+
+void InsertAll(const Tensor& keys, const std::vector<int64_t>& values,
+               ShardedInt64Map* map, bool clear = false) {
+  map->InsertBatch(
+      keys.flat<int64_t>(), [&values](int64_t i) { return values[i]; }, clear);
+}
+
+TEST(ShardedHashMapTest, FindInsertRemove) {
+  ShardedInt64Map map;
+  std::vector<int64_t> keys(1000);
+  std::vector<int64_t> values(keys.size());
+  for (int i = 0; i < keys.size(); ++i) {
+    keys[i] = i * 64;
+    values[i] = i;
+  }
+  InsertAll(test::AsTensor<int64_t>(keys), values, &map);
+  EXPECT_EQ(map.size(), keys.size());
+  EXPECT_EQ(FindAll<int64_t>(map, test::AsTensor<int64_t>(keys)), values);
+  EXPECT_EQ(FindAll<int64_t>(map, test::AsTensor<int64_t>({64, 1, 128, -64})),
+            std::vector<int64_t>({1, -1, 2, -1}));
+
+  const Tensor removed_keys = test::AsTensor<int64_t>({0, 64, 1});
+  map.RemoveBatch(removed_keys.flat<int64_t>());
+  EXPECT_EQ(map.size(), keys.size() - 2);
+  EXPECT_EQ(FindAll<int64_t>(map, test::AsTensor<int64_t>({0, 64, 128})),
+            std::vector<int64_t>({-1, -1, 2}));
+}
+
+TEST(ShardedHashMapTest, LastValueOfDuplicateKeyWins) {
+  ShardedInt64Map map;
+  InsertAll(test::AsTensor<int64_t>({7, 8, 7, 9, 7}), {1, 2, 3, 4, 5}, &map);
+  EXPECT_EQ(map.size(), 3);
+  EXPECT_EQ(FindAll<int64_t>(map, test::AsTensor<int64_t>({7, 8, 9})),
+            std::vector<int64_t>({5, 2, 4}));
+}
+
+TEST(ShardedHashMapTest, InsertWithClearReplacesContents) {
+  ShardedInt64Map map;
+  InsertAll(test::AsTensor<int64_t>({1, 2, 3}), {1, 2, 3}, &map);
+  InsertAll(test::AsTensor<int64_t>({3, 4}), {30, 40}, &map, /*clear=*/true);
+  EXPECT_EQ(map.size(), 2);
+  EXPECT_EQ(FindAll<int64_t>(map, test::AsTensor<int64_t>({1, 2, 3, 4})),
+            std::vector<int64_t>({-1, -1, 30, 40}));
+}
+
+TEST(ShardedHashMapTest, Export) {
+  ShardedInt64Map map;
+  std::vector<int64_t> keys;
+  for (int64_t k = 0; k < 100; ++k) keys.push_back(k);
+  InsertAll(test::AsTensor<int64_t>(keys), keys, &map);
+
+  std::vector<int64_t> exported_keys;
+  TF_ASSERT_OK(map.Export(
+      [&exported_keys](int64_t size) {
+        exported_keys.resize(size, -1);
+        return OkStatus();
+      },
+      [&exported_keys](int64_t i, int64_t key, int64_t value) {
+        EXPECT_EQ(key, value);
+        exported_keys[i] = key;
+      }));
+  std::sort(exported_keys.begin(), exported_keys.end());
+  EXPECT_EQ(exported_keys, keys);
+
+  EXPECT_EQ(map.Export([](int64_t size) { return errors::Internal("Failed"); },
+                       [](int64_t i, int64_t key, int64_t value) {
+                         ADD_FAILURE() << "Unexpected entry " << key;
+                       })
+                .code(),
+            error::INTERNAL);
+}
+
+TEST(ShardedHashMapTest, StringKeys) {
+  lookup::ShardedHashMap<tstring, int64_t> map;
+  const Tensor keys = test::AsTensor<tstring>({"a", "bb", "", "ccc"});
+  map.InsertBatch(keys.flat<tstring>(), [](int64_t i) { return i; });
+  EXPECT_EQ(FindAll<tstring>(
+                map, test::AsTensor<tstring>({"ccc", "d", "", "a", "bb"})),
+            std::vector<int64_t>({3, -1, 2, 0, 1}));
+}
+
+TEST(ShardedHashMapTest, SingleShard) {
+  lookup::ShardedHashMap<int64_t, int64_t, /*kNumShardBits=*/0> map;
+  const Tensor keys = test::AsTensor<int64_t>({5, 6});
+  map.InsertBatch(keys.flat<int64_t>(), [](int64_t i) { return i + 1; });
+  EXPECT_EQ(FindAll<int64_t>(map, test::AsTensor<int64_t>({6, 5, 4})),
+            std::vector<int64_t>({2, 1, -1}));
+}
+
+TEST(ShardedHashMapTest, ConcurrentFindAndInsert) {
+  constexpr int kNumThreads = 8;
+  constexpr int kKeysPerThread = 1000;
+  ShardedInt64Map map;
+  {
+    thread::ThreadPool pool(Env::Default(), "test", kNumThreads);
+    for (int t = 0; t < kNumThreads; ++t) {
+      pool.Schedule([t, &map]() {
+        std::vector<int64_t> keys;
+        for (int64_t k = 0; k < kKeysPerThread; ++k) {
+          keys.push_back(t * kKeysPerThread + k);
+        }
+        const Tensor key_tensor = test::AsTensor<int64_t>(keys);
+        for (int k = 0; k < kKeysPerThread; k += 100) {
+          // Insert the next 100 keys of this thread, and check that all the
+          // keys inserted so far are found with their value.
+          const Tensor new_keys = key_tensor.Slice(k, k + 100);
+          const Tensor inserted_keys = key_tensor.Slice(0, k + 100);
+          map.InsertBatch(new_keys.flat<int64_t>(), [&keys, k](int64_t i) {
+            return keys[k + i] * 2;
+          });
+          map.FindBatch(inserted_keys.flat<int64_t>(),
+                        [&keys](int64_t i, const int64_t* value) {
+                          ASSERT_NE(value, nullptr);
+                          EXPECT_EQ(*value, keys[i] * 2);
+                        });
+        }
+      });
+    }
+  }
+  EXPECT_EQ(map.size(), kNumThreads * kKeysPerThread);
+}
+
+// Runs batched finds of random keys, and if `insert_every` is not zero,
+// batched updates every `insert_every` finds, concurrently from each benchmark
+// thread on a shared map of 2^20 entries with `2^kNumShardBits` shards. The
+// single shard map reproduces a table guarded by one mutex.
+template <int kNumShardBits>
+void BM_ShardedHashMapFindInsert(::testing::benchmark::State& state) {
+  using Map = lookup::ShardedHashMap<int64_t, int64_t, kNumShardBits>;
+  constexpr int64_t kNumKeys = 1 << 20;
+  constexpr int64_t kFindBatchSize = 1024;
+  constexpr int64_t kInsertBatchSize = 64;
+  static Map* map = []() {
+    Map* map = new Map();
+    std::vector<int64_t> keys(kNumKeys);
+    for (int64_t k = 0; k < kNumKeys; ++k) keys[k] = k;
+    const Tensor key_tensor = test::AsTensor<int64_t>(keys);
+    map->InsertBatch(key_tensor.flat<int64_t>(), [](int64_t i) { return i; });
+    return map;
+  }();
+  const int insert_every = state.range(0);
+
+  random::PhiloxRandom philox(state.thread_index() + 1);
+  random::SimplePhilox rng(&philox);
+  std::vector<int64_t> keys(kFindBatchSize);
+  for (int64_t& key : keys) key = rng.Uniform64(kNumKeys);
+  const Tensor find_keys = test::AsTensor<int64_t>(keys);
+  const Tensor insert_keys = find_keys.Slice(0, kInsertBatchSize);
+
+  int64_t num_finds = 0;
+  int64_t sum = 0;
+  for (auto s : state) {
+    map->FindBatch(find_keys.flat<int64_t>(),
+                   [&sum](int64_t i, const int64_t* value) { sum += *value; });
+    if (insert_every > 0 && ++num_finds % insert_every == 0) {
+      map->InsertBatch(insert_keys.flat<int64_t>(),
+                       [&keys](int64_t i) { return keys[i]; });
+    }
+  }
+  tensorflow::testing::DoNotOptimize(sum);
+  state.SetItemsProcessed(state.iterations() * kFindBatchSize);
+}
+
+void FindInsertBenchmarkArgs(::benchmark::internal::Benchmark* b) {
+  b->UseRealTime()->ArgNames({"insert_every"})->Arg(0)->Arg(16);
+  for (int threads : {1, 4, 16, 64}) b->Threads(threads);
+}
+
+BENCHMARK_TEMPLATE(BM_ShardedHashMapFindInsert, 0)
+    ->Apply(FindInsertBenchmarkArgs);
+BENCHMARK_TEMPLATE(BM_ShardedHashMapFindInsert, 4)
+    ->Apply(FindInsertBenchmarkArgs);
+
 }  // namespace
 }  // namespace tensorflow
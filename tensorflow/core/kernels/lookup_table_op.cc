@@ -16,6 +16,7 @@ limitations under the License.
 #include "tensorflow/core/kernels/lookup_table_op.h"
 #define EIGEN_USE_THREADS
 
+#include <optional>
 #include <string>
 #include <type_traits>
 #include <utility>
@@ -36,11 +37,13 @@ std::string UniqueNodeName(const std::string& base) {
   return strings::StrCat(base, "/", counter.fetch_add(1), "/", random::New64());
 }
 
-// Lookup table that wraps an unordered_map, where the key and value data type
+// Lookup table that wraps a ShardedHashMap, where the key and value data type
 // is specified. Each individual value must be a scalar. If vector values are
 // required, use MutableHashTableOfTensors.
 //
 // This table is mutable and thread safe - Insert can be called at any time.
+// Keys are split into shards with their own locks, so that concurrent lookups
+// and updates of different shards do not serialize.
 //
 // Sample use case:
 //
@@ -55,10 +58,7 @@ class MutableHashTableOfScalars final : public LookupInterface {
  public:
   MutableHashTableOfScalars(OpKernelContext* ctx, OpKernel* kernel) {}
 
-  size_t size() const override {
-    tf_shared_lock l(mu_);
-    return table_.size();
-  }
+  size_t size() const override { return table_.size(); }
 
   Status Find(OpKernelContext* ctx, const Tensor& key, Tensor* value,
               const Tensor& default_value) override {
@@ -70,18 +70,20 @@ class MutableHashTableOfScalars final : public LookupInterface {
     int64_t default_total = default_flat.size();
     bool is_full_size_default = (total == default_total);
 
-    tf_shared_lock l(mu_);
-    for (int64_t i = 0; i < key_values.size(); ++i) {
+    table_.FindBatch(key_values, [&](int64_t i, const V* found) {
       // is_full_size_default is true:
       //   Each key has an independent default value, key_values(i)
       //   corresponding uses default_flat(i) as its default value.
       //
       // is_full_size_default is false:
       //   All keys will share the default_flat(0) as default value.
-      value_values(i) = gtl::FindWithDefault(
-          table_, SubtleMustCopyIfIntegral(key_values(i)),
-          is_full_size_default ? default_flat(i) : default_flat(0));
-    }
+      if (found != nullptr) {
+        value_values(i) = *found;
+      } else {
+        value_values(i) =
+            is_full_size_default ? default_flat(i) : default_flat(0);
+      }
+    });
 
     return OkStatus();
   }
@@ -90,14 +92,12 @@ class MutableHashTableOfScalars final : public LookupInterface {
     const auto key_values = keys.flat<K>();
     const auto value_values = values.flat<V>();
 
-    mutex_lock l(mu_);
-    if (clear) {
-      table_.clear();
-    }
-    for (int64_t i = 0; i < key_values.size(); ++i) {
-      gtl::InsertOrUpdate(&table_, SubtleMustCopyIfIntegral(key_values(i)),
-                          SubtleMustCopyIfIntegral(value_values(i)));
-    }
+    table_.InsertBatch(
+        key_values,
+        [&value_values](int64_t i) {
+          return SubtleMustCopyIfIntegral(value_values(i));
+        },
+        clear);
     return OkStatus();
   }
 
@@ -107,12 +107,7 @@ class MutableHashTableOfScalars final : public LookupInterface {
   }
 
   Status Remove(OpKernelContext* ctx, const Tensor& keys) override {
-    const auto key_values = keys.flat<K>();
-
-    mutex_lock l(mu_);
-    for (int64_t i = 0; i < key_values.size(); ++i) {
-      table_.erase(SubtleMustCopyIfIntegral(key_values(i)));
-    }
+    table_.RemoveBatch(keys.flat<K>());
     return OkStatus();
   }
 
@@ -122,17 +117,12 @@ class MutableHashTableOfScalars final : public LookupInterface {
   }
 
   Status ExportValues(OpKernelContext* ctx) override {
-    tf_shared_lock l(mu_);
-    int64_t size = table_.size();
-
-    Tensor* keys;
-    Tensor* values;
-    TF_RETURN_IF_ERROR(
-        ctx->allocate_output("keys", TensorShape({size}), &keys));
-    TF_RETURN_IF_ERROR(
-        ctx->allocate_output("values", TensorShape({size}), &values));
-    ExportKeysAndValues(keys, values);
-    return OkStatus();
+    return ExportKeysAndValues(
+        [ctx](int64_t size, Tensor** keys, Tensor** values) {
+          TF_RETURN_IF_ERROR(
+              ctx->allocate_output("keys", TensorShape({size}), keys));
+          return ctx->allocate_output("values", TensorShape({size}), values);
+        });
   }
 
   DataType key_dtype() const override { return DataTypeToEnum<K>::v(); }
@@ -144,25 +134,20 @@ class MutableHashTableOfScalars final : public LookupInterface {
   TensorShape value_shape() const override { return TensorShape(); }
 
   int64_t MemoryUsed() const override {
-    int64_t ret = 0;
-    tf_shared_lock l(mu_);
-    for (unsigned i = 0; i < table_.bucket_count(); ++i) {
-      size_t bucket_size = table_.bucket_size(i);
-      if (bucket_size == 0) {
-        ret++;
-      } else {
-        ret += bucket_size;
-      }
-    }
-    return sizeof(MutableHashTableOfScalars) + ret;
+    return sizeof(MutableHashTableOfScalars) + table_.MemoryUsed();
   }
 
   Status AsGraphDef(GraphDefBuilder* builder, Node** out) const override {
-    tf_shared_lock l(mu_);
-    int64_t size = table_.size();
-    Tensor keys(key_dtype(), TensorShape({size}));
-    Tensor values(value_dtype(), TensorShape({size}));
-    ExportKeysAndValues(&keys, &values);
+    Tensor keys;
+    Tensor values;
+    TF_RETURN_IF_ERROR(ExportKeysAndValues(
+        [&](int64_t size, Tensor** keys_ptr, Tensor** values_ptr) {
+          keys = Tensor(key_dtype(), TensorShape({size}));
+          values = Tensor(value_dtype(), TensorShape({size}));
+          *keys_ptr = &keys;
+          *values_ptr = &values;
+          return OkStatus();
+        }));
 
     // We set use_node_name_sharing with a unique node name so that the resource
     // can outlive the MutableHashTableV2 kernel. This means that the lifetime
@@ -195,24 +180,32 @@ class MutableHashTableOfScalars final : public LookupInterface {
   }
 
  private:
-  // Writes all keys and values into `keys` and `values`. `keys` and `values`
-  // must point to tensors of size `table_.size()`.
-  void ExportKeysAndValues(Tensor* keys, Tensor* values) const
-      TF_SHARED_LOCKS_REQUIRED(mu_) {
-    auto keys_data = keys->flat<K>();
-    auto values_data = values->flat<V>();
-    int64_t i = 0;
-    for (auto it = table_.begin(); it != table_.end(); ++it, ++i) {
-      keys_data(i) = it->first;
-      values_data(i) = it->second;
-    }
+  // Calls `allocate_fn(size, &keys, &values)`, which must point `keys` and
+  // `values` to tensors of `size` elements, and writes all keys and values
+  // into them. The table is locked throughout.
+  template <typename AllocateFn>
+  Status ExportKeysAndValues(AllocateFn allocate_fn) const {
+    std::optional<typename TTypes<K>::Flat> keys_data;
+    std::optional<typename TTypes<V>::Flat> values_data;
+    return table_.Export(
+        [&](int64_t size) {
+          Tensor* keys;
+          Tensor* values;
+          TF_RETURN_IF_ERROR(allocate_fn(size, &keys, &values));
+          keys_data.emplace(keys->flat<K>());
+          values_data.emplace(values->flat<V>());
+          return OkStatus();
+        },
+        [&](int64_t i, const K& key, const V& value) {
+          (*keys_data)(i) = key;
+          (*values_data)(i) = value;
+        });
   }
 
-  mutable mutex mu_;
-  std::unordered_map<K, V> table_ TF_GUARDED_BY(mu_);
+  ShardedHashMap<K, V> table_;
 };
 
-// Lookup table that wraps an unordered_map. Behaves identical to
+// Lookup table that wraps a ShardedHashMap. Behaves identical to
 // MutableHashTableOfScalars except that each value must be a vector.
 template <class K, class V>
 class MutableHashTableOfTensors final : public LookupInterface {
@@ -226,10 +219,7 @@ class MutableHashTableOfTensors final : public LookupInterface {
                                 value_shape_.DebugString()));
   }
 
-  size_t size() const override {
-    tf_shared_lock l(mu_);
-    return table_.size();
-  }
+  size_t size() const override { return table_.size(); }
 
   Status Find(OpKernelContext* ctx, const Tensor& key, Tensor* value,
               const Tensor& default_value) override {
@@ -242,10 +232,7 @@ class MutableHashTableOfTensors final : public LookupInterface {
     int64_t default_total = default_flat.size();
     bool is_full_size_default = (total == default_total);
 
-    tf_shared_lock l(mu_);
-    for (int64_t i = 0; i < key_values.size(); ++i) {
-      ValueArray* value_vec =
-          gtl::FindOrNull(table_, SubtleMustCopyIfIntegral(key_values(i)));
+    table_.FindBatch(key_values, [&](int64_t i, const ValueArray* value_vec) {
       if (value_vec != nullptr) {
         for (int64_t j = 0; j < value_dim; j++) {
           value_values(i, j) = value_vec->at(j);
@@ -262,7 +249,7 @@ class MutableHashTableOfTensors final : public LookupInterface {
               is_full_size_default ? default_flat(i, j) : default_flat(0, j);
         }
       }
-    }
+    });
 
     return OkStatus();
   }
@@ -272,19 +259,17 @@ class MutableHashTableOfTensors final : public LookupInterface {
     const auto value_values = values.flat_inner_dims<V, 2>();
     int64_t value_dim = value_shape_.dim_size(0);
 
-    mutex_lock l(mu_);
-    if (clear) {
-      table_.clear();
-    }
-    for (int64_t i = 0; i < key_values.size(); ++i) {
-      ValueArray value_vec;
-      for (int64_t j = 0; j < value_dim; j++) {
-        V value = value_values(i, j);
-        value_vec.push_back(value);
-      }
-      gtl::InsertOrUpdate(&table_, SubtleMustCopyIfIntegral(key_values(i)),
-                          value_vec);
-    }
+    table_.InsertBatch(
+        key_values,
+        [&value_values, value_dim](int64_t i) {
+          ValueArray value_vec;
+          for (int64_t j = 0; j < value_dim; j++) {
+            V value = value_values(i, j);
+            value_vec.push_back(value);
+          }
+          return value_vec;
+        },
+        clear);
     return OkStatus();
   }
 
@@ -294,12 +279,7 @@ class MutableHashTableOfTensors final : public LookupInterface {
   }
 
   Status Remove(OpKernelContext* ctx, const Tensor& keys) override {
-    const auto key_values = keys.flat<K>();
-
-    mutex_lock l(mu_);
-    for (int64_t i = 0; i < key_values.size(); ++i) {
-      table_.erase(SubtleMustCopyIfIntegral(key_values(i)));
-    }
+    table_.RemoveBatch(keys.flat<K>());
     return OkStatus();
   }
 
@@ -309,18 +289,14 @@ class MutableHashTableOfTensors final : public LookupInterface {
   }
 
   Status ExportValues(OpKernelContext* ctx) override {
-    tf_shared_lock l(mu_);
-    int64_t size = table_.size();
     int64_t value_dim = value_shape_.dim_size(0);
-
-    Tensor* keys;
-    Tensor* values;
-    TF_RETURN_IF_ERROR(
-        ctx->allocate_output("keys", TensorShape({size}), &keys));
-    TF_RETURN_IF_ERROR(ctx->allocate_output(
-        "values", TensorShape({size, value_dim}), &values));
-    ExportKeysAndValues(keys, values);
-    return OkStatus();
+    return ExportKeysAndValues(
+        [ctx, value_dim](int64_t size, Tensor** keys, Tensor** values) {
+          TF_RETURN_IF_ERROR(
+              ctx->allocate_output("keys", TensorShape({size}), keys));
+          return ctx->allocate_output(
+              "values", TensorShape({size, value_dim}), values);
+        });
   }
 
   DataType key_dtype() const override { return DataTypeToEnum<K>::v(); }
@@ -332,25 +308,21 @@ class MutableHashTableOfTensors final : public LookupInterface {
   TensorShape value_shape() const override { return value_shape_; }
 
   int64_t MemoryUsed() const override {
-    int64_t ret = 0;
-    tf_shared_lock l(mu_);
-    for (unsigned i = 0; i < table_.bucket_count(); ++i) {
-      size_t bucket_size = table_.bucket_size(i);
-      if (bucket_size == 0) {
-        ret++;
-      } else {
-        ret += bucket_size;
-      }
-    }
-    return sizeof(MutableHashTableOfTensors) + ret;
+    return sizeof(MutableHashTableOfTensors) + table_.MemoryUsed();
   }
 
   Status AsGraphDef(GraphDefBuilder* builder, Node** out) const override {
-    tf_shared_lock l(mu_);
-    int64_t size = table_.size();
-    Tensor keys(key_dtype(), TensorShape({size}));
-    Tensor values(value_dtype(), TensorShape({size, value_shape_.dim_size(0)}));
-    ExportKeysAndValues(&keys, &values);
+    Tensor keys;
+    Tensor values;
+    TF_RETURN_IF_ERROR(ExportKeysAndValues(
+        [&](int64_t size, Tensor** keys_ptr, Tensor** values_ptr) {
+          keys = Tensor(key_dtype(), TensorShape({size}));
+          values = Tensor(value_dtype(),
+                          TensorShape({size, value_shape_.dim_size(0)}));
+          *keys_ptr = &keys;
+          *values_ptr = &values;
+          return OkStatus();
+        }));
 
     // We set use_node_name_sharing with a unique node name so that the resource
     // can outlive the MutableHashTableOfTensorsV2 kernel. This means that the
@@ -384,30 +356,36 @@ class MutableHashTableOfTensors final : public LookupInterface {
   }
 
  private:
-  // Writes all keys and values into `keys` and `values`. `keys` and `values`
-  // must point to tensors of size `table_.size()`.
-  void ExportKeysAndValues(Tensor* keys, Tensor* values) const
-      TF_SHARED_LOCKS_REQUIRED(mu_) {
+  typedef gtl::InlinedVector<V, 4> ValueArray;
+
+  // Calls `allocate_fn(size, &keys, &values)`, which must point `keys` and
+  // `values` to tensors of `size` rows, and writes all keys and values into
+  // them. The table is locked throughout.
+  template <typename AllocateFn>
+  Status ExportKeysAndValues(AllocateFn allocate_fn) const {
     int64_t value_dim = value_shape_.dim_size(0);
-    auto keys_data = keys->flat<K>();
-    auto values_data = values->matrix<V>();
-    int64_t i = 0;
-    for (auto it = table_.begin(); it != table_.end(); ++it, ++i) {
-      K key = it->first;
-      ValueArray value = it->second;
-      keys_data(i) = key;
-      for (int64_t j = 0; j < value_dim; j++) {
-        values_data(i, j) = value[j];
-      }
-    }
+    std::optional<typename TTypes<K>::Flat> keys_data;
+    std::optional<typename TTypes<V>::Matrix> values_data;
+    return table_.Export(
+        [&](int64_t size) {
+          Tensor* keys;
+          Tensor* values;
+          TF_RETURN_IF_ERROR(allocate_fn(size, &keys, &values));
+          keys_data.emplace(keys->flat<K>());
+          values_data.emplace(values->matrix<V>());
+          return OkStatus();
+        },
+        [&](int64_t i, const K& key, const ValueArray& value) {
+          (*keys_data)(i) = key;
+          for (int64_t j = 0; j < value_dim; j++) {
+            (*values_data)(i, j) = value[j];
+          }
+        });
   }
 
   TensorShape value_shape_;
-  mutable mutex mu_;
-  typedef gtl::InlinedVector<V, 4> ValueArray;
-  std::unordered_map<K, ValueArray> table_ TF_GUARDED_BY(mu_);
+  ShardedHashMap<K, ValueArray> table_;
 };
-
 namespace {
 
 template <typename T>
@@ -16,6 +16,12 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_KERNELS_LOOKUP_TABLE_OP_H_
 #define TENSORFLOW_CORE_KERNELS_LOOKUP_TABLE_OP_H_
 
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
 #include "absl/container/flat_hash_map.h"
 #include "tensorflow/core/framework/bounds_check.h"
 #include "tensorflow/core/framework/lookup_interface.h"
@@ -28,8 +34,10 @@ limitations under the License.
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/gtl/map_util.h"
+#include "tensorflow/core/lib/hash/hash.h"
 #include "tensorflow/core/platform/errors.h"
 #include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/thread_annotations.h"
 
 namespace tensorflow {
@@ -200,6 +208,210 @@ inline const ResourceHandle& SubtleMustCopyIfIntegral(
 // Returns a unique node name starting with "base".
 std::string UniqueNodeName(const std::string& base);
 
+// A hash map from K to V which is split into `2^kNumShardBits` shards, each
+// guarded by its own mutex, so that concurrent readers and writers only contend
+// on the shards of the keys they access.
+//
+// The batched operations group their keys by shard and acquire each shard
+// mutex once per batch. Lookups of integral keys prefetch the slots of the
+// following keys of the shard to overlap their cache misses.
+template <class K, class V, int kNumShardBits = 4>
+class ShardedHashMap {
+ public:
+  static_assert(kNumShardBits >= 0 && kNumShardBits <= 8,
+                "The number of shards must fit in a uint8.");
+  static constexpr int kNumShards = 1 << kNumShardBits;
+
+  using KeyTensor = typename TTypes<K>::ConstFlat;
+
+  // Returns the number of entries. Shards are counted one after the other, so
+  // the result may not reflect concurrent updates of several shards.
+  size_t size() const {
+    size_t size = 0;
+    for (const Shard& shard : shards_) {
+      tf_shared_lock l(shard.mu);
+      size += shard.map.size();
+    }
+    return size;
+  }
+
+  // Returns an estimate of the memory allocated by the shards.
+  int64_t MemoryUsed() const {
+    int64_t bytes = 0;
+    for (const Shard& shard : shards_) {
+      tf_shared_lock l(shard.mu);
+      bytes += shard.map.capacity() * (sizeof(typename Map::value_type) + 1);
+    }
+    return bytes;
+  }
+
+  // Calls `fn(i, value)` for each `i` in [0, keys.size()), where `value` points
+  // to the value of `keys(i)`, or is null if there is none. `value` is only
+  // valid during the call, which is made with the shard mutex held.
+  template <typename Fn>
+  void FindBatch(KeyTensor keys, Fn fn) const {
+    // Prefetching requires hashing each key one more time, which only pays
+    // off for keys that are cheap to hash.
+    constexpr bool kPrefetch = std::is_integral<K>::value;
+    constexpr int64_t kPrefetchDistance = 8;
+    ShardedIndices indices(keys);
+    for (int s = 0; s < kNumShards; ++s) {
+      const int64_t begin = indices.offsets[s];
+      const int64_t end = indices.offsets[s + 1];
+      if (begin == end) continue;
+      const Shard& shard = shards_[s];
+      tf_shared_lock l(shard.mu);
+      for (int64_t p = begin; p < end; ++p) {
+        if (kPrefetch && p + kPrefetchDistance < end) {
+          shard.map.prefetch(SubtleMustCopyIfIntegral(
+              keys(indices.Get(p + kPrefetchDistance))));
+        }
+        const int64_t i = indices.Get(p);
+        const auto it = shard.map.find(SubtleMustCopyIfIntegral(keys(i)));
+        fn(i, it == shard.map.end() ? nullptr : &it->second);
+      }
+    }
+  }
+
+  // Inserts or updates the value of each `keys(i)` to `value_fn(i)`. When a
+  // key appears several times in `keys`, its last value is kept. If `clear` is
+  // true, all the shards are locked and cleared first, so that readers never
+  // observe a partially replaced map.
+  template <typename Fn>
+  void InsertBatch(KeyTensor keys, Fn value_fn, bool clear = false) {
+    ShardedIndices indices(keys);
+    if (clear) {
+      std::vector<mutex_lock> locks;
+      locks.reserve(kNumShards);
+      for (Shard& shard : shards_) locks.emplace_back(shard.mu);
+      for (int s = 0; s < kNumShards; ++s) {
+        Map& map = GetMapLocked(s);
+        map.clear();
+        InsertLocked(keys, indices, s, value_fn, &map);
+      }
+      return;
+    }
+    for (int s = 0; s < kNumShards; ++s) {
+      if (indices.offsets[s] == indices.offsets[s + 1]) continue;
+      mutex_lock l(shards_[s].mu);
+      InsertLocked(keys, indices, s, value_fn, &shards_[s].map);
+    }
+  }
+
+  // Removes the entries of `keys`.
+  void RemoveBatch(KeyTensor keys) {
+    ShardedIndices indices(keys);
+    for (int s = 0; s < kNumShards; ++s) {
+      const int64_t begin = indices.offsets[s];
+      const int64_t end = indices.offsets[s + 1];
+      if (begin == end) continue;
+      Shard& shard = shards_[s];
+      mutex_lock l(shard.mu);
+      for (int64_t p = begin; p < end; ++p) {
+        shard.map.erase(SubtleMustCopyIfIntegral(keys(indices.Get(p))));
+      }
+    }
+  }
+
+  // Calls `init_fn(size)` and then `fn(i, key, value)` for each of the `size`
+  // entries, with all the shards locked, so that a consistent snapshot of the
+  // map is visited. Returns the error of `init_fn`, if any.
+  template <typename InitFn, typename Fn>
+  Status Export(InitFn init_fn, Fn fn) const {
+    std::vector<tf_shared_lock> locks;
+    locks.reserve(kNumShards);
+    for (const Shard& shard : shards_) locks.emplace_back(shard.mu);
+    int64_t size = 0;
+    for (int s = 0; s < kNumShards; ++s) size += GetMapLocked(s).size();
+    TF_RETURN_IF_ERROR(init_fn(size));
+    int64_t i = 0;
+    for (int s = 0; s < kNumShards; ++s) {
+      for (const auto& entry : GetMapLocked(s)) {
+        fn(i++, entry.first, entry.second);
+      }
+    }
+    return OkStatus();
+  }
+
+ private:
+  using Map = absl::flat_hash_map<K, V>;
+
+  // Shards are aligned to separate cache lines so that the mutex of one shard
+  // does not share a line with the mutex of another.
+  struct alignas(64) Shard {
+    mutable mutex mu;
+    Map map TF_GUARDED_BY(mu);
+  };
+
+  // The indices of a batch of keys, grouped by shard: the keys of shard `s`
+  // are `keys(Get(p))` for p in [offsets[s], offsets[s + 1]), in their order
+  // in the batch.
+  class ShardedIndices {
+   public:
+    explicit ShardedIndices(KeyTensor keys) {
+      const int64_t n = keys.size();
+      offsets.fill(0);
+      if (kNumShards == 1) {
+        offsets[1] = n;
+        return;
+      }
+      std::vector<uint8_t> key_shards(n);
+      for (int64_t i = 0; i < n; ++i) {
+        key_shards[i] = ShardOf(SubtleMustCopyIfIntegral(keys(i)));
+        ++offsets[key_shards[i] + 1];
+      }
+      for (int s = 0; s < kNumShards; ++s) offsets[s + 1] += offsets[s];
+      std::array<int64_t, kNumShards> next;
+      std::copy(offsets.begin(), offsets.end() - 1, next.begin());
+      order_.resize(n);
+      for (int64_t i = 0; i < n; ++i) order_[next[key_shards[i]]++] = i;
+    }
+
+    int64_t Get(int64_t p) const { return kNumShards == 1 ? p : order_[p]; }
+
+    std::array<int64_t, kNumShards + 1> offsets;
+
+   private:
+    std::vector<int64_t> order_;
+  };
+
+  static uint64 ShardHash(const tstring& key) { return Hash64(key); }
+
+  template <typename T>
+  static uint64 ShardHash(const T& key) {
+    // Fibonacci hashing spreads consecutive and strided ids in the top bits.
+    return static_cast<uint64>(key) * 0x9E3779B97F4A7C15ull;
+  }
+
+  static int ShardOf(const K& key) {
+    if constexpr (kNumShardBits == 0) {
+      return 0;
+    } else {
+      return ShardHash(key) >> (64 - kNumShardBits);
+    }
+  }
+
+  // Returns the map of shard `s`, whose mutex must be held by a lock on all
+  // the shards.
+  Map& GetMapLocked(int s) TF_NO_THREAD_SAFETY_ANALYSIS {
+    return shards_[s].map;
+  }
+  const Map& GetMapLocked(int s) const TF_NO_THREAD_SAFETY_ANALYSIS {
+    return shards_[s].map;
+  }
+
+  template <typename Fn>
+  static void InsertLocked(KeyTensor keys, const ShardedIndices& indices, int s,
+                           Fn& value_fn, Map* map) {
+    for (int64_t p = indices.offsets[s]; p < indices.offsets[s + 1]; ++p) {
+      const int64_t i = indices.Get(p);
+      gtl::InsertOrUpdate(map, SubtleMustCopyIfIntegral(keys(i)), value_fn(i));
+    }
+  }
+
+  std::array<Shard, kNumShards> shards_;
+};
+
 // Lookup table that wraps an flat_hash_map, where the key and value data type
 // is specified.
 //
@@ -25,7 +25,9 @@ limitations under the License.
 #include "absl/algorithm/container.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
+#include "absl/strings/numbers.h"
 #include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/optional.h"
 #include "tensorflow/core/framework/types.h"
@@ -128,6 +130,15 @@ MemoryProfile GenerateMemoryProfile(const XPlane* host_trace) {
           case StatType::kFragmentation:
             stats.set_fragmentation(stat.DoubleValue());
             break;
+          case StatType::kFreeBytesByBin:
+            for (absl::string_view bin_bytes :
+                 absl::StrSplit(stat.StrOrRefValue(), ',', absl::SkipEmpty())) {
+              int64_t free_bytes;
+              if (absl::SimpleAtoi(bin_bytes, &free_bytes)) {
+                stats.add_free_bytes_by_bin(free_bytes);
+              }
+            }
+            break;
           case StatType::kPeakBytesInUse:
             stats.set_peak_bytes_in_use(stat.IntValue());
             break;
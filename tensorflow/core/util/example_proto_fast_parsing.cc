@@ -14,10 +14,16 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow/core/util/example_proto_fast_parsing.h"
 
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <numeric>
 #include <vector>
 
 #include "absl/base/casts.h"
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/numeric/bits.h"
 #include "tensorflow/core/example/example.pb.h"
 #include "tensorflow/core/example/feature.pb.h"
 #include "tensorflow/core/framework/allocator.h"
@@ -31,8 +37,10 @@ limitations under the License.
 #include "tensorflow/core/lib/monitoring/counter.h"
 #include "tensorflow/core/platform/blocking_counter.h"
 #include "tensorflow/core/platform/byte_order.h"
+#include "tensorflow/core/platform/hash.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/protobuf.h"
+#include "tensorflow/core/platform/raw_coding.h"
 #include "tensorflow/core/util/presized_cuckoo_map.h"
 #include "tensorflow/core/util/sparse/sparse_tensor.h"
 
@@ -113,6 +121,108 @@ constexpr uint8 kVarintTag(uint32 tag) { return (tag << 3) | 0; }
 constexpr uint8 kDelimitedTag(uint32 tag) { return (tag << 3) | 2; }
 constexpr uint8 kFixed32Tag(uint32 tag) { return (tag << 3) | 5; }
 
+// Masks of the high bit of each byte of a 64-bit word, which is set in all but
+// the last byte of a varint.
+constexpr uint64 kVarintContinuationBits = 0x8080808080808080ULL;
+
+// Returns the value of the varint bytes (least significant first) of `word`,
+// i.e. drops the continuation bits by joining pairs of 7-bit groups into
+// 14-bit groups, then 28-bit groups, then the 56-bit value.
+inline uint64 CompactVarintBytes(uint64 word) {
+  word = (word & 0x007f007f007f007fULL) |
+         ((word & 0x7f007f007f007f00ULL) >> 1);
+  word = (word & 0x00003fff00003fffULL) |
+         ((word & 0x3fff00003fff0000ULL) >> 2);
+  word = (word & 0x000000000fffffffULL) |
+         ((word & 0x0fffffff00000000ULL) >> 4);
+  return word;
+}
+
+// Decodes the packed varints `[begin, end)` into `out`, storing the first
+// `capacity` of them and validating the others. Sets `*num_values` to the
+// number of varints. Returns false if the bytes are not a sequence of varints
+// of at most 10 bytes.
+//
+// The varints are decoded a 64-bit word at a time rather than a byte at a time:
+// the ends of the varints are found from the continuation bits of the word,
+// and each varint is extracted with shifts and masks. Words of 8 single-byte
+// varints, common for small ids and counts, are widened in one vectorizable
+// loop.
+bool DecodePackedVarints(const uint8* begin, const uint8* end, int64_t* out,
+                         size_t capacity, size_t* num_values) {
+  size_t index = 0;
+  // The value and number of bits of a varint continued in the next word.
+  uint64 partial = 0;
+  int partial_bits = 0;
+  for (const uint8* pos = begin; pos < end; pos += 8) {
+    uint64 word;
+    uint64 last_bytes;
+    if (end - pos >= 8) {
+      word = core::DecodeFixed64(reinterpret_cast<const char*>(pos));
+      last_bytes = ~word & kVarintContinuationBits;
+      if (last_bytes == kVarintContinuationBits && partial_bits == 0 &&
+          index + 8 <= capacity) {
+        for (int i = 0; i < 8; ++i) {
+          out[index + i] = static_cast<uint8>(word >> (8 * i));
+        }
+        index += 8;
+        continue;
+      }
+    } else {
+      char tail[8] = {};
+      std::memcpy(tail, pos, end - pos);
+      word = core::DecodeFixed64(tail);
+      last_bytes = ~word & kVarintContinuationBits &
+                   (~uint64{0} >> (8 * (8 - (end - pos))));
+    }
+    // Bit offset of the first byte of the next varint in `word`.
+    int start = 0;
+    while (last_bytes != 0) {
+      const int stop = absl::countr_zero(last_bytes);
+      uint64 value = CompactVarintBytes((word >> start) &
+                                        (~uint64{0} >> (63 - (stop - start))));
+      if (partial_bits != 0) {
+        value = partial | (value << partial_bits);
+        partial = 0;
+        partial_bits = 0;
+      }
+      if (index < capacity) out[index] = static_cast<int64_t>(value);
+      ++index;
+      start = stop + 1;
+      last_bytes &= last_bytes - 1;
+    }
+    const int word_bits = std::min<int>(64, 8 * (end - pos));
+    if (start < word_bits) {
+      // Bits beyond the 64th of a 10-byte varint are dropped, as protobuf
+      // does.
+      if (partial_bits < 64) {
+        partial |= CompactVarintBytes(word >> start) << partial_bits;
+      }
+      partial_bits += 7 * ((word_bits - start) / 8);
+      if (partial_bits >= 70) return false;
+    }
+  }
+  *num_values = index;
+  return partial_bits == 0;
+}
+
+// Returns the position of the values appended to `list`, and sets `*capacity`
+// to the number of values that can be written there, making room for
+// `max_values` values if `list` can grow.
+int64_t* PrepareAppend(SmallVector<int64_t>* list, size_t max_values,
+                       size_t* capacity) {
+  const size_t size = list->size();
+  list->resize(size + max_values);
+  *capacity = max_values;
+  return list->data() + size;
+}
+
+int64_t* PrepareAppend(LimitedArraySlice<int64_t>* list, size_t max_values,
+                       size_t* capacity) {
+  *capacity = std::max<int64_t>(list->EndDistance(), 0);
+  return list->data() + list->size();
+}
+
 namespace parsed {
 
 // ParseDataType has to be called first, then appropriate ParseZzzzList.
@@ -299,15 +409,27 @@ class Feature {
         if (!stream.ExpectTag(kDelimitedTag(1))) return false;  // packed tag
         uint32 packed_length;
         if (!stream.ReadVarint32(&packed_length)) return false;
-        auto packed_limit = stream.PushLimit(packed_length);
-
-        while (!stream.ExpectAtEnd()) {
-          protobuf_uint64 n;  // There is no API for int64
-          if (!stream.ReadVarint64(&n)) return false;
-          int64_list->push_back(static_cast<int64_t>(n));
+        if (packed_length > 0) {
+          // Decode the values directly into the result "vector".
+          const void* packed_data;
+          int buffer_size;
+          if (!stream.GetDirectBufferPointer(&packed_data, &buffer_size) ||
+              static_cast<uint32>(buffer_size) < packed_length) {
+            return false;
+          }
+          const uint8* begin = static_cast<const uint8*>(packed_data);
+          const size_t initial_size = int64_list->size();
+          // Each value takes at least one byte.
+          size_t capacity;
+          int64_t* out = PrepareAppend(int64_list, packed_length, &capacity);
+          size_t num_values;
+          if (!DecodePackedVarints(begin, begin + packed_length, out, capacity,
+                                   &num_values)) {
+            return false;
+          }
+          int64_list->resize(initial_size + num_values);
+          stream.Skip(packed_length);
         }
-
-        stream.PopLimit(packed_limit);
       } else {  // non-packed
         while (!stream.ExpectAtEnd()) {
           if (!stream.ExpectTag(kVarintTag(1))) return false;
@@ -561,6 +683,236 @@ struct SeededHasher {
   uint64 seed{0xDECAFCAFFE};
 };
 
+}  // namespace
+
+// Maps the feature names of a config to their index and type with a perfect
+// hash built with the "hash and displace" scheme: the names are grouped in
+// buckets by hash, and each bucket stores a displacement which sends its names
+// to free slots of the table. A lookup hashes the name once, and compares it
+// with the name of a single slot.
+//
+// Names are hashed from their length and their first and last 8 bytes, which
+// tells most feature names apart without reading all their bytes. The names
+// are hashed fully if that does not tell the config names apart.
+class FeatureNameIndex {
+ public:
+  FeatureNameIndex() = default;
+  FeatureNameIndex(const FeatureNameIndex&) = delete;
+  FeatureNameIndex& operator=(const FeatureNameIndex&) = delete;
+
+  // Builds the index of the feature names of `config`.
+  Status Build(const Config& config);
+
+  // Returns true and sets `*d_and_type` to the index and type of `name` if it
+  // is in the config, or returns false.
+  bool Find(StringPiece name, std::pair<size_t, Type>* d_and_type) const {
+    const uint64 h = Hash(name);
+    const Slot& slot = slots_[Position(h, displacements_[Bucket(h)])];
+    if (slot.name == nullptr || *slot.name != name) return false;
+    *d_and_type = slot.d_and_type;
+    return true;
+  }
+
+  // Returns whether the index was built from the feature names of `config`.
+  bool Matches(const Config& config) const;
+
+ private:
+  struct Slot {
+    const tstring* name = nullptr;
+    std::pair<size_t, Type> d_and_type;
+  };
+
+  // The bytes of `name` that its cheap hash reads.
+  struct CheapKey {
+    size_t size = 0;
+    uint64 head = 0;
+    uint64 tail = 0;
+
+    template <typename H>
+    friend H AbslHashValue(H h, const CheapKey& key) {
+      return H::combine(std::move(h), key.size, key.head, key.tail);
+    }
+    bool operator==(const CheapKey& other) const {
+      return size == other.size && head == other.head && tail == other.tail;
+    }
+  };
+
+  static CheapKey GetCheapKey(StringPiece name) {
+    const char* data = name.data();
+    CheapKey key;
+    key.size = name.size();
+    if (key.size >= 8) {
+      std::memcpy(&key.head, data, 8);
+      std::memcpy(&key.tail, data + key.size - 8, 8);
+    } else if (key.size >= 4) {
+      uint32 head32, tail32;
+      std::memcpy(&head32, data, 4);
+      std::memcpy(&tail32, data + key.size - 4, 4);
+      key.head = head32;
+      key.tail = tail32;
+    } else if (key.size > 0) {
+      key.head = static_cast<uint8>(data[0]) |
+                 (static_cast<uint8>(data[key.size / 2]) << 8) |
+                 (static_cast<uint8>(data[key.size - 1]) << 16);
+    }
+    return key;
+  }
+
+  uint64 Hash(StringPiece name) const {
+    if (full_hash_) return Hash64(name.data(), name.size(), seed_);
+    constexpr uint64 kMul = 0x9ddfea08eb382d69ULL;
+    const CheapKey key = GetCheapKey(name);
+    uint64 h = (key.head ^ seed_) * kMul;
+    h = (h ^ (h >> 47) ^ key.tail ^ (static_cast<uint64>(key.size) << 56)) *
+        kMul;
+    return h ^ (h >> 47);
+  }
+
+  size_t Bucket(uint64 h) const { return (h >> 32) & bucket_mask_; }
+
+  size_t Position(uint64 h, uint32 displacement) const {
+    const uint32 step = static_cast<uint32>((h >> 32) * 0x9E3779B9u) | 1;
+    return (static_cast<uint32>(h) + displacement * step) & slot_mask_;
+  }
+
+  // Attempts to place `entries` in the slots with the current hash. Returns
+  // false if some bucket has no displacement sending its names to free slots.
+  bool TryBuild(const std::vector<Slot>& entries);
+
+  // The feature names of the config, which the slots point to.
+  std::vector<tstring> names_;
+  uint64 seed_ = 0xDECAFCAFFE;
+  bool full_hash_ = false;
+  size_t bucket_mask_ = 0;
+  size_t slot_mask_ = 0;
+  std::vector<uint32> displacements_ = {0};
+  std::vector<Slot> slots_ = {Slot()};
+};
+
+Status FeatureNameIndex::Build(const Config& config) {
+  names_.clear();
+  names_.reserve(config.dense.size() + config.sparse.size() +
+                 config.ragged.size());
+  std::vector<Slot> entries;
+  entries.reserve(names_.capacity());
+  auto add = [&](const tstring& name, std::pair<size_t, Type> d_and_type) {
+    names_.push_back(name);
+    entries.push_back({&names_.back(), d_and_type});
+  };
+  for (size_t d = 0; d < config.dense.size(); ++d) {
+    add(config.dense[d].feature_name, {d, Type::Dense});
+  }
+  for (size_t d = 0; d < config.sparse.size(); ++d) {
+    add(config.sparse[d].feature_name, {d, Type::Sparse});
+  }
+  for (size_t d = 0; d < config.ragged.size(); ++d) {
+    add(config.ragged[d].feature_name, {d, Type::Ragged});
+  }
+  absl::flat_hash_set<StringPiece> names;
+  absl::flat_hash_set<CheapKey> cheap_keys;
+  // Distinct names with the same cheap key have the same cheap hash for every
+  // seed, so no displacement can tell them apart.
+  bool cheap_key_collision = false;
+  for (const Slot& entry : entries) {
+    if (!names.insert(*entry.name).second) {
+      return errors::Internal(
+          "Could not avoid collision. This should not happen.");
+    }
+    cheap_key_collision |= !cheap_keys.insert(GetCheapKey(*entry.name)).second;
+  }
+
+  // Buckets of 4 names on average, and a table at most half full.
+  bucket_mask_ = absl::bit_ceil(std::max<size_t>(entries.size() / 4, 1)) - 1;
+  slot_mask_ = absl::bit_ceil(std::max<size_t>(2 * entries.size(), 1)) - 1;
+  for (int attempt = 0; attempt < 1000; ++attempt) {
+    seed_ = 0xDECAFCAFFE + attempt;
+    full_hash_ = cheap_key_collision || attempt >= 8;
+    if (TryBuild(entries)) return OkStatus();
+  }
+  return errors::Internal("Could not avoid collision. This should not happen.");
+}
+
+bool FeatureNameIndex::Matches(const Config& config) const {
+  if (names_.size() !=
+      config.dense.size() + config.sparse.size() + config.ragged.size()) {
+    return false;
+  }
+  std::pair<size_t, Type> d_and_type;
+  auto matches = [&](const tstring& name, size_t d, Type type) {
+    return Find(name, &d_and_type) && d_and_type.first == d &&
+           d_and_type.second == type;
+  };
+  for (size_t d = 0; d < config.dense.size(); ++d) {
+    if (!matches(config.dense[d].feature_name, d, Type::Dense)) return false;
+  }
+  for (size_t d = 0; d < config.sparse.size(); ++d) {
+    if (!matches(config.sparse[d].feature_name, d, Type::Sparse)) return false;
+  }
+  for (size_t d = 0; d < config.ragged.size(); ++d) {
+    if (!matches(config.ragged[d].feature_name, d, Type::Ragged)) return false;
+  }
+  return true;
+}
+
+bool FeatureNameIndex::TryBuild(const std::vector<Slot>& entries) {
+  displacements_.assign(bucket_mask_ + 1, 0);
+  slots_.assign(slot_mask_ + 1, Slot());
+  std::vector<std::vector<std::pair<uint64, const Slot*>>> buckets(
+      bucket_mask_ + 1);
+  for (const Slot& entry : entries) {
+    const uint64 h = Hash(*entry.name);
+    buckets[Bucket(h)].push_back({h, &entry});
+  }
+  // Place the largest buckets first, while most slots are free.
+  std::vector<size_t> order(buckets.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return buckets[a].size() > buckets[b].size();
+  });
+  std::vector<size_t> positions;
+  for (size_t b : order) {
+    const auto& bucket = buckets[b];
+    if (bucket.empty()) break;
+    bool placed = false;
+    for (uint32 displacement = 0; !placed && displacement <= 4 * slot_mask_;
+         ++displacement) {
+      positions.clear();
+      placed = true;
+      for (const auto& [h, entry] : bucket) {
+        const size_t position = Position(h, displacement);
+        if (slots_[position].name != nullptr ||
+            std::find(positions.begin(), positions.end(), position) !=
+                positions.end()) {
+          placed = false;
+          break;
+        }
+        positions.push_back(position);
+      }
+      if (placed) {
+        displacements_[b] = displacement;
+        for (size_t i = 0; i < bucket.size(); ++i) {
+          slots_[positions[i]] = *bucket[i].second;
+        }
+      }
+    }
+    if (!placed) return false;
+  }
+  return true;
+}
+
+Status BuildFeatureNameIndex(FastParseExampleConfig* config) {
+  auto index = std::make_shared<FeatureNameIndex>();
+  TF_RETURN_IF_ERROR(index->Build(*config));
+  config->index = std::move(index);
+  return OkStatus();
+}
+
+bool HasFeatureNameIndex(const FastParseExampleConfig& config) {
+  return config.index != nullptr && config.index->Matches(config);
+}
+
+namespace {
+
 void LogDenseFeatureDataLoss(StringPiece feature_name) {
   LOG(WARNING) << "Data loss! Feature '" << feature_name
                << "' is present in multiple concatenated "
@@ -586,8 +938,7 @@ void LogSparseFeatureDataLoss(StringPiece feature_name) {
 Status FastParseSerializedExample(
     const tstring& serialized_example, const tstring& example_name,
     const size_t example_index, const Config& config,
-    const PresizedCuckooMap<std::pair<size_t, Type>>& config_index,
-    SeededHasher hasher, std::vector<Tensor>* output_dense,
+    const FeatureNameIndex& config_index, std::vector<Tensor>* output_dense,
     std::vector<SparseBuffer>* output_varlen_dense,
     std::vector<SparseBuffer>* output_sparse,
     std::vector<SparseBuffer>* output_ragged,
@@ -624,23 +975,12 @@ Status FastParseSerializedExample(
     parsed::Feature& feature = name_and_feature.second;
 
     std::pair<size_t, Type> d_and_type;
-    uint64 h = hasher(feature_name);
-    if (!config_index.Find(h, &d_and_type)) continue;
+    if (!config_index.Find(feature_name, &d_and_type)) continue;
 
     size_t d = d_and_type.first;
     bool is_dense = d_and_type.second == Type::Dense;
     bool is_ragged = d_and_type.second == Type::Ragged;
 
-    {
-      // Testing for PresizedCuckooMap collision.
-      // TODO(lew): Use dense_hash_map and avoid this and hasher creation.
-      const tstring& config_feature_name =
-          is_dense ? config.dense[d].feature_name
-                   : (is_ragged ? config.ragged[d].feature_name
-                                : config.sparse[d].feature_name);
-      if (feature_name != config_feature_name) continue;
-    }
-
     auto example_error = [&](StringPiece suffix) {
       return errors::InvalidArgument("Name: ", example_name,
                                      ", Key: ", feature_name,
@@ -1139,36 +1479,14 @@ Status FastParseExample(const Config& config,
     result->feature_stats.resize(serialized.size());
   }
 
-  size_t config_size =
-      config.dense.size() + config.sparse.size() + config.ragged.size();
-  SeededHasher hasher;
-  // Build config index.
-  PresizedCuckooMap<std::pair<size_t, Type>> config_index(config_size);
-  bool ok = true;
-  for (size_t i = 0; i < 1000; ++i) {
-    for (size_t d = 0; d < config.dense.size(); ++d) {
-      ok &= config_index.InsertUnique(hasher(config.dense[d].feature_name),
-                                      {d, Type::Dense});
-    }
-    for (size_t d = 0; d < config.sparse.size(); ++d) {
-      ok &= config_index.InsertUnique(hasher(config.sparse[d].feature_name),
-                                      {d, Type::Sparse});
-    }
-    for (size_t d = 0; d < config.ragged.size(); ++d) {
-      ok &= config_index.InsertUnique(hasher(config.ragged[d].feature_name),
-                                      {d, Type::Ragged});
-    }
-    if (ok) break;
-    LOG(WARNING) << "Collision found. This should happen only if you have "
-                    "around 2^32 entries in your config.";
-    hasher.seed++;
-    config_index.Clear(config_size);
-    ok = true;
-  }
-  if (!ok) {
-    return errors::Internal(
-        "Could not avoid collision. This should not happen.");
+  // Build config index, unless the config carries one.
+  std::shared_ptr<const FeatureNameIndex> config_index_ptr = config.index;
+  if (!HasFeatureNameIndex(config)) {
+    auto index = std::make_shared<FeatureNameIndex>();
+    TF_RETURN_IF_ERROR(index->Build(config));
+    config_index_ptr = std::move(index);
   }
+  const FeatureNameIndex& config_index = *config_index_ptr;
 
   // Allocate dense output for fixed length dense values
   // (variable-length dense and sparse and ragged have to be buffered).
@@ -1239,7 +1557,7 @@ Status FastParseExample(const Config& config,
       status_of_minibatch[minibatch] = FastParseSerializedExample(
           serialized[e],
           (!example_names.empty() ? example_names[e] : "<unknown>"), e, config,
-          config_index, hasher, &fixed_dense_values,
+          config_index, &fixed_dense_values,
           &varlen_dense_buffers[minibatch], &sparse_buffers[minibatch],
           &ragged_buffers[minibatch], stats);
       if (!status_of_minibatch[minibatch].ok()) break;
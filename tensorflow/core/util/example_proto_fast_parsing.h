@@ -16,6 +16,7 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_UTIL_EXAMPLE_PROTO_FAST_PARSING_H_
 #define TENSORFLOW_CORE_UTIL_EXAMPLE_PROTO_FAST_PARSING_H_
 
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -34,6 +35,8 @@ limitations under the License.
 namespace tensorflow {
 namespace example {
 
+class FeatureNameIndex;
+
 // FastParseExampleConfig defines how to parse features in Example.
 // Each sub-config is responsible for one feature identified with feature_name.
 // FastParseExampleConfig can't have two sub-configs with the same feature_name.
@@ -95,8 +98,21 @@ struct FastParseExampleConfig {
   // If `true`, `Result::feature_stats` will contain one
   // `PerExampleFeatureStats` for each serialized example in the input.
   bool collect_feature_stats = false;
+
+  // Index of the feature names above, set by `BuildFeatureNameIndex()`.
+  // `FastParseExample()` builds one for the call if this is unset or was built
+  // from other feature names.
+  std::shared_ptr<const FeatureNameIndex> index;
 };
 
+// Sets `config->index` to an index of the feature names of `config`, which
+// `FastParseExample()` calls with `config` or its copies then share instead of
+// each building one.
+Status BuildFeatureNameIndex(FastParseExampleConfig* config);
+
+// Returns whether `config.index` indexes the feature names of `config`.
+bool HasFeatureNameIndex(const FastParseExampleConfig& config);
+
 // Statistics about the features in each example passed to
 // `FastParse[Single]Example()`.
 //
@@ -13,12 +13,14 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <limits>
 #include <utility>
 
 #include "tensorflow/core/util/example_proto_fast_parsing.h"
 
 #include "tensorflow/core/example/example.pb.h"
 #include "tensorflow/core/example/feature.pb.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/random/philox_random.h"
 #include "tensorflow/core/lib/random/simple_philox.h"
 #include "tensorflow/core/platform/protobuf.h"
@@ -427,6 +429,253 @@ TEST(TestFastParseExample, Empty) {
   EXPECT_TRUE(status.ok()) << status;
 }
 
+TEST(FastParse, PackedInt64Boundaries) {
+  Example example;
+  Int64List* int64_list =
+      (*example.mutable_features()->mutable_feature())["ids"]
+          .mutable_int64_list();
+  for (int64_t value :
+       {int64_t{0}, int64_t{1}, int64_t{127}, int64_t{128}, int64_t{16383},
+        int64_t{16384}, (int64_t{1} << 49) - 1, int64_t{1} << 49,
+        (int64_t{1} << 56) - 1, int64_t{1} << 56,
+        std::numeric_limits<int64_t>::max(), int64_t{-1},
+        std::numeric_limits<int64_t>::min()}) {
+    int64_list->add_value(value);
+  }
+  // Runs of single-byte values, with multi-byte values in between.
+  for (int i = 0; i < 50; ++i) {
+    int64_list->add_value(i % 17 == 0 ? 300 * i : i);
+  }
+  TestCorrectness(Serialize(example));
+}
+
+TEST(FastParse, TruncatedPackedInt64) {
+  // The packed list of "age" ends with a byte with continuation bit.
+  Example example;
+  EXPECT_FALSE(TestFastParse(
+      "\x0a\x0d\x0a\x0b\x0a\x03\x61\x67\x65\x12\x04\x1a\x02\x08\x8d",
+      &example));
+}
+
+TEST(TestFastParseExample, DenseFeaturesWithSimilarNames) {
+  // The names only differ in the middle, so that they are told apart by hashing
+  // them fully.
+  constexpr int kNumFeatures = 300;
+  constexpr int kNumValues = 20;
+  constexpr int kNumExamples = 5;
+  FastParseExampleConfig config;
+  for (int f = 0; f < kNumFeatures; ++f) {
+    AddDenseFeature(strings::StrCat("feature_prefix_", f, "_feature_suffix")
+                        .c_str(),
+                    f % 2 == 0 ? DT_INT64 : DT_FLOAT, {kNumValues}, false,
+                    kNumValues, &config);
+  }
+  std::vector<tstring> serialized;
+  for (int e = 0; e < kNumExamples; ++e) {
+    Example example;
+    auto& features = *example.mutable_features()->mutable_feature();
+    for (int f = 0; f < kNumFeatures; ++f) {
+      const string name =
+          strings::StrCat("feature_prefix_", f, "_feature_suffix");
+      for (int v = 0; v < kNumValues; ++v) {
+        if (f % 2 == 0) {
+          features[name].mutable_int64_list()->add_value(
+              (int64_t{e} << 40) - f * v);
+        } else {
+          features[name].mutable_float_list()->add_value(e + f * 0.5f + v);
+        }
+      }
+      // Features which are not in the config are skipped.
+      features[strings::StrCat("feature_prefix_", f, "_other_suffix")]
+          .mutable_int64_list()
+          ->add_value(f);
+    }
+    serialized.push_back(Serialize(example));
+  }
+
+  Result result;
+  TF_ASSERT_OK(FastParseExample(config, serialized, {}, nullptr, &result));
+  ASSERT_EQ(result.dense_values.size(), kNumFeatures);
+  for (int f = 0; f < kNumFeatures; ++f) {
+    const Tensor& values = result.dense_values[f];
+    ASSERT_EQ(values.NumElements(), kNumExamples * kNumValues);
+    for (int e = 0; e < kNumExamples; ++e) {
+      for (int v = 0; v < kNumValues; ++v) {
+        if (f % 2 == 0) {
+          EXPECT_EQ(values.matrix<int64_t>()(e, v),
+                    (int64_t{e} << 40) - f * v);
+        } else {
+          EXPECT_EQ(values.matrix<float>()(e, v), e + f * 0.5f + v);
+        }
+      }
+    }
+  }
+}
+
+TEST(TestFastParseExample, ConfigFeatureNameIndex) {
+  FastParseExampleConfig config;
+  AddDenseFeature("a", DT_INT64, {1}, false, 1, &config);
+  AddDenseFeature("b", DT_INT64, {1}, false, 1, &config);
+  EXPECT_FALSE(HasFeatureNameIndex(config));
+  TF_ASSERT_OK(BuildFeatureNameIndex(&config));
+  EXPECT_TRUE(HasFeatureNameIndex(config));
+
+  Example example;
+  auto& features = *example.mutable_features()->mutable_feature();
+  features["a"].mutable_int64_list()->add_value(1);
+  features["b"].mutable_int64_list()->add_value(2);
+  features["c"].mutable_int64_list()->add_value(3);
+  const std::vector<tstring> serialized = {Serialize(example)};
+
+  // Copies of the config share its index.
+  FastParseExampleConfig copy = config;
+  EXPECT_TRUE(HasFeatureNameIndex(copy));
+  Result result;
+  TF_ASSERT_OK(FastParseExample(copy, serialized, {}, nullptr, &result));
+  EXPECT_EQ(result.dense_values[0].flat<int64_t>()(0), 1);
+  EXPECT_EQ(result.dense_values[1].flat<int64_t>()(0), 2);
+
+  // An index built from other feature names is not used.
+  copy.dense[1].feature_name = "c";
+  EXPECT_FALSE(HasFeatureNameIndex(copy));
+  Result other_result;
+  TF_ASSERT_OK(
+      FastParseExample(copy, serialized, {}, nullptr, &other_result));
+  EXPECT_EQ(other_result.dense_values[0].flat<int64_t>()(0), 1);
+  EXPECT_EQ(other_result.dense_values[1].flat<int64_t>()(0), 3);
+}
+
+TEST(TestFastParseExample, DenseInt64WrongNumberOfValues) {
+  FastParseExampleConfig config;
+  AddDenseFeature("ids", DT_INT64, {4}, false, 4, &config);
+  for (int num_values : {3, 5, 40}) {
+    Example example;
+    auto* int64_list = (*example.mutable_features()->mutable_feature())["ids"]
+                           .mutable_int64_list();
+    for (int v = 0; v < num_values; ++v) {
+      int64_list->add_value(v);
+    }
+    Result result;
+    Status status = FastParseExample(config, {Serialize(example)}, {},
+                                     nullptr, &result);
+    EXPECT_EQ(status.code(), error::INVALID_ARGUMENT);
+    EXPECT_THAT(std::string(status.message()),
+                ::testing::HasSubstr("Number of int64 values != expected"));
+  }
+}
+
+std::vector<tstring> BenchmarkExamples(DataType dtype, int num_features,
+                                       int num_values, int num_examples,
+                                       FastParseExampleConfig* config) {
+  random::PhiloxRandom philox(42);
+  random::SimplePhilox rng(&philox);
+  for (int f = 0; f < num_features; ++f) {
+    AddDenseFeature(strings::StrCat("feature_", f).c_str(), dtype,
+                    {num_values}, false, num_values, config);
+  }
+  std::vector<tstring> serialized;
+  for (int e = 0; e < num_examples; ++e) {
+    Example example;
+    auto& features = *example.mutable_features()->mutable_feature();
+    for (int f = 0; f < num_features; ++f) {
+      Feature& feature = features[strings::StrCat("feature_", f)];
+      for (int v = 0; v < num_values; ++v) {
+        if (dtype == DT_INT64) {
+          // Mostly small ids and counts, with some large ids.
+          feature.mutable_int64_list()->add_value(
+              rng.Uniform(10) == 0 ? rng.Rand64() >> rng.Uniform(64)
+                                   : rng.Uniform(128));
+        } else {
+          feature.mutable_float_list()->add_value(rng.RandFloat());
+        }
+      }
+    }
+    serialized.push_back(Serialize(example));
+  }
+  return serialized;
+}
+
+// Parses a batch of examples of `num_features` dense features of `num_values`
+// values with `FastParseExample`.
+void BM_FastParseExampleDense(::testing::benchmark::State& state) {
+  const DataType dtype = state.range(0) == 0 ? DT_INT64 : DT_FLOAT;
+  const int num_features = state.range(1);
+  const int num_values = state.range(2);
+  FastParseExampleConfig config;
+  const std::vector<tstring> serialized = BenchmarkExamples(
+      dtype, num_features, num_values, /*num_examples=*/128, &config);
+  size_t bytes = 0;
+  for (const tstring& example : serialized) bytes += example.size();
+
+  for (auto s : state) {
+    Result result;
+    TF_CHECK_OK(FastParseExample(config, serialized, {}, nullptr, &result));
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * bytes);
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                          serialized.size());
+}
+
+// Parses the same examples as `BM_FastParseExampleDense` with the protobuf
+// parser, as a reference.
+void BM_ProtoParseExampleDense(::testing::benchmark::State& state) {
+  const DataType dtype = state.range(0) == 0 ? DT_INT64 : DT_FLOAT;
+  const int num_features = state.range(1);
+  const int num_values = state.range(2);
+  FastParseExampleConfig config;
+  const std::vector<tstring> serialized = BenchmarkExamples(
+      dtype, num_features, num_values, /*num_examples=*/128, &config);
+  size_t bytes = 0;
+  for (const tstring& example : serialized) bytes += example.size();
+
+  for (auto s : state) {
+    for (const tstring& example : serialized) {
+      Example parsed;
+      CHECK(parsed.ParseFromArray(example.data(), example.size()));
+    }
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * bytes);
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                          serialized.size());
+}
+
+// Parses a batch of examples of 500 dense features, configuring either all of
+// them or only one in ten, as the `parse_example_projection` tf.data
+// optimization does when the map function consuming the parsed features only
+// reads 50 of them.
+void BM_FastParseExampleProjection(::testing::benchmark::State& state) {
+  const int parsed_feature_stride = state.range(0);
+  FastParseExampleConfig full_config;
+  const std::vector<tstring> serialized =
+      BenchmarkExamples(DT_FLOAT, /*num_features=*/500, /*num_values=*/8,
+                        /*num_examples=*/128, &full_config);
+  FastParseExampleConfig config;
+  for (size_t f = 0; f < full_config.dense.size(); f += parsed_feature_stride) {
+    config.dense.push_back(full_config.dense[f]);
+  }
+  size_t bytes = 0;
+  for (const tstring& example : serialized) bytes += example.size();
+
+  for (auto s : state) {
+    Result result;
+    TF_CHECK_OK(FastParseExample(config, serialized, {}, nullptr, &result));
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * bytes);
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                          serialized.size());
+}
+
+BENCHMARK(BM_FastParseExampleDense)
+    ->ArgNames({"float", "features", "values"})
+    ->ArgsProduct({{0, 1}, {10, 100}, {1, 16, 256}});
+BENCHMARK(BM_ProtoParseExampleDense)
+    ->ArgNames({"float", "features", "values"})
+    ->ArgsProduct({{0, 1}, {10, 100}, {1, 16, 256}});
+BENCHMARK(BM_FastParseExampleProjection)
+    ->ArgNames({"parsed_feature_stride"})
+    ->Arg(1)
+    ->Arg(10);
+
 }  // namespace
 }  // namespace example
 }  // namespace tensorflow
@@ -16,6 +16,7 @@
 import time
 
 from absl.testing import parameterized
+import numpy as np
 
 from tensorflow.core.protobuf import service_config_pb2
 from tensorflow.python.data.experimental.kernel_tests.service import test_base as data_service_test_base
@@ -1328,6 +1329,46 @@ class DataServiceOpsGrpcDataTransferTest(
     )
     self.assertDatasetProduces(ds, list(range(num_elements)))
 
+  @combinations.generate(test_base.default_test_combinations())
+  def testDistributeCodecPolicyAuto(self):
+    cluster = self.make_test_cluster(num_workers=1)
+    # Sorted integers are delta-encoded, floats byte-shuffled, and repeated
+    # strings dictionary-encoded.
+    ids = np.arange(0, 3000, 3, dtype=np.int64)
+    floats = np.linspace(0.0, 1.0, 64, dtype=np.float32)
+    strings = np.array([b"a", b"b", b""] * 20)
+    ds = dataset_ops.Dataset.from_tensors((ids, floats, strings)).repeat(3)
+    ds = ds.apply(
+        data_service_ops._distribute(
+            processing_mode=data_service_ops.ShardingPolicy.OFF,
+            service=cluster.dispatcher.target,
+            codec_policy="auto",
+        )
+    )
+    self.assertDatasetProduces(ds, [(ids, floats, strings)] * 3)
+
+  @combinations.generate(test_base.default_test_combinations())
+  def testDistributeInvalidCodecPolicy(self):
+    cluster = self.make_test_cluster(num_workers=1)
+    ds = dataset_ops.Dataset.range(10)
+    with self.assertRaisesRegex(ValueError, "Invalid `codec_policy` argument"):
+      ds.apply(
+          data_service_ops._distribute(
+              processing_mode=data_service_ops.ShardingPolicy.OFF,
+              service=cluster.dispatcher.target,
+              codec_policy="foo",
+          )
+      )
+    with self.assertRaisesRegex(ValueError, "requires `compression`"):
+      ds.apply(
+          data_service_ops._distribute(
+              processing_mode=data_service_ops.ShardingPolicy.OFF,
+              service=cluster.dispatcher.target,
+              compression=None,
+              codec_policy="auto",
+          )
+      )
+
 
 if __name__ == "__main__":
   test.main()
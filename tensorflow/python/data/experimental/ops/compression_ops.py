@@ -17,11 +17,15 @@ from tensorflow.python.data.util import structure
 from tensorflow.python.ops import gen_experimental_dataset_ops as ged_ops
 
 
-def compress(element):
+def compress(element, codec_policy="raw"):
   """Compress a dataset element.
 
   Args:
     element: A nested structure of types supported by Tensorflow.
+    codec_policy: (Optional.) "raw" to compress the components as they are, or
+      "auto" to first encode each component with a codec chosen from its dtype
+      and contents. Elements compressed with "auto" can only be uncompressed by
+      binaries that support component codecs.
 
   Returns:
     A variant tensor representing the compressed element. This variant can be
@@ -29,7 +33,7 @@ def compress(element):
   """
   element_spec = structure.type_spec_from_value(element)
   tensor_list = structure.to_tensor_list(element_spec, element)
-  return ged_ops.compress_element(tensor_list)
+  return ged_ops.compress_element(tensor_list, codec_policy=codec_policy)
 
 
 def uncompress(element, output_spec):
@@ -39,6 +39,8 @@ from tensorflow.python.util.tf_export import tf_export
 
 COMPRESSION_AUTO = "AUTO"
 COMPRESSION_NONE = None
+_CODEC_POLICY_RAW = "raw"
+_CODEC_POLICY_AUTO = "auto"
 _PARALLEL_EPOCHS = "parallel_epochs"
 _DISTRIBUTED_EPOCH = "distributed_epoch"
 
@@ -188,6 +190,17 @@ def _validate_compression(compression):
                      f"Must be one of {valid_compressions}.")
 
 
+def _validate_codec_policy(codec_policy, compression):
+  valid_codec_policies = [_CODEC_POLICY_RAW, _CODEC_POLICY_AUTO]
+  if codec_policy not in valid_codec_policies:
+    raise ValueError(f"Invalid `codec_policy` argument: {codec_policy}. "
+                     f"Must be one of {valid_codec_policies}.")
+  if codec_policy != _CODEC_POLICY_RAW and compression != COMPRESSION_AUTO:
+    raise ValueError(f"`codec_policy` {codec_policy!r} requires `compression` "
+                     f"{COMPRESSION_AUTO!r}, but `compression` is "
+                     f"{compression!r}.")
+
+
 def _get_compression_proto(compression):
   if compression == COMPRESSION_AUTO:
     return data_service_pb2.DataServiceMetadata.COMPRESSION_SNAPPY
@@ -444,7 +457,8 @@ def _distribute(processing_mode,
                 data_transfer_protocol=None,
                 compression="AUTO",
                 cross_trainer_cache=None,
-                target_workers="AUTO"):
+                target_workers="AUTO",
+                codec_policy="raw"):
   """A transformation that moves dataset processing to the tf.data service.
 
   This transformation is similar to `distribute`, but supports additional
@@ -501,15 +515,20 @@ def _distribute(processing_mode,
       data copy if every TF worker colocates with a tf.data service worker.
       Consumers of a shared job must use the same `target_workers`. Defaults to
       `"AUTO"`.
+    codec_policy: (Optional.) How the elements are encoded before they are
+      compressed, if `compression` is `"AUTO"`. See `_register_dataset`.
+      Defaults to `"raw"`.
 
   Returns:
     Dataset: A `Dataset` of the elements produced by the data service.
   """
   processing_mode = _get_validated_sharding_policy(processing_mode)
   _validate_compression(compression)
+  _validate_codec_policy(codec_policy, compression)
 
   def _apply_fn(dataset):  # pylint: disable=missing-docstring
-    dataset_id = _register_dataset(service, dataset, compression=compression)
+    dataset_id = _register_dataset(
+        service, dataset, compression=compression, codec_policy=codec_policy)
     return _from_dataset_id(
         processing_mode,
         service,
@@ -776,7 +795,11 @@ def distribute(processing_mode,
       target_workers=target_workers)
 
 
-def _register_dataset(service, dataset, compression, dataset_id=None):
+def _register_dataset(service,
+                      dataset,
+                      compression,
+                      dataset_id=None,
+                      codec_policy="raw"):
   """Registers a dataset with the tf.data service.
 
   This transformation is similar to `register_dataset`, but supports additional
@@ -798,11 +821,21 @@ def _register_dataset(service, dataset, compression, dataset_id=None):
       no new dataset is registered. This is useful if multiple training jobs
       want to (re)use the same dataset for training. In this case, they can
       register the dataset with the same dataset ID.
+    codec_policy: (Optional.) How the elements are encoded before they are
+      compressed, if `compression` is `"AUTO"`. `"raw"` compresses the
+      components as they are. `"auto"` first encodes each component with a
+      codec chosen from its dtype and contents: sorted integers are
+      delta-encoded, floating point values are byte-shuffled, and strings with
+      many repeated values are dictionary-encoded. The workers and the clients
+      of a dataset registered with `"auto"` must all run a TensorFlow version
+      that supports the codecs: older workers fail to load the dataset, and
+      older clients fail to uncompress its elements. Defaults to `"raw"`.
 
   Returns:
     A scalar string tensor representing the dataset ID.
   """
   _validate_compression(compression)
+  _validate_codec_policy(codec_policy, compression)
   if isinstance(service, tuple):
     protocol, address = service
   else:
@@ -818,7 +851,7 @@ def _register_dataset(service, dataset, compression, dataset_id=None):
 
   if compression == COMPRESSION_AUTO:
     dataset = dataset.map(
-        lambda *x: compression_ops.compress(x),
+        lambda *x: compression_ops.compress(x, codec_policy=codec_policy),
         num_parallel_calls=dataset_ops.AUTOTUNE)
   dataset = dataset._apply_debug_options()  # pylint: disable=protected-access
 
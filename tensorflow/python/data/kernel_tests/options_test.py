@@ -148,6 +148,7 @@ class OptionsTest(test_base.DatasetTestBase, parameterized.TestCase):
     options.experimental_optimization.map_parallelization = True
     options.experimental_optimization.noop_elimination = True
     options.experimental_optimization.parallel_batch = True
+    options.experimental_optimization.parse_example_projection = True
     options.experimental_optimization.shuffle_and_repeat_fusion = True
     options.experimental_optimization.warm_start = True
     options.experimental_slack = True
@@ -45,12 +45,18 @@ class AutotuneAlgorithm(enum.Enum):
 
   STAGE_BASED: In each optimization step, this algorithm chooses the worst
   bottleneck parameter and increases its value by 1.
+
+  MODEL_PREDICTIVE: In each optimization step, this algorithm updates a model of
+  the per-element cost of each transformation from the time measured since the
+  previous step, and jointly chooses the parallelism and buffer sizes that
+  minimize the predicted latency under the CPU and RAM budgets.
   """
   DEFAULT = 0
   HILL_CLIMB = 1
   GRADIENT_DESCENT = 2
   MAX_PARALLELISM = 3
   STAGE_BASED = 4
+  MODEL_PREDICTIVE = 5
 
   @classmethod
   def _to_proto(cls, obj):
@@ -64,9 +70,12 @@ class AutotuneAlgorithm(enum.Enum):
       return model_pb2.AutotuneAlgorithm.MAX_PARALLELISM
     if obj == cls.STAGE_BASED:
       return model_pb2.AutotuneAlgorithm.STAGE_BASED
+    if obj == cls.MODEL_PREDICTIVE:
+      return model_pb2.AutotuneAlgorithm.MODEL_PREDICTIVE
     raise ValueError(
         f"Invalid `obj.` Supported values include `DEFAULT`, `HILL_CLIMB` "
-        f"`GRADIENT_DESCENT`, and `STAGE_BASED`. Got {obj.name}.")
+        f"`GRADIENT_DESCENT`, `STAGE_BASED` and `MODEL_PREDICTIVE`. Got "
+        f"{obj.name}.")
 
   @classmethod
   def _from_proto(cls, pb):
@@ -80,9 +89,11 @@ class AutotuneAlgorithm(enum.Enum):
       return cls.MAX_PARALLELISM
     if pb == model_pb2.AutotuneAlgorithm.STAGE_BASED:
       return cls.STAGE_BASED
+    if pb == model_pb2.AutotuneAlgorithm.MODEL_PREDICTIVE:
+      return cls.MODEL_PREDICTIVE
     raise ValueError(
         f"Invalid `pb.` Supported values include `DEFAULT`, `HILL_CLIMB`, "
-        f"`GRADIENT_DESCENT` and `STAGE_BASED`. Got {pb}.")
+        f"`GRADIENT_DESCENT`, `STAGE_BASED` and `MODEL_PREDICTIVE`. Got {pb}.")
 
 
 @tf_export("data.experimental.AutoShardPolicy")
@@ -383,6 +394,14 @@ class OptimizationOptions(options_lib.OptionsBase):
       docstring="Whether to parallelize copying of batch elements. If None, "
       "defaults to True.")
 
+  parse_example_projection = options_lib.create_option(
+      name="parse_example_projection",
+      ty=bool,
+      docstring=
+      "Whether to stop parsing the features of a parse example transformation "
+      "which are not used by the map transformation consuming it. If None, "
+      "defaults to False.")
+
   shuffle_and_repeat_fusion = options_lib.create_option(
       name="shuffle_and_repeat_fusion",
       ty=bool,
@@ -425,6 +444,8 @@ class OptimizationOptions(options_lib.OptionsBase):
       pb.noop_elimination = self.noop_elimination
     if self.parallel_batch is not None:
       pb.parallel_batch = self.parallel_batch
+    if self.parse_example_projection is not None:
+      pb.parse_example_projection = self.parse_example_projection
     if self.shuffle_and_repeat_fusion is not None:
       pb.shuffle_and_repeat_fusion = self.shuffle_and_repeat_fusion
     if self.warm_start is not None:
@@ -452,6 +473,8 @@ class OptimizationOptions(options_lib.OptionsBase):
       self.noop_elimination = pb.noop_elimination
     if pb.WhichOneof("optional_parallel_batch") is not None:
       self.parallel_batch = pb.parallel_batch
+    if pb.WhichOneof("optional_parse_example_projection") is not None:
+      self.parse_example_projection = pb.parse_example_projection
     if pb.WhichOneof("optional_shuffle_and_repeat_fusion") is not None:
       self.shuffle_and_repeat_fusion = pb.shuffle_and_repeat_fusion
     if pb.WhichOneof("optional_warm_start") is not None:
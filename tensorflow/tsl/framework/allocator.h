@@ -21,6 +21,7 @@ limitations under the License.
 #include <functional>
 #include <limits>
 #include <optional>
+#include <vector>
 
 #include "absl/strings/string_view.h"
 #include "absl/types/optional.h"
@@ -92,6 +93,17 @@ struct AllocatorStats {
   std::optional<int64_t> pool_bytes;
   std::optional<int64_t> peak_pool_bytes;
 
+  // For allocators that group memory chunks by size (e.g. BFCAllocator), the
+  // chunks of each size bin, in increasing order of size. Empty otherwise.
+  struct ChunkSizeBin {
+    int64_t min_chunk_bytes = 0;  // Smallest chunk size in this bin.
+    int64_t num_chunks_in_use = 0;
+    int64_t bytes_in_use = 0;
+    int64_t num_free_chunks = 0;
+    int64_t free_bytes = 0;
+  };
+  std::vector<ChunkSizeBin> chunk_size_bins;
+
   AllocatorStats()
       : num_allocs(0),
         bytes_in_use(0),
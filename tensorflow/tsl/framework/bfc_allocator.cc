@@ -17,12 +17,16 @@ limitations under the License.
 
 #include <algorithm>
 #include <atomic>
+#include <chrono>  // NOLINT(build/c++11)
 #include <memory>
 #include <utility>
 
+#include "absl/strings/str_join.h"
 #include "absl/strings/string_view.h"
 #include "tensorflow/tsl/framework/allocator_retry.h"
+#include "tensorflow/tsl/framework/metrics.h"
 #include "tensorflow/tsl/lib/core/bits.h"
+#include "tensorflow/tsl/platform/env.h"
 #include "tensorflow/tsl/platform/file_system.h"
 #include "tensorflow/tsl/platform/logging.h"
 #include "tensorflow/tsl/platform/mutex.h"
@@ -36,8 +40,46 @@ limitations under the License.
 #include "tensorflow/tsl/protobuf/bfc_memory_map.pb.h"
 
 namespace tsl {
+namespace {
+
+// Number of thread cache operations between two trims of the cache.
+constexpr int64_t kThreadCacheTrimInterval = 1 << 14;
+
+}  // namespace
 
 constexpr BFCAllocator::ChunkHandle BFCAllocator::kInvalidChunkHandle;
+constexpr size_t BFCAllocator::kThreadCacheMaxChunkSize;
+constexpr size_t BFCAllocator::kThreadCacheMaxBytes;
+
+// The free chunks cached by one thread, by size. Only the owning thread pushes
+// and pops chunks, so `mu` is only contended when the cache is flushed or its
+// stats are read.
+struct BFCAllocator::ThreadCache {
+  static constexpr int kNumSizes =
+      kThreadCacheMaxChunkSize / kMinAllocationSize;
+
+  // Chunks of size (i + 1) * kMinAllocationSize are in free_lists[i].
+  static int SizeIndex(size_t chunk_size) {
+    return chunk_size / kMinAllocationSize - 1;
+  }
+
+  mutex mu;
+  std::array<std::vector<void*>, kNumSizes> free_lists TF_GUARDED_BY(mu);
+  // Smallest length of each free list since the last trim.
+  std::array<size_t, kNumSizes> low_water TF_GUARDED_BY(mu) = {};
+  size_t cached_bytes TF_GUARDED_BY(mu) = 0;
+  int64_t ops_since_trim TF_GUARDED_BY(mu) = 0;
+
+  // Stats of the allocations served from this cache, which are not counted in
+  // the allocator's stats_.
+  int64_t num_allocs TF_GUARDED_BY(mu) = 0;
+  int64_t largest_alloc_size TF_GUARDED_BY(mu) = 0;
+
+  // Set when the owning thread exits.
+  std::atomic<bool> orphaned{false};
+  // Set when the allocator is destroyed.
+  std::atomic<bool> allocator_destroyed{false};
+};
 
 BFCAllocator::BFCAllocator(std::unique_ptr<SubAllocator> sub_allocator,
                            size_t total_memory, const string& name,
@@ -47,7 +89,16 @@ BFCAllocator::BFCAllocator(std::unique_ptr<SubAllocator> sub_allocator,
       sub_allocator_(std::move(sub_allocator)),
       name_(name),
       free_chunks_list_(kInvalidChunkHandle),
-      next_allocation_id_(1) {
+      next_allocation_id_(1),
+      thread_cache_key_([] {
+        static std::atomic<int64_t> next_key{0};
+        return next_key.fetch_add(1, std::memory_order_relaxed);
+      }()) {
+  if (opts.use_thread_caches) {
+    thread_cache_chunks_.reset(
+        new ThreadCacheChunkShard[kNumThreadCacheChunkShards]);
+  }
+
   if (opts.allow_growth) {
     // 2MiB smallest initial allocation, unless total memory available
     // is less.
@@ -84,9 +135,29 @@ BFCAllocator::BFCAllocator(std::unique_ptr<SubAllocator> sub_allocator,
       CHECK_NE(BinForSize(bin_size * 2), BinFromIndex(b));
     }
   }
+
+  if (opts.compaction_interval_ms > 0) {
+    compaction_thread_.reset(Env::Default()->StartThread(
+        ThreadOptions(), "bfc_compaction", [this] { CompactionLoop(); }));
+  }
 }
 
 BFCAllocator::~BFCAllocator() {
+  if (compaction_thread_ != nullptr) {
+    {
+      mutex_lock l(compaction_mu_);
+      stop_compaction_ = true;
+      compaction_cv_.notify_all();
+    }
+    compaction_thread_.reset();
+  }
+  {
+    mutex_lock l(thread_caches_mu_);
+    for (const auto& cache : thread_caches_) {
+      cache->allocator_destroyed.store(true, std::memory_order_release);
+    }
+  }
+
   // Return memory back.
   VLOG(2) << "Number of regions allocated: "
           << region_manager_.regions().size();
@@ -264,6 +335,14 @@ void* BFCAllocator::AllocateRawInternalWithRetry(
 void* BFCAllocator::AllocateRaw(size_t unused_alignment, size_t num_bytes,
                                 const AllocationAttributes& allocation_attr) {
   VLOG(3) << "AllocateRaw " << Name() << "  " << num_bytes;
+  const bool use_thread_cache = UseThreadCache(num_bytes, allocation_attr);
+  if (use_thread_cache) {
+    void* ptr = AllocateFromThreadCache(RoundedBytes(num_bytes));
+    if (ptr != nullptr) {
+      VLOG(3) << "AllocateRaw " << Name() << "  " << num_bytes << " " << ptr;
+      return ptr;
+    }
+  }
   void* result = [&] {
     if (!opts_.allow_retry_on_failure || !allocation_attr.retry_on_failure) {
       // If we have globally disabled retry-on-failure and fail to allocate an
@@ -310,10 +389,191 @@ void* BFCAllocator::AllocateRaw(size_t unused_alignment, size_t num_bytes,
                                           allocation_attr);
     }
   }();
+  if (result != nullptr && use_thread_cache) {
+    RegisterThreadCacheChunk(result);
+  }
   VLOG(3) << "AllocateRaw " << Name() << "  " << num_bytes << " " << result;
   return result;
 }
 
+bool BFCAllocator::UseThreadCache(
+    size_t num_bytes, const AllocationAttributes& allocation_attr) const {
+  // Allocations with a timestamp requirement and traced allocations need the
+  // bookkeeping of the bins.
+  return opts_.use_thread_caches && num_bytes > 0 &&
+         num_bytes <= kThreadCacheMaxChunkSize && timing_counter_ == nullptr &&
+         allocation_attr.freed_by_func == nullptr &&
+         !tsl::profiler::TraceMe::Active(tsl::profiler::TraceMeLevel::kInfo);
+}
+
+BFCAllocator::ThreadCache* BFCAllocator::GetThreadCache() {
+  // The caches of the calling thread, keyed by thread_cache_key_.
+  struct ThreadCaches {
+    ~ThreadCaches() {
+      for (const auto& entry : caches) {
+        entry.second->orphaned.store(true, std::memory_order_release);
+      }
+    }
+    std::vector<std::pair<int64_t, std::shared_ptr<ThreadCache>>> caches;
+  };
+  static thread_local ThreadCaches thread_caches;
+
+  for (const auto& entry : thread_caches.caches) {
+    if (entry.first == thread_cache_key_) return entry.second.get();
+  }
+
+  // Forget the caches of destroyed allocators before adding a new one.
+  thread_caches.caches.erase(
+      std::remove_if(thread_caches.caches.begin(), thread_caches.caches.end(),
+                     [](const auto& entry) {
+                       return entry.second->allocator_destroyed.load(
+                           std::memory_order_acquire);
+                     }),
+      thread_caches.caches.end());
+  auto cache = std::make_shared<ThreadCache>();
+  {
+    mutex_lock l(lock_);
+    mutex_lock l2(thread_caches_mu_);
+    RemoveOrphanedThreadCaches();
+    thread_caches_.push_back(cache);
+  }
+  thread_caches.caches.emplace_back(thread_cache_key_, cache);
+  return cache.get();
+}
+
+void* BFCAllocator::AllocateFromThreadCache(size_t rounded_bytes) {
+  ThreadCache* cache = GetThreadCache();
+  void* ptr = nullptr;
+  bool trim;
+  {
+    mutex_lock l(cache->mu);
+    const int i = ThreadCache::SizeIndex(rounded_bytes);
+    std::vector<void*>& free_list = cache->free_lists[i];
+    if (!free_list.empty()) {
+      ptr = free_list.back();
+      free_list.pop_back();
+      cache->low_water[i] = std::min(cache->low_water[i], free_list.size());
+      cache->cached_bytes -= rounded_bytes;
+      ++cache->num_allocs;
+      cache->largest_alloc_size = std::max<int64_t>(
+          cache->largest_alloc_size, rounded_bytes);
+    }
+    trim = ++cache->ops_since_trim >= kThreadCacheTrimInterval;
+  }
+  if (trim) TrimThreadCache(cache);
+  return ptr;
+}
+
+void BFCAllocator::RegisterThreadCacheChunk(void* ptr) {
+  // The chunk may be larger than requested if it was not worth splitting.
+  const size_t chunk_size = AllocatedSize(ptr);
+  if (chunk_size > kThreadCacheMaxChunkSize) return;
+  ThreadCacheChunkShard& shard = ChunkShardFor(ptr);
+  mutex_lock l(shard.mu);
+  shard.chunk_sizes[ptr] = chunk_size;
+}
+
+bool BFCAllocator::DeallocateToThreadCache(void* ptr) {
+  size_t chunk_size;
+  {
+    ThreadCacheChunkShard& shard = ChunkShardFor(ptr);
+    mutex_lock l(shard.mu);
+    auto it = shard.chunk_sizes.find(ptr);
+    if (it == shard.chunk_sizes.end()) return false;
+    if (timing_counter_ != nullptr ||
+        tsl::profiler::TraceMe::Active(tsl::profiler::TraceMeLevel::kInfo)) {
+      shard.chunk_sizes.erase(it);
+      return false;
+    }
+    chunk_size = it->second;
+  }
+  ThreadCache* cache = GetThreadCache();
+  bool trim;
+  {
+    mutex_lock l(cache->mu);
+    cache->free_lists[ThreadCache::SizeIndex(chunk_size)].push_back(ptr);
+    cache->cached_bytes += chunk_size;
+    trim = ++cache->ops_since_trim >= kThreadCacheTrimInterval ||
+           cache->cached_bytes > kThreadCacheMaxBytes;
+  }
+  if (trim) TrimThreadCache(cache);
+  return true;
+}
+
+void BFCAllocator::TrimThreadCache(ThreadCache* cache) {
+  bool released;
+  {
+    mutex_lock l(lock_);
+    released = ReleaseThreadCacheChunks(cache, /*all=*/false);
+  }
+  if (released) retry_helper_.NotifyDealloc();
+}
+
+bool BFCAllocator::ReleaseThreadCacheChunks(ThreadCache* cache, bool all) {
+  mutex_lock l(cache->mu);
+  bool released = false;
+  for (int i = 0; i < ThreadCache::kNumSizes; ++i) {
+    std::vector<void*>& free_list = cache->free_lists[i];
+    size_t num_to_release = all ? free_list.size() : cache->low_water[i];
+    if (cache->cached_bytes > kThreadCacheMaxBytes) {
+      num_to_release = std::max(num_to_release, (free_list.size() + 1) / 2);
+    }
+    const size_t chunk_size = (i + 1) * kMinAllocationSize;
+    for (size_t j = 0; j < num_to_release; ++j) {
+      void* ptr = free_list.back();
+      free_list.pop_back();
+      {
+        ThreadCacheChunkShard& shard = ChunkShardFor(ptr);
+        mutex_lock shard_lock(shard.mu);
+        shard.chunk_sizes.erase(ptr);
+      }
+      FreeChunkPtr(ptr);
+    }
+    cache->cached_bytes -= num_to_release * chunk_size;
+    cache->low_water[i] = free_list.size();
+    released |= num_to_release > 0;
+  }
+  cache->ops_since_trim = 0;
+  return released;
+}
+
+bool BFCAllocator::FlushThreadCaches() {
+  bool released;
+  {
+    mutex_lock l(lock_);
+    released = FlushThreadCachesLocked();
+  }
+  if (released) retry_helper_.NotifyDealloc();
+  return released;
+}
+
+bool BFCAllocator::FlushThreadCachesLocked() {
+  if (!opts_.use_thread_caches) return false;
+  mutex_lock l(thread_caches_mu_);
+  bool released = false;
+  for (const auto& cache : thread_caches_) {
+    released |= ReleaseThreadCacheChunks(cache.get(), /*all=*/true);
+  }
+  RemoveOrphanedThreadCaches();
+  return released;
+}
+
+void BFCAllocator::RemoveOrphanedThreadCaches() {
+  auto orphans_begin = std::partition(
+      thread_caches_.begin(), thread_caches_.end(), [](const auto& cache) {
+        return !cache->orphaned.load(std::memory_order_acquire);
+      });
+  for (auto it = orphans_begin; it != thread_caches_.end(); ++it) {
+    ThreadCache* cache = it->get();
+    ReleaseThreadCacheChunks(cache, /*all=*/true);
+    mutex_lock l(cache->mu);
+    stats_.num_allocs += cache->num_allocs;
+    stats_.largest_alloc_size =
+        std::max(stats_.largest_alloc_size, cache->largest_alloc_size);
+  }
+  thread_caches_.erase(orphans_begin, thread_caches_.end());
+}
+
 // static
 size_t BFCAllocator::RoundedBytes(size_t bytes) {
   size_t rounded_bytes =
@@ -331,26 +591,9 @@ bool BFCAllocator::DeallocateFreeRegions(size_t rounded_bytes)
   }
 
   // Searching for free regions.
-  absl::flat_hash_set<void*> free_region_ptrs;
   size_t total_free_bytes = 0;
-  for (const AllocationRegion& region : region_manager_.regions()) {
-    ChunkHandle h = region_manager_.get_handle(region.ptr());
-    bool any_use = false;
-    while (h != kInvalidChunkHandle) {
-      const Chunk* c = ChunkFromHandle(h);
-      if (c->in_use()) {
-        any_use = true;
-        break;
-      }
-      h = c->next;
-    }
-
-    if (!any_use) {
-      VLOG(2) << "Found free region with ptr = " << region.ptr();
-      free_region_ptrs.insert(region.ptr());
-      total_free_bytes += region.memory_size();
-    }
-  }
+  absl::flat_hash_set<void*> free_region_ptrs =
+      FindFreeRegions(&total_free_bytes);
 
   if (total_free_bytes == 0) {
     return false;
@@ -379,6 +622,99 @@ bool BFCAllocator::DeallocateFreeRegions(size_t rounded_bytes)
   return true;
 }
 
+absl::flat_hash_set<void*> BFCAllocator::FindFreeRegions(
+    size_t* total_free_bytes) {
+  absl::flat_hash_set<void*> free_region_ptrs;
+  for (const AllocationRegion& region : region_manager_.regions()) {
+    ChunkHandle h = region_manager_.get_handle(region.ptr());
+    bool any_use = false;
+    while (h != kInvalidChunkHandle) {
+      const Chunk* c = ChunkFromHandle(h);
+      if (c->in_use()) {
+        any_use = true;
+        break;
+      }
+      h = c->next;
+    }
+
+    if (!any_use) {
+      VLOG(2) << "Found free region with ptr = " << region.ptr();
+      free_region_ptrs.insert(region.ptr());
+      *total_free_bytes += region.memory_size();
+    }
+  }
+  return free_region_ptrs;
+}
+
+size_t BFCAllocator::Compact() {
+  size_t released;
+  {
+    mutex_lock l(lock_);
+    released = CompactInternal(/*idle_only=*/false, /*min_fragmentation=*/0);
+  }
+  if (released > 0) retry_helper_.NotifyDealloc();
+  return released;
+}
+
+size_t BFCAllocator::CompactInternal(bool idle_only, double min_fragmentation) {
+  FlushThreadCachesLocked();
+  if (!timestamped_chunks_.empty()) {
+    MergeTimestampedChunks(0);
+  }
+
+  size_t total_free_bytes = 0;
+  absl::flat_hash_set<void*> free_region_ptrs =
+      FindFreeRegions(&total_free_bytes);
+  absl::flat_hash_set<void*> region_ptrs_to_release;
+  if (idle_only) {
+    // Regions that were free at the previous pass may have been used and freed
+    // again since, but releasing them is still unlikely to be followed by an
+    // immediate re-allocation.
+    for (void* ptr : free_region_ptrs) {
+      if (idle_free_regions_.contains(ptr)) {
+        region_ptrs_to_release.insert(ptr);
+      }
+    }
+    for (void* ptr : region_ptrs_to_release) {
+      free_region_ptrs.erase(ptr);
+    }
+    idle_free_regions_ = std::move(free_region_ptrs);
+  } else {
+    region_ptrs_to_release = std::move(free_region_ptrs);
+  }
+  if (region_ptrs_to_release.empty()) return 0;
+  if (min_fragmentation > 0 &&
+      (*stats_.pool_bytes <= stats_.bytes_in_use ||
+       GetFragmentation() < min_fragmentation)) {
+    return 0;
+  }
+
+  const int64_t pool_bytes = *stats_.pool_bytes;
+  DeallocateRegions(region_ptrs_to_release);
+  const size_t released = pool_bytes - *stats_.pool_bytes;
+  VLOG(1) << "Compaction of " << Name() << " released "
+          << strings::HumanReadableNumBytes(released) << " in "
+          << region_ptrs_to_release.size() << " regions";
+  metrics::UpdateBfcAllocatorReleasedBytes(released);
+  return released;
+}
+
+void BFCAllocator::CompactionLoop() {
+  mutex_lock l(compaction_mu_);
+  while (!stop_compaction_) {
+    compaction_cv_.wait_for(
+        l, std::chrono::milliseconds(opts_.compaction_interval_ms));
+    if (stop_compaction_) break;
+    size_t released;
+    {
+      mutex_lock l2(lock_);
+      released = CompactInternal(/*idle_only=*/true,
+                                 opts_.compaction_fragmentation_threshold);
+    }
+    if (released > 0) retry_helper_.NotifyDealloc();
+  }
+}
+
 void BFCAllocator::DeallocateRegions(
     const absl::flat_hash_set<void*>& region_ptrs)
     TF_EXCLUSIVE_LOCKS_REQUIRED(lock_) {
@@ -468,6 +804,16 @@ void* BFCAllocator::AllocateRawInternal(size_t unused_alignment,
   // the unallocated bytes cannot satisfy the request. Before giving up, let's
   // try deallocating free regions so that suballocator can combine them with
   // the unallocated bytes and form a larger region.
+  // Chunks held in thread caches can be merged into a large enough chunk once
+  // they are back in the bins.
+  if (FlushThreadCachesLocked()) {
+    ptr = FindChunkPtr(bin_num, rounded_bytes, num_bytes, freed_before);
+    if (ptr != nullptr) {
+      AddTraceMe("MemoryAllocation", ptr);
+      return ptr;
+    }
+  }
+
   if (DeallocateFreeRegions(rounded_bytes) &&
       Extend(unused_alignment, rounded_bytes)) {
     ptr = FindChunkPtr(bin_num, rounded_bytes, num_bytes, freed_before);
@@ -515,6 +861,18 @@ double BFCAllocator::GetFragmentation() {
          bytes_available;
 }
 
+string BFCAllocator::FreeBytesByBin() {
+  BinNum num_bins = kNumBins;
+  while (num_bins > 0 && BinFromIndex(num_bins - 1)->free_bytes == 0) {
+    --num_bins;
+  }
+  std::vector<size_t> free_bytes(num_bins);
+  for (BinNum b = 0; b < num_bins; b++) {
+    free_bytes[b] = BinFromIndex(b)->free_bytes;
+  }
+  return absl::StrJoin(free_bytes, ",");
+}
+
 void BFCAllocator::AddTraceMe(absl::string_view traceme_name, const void* ptr) {
   BFCAllocator::Chunk* chunk = ChunkFromHandle(region_manager_.get_handle(ptr));
   AddTraceMe(traceme_name, chunk->ptr, chunk->requested_size, chunk->size);
@@ -542,6 +900,7 @@ void BFCAllocator::AddTraceMe(absl::string_view traceme_name,
                                {"bytes_allocated", stats_.bytes_in_use},
                                {"bytes_available", bytes_available},
                                {"fragmentation", GetFragmentation()},
+                               {"free_bytes_by_bin", FreeBytesByBin()},
                                {"peak_bytes_in_use", stats_.peak_bytes_in_use},
                                {"requested_bytes", req_bytes},
                                {"allocation_bytes", alloc_bytes},
@@ -601,6 +960,9 @@ void* BFCAllocator::FindChunkPtr(BinNum bin_num, size_t rounded_bytes,
         // Update stats.
         ++stats_.num_allocs;
         stats_.bytes_in_use += chunk->size;
+        Bin* used_bin = BinForSize(chunk->size);
+        ++used_bin->num_chunks_in_use;
+        used_bin->bytes_in_use += chunk->size;
         if (stats_.bytes_in_use > stats_.peak_bytes_in_use) {
           VLOG(2) << "New Peak memory usage of " << stats_.bytes_in_use
                   << " bytes for " << Name();
@@ -684,6 +1046,10 @@ void BFCAllocator::SplitChunk(BFCAllocator::ChunkHandle h, size_t num_bytes) {
 void BFCAllocator::DeallocateRaw(void* ptr) {
   VLOG(3) << "DeallocateRaw " << Name() << " "
           << (ptr ? RequestedSize(ptr) : 0);
+  if (opts_.use_thread_caches && ptr != nullptr &&
+      DeallocateToThreadCache(ptr)) {
+    return;
+  }
   DeallocateRawInternal(ptr);
   retry_helper_.NotifyDealloc();
 }
@@ -694,7 +1060,10 @@ void BFCAllocator::DeallocateRawInternal(void* ptr) {
     return;
   }
   mutex_lock l(lock_);
+  FreeChunkPtr(ptr);
+}
 
+void BFCAllocator::FreeChunkPtr(void* ptr) {
   // Find the chunk from the ptr.
   BFCAllocator::ChunkHandle h = region_manager_.get_handle(ptr);
   CHECK(h != kInvalidChunkHandle);
@@ -772,6 +1141,7 @@ void BFCAllocator::InsertFreeChunkIntoBin(BFCAllocator::ChunkHandle h) {
   Bin* new_bin = BinFromIndex(bin_num);
   c->bin_num = bin_num;
   new_bin->free_chunks.insert(h);
+  new_bin->free_bytes += c->size;
 }
 
 void BFCAllocator::RemoveFreeChunkIterFromBin(
@@ -781,14 +1151,16 @@ void BFCAllocator::RemoveFreeChunkIterFromBin(
   Chunk* c = ChunkFromHandle(h);
   CHECK(!c->in_use() && (c->bin_num != kInvalidBinNum));
   free_chunks->erase(citer);
+  BinFromIndex(c->bin_num)->free_bytes -= c->size;
   c->bin_num = kInvalidBinNum;
 }
 
 void BFCAllocator::RemoveFreeChunkFromBin(BFCAllocator::ChunkHandle h) {
   Chunk* c = ChunkFromHandle(h);
   CHECK(!c->in_use() && (c->bin_num != kInvalidBinNum));
-  CHECK_GT(BinFromIndex(c->bin_num)->free_chunks.erase(h), 0)
-      << "Could not find chunk in bin";
+  Bin* bin = BinFromIndex(c->bin_num);
+  CHECK_GT(bin->free_chunks.erase(h), 0) << "Could not find chunk in bin";
+  bin->free_bytes -= c->size;
   c->bin_num = kInvalidBinNum;
 }
 
@@ -806,6 +1178,9 @@ void BFCAllocator::MarkFree(BFCAllocator::ChunkHandle h) {
 
   // Updates the stats.
   stats_.bytes_in_use -= c->size;
+  Bin* used_bin = BinForSize(c->size);
+  --used_bin->num_chunks_in_use;
+  used_bin->bytes_in_use -= c->size;
 
 #ifdef TENSORFLOW_MEM_DEBUG
   if (ShouldRecordOpName()) {
@@ -933,7 +1308,9 @@ bool BFCAllocator::MergeTimestampedChunks(size_t required_bytes) {
   return satisfied;
 }
 
-bool BFCAllocator::TracksAllocationSizes() const { return true; }
+bool BFCAllocator::TracksAllocationSizes() const {
+  return !opts_.use_thread_caches;
+}
 
 size_t BFCAllocator::RequestedSize(const void* ptr) const {
   CHECK(ptr);
@@ -1207,7 +1584,26 @@ MemoryDump BFCAllocator::RecordMemoryMapInternal() {
 
 absl::optional<AllocatorStats> BFCAllocator::GetStats() {
   mutex_lock l(lock_);
-  return stats_;
+  AllocatorStats stats = stats_;
+  stats.chunk_size_bins.resize(kNumBins);
+  for (BinNum b = 0; b < kNumBins; b++) {
+    const Bin* bin = BinFromIndex(b);
+    AllocatorStats::ChunkSizeBin& bin_stats = stats.chunk_size_bins[b];
+    bin_stats.min_chunk_bytes = bin->bin_size;
+    bin_stats.num_chunks_in_use = bin->num_chunks_in_use;
+    bin_stats.bytes_in_use = bin->bytes_in_use;
+    bin_stats.num_free_chunks = bin->free_chunks.size();
+    bin_stats.free_bytes = bin->free_bytes;
+  }
+  mutex_lock l2(thread_caches_mu_);
+  for (const auto& cache : thread_caches_) {
+    mutex_lock l3(cache->mu);
+    stats.bytes_in_use -= cache->cached_bytes;
+    stats.num_allocs += cache->num_allocs;
+    stats.largest_alloc_size =
+        std::max(stats.largest_alloc_size, cache->largest_alloc_size);
+  }
+  return stats;
 }
 
 bool BFCAllocator::ClearStats() {
@@ -1215,6 +1611,12 @@ bool BFCAllocator::ClearStats() {
   stats_.num_allocs = 0;
   stats_.peak_bytes_in_use = stats_.bytes_in_use;
   stats_.largest_alloc_size = 0;
+  mutex_lock l2(thread_caches_mu_);
+  for (const auto& cache : thread_caches_) {
+    mutex_lock l3(cache->mu);
+    cache->num_allocs = 0;
+    cache->largest_alloc_size = 0;
+  }
   return true;
 }
 
@@ -17,12 +17,14 @@ limitations under the License.
 #define TENSORFLOW_TSL_FRAMEWORK_BFC_ALLOCATOR_H_
 
 #include <array>
+#include <atomic>
 #include <deque>
 #include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "tensorflow/tsl/framework/allocator.h"
 #include "tensorflow/tsl/framework/allocator_retry.h"
@@ -40,6 +42,8 @@ class MemoryDump;
 namespace tsl {
 using tensorflow::MemoryDump;
 
+class Thread;
+
 // A memory allocator that implements a 'best-fit with coalescing'
 // algorithm.  This is essentially a very simple version of Doug Lea's
 // malloc (dlmalloc).
@@ -68,6 +72,31 @@ class BFCAllocator : public Allocator {
     // Controls when a chunk should be split, if its size exceeds the requested
     // allocation size.
     double fragmentation_fraction = 0;
+
+    // If true, chunks of up to kThreadCacheMaxChunkSize bytes are kept in
+    // per-thread caches when they are freed, and later allocations of the same
+    // size on that thread reuse them without taking the allocator's lock.
+    // Cached chunks are returned to the bins when they have been idle for a
+    // while, when a thread caches more than kThreadCacheMaxBytes, and before
+    // an allocation fails for lack of memory.
+    //
+    // Chunks held in thread caches are reported as free by GetStats(), but
+    // count as in use for peak_bytes_in_use and in memory maps. RequestedSize()
+    // and AllocationId() of a reused chunk are those of the allocation that
+    // first took the chunk from the bins, so TracksAllocationSizes() returns
+    // false. Thread caches are bypassed while the allocator uses a timing
+    // counter or memory allocations are being traced.
+    bool use_thread_caches = false;
+
+    // If positive, a background thread compacts the allocator every
+    // `compaction_interval_ms` milliseconds, releasing the regions that have
+    // been entirely free since the previous pass; see Compact().
+    int64_t compaction_interval_ms = 0;
+
+    // Background compaction only releases regions while the fragmentation of
+    // the free memory (the fraction of it outside the largest free chunk) is
+    // at least this value.
+    double compaction_fragmentation_threshold = 0;
   };
   BFCAllocator(std::unique_ptr<SubAllocator> sub_allocator, size_t total_memory,
                const string& name, const Options& opts);
@@ -107,8 +136,24 @@ class BFCAllocator : public Allocator {
 
   MemoryDump RecordMemoryMap();
 
+  // Returns the chunks held in all thread caches to the bins. Returns true if
+  // any chunk was returned.
+  bool FlushThreadCaches();
+
+  // Returns free memory to the sub-allocator: flushes the thread caches,
+  // coalesces the timestamped chunks that have become safe, and frees the
+  // regions that no longer contain an allocated chunk. Returns the number of
+  // bytes released.
+  size_t Compact();
+
+  // Thread caches hold chunks of at most this many bytes.
+  static constexpr size_t kThreadCacheMaxChunkSize = 4096;
+  // Maximum number of bytes held in the cache of one thread.
+  static constexpr size_t kThreadCacheMaxBytes = 1 << 20;
+
  private:
   struct Bin;
+  struct ThreadCache;
 
   void* AllocateRawInternal(size_t alignment, size_t num_bytes,
                             bool dump_log_on_failure,
@@ -120,6 +165,46 @@ class BFCAllocator : public Allocator {
 
   void DeallocateRawInternal(void* ptr);
 
+  // Returns the chunk containing 'ptr' to the bins.
+  void FreeChunkPtr(void* ptr) TF_EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Returns true if an allocation of 'num_bytes' may use the thread cache.
+  bool UseThreadCache(size_t num_bytes,
+                      const AllocationAttributes& allocation_attr) const;
+
+  // Returns the cache of the calling thread, creating it if needed.
+  ThreadCache* GetThreadCache();
+
+  // Pops a chunk of exactly 'rounded_bytes' bytes from the cache of the calling
+  // thread, or returns nullptr.
+  void* AllocateFromThreadCache(size_t rounded_bytes);
+
+  // Records that the chunk at 'ptr', which was just allocated from the bins
+  // for a request that may use the thread cache, can be cached when freed.
+  void RegisterThreadCacheChunk(void* ptr);
+
+  // Pushes the chunk at 'ptr' to the cache of the calling thread. Returns false
+  // if the chunk must be returned to the bins instead.
+  bool DeallocateToThreadCache(void* ptr);
+
+  // Returns the chunks of 'cache' that have not been used since the last trim,
+  // and enough others to bring it under kThreadCacheMaxBytes, to the bins.
+  void TrimThreadCache(ThreadCache* cache);
+
+  // Returns chunks of 'cache' to the bins: all of them if 'all' is true,
+  // otherwise as described in TrimThreadCache. Returns true if any chunk was
+  // returned.
+  bool ReleaseThreadCacheChunks(ThreadCache* cache, bool all)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Returns the chunks held in all thread caches to the bins.
+  bool FlushThreadCachesLocked() TF_EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Flushes the caches of threads that have exited, folds their stats into
+  // stats_, and forgets them.
+  void RemoveOrphanedThreadCaches()
+      TF_EXCLUSIVE_LOCKS_REQUIRED(lock_, thread_caches_mu_);
+
   // Chunks whose freed_at_count is later than the safe frontier value are kept
   // on a special list and not subject to merging immediately upon being freed.
   //
@@ -270,6 +355,12 @@ class BFCAllocator : public Allocator {
     // List of free chunks within the bin, sorted by chunk size.
     // Chunk * not owned.
     FreeChunkSet free_chunks;
+    // Total size of free_chunks.
+    size_t free_bytes = 0;
+    // Number and total size of the allocated chunks whose size falls in this
+    // bin, including the chunks held in thread caches.
+    size_t num_chunks_in_use = 0;
+    size_t bytes_in_use = 0;
     Bin(BFCAllocator* allocator, size_t bs)
         : bin_size(bs), free_chunks(ChunkComparator(allocator)) {}
   };
@@ -465,6 +556,20 @@ class BFCAllocator : public Allocator {
   void DeallocateRegions(const absl::flat_hash_set<void*>& region_ptrs)
       TF_EXCLUSIVE_LOCKS_REQUIRED(lock_);
 
+  // Returns the regions that contain no allocated chunk, and adds their sizes
+  // to *total_free_bytes.
+  absl::flat_hash_set<void*> FindFreeRegions(size_t* total_free_bytes)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Implements Compact(). If 'idle_only', only the regions that were already
+  // entirely free at the previous idle-only pass are released, and nothing is
+  // released while the fragmentation is below 'min_fragmentation'.
+  size_t CompactInternal(bool idle_only, double min_fragmentation)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Body of the background compaction thread.
+  void CompactionLoop();
+
   // Returns a pointer to an underlying allocated chunk of size
   // 'rounded_bytes'.
   void* FindChunkPtr(BinNum bin_num, size_t rounded_bytes, size_t num_bytes,
@@ -517,6 +622,10 @@ class BFCAllocator : public Allocator {
   // size over total free memory, and returns a value within [0, 1].
   double GetFragmentation() TF_EXCLUSIVE_LOCKS_REQUIRED(lock_);
 
+  // Returns the free bytes in each bin, separated by commas, omitting the
+  // trailing empty bins.
+  string FreeBytesByBin() TF_EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
   // Information about a Bin that is useful for debugging.
   struct BinDebugInfo {
     size_t total_bytes_in_use = 0;
@@ -609,8 +718,40 @@ class BFCAllocator : public Allocator {
   // newly-created chunk.
   int64_t next_allocation_id_ TF_GUARDED_BY(lock_);
 
-  // Stats.
+  // Stats. With thread caches, chunks held by the caches count as in use, and
+  // allocations served by the caches are not counted; see GetStats().
   AllocatorStats stats_ TF_GUARDED_BY(lock_);
+
+  // Sizes of the chunks that were allocated from the bins for requests that
+  // may use the thread cache, and that have not been returned to the bins
+  // since. Sharded by address so that deallocations on different threads
+  // rarely contend.
+  struct alignas(64) ThreadCacheChunkShard {
+    mutex mu;
+    absl::flat_hash_map<const void*, size_t> chunk_sizes TF_GUARDED_BY(mu);
+  };
+  static constexpr int kNumThreadCacheChunkShards = 64;
+  ThreadCacheChunkShard& ChunkShardFor(const void* ptr) {
+    return thread_cache_chunks_[(reinterpret_cast<std::uintptr_t>(ptr) >>
+                                 kMinAllocationBits) %
+                                kNumThreadCacheChunkShards];
+  }
+  std::unique_ptr<ThreadCacheChunkShard[]> thread_cache_chunks_;
+
+  // Identifies this allocator in the thread-local lists of caches, since the
+  // address of a destroyed allocator may be reused.
+  const int64_t thread_cache_key_;
+  mutable mutex thread_caches_mu_;
+  std::vector<std::shared_ptr<ThreadCache>> thread_caches_
+      TF_GUARDED_BY(thread_caches_mu_);
+
+  // Regions that were entirely free at the last background compaction pass.
+  absl::flat_hash_set<void*> idle_free_regions_ TF_GUARDED_BY(lock_);
+
+  mutex compaction_mu_;
+  condition_variable compaction_cv_;
+  bool stop_compaction_ TF_GUARDED_BY(compaction_mu_) = false;
+  std::unique_ptr<Thread> compaction_thread_;
 #ifdef TENSORFLOW_MEM_DEBUG
   int64 action_counter_ TF_GUARDED_BY(lock_) = 0;
 #define MEM_DEBUG_SIZE_HISTORY_SIZE 4096
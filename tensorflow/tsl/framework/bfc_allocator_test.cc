@@ -0,0 +1,330 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/tsl/framework/bfc_allocator.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "tensorflow/tsl/platform/blocking_counter.h"
+#include "tensorflow/tsl/platform/env.h"
+#include "tensorflow/tsl/platform/mem.h"
+#include "tensorflow/tsl/platform/mutex.h"
+#include "tensorflow/tsl/platform/test.h"
+#include "tensorflow/tsl/platform/test_benchmark.h"
+#include "tensorflow/tsl/platform/threadpool.h"
+
+namespace tsl {
+namespace {
+
+class HostSubAllocator : public SubAllocator {
+ public:
+  HostSubAllocator() : SubAllocator({}, {}) {}
+
+  void* Alloc(size_t alignment, size_t num_bytes,
+              size_t* bytes_received) override {
+    *bytes_received = num_bytes;
+    return port::AlignedMalloc(num_bytes, std::max<size_t>(alignment, 64));
+  }
+  void Free(void* ptr, size_t num_bytes) override { port::AlignedFree(ptr); }
+  bool SupportsCoalescing() const override { return false; }
+};
+
+std::unique_ptr<BFCAllocator> CreateAllocator(
+    size_t total_memory, const BFCAllocator::Options& opts) {
+  return std::make_unique<BFCAllocator>(std::make_unique<HostSubAllocator>(),
+                                        total_memory, "host_bfc", opts);
+}
+
+std::unique_ptr<BFCAllocator> CreateAllocator(size_t total_memory,
+                                              bool use_thread_caches,
+                                              bool allow_growth = true) {
+  BFCAllocator::Options opts;
+  opts.allow_growth = allow_growth;
+  opts.allow_retry_on_failure = false;
+  opts.use_thread_caches = use_thread_caches;
+  return CreateAllocator(total_memory, opts);
+}
+
+TEST(BFCAllocatorTest, ThreadCacheReusesChunks) {
+  auto a = CreateAllocator(1 << 30, /*use_thread_caches=*/true);
+  EXPECT_FALSE(a->TracksAllocationSizes());
+
+  void* p1 = a->AllocateRaw(64, 1000);
+  ASSERT_NE(nullptr, p1);
+  EXPECT_EQ(1024, a->AllocatedSize(p1));
+  a->DeallocateRaw(p1);
+
+  AllocatorStats stats = *a->GetStats();
+  EXPECT_EQ(0, stats.bytes_in_use);
+  EXPECT_EQ(1, stats.num_allocs);
+
+  // An allocation of the same size reuses the cached chunk.
+  void* p2 = a->AllocateRaw(64, 1010);
+  EXPECT_EQ(p1, p2);
+  stats = *a->GetStats();
+  EXPECT_EQ(1024, stats.bytes_in_use);
+  EXPECT_EQ(2, stats.num_allocs);
+  EXPECT_EQ(1024, stats.largest_alloc_size);
+
+  // Allocations of other sizes do not.
+  void* p3 = a->AllocateRaw(64, 2000);
+  EXPECT_NE(p2, p3);
+  a->DeallocateRaw(p2);
+  a->DeallocateRaw(p3);
+
+  // Large allocations never use the cache.
+  void* p4 = a->AllocateRaw(64, BFCAllocator::kThreadCacheMaxChunkSize + 1);
+  a->DeallocateRaw(p4);
+  stats = *a->GetStats();
+  EXPECT_EQ(0, stats.bytes_in_use);
+  EXPECT_EQ(4, stats.num_allocs);
+
+  EXPECT_TRUE(a->FlushThreadCaches());
+  EXPECT_FALSE(a->FlushThreadCaches());
+  stats = *a->GetStats();
+  EXPECT_EQ(0, stats.bytes_in_use);
+  EXPECT_EQ(4, stats.num_allocs);
+
+  EXPECT_TRUE(a->ClearStats());
+  stats = *a->GetStats();
+  EXPECT_EQ(0, stats.num_allocs);
+  EXPECT_EQ(0, stats.largest_alloc_size);
+}
+
+TEST(BFCAllocatorTest, ThreadCacheIsBoundedInBytes) {
+  auto a = CreateAllocator(1 << 30, /*use_thread_caches=*/true);
+  constexpr size_t kChunkSize = 4096;
+  constexpr int kNumChunks =
+      2 * BFCAllocator::kThreadCacheMaxBytes / kChunkSize;
+  std::vector<void*> ptrs;
+  for (int i = 0; i < kNumChunks; ++i) {
+    ptrs.push_back(a->AllocateRaw(64, kChunkSize));
+  }
+  for (void* ptr : ptrs) {
+    a->DeallocateRaw(ptr);
+  }
+  EXPECT_EQ(0, a->GetStats()->bytes_in_use);
+
+  // Some chunks went back to the bins when the cache exceeded its limit, so
+  // not all of these allocations are served from the cache.
+  const int64_t num_allocs = a->GetStats()->num_allocs;
+  ptrs.clear();
+  for (int i = 0; i < kNumChunks; ++i) {
+    ptrs.push_back(a->AllocateRaw(64, kChunkSize));
+  }
+  EXPECT_EQ(num_allocs + kNumChunks, a->GetStats()->num_allocs);
+  EXPECT_EQ(kNumChunks * kChunkSize, a->GetStats()->bytes_in_use);
+  for (void* ptr : ptrs) {
+    a->DeallocateRaw(ptr);
+  }
+}
+
+TEST(BFCAllocatorTest, CachedChunksAreReclaimedBeforeFailing) {
+  constexpr size_t kMemory = 1 << 20;
+  auto a = CreateAllocator(kMemory, /*use_thread_caches=*/true,
+                           /*allow_growth=*/false);
+  std::vector<void*> ptrs;
+  for (int i = 0; i < kMemory / 1024; ++i) {
+    void* ptr = a->AllocateRaw(64, 1024);
+    ASSERT_NE(nullptr, ptr);
+    ptrs.push_back(ptr);
+  }
+  EXPECT_EQ(nullptr, a->AllocateRaw(64, 1024));
+  for (void* ptr : ptrs) {
+    a->DeallocateRaw(ptr);
+  }
+  // The freed chunks are held in the cache of this thread, but they are
+  // flushed and coalesced to serve a large allocation.
+  void* ptr = a->AllocateRaw(64, kMemory / 2);
+  ASSERT_NE(nullptr, ptr);
+  EXPECT_EQ(kMemory / 2, a->GetStats()->bytes_in_use);
+  a->DeallocateRaw(ptr);
+}
+
+TEST(BFCAllocatorTest, ThreadCachesWithCrossThreadFrees) {
+  auto a = CreateAllocator(1 << 30, /*use_thread_caches=*/true);
+  constexpr int kNumThreads = 8;
+  constexpr int kNumIterations = 2000;
+
+  // Each thread frees the allocations of the previous thread.
+  mutex mu;
+  std::vector<std::vector<void*>> handoff(kNumThreads);
+  {
+    thread::ThreadPool pool(Env::Default(), "test", kNumThreads);
+    for (int t = 0; t < kNumThreads; ++t) {
+      pool.Schedule([&, t]() {
+        std::mt19937 rng(t);
+        std::uniform_int_distribution<size_t> num_bytes_dist(1, 8192);
+        for (int i = 0; i < kNumIterations; ++i) {
+          const size_t num_bytes = num_bytes_dist(rng);
+          void* ptr = a->AllocateRaw(64, num_bytes);
+          CHECK(ptr != nullptr);
+          memset(ptr, t, num_bytes);
+          void* to_free = nullptr;
+          {
+            mutex_lock l(mu);
+            handoff[t].push_back(ptr);
+            std::vector<void*>& prev = handoff[(t + 1) % kNumThreads];
+            if (!prev.empty()) {
+              to_free = prev.back();
+              prev.pop_back();
+            }
+          }
+          if (to_free != nullptr) a->DeallocateRaw(to_free);
+        }
+      });
+    }
+  }
+  for (auto& ptrs : handoff) {
+    for (void* ptr : ptrs) {
+      a->DeallocateRaw(ptr);
+    }
+  }
+  AllocatorStats stats = *a->GetStats();
+  EXPECT_EQ(0, stats.bytes_in_use);
+  EXPECT_EQ(kNumThreads * kNumIterations, stats.num_allocs);
+
+  // The pool threads have exited; their caches are flushed and their stats
+  // kept.
+  a->FlushThreadCaches();
+  stats = *a->GetStats();
+  EXPECT_EQ(0, stats.bytes_in_use);
+  EXPECT_EQ(kNumThreads * kNumIterations, stats.num_allocs);
+}
+
+TEST(BFCAllocatorTest, ChunkSizeBins) {
+  auto a = CreateAllocator(1 << 30, /*use_thread_caches=*/false);
+  void* p1 = a->AllocateRaw(64, 1000);
+  void* p2 = a->AllocateRaw(64, 1000);
+  void* p3 = a->AllocateRaw(64, 300);
+  a->DeallocateRaw(p1);
+
+  AllocatorStats stats = *a->GetStats();
+  ASSERT_FALSE(stats.chunk_size_bins.empty());
+  int64_t num_chunks_in_use = 0;
+  int64_t bytes_in_use = 0;
+  int64_t free_bytes = 0;
+  for (int b = 0; b < stats.chunk_size_bins.size(); ++b) {
+    const AllocatorStats::ChunkSizeBin& bin = stats.chunk_size_bins[b];
+    EXPECT_EQ(256 << b, bin.min_chunk_bytes);
+    num_chunks_in_use += bin.num_chunks_in_use;
+    bytes_in_use += bin.bytes_in_use;
+    free_bytes += bin.free_bytes;
+  }
+  EXPECT_EQ(2, num_chunks_in_use);
+  EXPECT_EQ(stats.bytes_in_use, bytes_in_use);
+  EXPECT_EQ(*stats.pool_bytes - stats.bytes_in_use, free_bytes);
+  // The 512-byte chunk of p3 and the 1KB chunk of p2 are in use, and the 1KB
+  // chunk of p1 could not be merged with its neighbors.
+  EXPECT_EQ(1, stats.chunk_size_bins[1].num_chunks_in_use);
+  EXPECT_EQ(512, stats.chunk_size_bins[1].bytes_in_use);
+  EXPECT_EQ(1, stats.chunk_size_bins[2].num_chunks_in_use);
+  EXPECT_EQ(1, stats.chunk_size_bins[2].num_free_chunks);
+  EXPECT_EQ(1024, stats.chunk_size_bins[2].free_bytes);
+
+  a->DeallocateRaw(p2);
+  a->DeallocateRaw(p3);
+  stats = *a->GetStats();
+  for (const AllocatorStats::ChunkSizeBin& bin : stats.chunk_size_bins) {
+    EXPECT_EQ(0, bin.num_chunks_in_use);
+  }
+}
+
+TEST(BFCAllocatorTest, CompactReleasesFreeRegions) {
+  auto a = CreateAllocator(1 << 30, /*use_thread_caches=*/true);
+  // The first region has 2MB, and the second one 4MB.
+  void* p1 = a->AllocateRaw(64, 1 << 20);
+  void* p2 = a->AllocateRaw(64, 3 << 20);
+  void* p3 = a->AllocateRaw(64, 1000);
+  EXPECT_EQ(6 << 20, *a->GetStats()->pool_bytes);
+  EXPECT_EQ(0, a->Compact());
+
+  a->DeallocateRaw(p2);
+  EXPECT_EQ(4 << 20, a->Compact());
+  EXPECT_EQ(2 << 20, *a->GetStats()->pool_bytes);
+
+  // The chunk of p3 is held in the thread cache, and flushed by Compact().
+  a->DeallocateRaw(p1);
+  a->DeallocateRaw(p3);
+  EXPECT_EQ(2 << 20, a->Compact());
+  AllocatorStats stats = *a->GetStats();
+  EXPECT_EQ(0, *stats.pool_bytes);
+  EXPECT_EQ(0, stats.bytes_in_use);
+
+  void* p4 = a->AllocateRaw(64, 1 << 20);
+  ASSERT_NE(nullptr, p4);
+  a->DeallocateRaw(p4);
+}
+
+TEST(BFCAllocatorTest, BackgroundCompactionReleasesIdleRegions) {
+  BFCAllocator::Options opts;
+  opts.compaction_interval_ms = 1;
+  auto a = CreateAllocator(1 << 30, opts);
+  void* ptr = a->AllocateRaw(64, 1 << 20);
+  EXPECT_EQ(2 << 20, *a->GetStats()->pool_bytes);
+  a->DeallocateRaw(ptr);
+  for (int i = 0; i < 10000 && *a->GetStats()->pool_bytes > 0; ++i) {
+    Env::Default()->SleepForMicroseconds(1000);
+  }
+  EXPECT_EQ(0, *a->GetStats()->pool_bytes);
+}
+
+// Allocates and frees buffers of 256 bytes to 4KB from `num_threads` threads.
+// Arguments are the number of threads and whether thread caches are used.
+void BM_AllocationThreaded(::testing::benchmark::State& state) {
+  const int num_threads = state.range(0);
+  const bool use_thread_caches = state.range(1) != 0;
+  constexpr int kAllocsPerThread = 10000;
+  constexpr int kLiveAllocs = 16;
+  auto a = CreateAllocator(1 << 30, use_thread_caches);
+  thread::ThreadPool pool(Env::Default(), "bench", num_threads);
+
+  for (auto s : state) {
+    BlockingCounter counter(num_threads);
+    for (int t = 0; t < num_threads; ++t) {
+      pool.Schedule([&a, &counter, t]() {
+        void* live[kLiveAllocs] = {};
+        for (int i = 0; i < kAllocsPerThread; ++i) {
+          const int slot = i % kLiveAllocs;
+          if (live[slot] != nullptr) a->DeallocateRaw(live[slot]);
+          const size_t num_bytes = 256 << ((i + t) % 5);
+          live[slot] = a->AllocateRaw(64, num_bytes);
+        }
+        for (void* ptr : live) {
+          if (ptr != nullptr) a->DeallocateRaw(ptr);
+        }
+        counter.DecrementCount();
+      });
+    }
+    counter.Wait();
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                          num_threads * kAllocsPerThread);
+}
+BENCHMARK(BM_AllocationThreaded)
+    ->UseRealTime()
+    ->ArgPair(1, 0)
+    ->ArgPair(1, 1)
+    ->ArgPair(4, 0)
+    ->ArgPair(4, 1)
+    ->ArgPair(16, 0)
+    ->ArgPair(16, 1);
+
+}  // namespace
+}  // namespace tsl
@@ -28,6 +28,11 @@ auto* bfc_allocator_delay =
                                 "The total time spent running each graph "
                                 "optimization pass in microseconds.");
 
+auto* bfc_allocator_released_bytes = monitoring::Counter<0>::New(
+    "/tensorflow/core/bfc_allocator_released_bytes",
+    "The total number of bytes that BFC allocators returned to their "
+    "sub-allocators when compacting.");
+
 }  // namespace
 
 void UpdateBfcAllocatorDelayTime(const uint64_t delay_usecs) {
@@ -37,5 +42,13 @@ void UpdateBfcAllocatorDelayTime(const uint64_t delay_usecs) {
   }
 }
 
+void UpdateBfcAllocatorReleasedBytes(const uint64_t released_bytes) {
+  static auto* bfc_allocator_released_bytes_cell =
+      bfc_allocator_released_bytes->GetCell();
+  if (released_bytes > 0) {
+    bfc_allocator_released_bytes_cell->IncrementBy(released_bytes);
+  }
+}
+
 }  // namespace metrics
 }  // namespace tsl
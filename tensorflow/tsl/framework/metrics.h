@@ -24,6 +24,10 @@ namespace metrics {
 // Updates the metrics stored about time BFC allocator spents during delay.
 void UpdateBfcAllocatorDelayTime(const uint64_t delay_usecs);
 
+// Updates the metrics stored about memory that BFC allocators returned to
+// their sub-allocators when compacting.
+void UpdateBfcAllocatorReleasedBytes(const uint64_t released_bytes);
+
 }  // namespace metrics
 }  // namespace tsl
 
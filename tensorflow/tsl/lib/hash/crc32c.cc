@@ -26,6 +26,8 @@ namespace crc32c {
 
 extern bool CanAccelerate();
 extern uint32_t AcceleratedExtend(uint32_t crc, const char *buf, size_t size);
+extern void AcceleratedValueBatch(const StringPiece *data, size_t n,
+                                  uint32_t *crcs);
 
 static const uint32 table0_[256] = {
     0x00000000, 0xf26b8303, 0xe13b70f7, 0x1350f3f4, 0xc79a971f, 0x35f1141c,
@@ -263,6 +265,17 @@ uint32 Extend(uint32 crc, const char *buf, size_t size) {
   return l ^ 0xffffffffu;
 }
 
+void ValueBatch(const StringPiece *data, size_t n, uint32 *crcs) {
+  static bool can_accelerate = CanAccelerate();
+  if (can_accelerate) {
+    AcceleratedValueBatch(data, n, crcs);
+    return;
+  }
+  for (size_t i = 0; i < n; ++i) {
+    crcs[i] = Value(data[i].data(), data[i].size());
+  }
+}
+
 #if defined(TF_CORD_SUPPORT)
 uint32 Extend(uint32 crc, const absl::Cord &cord) {
   for (absl::string_view fragment : cord.Chunks()) {
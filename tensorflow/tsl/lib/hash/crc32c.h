@@ -20,6 +20,7 @@ limitations under the License.
 
 #include "tensorflow/tsl/platform/cord.h"
 #include "tensorflow/tsl/platform/platform.h"
+#include "tensorflow/tsl/platform/stringpiece.h"
 #include "tensorflow/tsl/platform/types.h"
 
 namespace tsl {
@@ -41,6 +42,12 @@ inline uint32 Value(const char* data, size_t n) { return Extend(0, data, n); }
 inline uint32 Value(const absl::Cord& cord) { return Extend(0, cord); }
 #endif
 
+// Sets crcs[i] to the crc32c of data[i] for i in [0, n). When the crc32c
+// instructions are available, the computations of several inputs are
+// interleaved, which is much faster than computing the values one at a time
+// for many short inputs.
+extern void ValueBatch(const StringPiece* data, size_t n, uint32* crcs);
+
 static const uint32 kMaskDelta = 0xa282ead8ul;
 
 // Return a masked representation of crc.
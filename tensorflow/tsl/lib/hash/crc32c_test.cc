@@ -14,6 +14,10 @@ limitations under the License.
 ==============================================================================*/
 
 #include "tensorflow/tsl/lib/hash/crc32c.h"
+
+#include <string>
+#include <vector>
+
 #include "tensorflow/tsl/platform/logging.h"
 #include "tensorflow/tsl/platform/test.h"
 #include "tensorflow/tsl/platform/test_benchmark.h"
@@ -70,6 +74,25 @@ TEST(CRC, Mask) {
   ASSERT_EQ(crc, Unmask(Unmask(Mask(Mask(crc)))));
 }
 
+TEST(CRC, ValueBatch) {
+  std::string buf(300, '\0');
+  for (size_t i = 0; i < buf.size(); i++) {
+    buf[i] = i * 7;
+  }
+  // Inputs of different sizes and alignments, in batches of all sizes.
+  std::vector<StringPiece> data;
+  for (int i = 0; i < 20; i++) {
+    data.push_back(StringPiece(buf).substr(i * 3, i * i % 97));
+  }
+  for (size_t n = 0; n <= data.size(); n++) {
+    std::vector<uint32> crcs(n);
+    ValueBatch(data.data(), n, crcs.data());
+    for (size_t i = 0; i < n; i++) {
+      ASSERT_EQ(crcs[i], Value(data[i].data(), data[i].size()));
+    }
+  }
+}
+
 #if defined(PLATFORM_GOOGLE)
 TEST(CRC, ValuesWithCord) {
   ASSERT_NE(Value(absl::Cord("a")), Value(absl::Cord("foo")));
@@ -93,5 +116,33 @@ static void BM_CRC(::testing::benchmark::State& state) {
 }
 BENCHMARK(BM_CRC)->Range(1, 256 * 1024);
 
+// Computes the crc32c of a batch of 256 short inputs, as in the framing of
+// small records, one at a time or as a batch.
+static void BM_CRCBatch(::testing::benchmark::State& state) {
+  const int len = state.range(0);
+  const bool batch = state.range(1);
+  constexpr int kNumInputs = 256;
+  std::string input(len * kNumInputs, 'x');
+  std::vector<StringPiece> data;
+  for (int i = 0; i < kNumInputs; i++) {
+    data.push_back(StringPiece(input).substr(i * len, len));
+  }
+  std::vector<uint32> crcs(kNumInputs);
+  uint32 h = 0;
+  for (auto s : state) {
+    if (batch) {
+      ValueBatch(data.data(), data.size(), crcs.data());
+    } else {
+      for (int i = 0; i < kNumInputs; i++) {
+        crcs[i] = Value(data[i].data(), data[i].size());
+      }
+    }
+    h ^= crcs[kNumInputs - 1];
+  }
+  state.SetBytesProcessed(state.iterations() * len * kNumInputs);
+  VLOG(1) << h;
+}
+BENCHMARK(BM_CRCBatch)->ArgsProduct({{8, 64, 200, 1024}, {0, 1}});
+
 }  // namespace crc32c
 }  // namespace tsl
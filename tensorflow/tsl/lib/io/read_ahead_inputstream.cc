@@ -0,0 +1,154 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/tsl/lib/io/read_ahead_inputstream.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "tensorflow/tsl/platform/errors.h"
+
+namespace tsl {
+namespace io {
+
+ReadAheadInputStream::ReadAheadInputStream(RandomAccessFile* file,
+                                           size_t chunk_size, int num_chunks)
+    : file_(file),
+      chunk_size_(chunk_size),
+      num_chunks_(std::max(num_chunks, 1)) {}
+
+Status ReadAheadInputStream::FillBuffer() {
+  const int64_t offset = buffer_offset_ + limit_;
+  buffer_offset_ = offset;
+  pos_ = 0;
+  limit_ = 0;
+  if (!file_status_.ok()) {
+    return file_status_;
+  }
+  if (!buffer_) {
+    buffer_.reset(new char[chunk_size_ * num_chunks_]);
+  }
+  std::vector<RandomAccessFile::ReadRequest> requests(num_chunks_);
+  for (int i = 0; i < num_chunks_; ++i) {
+    requests[i].offset = offset + i * chunk_size_;
+    requests[i].n = chunk_size_;
+    requests[i].scratch = buffer_.get() + i * chunk_size_;
+  }
+  file_->ReadBatch(absl::MakeSpan(requests));
+
+  // The buffer holds the chunks up to the first short or failed read.
+  for (const RandomAccessFile::ReadRequest& request : requests) {
+    if (request.result.data() != request.scratch) {
+      memmove(request.scratch, request.result.data(), request.result.size());
+    }
+    limit_ += request.result.size();
+    if (!request.status.ok()) {
+      file_status_ = request.status;
+      break;
+    }
+    if (request.result.size() < request.n) {
+      file_status_ = errors::OutOfRange("reached end of file");
+      break;
+    }
+  }
+  return file_status_;
+}
+
+Status ReadAheadInputStream::ReadNBytes(int64_t bytes_to_read,
+                                        tstring* result) {
+  if (bytes_to_read < 0) {
+    return errors::InvalidArgument("Can't read a negative number of bytes: ",
+                                   bytes_to_read);
+  }
+  result->clear();
+  result->reserve(bytes_to_read);
+
+  Status s;
+  while (result->size() < static_cast<size_t>(bytes_to_read)) {
+    if (pos_ == limit_) {
+      s = FillBuffer();
+      // If we didn't read any bytes, we're at the end of the file.
+      if (limit_ == 0) {
+        DCHECK(!s.ok());
+        break;
+      }
+    }
+    const size_t bytes_to_copy =
+        std::min<size_t>(limit_ - pos_, bytes_to_read - result->size());
+    result->append(buffer_.get() + pos_, bytes_to_copy);
+    pos_ += bytes_to_copy;
+  }
+  // The last fill may have reached the end of the file after reading enough
+  // bytes for this call.
+  if (errors::IsOutOfRange(s) &&
+      result->size() == static_cast<size_t>(bytes_to_read)) {
+    return OkStatus();
+  }
+  return s;
+}
+
+Status ReadAheadInputStream::SkipNBytes(int64_t bytes_to_skip) {
+  if (bytes_to_skip < 0) {
+    return errors::InvalidArgument("Can only skip forward, not ",
+                                   bytes_to_skip);
+  }
+  if (pos_ + bytes_to_skip <= limit_) {
+    pos_ += bytes_to_skip;
+    return OkStatus();
+  }
+  if (file_status_.ok()) {
+    // If the last skipped byte exists, skips without reading the others.
+    const int64_t offset = Tell() + bytes_to_skip;
+    char scratch;
+    StringPiece data;
+    Status s = file_->Read(offset - 1, 1, &data, &scratch);
+    if ((s.ok() || errors::IsOutOfRange(s)) && data.size() == 1) {
+      buffer_offset_ = offset;
+      pos_ = 0;
+      limit_ = 0;
+      return OkStatus();
+    }
+  }
+  // Otherwise, reads up to the end of the file.
+  while (bytes_to_skip > 0) {
+    if (pos_ == limit_) {
+      Status s = FillBuffer();
+      if (limit_ == 0) {
+        return s;
+      }
+    }
+    const size_t bytes_skipped =
+        std::min<size_t>(limit_ - pos_, bytes_to_skip);
+    pos_ += bytes_skipped;
+    bytes_to_skip -= bytes_skipped;
+  }
+  return OkStatus();
+}
+
+int64_t ReadAheadInputStream::Tell() const { return buffer_offset_ + pos_; }
+
+Status ReadAheadInputStream::Reset() {
+  buffer_offset_ = 0;
+  pos_ = 0;
+  limit_ = 0;
+  file_status_ = OkStatus();
+  return OkStatus();
+}
+
+}  // namespace io
+}  // namespace tsl
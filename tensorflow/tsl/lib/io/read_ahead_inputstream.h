@@ -0,0 +1,71 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_TSL_LIB_IO_READ_AHEAD_INPUTSTREAM_H_
+#define TENSORFLOW_TSL_LIB_IO_READ_AHEAD_INPUTSTREAM_H_
+
+#include <memory>
+
+#include "tensorflow/tsl/lib/io/inputstream_interface.h"
+#include "tensorflow/tsl/platform/file_system.h"
+
+namespace tsl {
+namespace io {
+
+// Reads a RandomAccessFile sequentially through a buffer of `num_chunks`
+// chunks of `chunk_size` bytes each. The buffer is refilled with a single
+// `RandomAccessFile::ReadBatch()` of all of its chunks, so that file systems
+// that support it keep `num_chunks` reads outstanding at once.
+//
+// A single instance of ReadAheadInputStream is NOT safe for concurrent use by
+// multiple threads.
+class ReadAheadInputStream : public InputStreamInterface {
+ public:
+  // Does not take ownership of `file`, which must outlive *this.
+  ReadAheadInputStream(RandomAccessFile* file, size_t chunk_size,
+                       int num_chunks);
+
+  Status ReadNBytes(int64_t bytes_to_read, tstring* result) override;
+
+  Status SkipNBytes(int64_t bytes_to_skip) override;
+
+  int64_t Tell() const override;
+
+  Status Reset() override;
+
+ private:
+  // Reads the chunks following the buffered bytes into the buffer. Requires
+  // all buffered bytes to have been consumed.
+  Status FillBuffer();
+
+  RandomAccessFile* const file_;  // Not owned.
+  const size_t chunk_size_;
+  const int num_chunks_;
+
+  // Allocated on the first read.
+  std::unique_ptr<char[]> buffer_;
+  // The file offset of `buffer_[0]`.
+  int64_t buffer_offset_ = 0;
+  // The bytes in `buffer_[pos_, limit_)` have not been consumed yet.
+  size_t pos_ = 0;
+  size_t limit_ = 0;
+  // The status of reading past `limit_`, e.g. OUT_OF_RANGE at end of file.
+  Status file_status_;
+};
+
+}  // namespace io
+}  // namespace tsl
+
+#endif  // TENSORFLOW_TSL_LIB_IO_READ_AHEAD_INPUTSTREAM_H_
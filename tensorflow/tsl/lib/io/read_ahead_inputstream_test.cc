@@ -0,0 +1,167 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/tsl/lib/io/read_ahead_inputstream.h"
+
+#include <stdlib.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/tsl/lib/core/status_test_util.h"
+#include "tensorflow/tsl/platform/env.h"
+#include "tensorflow/tsl/platform/errors.h"
+#include "tensorflow/tsl/platform/test.h"
+
+namespace tsl {
+namespace io {
+namespace {
+
+// A file backed by a string, which records the sizes of the read batches.
+class StringFile : public RandomAccessFile {
+ public:
+  explicit StringFile(std::string contents) : contents_(std::move(contents)) {}
+
+  Status Read(uint64 offset, size_t n, StringPiece* result,
+              char* scratch) const override {
+    if (offset >= contents_.size()) {
+      *result = StringPiece();
+      return errors::OutOfRange("EOF");
+    }
+    *result = StringPiece(contents_).substr(offset, n);
+    return result->size() < n ? errors::OutOfRange("EOF") : OkStatus();
+  }
+
+  void ReadBatch(absl::Span<ReadRequest> requests) const override {
+    batch_sizes_.push_back(requests.size());
+    RandomAccessFile::ReadBatch(requests);
+  }
+
+  const std::vector<size_t>& batch_sizes() const { return batch_sizes_; }
+
+ private:
+  const std::string contents_;
+  mutable std::vector<size_t> batch_sizes_;
+};
+
+std::string MakeContents(size_t size) {
+  std::string contents(size, '\0');
+  for (size_t i = 0; i < size; ++i) {
+    contents[i] = 'a' + i % 26;
+  }
+  return contents;
+}
+
+TEST(ReadAheadInputStream, ReadsWholeFile) {
+  const std::string contents = MakeContents(1000);
+  StringFile file(contents);
+  for (size_t chunk_size : {1, 7, 64, 1000, 4096}) {
+    for (int num_chunks : {1, 2, 5}) {
+      ReadAheadInputStream in(&file, chunk_size, num_chunks);
+      std::string actual;
+      tstring result;
+      while (true) {
+        Status s = in.ReadNBytes(33, &result);
+        actual.append(result);
+        if (!s.ok()) {
+          EXPECT_TRUE(errors::IsOutOfRange(s));
+          break;
+        }
+      }
+      EXPECT_EQ(actual, contents);
+      EXPECT_EQ(in.Tell(), contents.size());
+    }
+  }
+}
+
+TEST(ReadAheadInputStream, IssuesBatchesOfChunks) {
+  StringFile file(MakeContents(100));
+  ReadAheadInputStream in(&file, /*chunk_size=*/10, /*num_chunks=*/4);
+  tstring result;
+  TF_ASSERT_OK(in.ReadNBytes(45, &result));
+  EXPECT_EQ(result, MakeContents(45));
+  EXPECT_EQ(file.batch_sizes(), std::vector<size_t>({4, 4}));
+}
+
+TEST(ReadAheadInputStream, ReadPastEndOfFile) {
+  StringFile file(MakeContents(10));
+  ReadAheadInputStream in(&file, /*chunk_size=*/4, /*num_chunks=*/2);
+  tstring result;
+  EXPECT_TRUE(errors::IsOutOfRange(in.ReadNBytes(20, &result)));
+  EXPECT_EQ(result, MakeContents(10));
+  EXPECT_EQ(in.Tell(), 10);
+  EXPECT_TRUE(errors::IsOutOfRange(in.ReadNBytes(1, &result)));
+  EXPECT_EQ(result, "");
+  TF_EXPECT_OK(in.ReadNBytes(0, &result));
+}
+
+TEST(ReadAheadInputStream, SkipNBytes) {
+  const std::string contents = MakeContents(100);
+  StringFile file(contents);
+  ReadAheadInputStream in(&file, /*chunk_size=*/8, /*num_chunks=*/2);
+  tstring result;
+  TF_ASSERT_OK(in.ReadNBytes(3, &result));
+  // Within the buffer.
+  TF_ASSERT_OK(in.SkipNBytes(5));
+  EXPECT_EQ(in.Tell(), 8);
+  TF_ASSERT_OK(in.ReadNBytes(2, &result));
+  EXPECT_EQ(result, contents.substr(8, 2));
+  // Past the buffer.
+  TF_ASSERT_OK(in.SkipNBytes(50));
+  EXPECT_EQ(in.Tell(), 60);
+  TF_ASSERT_OK(in.ReadNBytes(2, &result));
+  EXPECT_EQ(result, contents.substr(60, 2));
+  // Past the end of the file.
+  EXPECT_TRUE(errors::IsOutOfRange(in.SkipNBytes(100)));
+  EXPECT_EQ(in.Tell(), 100);
+}
+
+TEST(ReadAheadInputStream, Reset) {
+  const std::string contents = MakeContents(30);
+  StringFile file(contents);
+  ReadAheadInputStream in(&file, /*chunk_size=*/4, /*num_chunks=*/3);
+  tstring result;
+  EXPECT_TRUE(errors::IsOutOfRange(in.ReadNBytes(40, &result)));
+  TF_ASSERT_OK(in.Reset());
+  EXPECT_EQ(in.Tell(), 0);
+  TF_ASSERT_OK(in.ReadNBytes(30, &result));
+  EXPECT_EQ(result, contents);
+}
+
+TEST(ReadAheadInputStream, ReadsLocalFileWithIoUring) {
+  // Uses io_uring for the local file if the kernel supports it.
+  setenv("TF_POSIX_IO_URING_QUEUE_DEPTH", "4", /*overwrite=*/1);
+  Env* env = Env::Default();
+  std::string fname;
+  ASSERT_TRUE(env->LocalTempFilename(&fname));
+  const std::string contents = MakeContents(100000);
+  TF_ASSERT_OK(WriteStringToFile(env, fname, contents));
+  std::unique_ptr<RandomAccessFile> file;
+  TF_ASSERT_OK(env->NewRandomAccessFile(fname, &file));
+  unsetenv("TF_POSIX_IO_URING_QUEUE_DEPTH");
+
+  ReadAheadInputStream in(file.get(), /*chunk_size=*/1000, /*num_chunks=*/8);
+  tstring result;
+  TF_ASSERT_OK(in.ReadNBytes(12345, &result));
+  EXPECT_EQ(result, contents.substr(0, 12345));
+  TF_ASSERT_OK(in.SkipNBytes(50000));
+  EXPECT_TRUE(errors::IsOutOfRange(in.ReadNBytes(50000, &result)));
+  EXPECT_EQ(result, contents.substr(62345));
+}
+
+}  // namespace
+}  // namespace io
+}  // namespace tsl
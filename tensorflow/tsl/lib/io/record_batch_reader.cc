@@ -0,0 +1,214 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/tsl/lib/io/record_batch_reader.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "absl/types/span.h"
+#include "tensorflow/tsl/lib/hash/crc32c.h"
+#include "tensorflow/tsl/platform/errors.h"
+#include "tensorflow/tsl/platform/raw_coding.h"
+#include "tensorflow/tsl/platform/stringpiece.h"
+
+namespace tsl {
+namespace io {
+namespace {
+
+// Format of a single record:
+//  uint64    length
+//  uint32    masked crc of length
+//  byte      data[length]
+//  uint32    masked crc of data
+constexpr size_t kLengthSize = sizeof(uint64);
+constexpr size_t kHeaderSize = kLengthSize + sizeof(uint32);
+constexpr size_t kFooterSize = sizeof(uint32);
+
+inline const char* GetChecksumErrorSuffix(uint64 offset) {
+  if (offset == 0) {
+    return " (Is this even a TFRecord file?)";
+  }
+  return "";
+}
+
+}  // namespace
+
+Status ParseRecords(absl::string_view data, uint64 offset,
+                    std::vector<absl::string_view>* records, size_t* consumed) {
+  // Finds the complete records from their lengths, which are validated below.
+  std::vector<size_t> starts;
+  size_t pos = 0;
+  while (data.size() - pos >= kHeaderSize + kFooterSize) {
+    const uint64 length = core::DecodeFixed64(data.data() + pos);
+    if (length > data.size() - pos - kHeaderSize - kFooterSize) {
+      break;
+    }
+    starts.push_back(pos);
+    pos += kHeaderSize + length + kFooterSize;
+  }
+
+  // Checksums the lengths first and the payloads next, so that the inputs
+  // that `ValueBatch()` interleaves have similar sizes.
+  const size_t n = starts.size();
+  std::vector<StringPiece> pieces(2 * n);
+  for (size_t i = 0; i < n; ++i) {
+    const char* header = data.data() + starts[i];
+    pieces[i] = StringPiece(header, kLengthSize);
+    pieces[n + i] =
+        StringPiece(header + kHeaderSize, core::DecodeFixed64(header));
+  }
+  std::vector<uint32> crcs(2 * n);
+  crc32c::ValueBatch(pieces.data(), pieces.size(), crcs.data());
+
+  records->reserve(records->size() + n);
+  for (size_t i = 0; i < n; ++i) {
+    const StringPiece& payload = pieces[n + i];
+    const uint32 length_crc =
+        core::DecodeFixed32(pieces[i].data() + kLengthSize);
+    const uint32 payload_crc =
+        core::DecodeFixed32(payload.data() + payload.size());
+    if (crc32c::Unmask(length_crc) != crcs[i] ||
+        crc32c::Unmask(payload_crc) != crcs[n + i]) {
+      *consumed = starts[i];
+      return errors::DataLoss("corrupted record at ", offset + starts[i],
+                              GetChecksumErrorSuffix(offset + starts[i]));
+    }
+    records->emplace_back(payload.data(), payload.size());
+  }
+  *consumed = pos;
+  return OkStatus();
+}
+
+RecordBatchReader::RecordBatchReader(RandomAccessFile* file,
+                                     size_t block_size,
+                                     int num_outstanding_reads)
+    : file_(file),
+      block_size_(std::max<size_t>(block_size, 1)),
+      num_outstanding_reads_(file->SupportsBatchedReads()
+                                 ? std::max(num_outstanding_reads, 1)
+                                 : 1) {}
+
+Status RecordBatchReader::ReadBatch(std::vector<absl::string_view>* records) {
+  records->clear();
+  while (true) {
+    size_t consumed = 0;
+    Status s = ParseRecords(
+        absl::string_view(buffer_.get() + pos_, limit_ - pos_), TellOffset(),
+        records, &consumed);
+    pos_ += consumed;
+    // The records preceding a corrupted one are returned before its error.
+    if (!records->empty()) {
+      return OkStatus();
+    }
+    TF_RETURN_IF_ERROR(s);
+
+    // The buffer holds no complete record, so reads at least the next one. Its
+    // length is validated first, to not grow the buffer for a corrupted one.
+    const uint64 offset = TellOffset();
+    size_t min_bytes = kHeaderSize;
+    if (limit_ - pos_ >= kHeaderSize) {
+      const char* header = buffer_.get() + pos_;
+      if (crc32c::Unmask(core::DecodeFixed32(header + kLengthSize)) !=
+          crc32c::Value(header, kLengthSize)) {
+        return errors::DataLoss("corrupted record at ", offset,
+                                GetChecksumErrorSuffix(offset));
+      }
+      const uint64 length = core::DecodeFixed64(header);
+      if (length >= SIZE_MAX - kHeaderSize - kFooterSize) {
+        return errors::DataLoss("record size too large",
+                                GetChecksumErrorSuffix(offset));
+      }
+      min_bytes = kHeaderSize + length + kFooterSize;
+    }
+    if (!file_status_.ok()) {
+      if (pos_ == limit_ || !errors::IsOutOfRange(file_status_)) {
+        return file_status_;
+      }
+      return errors::DataLoss("truncated record at ", offset,
+                              GetChecksumErrorSuffix(offset));
+    }
+    FillBuffer(min_bytes);
+  }
+}
+
+void RecordBatchReader::FillBuffer(size_t min_bytes) {
+  const size_t unconsumed = limit_ - pos_;
+  const size_t capacity =
+      std::max(block_size_ * num_outstanding_reads_, min_bytes);
+  if (capacity > capacity_) {
+    std::unique_ptr<char[]> buffer(new char[capacity]);
+    if (unconsumed > 0) {
+      memcpy(buffer.get(), buffer_.get() + pos_, unconsumed);
+    }
+    buffer_ = std::move(buffer);
+    capacity_ = capacity;
+  } else if (pos_ > 0 && unconsumed > 0) {
+    memmove(buffer_.get(), buffer_.get() + pos_, unconsumed);
+  }
+  buffer_offset_ += pos_;
+  pos_ = 0;
+  limit_ = unconsumed;
+
+  while (limit_ < min_bytes && file_status_.ok()) {
+    std::vector<RandomAccessFile::ReadRequest> requests;
+    for (size_t start = limit_; start < capacity_; start += block_size_) {
+      RandomAccessFile::ReadRequest request;
+      request.offset = buffer_offset_ + start;
+      request.n = std::min(block_size_, capacity_ - start);
+      request.scratch = buffer_.get() + start;
+      requests.push_back(request);
+    }
+    file_->ReadBatch(absl::MakeSpan(requests));
+
+    // The buffer holds the blocks up to the first short or failed read.
+    for (const RandomAccessFile::ReadRequest& request : requests) {
+      if (request.result.data() != request.scratch) {
+        memmove(request.scratch, request.result.data(), request.result.size());
+      }
+      limit_ += request.result.size();
+      if (!request.status.ok()) {
+        file_status_ = request.status;
+        break;
+      }
+      if (request.result.size() < request.n) {
+        file_status_ = errors::OutOfRange("reached end of file");
+        break;
+      }
+    }
+  }
+}
+
+uint64 RecordBatchReader::OffsetAfter(absl::string_view record) const {
+  return buffer_offset_ +
+         (record.data() + record.size() + kFooterSize - buffer_.get());
+}
+
+Status RecordBatchReader::SeekOffset(uint64 offset) {
+  if (offset >= buffer_offset_ && offset <= buffer_offset_ + limit_) {
+    pos_ = offset - buffer_offset_;
+    return OkStatus();
+  }
+  buffer_offset_ = offset;
+  pos_ = 0;
+  limit_ = 0;
+  file_status_ = OkStatus();
+  return OkStatus();
+}
+
+}  // namespace io
+}  // namespace tsl
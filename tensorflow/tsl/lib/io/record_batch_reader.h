@@ -0,0 +1,102 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_TSL_LIB_IO_RECORD_BATCH_READER_H_
+#define TENSORFLOW_TSL_LIB_IO_RECORD_BATCH_READER_H_
+
+#include <memory>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "tensorflow/tsl/platform/file_system.h"
+#include "tensorflow/tsl/platform/macros.h"
+#include "tensorflow/tsl/platform/status.h"
+#include "tensorflow/tsl/platform/types.h"
+
+namespace tsl {
+namespace io {
+
+// Parses the complete TFRecords at the beginning of `data`, which starts at
+// file offset `offset`, and appends views of their payloads to `*records`. The
+// checksums of all the records are computed together with
+// `crc32c::ValueBatch()`. Stops at the first incomplete record, and stores the
+// number of bytes spanned by the parsed records in `*consumed`.
+//
+// If a record is corrupted, returns DATA_LOSS after appending the records that
+// precede it.
+Status ParseRecords(absl::string_view data, uint64 offset,
+                    std::vector<absl::string_view>* records, size_t* consumed);
+
+// Reads the records of an uncompressed TFRecord file in batches: the file is
+// read in large blocks, and each call to `ReadBatch()` returns all the complete
+// records of a block as views into the block, without copying them.
+//
+// Note: this class is not thread safe; external synchronization required.
+class RecordBatchReader {
+ public:
+  // Reads `*file`, which must outlive *this, with `num_outstanding_reads`
+  // reads of `block_size` bytes each issued at once if the file supports
+  // batched reads, or one otherwise. The buffer grows to hold records that are
+  // larger than all of them.
+  RecordBatchReader(RandomAccessFile* file, size_t block_size,
+                    int num_outstanding_reads = 1);
+
+  // Replaces the contents of `*records` with the next records of the file.
+  // The views are valid until the next call to `ReadBatch()` or
+  // `SeekOffset()`. Returns OK with at least one record on success,
+  // OUT_OF_RANGE at the end of the file, or something else for an error.
+  Status ReadBatch(std::vector<absl::string_view>* records);
+
+  // Returns the offset of the record that follows `record`, which must be a
+  // view returned by the last call to `ReadBatch()`.
+  uint64 OffsetAfter(absl::string_view record) const;
+
+  // Returns the offset of the record that the next call to `ReadBatch()`
+  // starts at.
+  uint64 TellOffset() const { return buffer_offset_ + pos_; }
+
+  // Makes the next call to `ReadBatch()` start at `offset`, which must be the
+  // offset of a record or the end of the file. Buffered bytes are kept if
+  // `offset` is within the buffer.
+  Status SeekOffset(uint64 offset);
+
+ private:
+  // Moves the unconsumed bytes to the beginning of the buffer, and reads the
+  // file after them until the buffer holds at least `min_bytes` of them or
+  // the end of the file is reached.
+  void FillBuffer(size_t min_bytes);
+
+  RandomAccessFile* const file_;  // Not owned.
+  const size_t block_size_;
+  const int num_outstanding_reads_;
+
+  // Allocated on the first read.
+  std::unique_ptr<char[]> buffer_;
+  size_t capacity_ = 0;
+  // The file offset of `buffer_[0]`.
+  uint64 buffer_offset_ = 0;
+  // The bytes in `buffer_[pos_, limit_)` have not been returned yet.
+  size_t pos_ = 0;
+  size_t limit_ = 0;
+  // The status of reading past `limit_`, e.g. OUT_OF_RANGE at end of file.
+  Status file_status_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(RecordBatchReader);
+};
+
+}  // namespace io
+}  // namespace tsl
+
+#endif  // TENSORFLOW_TSL_LIB_IO_RECORD_BATCH_READER_H_
@@ -0,0 +1,288 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/tsl/lib/io/record_batch_reader.h"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/tsl/lib/core/status_test_util.h"
+#include "tensorflow/tsl/lib/io/record_reader.h"
+#include "tensorflow/tsl/lib/io/record_writer.h"
+#include "tensorflow/tsl/platform/env.h"
+#include "tensorflow/tsl/platform/errors.h"
+#include "tensorflow/tsl/platform/strcat.h"
+#include "tensorflow/tsl/platform/test.h"
+#include "tensorflow/tsl/platform/test_benchmark.h"
+
+namespace tsl {
+namespace io {
+namespace {
+
+// Writes `records` to a TFRecord file and returns the offset of each record,
+// followed by the size of the file.
+std::vector<uint64> WriteRecords(const string& fname,
+                                 const std::vector<string>& records) {
+  std::unique_ptr<WritableFile> file;
+  TF_CHECK_OK(Env::Default()->NewWritableFile(fname, &file));
+  RecordWriter writer(file.get());
+  std::vector<uint64> offsets = {0};
+  for (const string& record : records) {
+    TF_CHECK_OK(writer.WriteRecord(record));
+    offsets.push_back(offsets.back() + RecordReader::kHeaderSize +
+                      record.size() + RecordReader::kFooterSize);
+  }
+  TF_CHECK_OK(writer.Close());
+  return offsets;
+}
+
+std::vector<string> TestRecords() {
+  std::vector<string> records;
+  for (int i = 0; i < 100; ++i) {
+    records.push_back(string(i * 37 % 300, 'a' + i % 26));
+  }
+  return records;
+}
+
+// Wraps a file to report that it supports batched reads, and counts the reads
+// of its batches.
+class BatchedReadsFile : public RandomAccessFile {
+ public:
+  explicit BatchedReadsFile(RandomAccessFile* file) : file_(file) {}
+
+  Status Read(uint64 offset, size_t n, StringPiece* result,
+              char* scratch) const override {
+    return file_->Read(offset, n, result, scratch);
+  }
+
+  void ReadBatch(absl::Span<ReadRequest> requests) const override {
+    max_batch_size_ = std::max(max_batch_size_, requests.size());
+    file_->ReadBatch(requests);
+  }
+
+  bool SupportsBatchedReads() const override { return true; }
+
+  size_t max_batch_size() const { return max_batch_size_; }
+
+ private:
+  RandomAccessFile* const file_;
+  mutable size_t max_batch_size_ = 0;
+};
+
+// Reads all the records of `reader` until an error, which is returned.
+Status ReadAll(RecordBatchReader* reader, std::vector<string>* records) {
+  std::vector<absl::string_view> batch;
+  while (true) {
+    TF_RETURN_IF_ERROR(reader->ReadBatch(&batch));
+    EXPECT_FALSE(batch.empty());
+    for (absl::string_view record : batch) {
+      records->emplace_back(record);
+    }
+  }
+}
+
+TEST(RecordBatchReaderTest, ReadsAllRecords) {
+  const string fname = testing::TmpDir() + "/record_batch_reader_all";
+  const std::vector<string> expected = TestRecords();
+  WriteRecords(fname, expected);
+  std::unique_ptr<RandomAccessFile> file;
+  TF_ASSERT_OK(Env::Default()->NewRandomAccessFile(fname, &file));
+
+  for (size_t block_size : {1, 7, 16, 100, 1024, 1 << 20}) {
+    for (int num_outstanding_reads : {1, 3}) {
+      BatchedReadsFile batched_file(file.get());
+      RecordBatchReader reader(&batched_file, block_size,
+                               num_outstanding_reads);
+      std::vector<string> records;
+      Status s = ReadAll(&reader, &records);
+      EXPECT_TRUE(errors::IsOutOfRange(s)) << s;
+      EXPECT_EQ(records, expected);
+    }
+  }
+}
+
+TEST(RecordBatchReaderTest, ReadsOneBlockAtATimeWithoutBatchedReads) {
+  const string fname = testing::TmpDir() + "/record_batch_reader_unbatched";
+  WriteRecords(fname, TestRecords());
+  std::unique_ptr<RandomAccessFile> file;
+  TF_ASSERT_OK(Env::Default()->NewRandomAccessFile(fname, &file));
+
+  BatchedReadsFile batched_file(file.get());
+  RecordBatchReader batched_reader(&batched_file, /*block_size=*/100,
+                                   /*num_outstanding_reads=*/3);
+  std::vector<string> records;
+  EXPECT_TRUE(errors::IsOutOfRange(ReadAll(&batched_reader, &records)));
+  EXPECT_GE(batched_file.max_batch_size(), 3);
+
+  // The file reports that it does not support batched reads.
+  RecordBatchReader reader(file.get(), /*block_size=*/100,
+                           /*num_outstanding_reads=*/3);
+  std::vector<string> unbatched_records;
+  EXPECT_TRUE(errors::IsOutOfRange(ReadAll(&reader, &unbatched_records)));
+  EXPECT_EQ(unbatched_records, records);
+}
+
+TEST(RecordBatchReaderTest, EmptyFile) {
+  const string fname = testing::TmpDir() + "/record_batch_reader_empty";
+  WriteRecords(fname, {});
+  std::unique_ptr<RandomAccessFile> file;
+  TF_ASSERT_OK(Env::Default()->NewRandomAccessFile(fname, &file));
+
+  RecordBatchReader reader(file.get(), 1024);
+  std::vector<absl::string_view> batch;
+  EXPECT_TRUE(errors::IsOutOfRange(reader.ReadBatch(&batch)));
+  EXPECT_TRUE(batch.empty());
+}
+
+TEST(RecordBatchReaderTest, OffsetAfterAndSeek) {
+  const string fname = testing::TmpDir() + "/record_batch_reader_seek";
+  const std::vector<string> expected = TestRecords();
+  const std::vector<uint64> offsets = WriteRecords(fname, expected);
+  std::unique_ptr<RandomAccessFile> file;
+  TF_ASSERT_OK(Env::Default()->NewRandomAccessFile(fname, &file));
+
+  RecordBatchReader reader(file.get(), 1000);
+  std::vector<absl::string_view> batch;
+  size_t index = 0;
+  while (reader.ReadBatch(&batch).ok()) {
+    for (absl::string_view record : batch) {
+      ++index;
+      EXPECT_EQ(reader.OffsetAfter(record), offsets[index]);
+    }
+    EXPECT_EQ(reader.TellOffset(), offsets[index]);
+  }
+  EXPECT_EQ(index, expected.size());
+
+  for (size_t i : {50, 10, 99, 0}) {
+    TF_ASSERT_OK(reader.SeekOffset(offsets[i]));
+    TF_ASSERT_OK(reader.ReadBatch(&batch));
+    EXPECT_EQ(batch[0], expected[i]);
+  }
+}
+
+TEST(RecordBatchReaderTest, TruncatedRecord) {
+  const string fname = testing::TmpDir() + "/record_batch_reader_truncated";
+  const std::vector<uint64> offsets = WriteRecords(fname, {"abc", "defgh"});
+  string contents;
+  TF_ASSERT_OK(ReadFileToString(Env::Default(), fname, &contents));
+  contents.resize(contents.size() - 1);
+  TF_ASSERT_OK(WriteStringToFile(Env::Default(), fname, contents));
+  std::unique_ptr<RandomAccessFile> file;
+  TF_ASSERT_OK(Env::Default()->NewRandomAccessFile(fname, &file));
+
+  RecordBatchReader reader(file.get(), 1024);
+  std::vector<string> records;
+  Status s = ReadAll(&reader, &records);
+  EXPECT_TRUE(errors::IsDataLoss(s)) << s;
+  EXPECT_EQ(records, std::vector<string>({"abc"}));
+  EXPECT_EQ(reader.TellOffset(), offsets[1]);
+}
+
+TEST(RecordBatchReaderTest, CorruptedRecords) {
+  const string fname = testing::TmpDir() + "/record_batch_reader_corrupted";
+  const std::vector<string> expected = TestRecords();
+  const std::vector<uint64> offsets = WriteRecords(fname, expected);
+  string contents;
+  TF_ASSERT_OK(ReadFileToString(Env::Default(), fname, &contents));
+
+  // Corrupts the length, the length checksum, the payload or the payload
+  // checksum of a record.
+  for (size_t position :
+       {offsets[0], offsets[42] + 3, offsets[42] + 9, offsets[42] + 20,
+        offsets[43] - 1}) {
+    string corrupted = contents;
+    corrupted[position] ^= 0x40;
+    TF_ASSERT_OK(WriteStringToFile(Env::Default(), fname, corrupted));
+    std::unique_ptr<RandomAccessFile> file;
+    TF_ASSERT_OK(Env::Default()->NewRandomAccessFile(fname, &file));
+
+    RecordBatchReader reader(file.get(), 1024);
+    std::vector<string> records;
+    Status s = ReadAll(&reader, &records);
+    EXPECT_TRUE(errors::IsDataLoss(s)) << s;
+    const size_t num_valid = position < offsets[42] ? 0 : 42;
+    EXPECT_EQ(records, std::vector<string>(expected.begin(),
+                                           expected.begin() + num_valid));
+    EXPECT_EQ(reader.TellOffset(), offsets[num_valid]);
+  }
+}
+
+TEST(ParseRecordsTest, StopsAtIncompleteRecord) {
+  const string fname = testing::TmpDir() + "/record_batch_reader_parse";
+  const std::vector<uint64> offsets = WriteRecords(fname, {"a", "bc", "def"});
+  string contents;
+  TF_ASSERT_OK(ReadFileToString(Env::Default(), fname, &contents));
+
+  for (size_t size = 0; size <= contents.size(); ++size) {
+    std::vector<absl::string_view> records;
+    size_t consumed;
+    TF_ASSERT_OK(ParseRecords(absl::string_view(contents.data(), size),
+                              /*offset=*/0, &records, &consumed));
+    const size_t num_complete =
+        std::upper_bound(offsets.begin(), offsets.end(), size) -
+        offsets.begin() - 1;
+    EXPECT_EQ(records.size(), num_complete);
+    EXPECT_EQ(consumed, offsets[num_complete]);
+  }
+}
+
+// Reads a shard of small records with `RecordReader` (0) or
+// `RecordBatchReader` (1).
+void BM_ReadSmallRecords(::testing::benchmark::State& state) {
+  const int64_t record_size = state.range(0);
+  const bool batched = state.range(1);
+  constexpr int64_t kBufferSize = 256 << 10;
+  const int64_t num_records = (64 << 20) / record_size;
+
+  Env* env = Env::Default();
+  const string fname =
+      strings::StrCat(testing::TmpDir(), "/record_batch_reader_benchmark_",
+                      record_size);
+  if (!env->FileExists(fname).ok()) {
+    WriteRecords(fname, std::vector<string>(num_records,
+                                            string(record_size, 'x')));
+  }
+  std::unique_ptr<RandomAccessFile> file;
+  TF_CHECK_OK(env->NewRandomAccessFile(fname, &file));
+
+  int64_t num_read = 0;
+  for (auto s : state) {
+    if (batched) {
+      RecordBatchReader reader(file.get(), kBufferSize);
+      std::vector<absl::string_view> batch;
+      while (reader.ReadBatch(&batch).ok()) {
+        num_read += batch.size();
+      }
+    } else {
+      RecordReaderOptions options;
+      options.buffer_size = kBufferSize;
+      SequentialRecordReader reader(file.get(), options);
+      tstring record;
+      while (reader.ReadRecord(&record).ok()) {
+        ++num_read;
+      }
+    }
+  }
+  CHECK_EQ(num_read, state.iterations() * num_records);
+  state.SetItemsProcessed(num_read);
+  state.SetBytesProcessed(num_read * record_size);
+}
+BENCHMARK(BM_ReadSmallRecords)->ArgsProduct({{32, 256, 4096}, {0, 1}});
+
+}  // namespace
+}  // namespace io
+}  // namespace tsl
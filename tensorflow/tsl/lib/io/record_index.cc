@@ -0,0 +1,137 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/tsl/lib/io/record_index.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "tensorflow/tsl/lib/hash/crc32c.h"
+#include "tensorflow/tsl/platform/coding.h"
+#include "tensorflow/tsl/platform/errors.h"
+#include "tensorflow/tsl/platform/raw_coding.h"
+#include "tensorflow/tsl/platform/strcat.h"
+
+namespace tsl {
+namespace io {
+namespace {
+
+constexpr size_t kOffsetSize = sizeof(uint64);
+constexpr size_t kFooterSize = sizeof(uint32);
+constexpr size_t kBlockSize = kRecordsPerIndexBlock * kOffsetSize + kFooterSize;
+
+}  // namespace
+
+std::string RecordIndexFileName(const std::string& filename) {
+  return strings::StrCat(filename, kRecordIndexSuffix);
+}
+
+RecordIndexBuilder::RecordIndexBuilder(WritableFile* file) : file_(file) {
+  block_.reserve(kBlockSize);
+}
+
+Status RecordIndexBuilder::AddRecord(uint64 offset) {
+  if (finished_) {
+    return errors::FailedPrecondition("Record index was already finished");
+  }
+  core::PutFixed64(&block_, offset);
+  if (block_.size() == kRecordsPerIndexBlock * kOffsetSize) {
+    return WriteBlock();
+  }
+  return OkStatus();
+}
+
+Status RecordIndexBuilder::Finish() {
+  if (finished_) {
+    return OkStatus();
+  }
+  finished_ = true;
+  if (block_.empty()) {
+    return OkStatus();
+  }
+  return WriteBlock();
+}
+
+Status RecordIndexBuilder::WriteBlock() {
+  core::PutFixed32(&block_,
+                   crc32c::Mask(crc32c::Value(block_.data(), block_.size())));
+  Status s = file_->Append(block_);
+  block_.clear();
+  return s;
+}
+
+RecordIndex::RecordIndex(RandomAccessFile* file, uint64 num_records)
+    : file_(file), num_records_(num_records) {}
+
+Status RecordIndex::NumRecords(uint64 file_size, uint64* num_records) {
+  *num_records = file_size / kBlockSize * kRecordsPerIndexBlock;
+  const uint64 last_block_size = file_size % kBlockSize;
+  if (last_block_size > 0) {
+    if (last_block_size < kOffsetSize + kFooterSize ||
+        (last_block_size - kFooterSize) % kOffsetSize != 0) {
+      return errors::DataLoss("Record index has an invalid size: ", file_size);
+    }
+    *num_records += (last_block_size - kFooterSize) / kOffsetSize;
+  }
+  return OkStatus();
+}
+
+Status RecordIndex::Open(RandomAccessFile* file, uint64 file_size,
+                         std::unique_ptr<RecordIndex>* index) {
+  uint64 num_records;
+  TF_RETURN_IF_ERROR(NumRecords(file_size, &num_records));
+  index->reset(new RecordIndex(file, num_records));
+  return OkStatus();
+}
+
+Status RecordIndex::Lookup(uint64 i, uint64* offset) {
+  if (i >= num_records_) {
+    return errors::OutOfRange("Record ", i, " is out of range: the file has ",
+                              num_records_, " records");
+  }
+  const int64_t block_index = i / kRecordsPerIndexBlock;
+  if (block_index != block_index_) {
+    if (!block_) {
+      block_.reset(new char[kBlockSize]);
+    }
+    const size_t num_offsets = std::min<uint64>(
+        num_records_ - block_index * kRecordsPerIndexBlock,
+        kRecordsPerIndexBlock);
+    const size_t size = num_offsets * kOffsetSize;
+    block_index_ = -1;
+    StringPiece block;
+    Status s = file_->Read(block_index * kBlockSize, size + kFooterSize,
+                           &block, block_.get());
+    if (!s.ok() && !(errors::IsOutOfRange(s) &&
+                     block.size() == size + kFooterSize)) {
+      return s;
+    }
+    if (crc32c::Unmask(core::DecodeFixed32(block.data() + size)) !=
+        crc32c::Value(block.data(), size)) {
+      return errors::DataLoss("Corrupted record index block ", block_index);
+    }
+    if (block.data() != block_.get()) {
+      memcpy(block_.get(), block.data(), block.size());
+    }
+    block_index_ = block_index;
+  }
+  *offset = core::DecodeFixed64(block_.get() +
+                                (i % kRecordsPerIndexBlock) * kOffsetSize);
+  return OkStatus();
+}
+
+}  // namespace io
+}  // namespace tsl
@@ -0,0 +1,114 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_TSL_LIB_IO_RECORD_INDEX_H_
+#define TENSORFLOW_TSL_LIB_IO_RECORD_INDEX_H_
+
+#include <memory>
+#include <string>
+
+#include "tensorflow/tsl/platform/file_system.h"
+#include "tensorflow/tsl/platform/macros.h"
+#include "tensorflow/tsl/platform/status.h"
+#include "tensorflow/tsl/platform/types.h"
+
+namespace tsl {
+namespace io {
+
+// The index of a TFRecord file is a sidecar file, named after the TFRecord
+// file with the `kRecordIndexSuffix` suffix, that stores the offset of each
+// record so that any record can be read without scanning the file.
+//
+// Format of the index:
+//  block     blocks[num_records / kRecordsPerIndexBlock]
+//  block     last_block  // Holds the remaining offsets, if any.
+//
+// Format of a block:
+//  uint64    offsets[kRecordsPerIndexBlock]
+//  uint32    masked crc of offsets
+inline constexpr char kRecordIndexSuffix[] = ".index";
+inline constexpr size_t kRecordsPerIndexBlock = 1024;
+
+// Returns the name of the index of the TFRecord file `filename`.
+std::string RecordIndexFileName(const std::string& filename);
+
+// Writes the index of a TFRecord file, a block at a time.
+//
+// Note: this class is not thread safe; external synchronization required.
+class RecordIndexBuilder {
+ public:
+  // Appends the index to `*file`, which must be initially empty and remain
+  // live while the builder is in use.
+  explicit RecordIndexBuilder(WritableFile* file);
+
+  // Adds the offset of the next record.
+  Status AddRecord(uint64 offset);
+
+  // Writes the offsets that do not fill a block yet. After calling
+  // `Finish()`, any further calls to `AddRecord()` are invalid.
+  Status Finish();
+
+ private:
+  // Appends the buffered offsets as a block.
+  Status WriteBlock();
+
+  WritableFile* const file_;  // Not owned.
+  string block_;
+  bool finished_ = false;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(RecordIndexBuilder);
+};
+
+// Looks up the offsets of the records of a TFRecord file in its index. Each
+// lookup reads at most one block of the index, and the last block read is
+// cached.
+//
+// Note: this class is not thread safe; external synchronization required.
+class RecordIndex {
+ public:
+  // Opens the index stored in `*file`, which has `file_size` bytes and must
+  // remain live while the index is in use.
+  static Status Open(RandomAccessFile* file, uint64 file_size,
+                     std::unique_ptr<RecordIndex>* index);
+
+  // Stores the number of records indexed by an index of `file_size` bytes in
+  // `*num_records`.
+  static Status NumRecords(uint64 file_size, uint64* num_records);
+
+  // The number of records of the TFRecord file.
+  uint64 num_records() const { return num_records_; }
+
+  // Stores the offset of the record `i` in `*offset`. Returns OUT_OF_RANGE if
+  // `i` is not less than `num_records()`, or DATA_LOSS if the block that holds
+  // it is corrupted.
+  Status Lookup(uint64 i, uint64* offset);
+
+ private:
+  RecordIndex(RandomAccessFile* file, uint64 num_records);
+
+  RandomAccessFile* const file_;  // Not owned.
+  const uint64 num_records_;
+
+  // The block that was read last, or -1 if none.
+  int64_t block_index_ = -1;
+  std::unique_ptr<char[]> block_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(RecordIndex);
+};
+
+}  // namespace io
+}  // namespace tsl
+
+#endif  // TENSORFLOW_TSL_LIB_IO_RECORD_INDEX_H_
@@ -0,0 +1,145 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/tsl/lib/io/record_index.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/tsl/lib/core/status_test_util.h"
+#include "tensorflow/tsl/lib/io/record_reader.h"
+#include "tensorflow/tsl/lib/io/record_writer.h"
+#include "tensorflow/tsl/platform/env.h"
+#include "tensorflow/tsl/platform/errors.h"
+#include "tensorflow/tsl/platform/strcat.h"
+#include "tensorflow/tsl/platform/test.h"
+
+namespace tsl {
+namespace io {
+namespace {
+
+// Writes `num_records` records and the index of the file `fname`.
+void WriteIndexedRecords(const string& fname, int num_records,
+                         const RecordWriterOptions& options) {
+  Env* env = Env::Default();
+  std::unique_ptr<WritableFile> file;
+  TF_CHECK_OK(env->NewWritableFile(fname, &file));
+  std::unique_ptr<WritableFile> index_file;
+  TF_CHECK_OK(env->NewWritableFile(RecordIndexFileName(fname), &index_file));
+  RecordWriterOptions indexed_options = options;
+  indexed_options.index_file = index_file.get();
+  RecordWriter writer(file.get(), indexed_options);
+  for (int i = 0; i < num_records; ++i) {
+    TF_CHECK_OK(writer.WriteRecord(strings::StrCat("record_", i)));
+  }
+  TF_CHECK_OK(writer.Close());
+  TF_CHECK_OK(file->Close());
+  TF_CHECK_OK(index_file->Close());
+}
+
+class RecordIndexTest : public ::testing::TestWithParam<int> {};
+
+TEST_P(RecordIndexTest, LooksUpRecords) {
+  const int num_records = GetParam();
+  const string fname =
+      strings::StrCat(testing::TmpDir(), "/record_index_", num_records);
+  WriteIndexedRecords(fname, num_records, RecordWriterOptions());
+
+  Env* env = Env::Default();
+  std::unique_ptr<RandomAccessFile> file;
+  TF_ASSERT_OK(env->NewRandomAccessFile(fname, &file));
+  std::unique_ptr<RandomAccessFile> index_file;
+  TF_ASSERT_OK(
+      env->NewRandomAccessFile(RecordIndexFileName(fname), &index_file));
+  uint64 index_size;
+  TF_ASSERT_OK(env->GetFileSize(RecordIndexFileName(fname), &index_size));
+  std::unique_ptr<RecordIndex> index;
+  TF_ASSERT_OK(RecordIndex::Open(index_file.get(), index_size, &index));
+  EXPECT_EQ(index->num_records(), num_records);
+
+  // Reads the records in a scattered order.
+  RecordReader reader(file.get());
+  for (int i = 0; i < num_records; ++i) {
+    const int record = static_cast<int64_t>(i) * 7919 % num_records;
+    uint64 offset;
+    TF_ASSERT_OK(index->Lookup(record, &offset));
+    tstring data;
+    TF_ASSERT_OK(reader.ReadRecord(&offset, &data));
+    EXPECT_EQ(data, strings::StrCat("record_", record));
+  }
+  uint64 offset;
+  EXPECT_TRUE(errors::IsOutOfRange(index->Lookup(num_records, &offset)));
+}
+
+INSTANTIATE_TEST_SUITE_P(NumRecords, RecordIndexTest,
+                         ::testing::Values(0, 1, 1023, 1024, 1025, 2500));
+
+TEST(RecordIndexTest, IndexesCompressedStream) {
+  const string fname = testing::TmpDir() + "/record_index_zlib";
+  WriteIndexedRecords(fname, 100,
+                      RecordWriterOptions::CreateRecordWriterOptions("ZLIB"));
+
+  Env* env = Env::Default();
+  std::unique_ptr<RandomAccessFile> file;
+  TF_ASSERT_OK(env->NewRandomAccessFile(fname, &file));
+  std::unique_ptr<RandomAccessFile> index_file;
+  TF_ASSERT_OK(
+      env->NewRandomAccessFile(RecordIndexFileName(fname), &index_file));
+  uint64 index_size;
+  TF_ASSERT_OK(env->GetFileSize(RecordIndexFileName(fname), &index_size));
+  std::unique_ptr<RecordIndex> index;
+  TF_ASSERT_OK(RecordIndex::Open(index_file.get(), index_size, &index));
+  ASSERT_EQ(index->num_records(), 100);
+
+  RecordReader reader(file.get(),
+                      RecordReaderOptions::CreateRecordReaderOptions("ZLIB"));
+  for (int record : {42, 7, 99}) {
+    uint64 offset;
+    TF_ASSERT_OK(index->Lookup(record, &offset));
+    tstring data;
+    TF_ASSERT_OK(reader.ReadRecord(&offset, &data));
+    EXPECT_EQ(data, strings::StrCat("record_", record));
+  }
+}
+
+TEST(RecordIndexTest, CorruptedIndex) {
+  const string fname = testing::TmpDir() + "/record_index_corrupted";
+  WriteIndexedRecords(fname, 1500, RecordWriterOptions());
+  Env* env = Env::Default();
+  string contents;
+  TF_ASSERT_OK(ReadFileToString(env, RecordIndexFileName(fname), &contents));
+  // Corrupts the second block.
+  contents[contents.size() - 10] ^= 1;
+  TF_ASSERT_OK(
+      WriteStringToFile(env, RecordIndexFileName(fname), contents));
+
+  std::unique_ptr<RandomAccessFile> index_file;
+  TF_ASSERT_OK(
+      env->NewRandomAccessFile(RecordIndexFileName(fname), &index_file));
+  std::unique_ptr<RecordIndex> index;
+  TF_ASSERT_OK(RecordIndex::Open(index_file.get(), contents.size(), &index));
+  uint64 offset;
+  TF_EXPECT_OK(index->Lookup(10, &offset));
+  EXPECT_TRUE(errors::IsDataLoss(index->Lookup(1400, &offset)));
+
+  // A truncated index has an invalid size.
+  EXPECT_TRUE(errors::IsDataLoss(
+      RecordIndex::Open(index_file.get(), contents.size() - 3, &index)));
+}
+
+}  // namespace
+}  // namespace io
+}  // namespace tsl
@@ -21,6 +21,7 @@ limitations under the License.
 #include "tensorflow/tsl/lib/io/buffered_inputstream.h"
 #include "tensorflow/tsl/lib/io/compression.h"
 #include "tensorflow/tsl/lib/io/random_inputstream.h"
+#include "tensorflow/tsl/lib/io/read_ahead_inputstream.h"
 #include "tensorflow/tsl/platform/env.h"
 #include "tensorflow/tsl/platform/errors.h"
 #include "tensorflow/tsl/platform/raw_coding.h"
@@ -59,7 +60,11 @@ RecordReader::RecordReader(RandomAccessFile* file,
     : options_(options),
       input_stream_(new RandomAccessInputStream(file)),
       last_read_failed_(false) {
-  if (options.buffer_size > 0) {
+  if (options.buffer_size > 0 && options.num_outstanding_reads > 1 &&
+      file->SupportsBatchedReads()) {
+    input_stream_.reset(new ReadAheadInputStream(
+        file, options.buffer_size, options.num_outstanding_reads));
+  } else if (options.buffer_size > 0) {
     input_stream_.reset(new BufferedInputStream(input_stream_.release(),
                                                 options.buffer_size, true));
   }
@@ -46,6 +46,12 @@ struct RecordReaderOptions {
   // compressed files.) Consider using SequentialRecordReader.
   int64_t buffer_size = 0;
 
+  // If buffer_size is non-zero, the number of reads of buffer_size bytes that
+  // are issued at once when the buffer is refilled, if the file supports
+  // batched reads (e.g. the POSIX file system with io_uring). Files that do
+  // not are read one buffer at a time.
+  int num_outstanding_reads = 1;
+
   static RecordReaderOptions CreateRecordReaderOptions(
       const string& compression_type);
 
@@ -18,6 +18,7 @@ limitations under the License.
 #include "tensorflow/tsl/lib/io/record_writer.h"
 // clang-format on
 
+#include <stdlib.h>
 #include <zlib.h>
 
 #include <memory>
@@ -30,6 +31,8 @@ limitations under the License.
 #include "tensorflow/tsl/platform/status.h"
 #include "tensorflow/tsl/platform/strcat.h"
 #include "tensorflow/tsl/platform/test.h"
+#include "tensorflow/tsl/platform/test_benchmark.h"
+#include "tensorflow/tsl/platform/threadpool.h"
 
 namespace tsl {
 
@@ -305,6 +308,46 @@ TEST(RecordReaderWriterTest, TestSnappy) {
   }
 }
 
+TEST(RecordReaderWriterTest, TestParallelSnappy) {
+  Env* env = Env::Default();
+  string fname = testing::TmpDir() + "/record_reader_writer_psnappy_test";
+
+  std::vector<string> records;
+  for (int i = 0; i < 1000; ++i) {
+    records.push_back(strings::StrCat("record_", i, string(i % 100, 'x')));
+  }
+  {
+    std::unique_ptr<WritableFile> file;
+    TF_CHECK_OK(env->NewWritableFile(fname, &file));
+
+    thread::ThreadPool thread_pool(env, "snappy_compression", 4);
+    io::RecordWriterOptions options;
+    options.compression_type = io::RecordWriterOptions::SNAPPY_COMPRESSION;
+    options.snappy_options.input_buffer_size = 1024;
+    options.snappy_options.compression_thread_pool = &thread_pool;
+    io::RecordWriter writer(file.get(), options);
+    for (const string& record : records) {
+      TF_EXPECT_OK(writer.WriteRecord(record));
+    }
+    TF_CHECK_OK(writer.Close());
+  }
+
+  {
+    std::unique_ptr<RandomAccessFile> read_file;
+    TF_CHECK_OK(env->NewRandomAccessFile(fname, &read_file));
+    io::RecordReaderOptions options;
+    options.compression_type = io::RecordReaderOptions::SNAPPY_COMPRESSION;
+    io::RecordReader reader(read_file.get(), options);
+    uint64 offset = 0;
+    tstring record;
+    for (const string& expected : records) {
+      TF_CHECK_OK(reader.ReadRecord(&offset, &record));
+      EXPECT_EQ(expected, record);
+    }
+    EXPECT_TRUE(errors::IsOutOfRange(reader.ReadRecord(&offset, &record)));
+  }
+}
+
 TEST(RecordReaderWriterTest, TestZlib) {
   Env* env = Env::Default();
   string fname = testing::TmpDir() + "/record_reader_writer_zlib_test";
@@ -366,4 +409,96 @@ TEST(RecordReaderWriterTest, TestUseAfterClose) {
   }
 }
 
+TEST(RecordReaderWriterTest, TestOutstandingReads) {
+  Env* env = Env::Default();
+  string fname = testing::TmpDir() + "/record_reader_writer_outstanding_test";
+  std::vector<string> records;
+  for (int i = 0; i < 100; ++i) {
+    records.push_back(string(i * 7 % 50, 'a' + i % 26));
+  }
+  {
+    std::unique_ptr<WritableFile> file;
+    TF_CHECK_OK(env->NewWritableFile(fname, &file));
+    io::RecordWriter writer(file.get());
+    for (const string& record : records) {
+      TF_EXPECT_OK(writer.WriteRecord(record));
+    }
+    TF_CHECK_OK(writer.Close());
+  }
+
+  for (const char* queue_depth : {"0", "4"}) {
+    // With a non-zero queue depth, reads use io_uring if the kernel
+    // supports it.
+    setenv("TF_POSIX_IO_URING_QUEUE_DEPTH", queue_depth, /*overwrite=*/1);
+    std::unique_ptr<RandomAccessFile> read_file;
+    TF_CHECK_OK(env->NewRandomAccessFile(fname, &read_file));
+    unsetenv("TF_POSIX_IO_URING_QUEUE_DEPTH");
+    for (int64_t buffer_size : {1, 13, 4096}) {
+      io::RecordReaderOptions options;
+      options.buffer_size = buffer_size;
+      options.num_outstanding_reads = 3;
+      io::SequentialRecordReader reader(read_file.get(), options);
+      tstring record;
+      for (int i = 0; i < static_cast<int>(records.size()); ++i) {
+        if (i % 10 == 5) {
+          int num_skipped;
+          TF_ASSERT_OK(reader.SkipRecords(2, &num_skipped));
+          EXPECT_EQ(num_skipped, 2);
+          i += 2;
+        }
+        TF_ASSERT_OK(reader.ReadRecord(&record));
+        EXPECT_EQ(record, records[i]);
+      }
+      EXPECT_TRUE(errors::IsOutOfRange(reader.ReadRecord(&record)));
+    }
+  }
+}
+
+// Reads a large shard of records with the given buffer size in KiB, number of
+// outstanding reads and io_uring queue depth (0 for pread).
+void BM_ReadRecords(::testing::benchmark::State& state) {
+  const int64_t buffer_size = state.range(0) << 10;
+  const int num_outstanding_reads = state.range(1);
+  const int queue_depth = state.range(2);
+  constexpr int64_t kRecordSize = 4 << 10;
+  constexpr int64_t kNumRecords = 64 << 10;  // A shard of 256MiB.
+
+  Env* env = Env::Default();
+  string fname = testing::TmpDir() + "/record_reader_benchmark";
+  if (!env->FileExists(fname).ok()) {
+    std::unique_ptr<WritableFile> file;
+    TF_CHECK_OK(env->NewWritableFile(fname, &file));
+    io::RecordWriter writer(file.get());
+    const string record(kRecordSize, 'x');
+    for (int64_t i = 0; i < kNumRecords; ++i) {
+      TF_CHECK_OK(writer.WriteRecord(record));
+    }
+    TF_CHECK_OK(writer.Close());
+  }
+
+  setenv("TF_POSIX_IO_URING_QUEUE_DEPTH", strings::StrCat(queue_depth).c_str(),
+         /*overwrite=*/1);
+  std::unique_ptr<RandomAccessFile> file;
+  TF_CHECK_OK(env->NewRandomAccessFile(fname, &file));
+  unsetenv("TF_POSIX_IO_URING_QUEUE_DEPTH");
+
+  io::RecordReaderOptions options;
+  options.buffer_size = buffer_size;
+  options.num_outstanding_reads = num_outstanding_reads;
+  tstring record;
+  for (auto s : state) {
+    io::SequentialRecordReader reader(file.get(), options);
+    for (int64_t i = 0; i < kNumRecords; ++i) {
+      TF_CHECK_OK(reader.ReadRecord(&record));
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * kNumRecords * kRecordSize);
+}
+BENCHMARK(BM_ReadRecords)
+    ->Args({256, 1, 0})
+    ->Args({256, 4, 0})
+    ->Args({256, 4, 4})
+    ->Args({256, 16, 16})
+    ->Args({1024, 8, 8});
+
 }  // namespace tsl
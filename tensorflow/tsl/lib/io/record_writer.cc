@@ -60,6 +60,9 @@ RecordWriterOptions RecordWriterOptions::CreateRecordWriterOptions(
 RecordWriter::RecordWriter(WritableFile* dest,
                            const RecordWriterOptions& options)
     : dest_(dest), options_(options) {
+  if (options.index_file != nullptr) {
+    index_builder_ = std::make_unique<RecordIndexBuilder>(options.index_file);
+  }
 #if defined(IS_SLIM_BUILD)
   if (options.compression_type != RecordWriterOptions::NONE) {
     LOG(FATAL) << "Compression is unsupported on mobile platforms.";
@@ -75,6 +78,11 @@ RecordWriter::RecordWriter(WritableFile* dest,
                  << s.ToString();
     }
     dest_ = zlib_output_buffer;
+  } else if (IsSnappyCompressed(options) &&
+             options.snappy_options.compression_thread_pool != nullptr) {
+    dest_ = new SnappyParallelOutputBuffer(
+        dest, options.snappy_options.input_buffer_size,
+        options.snappy_options.compression_thread_pool);
   } else if (IsSnappyCompressed(options)) {
     dest_ =
         new SnappyOutputBuffer(dest, options.snappy_options.input_buffer_size,
@@ -110,6 +118,7 @@ Status RecordWriter::WriteRecord(StringPiece data) {
   char footer[kFooterSize];
   PopulateHeader(header, data.data(), data.size());
   PopulateFooter(footer, data.data(), data.size());
+  TF_RETURN_IF_ERROR(IndexRecord(data.size()));
   TF_RETURN_IF_ERROR(dest_->Append(StringPiece(header, sizeof(header))));
   TF_RETURN_IF_ERROR(dest_->Append(data));
   return dest_->Append(StringPiece(footer, sizeof(footer)));
@@ -130,14 +139,26 @@ Status RecordWriter::WriteRecord(const absl::Cord& data) {
   char footer[kFooterSize];
   PopulateHeader(header, data);
   PopulateFooter(footer, data);
+  TF_RETURN_IF_ERROR(IndexRecord(data.size()));
   TF_RETURN_IF_ERROR(dest_->Append(StringPiece(header, sizeof(header))));
   TF_RETURN_IF_ERROR(dest_->Append(data));
   return dest_->Append(StringPiece(footer, sizeof(footer)));
 }
 #endif
 
+Status RecordWriter::IndexRecord(size_t n) {
+  if (index_builder_) {
+    TF_RETURN_IF_ERROR(index_builder_->AddRecord(offset_));
+  }
+  offset_ += kHeaderSize + n + kFooterSize;
+  return OkStatus();
+}
+
 Status RecordWriter::Close() {
   if (dest_ == nullptr) return OkStatus();
+  if (index_builder_) {
+    TF_RETURN_IF_ERROR(index_builder_->Finish());
+  }
   if (IsZlibCompressed(options_) || IsSnappyCompressed(options_)) {
     Status s = dest_->Close();
     delete dest_;
@@ -16,13 +16,17 @@ limitations under the License.
 #ifndef TENSORFLOW_TSL_LIB_IO_RECORD_WRITER_H_
 #define TENSORFLOW_TSL_LIB_IO_RECORD_WRITER_H_
 
+#include <memory>
+
 #include "tensorflow/tsl/lib/hash/crc32c.h"
+#include "tensorflow/tsl/lib/io/record_index.h"
 #include "tensorflow/tsl/platform/coding.h"
 #include "tensorflow/tsl/platform/status.h"
 #include "tensorflow/tsl/platform/stringpiece.h"
 #if !defined(IS_SLIM_BUILD)
 #include "tensorflow/tsl/lib/io/snappy/snappy_compression_options.h"
 #include "tensorflow/tsl/lib/io/snappy/snappy_outputbuffer.h"
+#include "tensorflow/tsl/lib/io/snappy/snappy_parallel_outputbuffer.h"
 #include "tensorflow/tsl/lib/io/zlib_compression_options.h"
 #include "tensorflow/tsl/lib/io/zlib_outputbuffer.h"
 #endif  // IS_SLIM_BUILD
@@ -45,6 +49,12 @@ struct RecordWriterOptions {
   };
   CompressionType compression_type = NONE;
 
+  // If not null, the index of the file (see record_index.h) is written to
+  // "*index_file", which must be initially empty and remain live while the
+  // writer is in use. With compression, the indexed offsets are offsets in the
+  // uncompressed stream.
+  WritableFile* index_file = nullptr;
+
   static RecordWriterOptions CreateRecordWriterOptions(
       const string& compression_type);
 
@@ -111,8 +121,14 @@ class RecordWriter {
 #endif
 
  private:
+  // Adds the next record, of "n" bytes, to the index.
+  Status IndexRecord(size_t n);
+
   WritableFile* dest_;
   RecordWriterOptions options_;
+  // The offset of the next record.
+  uint64 offset_ = 0;
+  std::unique_ptr<RecordIndexBuilder> index_builder_;
 
   inline static uint32 MaskedCrc(const char* data, size_t n) {
     return crc32c::Mask(crc32c::Value(data, n));
@@ -19,6 +19,10 @@ limitations under the License.
 #include "tensorflow/tsl/platform/types.h"
 
 namespace tsl {
+namespace thread {
+class ThreadPool;
+}  // namespace thread
+
 namespace io {
 
 struct SnappyCompressionOptions {
@@ -28,6 +32,12 @@ struct SnappyCompressionOptions {
   // Size of the sink buffer where the compressed/decompressed data produced by
   // snappy is cached.
   int64_t output_buffer_size = 256 << 10;
+
+  // If not null, the pool on which blocks of `input_buffer_size` bytes are
+  // compressed in parallel when writing. Otherwise the blocks are compressed by
+  // the writing thread. Not owned; may be shared by several writers, and must
+  // outlive them.
+  thread::ThreadPool* compression_thread_pool = nullptr;
 };
 
 }  // namespace io
@@ -0,0 +1,142 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/tsl/lib/io/snappy/snappy_parallel_outputbuffer.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "tensorflow/tsl/platform/errors.h"
+#include "tensorflow/tsl/platform/logging.h"
+#include "tensorflow/tsl/platform/snappy.h"
+
+namespace tsl {
+namespace io {
+
+SnappyParallelOutputBuffer::SnappyParallelOutputBuffer(
+    WritableFile* file, size_t block_bytes, thread::ThreadPool* thread_pool)
+    : file_(file),
+      thread_pool_(thread_pool),
+      block_bytes_(block_bytes),
+      max_pending_blocks_(2 * std::max(thread_pool->NumThreads(), 1)) {
+  DCHECK_GT(block_bytes_, 0);
+  block_.reserve(block_bytes_);
+}
+
+SnappyParallelOutputBuffer::~SnappyParallelOutputBuffer() {
+  // The compression closures own their blocks, so there is no need to wait for
+  // them here.
+  if (!block_.empty() || !pending_.empty()) {
+    LOG(WARNING) << "There is still data in the output buffer. "
+                 << "Possible data loss has occurred.";
+  }
+}
+
+Status SnappyParallelOutputBuffer::Append(StringPiece data) {
+  while (!data.empty()) {
+    const size_t n = std::min(data.size(), block_bytes_ - block_.size());
+    block_.append(data.data(), n);
+    data.remove_prefix(n);
+    if (block_.size() == block_bytes_) {
+      SubmitBlock();
+      TF_RETURN_IF_ERROR(WriteBlocks(max_pending_blocks_));
+    }
+  }
+  return OkStatus();
+}
+
+#if defined(TF_CORD_SUPPORT)
+Status SnappyParallelOutputBuffer::Append(const absl::Cord& cord) {
+  for (absl::string_view fragment : cord.Chunks()) {
+    TF_RETURN_IF_ERROR(Append(fragment));
+  }
+  return OkStatus();
+}
+#endif
+
+void SnappyParallelOutputBuffer::SubmitBlock() {
+  auto block = std::make_shared<Block>();
+  block->input.swap(block_);
+  block_.reserve(block_bytes_);
+  pending_.push_back(block);
+  thread_pool_->Schedule([block]() {
+    std::string output;
+    const bool ok = port::Snappy_Compress(block->input.data(),
+                                          block->input.size(), &output);
+    mutex_lock l(block->mu);
+    if (ok) {
+      block->output = std::move(output);
+    } else {
+      block->status = errors::DataLoss("Snappy_Compress failed");
+    }
+    block->done = true;
+    block->cond_var.notify_all();
+  });
+}
+
+Status SnappyParallelOutputBuffer::WriteBlocks(size_t max_pending) {
+  while (!pending_.empty()) {
+    std::shared_ptr<Block> block = pending_.front();
+    mutex_lock l(block->mu);
+    // Blocks that are already compressed are written eagerly, so that writing
+    // overlaps with compression.
+    if (!block->done && pending_.size() <= max_pending) {
+      break;
+    }
+    while (!block->done) {
+      block->cond_var.wait(l);
+    }
+    pending_.pop_front();
+    TF_RETURN_IF_ERROR(block->status);
+    // Writes the length of the compressed block, in the byte order of
+    // `SnappyOutputBuffer`, followed by the compressed block.
+    const size_t length = block->output.size();
+    char header[4];
+    for (int i = 0; i < 4; ++i) {
+      header[i] = static_cast<char>(length >> (8 * (3 - i)));
+    }
+    TF_RETURN_IF_ERROR(file_->Append(StringPiece(header, sizeof(header))));
+    TF_RETURN_IF_ERROR(file_->Append(block->output));
+  }
+  return OkStatus();
+}
+
+Status SnappyParallelOutputBuffer::Close() {
+  // Given that we do not own `file`, we don't close it.
+  return Flush();
+}
+
+Status SnappyParallelOutputBuffer::Name(StringPiece* result) const {
+  return file_->Name(result);
+}
+
+Status SnappyParallelOutputBuffer::Sync() {
+  TF_RETURN_IF_ERROR(Flush());
+  return file_->Sync();
+}
+
+Status SnappyParallelOutputBuffer::Tell(int64_t* position) {
+  return file_->Tell(position);
+}
+
+Status SnappyParallelOutputBuffer::Flush() {
+  if (!block_.empty()) {
+    SubmitBlock();
+  }
+  return WriteBlocks(/*max_pending=*/0);
+}
+
+}  // namespace io
+}  // namespace tsl
@@ -0,0 +1,124 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_TSL_LIB_IO_SNAPPY_SNAPPY_PARALLEL_OUTPUTBUFFER_H_
+#define TENSORFLOW_TSL_LIB_IO_SNAPPY_SNAPPY_PARALLEL_OUTPUTBUFFER_H_
+
+#include <deque>
+#include <memory>
+#include <string>
+
+#include "tensorflow/tsl/platform/env.h"
+#include "tensorflow/tsl/platform/macros.h"
+#include "tensorflow/tsl/platform/mutex.h"
+#include "tensorflow/tsl/platform/status.h"
+#include "tensorflow/tsl/platform/threadpool.h"
+#include "tensorflow/tsl/platform/types.h"
+
+namespace tsl {
+namespace io {
+
+// Compresses input data using Snappy like `SnappyOutputBuffer`, and writes the
+// same output file format, but compresses the blocks of the input on a pool of
+// threads, so that compression does not stall the writer when it is slower
+// than the producer of the data.
+//
+// The input is split into blocks of `block_bytes` bytes. Each full block is
+// handed to the pool, and the compressed blocks are appended to `file` in the
+// order of the input. At most twice as many blocks as the pool has threads are
+// being compressed or waiting to be written at any time; `Append()` blocks on
+// the oldest of them beyond that, which bounds the memory used by the buffer.
+//
+// The pool is not owned, so that the writers of many files (e.g. the chunks of
+// a snapshot) share one set of compression threads instead of starting and
+// joining their own.
+//
+// Not thread-safe: the buffer must only be used by one thread at a time.
+class SnappyParallelOutputBuffer : public WritableFile {
+ public:
+  // Creates a `SnappyParallelOutputBuffer` for `file`, which compresses blocks
+  // of `block_bytes` bytes on `thread_pool`. `block_bytes` must be positive.
+  // Does not take ownership of `file` or `thread_pool`, which must outlive the
+  // buffer.
+  SnappyParallelOutputBuffer(WritableFile* file, size_t block_bytes,
+                             thread::ThreadPool* thread_pool);
+
+  // Per convention, the dtor does not call Flush() or Close(). We expect the
+  // caller to call those manually when done. Blocks that are still being
+  // compressed are dropped once the pool is done with them.
+  ~SnappyParallelOutputBuffer() override;
+
+  // Adds `data` to the compression pipeline. Blocks until the oldest pending
+  // block is written if too many blocks are pending.
+  Status Append(StringPiece data) override;
+
+#if defined(TF_CORD_SUPPORT)
+  Status Append(const absl::Cord& cord) override;
+#endif
+
+  // Compresses any buffered input and writes all output to file. This must be
+  // called before the destructor to avoid any data loss.
+  Status Close() override;
+
+  // Returns the name of the underlying file.
+  Status Name(StringPiece* result) const override;
+
+  // Compresses any buffered input, writes all output to file and syncs it.
+  Status Sync() override;
+
+  // Returns the write position in the underlying file. The position does not
+  // reflect buffered, un-flushed data.
+  Status Tell(int64_t* position) override;
+
+  // Compresses any buffered input and writes all output to file.
+  Status Flush() override;
+
+ private:
+  // A block of the input and its compressed output.
+  struct Block {
+    std::string input;
+    std::string output TF_GUARDED_BY(mu);
+    Status status TF_GUARDED_BY(mu);
+    bool done TF_GUARDED_BY(mu) = false;
+    mutex mu;
+    condition_variable cond_var;
+  };
+
+  // Hands `block_` to the thread pool and starts a new block.
+  void SubmitBlock();
+
+  // Writes the compressed blocks at the front of `pending_` to file in order,
+  // waiting for the compression of the oldest blocks until at most
+  // `max_pending` blocks remain.
+  Status WriteBlocks(size_t max_pending);
+
+  WritableFile* file_;               // Not owned
+  thread::ThreadPool* thread_pool_;  // Not owned
+  const size_t block_bytes_;
+  const size_t max_pending_blocks_;
+
+  // The input of the block being filled.
+  std::string block_;
+  // The blocks handed to the thread pool that have not been written yet, in
+  // the order of the input.
+  std::deque<std::shared_ptr<Block>> pending_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(SnappyParallelOutputBuffer);
+};
+
+}  // namespace io
+}  // namespace tsl
+
+#endif  // TENSORFLOW_TSL_LIB_IO_SNAPPY_SNAPPY_PARALLEL_OUTPUTBUFFER_H_
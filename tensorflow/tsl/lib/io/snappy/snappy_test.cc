@@ -21,8 +21,10 @@ limitations under the License.
 #include "tensorflow/tsl/lib/io/snappy/snappy_inputbuffer.h"
 #include "tensorflow/tsl/lib/io/snappy/snappy_inputstream.h"
 #include "tensorflow/tsl/lib/io/snappy/snappy_outputbuffer.h"
+#include "tensorflow/tsl/lib/io/snappy/snappy_parallel_outputbuffer.h"
 #include "tensorflow/tsl/platform/env.h"
 #include "tensorflow/tsl/platform/test.h"
+#include "tensorflow/tsl/platform/threadpool.h"
 
 namespace tsl {
 
@@ -402,4 +404,75 @@ TEST(SnappyBuffers, TellInputStream) {
   TestTellInputStream(10000, 10000, 2000, 10000, 2);
 }
 
+// Writes `num_writes` copies of the test string with a
+// `SnappyParallelOutputBuffer`, and checks that they are read back by both
+// `SnappyInputBuffer` and `SnappyInputStream`.
+void TestParallelWrites(int32_t block_bytes, int num_threads, int num_writes,
+                        bool with_flush) {
+  Env* env = Env::Default();
+  const string fname = testing::TmpDir() + "/snappy_parallel_buffers_test";
+  const string data = GenTestString(3);
+  string expected_result;
+  {
+    std::unique_ptr<WritableFile> file_writer;
+    TF_ASSERT_OK(env->NewWritableFile(fname, &file_writer));
+    thread::ThreadPool thread_pool(env, "snappy_compression", num_threads);
+    io::SnappyParallelOutputBuffer out(file_writer.get(), block_bytes,
+                                       &thread_pool);
+    for (int i = 0; i < num_writes; ++i) {
+      TF_ASSERT_OK(out.Append(StringPiece(data)));
+      if (with_flush) {
+        TF_ASSERT_OK(out.Flush());
+      }
+      strings::StrAppend(&expected_result, data);
+    }
+    TF_ASSERT_OK(out.Close());
+    TF_ASSERT_OK(file_writer->Close());
+  }
+
+  std::unique_ptr<RandomAccessFile> file_reader;
+  TF_ASSERT_OK(env->NewRandomAccessFile(fname, &file_reader));
+  io::SnappyInputBuffer in(file_reader.get(),
+                           /*input_buffer_bytes=*/2 * block_bytes,
+                           /*output_buffer_bytes=*/block_bytes);
+  tstring actual_result;
+  TF_ASSERT_OK(in.ReadNBytes(expected_result.size(), &actual_result));
+  EXPECT_EQ(actual_result, expected_result);
+
+  io::RandomAccessInputStream random_input_stream(file_reader.get(), false);
+  io::SnappyInputStream snappy_input_stream(
+      &random_input_stream, /*output_buffer_bytes=*/block_bytes);
+  actual_result.clear();
+  TF_ASSERT_OK(
+      snappy_input_stream.ReadNBytes(expected_result.size(), &actual_result));
+  EXPECT_EQ(actual_result, expected_result);
+}
+
+TEST(SnappyBuffers, ParallelWrites) {
+  if (!SnappyCompressionSupported()) {
+    fprintf(stderr, "skipping compression tests\n");
+    return;
+  }
+  TestParallelWrites(/*block_bytes=*/1000, /*num_threads=*/4,
+                     /*num_writes=*/100, /*with_flush=*/false);
+}
+
+TEST(SnappyBuffers, ParallelWritesWithFlush) {
+  if (!SnappyCompressionSupported()) {
+    fprintf(stderr, "skipping compression tests\n");
+    return;
+  }
+  TestParallelWrites(/*block_bytes=*/1000, /*num_threads=*/4,
+                     /*num_writes=*/20, /*with_flush=*/true);
+}
+
+TEST(SnappyBuffers, ParallelWritesSingleThread) {
+  if (!SnappyCompressionSupported()) {
+    fprintf(stderr, "skipping compression tests\n");
+    return;
+  }
+  TestParallelWrites(/*block_bytes=*/4096, /*num_threads=*/1,
+                     /*num_writes=*/50, /*with_flush=*/false);
+}
+
 }  // namespace tsl
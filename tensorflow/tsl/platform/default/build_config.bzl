@@ -673,6 +673,8 @@ def tf_additional_lib_hdrs():
             clean_dep("//tensorflow/tsl/platform/windows:windows_file_system.h"),
         ],
         "//conditions:default": [
+            clean_dep("//tensorflow/tsl/platform/default:direct_io_writable_file.h"),
+            clean_dep("//tensorflow/tsl/platform/default:io_uring_random_access_file.h"),
             clean_dep("//tensorflow/tsl/platform/default:posix_file_system.h"),
             clean_dep("//tensorflow/tsl/platform/default:subprocess.h"),
         ],
@@ -0,0 +1,176 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/tsl/platform/default/direct_io_writable_file.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <utility>
+
+#include "tensorflow/tsl/platform/errors.h"
+#include "tensorflow/tsl/platform/mem.h"
+
+namespace tsl {
+namespace {
+
+// The alignment of the offsets, sizes and buffers of direct I/O writes, which
+// is a multiple of the logical block size of common devices.
+constexpr size_t kAlignment = 4096;
+
+// The size of the buffer, and so of most writes.
+constexpr size_t kBufferSize = 1 << 20;
+
+size_t RoundUp(size_t n) { return (n + kAlignment - 1) & ~(kAlignment - 1); }
+
+size_t RoundDown(size_t n) { return n & ~(kAlignment - 1); }
+
+}  // namespace
+
+/* static */ Status DirectIOWritableFile::Create(
+    const std::string& fname, std::unique_ptr<WritableFile>* result) {
+#if defined(__linux__) && defined(O_DIRECT)
+  const int flags = O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT | O_CLOEXEC;
+  const int fd = open(fname.c_str(), flags, 0666);
+  if (fd < 0) {
+    return errors::IOError(fname, errno);
+  }
+  char* buffer =
+      static_cast<char*>(port::AlignedMalloc(kBufferSize, kAlignment));
+  if (buffer == nullptr) {
+    close(fd);
+    return errors::ResourceExhausted(
+        "Failed to allocate a direct I/O buffer for ", fname);
+  }
+  result->reset(new DirectIOWritableFile(fname, fd, buffer));
+  return OkStatus();
+#else
+  return errors::Unimplemented("Direct I/O is not supported on this platform.");
+#endif
+}
+
+DirectIOWritableFile::DirectIOWritableFile(std::string filename, int fd,
+                                           char* buffer)
+    : filename_(std::move(filename)), fd_(fd), buffer_(buffer) {}
+
+DirectIOWritableFile::~DirectIOWritableFile() {
+  if (fd_ >= 0) {
+    // Ignoring any potential errors, like the other writable files.
+    Close().IgnoreError();
+  }
+  port::AlignedFree(buffer_);
+}
+
+Status DirectIOWritableFile::Append(StringPiece data) {
+  if (fd_ < 0) {
+    return errors::FailedPrecondition("File ", filename_, " is closed.");
+  }
+  while (!data.empty()) {
+    const size_t n = std::min(data.size(), kBufferSize - buffer_used_);
+    memcpy(buffer_ + buffer_used_, data.data(), n);
+    buffer_used_ += n;
+    data.remove_prefix(n);
+    if (buffer_used_ == kBufferSize) {
+      TF_RETURN_IF_ERROR(WriteBuffer(/*include_partial_block=*/false));
+    }
+  }
+  return OkStatus();
+}
+
+#if defined(TF_CORD_SUPPORT)
+Status DirectIOWritableFile::Append(const absl::Cord& cord) {
+  for (absl::string_view chunk : cord.Chunks()) {
+    TF_RETURN_IF_ERROR(Append(chunk));
+  }
+  return OkStatus();
+}
+#endif
+
+Status DirectIOWritableFile::WriteBuffer(bool include_partial_block) {
+  const size_t full_bytes = RoundDown(buffer_used_);
+  size_t write_bytes = full_bytes;
+  if (include_partial_block && buffer_used_ > full_bytes) {
+    write_bytes = RoundUp(buffer_used_);
+    memset(buffer_ + buffer_used_, 0, write_bytes - buffer_used_);
+  }
+  size_t written = 0;
+  while (written < write_bytes) {
+    const ssize_t r = pwrite(fd_, buffer_ + written, write_bytes - written,
+                             buffer_offset_ + written);
+    if (r < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return errors::IOError(filename_, errno);
+    }
+    written += r;
+  }
+  if (write_bytes > full_bytes &&
+      ftruncate(fd_, buffer_offset_ + buffer_used_) != 0) {
+    return errors::IOError(filename_, errno);
+  }
+  // Keeps the partial block, which is rewritten by the next write.
+  memmove(buffer_, buffer_ + full_bytes, buffer_used_ - full_bytes);
+  buffer_offset_ += full_bytes;
+  buffer_used_ -= full_bytes;
+  return OkStatus();
+}
+
+Status DirectIOWritableFile::Close() {
+  if (fd_ < 0) {
+    return errors::IOError(filename_, EBADF);
+  }
+  Status s = WriteBuffer(/*include_partial_block=*/true);
+  if (close(fd_) != 0 && s.ok()) {
+    s = errors::IOError(filename_, errno);
+  }
+  fd_ = -1;
+  return s;
+}
+
+Status DirectIOWritableFile::Flush() {
+  if (fd_ < 0) {
+    return errors::IOError(filename_, EBADF);
+  }
+  return WriteBuffer(/*include_partial_block=*/true);
+}
+
+Status DirectIOWritableFile::Name(StringPiece* result) const {
+  *result = filename_;
+  return OkStatus();
+}
+
+Status DirectIOWritableFile::Sync() {
+  TF_RETURN_IF_ERROR(Flush());
+#if defined(__linux__)
+  const int r = fdatasync(fd_);
+#else
+  const int r = fsync(fd_);
+#endif
+  if (r != 0) {
+    return errors::IOError(filename_, errno);
+  }
+  return OkStatus();
+}
+
+Status DirectIOWritableFile::Tell(int64_t* position) {
+  *position = buffer_offset_ + buffer_used_;
+  return OkStatus();
+}
+
+}  // namespace tsl
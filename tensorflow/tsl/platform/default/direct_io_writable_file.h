@@ -0,0 +1,83 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_TSL_PLATFORM_DEFAULT_DIRECT_IO_WRITABLE_FILE_H_
+#define TENSORFLOW_TSL_PLATFORM_DEFAULT_DIRECT_IO_WRITABLE_FILE_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "tensorflow/tsl/platform/file_system.h"
+#include "tensorflow/tsl/platform/status.h"
+
+namespace tsl {
+
+// A WritableFile that bypasses the page cache by writing with O_DIRECT, which
+// avoids copying large sequential writes into the page cache and evicting more
+// useful pages from it.
+//
+// Appended data is accumulated in an aligned buffer, whose full blocks are
+// written when it fills up. `Flush()` also writes the partial block at the end
+// of the buffer, padded to the alignment, and truncates the file back to its
+// logical size; the partial block is kept in the buffer and is rewritten by the
+// next write.
+class DirectIOWritableFile : public WritableFile {
+ public:
+  // Creates (or truncates) `fname` and opens it for direct I/O. Returns an
+  // error if direct I/O is not supported by the platform or the file system
+  // of `fname`.
+  static Status Create(const std::string& fname,
+                       std::unique_ptr<WritableFile>* result);
+
+  ~DirectIOWritableFile() override;
+
+  Status Append(StringPiece data) override;
+
+#if defined(TF_CORD_SUPPORT)
+  Status Append(const absl::Cord& cord) override;
+#endif
+
+  Status Close() override;
+
+  Status Flush() override;
+
+  Status Name(StringPiece* result) const override;
+
+  Status Sync() override;
+
+  Status Tell(int64_t* position) override;
+
+ private:
+  DirectIOWritableFile(std::string filename, int fd, char* buffer);
+
+  // Writes the full blocks of the buffer and, if `include_partial_block` is
+  // true, the partial block after them. The partial block is moved to the
+  // beginning of the buffer.
+  Status WriteBuffer(bool include_partial_block);
+
+  const std::string filename_;
+  int fd_;
+  // Aligned buffer of `kBufferSize` bytes, of which the first `buffer_used_`
+  // bytes hold data starting at the aligned offset `buffer_offset_` of the
+  // file.
+  char* const buffer_;
+  size_t buffer_used_ = 0;
+  int64_t buffer_offset_ = 0;
+};
+
+}  // namespace tsl
+
+#endif  // TENSORFLOW_TSL_PLATFORM_DEFAULT_DIRECT_IO_WRITABLE_FILE_H_
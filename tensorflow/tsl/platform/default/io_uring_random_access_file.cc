@@ -0,0 +1,371 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/tsl/platform/default/io_uring_random_access_file.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// io_uring is used through its system calls directly, so that it only requires
+// the kernel headers at build time.
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define TSL_HAS_IO_URING 1
+#endif
+#endif
+#endif
+
+#include "tensorflow/tsl/platform/errors.h"
+#include "tensorflow/tsl/platform/logging.h"
+
+namespace tsl {
+
+#if defined(TSL_HAS_IO_URING)
+
+// A submission and a completion ring of an io_uring instance, mapped into the
+// address space of the process. Not thread-safe.
+class IoUringRandomAccessFile::Ring {
+ public:
+  static Status Create(unsigned entries, std::unique_ptr<Ring>* result) {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    const int ring_fd = syscall(__NR_io_uring_setup, entries, &params);
+    if (ring_fd < 0) {
+      return errors::Unimplemented("io_uring_setup() failed: ",
+                                   strerror(errno));
+    }
+    std::unique_ptr<Ring> ring(new Ring(ring_fd, params));
+    TF_RETURN_IF_ERROR(ring->Map());
+    *result = std::move(ring);
+    return OkStatus();
+  }
+
+  ~Ring() {
+    if (sqes_ != nullptr) {
+      munmap(sqes_, params_.sq_entries * sizeof(io_uring_sqe));
+    }
+    if (cq_ring_ != nullptr && cq_ring_ != sq_ring_) {
+      munmap(cq_ring_, cq_ring_size_);
+    }
+    if (sq_ring_ != nullptr) {
+      munmap(sq_ring_, sq_ring_size_);
+    }
+    close(ring_fd_);
+  }
+
+  // The maximum number of outstanding reads.
+  unsigned entries() const { return params_.sq_entries; }
+
+  // Queues a read of `fd` at `offset` into `iov`, which must stay valid until
+  // the read completes. Requires fewer than `entries()` outstanding reads.
+  void PrepareRead(int fd, const struct iovec* iov, uint64 offset,
+                   uint64 user_data) {
+    const unsigned tail = *sq_tail_;
+    const unsigned index = tail & *sq_mask_;
+    io_uring_sqe* sqe = &sqes_[index];
+    memset(sqe, 0, sizeof(*sqe));
+    // IORING_OP_READV is supported by all kernels with io_uring.
+    sqe->opcode = IORING_OP_READV;
+    sqe->fd = fd;
+    sqe->off = offset;
+    sqe->addr = reinterpret_cast<uint64>(iov);
+    sqe->len = 1;
+    sqe->user_data = user_data;
+    sq_array_[index] = index;
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+    ++num_unsubmitted_;
+  }
+
+  // Submits the queued reads and waits until at least `min_complete` reads
+  // have completed.
+  Status SubmitAndWait(unsigned min_complete) {
+    while (true) {
+      const int ret =
+          syscall(__NR_io_uring_enter, ring_fd_, num_unsubmitted_,
+                  min_complete, IORING_ENTER_GETEVENTS, nullptr, 0);
+      if (ret >= 0) {
+        num_unsubmitted_ -= std::min<unsigned>(ret, num_unsubmitted_);
+        if (num_unsubmitted_ == 0) {
+          return OkStatus();
+        }
+      } else if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+        return errors::IOError("io_uring_enter()", errno);
+      }
+    }
+  }
+
+  // Removes the queued reads that have not been submitted yet. Returns their
+  // number.
+  unsigned DiscardUnsubmitted() {
+    const unsigned num_discarded = num_unsubmitted_;
+    __atomic_store_n(sq_tail_, *sq_tail_ - num_unsubmitted_, __ATOMIC_RELEASE);
+    num_unsubmitted_ = 0;
+    return num_discarded;
+  }
+
+  // Waits until `num_submitted` submitted reads have completed, discarding
+  // their results, so that the buffers they read into can be released. This
+  // relies on the completion ring only, in case io_uring_enter() fails.
+  void Drain(unsigned num_submitted) {
+    uint64 user_data;
+    int32 res;
+    while (num_submitted > 0) {
+      if (PopCompletion(&user_data, &res)) {
+        --num_submitted;
+        continue;
+      }
+      const int ret = syscall(__NR_io_uring_enter, ring_fd_, 0, 1,
+                              IORING_ENTER_GETEVENTS, nullptr, 0);
+      if (ret < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+        // The reads still complete into the completion ring.
+        usleep(1000);
+      }
+    }
+  }
+
+  // Pops the next completed read, if any.
+  bool PopCompletion(uint64* user_data, int32* res) {
+    const unsigned head = *cq_head_;
+    if (head == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) {
+      return false;
+    }
+    const io_uring_cqe& cqe = cqes_[head & *cq_mask_];
+    *user_data = cqe.user_data;
+    *res = cqe.res;
+    __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+    return true;
+  }
+
+ private:
+  Ring(int ring_fd, const io_uring_params& params)
+      : ring_fd_(ring_fd), params_(params) {}
+
+  Status Map() {
+    sq_ring_size_ =
+        params_.sq_off.array + params_.sq_entries * sizeof(unsigned);
+    cq_ring_size_ =
+        params_.cq_off.cqes + params_.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = false;
+#if defined(IORING_FEAT_SINGLE_MMAP)
+    single_mmap = params_.features & IORING_FEAT_SINGLE_MMAP;
+#endif
+    if (single_mmap) {
+      sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    }
+    sq_ring_ = MapRegion(sq_ring_size_, IORING_OFF_SQ_RING);
+    if (sq_ring_ == nullptr) {
+      return errors::IOError("mmap() of io_uring submission ring", errno);
+    }
+    cq_ring_ = single_mmap ? sq_ring_
+                           : MapRegion(cq_ring_size_, IORING_OFF_CQ_RING);
+    if (cq_ring_ == nullptr) {
+      return errors::IOError("mmap() of io_uring completion ring", errno);
+    }
+    sqes_ = static_cast<io_uring_sqe*>(MapRegion(
+        params_.sq_entries * sizeof(io_uring_sqe), IORING_OFF_SQES));
+    if (sqes_ == nullptr) {
+      return errors::IOError("mmap() of io_uring submission entries", errno);
+    }
+
+    char* sq = static_cast<char*>(sq_ring_);
+    sq_tail_ = reinterpret_cast<unsigned*>(sq + params_.sq_off.tail);
+    sq_mask_ = reinterpret_cast<unsigned*>(sq + params_.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<unsigned*>(sq + params_.sq_off.array);
+    char* cq = static_cast<char*>(cq_ring_);
+    cq_head_ = reinterpret_cast<unsigned*>(cq + params_.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(cq + params_.cq_off.tail);
+    cq_mask_ = reinterpret_cast<unsigned*>(cq + params_.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params_.cq_off.cqes);
+    return OkStatus();
+  }
+
+  void* MapRegion(size_t size, off_t offset) {
+    void* region = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring_fd_, offset);
+    return region == MAP_FAILED ? nullptr : region;
+  }
+
+  const int ring_fd_;
+  const io_uring_params params_;
+  unsigned num_unsubmitted_ = 0;
+
+  size_t sq_ring_size_ = 0;
+  size_t cq_ring_size_ = 0;
+  void* sq_ring_ = nullptr;
+  void* cq_ring_ = nullptr;
+  io_uring_sqe* sqes_ = nullptr;
+
+  unsigned* sq_tail_ = nullptr;
+  unsigned* sq_mask_ = nullptr;
+  unsigned* sq_array_ = nullptr;
+  unsigned* cq_head_ = nullptr;
+  unsigned* cq_tail_ = nullptr;
+  unsigned* cq_mask_ = nullptr;
+  io_uring_cqe* cqes_ = nullptr;
+};
+
+void IoUringRandomAccessFile::ReadBatchLocked(
+    absl::Span<ReadRequest> requests) const {
+  // The number of bytes read so far for each request, and the buffer of its
+  // outstanding read.
+  std::vector<size_t> num_read(requests.size(), 0);
+  std::vector<struct iovec> iovecs(requests.size());
+  std::deque<size_t> pending;
+  for (size_t i = 0; i < requests.size(); ++i) {
+    requests[i].status = OkStatus();
+    requests[i].result = StringPiece(requests[i].scratch, 0);
+    if (requests[i].n > 0) {
+      pending.push_back(i);
+    }
+  }
+
+  unsigned num_outstanding = 0;
+  while (!pending.empty() || num_outstanding > 0) {
+    while (!pending.empty() && num_outstanding < ring_->entries()) {
+      const size_t i = pending.front();
+      pending.pop_front();
+      const ReadRequest& request = requests[i];
+      iovecs[i].iov_base = request.scratch + num_read[i];
+      // Some kernels reject reads of more than INT32_MAX bytes.
+      iovecs[i].iov_len =
+          std::min<size_t>(request.n - num_read[i], INT32_MAX);
+      ring_->PrepareRead(fd_, &iovecs[i], request.offset + num_read[i], i);
+      ++num_outstanding;
+    }
+    Status s = ring_->SubmitAndWait(/*min_complete=*/1);
+    if (!s.ok()) {
+      // io_uring_enter() only fails on invalid arguments after a successful
+      // setup. Waits for the reads in flight, which reference `iovecs` and the
+      // scratch buffers of the requests, then fails the unfinished requests
+      // and stops using the ring.
+      LOG(ERROR) << "Disabling io_uring reads: " << s;
+      num_outstanding -= ring_->DiscardUnsubmitted();
+      ring_->Drain(num_outstanding);
+      ring_failed_ = true;
+      for (size_t i = 0; i < requests.size(); ++i) {
+        if (requests[i].status.ok() && num_read[i] < requests[i].n) {
+          requests[i].status = s;
+        }
+      }
+      return;
+    }
+    uint64 i;
+    int32 res;
+    while (ring_->PopCompletion(&i, &res)) {
+      --num_outstanding;
+      ReadRequest& request = requests[i];
+      if (res > 0) {
+        num_read[i] += res;
+        if (num_read[i] < request.n) {
+          pending.push_back(i);
+        }
+      } else if (res == 0) {
+        request.status = Status(absl::StatusCode::kOutOfRange,
+                                "Read less bytes than requested");
+      } else if (res == -EINTR || res == -EAGAIN) {
+        pending.push_back(i);
+      } else {
+        StringPiece name;
+        file_->Name(&name).IgnoreError();
+        request.status = errors::IOError(string(name), -res);
+      }
+      request.result = StringPiece(request.scratch, num_read[i]);
+    }
+  }
+}
+
+#else  // TSL_HAS_IO_URING
+
+class IoUringRandomAccessFile::Ring {
+ public:
+  static Status Create(unsigned entries, std::unique_ptr<Ring>* result) {
+    return errors::Unimplemented("io_uring is not supported on this platform");
+  }
+};
+
+void IoUringRandomAccessFile::ReadBatchLocked(
+    absl::Span<ReadRequest> requests) const {
+  file_->ReadBatch(requests);
+}
+
+#endif  // TSL_HAS_IO_URING
+
+Status IoUringRandomAccessFile::Create(
+    int fd, int queue_depth, std::unique_ptr<RandomAccessFile>* file) {
+  if (queue_depth <= 0) {
+    return errors::InvalidArgument("io_uring queue depth must be positive: ",
+                                   queue_depth);
+  }
+  std::unique_ptr<Ring> ring;
+  TF_RETURN_IF_ERROR(Ring::Create(queue_depth, &ring));
+  file->reset(
+      new IoUringRandomAccessFile(std::move(*file), fd, std::move(ring)));
+  return OkStatus();
+}
+
+IoUringRandomAccessFile::IoUringRandomAccessFile(
+    std::unique_ptr<RandomAccessFile> file, int fd, std::unique_ptr<Ring> ring)
+    : file_(std::move(file)), fd_(fd), ring_(std::move(ring)) {}
+
+IoUringRandomAccessFile::~IoUringRandomAccessFile() = default;
+
+Status IoUringRandomAccessFile::Name(StringPiece* result) const {
+  return file_->Name(result);
+}
+
+Status IoUringRandomAccessFile::Read(uint64 offset, size_t n,
+                                     StringPiece* result,
+                                     char* scratch) const {
+  return file_->Read(offset, n, result, scratch);
+}
+
+#if defined(TF_CORD_SUPPORT)
+Status IoUringRandomAccessFile::Read(uint64 offset, size_t n,
+                                     absl::Cord* cord) const {
+  return file_->Read(offset, n, cord);
+}
+#endif
+
+void IoUringRandomAccessFile::ReadBatch(
+    absl::Span<ReadRequest> requests) const {
+  // A single read gains nothing from the ring, and a concurrent batch would
+  // have to wait for it.
+  if (requests.size() <= 1 || !mu_.try_lock()) {
+    file_->ReadBatch(requests);
+    return;
+  }
+  if (ring_failed_) {
+    mu_.unlock();
+    file_->ReadBatch(requests);
+    return;
+  }
+  ReadBatchLocked(requests);
+  mu_.unlock();
+}
+
+}  // namespace tsl
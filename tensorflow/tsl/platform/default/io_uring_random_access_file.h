@@ -0,0 +1,81 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_TSL_PLATFORM_DEFAULT_IO_URING_RANDOM_ACCESS_FILE_H_
+#define TENSORFLOW_TSL_PLATFORM_DEFAULT_IO_URING_RANDOM_ACCESS_FILE_H_
+
+#include <memory>
+
+#include "absl/types/span.h"
+#include "tensorflow/tsl/platform/file_system.h"
+#include "tensorflow/tsl/platform/mutex.h"
+#include "tensorflow/tsl/platform/status.h"
+
+namespace tsl {
+
+// A RandomAccessFile that performs `ReadBatch()` with a Linux io_uring: the
+// reads of a batch are queued in the submission ring and submitted with a
+// single system call, so that up to `queue_depth` of them are outstanding in
+// the kernel at once. Short reads are resubmitted for their remainder.
+//
+// Single `Read()` calls, and batches issued while another thread is using the
+// ring, are delegated to the wrapped file, so that concurrent readers are never
+// serialized on the ring.
+class IoUringRandomAccessFile : public RandomAccessFile {
+ public:
+  // Wraps `*file`, which must read from the descriptor `fd` and keep it open,
+  // in an `IoUringRandomAccessFile` with a ring of `queue_depth` entries. If
+  // io_uring is not supported by the build or the kernel, returns an error and
+  // leaves `*file` unchanged.
+  static Status Create(int fd, int queue_depth,
+                       std::unique_ptr<RandomAccessFile>* file);
+
+  ~IoUringRandomAccessFile() override;
+
+  Status Name(StringPiece* result) const override;
+
+  Status Read(uint64 offset, size_t n, StringPiece* result,
+              char* scratch) const override;
+
+#if defined(TF_CORD_SUPPORT)
+  Status Read(uint64 offset, size_t n, absl::Cord* cord) const override;
+#endif
+
+  void ReadBatch(absl::Span<ReadRequest> requests) const override;
+
+  bool SupportsBatchedReads() const override { return true; }
+
+ private:
+  class Ring;
+
+  IoUringRandomAccessFile(std::unique_ptr<RandomAccessFile> file, int fd,
+                          std::unique_ptr<Ring> ring);
+
+  // Performs `requests` on the ring.
+  void ReadBatchLocked(absl::Span<ReadRequest> requests) const
+      TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  const std::unique_ptr<RandomAccessFile> file_;
+  const int fd_;
+
+  mutable mutex mu_;
+  const std::unique_ptr<Ring> ring_ TF_PT_GUARDED_BY(mu_);
+  // Whether the ring failed, and reads are delegated to `file_`.
+  mutable bool ring_failed_ TF_GUARDED_BY(mu_) = false;
+};
+
+}  // namespace tsl
+
+#endif  // TENSORFLOW_TSL_PLATFORM_DEFAULT_IO_URING_RANDOM_ACCESS_FILE_H_
@@ -18,6 +18,7 @@ limitations under the License.
 #include <fcntl.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <sys/mman.h>
 
 #if defined(__linux__)
@@ -29,6 +30,8 @@ limitations under the License.
 #include <time.h>
 #include <unistd.h>
 
+#include "tensorflow/tsl/platform/default/direct_io_writable_file.h"
+#include "tensorflow/tsl/platform/default/io_uring_random_access_file.h"
 #include "tensorflow/tsl/platform/default/posix_file_system.h"
 #include "tensorflow/tsl/platform/env.h"
 #include "tensorflow/tsl/platform/errors.h"
@@ -45,6 +48,13 @@ using ::tsl::errors::IOError;
 // 128KB of copy buffer
 constexpr size_t kPosixCopyFileBufferSize = 128 * 1024;
 
+// Returns the io_uring queue depth of new random access files, from the
+// TF_POSIX_IO_URING_QUEUE_DEPTH environment variable. 0 disables io_uring.
+int IoUringQueueDepth() {
+  const char* value = getenv("TF_POSIX_IO_URING_QUEUE_DEPTH");
+  return value == nullptr ? 0 : atoi(value);
+}
+
 // pread() based random-access
 class PosixRandomAccessFile : public RandomAccessFile {
  private:
@@ -232,6 +242,15 @@ Status PosixFileSystem::NewRandomAccessFile(
     s = IOError(fname, errno);
   } else {
     result->reset(new PosixRandomAccessFile(translated_fname, fd));
+    const int queue_depth = IoUringQueueDepth();
+    if (queue_depth > 0) {
+      Status ring_status =
+          IoUringRandomAccessFile::Create(fd, queue_depth, result);
+      if (!ring_status.ok()) {
+        VLOG(1) << "Not using io_uring to read " << fname << ": "
+                << ring_status;
+      }
+    }
   }
   return s;
 }
@@ -264,6 +283,12 @@ Status PosixFileSystem::NewAppendableFile(
   return s;
 }
 
+Status PosixFileSystem::NewDirectIOWritableFile(
+    const string& fname, TransactionToken* token,
+    std::unique_ptr<WritableFile>* result) {
+  return DirectIOWritableFile::Create(TranslateName(fname), result);
+}
+
 Status PosixFileSystem::NewReadOnlyMemoryRegionFromFile(
     const string& fname, TransactionToken* token,
     std::unique_ptr<ReadOnlyMemoryRegion>* result) {
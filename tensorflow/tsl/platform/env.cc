@@ -220,6 +220,13 @@ Status Env::NewAppendableFile(const string& fname,
   return fs->NewAppendableFile(fname, result);
 }
 
+Status Env::NewDirectIOWritableFile(const string& fname,
+                                    std::unique_ptr<WritableFile>* result) {
+  FileSystem* fs;
+  TF_RETURN_IF_ERROR(GetFileSystemForFile(fname, &fs));
+  return fs->NewDirectIOWritableFile(fname, result);
+}
+
 Status Env::FileExists(const string& fname) {
   FileSystem* fs;
   TF_RETURN_IF_ERROR(GetFileSystemForFile(fname, &fs));
@@ -173,6 +173,21 @@ class Env {
                            std::unique_ptr<WritableFile>* result) {
     return OkStatus();
   }
+
+  /// \brief Creates an object that writes to a new file with direct I/O,
+  /// bypassing the page cache. Deletes any existing file with the same name
+  /// and creates a new file.
+  ///
+  /// Returns `Unimplemented` if the file system of `fname` does not support
+  /// direct I/O, in which case callers should fall back to
+  /// `NewWritableFile()`.
+  ///
+  /// The ownership of the returned WritableFile is passed to the caller
+  /// and the object should be deleted when is not used. The file object
+  /// shouldn't live longer than the Env object.
+  Status NewDirectIOWritableFile(const std::string& fname,
+                                 std::unique_ptr<WritableFile>* result);
+
   /// \brief Creates a readonly region of memory with the file context.
   ///
   /// On success, it returns a pointer to read-only memory region
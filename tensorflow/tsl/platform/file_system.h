@@ -24,6 +24,7 @@ limitations under the License.
 #include <utility>
 #include <vector>
 
+#include "absl/types/span.h"
 #include "tensorflow/tsl/platform/cord.h"
 #include "tensorflow/tsl/platform/errors.h"
 #include "tensorflow/tsl/platform/file_statistics.h"
@@ -125,6 +126,29 @@ class FileSystem {
     return OkStatus();
   }
 
+  /// \brief Creates an object that writes to a new file with direct I/O,
+  /// bypassing the page cache of the operating system. Deletes any existing
+  /// file with the same name and creates a new file.
+  ///
+  /// Direct I/O suits large sequential writes whose data is not read back
+  /// soon. File systems that do not support it return `Unimplemented`, in
+  /// which case callers should fall back to `NewWritableFile()`.
+  ///
+  /// The returned file will only be accessed by one thread at a time.
+  ///
+  /// The ownership of the returned WritableFile is passed to the caller
+  /// and the object should be deleted when is not used.
+  virtual tsl::Status NewDirectIOWritableFile(
+      const std::string& fname, std::unique_ptr<WritableFile>* result) {
+    return NewDirectIOWritableFile(fname, nullptr, result);
+  }
+
+  virtual tsl::Status NewDirectIOWritableFile(
+      const std::string& fname, TransactionToken* token,
+      std::unique_ptr<WritableFile>* result) {
+    return errors::Unimplemented("Direct I/O is not supported for ", fname);
+  }
+
   /// \brief Creates a readonly region of memory with the file context.
   ///
   /// On success, it returns a pointer to read-only memory region
@@ -545,6 +569,7 @@ class FileSystem {
   using FileSystem::NewRandomAccessFile;                      \
   using FileSystem::NewWritableFile;                          \
   using FileSystem::NewAppendableFile;                        \
+  using FileSystem::NewDirectIOWritableFile;                  \
   using FileSystem::NewReadOnlyMemoryRegionFromFile;          \
   using FileSystem::FileExists;                               \
   using FileSystem::GetChildren;                              \
@@ -589,6 +614,13 @@ class WrappedFileSystem : public FileSystem {
     return fs_->NewAppendableFile(fname, (token ? token : token_), result);
   }
 
+  tsl::Status NewDirectIOWritableFile(
+      const std::string& fname, TransactionToken* token,
+      std::unique_ptr<WritableFile>* result) override {
+    return fs_->NewDirectIOWritableFile(fname, (token ? token : token_),
+                                        result);
+  }
+
   tsl::Status NewReadOnlyMemoryRegionFromFile(
       const std::string& fname, TransactionToken* token,
       std::unique_ptr<ReadOnlyMemoryRegion>* result) override {
@@ -771,6 +803,37 @@ class RandomAccessFile {
   }
 #endif
 
+  /// \brief A read of up to `n` bytes starting at `offset` into
+  /// `scratch[0..n-1]`, for `ReadBatch()`.
+  struct ReadRequest {
+    uint64 offset = 0;
+    size_t n = 0;
+    char* scratch = nullptr;
+
+    /// The data and status of the read, as set by `Read()`.
+    StringPiece result;
+    tsl::Status status;
+  };
+
+  /// \brief Performs each of `requests` as if by `Read()`, setting its
+  /// `result` and `status`.
+  ///
+  /// Implementations may keep several of the reads outstanding at once, e.g.
+  /// to let the device serve them concurrently. The default implementation
+  /// performs them one at a time.
+  ///
+  /// Safe for concurrent use by multiple threads.
+  virtual void ReadBatch(absl::Span<ReadRequest> requests) const {
+    for (ReadRequest& request : requests) {
+      request.status =
+          Read(request.offset, request.n, &request.result, request.scratch);
+    }
+  }
+
+  /// \brief Returns true if `ReadBatch()` keeps several reads outstanding at
+  /// once, so that callers gain from buffering more than one read ahead.
+  virtual bool SupportsBatchedReads() const { return false; }
+
  private:
   TF_DISALLOW_COPY_AND_ASSIGN(RandomAccessFile);
 };
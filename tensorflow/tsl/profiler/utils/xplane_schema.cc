@@ -201,6 +201,7 @@ const StatTypeMap& GetStatTypeMap() {
       {"bytes_allocated", kBytesAllocated},
       {"bytes_available", kBytesAvailable},
       {"fragmentation", kFragmentation},
+      {"free_bytes_by_bin", kFreeBytesByBin},
       {"peak_bytes_in_use", kPeakBytesInUse},
       {"requested_bytes", kRequestedBytes},
       {"allocation_bytes", kAllocationBytes},
@@ -193,6 +193,7 @@ enum StatType {
   kBytesAllocated,
   kBytesAvailable,
   kFragmentation,
+  kFreeBytesByBin,
   kPeakBytesInUse,
   kRequestedBytes,
   kAllocationBytes,